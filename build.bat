@@ -105,7 +105,7 @@ REM    Add all the Maya libraries to link against
 set CommonLinkerFlags=%CommonLinkerFlags% "%MayaLibraryDir%\OpenMaya.lib" "%MayaLibraryDir%\OpenMayaAnim.lib" "%MayaLibraryDir%\OpenMayaFX.lib" "%MayaLibraryDir%\OpenMayaRender.lib" "%MayaLibraryDir%\OpenMayaUI.lib" "%MayaLibraryDir%\Foundation.lib"
 
 REM    Now add the OS libraries to link against
-set CommonLinkerFlags=%CommonLinkerFlags% /defaultlib:Kernel32.lib /defaultlib:User32.lib /defaultlib:Dbghelp.lib
+set CommonLinkerFlags=%CommonLinkerFlags% /defaultlib:Kernel32.lib /defaultlib:User32.lib /defaultlib:Dbghelp.lib /defaultlib:Psapi.lib
 
 set CommonLinkerFlags=%CommonLinkerFlags% /pdb:"%BuildDir%\%ProjectName%.pdb" /implib:"%BuildDir%\%ProjectName%.lib" "%BuildDir%\%ProjectName%.obj"
 
@@ -175,11 +175,11 @@ if not "%_NT_DEBUGGER_EXTENSION_PATH%"=="" (
 
 
 REM    Now build the custom dump file reader
-set DumpReaderCommonCompilerFlags=/nologo /W4 /WX /Fe:"%BuildDir%\dump_reader.exe"
+set DumpReaderCommonCompilerFlags=/nologo /W4 /WX /D _CRT_SECURE_NO_WARNINGS /Fe:"%BuildDir%\dump_reader.exe"
 set DumpReaderDebugCompilerFlags=%DumpReaderCommonCompilerFlags% /Zi /Od
 set DumpReaderReleaseCompilerFlags=%DumpReaderCommonCompilerFlags% /O2
 
-set DumpReaderCommonLinkerFlags=/nologo /machine:x64 /incremental:no /subsystem:console /defaultlib:Kernel32.lib /defaultlib:Dbghelp.lib /pdb:"%BuildDir%\dump_reader.pdb"
+set DumpReaderCommonLinkerFlags=/nologo /machine:x64 /incremental:no /subsystem:console /defaultlib:Kernel32.lib /defaultlib:Dbghelp.lib /defaultlib:Psapi.lib /pdb:"%BuildDir%\dump_reader.pdb"
 set DumpReaderDebugLinkerFlags=%DumpReaderCommonLinkerFlags% /opt:noref /debug
 set DumpReaderReleaseLinkerFlags=%DumpReaderCommonLinkerFlags% /opt:ref
 
@@ -195,6 +195,113 @@ echo Compiling custom dump file reader (command follows)...
 echo %DumpReaderBuildCmd%
 %DumpReaderBuildCmd%
 if %errorlevel% neq 0 goto error
+
+
+REM    Now build the stub DLL that the crash handler harness loads copies of for -benchiat.
+REM    It has no CRT and no entry point, so that loading it costs as little as possible.
+set CrashHarnessStubCompilerFlags=/nologo /W4 /WX /GS- /O2 /LD /Fe:"%BuildDir%\maya_crash_harness_stub.dll"
+set CrashHarnessStubLinkerFlags=/nologo /dll /noentry /nodefaultlib /machine:x64 /incremental:no Kernel32.lib
+
+set CrashHarnessStubEntryPoint=%~dp0src\maya_crash_harness_stub_dll.c
+
+set CrashHarnessStubBuildCmd=cl %CrashHarnessStubCompilerFlags% "%CrashHarnessStubEntryPoint%" /link %CrashHarnessStubLinkerFlags%
+
+echo Compiling crash handler harness stub DLL (command follows)...
+echo %CrashHarnessStubBuildCmd%
+%CrashHarnessStubBuildCmd%
+if %errorlevel% neq 0 goto error
+
+
+REM    Now build the standalone crash handler harness
+set CrashHarnessCommonCompilerFlags=/nologo /W4 /WX /EHsc /D _CRT_SECURE_NO_WARNINGS /Fe:"%BuildDir%\maya_crash_harness.exe"
+set CrashHarnessDebugCompilerFlags=%CrashHarnessCommonCompilerFlags% /Zi /Od /D_DEBUG /MDd
+set CrashHarnessReleaseCompilerFlags=%CrashHarnessCommonCompilerFlags% /O2 /DNDEBUG /MD
+
+set CrashHarnessCommonLinkerFlags=/nologo /machine:x64 /incremental:no /subsystem:console /defaultlib:Kernel32.lib /defaultlib:Dbghelp.lib /defaultlib:Ws2_32.lib /defaultlib:Cabinet.lib /defaultlib:Psapi.lib /pdb:"%BuildDir%\maya_crash_harness.pdb"
+set CrashHarnessDebugLinkerFlags=%CrashHarnessCommonLinkerFlags% /opt:noref /debug
+set CrashHarnessReleaseLinkerFlags=%CrashHarnessCommonLinkerFlags% /opt:ref
+
+set CrashHarnessEntryPoint=%~dp0src\maya_crash_harness_main.cpp
+
+if "%BuildType%"=="debug" (
+    set CrashHarnessBuildCmd=cl %CrashHarnessDebugCompilerFlags% "%CrashHarnessEntryPoint%" /link %CrashHarnessDebugLinkerFlags%
+) else (
+    set CrashHarnessBuildCmd=cl %CrashHarnessReleaseCompilerFlags% "%CrashHarnessEntryPoint%" /link %CrashHarnessReleaseLinkerFlags%
+)
+
+echo Compiling crash handler harness (command follows)...
+echo %CrashHarnessBuildCmd%
+%CrashHarnessBuildCmd%
+if %errorlevel% neq 0 goto error
+
+
+REM    Now build the live breadcrumb monitor
+set BreadcrumbMonitorCommonCompilerFlags=/nologo /W4 /WX /D _CRT_SECURE_NO_WARNINGS /Fe:"%BuildDir%\maya_breadcrumb_monitor.exe"
+set BreadcrumbMonitorDebugCompilerFlags=%BreadcrumbMonitorCommonCompilerFlags% /Zi /Od
+set BreadcrumbMonitorReleaseCompilerFlags=%BreadcrumbMonitorCommonCompilerFlags% /O2
+
+set BreadcrumbMonitorCommonLinkerFlags=/nologo /machine:x64 /incremental:no /subsystem:console /defaultlib:Kernel32.lib /pdb:"%BuildDir%\maya_breadcrumb_monitor.pdb"
+set BreadcrumbMonitorDebugLinkerFlags=%BreadcrumbMonitorCommonLinkerFlags% /opt:noref /debug
+set BreadcrumbMonitorReleaseLinkerFlags=%BreadcrumbMonitorCommonLinkerFlags% /opt:ref
+
+set BreadcrumbMonitorEntryPoint=%~dp0src\maya_breadcrumb_monitor_main.c
+
+if "%BuildType%"=="debug" (
+    set BreadcrumbMonitorBuildCmd=cl %BreadcrumbMonitorDebugCompilerFlags% "%BreadcrumbMonitorEntryPoint%" /link %BreadcrumbMonitorDebugLinkerFlags%
+) else (
+    set BreadcrumbMonitorBuildCmd=cl %BreadcrumbMonitorReleaseCompilerFlags% "%BreadcrumbMonitorEntryPoint%" /link %BreadcrumbMonitorReleaseLinkerFlags%
+)
+
+echo Compiling live breadcrumb monitor (command follows)...
+echo %BreadcrumbMonitorBuildCmd%
+%BreadcrumbMonitorBuildCmd%
+if %errorlevel% neq 0 goto error
+
+
+REM    Now build the crash report uploader
+set CrashUploaderCommonCompilerFlags=/nologo /W4 /WX /D _CRT_SECURE_NO_WARNINGS /Fe:"%BuildDir%\maya_crash_uploader.exe"
+set CrashUploaderDebugCompilerFlags=%CrashUploaderCommonCompilerFlags% /Zi /Od
+set CrashUploaderReleaseCompilerFlags=%CrashUploaderCommonCompilerFlags% /O2
+
+set CrashUploaderCommonLinkerFlags=/nologo /machine:x64 /incremental:no /subsystem:console /defaultlib:Kernel32.lib /defaultlib:Winhttp.lib /defaultlib:Cabinet.lib /pdb:"%BuildDir%\maya_crash_uploader.pdb"
+set CrashUploaderDebugLinkerFlags=%CrashUploaderCommonLinkerFlags% /opt:noref /debug
+set CrashUploaderReleaseLinkerFlags=%CrashUploaderCommonLinkerFlags% /opt:ref
+
+set CrashUploaderEntryPoint=%~dp0src\maya_crash_uploader_main.c
+
+if "%BuildType%"=="debug" (
+    set CrashUploaderBuildCmd=cl %CrashUploaderDebugCompilerFlags% "%CrashUploaderEntryPoint%" /link %CrashUploaderDebugLinkerFlags%
+) else (
+    set CrashUploaderBuildCmd=cl %CrashUploaderReleaseCompilerFlags% "%CrashUploaderEntryPoint%" /link %CrashUploaderReleaseLinkerFlags%
+)
+
+echo Compiling crash report uploader (command follows)...
+echo %CrashUploaderBuildCmd%
+%CrashUploaderBuildCmd%
+if %errorlevel% neq 0 goto error
+
+
+REM    Now build the symbol server
+set SymbolServerCommonCompilerFlags=/nologo /W4 /WX /D _CRT_SECURE_NO_WARNINGS /Fe:"%BuildDir%\maya_symbol_server.exe"
+set SymbolServerDebugCompilerFlags=%SymbolServerCommonCompilerFlags% /Zi /Od
+set SymbolServerReleaseCompilerFlags=%SymbolServerCommonCompilerFlags% /O2
+
+set SymbolServerCommonLinkerFlags=/nologo /machine:x64 /incremental:no /subsystem:console /defaultlib:Kernel32.lib /defaultlib:Dbghelp.lib /pdb:"%BuildDir%\maya_symbol_server.pdb"
+set SymbolServerDebugLinkerFlags=%SymbolServerCommonLinkerFlags% /opt:noref /debug
+set SymbolServerReleaseLinkerFlags=%SymbolServerCommonLinkerFlags% /opt:ref
+
+set SymbolServerEntryPoint=%~dp0src\maya_symbol_server_main.c
+
+if "%BuildType%"=="debug" (
+    set SymbolServerBuildCmd=cl %SymbolServerDebugCompilerFlags% "%SymbolServerEntryPoint%" /link %SymbolServerDebugLinkerFlags%
+) else (
+    set SymbolServerBuildCmd=cl %SymbolServerReleaseCompilerFlags% "%SymbolServerEntryPoint%" /link %SymbolServerReleaseLinkerFlags%
+)
+
+echo Compiling symbol server (command follows)...
+echo %SymbolServerBuildCmd%
+%SymbolServerBuildCmd%
+if %errorlevel% neq 0 goto error
 if %errorlevel% == 0 goto success
 
 
@@ -9,7 +9,10 @@
 
 #define MAYA_CRASH_INFO_STREAM_TYPE LastReservedStream + 1
 
-#define MINIDUMP_FILE_NAME "MayaCustomCrashDump.dmp"
+/// Crash dumps are named ``MayaCustomCrashDump_<yyyymmdd>-<hhmmss>_<pid>_<fingerprint>.dmp`` (in UTC),
+/// so that a later crash never overwrites an earlier one's dump or sidecar.
+#define MINIDUMP_FILE_PREFIX "MayaCustomCrashDump"
+#define MINIDUMP_FILE_PATTERN MINIDUMP_FILE_PREFIX "_*.dmp"
 #define DEFAULT_TEMP_DIRECTORY "C:/temp"
 #define TEMP_ENV_VAR_NAME "TEMP"
 
@@ -17,11 +20,12 @@
 #ifndef __cplusplus
 #include <stdbool.h>
 #endif
+#include <stdint.h>
 
 #define MAYA_DAG_PATH_MAX_NAME_LEN 512
 #define MAYA_DG_NODE_MAX_NAME_LEN 512
 
-#pragma pack(1)
+#pragma pack(push, 1)
 /// Information about the current Maya session when a crash occurred.
 typedef struct MayaCrashDumpInfo
 {
@@ -36,4 +40,710 @@ typedef struct MayaCrashDumpInfo
 } MayaCrashDumpInfo;
 
 
+#define MAYA_MEMORY_SAMPLES_STREAM_TYPE LastReservedStream + 2
+
+#define MAYA_MEMORY_SAMPLE_RING_CAPACITY 512
+
+/// A single sample of the memory pressure of the Maya process and the machine it is running on.
+typedef struct MayaMemorySample
+{
+    uint64_t timestamp; // NOTE: (sonictk) In ``QueryPerformanceCounter`` ticks.
+    uint64_t workingSetBytes;
+    uint64_t peakWorkingSetBytes;
+    uint64_t privateCommitBytes;
+    uint64_t heapAllocatedBytes; // NOTE: (sonictk) Only refreshed every few samples as well, since summarising a heap takes its lock.
+    uint64_t heapCommittedBytes;
+    uint64_t mappedBytes; // NOTE: (sonictk) Only refreshed every few samples, since walking the address space isn't cheap.
+    uint64_t imageBytes;
+    uint64_t systemAvailPhysBytes;
+    uint64_t systemCommitTotalBytes;
+    uint64_t systemCommitLimitBytes;
+    uint32_t pageFaultCount;
+    uint32_t numHeaps;
+} MayaMemorySample;
+
+/// Fixed-size ring of the most recent memory samples. ``numSamplesWritten`` is monotonic;
+/// the newest sample lives at index ``(numSamplesWritten - 1) % MAYA_MEMORY_SAMPLE_RING_CAPACITY``.
+typedef struct MayaMemorySampleRing
+{
+    uint64_t timerFrequency;
+    uint32_t intervalMs;
+    uint32_t numSamplesWritten;
+    MayaMemorySample samples[MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+} MayaMemorySampleRing;
+
+
+#define MAYA_SNAPSHOT_INFO_STREAM_TYPE LastReservedStream + 3
+
+typedef enum MayaSnapshotReason
+{
+    MayaSnapshotReason_Unknown = 0,
+    MayaSnapshotReason_MainThreadHang,
+    MayaSnapshotReason_UserRequested
+} MayaSnapshotReason;
+
+/// Written into dumps of a live process (i.e. ones that were not caused by a crash) to describe
+/// why and how the snapshot was taken.
+typedef struct MayaSnapshotInfo
+{
+    uint32_t reason; // NOTE: (sonictk) One of ``MayaSnapshotReason``.
+    uint32_t mainThreadId;
+    uint64_t stallMs;
+    uint64_t heartbeat;
+    uint64_t pauseMicroseconds; // NOTE: (sonictk) How long the process was paused for while the snapshot was captured.
+} MayaSnapshotInfo;
+
+
+#define MAYA_PROFILER_STACKS_STREAM_TYPE LastReservedStream + 4
+
+#define MAYA_PROFILER_MAX_FRAMES 24
+#define MAYA_PROFILER_MAX_UNIQUE_STACKS 1024
+#define MAYA_PROFILER_SAMPLE_RING_CAPACITY 4096
+
+/// A unique call stack of the main thread seen by the sampling profiler, along with how many
+/// times it was sampled. Frames are stored innermost first, as absolute addresses.
+typedef struct MayaProfilerStack
+{
+    uint64_t hash;
+    uint32_t count;
+    uint32_t numFrames;
+    uint64_t frames[MAYA_PROFILER_MAX_FRAMES];
+} MayaProfilerStack;
+
+/// A single sample taken by the profiler; refers to an entry in the stack table.
+typedef struct MayaProfilerSample
+{
+    uint64_t timestamp; // NOTE: (sonictk) In ``QueryPerformanceCounter`` ticks.
+    uint32_t stackIdx;
+    uint32_t reserved;
+} MayaProfilerSample;
+
+/// Everything recorded by the sampling profiler. ``numSamplesWritten`` is monotonic; the newest
+/// sample lives at index ``(numSamplesWritten - 1) % MAYA_PROFILER_SAMPLE_RING_CAPACITY``.
+typedef struct MayaProfilerData
+{
+    uint64_t timerFrequency;
+    uint32_t sampleRateHz;
+    uint32_t mainThreadId;
+    uint32_t numSamplesWritten;
+    uint32_t numUniqueStacks;
+    uint32_t numDroppedSamples; // NOTE: (sonictk) Samples whose stack did not fit into the stack table anymore.
+    uint32_t reserved;
+    MayaProfilerSample samples[MAYA_PROFILER_SAMPLE_RING_CAPACITY];
+    MayaProfilerStack stacks[MAYA_PROFILER_MAX_UNIQUE_STACKS];
+} MayaProfilerData;
+
+
+#define MAYA_CRASH_REPEAT_RECORD_MAGIC 0x5045524D // NOTE: (sonictk) ``MREP``.
+#define MAYA_CRASH_REPEAT_RECORD_FILE_PREFIX "MayaCustomCrashRepeat"
+
+/// Written in place of a full dump when a crash with the same fingerprint has already been
+/// dumped recently. Overwritten each time the crash repeats.
+typedef struct MayaCrashRepeatRecord
+{
+    uint32_t magic;
+    uint32_t exceptionCode;
+    uint64_t fingerprint;
+    uint64_t faultModuleId; // NOTE: (sonictk) The faulting module's link timestamp in the upper 32 bits and its image size in the lower 32 bits.
+    uint64_t faultModuleOffset;
+    uint64_t firstSeenTime; // NOTE: (sonictk) As a ``FILETIME``; this is when the last full dump was written.
+    uint64_t lastSeenTime;
+    uint32_t count; // NOTE: (sonictk) Number of times this crash was seen since ``firstSeenTime``, including the one that was dumped.
+    uint32_t lastProcessId;
+} MayaCrashRepeatRecord;
+
+
+#define MAYA_CRASH_SIDECAR_MAGIC 0x5243534D // NOTE: (sonictk) ``MSCR``.
+#define MAYA_CRASH_SIDECAR_VERSION 1
+#define MAYA_CRASH_SIDECAR_FILE_EXTENSION ".sidecar"
+/// NOTE: (sonictk) Sidecars are named after their dump, and so are unique per crash as well.
+#define MAYA_CRASH_SIDECAR_FILE_PATTERN MINIDUMP_FILE_PATTERN MAYA_CRASH_SIDECAR_FILE_EXTENSION
+
+#define MAYA_CRASH_SIDECAR_MAX_FRAMES 32
+#define MAYA_CRASH_SIDECAR_MAX_MODULES 16
+#define MAYA_CRASH_SIDECAR_NO_MODULE 0xFFFF
+#define MAYA_CRASH_SIDECAR_MODULE_NAME_LEN 36
+#define MAYA_CRASH_SIDECAR_SCENE_NAME_LEN 128
+#define MAYA_CRASH_SIDECAR_MEL_CMD_LEN 128
+#define MAYA_CRASH_SIDECAR_TIMING_INFO_LEN 32
+
+/// A code address as an offset into one of the modules in ``MayaCrashSidecar::modules``. If
+/// ``moduleIdx`` is ``MAYA_CRASH_SIDECAR_NO_MODULE``, the address did not fall within any module
+/// and ``offset`` holds its lower 32 bits.
+typedef struct MayaCrashSidecarFrame
+{
+    uint32_t offset;
+    uint16_t moduleIdx;
+    uint16_t reserved;
+} MayaCrashSidecarFrame;
+
+/// Identifies the exact build of a module, so that symbols can be fetched for it from a symbol
+/// server without the dump.
+typedef struct MayaCrashSidecarModule
+{
+    uint32_t timeDateStamp;
+    uint32_t sizeOfImage;
+    uint8_t pdbGuid[16];
+    uint32_t pdbAge;
+    char pdbName[MAYA_CRASH_SIDECAR_MODULE_NAME_LEN];
+} MayaCrashSidecarModule;
+
+/// Written next to each crash dump as ``<dump file path>.sidecar``, so that crashes can be triaged
+/// without having to open the dump and unwind its stacks. All fields are little-endian and the
+/// layout is fixed; the most useful fields for a first pass come first.
+typedef struct MayaCrashSidecar
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fingerprint; // NOTE: (sonictk) The same fingerprint that is used to detect crash loops.
+    uint64_t timestamp; // NOTE: (sonictk) As a ``FILETIME``.
+    uint32_t processId;
+    uint32_t exceptionCode;
+    MayaCrashSidecarFrame exceptionAddress;
+    uint32_t numFrames;
+    uint32_t numModules;
+    int32_t verAPI;
+    uint32_t reserved;
+    MayaCrashSidecarFrame frames[MAYA_CRASH_SIDECAR_MAX_FRAMES]; // NOTE: (sonictk) Innermost first.
+    char sceneName[MAYA_CRASH_SIDECAR_SCENE_NAME_LEN]; // NOTE: (sonictk) The tail end of the path, if it is too long.
+    char lastMELCmd[MAYA_CRASH_SIDECAR_MEL_CMD_LEN];
+    char timingInfo[MAYA_CRASH_SIDECAR_TIMING_INFO_LEN];
+    MayaCrashSidecarModule modules[MAYA_CRASH_SIDECAR_MAX_MODULES];
+} MayaCrashSidecar;
+
+
+/// The body of the uploader's ``POST batch`` requests is a sequence of these, each followed by
+/// the contents of a small file. See ``maya_crash_uploader_main.c`` for the rest of the protocol.
+#define MAYA_UPLOAD_BATCH_RECORD_MAGIC 0x5242554D // NOTE: (sonictk) ``MUBR``.
+#define MAYA_UPLOAD_BATCH_RECORD_NAME_LEN 116
+
+typedef enum MayaUploadBatchRecordType
+{
+    MayaUploadBatchRecordType_Unknown = 0,
+    MayaUploadBatchRecordType_Sidecar,
+    MayaUploadBatchRecordType_RepeatRecord
+} MayaUploadBatchRecordType;
+
+typedef struct MayaUploadBatchRecordHeader
+{
+    uint32_t magic;
+    uint32_t type; // NOTE: (sonictk) One of ``MayaUploadBatchRecordType``.
+    uint32_t size;
+    char name[MAYA_UPLOAD_BATCH_RECORD_NAME_LEN];
+} MayaUploadBatchRecordHeader;
+
+
+#define MAYA_LIVE_BREADCRUMBS_MAPPING_NAME_PREFIX "Local\\MayaCrashBreadcrumbs_"
+#define MAYA_LIVE_BREADCRUMBS_MAGIC 0x424C4D4D // NOTE: (sonictk) ``MMLB``.
+#define MAYA_LIVE_BREADCRUMBS_VERSION 1
+#define MAYA_LIVE_BREADCRUMBS_SCENE_PATH_LEN 260
+#define MAYA_LIVE_BREADCRUMBS_TIMING_INFO_LEN 32
+#define MAYA_LIVE_BREADCRUMBS_MEL_CMD_LEN 1024
+
+/// A copy of the breadcrumbs of a running Maya session, published in the named shared memory
+/// segment ``MAYA_LIVE_BREADCRUMBS_MAPPING_NAME_PREFIX<pid>`` so that it can be monitored live.
+///
+/// This is protected by a sequence lock: ``sequence`` is odd while the session is in the middle
+/// of updating it. Readers should read ``sequence``, copy the struct out, and then read ``sequence``
+/// again, retrying if it was odd or changed in the meantime. The session never waits on readers.
+typedef struct MayaLiveBreadcrumbs
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence;
+    uint32_t processId;
+    uint64_t lastUpdateTime; // NOTE: (sonictk) As a ``FILETIME``.
+    char scenePath[MAYA_LIVE_BREADCRUMBS_SCENE_PATH_LEN];
+    char timingInfo[MAYA_LIVE_BREADCRUMBS_TIMING_INFO_LEN];
+    char lastMELCmd[MAYA_LIVE_BREADCRUMBS_MEL_CMD_LEN];
+    char lastDagParentName[MAYA_DAG_PATH_MAX_NAME_LEN];
+    char lastDagChildName[MAYA_DAG_PATH_MAX_NAME_LEN];
+    char lastDGNodeAddedName[MAYA_DG_NODE_MAX_NAME_LEN];
+} MayaLiveBreadcrumbs;
+
+
+#define MAYA_BREADCRUMB_EVENTS_STREAM_TYPE LastReservedStream + 5
+
+#define MAYA_BREADCRUMB_EVENTS_MAGIC 0x5645424D // NOTE: (sonictk) ``MBEV``.
+#define MAYA_BREADCRUMB_EVENTS_VERSION 1
+#define MAYA_BREADCRUMB_EVENT_NAME_LEN 56
+
+typedef enum MayaBreadcrumbEventType
+{
+    MayaBreadcrumbEventType_None = 0,
+    MayaBreadcrumbEventType_MELProcEntry,
+    MayaBreadcrumbEventType_MELProcExit,
+    MayaBreadcrumbEventType_TimeChange,
+    MayaBreadcrumbEventType_DagChange,
+    MayaBreadcrumbEventType_NodeAdded,
+    MayaBreadcrumbEventType_SceneOpened
+} MayaBreadcrumbEventType;
+
+/// A single timestamped breadcrumb. ``id`` and ``arg`` depend on the type of event: for MEL
+/// events, they are the procedure ID (which matches entries to exits) and whether it was a
+/// procedure or a command; for DAG changes, ``arg`` is the ``MDagMessage::DagMessage``. For DAG
+/// changes and nodes added, ``id`` is the ID of the full name in the ``MayaNameTable``.
+typedef struct MayaBreadcrumbEvent
+{
+    uint64_t timestamp; // NOTE: (sonictk) In ``QueryPerformanceCounter`` ticks; ``0`` if the event was being written when the dump was taken.
+    uint32_t threadId;
+    uint16_t type; // NOTE: (sonictk) One of ``MayaBreadcrumbEventType``.
+    uint16_t reserved;
+    uint32_t id;
+    uint32_t arg;
+    char name[MAYA_BREADCRUMB_EVENT_NAME_LEN]; // NOTE: (sonictk) Truncated if too long.
+} MayaBreadcrumbEvent;
+
+/// The breadcrumb event ring, as written into the dump. It is immediately followed by
+/// ``capacity`` events. ``numEventsWritten`` is monotonic; event ``i`` lives at index
+/// ``i % capacity``, so the oldest event still around is ``numEventsWritten - capacity``.
+typedef struct MayaBreadcrumbEventRing
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity; // NOTE: (sonictk) Always a power of two.
+    uint32_t processId;
+    uint64_t numEventsWritten;
+    uint64_t timerFrequency;
+    uint64_t startTimestamp; // NOTE: (sonictk) In ``QueryPerformanceCounter`` ticks, when recording started.
+    uint64_t startTime; // NOTE: (sonictk) As a ``FILETIME``, at the same moment as ``startTimestamp``.
+} MayaBreadcrumbEventRing;
+
+
+#define MAYA_FLIGHT_RECORDER_STREAM_TYPE LastReservedStream + 6
+
+#define MAYA_FLIGHT_RECORDER_MAX_THREADS 128
+#define MAYA_FLIGHT_RECORDER_RING_CAPACITY 256 // NOTE: (sonictk) Must be a power of two.
+#define MAYA_FLIGHT_RECORDER_EVENT_NAME_LEN 16
+
+typedef enum MayaFlightRecorderPhase
+{
+    MayaFlightRecorderPhase_Begin = 0,
+    MayaFlightRecorderPhase_End
+} MayaFlightRecorderPhase;
+
+/// A single begin/end event recorded by the flight recorder.
+typedef struct MayaFlightRecorderEvent
+{
+    uint64_t timestamp; // NOTE: (sonictk) In ``QueryPerformanceCounter`` ticks.
+    uint32_t nameId; // NOTE: (sonictk) A hash of the full name of the node (or whatever else is being recorded).
+    uint16_t category;
+    uint8_t phase; // NOTE: (sonictk) One of ``MayaFlightRecorderPhase``.
+    uint8_t reserved;
+    char name[MAYA_FLIGHT_RECORDER_EVENT_NAME_LEN]; // NOTE: (sonictk) The tail end of the name, if it is too long.
+} MayaFlightRecorderEvent;
+
+/// The events recorded on a single thread. Only that thread ever writes to it. ``numEventsWritten``
+/// is monotonic; the newest event lives at index ``(numEventsWritten - 1) % MAYA_FLIGHT_RECORDER_RING_CAPACITY``.
+typedef struct MayaFlightRecorderRing
+{
+    uint32_t threadId; // NOTE: (sonictk) ``0`` if no thread has claimed this ring yet.
+    uint32_t reserved;
+    uint64_t numEventsWritten;
+    MayaFlightRecorderEvent events[MAYA_FLIGHT_RECORDER_RING_CAPACITY];
+} MayaFlightRecorderRing;
+
+typedef struct MayaFlightRecorderData
+{
+    uint64_t timerFrequency;
+    uint32_t numRings;
+    uint32_t numDroppedThreads; // NOTE: (sonictk) Threads that tried to record events after all the rings were claimed.
+    MayaFlightRecorderRing rings[MAYA_FLIGHT_RECORDER_MAX_THREADS];
+} MayaFlightRecorderData;
+
+
+#define MAYA_PLUGIN_LOAD_TIMES_STREAM_TYPE LastReservedStream + 7
+
+#define MAYA_PLUGIN_LOAD_TIMES_MAX_ENTRIES 256
+#define MAYA_PLUGIN_LOAD_TIME_NAME_LEN 64
+
+typedef enum MayaPluginLoadTimeKind
+{
+    MayaPluginLoadTimeKind_Load = 0,
+    MayaPluginLoadTimeKind_Unload,
+    MayaPluginLoadTimeKind_Self // NOTE: (sonictk) A phase of our own ``initializePlugin``.
+} MayaPluginLoadTimeKind;
+
+typedef enum MayaPluginLoadTimeStatus
+{
+    MayaPluginLoadTimeStatus_InProgress = 0, // NOTE: (sonictk) Also what a load that failed stays at.
+    MayaPluginLoadTimeStatus_Done
+} MayaPluginLoadTimeStatus;
+
+/// How long a single plugin took to load or unload, and how much memory it took (or gave back)
+/// while doing so. Plugins loaded from within another plugin's ``initializePlugin`` are counted
+/// in the totals of that plugin as well.
+typedef struct MayaPluginLoadTime
+{
+    uint64_t startTimestamp; // NOTE: (sonictk) In ``QueryPerformanceCounter`` ticks.
+    uint64_t durationTicks; // NOTE: (sonictk) ``0`` while still in progress.
+    int64_t privateBytesDelta;
+    int64_t workingSetDelta;
+    uint32_t order; // NOTE: (sonictk) The order in which the loads/unloads started.
+    uint8_t kind; // NOTE: (sonictk) One of ``MayaPluginLoadTimeKind``.
+    uint8_t status; // NOTE: (sonictk) One of ``MayaPluginLoadTimeStatus``.
+    uint16_t depth; // NOTE: (sonictk) How many other loads/unloads this one is nested in.
+    char name[MAYA_PLUGIN_LOAD_TIME_NAME_LEN];
+} MayaPluginLoadTime;
+
+typedef struct MayaPluginLoadTimes
+{
+    uint64_t timerFrequency;
+    uint32_t numEntries;
+    uint32_t numDroppedEntries;
+    MayaPluginLoadTime entries[MAYA_PLUGIN_LOAD_TIMES_MAX_ENTRIES];
+} MayaPluginLoadTimes;
+
+
+#define MAYA_SYMBOL_SERVER_PIPE_NAME "\\\\.\\pipe\\MayaSymbolServer"
+#define MAYA_SYMBOL_SERVER_MAGIC 0x5359534D // NOTE: (sonictk) ``MSYS``.
+#define MAYA_SYMBOL_SERVER_VERSION 1
+#define MAYA_SYMBOL_SERVER_MAX_MODULES MAYA_CRASH_SIDECAR_MAX_MODULES
+#define MAYA_SYMBOL_SERVER_MAX_LOOKUPS 256
+#define MAYA_SYMBOL_SERVER_SYMBOL_NAME_LEN 120
+
+typedef enum MayaSymbolServerStatus
+{
+    MayaSymbolServerStatus_Found = 0,
+    MayaSymbolServerStatus_NoModule, // NOTE: (sonictk) The address was not in any module.
+    MayaSymbolServerStatus_NoSymbols, // NOTE: (sonictk) The symbol store has no symbols for the module.
+    MayaSymbolServerStatus_NotFound // NOTE: (sonictk) No symbol covers the address.
+} MayaSymbolServerStatus;
+
+/// A batch of addresses to look up, as sent to ``maya_symbol_server.exe`` in a single message.
+/// The modules are identified the same way as in a sidecar, so that the frames of a sidecar can be
+/// sent as they are.
+typedef struct MayaSymbolServerRequest
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numModules;
+    uint32_t numLookups;
+    MayaCrashSidecarModule modules[MAYA_SYMBOL_SERVER_MAX_MODULES];
+    MayaCrashSidecarFrame lookups[MAYA_SYMBOL_SERVER_MAX_LOOKUPS];
+} MayaSymbolServerRequest;
+
+typedef struct MayaSymbolServerResult
+{
+    uint32_t status; // NOTE: (sonictk) One of ``MayaSymbolServerStatus``.
+    uint32_t displacement; // NOTE: (sonictk) Offset of the address from the start of the symbol.
+    char name[MAYA_SYMBOL_SERVER_SYMBOL_NAME_LEN];
+} MayaSymbolServerResult;
+
+/// Running totals of the server, sent back with every response.
+typedef struct MayaSymbolServerStats
+{
+    uint64_t numRequests;
+    uint64_t numLookups;
+    uint64_t numCacheHits;
+    uint64_t numCacheMisses;
+    uint64_t numEvictions;
+    uint64_t numCachedTables;
+    uint64_t numCachedBytes;
+    uint64_t totalRequestMicroseconds;
+} MayaSymbolServerStats;
+
+/// The reply to a ``MayaSymbolServerRequest``, with one result per lookup in the same order. Only
+/// the first ``numResults`` results are sent.
+typedef struct MayaSymbolServerResponse
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numResults;
+    uint32_t reserved;
+    MayaSymbolServerStats stats;
+    MayaSymbolServerResult results[MAYA_SYMBOL_SERVER_MAX_LOOKUPS];
+} MayaSymbolServerResponse;
+
+
+#define MAYA_NAME_TABLE_STREAM_TYPE LastReservedStream + 8
+
+#define MAYA_NAME_TABLE_MAGIC 0x4D414E4D // NOTE: (sonictk) ``MNAM``.
+#define MAYA_NAME_TABLE_VERSION 3
+#define MAYA_NAME_TABLE_CAPACITY 4096 // NOTE: (sonictk) Must be a power of two.
+#define MAYA_NAME_TABLE_INDEX_CAPACITY (MAYA_NAME_TABLE_CAPACITY * 2)
+#define MAYA_NAME_TABLE_NAME_LEN 128 // NOTE: (sonictk) The whole table goes into every dump, so long names only keep their tail end.
+#define MAYA_NAME_TABLE_INVALID_ID 0
+
+/// A single interned name. Name ``id`` lives in entry ``id % MAYA_NAME_TABLE_CAPACITY`` until it
+/// is evicted by the name that comes ``MAYA_NAME_TABLE_CAPACITY`` IDs after it.
+typedef struct MayaNameTableEntry
+{
+    uint32_t id; // NOTE: (sonictk) ``MAYA_NAME_TABLE_INVALID_ID`` if empty, or being written.
+    uint32_t hash;
+    uint32_t len;
+    char name[MAYA_NAME_TABLE_NAME_LEN]; // NOTE: (sonictk) The tail end of the name, if it is too long.
+} MayaNameTableEntry;
+
+/// The DAG paths and DG node names seen by the breadcrumbs, each stored once. The breadcrumbs
+/// refer to them by ID.
+typedef struct MayaNameTable
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t nextId; // NOTE: (sonictk) The last ID handed out; IDs are handed out in order.
+    uint64_t numInserts; // NOTE: (sonictk) Everything past the first ``capacity`` inserts evicted an older name.
+    uint32_t index[MAYA_NAME_TABLE_INDEX_CAPACITY]; // NOTE: (sonictk) Open addressing on the hash of the names; holds their IDs.
+    MayaNameTableEntry entries[MAYA_NAME_TABLE_CAPACITY];
+} MayaNameTable;
+
+
+#define MAYA_SCENE_STATS_STREAM_TYPE LastReservedStream + 9
+
+#define MAYA_SCENE_STATS_MAGIC 0x5453534D // NOTE: (sonictk) ``MSST``.
+#define MAYA_SCENE_STATS_VERSION 1
+#define MAYA_SCENE_STATS_MAX_TYPES 1024 // NOTE: (sonictk) Must be a power of two.
+#define MAYA_SCENE_STATS_TYPE_NAME_LEN 56
+
+/// The aggregate totals kept alongside the per-type counts. A node can count towards several of
+/// them (e.g. a mesh is also a shape and a DAG node).
+typedef enum MayaSceneStatsTotal
+{
+    MayaSceneStatsTotal_Nodes = 0,
+    MayaSceneStatsTotal_DagNodes,
+    MayaSceneStatsTotal_Transforms,
+    MayaSceneStatsTotal_Shapes,
+    MayaSceneStatsTotal_Meshes,
+    MayaSceneStatsTotal_Joints,
+    MayaSceneStatsTotal_Cameras,
+    MayaSceneStatsTotal_Lights,
+    MayaSceneStatsTotal_References,
+    MayaSceneStatsTotal_Count
+} MayaSceneStatsTotal;
+
+/// How many nodes of a single type are in the scene.
+typedef struct MayaSceneStatsType
+{
+    uint32_t typeId; // NOTE: (sonictk) The ``MTypeId`` of the node type; ``0`` if the slot is empty.
+    int32_t count;
+    char typeName[MAYA_SCENE_STATS_TYPE_NAME_LEN]; // NOTE: (sonictk) Filled in just after ``typeId``, so it may be empty.
+} MayaSceneStatsType;
+
+/// The number of nodes in the scene, by type. Kept up to date as nodes are added and removed
+/// (including by undo/redo), and recounted from scratch once a scene has been opened or created.
+typedef struct MayaSceneStats
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t maxTypes;
+    uint32_t isLoading; // NOTE: (sonictk) Non-zero while a scene is being opened; the counts are only of the nodes loaded so far.
+    uint32_t numTypes;
+    int32_t numUntypedNodes; // NOTE: (sonictk) Nodes whose type did not fit in ``types``. They still count towards the totals.
+    uint64_t numNodesAdded;
+    uint64_t numNodesRemoved;
+    uint64_t numRecounts;
+    int32_t totals[MayaSceneStatsTotal_Count];
+    uint32_t reserved;
+    MayaSceneStatsType types[MAYA_SCENE_STATS_MAX_TYPES]; // NOTE: (sonictk) Open addressing on the type ID.
+} MayaSceneStats;
+
+
+#define MAYA_SELF_PROFILE_STREAM_TYPE LastReservedStream + 10
+
+#define MAYA_SELF_PROFILE_MAGIC 0x4650534D // NOTE: (sonictk) ``MSPF``.
+#define MAYA_SELF_PROFILE_VERSION 1
+#define MAYA_SELF_PROFILE_MAX_THREADS 64
+
+/// The places in the plugin that run on every event in the session, and whose cost is counted.
+typedef enum MayaSelfProfileSite
+{
+    MayaSelfProfileSite_SceneOpen = 0,
+    MayaSelfProfileSite_SceneLoad, // NOTE: (sonictk) The before open/new callbacks, and the recount after a new scene.
+    MayaSelfProfileSite_TimeChange,
+    MayaSelfProfileSite_MELCmd,
+    MayaSelfProfileSite_DagChange,
+    MayaSelfProfileSite_NodeAdded,
+    MayaSelfProfileSite_NodeRemoved,
+    MayaSelfProfileSite_IdleHeartbeat,
+    MayaSelfProfileSite_PluginLoad, // NOTE: (sonictk) The before/after plugin load/unload callbacks.
+    MayaSelfProfileSite_FlightRecorder, // NOTE: (sonictk) ``mayaFlightRecorderBeginEvent``/``mayaFlightRecorderEndEvent``, called by node plugins.
+    MayaSelfProfileSite_Count
+} MayaSelfProfileSite;
+
+/// The cost of one of the sites, on one thread.
+typedef struct MayaSelfProfileCounter
+{
+    uint64_t numCalls;
+    uint64_t totalCycles; // NOTE: (sonictk) In ``__rdtsc`` ticks.
+    uint64_t maxCycles;
+    uint64_t numBytesCopied; // NOTE: (sonictk) Into the breadcrumbs, the name table and such.
+} MayaSelfProfileCounter;
+
+/// The counters of a single thread. They are only ever written to by that thread, and summed up
+/// across threads when read.
+typedef struct MayaSelfProfileThread
+{
+    uint32_t threadId; // NOTE: (sonictk) ``0`` if the slot is unused.
+    uint32_t reserved;
+    MayaSelfProfileCounter counters[MayaSelfProfileSite_Count];
+} MayaSelfProfileThread;
+
+typedef struct MayaSelfProfile
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numThreads;
+    uint32_t numDroppedThreads; // NOTE: (sonictk) Threads that found no slot left. Their calls are not counted.
+    uint64_t startCycles; // NOTE: (sonictk) ``__rdtsc`` and ``QueryPerformanceCounter`` when counting started...
+    uint64_t startTimestamp;
+    uint64_t endCycles; // NOTE: (sonictk) ...and when the stream was last filled in, to work out the rate of ``__rdtsc``.
+    uint64_t endTimestamp;
+    uint64_t timerFrequency;
+    MayaSelfProfileThread threads[MAYA_SELF_PROFILE_MAX_THREADS];
+} MayaSelfProfile;
+
+
+/**
+ * Every user stream of our own, in the order that they are written and printed. Each entry is
+ * ``X(name, streamType, layout, sizing, dumps)``:
+ *
+ * - ``name``: the writer fills the stream in with ``getMaya<name>Stream`` and the dump reader
+ *   prints it with ``print<name>Stream``.
+ * - ``layout``: the struct that the stream is written as.
+ * - ``sizing``: ``Fixed`` if the stream is exactly ``sizeof(layout)``, or ``Variable`` if
+ *   ``layout`` is only a header that is followed by more data.
+ * - ``dumps``: ``Every`` if the stream is written into every dump, or ``Snapshot`` if only into
+ *   snapshot dumps of the live process.
+ *
+ * NOTE: (sonictk) This is the only place that a stream needs adding to. The writer's table of
+ * streams, the readers' size checks and the dump reader's printing are all expanded from here,
+ * so a stream that is written but can't be read (or the other way round) fails to compile
+ * instead of turning up as a size mismatch in someone's crash dump. The comment streams are not
+ * in here, since they are plain text and there are several of the same type.
+ */
+#define MAYA_DUMP_USER_STREAMS(X) \
+    X(SnapshotInfo,     MAYA_SNAPSHOT_INFO_STREAM_TYPE,     MayaSnapshotInfo,        Fixed,    Snapshot) \
+    X(CrashInfo,        MAYA_CRASH_INFO_STREAM_TYPE,        MayaCrashDumpInfo,       Fixed,    Every) \
+    X(MemorySamples,    MAYA_MEMORY_SAMPLES_STREAM_TYPE,    MayaMemorySampleRing,    Fixed,    Every) \
+    X(ProfilerStacks,   MAYA_PROFILER_STACKS_STREAM_TYPE,   MayaProfilerData,        Fixed,    Every) \
+    X(BreadcrumbEvents, MAYA_BREADCRUMB_EVENTS_STREAM_TYPE, MayaBreadcrumbEventRing, Variable, Every) \
+    X(FlightRecorder,   MAYA_FLIGHT_RECORDER_STREAM_TYPE,   MayaFlightRecorderData,  Fixed,    Every) \
+    X(PluginLoadTimes,  MAYA_PLUGIN_LOAD_TIMES_STREAM_TYPE, MayaPluginLoadTimes,     Fixed,    Every) \
+    X(NameTable,        MAYA_NAME_TABLE_STREAM_TYPE,        MayaNameTable,           Fixed,    Every) \
+    X(SceneStats,       MAYA_SCENE_STATS_STREAM_TYPE,       MayaSceneStats,          Fixed,    Every) \
+    X(SelfProfile,      MAYA_SELF_PROFILE_STREAM_TYPE,      MayaSelfProfile,         Fixed,    Every)
+
+#define MAYA_DUMP_USER_STREAM_IS_VARIABLE_Fixed false
+#define MAYA_DUMP_USER_STREAM_IS_VARIABLE_Variable true
+#define MAYA_DUMP_USER_STREAM_IS_SNAPSHOT_ONLY_Every false
+#define MAYA_DUMP_USER_STREAM_IS_SNAPSHOT_ONLY_Snapshot true
+
+typedef enum MayaDumpUserStream
+{
+#define MAYA_DUMP_USER_STREAM_ENUM(name, streamType, layout, sizing, dumps) MayaDumpUserStream_##name,
+    MAYA_DUMP_USER_STREAMS(MAYA_DUMP_USER_STREAM_ENUM)
+#undef MAYA_DUMP_USER_STREAM_ENUM
+    MayaDumpUserStream_Count
+} MayaDumpUserStream;
+
+typedef struct MayaDumpUserStreamInfo
+{
+    const char *name;
+    ULONG streamType;
+    ULONG size; // NOTE: (sonictk) The minimum size, for streams of variable size.
+    bool isVariable;
+    bool isSnapshotOnly;
+} MayaDumpUserStreamInfo;
+
+static const MayaDumpUserStreamInfo kMayaDumpUserStreams[MayaDumpUserStream_Count] = {
+#define MAYA_DUMP_USER_STREAM_INFO(name, streamType, layout, sizing, dumps) \
+    {#name, (ULONG)(streamType), (ULONG)sizeof(layout), MAYA_DUMP_USER_STREAM_IS_VARIABLE_##sizing, MAYA_DUMP_USER_STREAM_IS_SNAPSHOT_ONLY_##dumps},
+    MAYA_DUMP_USER_STREAMS(MAYA_DUMP_USER_STREAM_INFO)
+#undef MAYA_DUMP_USER_STREAM_INFO
+};
+
+
+/**
+ * Looks up which of our streams a stream type is.
+ *
+ * @param streamType    The type of the stream, as found in the stream directory of the dump.
+ *
+ * @return              One of ``MayaDumpUserStream``, or ``MayaDumpUserStream_Count`` if it is
+ *                      not one of ours.
+ */
+static __inline MayaDumpUserStream findMayaDumpUserStream(ULONG streamType)
+{
+    // NOTE: (sonictk) A switch rather than a search, so that two streams registered with the same
+    // type are a compile error (duplicate case values).
+    switch (streamType) {
+#define MAYA_DUMP_USER_STREAM_CASE(name, streamType, layout, sizing, dumps) \
+    case (streamType): return MayaDumpUserStream_##name;
+    MAYA_DUMP_USER_STREAMS(MAYA_DUMP_USER_STREAM_CASE)
+#undef MAYA_DUMP_USER_STREAM_CASE
+    default:
+        return MayaDumpUserStream_Count;
+    }
+}
+
+
+/**
+ * Checks that a stream is the size that its layout says it should be.
+ *
+ * @param stream        One of ``MayaDumpUserStream``.
+ * @param size          The size of the stream, as found in the stream directory of the dump.
+ *
+ * @return              ``true`` if the stream can be read as its layout.
+ */
+static __inline bool isMayaDumpUserStreamSizeValid(MayaDumpUserStream stream, ULONG size)
+{
+    if (stream < 0 || stream >= MayaDumpUserStream_Count) {
+        return false;
+    }
+    const MayaDumpUserStreamInfo *info = &kMayaDumpUserStreams[stream];
+
+    return info->isVariable ? size >= info->size : size == info->size;
+}
+
+
+/**
+ * Finds the most recently written crash dump in the given directory, for the tools that open
+ * "the" crash dump when they are not given one. This only uses the Win32 string functions,
+ * since not everything that includes this header has the CRT's headers included first.
+ *
+ * @param dirPath           The directory to look in.
+ * @param dumpFilePath      Storage for the path of the dump.
+ * @param lenDumpFilePath   The size of ``dumpFilePath``, in bytes.
+ *
+ * @return                  ``true`` if a crash dump was found, ``false`` otherwise.
+ */
+static __inline bool findNewestMayaCrashDump(const char *dirPath, char *dumpFilePath, DWORD lenDumpFilePath)
+{
+    const int lenDirPath = lstrlenA(dirPath);
+    char pattern[MAX_PATH];
+    if (lenDirPath + 1 + lstrlenA(MINIDUMP_FILE_PATTERN) >= MAX_PATH) {
+        return false;
+    }
+    lstrcpyA(pattern, dirPath);
+    lstrcatA(pattern, "\\");
+    lstrcatA(pattern, MINIDUMP_FILE_PATTERN);
+
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA(pattern, &findData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    FILETIME newestWriteTime = {0};
+    bool found = false;
+    do {
+        if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0
+            || lenDirPath + 1 + lstrlenA(findData.cFileName) >= (int)lenDumpFilePath
+            || (found && CompareFileTime(&findData.ftLastWriteTime, &newestWriteTime) <= 0)) {
+            continue;
+        }
+        newestWriteTime = findData.ftLastWriteTime;
+        lstrcpyA(dumpFilePath, dirPath);
+        lstrcatA(dumpFilePath, "\\");
+        lstrcatA(dumpFilePath, findData.cFileName);
+        found = true;
+    } while (FindNextFileA(hFind, &findData));
+    FindClose(hFind);
+
+    return found;
+}
+
+#pragma pack(pop)
+
+
 #endif /* COMMON_H */
@@ -0,0 +1,251 @@
+/**
+ * @file   maya_breadcrumb_monitor_main.c
+ * @brief  A reference monitor that watches the breadcrumbs published by running Maya sessions
+ *         (scene, frame, last MEL command, last node added) and prints them as they change.
+ *         Reading never blocks or slows down the sessions being monitored.
+ *
+ *         usage: maya_breadcrumb_monitor.exe [-interval <ms>] [-count <num polls>] [pid...]
+ *         If no PIDs are specified, all processes on the machine are scanned for sessions
+ *         periodically.
+ */
+#ifndef _WIN32
+#error "Unsupported platform for compilation."
+#endif // _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Dbghelp.h>
+#include <TlHelp32.h>
+
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAYA_MONITOR_MAX_SESSIONS 256
+#define MAYA_MONITOR_DEFAULT_INTERVAL_MS 100
+#define MAYA_MONITOR_RESCAN_INTERVAL_MS 2000
+
+/// Number of times to retry reading a session that is in the middle of being updated before
+/// giving up until the next poll.
+#define MAYA_MONITOR_MAX_READ_RETRIES 64
+
+
+typedef struct MayaMonitoredSession
+{
+    DWORD processId;
+    HANDLE hMapping;
+    const MayaLiveBreadcrumbs *shared;
+    uint32_t lastSequence;
+} MayaMonitoredSession;
+
+static MayaMonitoredSession gMayaMonitoredSessions[MAYA_MONITOR_MAX_SESSIONS];
+static int gMayaNumMonitoredSessions = 0;
+
+
+/**
+ * Takes a consistent copy of the breadcrumbs of a session, using the sequence lock protocol
+ * described in ``common.h``.
+ *
+ * @param shared        The breadcrumbs published by the session.
+ * @param snapshot      Storage for the copy.
+ *
+ * @return              ``true`` if a consistent copy was taken, ``false`` if the session kept
+ *                      updating its breadcrumbs while we were reading them.
+ */
+bool readMayaLiveBreadcrumbs(const MayaLiveBreadcrumbs *shared, MayaLiveBreadcrumbs *snapshot)
+{
+    const volatile uint32_t *pSequence = (const volatile uint32_t *)&shared->sequence;
+    for (int i=0; i < MAYA_MONITOR_MAX_READ_RETRIES; ++i) {
+        uint32_t sequenceBefore = *pSequence;
+        if ((sequenceBefore & 1) != 0) {
+            YieldProcessor();
+            continue;
+        }
+        MemoryBarrier();
+        memcpy(snapshot, (const void *)shared, sizeof(MayaLiveBreadcrumbs));
+        MemoryBarrier();
+        if (*pSequence == sequenceBefore) {
+            snapshot->sequence = sequenceBefore;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/// Starts monitoring the given process, if it is publishing breadcrumbs and isn't being monitored already.
+void addMayaMonitoredSession(DWORD processId)
+{
+    if (gMayaNumMonitoredSessions >= MAYA_MONITOR_MAX_SESSIONS) {
+        return;
+    }
+    for (int i=0; i < gMayaNumMonitoredSessions; ++i) {
+        if (gMayaMonitoredSessions[i].processId == processId) {
+            return;
+        }
+    }
+
+    char mappingName[MAX_PATH] = {0};
+    snprintf(mappingName, MAX_PATH, "%s%lu", MAYA_LIVE_BREADCRUMBS_MAPPING_NAME_PREFIX, processId);
+    HANDLE hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName);
+    if (hMapping == NULL) {
+        return;
+    }
+    const MayaLiveBreadcrumbs *shared = (const MayaLiveBreadcrumbs *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, sizeof(MayaLiveBreadcrumbs));
+    if (shared == NULL || shared->magic != MAYA_LIVE_BREADCRUMBS_MAGIC || shared->version != MAYA_LIVE_BREADCRUMBS_VERSION) {
+        if (shared != NULL) {
+            UnmapViewOfFile(shared);
+        }
+        CloseHandle(hMapping);
+        return;
+    }
+
+    MayaMonitoredSession *session = &gMayaMonitoredSessions[gMayaNumMonitoredSessions++];
+    session->processId = processId;
+    session->hMapping = hMapping;
+    session->shared = shared;
+    session->lastSequence = 0;
+
+    printf("[%lu] Now monitoring.\n", processId);
+
+    return;
+}
+
+
+/// Stops monitoring sessions whose processes have exited.
+void removeExitedMayaMonitoredSessions()
+{
+    for (int i=0; i < gMayaNumMonitoredSessions;) {
+        MayaMonitoredSession *session = &gMayaMonitoredSessions[i];
+        HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, session->processId);
+        bool exited = hProcess == NULL || WaitForSingleObject(hProcess, 0) == WAIT_OBJECT_0;
+        if (hProcess != NULL) {
+            CloseHandle(hProcess);
+        }
+        if (!exited) {
+            ++i;
+            continue;
+        }
+
+        printf("[%lu] Process exited.\n", session->processId);
+        UnmapViewOfFile(session->shared);
+        CloseHandle(session->hMapping);
+        *session = gMayaMonitoredSessions[--gMayaNumMonitoredSessions];
+    }
+
+    return;
+}
+
+
+/// Looks for sessions publishing breadcrumbs amongst all the processes on the machine.
+void scanForMayaMonitoredSessions()
+{
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    PROCESSENTRY32 procEntry = {0};
+    procEntry.dwSize = sizeof(procEntry);
+    for (BOOL bStat = Process32First(hSnapshot, &procEntry); bStat == TRUE; bStat = Process32Next(hSnapshot, &procEntry)) {
+        addMayaMonitoredSession(procEntry.th32ProcessID);
+    }
+
+    CloseHandle(hSnapshot);
+
+    return;
+}
+
+
+/// Prints the breadcrumbs of every monitored session that have changed since the last poll.
+void pollMayaMonitoredSessions()
+{
+    MayaLiveBreadcrumbs snapshot;
+    for (int i=0; i < gMayaNumMonitoredSessions; ++i) {
+        MayaMonitoredSession *session = &gMayaMonitoredSessions[i];
+        if (*(const volatile uint32_t *)&session->shared->sequence == session->lastSequence) {
+            continue;
+        }
+        if (!readMayaLiveBreadcrumbs(session->shared, &snapshot)) {
+            continue;
+        }
+        session->lastSequence = snapshot.sequence;
+
+        // NOTE: (sonictk) The session could have been writing garbage for all we know.
+        snapshot.scenePath[MAYA_LIVE_BREADCRUMBS_SCENE_PATH_LEN - 1] = '\0';
+        snapshot.timingInfo[MAYA_LIVE_BREADCRUMBS_TIMING_INFO_LEN - 1] = '\0';
+        snapshot.lastMELCmd[MAYA_LIVE_BREADCRUMBS_MEL_CMD_LEN - 1] = '\0';
+        snapshot.lastDGNodeAddedName[MAYA_DG_NODE_MAX_NAME_LEN - 1] = '\0';
+        snapshot.lastDagChildName[MAYA_DAG_PATH_MAX_NAME_LEN - 1] = '\0';
+
+        FILETIME updateFileTime;
+        updateFileTime.dwLowDateTime = (DWORD)snapshot.lastUpdateTime;
+        updateFileTime.dwHighDateTime = (DWORD)(snapshot.lastUpdateTime >> 32);
+        FILETIME localFileTime;
+        FileTimeToLocalFileTime(&updateFileTime, &localFileTime);
+        SYSTEMTIME updateTime = {0};
+        FileTimeToSystemTime(&localFileTime, &updateTime);
+
+        printf("[%lu] %02u:%02u:%02u.%03u scene: %s | %s | last node: %s | last DAG child: %s | last MEL: %.120s\n",
+               session->processId,
+               updateTime.wHour, updateTime.wMinute, updateTime.wSecond, updateTime.wMilliseconds,
+               snapshot.scenePath[0] == '\0' ? "(untitled)" : snapshot.scenePath,
+               snapshot.timingInfo,
+               snapshot.lastDGNodeAddedName,
+               snapshot.lastDagChildName,
+               snapshot.lastMELCmd);
+    }
+
+    return;
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned int intervalMs = MAYA_MONITOR_DEFAULT_INTERVAL_MS;
+    unsigned int numPolls = 0; // NOTE: (sonictk) ``0`` means poll forever.
+    bool scanAllProcesses = true;
+
+    for (int i=1; i < argc; ++i) {
+        if (strcmp(argv[i], "-interval") == 0 && i + 1 < argc) {
+            intervalMs = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-count") == 0 && i + 1 < argc) {
+            numPolls = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else {
+            DWORD processId = (DWORD)strtoul(argv[i], NULL, 10);
+            addMayaMonitoredSession(processId);
+            if (gMayaNumMonitoredSessions == 0 || gMayaMonitoredSessions[gMayaNumMonitoredSessions - 1].processId != processId) {
+                printf("Process %lu is not publishing any breadcrumbs.\n", processId);
+            }
+            scanAllProcesses = false;
+        }
+    }
+
+    if (!scanAllProcesses && gMayaNumMonitoredSessions == 0) {
+        return 1;
+    }
+
+    ULONGLONG lastScanTime = 0;
+    for (unsigned int poll=0; numPolls == 0 || poll < numPolls; ++poll) {
+        ULONGLONG now = GetTickCount64();
+        if (now - lastScanTime >= MAYA_MONITOR_RESCAN_INTERVAL_MS) {
+            removeExitedMayaMonitoredSessions();
+            if (scanAllProcesses) {
+                scanForMayaMonitoredSessions();
+            }
+            lastScanTime = now;
+        }
+
+        pollMayaMonitoredSessions();
+        fflush(stdout);
+
+        Sleep(intervalMs);
+    }
+
+    return 0;
+}
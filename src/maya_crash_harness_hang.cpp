@@ -0,0 +1,277 @@
+/**
+ * @file   maya_crash_harness_hang.cpp
+ * @brief  ``maya_crash_harness.exe -hang <thresholdSecs>`` checks the hang watchdog end to end. A
+ *         child process starts the watchdog, keeps its heartbeat going for a moment, and then
+ *         blocks its main thread for a few times the threshold. The parent checks that:
+ *
+ *         - a snapshot dump of the child turns up once the threshold has passed, and no later than
+ *           the watchdog's polling period after it;
+ *         - the child kept running while the dump was written (another of its threads keeps
+ *           ticking), and was only paused for a few milliseconds to take the snapshot;
+ *         - every breadcrumb stream made it into the dump intact;
+ *         - the child carries on once its main thread is unblocked, and exits normally.
+ */
+
+#define MAYA_CRASH_HARNESS_HANG_FLAG "-hang"
+#define MAYA_CRASH_HARNESS_HANG_CHILD_FLAG "--hangchild"
+
+/// The child's main thread is blocked for this many times the threshold.
+#define MAYA_CRASH_HARNESS_HANG_STALL_MULTIPLE 3
+
+/// How often the child's main thread bumps its heartbeat while it isn't hung, and for how long.
+#define MAYA_CRASH_HARNESS_HANG_HEARTBEAT_PERIOD_MS 50
+#define MAYA_CRASH_HARNESS_HANG_NUM_HEARTBEATS 10
+
+/// How often another thread of the child ticks to show that the process is still running.
+#define MAYA_CRASH_HARNESS_HANG_LIVENESS_PERIOD_MS 10
+
+/// NOTE: (sonictk) ``GetTickCount64``, which the watchdog goes by, only ticks every 10-16 ms, and
+/// the dump file is created just before the snapshot is taken.
+#define MAYA_CRASH_HARNESS_HANG_DETECT_SLACK_MS 250
+
+#define MAYA_CRASH_HARNESS_HANG_MAX_PAUSE_MS 50
+
+
+/// Written to by the child, in memory shared with the parent.
+struct MayaCrashHarnessHangResult
+{
+    volatile LONG64 blockTicks; // NOTE: (sonictk) When the main thread bumped its heartbeat for the last time before hanging.
+    volatile LONG64 unblockTicks;
+    volatile LONG numLivenessTicks;
+};
+
+/// The outcome of a single run, as seen by the parent.
+struct MayaCrashHarnessHangRun
+{
+    double detectMs; // NOTE: (sonictk) From the main thread hanging to the dump file being created.
+    double pauseMs;
+    uint64_t stallMs; // NOTE: (sonictk) As recorded by the watchdog in the dump.
+    unsigned int numStreamsRecovered;
+    bool dumpWritten;
+    bool keptRunning;
+    bool exitedNormally;
+    bool timedOut;
+};
+
+
+static MayaCrashHarnessHangResult *gHarnessHangResult = NULL;
+
+
+DWORD WINAPI mayaCrashHarnessLivenessThreadProc(LPVOID unused)
+{
+    (void)unused;
+    for (;;) {
+        ::InterlockedIncrement(&gHarnessHangResult->numLivenessTicks);
+        ::Sleep(MAYA_CRASH_HARNESS_HANG_LIVENESS_PERIOD_MS);
+    }
+}
+
+
+/// Keeps the heartbeat going from the main thread for a little while.
+static void bumpMayaCrashHarnessHeartbeat()
+{
+    for (unsigned int i=0; i < MAYA_CRASH_HARNESS_HANG_NUM_HEARTBEATS; ++i) {
+        bumpMayaMainThreadHeartbeat();
+        ::Sleep(MAYA_CRASH_HARNESS_HANG_HEARTBEAT_PERIOD_MS);
+    }
+    bumpMayaMainThreadHeartbeat();
+}
+
+
+/**
+ * The child process: starts the watchdog the same way the plugin does, and then hangs its main
+ * thread for a while.
+ *
+ * @return  ``0`` if the child made it through the hang, non-zero otherwise.
+ */
+int runMayaCrashHarnessHangChild(unsigned int thresholdSecs, HANDLE hResultMapping)
+{
+    gHarnessHangResult = (MayaCrashHarnessHangResult *)::MapViewOfFile(hResultMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaCrashHarnessHangResult));
+    if (gHarnessHangResult == NULL) {
+        return 2;
+    }
+
+    MINIDUMP_USER_STREAM streams[MAYA_CRASH_HARNESS_NUM_STREAMS];
+    getMayaCrashHarnessStreams(streams);
+    for (unsigned int i=0; i < MAYA_CRASH_HARNESS_NUM_STREAMS; ++i) {
+        memset(streams[i].Buffer, getMayaCrashHarnessStreamPattern(i), streams[i].BufferSize);
+    }
+
+    if (!startMayaHangWatchdog(thresholdSecs, false)) {
+        return 2;
+    }
+    HANDLE hLivenessThread = ::CreateThread(NULL, 0, mayaCrashHarnessLivenessThreadProc, NULL, 0, NULL);
+    if (hLivenessThread == NULL) {
+        return 2;
+    }
+    ::CloseHandle(hLivenessThread);
+
+    // NOTE: (sonictk) Let the watchdog see a healthy main thread first.
+    bumpMayaCrashHarnessHeartbeat();
+
+    LARGE_INTEGER ticks;
+    ::QueryPerformanceCounter(&ticks);
+    gHarnessHangResult->blockTicks = ticks.QuadPart;
+
+    ::Sleep(thresholdSecs * 1000 * MAYA_CRASH_HARNESS_HANG_STALL_MULTIPLE);
+
+    ::QueryPerformanceCounter(&ticks);
+    gHarnessHangResult->unblockTicks = ticks.QuadPart;
+
+    // NOTE: (sonictk) The watchdog must be finished with its dump by the time this returns.
+    bumpMayaCrashHarnessHeartbeat();
+    stopMayaHangWatchdog();
+
+    return 0;
+}
+
+
+/**
+ * Runs the child once and checks what the watchdog did about it.
+ *
+ * @return  ``false`` if the child process could not be run at all.
+ */
+bool runMayaCrashHarnessHangOnce(const char *exePath,
+                                 unsigned int thresholdSecs,
+                                 const MayaCrashHarnessConfig *config,
+                                 LONGLONG timerFrequency,
+                                 MayaCrashHarnessHangRun *run)
+{
+    memset(run, 0, sizeof(MayaCrashHarnessHangRun));
+
+    SECURITY_ATTRIBUTES secAttrs = {0};
+    secAttrs.nLength = sizeof(secAttrs);
+    secAttrs.bInheritHandle = TRUE;
+    HANDLE hResultMapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, &secAttrs, PAGE_READWRITE, 0, sizeof(MayaCrashHarnessHangResult), NULL);
+    if (hResultMapping == NULL) {
+        return false;
+    }
+    MayaCrashHarnessHangResult *result = (MayaCrashHarnessHangResult *)::MapViewOfFile(hResultMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaCrashHarnessHangResult));
+    if (result == NULL) {
+        ::CloseHandle(hResultMapping);
+        return false;
+    }
+
+    char cmdLine[MAX_PATH * 2] = {0};
+    snprintf(cmdLine, sizeof(cmdLine), "\"%s\" %s %u %llu",
+             exePath, MAYA_CRASH_HARNESS_HANG_CHILD_FLAG, thresholdSecs, (unsigned long long)(uintptr_t)hResultMapping);
+
+    STARTUPINFOA startupInfo = {0};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION procInfo = {0};
+    if (!::CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE, 0, NULL, NULL, &startupInfo, &procInfo)) {
+        ::UnmapViewOfFile(result);
+        ::CloseHandle(hResultMapping);
+        return false;
+    }
+
+    // NOTE: (sonictk) The child inherits our environment, so its watchdog writes to the same
+    // directory, under the same name as the plugin's would.
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    char dumpFilePath[MAX_PATH] = {0};
+    snprintf(dumpFilePath, MAX_PATH, "%s\\%s_%lu_1.dmp", tempDirPath, MAYA_HANG_DUMP_FILE_PREFIX, procInfo.dwProcessId);
+
+    const DWORD hangMs = thresholdSecs * 1000 * MAYA_CRASH_HARNESS_HANG_STALL_MULTIPLE;
+    const ULONGLONG deadline = ::GetTickCount64() + hangMs + config->timeoutSecs * 1000;
+    LARGE_INTEGER detectTicks = {0};
+    bool exited = false;
+    while (::GetTickCount64() < deadline) {
+        if (::GetFileAttributesA(dumpFilePath) != INVALID_FILE_ATTRIBUTES) {
+            ::QueryPerformanceCounter(&detectTicks);
+            break;
+        }
+        if (::WaitForSingleObject(procInfo.hProcess, 5) == WAIT_OBJECT_0) {
+            exited = true;
+            break;
+        }
+    }
+
+    if (detectTicks.QuadPart != 0 && result->blockTicks != 0) {
+        run->detectMs = (double)(detectTicks.QuadPart - result->blockTicks) * 1000.0 / (double)timerFrequency;
+
+        // NOTE: (sonictk) The main thread is still hung at this point, so anything that moves in
+        // the child now is the rest of the process carrying on around the snapshot.
+        const LONG numLivenessTicks = result->numLivenessTicks;
+        ::Sleep(MAYA_CRASH_HARNESS_HANG_LIVENESS_PERIOD_MS * 20);
+        run->keptRunning = result->numLivenessTicks > numLivenessTicks;
+    }
+
+    if (!exited) {
+        const ULONGLONG now = ::GetTickCount64();
+        const DWORD waitMs = now < deadline ? (DWORD)(deadline - now) : 0;
+        if (::WaitForSingleObject(procInfo.hProcess, waitMs) != WAIT_OBJECT_0) {
+            run->timedOut = true;
+            ::TerminateProcess(procInfo.hProcess, 1);
+            ::WaitForSingleObject(procInfo.hProcess, INFINITE);
+        }
+    }
+    DWORD exitCode = 1;
+    ::GetExitCodeProcess(procInfo.hProcess, &exitCode);
+    run->exitedNormally = !run->timedOut && exitCode == 0 && result->unblockTicks != 0;
+    ::CloseHandle(procInfo.hThread);
+    ::CloseHandle(procInfo.hProcess);
+
+    MayaSnapshotInfo snapshotInfo = {0};
+    if (readMayaCrashHarnessDumpStream(dumpFilePath, MAYA_SNAPSHOT_INFO_STREAM_TYPE, &snapshotInfo, sizeof(snapshotInfo))) {
+        run->dumpWritten = true;
+        run->pauseMs = (double)snapshotInfo.pauseMicroseconds / 1000.0;
+        run->stallMs = snapshotInfo.stallMs;
+        run->numStreamsRecovered = countMayaCrashHarnessStreamsRecovered(dumpFilePath);
+    }
+
+    if (!config->keepDumps) {
+        ::DeleteFileA(dumpFilePath);
+    }
+
+    ::UnmapViewOfFile(result);
+    ::CloseHandle(hResultMapping);
+
+    return true;
+}
+
+
+/**
+ * Runs the hang scenario ``config->numRuns`` times, printing a line for each run.
+ *
+ * @return  The number of runs that failed any of the checks.
+ */
+int runMayaCrashHarnessHang(const char *exePath, unsigned int thresholdSecs, const MayaCrashHarnessConfig *config, LONGLONG timerFrequency)
+{
+    // NOTE: (sonictk) The watchdog polls a few times per threshold, but never less than once a second.
+    const DWORD pollMs = thresholdSecs * 1000 / 4 > 1000 ? 1000 : thresholdSecs * 1000 / 4;
+    const double minDetectMs = (double)thresholdSecs * 1000.0 - MAYA_CRASH_HARNESS_HANG_DETECT_SLACK_MS;
+    const double maxDetectMs = (double)thresholdSecs * 1000.0 + pollMs + MAYA_CRASH_HARNESS_HANG_DETECT_SLACK_MS;
+
+    printf("Hang threshold: %u s, main thread hung for %u s, runs: %u\n"
+           "Expecting a snapshot within %.0f-%.0f ms of the hang, paused for at most %d ms\n\n",
+           thresholdSecs, thresholdSecs * MAYA_CRASH_HARNESS_HANG_STALL_MULTIPLE, config->numRuns,
+           minDetectMs, maxDetectMs, MAYA_CRASH_HARNESS_HANG_MAX_PAUSE_MS);
+    printf("%-4s %6s %12s %12s %10s %8s %8s %7s %s\n",
+           "Run", "Dump", "Detect (ms)", "Stall (ms)", "Pause (ms)", "Running", "Exited", "Streams", "Result");
+
+    int numFailed = 0;
+    for (unsigned int i=0; i < config->numRuns; ++i) {
+        MayaCrashHarnessHangRun run;
+        if (!runMayaCrashHarnessHangOnce(exePath, thresholdSecs, config, timerFrequency, &run)) {
+            fprintf(stderr, "Could not run the hang scenario: error %lu\n", ::GetLastError());
+            return numFailed + (int)(config->numRuns - i);
+        }
+
+        const bool passed = run.dumpWritten
+            && run.detectMs >= minDetectMs
+            && run.detectMs <= maxDetectMs
+            && run.pauseMs <= MAYA_CRASH_HARNESS_HANG_MAX_PAUSE_MS
+            && run.keptRunning
+            && run.exitedNormally
+            && run.numStreamsRecovered == MAYA_CRASH_HARNESS_NUM_STREAMS;
+        numFailed += passed ? 0 : 1;
+
+        printf("%-4u %6s %12.1f %12llu %10.3f %8s %8s %3u/%-3u %s\n",
+               i, run.dumpWritten ? "yes" : "no", run.detectMs, (unsigned long long)run.stallMs, run.pauseMs,
+               run.keptRunning ? "yes" : "no", run.timedOut ? "timeout" : run.exitedNormally ? "yes" : "no",
+               run.numStreamsRecovered, MAYA_CRASH_HARNESS_NUM_STREAMS, passed ? "ok" : "FAILED");
+    }
+
+    return numFailed;
+}
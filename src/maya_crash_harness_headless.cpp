@@ -0,0 +1,492 @@
+/**
+ * @file   maya_crash_harness_headless.cpp
+ * @brief  ``maya_crash_harness.exe -headless [-n <runs>] [crashType...]`` checks headless crash
+ *         handling end to end. A child process installs the same handlers that the plugin does in
+ *         a batch session, raises and handles the exceptions that a healthy session raises all the
+ *         time (which must not be mistaken for crashes), and then crashes in the requested way.
+ *         The parent checks that:
+ *
+ *         - the child got past all of the exceptions that it handled itself;
+ *         - the child exits with the code for the kind of crash it was, and reports how long it
+ *           took from the fault to the process being gone;
+ *         - the ``MAYA_CRASH`` line on the child's ``stderr`` agrees with its exit code and pid,
+ *           and points at the dump that was written;
+ *         - the status file has the very same line in it.
+ *
+ *         Along with the crash types, the ``SwallowedStackCorruption`` scenario corrupts the return
+ *         address underneath a ``__try``/``__except`` frame, the way a host that wraps calls into
+ *         plugins might, and checks that the vectored exception handler wrote the dump.
+ */
+
+#define MAYA_CRASH_HARNESS_HEADLESS_FLAG "-headless"
+#define MAYA_CRASH_HARNESS_HEADLESS_CHILD_FLAG "--headlesschild"
+
+/// The number of exceptions that the child raises and handles before it crashes.
+#define MAYA_CRASH_HARNESS_HEADLESS_NUM_PROBES 4
+
+/// NOTE: (sonictk) Not one of ``MayaForceCrashType``, since it is only the harness that wraps the
+/// stack corruption in a frame of its own.
+#define MAYA_CRASH_HARNESS_HEADLESS_SWALLOWED_CRASH_TYPE MayaForceCrashType_Count
+#define MAYA_CRASH_HARNESS_HEADLESS_NUM_SCENARIOS (MayaForceCrashType_Count + 1)
+
+#define MAYA_CRASH_HARNESS_HEADLESS_MAX_LINE_BYTES (MAX_PATH * 2)
+#define MAYA_CRASH_HARNESS_HEADLESS_PAGE_SIZE 4096
+
+/// NOTE: (sonictk) Raised by the child as a stand-in for the exceptions of other language runtimes,
+/// which are noncontinuable like MSVC's C++ throws are.
+#define MAYA_CRASH_HARNESS_HEADLESS_CUSTOMER_EXCEPTION_CODE 0xE0000001
+
+
+/// Written to by the child, in memory shared with the parent.
+struct MayaCrashHarnessHeadlessResult
+{
+    volatile LONG64 faultTicks;
+    volatile LONG numProbesHandled;
+    volatile LONG vectoredHandlerCalled;
+};
+
+/// The outcome of a single run, as seen by the parent.
+struct MayaCrashHarnessHeadlessRun
+{
+    double faultToExitMs;
+    double reportedElapsedMs; // NOTE: (sonictk) As reported by the child, from entering the filter to writing the line.
+    DWORD exitCode;
+    unsigned int numProbesHandled;
+    bool exitCodeMatches;
+    bool lineMatches;
+    bool statusFileMatches;
+    bool dumpWritten;
+    bool dumpedByVectoredHandler;
+    bool timedOut;
+};
+
+
+/// What each scenario is expected to exit with, or ``0`` if that depends on how the CRT was built.
+static const int kMayaCrashHarnessHeadlessExitCodes[MAYA_CRASH_HARNESS_HEADLESS_NUM_SCENARIOS] = {
+    0,
+    MayaCrashExitCode_AccessViolation,
+    MayaCrashExitCode_Abort,
+    0, // NOTE: (sonictk) An access violation in release builds; the debug CRT catches it first.
+    0,
+    MayaCrashExitCode_PureCall,
+    MayaCrashExitCode_StackOverflow,
+    MayaCrashExitCode_AccessViolation // NOTE: (sonictk) Returning to the corrupted address.
+};
+
+static MayaCrashHarnessHeadlessResult *gHarnessHeadlessResult = NULL;
+static volatile LONG gHarnessHeadlessHandlerCalled = 0;
+
+
+/// The child's crash handler, which does what the plugin's does in a batch session.
+LONG WINAPI mayaCrashHarnessHeadlessExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+{
+    if (::InterlockedExchange(&gHarnessHeadlessHandlerCalled, 1) != 0) {
+        return EXCEPTION_EXECUTE_HANDLER;
+    }
+
+    MayaHeadlessCrashReport report = {0};
+    ::QueryPerformanceCounter(&report.faultTime);
+    report.exceptionCode = exceptionInfo->ExceptionRecord->ExceptionCode;
+    report.exceptionAddress = exceptionInfo->ExceptionRecord->ExceptionAddress;
+    report.status = MayaHeadlessCrashStatus_DumpFailed;
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+
+    HANDLE hFile = ::CreateFileA(gHarnessDumpFilePath, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != NULL && hFile != INVALID_HANDLE_VALUE) {
+        MINIDUMP_USER_STREAM streams[MAYA_CRASH_HARNESS_NUM_STREAMS];
+        getMayaCrashHarnessStreams(streams);
+        if (writeMayaCrashDump(hFile, exceptionInfo, streams, MAYA_CRASH_HARNESS_NUM_STREAMS, MayaDumpCapture_Normal)) {
+            report.status = MayaHeadlessCrashStatus_Dumped;
+            report.filePath = gHarnessDumpFilePath;
+        }
+        ::CloseHandle(hFile);
+    }
+
+    finishMayaHeadlessCrash(tempDirPath, &report);
+
+    return EXCEPTION_EXECUTE_HANDLER;
+}
+
+
+LONG WINAPI mayaCrashHarnessHeadlessVectoredExceptionHandler(PEXCEPTION_POINTERS exceptionInfo)
+{
+    if (!isMayaFirstChanceExceptionFatal(exceptionInfo->ExceptionRecord)) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+    if (gHarnessHeadlessHandlerCalled == 0) {
+        gHarnessHeadlessResult->vectoredHandlerCalled = 1;
+    }
+
+    return mayaCrashHarnessHeadlessExceptionFilter(exceptionInfo);
+}
+
+
+const char *getMayaCrashHarnessHeadlessScenarioName(int crashType)
+{
+    if (crashType == MAYA_CRASH_HARNESS_HEADLESS_SWALLOWED_CRASH_TYPE) {
+        return "SwallowedStackCorruption";
+    }
+
+    return getMayaCrashHarnessHeadlessScenarioName(crashType);
+}
+
+
+void __cdecl mayaCrashHarnessHeadlessPurecallHandler()
+{
+    EXCEPTION_POINTERS *ppExceptionPointers = NULL;
+    GetExceptionPointers(EXCEPTION_NONCONTINUABLE, &ppExceptionPointers);
+    mayaCrashHarnessHeadlessExceptionFilter(ppExceptionPointers);
+    ::ExitProcess(0);
+}
+
+
+/// Raises and handles the structured exceptions that code routinely recovers from.
+/// NOTE: (sonictk) Kept apart from anything with destructors, which ``__try`` can't be mixed with.
+static unsigned int raiseMayaCrashHarnessHandledSEHExceptions()
+{
+    unsigned int numHandled = 0;
+
+    volatile BYTE *page = (volatile BYTE *)::VirtualAlloc(NULL, MAYA_CRASH_HARNESS_HEADLESS_PAGE_SIZE, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE|PAGE_GUARD);
+    if (page != NULL) {
+        __try {
+            page[0] = 1;
+        } __except (::GetExceptionCode() == STATUS_GUARD_PAGE_VIOLATION ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+            ++numHandled;
+        }
+        ::VirtualFree((LPVOID)page, 0, MEM_RELEASE);
+    }
+
+    __try {
+        ::DebugBreak();
+    } __except (::GetExceptionCode() == EXCEPTION_BREAKPOINT ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        ++numHandled;
+    }
+
+    __try {
+        ::RaiseException(MAYA_CRASH_HARNESS_HEADLESS_CUSTOMER_EXCEPTION_CODE, EXCEPTION_NONCONTINUABLE, 0, NULL);
+    } __except (::GetExceptionCode() == MAYA_CRASH_HARNESS_HEADLESS_CUSTOMER_EXCEPTION_CODE ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        ++numHandled;
+    }
+
+    // NOTE: (sonictk) Raises (and handles) ``DBG_PRINTEXCEPTION_C`` internally.
+    ::OutputDebugStringA("maya_crash_harness: handled exceptions raised\n");
+
+    return numHandled;
+}
+
+
+static unsigned int throwMayaCrashHarnessHandledCPPException()
+{
+    unsigned int numHandled = 0;
+    try {
+        throw MAYA_CRASH_HARNESS_HEADLESS_NUM_PROBES;
+    } catch (int) {
+        ++numHandled;
+    }
+
+    return numHandled;
+}
+
+
+/// Corrupts the return address of a call made from within a ``__try``/``__except`` frame that
+/// passes everything on, as a host that guards its calls into plugins does. Unwinding through the
+/// corrupted frame cannot get as far as the unhandled exception filter, so only the vectored
+/// exception handler gets to dump this one.
+__declspec(noinline) static bool triggerMayaCrashHarnessSwallowedStackCorruption()
+{
+    bool bStat = false;
+    __try {
+        bStat = triggerMayaForceCrash(MayaForceCrashType_StackCorruption);
+    } __except (EXCEPTION_CONTINUE_SEARCH) {
+    }
+
+    return bStat;
+}
+
+
+/**
+ * The child process: installs the handlers that the plugin does in a batch session, handles a
+ * few exceptions of its own, and then crashes in the requested way.
+ *
+ * @return  The exit code of the child process, if it doesn't crash.
+ */
+int runMayaCrashHarnessHeadlessChild(int crashType, HANDLE hResultMapping, const char *dumpFilePath)
+{
+    gHarnessHeadlessResult = (MayaCrashHarnessHeadlessResult *)::MapViewOfFile(hResultMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaCrashHarnessHeadlessResult));
+    if (gHarnessHeadlessResult == NULL) {
+        return 2;
+    }
+    strncpy(gHarnessDumpFilePath, dumpFilePath, MAX_PATH - 1);
+
+    MINIDUMP_USER_STREAM streams[MAYA_CRASH_HARNESS_NUM_STREAMS];
+    getMayaCrashHarnessStreams(streams);
+    for (unsigned int i=0; i < MAYA_CRASH_HARNESS_NUM_STREAMS; ++i) {
+        memset(streams[i].Buffer, getMayaCrashHarnessStreamPattern(i), streams[i].BufferSize);
+    }
+
+    _set_abort_behavior(0, _WRITE_ABORT_MSG);
+    _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ASSERT, _CRTDBG_FILE_STDERR);
+
+    ::AddVectoredExceptionHandler(1, mayaCrashHarnessHeadlessVectoredExceptionHandler);
+    ::SetUnhandledExceptionFilter(mayaCrashHarnessHeadlessExceptionFilter);
+    _set_purecall_handler(mayaCrashHarnessHeadlessPurecallHandler);
+    signal(SIGABRT, mayaCrashHarnessAbortSignalHandler);
+
+    // NOTE: (sonictk) Any of these being taken for a crash ends the child right here.
+    unsigned int numProbesHandled = raiseMayaCrashHarnessHandledSEHExceptions();
+    numProbesHandled += throwMayaCrashHarnessHandledCPPException();
+    gHarnessHeadlessResult->numProbesHandled = (LONG)numProbesHandled;
+
+    LARGE_INTEGER ticks;
+    ::QueryPerformanceCounter(&ticks);
+    gHarnessHeadlessResult->faultTicks = ticks.QuadPart;
+
+    if (crashType == MAYA_CRASH_HARNESS_HEADLESS_SWALLOWED_CRASH_TYPE) {
+        triggerMayaCrashHarnessSwallowedStackCorruption();
+    } else if (!triggerMayaForceCrash(crashType)) {
+        return 2;
+    }
+
+    return 3;
+}
+
+
+/**
+ * Reads the first ``MAYA_CRASH`` line out of the given file.
+ *
+ * @return  ``true`` if the file has such a line.
+ */
+bool readMayaCrashHarnessHeadlessLine(const char *filePath, char *line, DWORD lenLine)
+{
+    static char contents[MAYA_CRASH_HARNESS_HEADLESS_MAX_LINE_BYTES * 8];
+    HANDLE hFile = ::CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD bytesRead = 0;
+    ::ReadFile(hFile, contents, (DWORD)sizeof(contents) - 1, &bytesRead, NULL);
+    ::CloseHandle(hFile);
+    contents[bytesRead] = '\0';
+
+    const char *start = strstr(contents, "MAYA_CRASH ");
+    if (start == NULL) {
+        return false;
+    }
+    const char *end = strchr(start, '\n');
+    size_t lenStart = end != NULL ? (size_t)(end + 1 - start) : strlen(start);
+    if (lenStart >= lenLine) {
+        return false;
+    }
+    memcpy(line, start, lenStart);
+    line[lenStart] = '\0';
+
+    return true;
+}
+
+
+/**
+ * Runs a single scenario once in a child process and checks how it went.
+ *
+ * @return  ``false`` if the child process could not be run at all.
+ */
+bool runMayaCrashHarnessHeadlessOnce(const char *exePath,
+                                     int crashType,
+                                     unsigned int runIdx,
+                                     const MayaCrashHarnessConfig *config,
+                                     LONGLONG timerFrequency,
+                                     MayaCrashHarnessHeadlessRun *run)
+{
+    memset(run, 0, sizeof(MayaCrashHarnessHeadlessRun));
+
+    SECURITY_ATTRIBUTES secAttrs = {0};
+    secAttrs.nLength = sizeof(secAttrs);
+    secAttrs.bInheritHandle = TRUE;
+    HANDLE hResultMapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, &secAttrs, PAGE_READWRITE, 0, sizeof(MayaCrashHarnessHeadlessResult), NULL);
+    if (hResultMapping == NULL) {
+        return false;
+    }
+    MayaCrashHarnessHeadlessResult *result = (MayaCrashHarnessHeadlessResult *)::MapViewOfFile(hResultMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaCrashHarnessHeadlessResult));
+    if (result == NULL) {
+        ::CloseHandle(hResultMapping);
+        return false;
+    }
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    char dumpFilePath[MAX_PATH] = {0};
+    snprintf(dumpFilePath, MAX_PATH, "%s\\%s_headless_%s_%u.dmp", tempDirPath, MAYA_CRASH_HARNESS_DUMP_FILE_PREFIX, getMayaCrashHarnessHeadlessScenarioName(crashType), runIdx);
+    ::DeleteFileA(dumpFilePath);
+
+    // NOTE: (sonictk) The child's ``stderr`` goes to a file rather than a pipe, so that nothing it
+    // writes can block it and the parent never has to read while it waits.
+    char stderrFilePath[MAX_PATH] = {0};
+    snprintf(stderrFilePath, MAX_PATH, "%s\\%s_headless_%s_%u.stderr.txt", tempDirPath, MAYA_CRASH_HARNESS_DUMP_FILE_PREFIX, getMayaCrashHarnessHeadlessScenarioName(crashType), runIdx);
+    HANDLE hStdErr = ::CreateFileA(stderrFilePath, GENERIC_WRITE, FILE_SHARE_READ, &secAttrs, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hStdErr == INVALID_HANDLE_VALUE) {
+        ::UnmapViewOfFile(result);
+        ::CloseHandle(hResultMapping);
+        return false;
+    }
+
+    char cmdLine[MAX_PATH * 3] = {0};
+    snprintf(cmdLine, sizeof(cmdLine), "\"%s\" %s %d %llu \"%s\"",
+             exePath, MAYA_CRASH_HARNESS_HEADLESS_CHILD_FLAG, crashType, (unsigned long long)(uintptr_t)hResultMapping, dumpFilePath);
+
+    STARTUPINFOA startupInfo = {0};
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdInput = ::GetStdHandle(STD_INPUT_HANDLE);
+    startupInfo.hStdOutput = ::GetStdHandle(STD_OUTPUT_HANDLE);
+    startupInfo.hStdError = hStdErr;
+    PROCESS_INFORMATION procInfo = {0};
+    BOOL bStat = ::CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE, 0, NULL, NULL, &startupInfo, &procInfo);
+    ::CloseHandle(hStdErr);
+    if (!bStat) {
+        ::UnmapViewOfFile(result);
+        ::CloseHandle(hResultMapping);
+        ::DeleteFileA(stderrFilePath);
+        return false;
+    }
+
+    DWORD waitStat = ::WaitForSingleObject(procInfo.hProcess, config->timeoutSecs * 1000);
+    LARGE_INTEGER exitTicks;
+    ::QueryPerformanceCounter(&exitTicks);
+    if (waitStat != WAIT_OBJECT_0) {
+        run->timedOut = true;
+        ::TerminateProcess(procInfo.hProcess, 1);
+        ::WaitForSingleObject(procInfo.hProcess, INFINITE);
+    }
+    ::GetExitCodeProcess(procInfo.hProcess, &run->exitCode);
+    const DWORD childPid = procInfo.dwProcessId;
+    ::CloseHandle(procInfo.hThread);
+    ::CloseHandle(procInfo.hProcess);
+
+    run->numProbesHandled = (unsigned int)result->numProbesHandled;
+    run->dumpedByVectoredHandler = result->vectoredHandlerCalled != 0;
+    if (result->faultTicks != 0) {
+        run->faultToExitMs = (double)(exitTicks.QuadPart - result->faultTicks) * 1000.0 / (double)timerFrequency;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA fileAttrs = {0};
+    run->dumpWritten = ::GetFileAttributesExA(dumpFilePath, GetFileExInfoStandard, &fileAttrs) != 0
+        && (fileAttrs.nFileSizeHigh != 0 || fileAttrs.nFileSizeLow != 0);
+
+    // NOTE: (sonictk) The line has to agree with itself (the exit code it names is the one for the
+    // exception code it names), with what the process actually did, and with the status file.
+    char line[MAYA_CRASH_HARNESS_HEADLESS_MAX_LINE_BYTES] = {0};
+    if (!run->timedOut && readMayaCrashHarnessHeadlessLine(stderrFilePath, line, (DWORD)sizeof(line))) {
+        char status[32] = {0};
+        char crashClass[32] = {0};
+        int lineExitCode = 0;
+        unsigned long lineExceptionCode = 0;
+        void *lineAddress = NULL;
+        unsigned long long lineFingerprint = 0;
+        unsigned long linePid = 0;
+        double lineElapsedMs = 0.0;
+        char linePath[MAX_PATH] = {0};
+        int numFields = sscanf(line, "MAYA_CRASH status=%31s class=%31s exit_code=%d exception_code=0x%lx address=0x%p fingerprint=%llx pid=%lu elapsed_ms=%lf path=%259[^\r\n]",
+                               status, crashClass, &lineExitCode, &lineExceptionCode, &lineAddress, &lineFingerprint, &linePid, &lineElapsedMs, linePath);
+        run->reportedElapsedMs = lineElapsedMs;
+
+        const int expectedExitCode = crashType > MayaForceCrashType_NoCrash && crashType < MAYA_CRASH_HARNESS_HEADLESS_NUM_SCENARIOS ? kMayaCrashHarnessHeadlessExitCodes[crashType] : 0;
+        run->exitCodeMatches = numFields >= 3
+            && run->exitCode == (DWORD)lineExitCode
+            && lineExitCode == (int)getMayaCrashExitCode((DWORD)lineExceptionCode)
+            && (expectedExitCode == 0 || lineExitCode == expectedExitCode);
+        run->lineMatches = numFields == 9
+            && strcmp(status, "dumped") == 0
+            && linePid == childPid
+            && _stricmp(linePath, dumpFilePath) == 0
+            && lineElapsedMs <= run->faultToExitMs;
+
+        char statusFilePath[MAX_PATH] = {0};
+        snprintf(statusFilePath, MAX_PATH, "%s\\%s_%lu.txt", tempDirPath, MAYA_CRASH_STATUS_FILE_PREFIX, childPid);
+        char statusLine[MAYA_CRASH_HARNESS_HEADLESS_MAX_LINE_BYTES] = {0};
+        run->statusFileMatches = readMayaCrashHarnessHeadlessLine(statusFilePath, statusLine, (DWORD)sizeof(statusLine))
+            && strcmp(statusLine, line) == 0;
+        if (!config->keepDumps) {
+            ::DeleteFileA(statusFilePath);
+        }
+    }
+
+    if (!config->keepDumps) {
+        ::DeleteFileA(dumpFilePath);
+        ::DeleteFileA(stderrFilePath);
+    }
+
+    ::UnmapViewOfFile(result);
+    ::CloseHandle(hResultMapping);
+
+    return true;
+}
+
+
+/**
+ * Runs each of the given scenarios ``config->numRuns`` times headlessly, and prints how long the
+ * children took to go from the fault to being gone.
+ *
+ * @return  The number of scenarios that failed any of their checks.
+ */
+int runMayaCrashHarnessHeadless(const char *exePath,
+                                const int *crashTypes,
+                                int numCrashTypes,
+                                const MayaCrashHarnessConfig *config,
+                                LONGLONG timerFrequency)
+{
+    printf("Headless crash handling: %u runs per scenario\n", config->numRuns);
+    printf("%-24s %7s %7s %9s %9s %11s %5s %12s %12s %13s\n",
+           "Scenario", "Probes", "Dumped", "Exit code", "Line", "Status file", "Code", "Median (ms)", "Max (ms)", "Handler (ms)");
+
+    double *times = (double *)calloc(config->numRuns, sizeof(double));
+    double *handlerTimes = (double *)calloc(config->numRuns, sizeof(double));
+    int numFailed = 0;
+    // NOTE: (sonictk) The swallowed stack corruption is always run last, on top of the crash types.
+    for (int c=0; c <= numCrashTypes && times != NULL && handlerTimes != NULL; ++c) {
+        const int crashType = c < numCrashTypes ? crashTypes[c] : MAYA_CRASH_HARNESS_HEADLESS_SWALLOWED_CRASH_TYPE;
+        unsigned int numProbesOk = 0;
+        unsigned int numDumped = 0;
+        unsigned int numExitCodesOk = 0;
+        unsigned int numLinesOk = 0;
+        unsigned int numStatusFilesOk = 0;
+        DWORD lastExitCode = 0;
+        for (unsigned int i=0; i < config->numRuns; ++i) {
+            MayaCrashHarnessHeadlessRun run;
+            if (!runMayaCrashHarnessHeadlessOnce(exePath, crashType, i, config, timerFrequency, &run)) {
+                fprintf(stderr, "Could not run the %s scenario: error %lu\n", getMayaCrashHarnessHeadlessScenarioName(crashType), ::GetLastError());
+                break;
+            }
+            times[i] = run.faultToExitMs;
+            handlerTimes[i] = run.reportedElapsedMs;
+            lastExitCode = run.exitCode;
+            numProbesOk += run.numProbesHandled == MAYA_CRASH_HARNESS_HEADLESS_NUM_PROBES ? 1 : 0;
+            // NOTE: (sonictk) Only the vectored exception handler can get to the swallowed one.
+            numDumped += !run.timedOut && run.dumpWritten
+                && (crashType != MAYA_CRASH_HARNESS_HEADLESS_SWALLOWED_CRASH_TYPE || run.dumpedByVectoredHandler) ? 1 : 0;
+            numExitCodesOk += run.exitCodeMatches ? 1 : 0;
+            numLinesOk += run.lineMatches ? 1 : 0;
+            numStatusFilesOk += run.statusFileMatches ? 1 : 0;
+        }
+        qsort(times, config->numRuns, sizeof(double), compareDoubles);
+        qsort(handlerTimes, config->numRuns, sizeof(double), compareDoubles);
+
+        printf("%-24s %3u/%-3u %3u/%-3u %4u/%-4u %4u/%-4u %5u/%-5u %5lu %12.3f %12.3f %13.3f\n",
+               getMayaCrashHarnessHeadlessScenarioName(crashType),
+               numProbesOk, config->numRuns, numDumped, config->numRuns, numExitCodesOk, config->numRuns,
+               numLinesOk, config->numRuns, numStatusFilesOk, config->numRuns, lastExitCode,
+               times[config->numRuns / 2], times[config->numRuns - 1], handlerTimes[config->numRuns / 2]);
+        fflush(stdout);
+
+        if (numProbesOk != config->numRuns || numDumped != config->numRuns || numExitCodesOk != config->numRuns
+            || numLinesOk != config->numRuns || numStatusFilesOk != config->numRuns) {
+            ++numFailed;
+        }
+    }
+
+    free(handlerTimes);
+    free(times);
+
+    return numFailed;
+}
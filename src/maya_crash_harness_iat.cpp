@@ -0,0 +1,199 @@
+/**
+ * @file   maya_crash_harness_iat.cpp
+ * @brief  ``maya_crash_harness.exe -benchiat <modules>`` measures what the import address table
+ *         patching adds to loading a module. That many copies of a stub DLL are loaded, one after
+ *         the other, and each copy is patched either by itself from the loader notification (as the
+ *         plugin does now), or by rescanning every module in the process after each load (as the
+ *         plugin used to). Every copy is then checked to have actually been patched.
+ */
+
+#define MAYA_CRASH_HARNESS_BENCH_IAT_FLAG "-benchiat"
+#define MAYA_CRASH_HARNESS_BENCH_IAT_MAX_MODULES 4096
+
+#define MAYA_CRASH_HARNESS_STUB_DLL_NAME "maya_crash_harness_stub.dll"
+#define MAYA_CRASH_HARNESS_STUB_SET_FILTER_FUNC_NAME "mayaCrashHarnessStubSetFilter"
+
+typedef LPTOP_LEVEL_EXCEPTION_FILTER (*MayaCrashHarnessStubSetFilterFunc)(LPTOP_LEVEL_EXCEPTION_FILTER filter);
+
+enum MayaCrashHarnessIATPatchMode
+{
+    MayaCrashHarnessIATPatchMode_None = 0,
+    MayaCrashHarnessIATPatchMode_Incremental,
+    MayaCrashHarnessIATPatchMode_FullRescan,
+    MayaCrashHarnessIATPatchMode_Count
+};
+
+static const char *kMayaCrashHarnessIATPatchModeNames[MayaCrashHarnessIATPatchMode_Count] = {
+    "none",
+    "incremental",
+    "full rescan"
+};
+
+
+static volatile LONG gHarnessNumDetouredSetFilterCalls = 0;
+
+
+/// What the stubs end up calling once they have been patched.
+LPTOP_LEVEL_EXCEPTION_FILTER WINAPI mayaCrashHarnessDetouredSetFilter(LPTOP_LEVEL_EXCEPTION_FILTER filter)
+{
+    (void)filter;
+    ::InterlockedIncrement(&gHarnessNumDetouredSetFilterCalls);
+
+    return NULL;
+}
+
+
+/**
+ * Loads every copy of the stub DLL, patching them the given way as they are loaded, and then
+ * unloads them all again.
+ *
+ * @param stubPaths     The paths of the copies of the stub.
+ * @param hStubs        Storage for the handles of the copies, as they are loaded.
+ * @param numModules    The number of copies.
+ * @param mode          How to patch the copies. One of ``MayaCrashHarnessIATPatchMode``.
+ * @param hooks         The hooks to apply.
+ * @param numHooks      The number of hooks.
+ * @param numPatched    Storage for the number of copies that turned out to have been patched.
+ *
+ * @return              The time taken to load (and patch) all of the copies, in milliseconds.
+ */
+double runMayaIATBenchOnce(const char (*stubPaths)[MAX_PATH],
+                           HMODULE *hStubs,
+                           unsigned int numModules,
+                           int mode,
+                           const MayaIATHook *hooks,
+                           unsigned int numHooks,
+                           LONGLONG timerFrequency,
+                           unsigned int *numPatched)
+{
+    *numPatched = 0;
+    if (mode == MayaCrashHarnessIATPatchMode_Incremental && !startPatchingIATsOnModuleLoad(hooks, numHooks)) {
+        return 0.0;
+    }
+
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+    ::QueryPerformanceCounter(&start);
+    for (unsigned int i=0; i < numModules; ++i) {
+        hStubs[i] = ::LoadLibraryA(stubPaths[i]);
+        if (mode == MayaCrashHarnessIATPatchMode_FullRescan) {
+            patchOverIATEntriesInAllModules(hooks, numHooks, false);
+        }
+    }
+    ::QueryPerformanceCounter(&end);
+
+    if (mode == MayaCrashHarnessIATPatchMode_Incremental) {
+        stopPatchingIATsOnModuleLoad();
+    }
+
+    // NOTE: (sonictk) Unpatched copies would call the real ``SetUnhandledExceptionFilter``, so
+    // there is nothing to check when nothing was patched.
+    if (mode != MayaCrashHarnessIATPatchMode_None) {
+        gHarnessNumDetouredSetFilterCalls = 0;
+        for (unsigned int i=0; i < numModules; ++i) {
+            MayaCrashHarnessStubSetFilterFunc pfnSetFilter = hStubs[i] == NULL ? NULL
+                : (MayaCrashHarnessStubSetFilterFunc)::GetProcAddress(hStubs[i], MAYA_CRASH_HARNESS_STUB_SET_FILTER_FUNC_NAME);
+            if (pfnSetFilter != NULL) {
+                pfnSetFilter(NULL);
+            }
+        }
+        *numPatched = (unsigned int)gHarnessNumDetouredSetFilterCalls;
+
+        // NOTE: (sonictk) The full rescan patches the harness itself as well.
+        patchOverIATEntriesInAllModules(hooks, numHooks, true);
+    }
+
+    for (unsigned int i=0; i < numModules; ++i) {
+        if (hStubs[i] != NULL) {
+            ::FreeLibrary(hStubs[i]);
+            hStubs[i] = NULL;
+        }
+    }
+
+    return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)timerFrequency;
+}
+
+
+/**
+ * Runs the benchmark ``numRuns`` times for each way of patching, and prints the median times.
+ *
+ * @return  The number of ways of patching that failed to patch every copy of the stub.
+ */
+int runMayaIATBench(const char *exePath, unsigned int numModules, unsigned int numRuns, LONGLONG timerFrequency)
+{
+    numModules = numModules > MAYA_CRASH_HARNESS_BENCH_IAT_MAX_MODULES ? MAYA_CRASH_HARNESS_BENCH_IAT_MAX_MODULES : numModules;
+
+    // NOTE: (sonictk) The stub is built next to the harness. The loader only maps a DLL once per
+    // name, so every copy gets a name of its own.
+    char stubDllPath[MAX_PATH] = {0};
+    strncpy(stubDllPath, exePath, MAX_PATH - 1);
+    char *exeName = strrchr(stubDllPath, '\\');
+    exeName = exeName == NULL ? stubDllPath : exeName + 1;
+    snprintf(exeName, (size_t)(MAX_PATH - (exeName - stubDllPath)), "%s", MAYA_CRASH_HARNESS_STUB_DLL_NAME);
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    char stubDirPath[MAX_PATH] = {0};
+    snprintf(stubDirPath, MAX_PATH, "%s\\MayaCrashHarnessStubs_%lu", tempDirPath, ::GetCurrentProcessId());
+    ::CreateDirectoryA(stubDirPath, NULL);
+
+    char (*stubPaths)[MAX_PATH] = (char (*)[MAX_PATH])calloc(numModules, MAX_PATH);
+    HMODULE *hStubs = (HMODULE *)calloc(numModules, sizeof(HMODULE));
+    double *times = (double *)calloc(numRuns, sizeof(double));
+    int numFailed = 0;
+    for (unsigned int i=0; i < numModules; ++i) {
+        snprintf(stubPaths[i], MAX_PATH, "%s\\stub_%u.dll", stubDirPath, i);
+        if (!::CopyFileA(stubDllPath, stubPaths[i], FALSE)) {
+            fprintf(stderr, "Could not copy %s to %s: error %lu\n", stubDllPath, stubPaths[i], ::GetLastError());
+            numFailed = MayaCrashHarnessIATPatchMode_Count;
+            numModules = i;
+            break;
+        }
+    }
+
+    MayaIATHook hook = {0};
+    hook.pfnOrig = (PROC)::GetProcAddress(::GetModuleHandleA("kernel32.dll"), "SetUnhandledExceptionFilter");
+    hook.pfnNew = (PROC)mayaCrashHarnessDetouredSetFilter;
+
+    if (numFailed == 0) {
+        // NOTE: (sonictk) Load everything once first, so that none of the runs read the copies from disk.
+        unsigned int numPatched = 0;
+        runMayaIATBenchOnce(stubPaths, hStubs, numModules, MayaCrashHarnessIATPatchMode_None, &hook, 1, timerFrequency, &numPatched);
+
+        printf("IAT patching: %u modules, median of %u runs\n", numModules, numRuns);
+        printf("%-12s %12s %12s %16s %9s\n", "Patching", "Load (ms)", "Patch (ms)", "Patch/module (us)", "Patched");
+
+        double noPatchMs = 0.0;
+        for (int mode=MayaCrashHarnessIATPatchMode_None; mode < MayaCrashHarnessIATPatchMode_Count; ++mode) {
+            unsigned int minPatched = numModules;
+            for (unsigned int i=0; i < numRuns; ++i) {
+                times[i] = runMayaIATBenchOnce(stubPaths, hStubs, numModules, mode, &hook, 1, timerFrequency, &numPatched);
+                minPatched = numPatched < minPatched ? numPatched : minPatched;
+            }
+            qsort(times, numRuns, sizeof(double), compareDoubles);
+            const double loadMs = times[numRuns / 2];
+            if (mode == MayaCrashHarnessIATPatchMode_None) {
+                noPatchMs = loadMs;
+                printf("%-12s %12.2f %12s %16s %9s\n", kMayaCrashHarnessIATPatchModeNames[mode], loadMs, "-", "-", "-");
+                continue;
+            }
+
+            const double patchMs = loadMs > noPatchMs ? loadMs - noPatchMs : 0.0;
+            printf("%-12s %12.2f %12.2f %16.2f %4u/%-4u\n",
+                   kMayaCrashHarnessIATPatchModeNames[mode], loadMs, patchMs,
+                   numModules != 0 ? patchMs * 1000.0 / (double)numModules : 0.0, minPatched, numModules);
+            numFailed += minPatched == numModules ? 0 : 1;
+        }
+    }
+
+    for (unsigned int i=0; i < numModules; ++i) {
+        ::DeleteFileA(stubPaths[i]);
+    }
+    ::RemoveDirectoryA(stubDirPath);
+
+    free(times);
+    free(hStubs);
+    free(stubPaths);
+
+    return numFailed;
+}
@@ -0,0 +1,1013 @@
+/**
+ * @file   maya_crash_harness_main.cpp
+ * @brief  A standalone harness that runs each of the ``mayaForceCrash`` scenarios in a child
+ *         process under load (many threads with deep stacks, a large heap), and reports how
+ *         long the crash handler took to write out its dump, how large the dump was, and
+ *         whether every breadcrumb stream made it into the dump intact.
+ *
+ *         usage: maya_crash_harness.exe [-n <runs>] [-threads <num>] [-heapmb <MB>] [-depth <frames>] [-timeout <secs>] [-capture <mode>] [-writers <num>] [-keep] [crashType...]
+ *         e.g. ``maya_crash_harness.exe -n 10 1 6`` will run the null pointer dereference and
+ *         stack overflow scenarios 10 times each. If no crash types are specified, all of them are run.
+ *
+ *         ``-capture`` takes one of ``MayaDumpCapture``, and ``-writers`` the number of dump writer
+ *         threads to write dumps that capture memory with (``0`` to have DbgHelp write them by
+ *         itself), so that e.g. ``-capture 2 -writers 0`` and ``-capture 2 -writers 4`` can be
+ *         compared.
+ *
+ *         ``maya_crash_harness.exe -bench <events> [-threads <num>]`` instead measures the cost of
+ *         recording compute events in the flight recorder, with a stand-in for the node computes.
+ *
+ *         ``maya_crash_harness.exe -benchnames <nodes>`` measures the cost of the DAG/DG breadcrumbs
+ *         with and without the name table, with a stand-in for a scene with that many nodes.
+ *
+ *         ``maya_crash_harness.exe -benchiat <modules> [-n <runs>]`` measures how long patching the
+ *         import address table of each newly-loaded module takes, against rescanning every module
+ *         after each load, with that many copies of a stub DLL.
+ *
+ *         ``maya_crash_harness.exe -hang <thresholdSecs> [-n <runs>]`` checks that the hang watchdog
+ *         writes a snapshot dump of a child whose main thread stops responding, within the threshold,
+ *         without stopping the child.
+ *
+ *         ``maya_crash_harness.exe -upload <crashes> [-fail <percent>] [-drop <percent>]`` runs
+ *         ``maya_crash_uploader.exe`` over a crash storm of that many crash dumps, against a stand-in
+ *         for the crash report server on the loopback interface that fails and drops that many
+ *         percent of its requests, and reports the throughput and the bytes saved.
+ *
+ *         ``maya_crash_harness.exe -headless [-n <runs>] [crashType...]`` runs the scenarios the way
+ *         a batch session handles them, and checks the exit code, the ``MAYA_CRASH`` line on
+ *         ``stderr`` and the status file of each, along with how long the child took to exit.
+ *
+ *         ``maya_crash_harness.exe -streams [-keep]`` writes one of each of the streams registered in
+ *         ``MAYA_DUMP_USER_STREAMS`` into a dump, and checks that each of them reads back out of it
+ *         through the registry with the right type, size and contents.
+ *
+ *         ``maya_crash_harness.exe -sparsedump <GB> [-budget <MB>] [-keep]`` writes a full-memory dump
+ *         of that size (at least 5 GB) as a sparse file, and checks that ``dump_reader.exe -stream``
+ *         reads all of it while its peak working set stays within the budget.
+ */
+#ifndef _WIN32
+#error "Unsupported platform for compilation."
+#endif // _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Dbghelp.h>
+#include <Psapi.h>
+#include <winioctl.h>
+#include <winsock2.h>
+#include <compressapi.h>
+
+#include <crtdbg.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "maya_custom_unhandled_exception_filter_env.h"
+#include "maya_custom_unhandled_exception_filter_crash.cpp"
+#include "maya_custom_unhandled_exception_filter_dump_writer.cpp"
+#include "maya_custom_unhandled_exception_filter_flight_recorder.cpp"
+#include "maya_custom_unhandled_exception_filter_name_table.cpp"
+#include "maya_custom_unhandled_exception_filter_self_profile.cpp"
+#include "maya_custom_unhandled_exception_filter_snapshot.cpp"
+#include "maya_custom_unhandled_exception_filter_watchdog.cpp"
+#include "maya_custom_unhandled_exception_filter_iat.cpp"
+#include "maya_custom_unhandled_exception_filter_headless.cpp"
+#include "get_exception_info.c"
+
+#define MAYA_CRASH_HARNESS_CHILD_FLAG "--child"
+#define MAYA_CRASH_HARNESS_BENCH_FLAG "-bench"
+#define MAYA_CRASH_HARNESS_BENCH_NAMES_FLAG "-benchnames"
+
+/// NOTE: (sonictk) Most of the DAG changes in a real session hit the same few thousand nodes over
+/// and over again (the controls being animated, the rig being evaluated), with the odd one anywhere
+/// else in the scene.
+#define MAYA_CRASH_HARNESS_BENCH_NAMES_HOT_SET 2000
+#define MAYA_CRASH_HARNESS_BENCH_NAMES_HOT_PERCENT 95
+#define MAYA_CRASH_HARNESS_BENCH_NAMES_EVENTS_PER_NODE 10
+
+#define MAYA_CRASH_HARNESS_DEFAULT_NUM_RUNS 5
+#define MAYA_CRASH_HARNESS_MAX_NUM_RUNS 256
+#define MAYA_CRASH_HARNESS_DEFAULT_NUM_LOAD_THREADS 32
+#define MAYA_CRASH_HARNESS_MAX_NUM_LOAD_THREADS 256
+#define MAYA_CRASH_HARNESS_DEFAULT_HEAP_MB 1024
+#define MAYA_CRASH_HARNESS_DEFAULT_STACK_DEPTH 2000
+#define MAYA_CRASH_HARNESS_MAX_STACK_DEPTH 4000
+#define MAYA_CRASH_HARNESS_DEFAULT_TIMEOUT_SECS 60
+
+#define MAYA_CRASH_HARNESS_DUMP_FILE_PREFIX "MayaCrashHarness"
+
+/// NOTE: (sonictk) These mirror the sizes of the breadcrumb buffers in the plugin, so that the
+/// dumps written by the harness are the same size as the real thing.
+#define MAYA_CRASH_HARNESS_TIMING_INFO_BLK_SIZE 32
+#define MAYA_CRASH_HARNESS_MEL_CMD_INFO_BLK_SIZE 1024
+
+#define MAYA_CRASH_HARNESS_NUM_STREAMS 6
+
+
+/// Written to by the child's crash handler, in memory shared with the parent.
+struct MayaCrashHarnessChildResult
+{
+    volatile LONG64 faultTicks;
+    volatile LONG64 dumpStartTicks;
+    volatile LONG64 dumpEndTicks;
+    volatile LONG handlerCalled;
+    volatile LONG dumpWritten;
+    DWORD exceptionCode;
+};
+
+/// The outcome of a single run of a scenario, as seen by the parent.
+struct MayaCrashHarnessRun
+{
+    double timeToDumpMs;
+    double dumpWriteMs;
+    ULONGLONG dumpSizeBytes;
+    unsigned int numStreamsRecovered;
+    bool handlerCalled;
+    bool dumpWritten;
+    bool timedOut;
+};
+
+struct MayaCrashHarnessConfig
+{
+    unsigned int numRuns;
+    unsigned int numLoadThreads;
+    unsigned int heapMB;
+    unsigned int stackDepth;
+    unsigned int timeoutSecs;
+    unsigned int dumpCapture;
+    unsigned int numDumpWriters;
+    bool keepDumps;
+};
+
+
+/// Breadcrumbs written into the child's dumps. These take the place of the plugin's .bss state.
+static char gHarnessScenePath[MAX_PATH];
+static char gHarnessTimingInfoBlk[MAYA_CRASH_HARNESS_TIMING_INFO_BLK_SIZE];
+static char gHarnessMELCmdInfoBlk[MAYA_CRASH_HARNESS_MEL_CMD_INFO_BLK_SIZE];
+static MayaCrashDumpInfo gHarnessCrashDumpInfo;
+static MayaMemorySampleRing gHarnessMemorySampleRing;
+static MayaProfilerData gHarnessProfilerData;
+
+static MayaCrashHarnessChildResult *gHarnessChildResult = NULL;
+static char gHarnessDumpFilePath[MAX_PATH] = {0};
+static int gHarnessDumpCapture = MayaDumpCapture_Normal;
+
+static volatile LONG gHarnessNumLoadThreadsPending = 0;
+static HANDLE gHarnessLoadReadyEvent = NULL;
+
+
+/**
+ * Describes the user streams that the harness writes into (and expects back out of) every dump.
+ * Each stream's buffer is filled with a byte pattern unique to that stream, so that the parent
+ * can tell whether it was recovered intact.
+ *
+ * @param streams   Storage for ``MAYA_CRASH_HARNESS_NUM_STREAMS`` streams.
+ */
+void getMayaCrashHarnessStreams(MINIDUMP_USER_STREAM *streams)
+{
+    streams[0].Type = CommentStreamA;
+    streams[0].BufferSize = sizeof(gHarnessScenePath);
+    streams[0].Buffer = gHarnessScenePath;
+
+    streams[1].Type = CommentStreamA;
+    streams[1].BufferSize = sizeof(gHarnessTimingInfoBlk);
+    streams[1].Buffer = gHarnessTimingInfoBlk;
+
+    streams[2].Type = CommentStreamA;
+    streams[2].BufferSize = sizeof(gHarnessMELCmdInfoBlk);
+    streams[2].Buffer = gHarnessMELCmdInfoBlk;
+
+    streams[3].Type = MAYA_CRASH_INFO_STREAM_TYPE;
+    streams[3].BufferSize = sizeof(gHarnessCrashDumpInfo);
+    streams[3].Buffer = &gHarnessCrashDumpInfo;
+
+    streams[4].Type = MAYA_MEMORY_SAMPLES_STREAM_TYPE;
+    streams[4].BufferSize = sizeof(gHarnessMemorySampleRing);
+    streams[4].Buffer = &gHarnessMemorySampleRing;
+
+    streams[5].Type = MAYA_PROFILER_STACKS_STREAM_TYPE;
+    streams[5].BufferSize = sizeof(gHarnessProfilerData);
+    streams[5].Buffer = &gHarnessProfilerData;
+
+    return;
+}
+
+
+inline BYTE getMayaCrashHarnessStreamPattern(unsigned int streamIdx)
+{
+    return (BYTE)(0xA0 + streamIdx);
+}
+
+
+/// Stands in for the plugin's breadcrumbs in the snapshot dumps written by the hang watchdog.
+ULONG fillMayaDumpUserStreams(MINIDUMP_USER_STREAM *streams, ULONG maxStreams, MayaDumpUserStreamStaging *staging)
+{
+    (void)staging;
+    if (maxStreams < MAYA_CRASH_HARNESS_NUM_STREAMS) {
+        return 0;
+    }
+    getMayaCrashHarnessStreams(streams);
+
+    return MAYA_CRASH_HARNESS_NUM_STREAMS;
+}
+
+
+/// The child's crash handler. Does exactly what the plugin's unhandled exception filter does,
+/// minus the message boxes, and records how long it took.
+LONG WINAPI mayaCrashHarnessExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+{
+    if (::InterlockedExchange(&gHarnessChildResult->handlerCalled, 1) != 0) {
+        return EXCEPTION_EXECUTE_HANDLER;
+    }
+
+    LARGE_INTEGER ticks;
+    ::QueryPerformanceCounter(&ticks);
+    gHarnessChildResult->dumpStartTicks = ticks.QuadPart;
+    gHarnessChildResult->exceptionCode = exceptionInfo->ExceptionRecord->ExceptionCode;
+
+    HANDLE hFile = ::CreateFileA(gHarnessDumpFilePath, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != NULL && hFile != INVALID_HANDLE_VALUE) {
+        MINIDUMP_USER_STREAM streams[MAYA_CRASH_HARNESS_NUM_STREAMS];
+        getMayaCrashHarnessStreams(streams);
+        BOOL dumpWritten = writeMayaCrashDump(hFile, exceptionInfo, streams, MAYA_CRASH_HARNESS_NUM_STREAMS, gHarnessDumpCapture);
+        // NOTE: (sonictk) The writers flush the dump to disk when they're done; do the same
+        // without them (it's next to free after they have), so that both are timed up to the
+        // same point.
+        if (dumpWritten && gHarnessDumpCapture != MayaDumpCapture_Normal) {
+            ::FlushFileBuffers(hFile);
+        }
+        ::CloseHandle(hFile);
+
+        ::QueryPerformanceCounter(&ticks);
+        gHarnessChildResult->dumpEndTicks = ticks.QuadPart;
+        gHarnessChildResult->dumpWritten = dumpWritten ? 1 : 0;
+    }
+
+    // NOTE: (sonictk) Don't let anything else (e.g. WER) get a look in; the parent only cares
+    // about what our handler did.
+    ::TerminateProcess(::GetCurrentProcess(), exceptionInfo->ExceptionRecord->ExceptionCode);
+
+    return EXCEPTION_EXECUTE_HANDLER;
+}
+
+
+LONG WINAPI mayaCrashHarnessVectoredExceptionHandler(PEXCEPTION_POINTERS exceptionInfo)
+{
+    if (!isMayaFirstChanceExceptionFatal(exceptionInfo->ExceptionRecord)) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    return mayaCrashHarnessExceptionFilter(exceptionInfo);
+}
+
+
+void __cdecl mayaCrashHarnessPurecallHandler()
+{
+    EXCEPTION_POINTERS *ppExceptionPointers = NULL;
+    GetExceptionPointers(EXCEPTION_NONCONTINUABLE, &ppExceptionPointers);
+    mayaCrashHarnessExceptionFilter(ppExceptionPointers);
+    ::ExitProcess(0);
+}
+
+
+void __cdecl mayaCrashHarnessAbortSignalHandler(int sig)
+{
+    (void)sig;
+    ::RaiseException(SIGABRT, EXCEPTION_NONCONTINUABLE, 0, NULL);
+}
+
+
+/// Recurses until the requested depth is reached, so that the dump has deep stacks to walk.
+__declspec(noinline) unsigned int recurseMayaCrashHarnessLoadThread(unsigned int depth)
+{
+    volatile char pad[128];
+    pad[depth % sizeof(pad)] = (char)depth;
+    if (depth == 0) {
+        if (::InterlockedDecrement(&gHarnessNumLoadThreadsPending) == 0) {
+            ::SetEvent(gHarnessLoadReadyEvent);
+        }
+        // NOTE: (sonictk) Keep the CPU busy so that the crash handler has to compete for it.
+        volatile unsigned int counter = 0;
+        for (;;) {
+            ++counter;
+        }
+    }
+
+    return recurseMayaCrashHarnessLoadThread(depth - 1) + pad[0];
+}
+
+
+DWORD WINAPI mayaCrashHarnessLoadThreadProc(LPVOID param)
+{
+    return (DWORD)recurseMayaCrashHarnessLoadThread((unsigned int)(uintptr_t)param);
+}
+
+
+/**
+ * The child process: sets up the load, installs the same handlers that the plugin does, and
+ * then crashes in the requested way.
+ *
+ * @return  The exit code of the child process, if it doesn't crash.
+ */
+int runMayaCrashHarnessChild(int crashType, const MayaCrashHarnessConfig *config, HANDLE hResultMapping, const char *dumpFilePath)
+{
+    gHarnessChildResult = (MayaCrashHarnessChildResult *)::MapViewOfFile(hResultMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaCrashHarnessChildResult));
+    if (gHarnessChildResult == NULL) {
+        return 2;
+    }
+    strncpy(gHarnessDumpFilePath, dumpFilePath, MAX_PATH - 1);
+    gHarnessDumpCapture = config->dumpCapture < MayaDumpCapture_Count ? (int)config->dumpCapture : MayaDumpCapture_Normal;
+    if (gHarnessDumpCapture != MayaDumpCapture_Normal && config->numDumpWriters != 0 && !startMayaDumpWriters(config->numDumpWriters)) {
+        return 2;
+    }
+
+    MINIDUMP_USER_STREAM streams[MAYA_CRASH_HARNESS_NUM_STREAMS];
+    getMayaCrashHarnessStreams(streams);
+    for (unsigned int i=0; i < MAYA_CRASH_HARNESS_NUM_STREAMS; ++i) {
+        memset(streams[i].Buffer, getMayaCrashHarnessStreamPattern(i), streams[i].BufferSize);
+    }
+
+    // NOTE: (sonictk) Touch every page so that the heap is actually committed and resident.
+    for (unsigned int i=0; i < config->heapMB; ++i) {
+        void *chunk = malloc(1024 * 1024);
+        if (chunk == NULL) {
+            break;
+        }
+        memset(chunk, (int)i, 1024 * 1024);
+    }
+
+    gHarnessLoadReadyEvent = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    gHarnessNumLoadThreadsPending = (LONG)config->numLoadThreads;
+    for (unsigned int i=0; i < config->numLoadThreads; ++i) {
+        HANDLE hThread = ::CreateThread(NULL, 0, mayaCrashHarnessLoadThreadProc, (LPVOID)(uintptr_t)config->stackDepth, 0, NULL);
+        if (hThread == NULL) {
+            if (::InterlockedDecrement(&gHarnessNumLoadThreadsPending) == 0) {
+                ::SetEvent(gHarnessLoadReadyEvent);
+            }
+            continue;
+        }
+        ::CloseHandle(hThread);
+    }
+    if (config->numLoadThreads > 0) {
+        ::WaitForSingleObject(gHarnessLoadReadyEvent, INFINITE);
+    }
+
+    // NOTE: (sonictk) Keep the CRT from popping up dialogs that would stall the run.
+    _set_abort_behavior(0, _WRITE_ABORT_MSG);
+    _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ASSERT, _CRTDBG_FILE_STDERR);
+
+    ::AddVectoredExceptionHandler(1, mayaCrashHarnessVectoredExceptionHandler);
+    ::SetUnhandledExceptionFilter(mayaCrashHarnessExceptionFilter);
+    _set_purecall_handler(mayaCrashHarnessPurecallHandler);
+    signal(SIGABRT, mayaCrashHarnessAbortSignalHandler);
+
+    LARGE_INTEGER ticks;
+    ::QueryPerformanceCounter(&ticks);
+    gHarnessChildResult->faultTicks = ticks.QuadPart;
+
+    if (!triggerMayaForceCrash(crashType)) {
+        return 2;
+    }
+
+    // NOTE: (sonictk) The crash didn't happen, or was swallowed somewhere along the way.
+    return 3;
+}
+
+
+/**
+ * Checks which of the breadcrumb streams made it into the given dump intact.
+ *
+ * @param dumpFilePath  The dump to check.
+ *
+ * @return              The number of streams that were recovered.
+ */
+unsigned int countMayaCrashHarnessStreamsRecovered(const char *dumpFilePath)
+{
+    HANDLE hFile = ::CreateFileA(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    LARGE_INTEGER fileSize;
+    ::GetFileSizeEx(hFile, &fileSize);
+    HANDLE hMapFile = ::CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapFile == NULL) {
+        ::CloseHandle(hFile);
+        return 0;
+    }
+    PBYTE pFileView = (PBYTE)::MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+    if (pFileView == NULL) {
+        ::CloseHandle(hMapFile);
+        ::CloseHandle(hFile);
+        return 0;
+    }
+
+    MINIDUMP_USER_STREAM streams[MAYA_CRASH_HARNESS_NUM_STREAMS];
+    getMayaCrashHarnessStreams(streams);
+    bool recovered[MAYA_CRASH_HARNESS_NUM_STREAMS] = {0};
+    unsigned int numRecovered = 0;
+
+    // NOTE: (sonictk) We walk the stream directory ourselves rather than going through
+    // ``MiniDumpReadDumpStream``, since that only ever finds the first stream of a given type,
+    // and there are several comment streams.
+    const MINIDUMP_HEADER *pHeader = (const MINIDUMP_HEADER *)pFileView;
+    if (fileSize.QuadPart >= (LONGLONG)sizeof(MINIDUMP_HEADER)
+        && pHeader->Signature == MINIDUMP_SIGNATURE
+        && (ULONGLONG)pHeader->StreamDirectoryRva + (ULONGLONG)pHeader->NumberOfStreams * sizeof(MINIDUMP_DIRECTORY) <= (ULONGLONG)fileSize.QuadPart) {
+        const MINIDUMP_DIRECTORY *pDir = (const MINIDUMP_DIRECTORY *)(pFileView + pHeader->StreamDirectoryRva);
+        for (ULONG i=0; i < pHeader->NumberOfStreams; ++i) {
+            const MINIDUMP_LOCATION_DESCRIPTOR *pLoc = &pDir[i].Location;
+            if ((ULONGLONG)pLoc->Rva + pLoc->DataSize > (ULONGLONG)fileSize.QuadPart) {
+                continue;
+            }
+            const BYTE *pData = pFileView + pLoc->Rva;
+            for (unsigned int j=0; j < MAYA_CRASH_HARNESS_NUM_STREAMS; ++j) {
+                if (recovered[j] || pDir[i].StreamType != streams[j].Type || pLoc->DataSize != streams[j].BufferSize) {
+                    continue;
+                }
+                const BYTE pattern = getMayaCrashHarnessStreamPattern(j);
+                bool intact = true;
+                for (ULONG k=0; k < pLoc->DataSize; ++k) {
+                    if (pData[k] != pattern) {
+                        intact = false;
+                        break;
+                    }
+                }
+                if (intact) {
+                    recovered[j] = true;
+                    ++numRecovered;
+                    break;
+                }
+            }
+        }
+    }
+
+    ::UnmapViewOfFile(pFileView);
+    ::CloseHandle(hMapFile);
+    ::CloseHandle(hFile);
+
+    return numRecovered;
+}
+
+
+/**
+ * Reads the first stream of the given type out of a dump.
+ *
+ * @param dumpFilePath  The dump to read.
+ * @param streamType    The type of the stream to read.
+ * @param buf           Storage for the stream.
+ * @param size          The size the stream is expected to be.
+ *
+ * @return              ``true`` if the stream was found and was of the expected size, ``false`` otherwise.
+ */
+bool readMayaCrashHarnessDumpStream(const char *dumpFilePath, ULONG streamType, void *buf, ULONG size)
+{
+    HANDLE hFile = ::CreateFileA(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    HANDLE hMapFile = ::CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapFile == NULL) {
+        ::CloseHandle(hFile);
+        return false;
+    }
+    PVOID pFileView = ::MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+    if (pFileView == NULL) {
+        ::CloseHandle(hMapFile);
+        ::CloseHandle(hFile);
+        return false;
+    }
+
+    PMINIDUMP_DIRECTORY pDir = NULL;
+    PVOID pStream = NULL;
+    ULONG streamSize = 0;
+    bool bStat = ::MiniDumpReadDumpStream(pFileView, streamType, &pDir, &pStream, &streamSize) && streamSize == size;
+    if (bStat) {
+        memcpy(buf, pStream, size);
+    }
+
+    ::UnmapViewOfFile(pFileView);
+    ::CloseHandle(hMapFile);
+    ::CloseHandle(hFile);
+
+    return bStat;
+}
+
+
+#include "maya_crash_harness_hang.cpp"
+
+
+/**
+ * Runs a single scenario once in a child process and collects the results.
+ *
+ * @return  ``false`` if the child process could not be run at all.
+ */
+bool runMayaCrashHarnessScenarioOnce(const char *exePath,
+                                     int crashType,
+                                     unsigned int runIdx,
+                                     const MayaCrashHarnessConfig *config,
+                                     LONGLONG timerFrequency,
+                                     MayaCrashHarnessRun *run)
+{
+    memset(run, 0, sizeof(MayaCrashHarnessRun));
+
+    SECURITY_ATTRIBUTES secAttrs = {0};
+    secAttrs.nLength = sizeof(secAttrs);
+    secAttrs.bInheritHandle = TRUE;
+    HANDLE hResultMapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, &secAttrs, PAGE_READWRITE, 0, sizeof(MayaCrashHarnessChildResult), NULL);
+    if (hResultMapping == NULL) {
+        return false;
+    }
+    MayaCrashHarnessChildResult *result = (MayaCrashHarnessChildResult *)::MapViewOfFile(hResultMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaCrashHarnessChildResult));
+    if (result == NULL) {
+        ::CloseHandle(hResultMapping);
+        return false;
+    }
+
+    char tempDirPath[MAX_PATH] = {0};
+    DWORD lenTempDirPath = ::GetEnvironmentVariableA(TEMP_ENV_VAR_NAME, tempDirPath, MAX_PATH);
+    if (lenTempDirPath == 0 || lenTempDirPath >= MAX_PATH) {
+        strncpy(tempDirPath, DEFAULT_TEMP_DIRECTORY, MAX_PATH - 1);
+    }
+    char dumpFilePath[MAX_PATH] = {0};
+    snprintf(dumpFilePath, MAX_PATH, "%s\\%s_%s_%u.dmp", tempDirPath, MAYA_CRASH_HARNESS_DUMP_FILE_PREFIX, getMayaForceCrashTypeName(crashType), runIdx);
+    ::DeleteFileA(dumpFilePath);
+
+    char cmdLine[MAX_PATH * 3] = {0};
+    snprintf(cmdLine, sizeof(cmdLine), "\"%s\" %s %d %u %u %u %u %u %llu \"%s\"",
+             exePath, MAYA_CRASH_HARNESS_CHILD_FLAG, crashType,
+             config->numLoadThreads, config->heapMB, config->stackDepth, config->dumpCapture, config->numDumpWriters,
+             (unsigned long long)(uintptr_t)hResultMapping, dumpFilePath);
+
+    STARTUPINFOA startupInfo = {0};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION procInfo = {0};
+    if (!::CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE, 0, NULL, NULL, &startupInfo, &procInfo)) {
+        ::UnmapViewOfFile(result);
+        ::CloseHandle(hResultMapping);
+        return false;
+    }
+
+    DWORD waitStat = ::WaitForSingleObject(procInfo.hProcess, config->timeoutSecs * 1000);
+    if (waitStat != WAIT_OBJECT_0) {
+        run->timedOut = true;
+        ::TerminateProcess(procInfo.hProcess, 1);
+        ::WaitForSingleObject(procInfo.hProcess, INFINITE);
+    }
+    ::CloseHandle(procInfo.hThread);
+    ::CloseHandle(procInfo.hProcess);
+
+    run->handlerCalled = result->handlerCalled != 0;
+    run->dumpWritten = result->dumpWritten != 0;
+    if (run->dumpWritten) {
+        run->timeToDumpMs = (double)(result->dumpEndTicks - result->faultTicks) * 1000.0 / (double)timerFrequency;
+        run->dumpWriteMs = (double)(result->dumpEndTicks - result->dumpStartTicks) * 1000.0 / (double)timerFrequency;
+
+        WIN32_FILE_ATTRIBUTE_DATA fileAttrs = {0};
+        if (::GetFileAttributesExA(dumpFilePath, GetFileExInfoStandard, &fileAttrs)) {
+            run->dumpSizeBytes = ((ULONGLONG)fileAttrs.nFileSizeHigh << 32) | fileAttrs.nFileSizeLow;
+        }
+        run->numStreamsRecovered = countMayaCrashHarnessStreamsRecovered(dumpFilePath);
+    }
+
+    if (!config->keepDumps) {
+        ::DeleteFileA(dumpFilePath);
+    }
+
+    ::UnmapViewOfFile(result);
+    ::CloseHandle(hResultMapping);
+
+    return true;
+}
+
+
+/// Stand-ins for the names of the nodes that would be computed in a real scene.
+static const char *gHarnessBenchNodeNames[] = {
+    "pCube1",
+    "polySmoothFace12",
+    "skinCluster3",
+    "tweak42",
+    "deformerGroupParts17",
+    "|rig|spine|spine_03_jnt|spine_03_jnt_parentConstraint1"
+};
+
+struct MayaFlightRecorderBenchThread
+{
+    HANDLE hThread;
+    unsigned int numEvents;
+    LONGLONG elapsedTicks;
+};
+
+static HANDLE gHarnessBenchStartEvent = NULL;
+
+
+DWORD WINAPI mayaFlightRecorderBenchThreadProc(LPVOID param)
+{
+    MayaFlightRecorderBenchThread *thread = (MayaFlightRecorderBenchThread *)param;
+    ::WaitForSingleObject(gHarnessBenchStartEvent, INFINITE);
+
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+    ::QueryPerformanceCounter(&start);
+    for (unsigned int i=0; i < thread->numEvents; ++i) {
+        const char *name = gHarnessBenchNodeNames[i % (ARRAY_SIZE(gHarnessBenchNodeNames))];
+        mayaFlightRecorderBeginEvent(name, MayaFlightRecorderCategory_Compute);
+        mayaFlightRecorderEndEvent(name, MayaFlightRecorderCategory_Compute);
+    }
+    ::QueryPerformanceCounter(&end);
+    thread->elapsedTicks = end.QuadPart - start.QuadPart;
+
+    return 0;
+}
+
+
+/**
+ * Has the given number of threads record begin/end pairs of events as fast as they can.
+ *
+ * @return  The average time taken per event, in nanoseconds.
+ */
+double runMayaFlightRecorderBenchOnce(unsigned int numThreads, unsigned int numEvents, LONGLONG timerFrequency)
+{
+    static MayaFlightRecorderBenchThread threads[MAYA_FLIGHT_RECORDER_MAX_THREADS];
+    gHarnessBenchStartEvent = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    for (unsigned int i=0; i < numThreads; ++i) {
+        threads[i].numEvents = numEvents;
+        threads[i].elapsedTicks = 0;
+        threads[i].hThread = ::CreateThread(NULL, 0, mayaFlightRecorderBenchThreadProc, &threads[i], 0, NULL);
+    }
+    ::SetEvent(gHarnessBenchStartEvent);
+
+    LONGLONG totalTicks = 0;
+    for (unsigned int i=0; i < numThreads; ++i) {
+        if (threads[i].hThread == NULL) {
+            continue;
+        }
+        ::WaitForSingleObject(threads[i].hThread, INFINITE);
+        ::CloseHandle(threads[i].hThread);
+        totalTicks += threads[i].elapsedTicks;
+    }
+    ::CloseHandle(gHarnessBenchStartEvent);
+    gHarnessBenchStartEvent = NULL;
+
+    const double totalEvents = 2.0 * (double)numEvents * (double)numThreads;
+
+    return (double)totalTicks * 1000000000.0 / (double)timerFrequency / totalEvents;
+}
+
+
+/// Measures the cost of recording events in the flight recorder, with recording both off and on.
+int runMayaFlightRecorderBench(unsigned int numThreads, unsigned int numEvents, LONGLONG timerFrequency)
+{
+    numThreads = numThreads == 0 ? 1 : numThreads;
+    numThreads = numThreads > MAYA_FLIGHT_RECORDER_MAX_THREADS ? MAYA_FLIGHT_RECORDER_MAX_THREADS : numThreads;
+    numEvents = numEvents == 0 ? 1 : numEvents;
+
+    stopMayaFlightRecorder();
+    const double nsOff = runMayaFlightRecorderBenchOnce(numThreads, numEvents, timerFrequency);
+    startMayaFlightRecorder();
+    const double nsOn = runMayaFlightRecorderBenchOnce(numThreads, numEvents, timerFrequency);
+    stopMayaFlightRecorder();
+
+    printf("Flight recorder: %u threads x %u begin/end pairs\n"
+           "Recording off: %8.2f ns/event\n"
+           "Recording on:  %8.2f ns/event (%.2f ns/event overhead)\n"
+           "Threads recorded: %u, dropped: %u\n",
+           numThreads, numEvents, nsOff, nsOn, nsOn - nsOff,
+           gMayaFlightRecorderData.numRings, gMayaFlightRecorderData.numDroppedThreads);
+
+    return 0;
+}
+
+
+/// What the DAG change callback used to do with each name: copy it into the crash info.
+static MayaCrashDumpInfo gHarnessBenchCrashDumpInfo;
+
+static inline size_t copyMayaHarnessBenchName(char *dst, const char *src)
+{
+    size_t len = strlen(src);
+    len = len > MAYA_DAG_PATH_MAX_NAME_LEN - 1 ? MAYA_DAG_PATH_MAX_NAME_LEN - 1 : len;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+
+    return len + 1;
+}
+
+
+/**
+ * Compares the cost of keeping the last DAG/DG names seen by copying them every time, against
+ * interning them in the name table, for a stand-in scene with ``numNodes`` nodes.
+ */
+int runMayaNameTableBench(unsigned int numNodes, LONGLONG timerFrequency)
+{
+    numNodes = numNodes < 2 ? 2 : numNodes;
+    const unsigned int hotSetSize = numNodes < MAYA_CRASH_HARNESS_BENCH_NAMES_HOT_SET ? numNodes : MAYA_CRASH_HARNESS_BENCH_NAMES_HOT_SET;
+    const unsigned int numEvents = numNodes * MAYA_CRASH_HARNESS_BENCH_NAMES_EVENTS_PER_NODE;
+
+    // NOTE: (sonictk) DAG paths as they come out of a typical rig, a few levels deep.
+    static const size_t kNameLen = 96;
+    char *names = (char *)malloc((size_t)numNodes * kNameLen);
+    unsigned int *eventNodes = (unsigned int *)malloc((size_t)numEvents * sizeof(unsigned int));
+    if (names == NULL || eventNodes == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        free(names);
+        free(eventNodes);
+        return 1;
+    }
+    for (unsigned int i=0; i < numNodes; ++i) {
+        snprintf(names + (size_t)i * kNameLen, kNameLen, "|assets|char_%02u_rig|skeleton_grp|limb_%03u_grp|ctrl_%06u", i % 37, i % 211, i);
+    }
+    uint32_t rng = 0x2545F491;
+    for (unsigned int i=0; i < numEvents; ++i) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        const bool isHot = rng % 100 < MAYA_CRASH_HARNESS_BENCH_NAMES_HOT_PERCENT;
+        eventNodes[i] = isHot ? (rng >> 8) % hotSetSize : (rng >> 8) % numNodes;
+    }
+
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+
+    // NOTE: (sonictk) Each event is a node added (every node once, up front) or a DAG change, which
+    // has a child and a parent path.
+    uint64_t bytesCopied = 0;
+    ::QueryPerformanceCounter(&start);
+    for (unsigned int i=0; i < numNodes; ++i) {
+        bytesCopied += copyMayaHarnessBenchName(gHarnessBenchCrashDumpInfo.lastDGNodeAddedName, names + (size_t)i * kNameLen);
+    }
+    for (unsigned int i=0; i < numEvents; ++i) {
+        const unsigned int node = eventNodes[i];
+        bytesCopied += copyMayaHarnessBenchName(gHarnessBenchCrashDumpInfo.lastDagChildName, names + (size_t)node * kNameLen);
+        bytesCopied += copyMayaHarnessBenchName(gHarnessBenchCrashDumpInfo.lastDagParentName, names + (size_t)(node / 2) * kNameLen);
+    }
+    ::QueryPerformanceCounter(&end);
+    const double copyNs = (double)(end.QuadPart - start.QuadPart) * 1000000000.0 / (double)timerFrequency;
+
+    volatile uint32_t lastId = 0;
+    ::QueryPerformanceCounter(&start);
+    for (unsigned int i=0; i < numNodes; ++i) {
+        lastId = internMayaName(names + (size_t)i * kNameLen);
+    }
+    for (unsigned int i=0; i < numEvents; ++i) {
+        const unsigned int node = eventNodes[i];
+        lastId = internMayaName(names + (size_t)node * kNameLen);
+        lastId = internMayaName(names + (size_t)(node / 2) * kNameLen);
+    }
+    ::QueryPerformanceCounter(&end);
+    const double internNs = (double)(end.QuadPart - start.QuadPart) * 1000000000.0 / (double)timerFrequency;
+
+    const double numNames = (double)numNodes + 2.0 * (double)numEvents;
+    const uint64_t numInserts = gMayaNameTable.numInserts;
+    uint64_t bytesInterned = 0;
+    for (uint32_t i=0; i < MAYA_NAME_TABLE_CAPACITY; ++i) {
+        bytesInterned += gMayaNameTable.entries[i].id != MAYA_NAME_TABLE_INVALID_ID ? gMayaNameTable.entries[i].len + 1 : 0;
+    }
+
+    printf("Name table: %u nodes, %u DAG changes (%u%% within %u hot nodes)\n"
+           "Copying names:   %8.2f ns/name, %12llu bytes copied (%.1f bytes/name)\n"
+           "Interning names: %8.2f ns/name, %12llu names added (%.1f%% already interned), %llu evicted\n"
+           "Name table: %.1f KB in .bss and in every dump (%u names of up to %u bytes), %.1f KB of names when the benchmark ended\n",
+           numNodes, numEvents, MAYA_CRASH_HARNESS_BENCH_NAMES_HOT_PERCENT, hotSetSize,
+           copyNs / numNames, bytesCopied, (double)bytesCopied / numNames,
+           internNs / numNames, numInserts, (1.0 - (double)numInserts / numNames) * 100.0,
+           numInserts > MAYA_NAME_TABLE_CAPACITY ? numInserts - MAYA_NAME_TABLE_CAPACITY : 0,
+           sizeof(MayaNameTable) / 1024.0, MAYA_NAME_TABLE_CAPACITY, MAYA_NAME_TABLE_NAME_LEN, bytesInterned / 1024.0);
+
+    free(names);
+    free(eventNodes);
+
+    return 0;
+}
+
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+
+#include "maya_crash_harness_iat.cpp"
+#include "maya_crash_harness_upload.cpp"
+#include "maya_crash_harness_headless.cpp"
+#include "maya_crash_harness_streams.cpp"
+#include "maya_crash_harness_sparse.cpp"
+
+
+/**
+ * Runs a scenario ``config->numRuns`` times and prints a row of the results table for it.
+ *
+ * @return  ``true`` if every dump that was written had all of its breadcrumb streams intact.
+ */
+bool runMayaCrashHarnessScenario(const char *exePath, int crashType, const MayaCrashHarnessConfig *config, LONGLONG timerFrequency)
+{
+    MayaCrashHarnessRun runs[MAYA_CRASH_HARNESS_MAX_NUM_RUNS];
+    double timesToDump[MAYA_CRASH_HARNESS_MAX_NUM_RUNS];
+    unsigned int numHandled = 0;
+    unsigned int numDumps = 0;
+    unsigned int numTimedOut = 0;
+    unsigned int minStreamsRecovered = MAYA_CRASH_HARNESS_NUM_STREAMS;
+    double maxDumpWriteMs = 0.0;
+    double totalDumpWriteMs = 0.0;
+    ULONGLONG totalDumpSizeBytes = 0;
+
+    for (unsigned int i=0; i < config->numRuns; ++i) {
+        if (!runMayaCrashHarnessScenarioOnce(exePath, crashType, i, config, timerFrequency, &runs[i])) {
+            fprintf(stderr, "Could not run the %s scenario: error %lu\n", getMayaForceCrashTypeName(crashType), ::GetLastError());
+            return false;
+        }
+        numHandled += runs[i].handlerCalled ? 1 : 0;
+        numTimedOut += runs[i].timedOut ? 1 : 0;
+        if (!runs[i].dumpWritten) {
+            continue;
+        }
+        timesToDump[numDumps++] = runs[i].timeToDumpMs;
+        totalDumpSizeBytes += runs[i].dumpSizeBytes;
+        totalDumpWriteMs += runs[i].dumpWriteMs;
+        maxDumpWriteMs = runs[i].dumpWriteMs > maxDumpWriteMs ? runs[i].dumpWriteMs : maxDumpWriteMs;
+        minStreamsRecovered = runs[i].numStreamsRecovered < minStreamsRecovered ? runs[i].numStreamsRecovered : minStreamsRecovered;
+    }
+
+    if (numDumps == 0) {
+        printf("%-20s %4u/%-4u %4u/%-4u %8u %12s %12s %12s %12s %10s %7s\n",
+               getMayaForceCrashTypeName(crashType), numHandled, config->numRuns, numDumps, config->numRuns, numTimedOut,
+               "-", "-", "-", "-", "-", "-");
+        return true;
+    }
+
+    qsort(timesToDump, numDumps, sizeof(double), compareDoubles);
+    printf("%-20s %4u/%-4u %4u/%-4u %8u %12.2f %12.2f %12.2f %12.1f %10.1f %3u/%-3u\n",
+           getMayaForceCrashTypeName(crashType), numHandled, config->numRuns, numDumps, config->numRuns, numTimedOut,
+           timesToDump[numDumps / 2], timesToDump[numDumps - 1], maxDumpWriteMs,
+           (double)totalDumpSizeBytes / (double)numDumps / 1024.0,
+           totalDumpWriteMs > 0.0 ? (double)totalDumpSizeBytes / (1024.0 * 1024.0) / (totalDumpWriteMs / 1000.0) : 0.0,
+           minStreamsRecovered, MAYA_CRASH_HARNESS_NUM_STREAMS);
+
+    return minStreamsRecovered == MAYA_CRASH_HARNESS_NUM_STREAMS;
+}
+
+
+int main(int argc, char *argv[])
+{
+    MayaCrashHarnessConfig config = {0};
+    config.numRuns = MAYA_CRASH_HARNESS_DEFAULT_NUM_RUNS;
+    config.numLoadThreads = MAYA_CRASH_HARNESS_DEFAULT_NUM_LOAD_THREADS;
+    config.heapMB = MAYA_CRASH_HARNESS_DEFAULT_HEAP_MB;
+    config.stackDepth = MAYA_CRASH_HARNESS_DEFAULT_STACK_DEPTH;
+    config.timeoutSecs = MAYA_CRASH_HARNESS_DEFAULT_TIMEOUT_SECS;
+    config.dumpCapture = MayaDumpCapture_Normal;
+    config.numDumpWriters = MAYA_DUMP_WRITERS_DEFAULT_NUM_THREADS;
+
+    // NOTE: (sonictk) The child process is invoked as:
+    // ``--child <crashType> <numLoadThreads> <heapMB> <stackDepth> <dumpCapture> <numDumpWriters> <resultMappingHandle> <dumpFilePath>``
+    if (argc == 4 && strcmp(argv[1], MAYA_CRASH_HARNESS_HANG_CHILD_FLAG) == 0) {
+        HANDLE hResultMapping = (HANDLE)(uintptr_t)_strtoui64(argv[3], NULL, 10);
+        return runMayaCrashHarnessHangChild((unsigned int)strtoul(argv[2], NULL, 10), hResultMapping);
+    }
+    if (argc == 5 && strcmp(argv[1], MAYA_CRASH_HARNESS_HEADLESS_CHILD_FLAG) == 0) {
+        HANDLE hResultMapping = (HANDLE)(uintptr_t)_strtoui64(argv[3], NULL, 10);
+        return runMayaCrashHarnessHeadlessChild(atoi(argv[2]), hResultMapping, argv[4]);
+    }
+    if (argc == 10 && strcmp(argv[1], MAYA_CRASH_HARNESS_CHILD_FLAG) == 0) {
+        int crashType = atoi(argv[2]);
+        config.numLoadThreads = (unsigned int)strtoul(argv[3], NULL, 10);
+        config.heapMB = (unsigned int)strtoul(argv[4], NULL, 10);
+        config.stackDepth = (unsigned int)strtoul(argv[5], NULL, 10);
+        config.dumpCapture = (unsigned int)strtoul(argv[6], NULL, 10);
+        config.numDumpWriters = (unsigned int)strtoul(argv[7], NULL, 10);
+        HANDLE hResultMapping = (HANDLE)(uintptr_t)_strtoui64(argv[8], NULL, 10);
+        return runMayaCrashHarnessChild(crashType, &config, hResultMapping, argv[9]);
+    }
+
+    int crashTypes[MayaForceCrashType_Count] = {0};
+    int numCrashTypes = 0;
+    unsigned int numBenchEvents = 0;
+    unsigned int numBenchNodes = 0;
+    unsigned int hangThresholdSecs = 0;
+    unsigned int numBenchModules = 0;
+    unsigned int numUploadCrashes = 0;
+    bool runHeadless = false;
+    bool runStreams = false;
+    unsigned int sparseDumpGB = 0;
+    unsigned int sparseBudgetMB = MAYA_CRASH_HARNESS_SPARSE_DEFAULT_BUDGET_MB;
+    unsigned int uploadFailPercent = MAYA_CRASH_HARNESS_UPLOAD_DEFAULT_FAIL_PERCENT;
+    unsigned int uploadDropPercent = MAYA_CRASH_HARNESS_UPLOAD_DEFAULT_DROP_PERCENT;
+    for (int i=1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-n") == 0 && i + 1 < argc) {
+            config.numRuns = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-threads") == 0 && i + 1 < argc) {
+            config.numLoadThreads = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-heapmb") == 0 && i + 1 < argc) {
+            config.heapMB = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-depth") == 0 && i + 1 < argc) {
+            config.stackDepth = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-timeout") == 0 && i + 1 < argc) {
+            config.timeoutSecs = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-capture") == 0 && i + 1 < argc) {
+            config.dumpCapture = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-writers") == 0 && i + 1 < argc) {
+            config.numDumpWriters = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-keep") == 0) {
+            config.keepDumps = true;
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_BENCH_FLAG) == 0 && i + 1 < argc) {
+            numBenchEvents = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_BENCH_NAMES_FLAG) == 0 && i + 1 < argc) {
+            numBenchNodes = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_BENCH_IAT_FLAG) == 0 && i + 1 < argc) {
+            numBenchModules = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_HANG_FLAG) == 0 && i + 1 < argc) {
+            hangThresholdSecs = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_UPLOAD_FLAG) == 0 && i + 1 < argc) {
+            numUploadCrashes = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-fail") == 0 && i + 1 < argc) {
+            uploadFailPercent = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-drop") == 0 && i + 1 < argc) {
+            uploadDropPercent = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_HEADLESS_FLAG) == 0) {
+            runHeadless = true;
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_STREAMS_FLAG) == 0) {
+            runStreams = true;
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_SPARSE_FLAG) == 0 && i + 1 < argc) {
+            sparseDumpGB = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, MAYA_CRASH_HARNESS_SPARSE_BUDGET_FLAG) == 0 && i + 1 < argc) {
+            sparseBudgetMB = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else {
+            int crashType = atoi(arg);
+            if (crashType <= MayaForceCrashType_NoCrash || crashType >= MayaForceCrashType_Count) {
+                fprintf(stderr, "Invalid crash type: %s\n", arg);
+                return 1;
+            }
+            if (numCrashTypes < MayaForceCrashType_Count) {
+                crashTypes[numCrashTypes++] = crashType;
+            }
+        }
+    }
+    if (numCrashTypes == 0) {
+        for (int i=MayaForceCrashType_NoCrash + 1; i < MayaForceCrashType_Count; ++i) {
+            crashTypes[numCrashTypes++] = i;
+        }
+    }
+
+    config.numRuns = config.numRuns == 0 ? 1 : config.numRuns;
+    config.numRuns = config.numRuns > MAYA_CRASH_HARNESS_MAX_NUM_RUNS ? MAYA_CRASH_HARNESS_MAX_NUM_RUNS : config.numRuns;
+    config.numLoadThreads = config.numLoadThreads > MAYA_CRASH_HARNESS_MAX_NUM_LOAD_THREADS ? MAYA_CRASH_HARNESS_MAX_NUM_LOAD_THREADS : config.numLoadThreads;
+    config.stackDepth = config.stackDepth > MAYA_CRASH_HARNESS_MAX_STACK_DEPTH ? MAYA_CRASH_HARNESS_MAX_STACK_DEPTH : config.stackDepth;
+    config.dumpCapture = config.dumpCapture >= MayaDumpCapture_Count ? MayaDumpCapture_Normal : config.dumpCapture;
+    config.numDumpWriters = config.numDumpWriters > MAYA_DUMP_WRITERS_MAX_NUM_THREADS ? MAYA_DUMP_WRITERS_MAX_NUM_THREADS : config.numDumpWriters;
+
+    char exePath[MAX_PATH] = {0};
+    ::GetModuleFileNameA(NULL, exePath, MAX_PATH);
+
+    // NOTE: (sonictk) Inherited by the children, so that crashes the handler misses don't end
+    // up sitting in a WER dialog until the run times out.
+    ::SetErrorMode(SEM_FAILCRITICALERRORS|SEM_NOGPFAULTERRORBOX);
+
+    LARGE_INTEGER freq;
+    ::QueryPerformanceFrequency(&freq);
+
+    if (numBenchEvents != 0) {
+        return runMayaFlightRecorderBench(config.numLoadThreads, numBenchEvents, freq.QuadPart);
+    }
+    if (numBenchNodes != 0) {
+        return runMayaNameTableBench(numBenchNodes, freq.QuadPart);
+    }
+    if (numBenchModules != 0) {
+        return runMayaIATBench(exePath, numBenchModules, config.numRuns, freq.QuadPart);
+    }
+    if (hangThresholdSecs != 0) {
+        return runMayaCrashHarnessHang(exePath, hangThresholdSecs, &config, freq.QuadPart);
+    }
+    if (numUploadCrashes != 0) {
+        return runMayaCrashHarnessUpload(exePath, numUploadCrashes, uploadFailPercent, uploadDropPercent, &config, freq.QuadPart);
+    }
+
+    if (sparseDumpGB != 0) {
+        return runMayaCrashHarnessSparseDump(exePath, sparseDumpGB, sparseBudgetMB, &config, freq.QuadPart);
+    }
+    if (runStreams) {
+        return runMayaCrashHarnessStreams(&config);
+    }
+    if (runHeadless) {
+        return runMayaCrashHarnessHeadless(exePath, crashTypes, numCrashTypes, &config, freq.QuadPart);
+    }
+
+    printf("Runs per scenario: %u, load threads: %u, heap: %u MB, stack depth: %u frames, dump capture: %u, dump writers: %u\n\n",
+           config.numRuns, config.numLoadThreads, config.heapMB, config.stackDepth,
+           config.dumpCapture, config.dumpCapture == MayaDumpCapture_Normal ? 0 : config.numDumpWriters);
+    printf("%-20s %9s %9s %8s %12s %12s %12s %12s %10s %7s\n",
+           "Scenario", "Handled", "Dumps", "Timeouts", "Median (ms)", "Max (ms)", "Write (ms)", "Size (KB)", "MB/s", "Streams");
+
+    int numFailed = 0;
+    for (int i=0; i < numCrashTypes; ++i) {
+        if (!runMayaCrashHarnessScenario(exePath, crashTypes[i], &config, freq.QuadPart)) {
+            ++numFailed;
+        }
+    }
+
+    return numFailed;
+}
@@ -0,0 +1,306 @@
+/**
+ * @file   maya_crash_harness_sparse.cpp
+ * @brief  ``maya_crash_harness.exe -sparsedump <GB> [-budget <MB>] [-keep]`` checks that
+ *         ``dump_reader.exe -stream`` stays within its memory budget on a dump larger than 4 GB.
+ *         A full-memory dump of that size is put together as a sparse file, so it takes up next
+ *         to no disk space: only the streams at the start and the first page of each memory range
+ *         are actually written, and the rest reads back as zeros. The reader is then run over it,
+ *         and the harness checks that:
+ *
+ *         - the reader succeeded, and read and scanned all of the memory, including the ranges
+ *           that lie past 4 GB into the file;
+ *         - the peak working set of the reader stayed within the budget.
+ */
+
+#define MAYA_CRASH_HARNESS_SPARSE_FLAG "-sparsedump"
+#define MAYA_CRASH_HARNESS_SPARSE_BUDGET_FLAG "-budget"
+#define MAYA_CRASH_HARNESS_SPARSE_DUMP_FILE_PREFIX "MayaCrashHarnessSparse"
+#define MAYA_CRASH_HARNESS_DUMP_READER_EXE_NAME "dump_reader.exe"
+
+/// NOTE: (sonictk) Anything up to 4 GB would not need 64-bit offsets to read.
+#define MAYA_CRASH_HARNESS_SPARSE_MIN_GB 5
+#define MAYA_CRASH_HARNESS_SPARSE_DEFAULT_BUDGET_MB 64
+#define MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE (256ULL * 1024 * 1024)
+#define MAYA_CRASH_HARNESS_SPARSE_RANGE_GAP (64ULL * 1024)
+#define MAYA_CRASH_HARNESS_SPARSE_BASE_ADDRESS 0x10000000000ULL
+#define MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE 4096
+#define MAYA_CRASH_HARNESS_SPARSE_SECS_PER_GB 10
+
+/// NOTE: (sonictk) The reader's image, the CRT and DbgHelp are in its working set as well, on top
+/// of what it allocates out of the budget.
+#define MAYA_CRASH_HARNESS_SPARSE_RSS_SLACK_MB 16
+
+#define MAYA_CRASH_HARNESS_SPARSE_MAX_OUTPUT_BYTES (64 * 1024)
+
+
+/**
+ * Writes a full-memory dump of the given size as a sparse file. The dump has a memory info list
+ * and a memory list of ``numRanges`` ranges of private read-write memory, one after the other.
+ *
+ * @param dumpFilePath  The dump to write.
+ * @param numRanges     The number of memory ranges.
+ * @param memoryBytes   Storage for the size of the memory in the dump.
+ * @param fileBytes     Storage for the size of the dump.
+ *
+ * @return              ``true`` if the dump was written, ``false`` otherwise.
+ */
+static bool writeMayaCrashHarnessSparseDump(const char *dumpFilePath, uint32_t numRanges, uint64_t *memoryBytes, uint64_t *fileBytes)
+{
+    HANDLE hFile = ::CreateFileA(dumpFilePath, GENERIC_READ|GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Could not create %s: error %lu\n", dumpFilePath, ::GetLastError());
+        return false;
+    }
+    // NOTE: (sonictk) Rather not write GBs of zeros to a volume that can't do sparse files.
+    DWORD bytesReturned = 0;
+    if (!::DeviceIoControl(hFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytesReturned, NULL)) {
+        fprintf(stderr, "Could not make %s sparse: error %lu\n", dumpFilePath, ::GetLastError());
+        ::CloseHandle(hFile);
+        ::DeleteFileA(dumpFilePath);
+        return false;
+    }
+
+    const ULONG32 numStreams = 2;
+    const uint64_t memoryInfoListSize = sizeof(MINIDUMP_MEMORY_INFO_LIST) + (uint64_t)numRanges * sizeof(MINIDUMP_MEMORY_INFO);
+    const uint64_t memoryListSize = sizeof(MINIDUMP_MEMORY64_LIST) + (uint64_t)numRanges * sizeof(MINIDUMP_MEMORY_DESCRIPTOR64);
+    const uint64_t dirRva = sizeof(MINIDUMP_HEADER);
+    const uint64_t memoryInfoListRva = dirRva + numStreams * sizeof(MINIDUMP_DIRECTORY);
+    const uint64_t memoryListRva = memoryInfoListRva + memoryInfoListSize;
+    const uint64_t baseRva = (memoryListRva + memoryListSize + MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE - 1) & ~(uint64_t)(MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE - 1);
+    *memoryBytes = (uint64_t)numRanges * MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE;
+    *fileBytes = baseRva + *memoryBytes;
+
+    BYTE *prefix = (BYTE *)calloc((size_t)baseRva, 1);
+    BYTE *page = (BYTE *)malloc(MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE);
+    if (prefix == NULL || page == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        free(prefix);
+        free(page);
+        ::CloseHandle(hFile);
+        ::DeleteFileA(dumpFilePath);
+        return false;
+    }
+
+    MINIDUMP_HEADER *header = (MINIDUMP_HEADER *)prefix;
+    header->Signature = MINIDUMP_SIGNATURE;
+    header->Version = MINIDUMP_VERSION;
+    header->NumberOfStreams = numStreams;
+    header->StreamDirectoryRva = (RVA)dirRva;
+    header->Flags = MiniDumpWithFullMemory|MiniDumpWithFullMemoryInfo;
+
+    MINIDUMP_DIRECTORY *dir = (MINIDUMP_DIRECTORY *)(prefix + dirRva);
+    dir[0].StreamType = MemoryInfoListStream;
+    dir[0].Location.DataSize = (ULONG32)memoryInfoListSize;
+    dir[0].Location.Rva = (RVA)memoryInfoListRva;
+    dir[1].StreamType = Memory64ListStream;
+    dir[1].Location.DataSize = (ULONG32)memoryListSize;
+    dir[1].Location.Rva = (RVA)memoryListRva;
+
+    MINIDUMP_MEMORY_INFO_LIST *memoryInfoList = (MINIDUMP_MEMORY_INFO_LIST *)(prefix + memoryInfoListRva);
+    memoryInfoList->SizeOfHeader = sizeof(MINIDUMP_MEMORY_INFO_LIST);
+    memoryInfoList->SizeOfEntry = sizeof(MINIDUMP_MEMORY_INFO);
+    memoryInfoList->NumberOfEntries = numRanges;
+    MINIDUMP_MEMORY_INFO *memoryInfos = (MINIDUMP_MEMORY_INFO *)(memoryInfoList + 1);
+
+    MINIDUMP_MEMORY64_LIST *memoryList = (MINIDUMP_MEMORY64_LIST *)(prefix + memoryListRva);
+    memoryList->NumberOfMemoryRanges = numRanges;
+    memoryList->BaseRva = baseRva;
+
+    for (uint32_t i=0; i < numRanges; ++i) {
+        const uint64_t address = MAYA_CRASH_HARNESS_SPARSE_BASE_ADDRESS + (uint64_t)i * (MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE + MAYA_CRASH_HARNESS_SPARSE_RANGE_GAP);
+        MINIDUMP_MEMORY_INFO *info = &memoryInfos[i];
+        info->BaseAddress = address;
+        info->AllocationBase = address;
+        info->AllocationProtect = PAGE_READWRITE;
+        info->RegionSize = MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE;
+        info->State = MEM_COMMIT;
+        info->Protect = PAGE_READWRITE;
+        info->Type = MEM_PRIVATE;
+
+        memoryList->MemoryRanges[i].StartOfMemoryRange = address;
+        memoryList->MemoryRanges[i].DataSize = MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE;
+    }
+
+    DWORD bytesWritten = 0;
+    bool bStat = ::WriteFile(hFile, prefix, (DWORD)baseRva, &bytesWritten, NULL) && bytesWritten == (DWORD)baseRva;
+
+    // NOTE: (sonictk) The first page of each range is written out for real, so that the reader
+    // has data to get through all the way to the end of the file, not just holes.
+    for (uint32_t i=0; i < numRanges && bStat; ++i) {
+        memset(page, (int)(0x11 + i % 0xEE), MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE);
+        LARGE_INTEGER offset;
+        offset.QuadPart = (LONGLONG)(baseRva + (uint64_t)i * MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE);
+        bStat = ::SetFilePointerEx(hFile, offset, NULL, FILE_BEGIN)
+            && ::WriteFile(hFile, page, MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE, &bytesWritten, NULL)
+            && bytesWritten == MAYA_CRASH_HARNESS_SPARSE_PAGE_SIZE;
+    }
+    LARGE_INTEGER endOffset;
+    endOffset.QuadPart = (LONGLONG)*fileBytes;
+    bStat = bStat && ::SetFilePointerEx(hFile, endOffset, NULL, FILE_BEGIN) && ::SetEndOfFile(hFile);
+    if (!bStat) {
+        fprintf(stderr, "Could not write %s: error %lu\n", dumpFilePath, ::GetLastError());
+    }
+
+    free(prefix);
+    free(page);
+    ::CloseHandle(hFile);
+    if (!bStat) {
+        ::DeleteFileA(dumpFilePath);
+    }
+
+    return bStat;
+}
+
+
+/**
+ * Runs ``dump_reader.exe -stream`` over a sparse dump larger than 4 GB, and checks that it read
+ * all of it within its budget.
+ *
+ * @param exePath   The path of the harness; the reader is expected next to it.
+ * @param sizeGB    The size of the memory in the dump, in GB.
+ * @param budgetMB  The memory budget to give the reader, in MB.
+ * @param config    How long to wait for the reader at the least, and whether to keep the dump.
+ *
+ * @return          The number of checks that failed.
+ */
+int runMayaCrashHarnessSparseDump(const char *exePath, unsigned int sizeGB, unsigned int budgetMB, const MayaCrashHarnessConfig *config, LONGLONG timerFrequency)
+{
+    sizeGB = sizeGB < MAYA_CRASH_HARNESS_SPARSE_MIN_GB ? MAYA_CRASH_HARNESS_SPARSE_MIN_GB : sizeGB;
+    budgetMB = budgetMB == 0 ? MAYA_CRASH_HARNESS_SPARSE_DEFAULT_BUDGET_MB : budgetMB;
+    const uint32_t numRanges = (uint32_t)(((uint64_t)sizeGB << 30) / MAYA_CRASH_HARNESS_SPARSE_RANGE_SIZE);
+
+    char readerPath[MAX_PATH] = {0};
+    strncpy(readerPath, exePath, MAX_PATH - 1);
+    char *exeName = strrchr(readerPath, '\\');
+    exeName = exeName == NULL ? readerPath : exeName + 1;
+    snprintf(exeName, (size_t)(MAX_PATH - (exeName - readerPath)), "%s", MAYA_CRASH_HARNESS_DUMP_READER_EXE_NAME);
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    char dumpFilePath[MAX_PATH] = {0};
+    snprintf(dumpFilePath, MAX_PATH, "%s\\%s_%lu.dmp", tempDirPath, MAYA_CRASH_HARNESS_SPARSE_DUMP_FILE_PREFIX, ::GetCurrentProcessId());
+    char outputFilePath[MAX_PATH] = {0};
+    snprintf(outputFilePath, MAX_PATH, "%s\\%s_%lu.txt", tempDirPath, MAYA_CRASH_HARNESS_SPARSE_DUMP_FILE_PREFIX, ::GetCurrentProcessId());
+
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+    ::QueryPerformanceCounter(&start);
+    uint64_t memoryBytes = 0;
+    uint64_t fileBytes = 0;
+    if (!writeMayaCrashHarnessSparseDump(dumpFilePath, numRanges, &memoryBytes, &fileBytes)) {
+        return 1;
+    }
+    ::QueryPerformanceCounter(&end);
+    DWORD allocatedHigh = 0;
+    const DWORD allocatedLow = ::GetCompressedFileSizeA(dumpFilePath, &allocatedHigh);
+    const uint64_t allocatedBytes = ((uint64_t)allocatedHigh << 32) | allocatedLow;
+
+    const double bytesToMB = 1.0 / (1024.0 * 1024.0);
+    printf("Sparse dump: %.1f MB of memory in %u ranges, %.1f MB file, %.1f MB on disk, written in %.3f s\n",
+           memoryBytes * bytesToMB, numRanges, fileBytes * bytesToMB, allocatedBytes * bytesToMB,
+           (double)(end.QuadPart - start.QuadPart) / (double)timerFrequency);
+
+    // NOTE: (sonictk) The reader's output goes to a file rather than a pipe, so that nothing it
+    // writes can block it and the parent never has to read while it waits.
+    SECURITY_ATTRIBUTES secAttrs = {0};
+    secAttrs.nLength = sizeof(secAttrs);
+    secAttrs.bInheritHandle = TRUE;
+    HANDLE hOutput = ::CreateFileA(outputFilePath, GENERIC_WRITE, FILE_SHARE_READ, &secAttrs, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hOutput == INVALID_HANDLE_VALUE) {
+        if (!config->keepDumps) {
+            ::DeleteFileA(dumpFilePath);
+        }
+        return 1;
+    }
+
+    char cmdLine[MAX_PATH * 3] = {0};
+    snprintf(cmdLine, sizeof(cmdLine), "\"%s\" -stream \"%s\" %u", readerPath, dumpFilePath, budgetMB);
+    STARTUPINFOA startupInfo = {0};
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdInput = ::GetStdHandle(STD_INPUT_HANDLE);
+    startupInfo.hStdOutput = hOutput;
+    startupInfo.hStdError = hOutput;
+    PROCESS_INFORMATION procInfo = {0};
+    ::QueryPerformanceCounter(&start);
+    BOOL bStat = ::CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE, 0, NULL, NULL, &startupInfo, &procInfo);
+    ::CloseHandle(hOutput);
+    if (!bStat) {
+        fprintf(stderr, "Could not run %s: error %lu\n", readerPath, ::GetLastError());
+        ::DeleteFileA(outputFilePath);
+        if (!config->keepDumps) {
+            ::DeleteFileA(dumpFilePath);
+        }
+        return 1;
+    }
+
+    const unsigned int timeoutSecs = sizeGB * MAYA_CRASH_HARNESS_SPARSE_SECS_PER_GB > config->timeoutSecs
+        ? sizeGB * MAYA_CRASH_HARNESS_SPARSE_SECS_PER_GB : config->timeoutSecs;
+    const bool timedOut = ::WaitForSingleObject(procInfo.hProcess, timeoutSecs * 1000) != WAIT_OBJECT_0;
+    ::QueryPerformanceCounter(&end);
+    if (timedOut) {
+        ::TerminateProcess(procInfo.hProcess, 1);
+        ::WaitForSingleObject(procInfo.hProcess, INFINITE);
+    }
+    DWORD exitCode = 1;
+    ::GetExitCodeProcess(procInfo.hProcess, &exitCode);
+
+    // NOTE: (sonictk) Measured from here rather than taken from what the reader prints, so that
+    // the check doesn't rely on the reader's own accounting.
+    PROCESS_MEMORY_COUNTERS memCounters;
+    memset(&memCounters, 0, sizeof(memCounters));
+    const bool haveMemCounters = ::GetProcessMemoryInfo(procInfo.hProcess, &memCounters, sizeof(memCounters)) == TRUE;
+    ::CloseHandle(procInfo.hThread);
+    ::CloseHandle(procInfo.hProcess);
+
+    char *output = (char *)calloc(MAYA_CRASH_HARNESS_SPARSE_MAX_OUTPUT_BYTES + 1, 1);
+    double streamedMB = 0.0;
+    double scannedMB = 0.0;
+    if (output != NULL) {
+        HANDLE hRead = ::CreateFileA(outputFilePath, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        DWORD bytesRead = 0;
+        if (hRead != INVALID_HANDLE_VALUE) {
+            ::ReadFile(hRead, output, MAYA_CRASH_HARNESS_SPARSE_MAX_OUTPUT_BYTES, &bytesRead, NULL);
+            ::CloseHandle(hRead);
+        }
+        const char *streamedLine = strstr(output, "Streamed ");
+        if (streamedLine != NULL) {
+            sscanf(streamedLine, "Streamed %lf MB", &streamedMB);
+        }
+        const char *scannedLine = strstr(output, " vtable pointers in ");
+        if (scannedLine != NULL) {
+            sscanf(scannedLine, " vtable pointers in %lf MB scanned", &scannedMB);
+        }
+    }
+
+    const double memoryMB = memoryBytes * bytesToMB;
+    const double peakMB = memCounters.PeakWorkingSetSize * bytesToMB;
+    // NOTE: (sonictk) The reader prints its sizes to a tenth of a MB.
+    const bool readAll = streamedMB + 0.1 >= memoryMB;
+    const bool scannedAll = scannedMB + 0.1 >= memoryMB && scannedMB - 0.1 <= memoryMB;
+    const bool withinBudget = haveMemCounters && peakMB <= (double)(budgetMB + MAYA_CRASH_HARNESS_SPARSE_RSS_SLACK_MB);
+
+    printf("%-24s %s\n", "Reader", timedOut ? "TIMED OUT" : (exitCode == 0 ? "ok" : "FAILED"));
+    printf("%-24s %.1f of %.1f MB %s\n", "Read", streamedMB, memoryMB, readAll ? "ok" : "FAILED");
+    printf("%-24s %.1f of %.1f MB %s\n", "Scanned", scannedMB, memoryMB, scannedAll ? "ok" : "FAILED");
+    printf("%-24s %.1f MB of a %u MB budget (+%u MB) %s\n", "Peak working set", peakMB, budgetMB,
+           MAYA_CRASH_HARNESS_SPARSE_RSS_SLACK_MB, withinBudget ? "ok" : "FAILED");
+    printf("%-24s %.3f s\n", "Elapsed", (double)(end.QuadPart - start.QuadPart) / (double)timerFrequency);
+
+    int numFailed = 0;
+    numFailed += !timedOut && exitCode == 0 ? 0 : 1;
+    numFailed += readAll ? 0 : 1;
+    numFailed += scannedAll ? 0 : 1;
+    numFailed += withinBudget ? 0 : 1;
+    if (numFailed != 0 && output != NULL) {
+        printf("\nReader output:\n%s\n", output);
+    }
+
+    free(output);
+    ::DeleteFileA(outputFilePath);
+    if (!config->keepDumps) {
+        ::DeleteFileA(dumpFilePath);
+    }
+
+    return numFailed;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file   maya_crash_harness_streams.cpp
+ * @brief  ``maya_crash_harness.exe -streams [-keep]`` round-trips every stream in
+ *         ``MAYA_DUMP_USER_STREAMS`` through a real dump. One stream of each is written into a dump
+ *         the same way the exception filter writes its dump, and each one is then read back out of
+ *         the stream directory through the registry. The harness checks that:
+ *
+ *         - the type found in the directory maps back to the stream that was written, and no
+ *           stream turns up twice;
+ *         - ``isMayaDumpUserStreamSizeValid`` accepts the size the stream came back with, and that
+ *           size is the one that was written;
+ *         - the stream came back with the same contents;
+ *         - ``isMayaDumpUserStreamSizeValid`` rejects the sizes just either side of each layout.
+ */
+
+#define MAYA_CRASH_HARNESS_STREAMS_FLAG "-streams"
+#define MAYA_CRASH_HARNESS_STREAMS_DUMP_FILE_PREFIX "MayaCrashHarnessStreams"
+
+/// NOTE: (sonictk) How much data the streams of variable size get after their header, on top of
+/// their index, so that no two of them are the same size.
+#define MAYA_CRASH_HARNESS_STREAMS_VARIABLE_DATA_BYTES 4096
+
+/// Raised and handled by the harness itself, so that the dump is written with an exception record
+/// the way the exception filter writes it.
+#define MAYA_CRASH_HARNESS_STREAMS_EXCEPTION_CODE 0xE0000002
+
+
+/// What was found of a single stream when it was read back.
+struct MayaCrashHarnessStreamsResult
+{
+    ULONG sizeRead;
+    unsigned int numFound;
+    bool sizeValid;
+    bool contentsMatch;
+};
+
+
+inline BYTE getMayaCrashHarnessStreamsByte(unsigned int streamIdx, ULONG offset)
+{
+    return (BYTE)(streamIdx * 31 + offset * 7 + 1);
+}
+
+
+/// Writes the dump from within the exception, the same way the exception filter does.
+static LONG mayaCrashHarnessStreamsDumpFilter(LPEXCEPTION_POINTERS exceptionInfo,
+                                              HANDLE hFile,
+                                              MINIDUMP_USER_STREAM *streams,
+                                              ULONG numStreams,
+                                              BOOL *dumpWritten)
+{
+    *dumpWritten = writeMayaCrashDump(hFile, exceptionInfo, streams, numStreams, MayaDumpCapture_Normal);
+
+    return EXCEPTION_EXECUTE_HANDLER;
+}
+
+
+/**
+ * Writes a dump with one of each registered stream in it.
+ *
+ * @param dumpFilePath  The dump to write.
+ * @param streams       The streams to write.
+ * @param numStreams    The number of streams.
+ *
+ * @return              ``true`` if the dump was written, ``false`` otherwise.
+ */
+static bool writeMayaCrashHarnessStreamsDump(const char *dumpFilePath, MINIDUMP_USER_STREAM *streams, ULONG numStreams)
+{
+    HANDLE hFile = ::CreateFileA(dumpFilePath, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    BOOL dumpWritten = FALSE;
+    __try {
+        ::RaiseException(MAYA_CRASH_HARNESS_STREAMS_EXCEPTION_CODE, 0, 0, NULL);
+    } __except (mayaCrashHarnessStreamsDumpFilter(GetExceptionInformation(), hFile, streams, numStreams, &dumpWritten)) {
+    }
+    ::CloseHandle(hFile);
+
+    return dumpWritten == TRUE;
+}
+
+
+/**
+ * Reads every one of our streams back out of the stream directory of the dump, through the registry.
+ *
+ * @param dumpFilePath  The dump to read.
+ * @param streams       The streams that were written, indexed by ``MayaDumpUserStream``.
+ * @param results       Storage for what was found of each stream, indexed by ``MayaDumpUserStream``.
+ *
+ * @return              ``true`` if the dump could be read, ``false`` otherwise.
+ */
+static bool readMayaCrashHarnessStreamsDump(const char *dumpFilePath, const MINIDUMP_USER_STREAM *streams, MayaCrashHarnessStreamsResult *results)
+{
+    HANDLE hFile = ::CreateFileA(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    ::GetFileSizeEx(hFile, &fileSize);
+    HANDLE hMapFile = ::CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapFile == NULL) {
+        ::CloseHandle(hFile);
+        return false;
+    }
+    PBYTE pFileView = (PBYTE)::MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+    if (pFileView == NULL) {
+        ::CloseHandle(hMapFile);
+        ::CloseHandle(hFile);
+        return false;
+    }
+
+    // NOTE: (sonictk) We walk the stream directory ourselves rather than going through
+    // ``MiniDumpReadDumpStream``, so that a stream written twice shows up as such.
+    bool bStat = false;
+    const MINIDUMP_HEADER *pHeader = (const MINIDUMP_HEADER *)pFileView;
+    if (fileSize.QuadPart >= (LONGLONG)sizeof(MINIDUMP_HEADER)
+        && pHeader->Signature == MINIDUMP_SIGNATURE
+        && (ULONGLONG)pHeader->StreamDirectoryRva + (ULONGLONG)pHeader->NumberOfStreams * sizeof(MINIDUMP_DIRECTORY) <= (ULONGLONG)fileSize.QuadPart) {
+        bStat = true;
+        const MINIDUMP_DIRECTORY *pDir = (const MINIDUMP_DIRECTORY *)(pFileView + pHeader->StreamDirectoryRva);
+        for (ULONG i=0; i < pHeader->NumberOfStreams; ++i) {
+            const MayaDumpUserStream stream = findMayaDumpUserStream(pDir[i].StreamType);
+            if (stream == MayaDumpUserStream_Count) {
+                continue;
+            }
+            MayaCrashHarnessStreamsResult *result = &results[stream];
+            const MINIDUMP_LOCATION_DESCRIPTOR *pLoc = &pDir[i].Location;
+            ++result->numFound;
+            result->sizeRead = pLoc->DataSize;
+            result->sizeValid = isMayaDumpUserStreamSizeValid(stream, pLoc->DataSize);
+            result->contentsMatch = false;
+            if (pLoc->DataSize != streams[stream].BufferSize || (ULONGLONG)pLoc->Rva + pLoc->DataSize > (ULONGLONG)fileSize.QuadPart) {
+                continue;
+            }
+            result->contentsMatch = memcmp(pFileView + pLoc->Rva, streams[stream].Buffer, pLoc->DataSize) == 0;
+        }
+    }
+
+    ::UnmapViewOfFile(pFileView);
+    ::CloseHandle(hMapFile);
+    ::CloseHandle(hFile);
+
+    return bStat;
+}
+
+
+/**
+ * Round-trips every registered stream through a dump, and prints what came back of each.
+ *
+ * @return  The number of checks that failed.
+ */
+int runMayaCrashHarnessStreams(const MayaCrashHarnessConfig *config)
+{
+    MINIDUMP_USER_STREAM streams[MayaDumpUserStream_Count];
+    MayaCrashHarnessStreamsResult results[MayaDumpUserStream_Count];
+    memset(streams, 0, sizeof(streams));
+    memset(results, 0, sizeof(results));
+
+    int numFailed = 0;
+    for (unsigned int i=0; i < MayaDumpUserStream_Count; ++i) {
+        const MayaDumpUserStreamInfo *info = &kMayaDumpUserStreams[i];
+        const ULONG size = info->isVariable ? info->size + MAYA_CRASH_HARNESS_STREAMS_VARIABLE_DATA_BYTES + i : info->size;
+        BYTE *buf = (BYTE *)malloc(size);
+        if (buf == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            numFailed = MayaDumpUserStream_Count;
+            break;
+        }
+        for (ULONG j=0; j < size; ++j) {
+            buf[j] = getMayaCrashHarnessStreamsByte(i, j);
+        }
+        streams[i].Type = info->streamType;
+        streams[i].BufferSize = size;
+        streams[i].Buffer = buf;
+    }
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    char dumpFilePath[MAX_PATH] = {0};
+    snprintf(dumpFilePath, MAX_PATH, "%s\\%s_%lu.dmp", tempDirPath, MAYA_CRASH_HARNESS_STREAMS_DUMP_FILE_PREFIX, ::GetCurrentProcessId());
+
+    if (numFailed == 0 && !writeMayaCrashHarnessStreamsDump(dumpFilePath, streams, MayaDumpUserStream_Count)) {
+        fprintf(stderr, "Could not write the dump to %s: error %lu\n", dumpFilePath, ::GetLastError());
+        numFailed = MayaDumpUserStream_Count;
+    }
+    if (numFailed == 0 && !readMayaCrashHarnessStreamsDump(dumpFilePath, streams, results)) {
+        fprintf(stderr, "Could not read the dump back from %s\n", dumpFilePath);
+        numFailed = MayaDumpUserStream_Count;
+    }
+
+    if (numFailed == 0) {
+        printf("%-18s %10s %8s %10s %10s %7s %10s %9s %10s\n",
+               "Stream", "Type", "Sizing", "Written", "Read", "Found", "Size check", "Contents", "Neighbours");
+        for (unsigned int i=0; i < MayaDumpUserStream_Count; ++i) {
+            const MayaDumpUserStreamInfo *info = &kMayaDumpUserStreams[i];
+            const MayaCrashHarnessStreamsResult *result = &results[i];
+            const MayaDumpUserStream stream = (MayaDumpUserStream)i;
+
+            // NOTE: (sonictk) Anything short of the layout must be rejected, and so must anything
+            // past it unless the layout is only a header.
+            const bool neighboursRejected = !isMayaDumpUserStreamSizeValid(stream, info->size - 1)
+                && (info->isVariable || !isMayaDumpUserStreamSizeValid(stream, info->size + 1));
+            const bool intact = result->numFound == 1
+                && result->sizeValid
+                && result->sizeRead == streams[i].BufferSize
+                && result->contentsMatch;
+
+            printf("%-18s 0x%08lx %8s %10lu %10lu %7u %10s %9s %10s\n",
+                   info->name, info->streamType, info->isVariable ? "variable" : "fixed",
+                   streams[i].BufferSize, result->sizeRead, result->numFound,
+                   result->sizeValid ? "ok" : "FAILED",
+                   result->contentsMatch ? "ok" : "FAILED",
+                   neighboursRejected ? "ok" : "FAILED");
+            numFailed += intact ? 0 : 1;
+            numFailed += neighboursRejected ? 0 : 1;
+        }
+
+        // NOTE: (sonictk) The comment streams are not ours, and must not be mistaken for any of ours.
+        if (findMayaDumpUserStream(CommentStreamA) != MayaDumpUserStream_Count) {
+            printf("CommentStreamA was mistaken for one of our streams.\n");
+            ++numFailed;
+        }
+        printf("%u streams round-tripped, %d checks failed.\n", (unsigned int)MayaDumpUserStream_Count, numFailed);
+    }
+
+    if (!config->keepDumps) {
+        ::DeleteFileA(dumpFilePath);
+    }
+    for (unsigned int i=0; i < MayaDumpUserStream_Count; ++i) {
+        free(streams[i].Buffer);
+    }
+
+    return numFailed;
+}
@@ -0,0 +1,23 @@
+/**
+ * @file   maya_crash_harness_stub_dll.c
+ * @brief  A DLL that does nothing but import ``SetUnhandledExceptionFilter``, the same way a Maya
+ *         plugin that installs its own filter would. ``maya_crash_harness.exe -benchiat`` loads
+ *         many copies of it to measure how much patching each newly-loaded module adds to the load.
+ *
+ *         It is built without the CRT and without an entry point, so that loading it costs as
+ *         little as possible besides the patching itself.
+ */
+#ifndef _WIN32
+#error "Unsupported platform for compilation."
+#endif // _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+
+
+/// Goes through this module's import address table, so calling it shows whether it was patched.
+__declspec(dllexport) LPTOP_LEVEL_EXCEPTION_FILTER mayaCrashHarnessStubSetFilter(LPTOP_LEVEL_EXCEPTION_FILTER filter)
+{
+    return SetUnhandledExceptionFilter(filter);
+}
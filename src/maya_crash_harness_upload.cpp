@@ -0,0 +1,763 @@
+/**
+ * @file   maya_crash_harness_upload.cpp
+ * @brief  ``maya_crash_harness.exe -upload <crashes>`` drives ``maya_crash_uploader.exe`` against
+ *         a stand-in for the crash report server, listening on the loopback interface, that fails
+ *         some of its requests on purpose. The spool is filled with a crash storm: that many crash
+ *         dumps (along with their sidecars) spread over a handful of distinct crashes, plus files
+ *         that aren't the plugin's and must be left alone. The uploader is run until the spool has
+ *         been emptied, every dump the stand-in ended up with is checked against the original, and
+ *         the throughput and bytes saved by deduplication and compression are reported.
+ */
+
+#define MAYA_CRASH_HARNESS_UPLOAD_FLAG "-upload"
+#define MAYA_CRASH_HARNESS_UPLOADER_EXE_NAME "maya_crash_uploader.exe"
+
+#define MAYA_CRASH_HARNESS_UPLOAD_MAX_CRASHES 1024 // NOTE: (sonictk) The most the uploader takes in a single pass.
+#define MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS 8
+#define MAYA_CRASH_HARNESS_UPLOAD_PAGE_SIZE 4096
+/// NOTE: (sonictk) Deliberately not a multiple of the chunk size, so that the last chunk is a short one.
+#define MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES (2 * 1024 * 1024 + 4321)
+#define MAYA_CRASH_HARNESS_UPLOAD_CHUNK_MB 1
+#define MAYA_CRASH_HARNESS_UPLOAD_MAX_PASSES 8
+
+#define MAYA_CRASH_HARNESS_UPLOAD_DEFAULT_FAIL_PERCENT 10
+#define MAYA_CRASH_HARNESS_UPLOAD_DEFAULT_DROP_PERCENT 5
+
+#define MAYA_CRASH_HARNESS_UPLOAD_MAX_HEADER_BYTES 8192
+#define MAYA_CRASH_HARNESS_UPLOAD_MAX_BODY_BYTES (4 * 1024 * 1024)
+#define MAYA_CRASH_HARNESS_UPLOAD_MAX_RESPONSE_BYTES (64 * 1024)
+#define MAYA_CRASH_HARNESS_UPLOAD_MAX_SERVER_DUMPS MAYA_CRASH_HARNESS_UPLOAD_MAX_CRASHES
+
+#define MAYA_CRASH_HARNESS_UPLOAD_FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define MAYA_CRASH_HARNESS_UPLOAD_FNV_PRIME 0x100000001B3ULL
+
+
+/// Files put in the spool alongside the crash storm, which the uploader must leave where they are.
+static const char *kMayaCrashHarnessUploadForeignFileNames[] = {
+    "OtherApplication.dmp",
+    "OtherApplication.dmp" MAYA_CRASH_SIDECAR_FILE_EXTENSION,
+    MAYA_HANG_DUMP_FILE_PREFIX "_1234_1.dmp",
+    // NOTE: (sonictk) A crash dump whose sidecar hasn't been written yet.
+    MINIDUMP_FILE_PREFIX "_20261018-000000_1234_0000000000000000.dmp"
+};
+
+
+/// A dump as the stand-in has received it so far.
+struct MayaUploadStandInDump
+{
+    char name[MAX_PATH];
+    uint64_t total;
+    uint64_t received;
+    uint64_t hash; // NOTE: (sonictk) Of the bytes received so far, in order.
+    uint64_t fingerprint;
+    bool hasFingerprint;
+};
+
+/// A stand-in for the crash report server, speaking the protocol described at the top of
+/// ``maya_crash_uploader_main.c``.
+struct MayaUploadStandIn
+{
+    SOCKET hListenSocket;
+    HANDLE hThread;
+    unsigned short port;
+    unsigned int failPercent; // NOTE: (sonictk) Requests answered with a ``503``.
+    unsigned int dropPercent; // NOTE: (sonictk) Requests whose connection is closed without an answer.
+    uint32_t rngState;
+
+    DECOMPRESSOR_HANDLE hDecompressor;
+    char *requestBuf;
+    BYTE *rawBuf;
+    char *responseBuf;
+
+    MayaUploadStandInDump dumps[MAYA_CRASH_HARNESS_UPLOAD_MAX_SERVER_DUMPS];
+    unsigned int numDumps;
+
+    uint64_t numRequests;
+    uint64_t numFailed;
+    uint64_t numDropped;
+    uint64_t numRejected; // NOTE: (sonictk) Requests the stand-in found fault with, e.g. a corrupt body.
+    uint64_t numBatchRecords;
+    uint64_t wireBytes; // NOTE: (sonictk) Request bodies as they were sent.
+    uint64_t rawBytes; // NOTE: (sonictk) Request bodies once decompressed.
+};
+
+
+static inline uint64_t hashMayaCrashHarnessUploadBytes(uint64_t hash, const BYTE *data, size_t len)
+{
+    for (size_t i=0; i < len; ++i) {
+        hash ^= data[i];
+        hash *= MAYA_CRASH_HARNESS_UPLOAD_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+static inline uint32_t nextMayaCrashHarnessUploadRandom(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+
+/**
+ * Finds the value of a header in a request.
+ *
+ * @param headers   The request line and headers, ``NULL``-terminated.
+ * @param name      The name of the header, without the ``:``. Matched case-insensitively.
+ *
+ * @return          The start of the value, or ``NULL`` if the request doesn't have that header.
+ */
+const char *findMayaUploadStandInHeader(const char *headers, const char *name)
+{
+    const size_t lenName = strlen(name);
+    for (const char *line = strstr(headers, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (_strnicmp(line, name, lenName) == 0 && line[lenName] == ':') {
+            const char *value = line + lenName + 1;
+            while (*value == ' ') {
+                ++value;
+            }
+            return value;
+        }
+    }
+
+    return NULL;
+}
+
+
+bool sendAllMayaUploadStandIn(SOCKET hSocket, const char *data, int len)
+{
+    while (len > 0) {
+        int numSent = ::send(hSocket, data, len, 0);
+        if (numSent == SOCKET_ERROR) {
+            return false;
+        }
+        data += numSent;
+        len -= numSent;
+    }
+
+    return true;
+}
+
+
+void sendMayaUploadStandInResponse(SOCKET hSocket, int statusCode, const char *extraHeaders, const char *body, int lenBody)
+{
+    // NOTE: (sonictk) Every response closes the connection, so that the stand-in can serve one
+    // connection at a time without the uploader ever waiting on a second one.
+    char header[512] = {0};
+    int lenHeader = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Length: %d\r\nConnection: close\r\n%s\r\n",
+                             statusCode, statusCode < 300 ? "OK" : "Error", lenBody, extraHeaders != NULL ? extraHeaders : "");
+    if (sendAllMayaUploadStandIn(hSocket, header, lenHeader) && lenBody > 0) {
+        sendAllMayaUploadStandIn(hSocket, body, lenBody);
+    }
+}
+
+
+/**
+ * Reads a whole request from the connection into ``server->requestBuf``.
+ *
+ * @param lenHeaders    Storage for the length of the request line and headers, including the blank line.
+ * @param lenBody       Storage for the length of the body that follows them.
+ *
+ * @return              ``true`` if a whole request was read.
+ */
+bool recvMayaUploadStandInRequest(MayaUploadStandIn *server, SOCKET hSocket, int *lenHeaders, int *lenBody)
+{
+    const int lenBuf = MAYA_CRASH_HARNESS_UPLOAD_MAX_HEADER_BYTES + MAYA_CRASH_HARNESS_UPLOAD_MAX_BODY_BYTES;
+    int lenRead = 0;
+    *lenHeaders = 0;
+    while (*lenHeaders == 0) {
+        int numRead = ::recv(hSocket, server->requestBuf + lenRead, MAYA_CRASH_HARNESS_UPLOAD_MAX_HEADER_BYTES - lenRead, 0);
+        if (numRead <= 0) {
+            return false;
+        }
+        lenRead += numRead;
+        server->requestBuf[lenRead] = '\0';
+        char *end = strstr(server->requestBuf, "\r\n\r\n");
+        if (end != NULL) {
+            *lenHeaders = (int)(end + 4 - server->requestBuf);
+        } else if (lenRead == MAYA_CRASH_HARNESS_UPLOAD_MAX_HEADER_BYTES) {
+            return false;
+        }
+    }
+
+    // NOTE: (sonictk) Terminate the headers so that they can be searched, keeping the body intact.
+    char savedChar = server->requestBuf[*lenHeaders - 2];
+    server->requestBuf[*lenHeaders - 2] = '\0';
+    const char *contentLength = findMayaUploadStandInHeader(server->requestBuf, "Content-Length");
+    server->requestBuf[*lenHeaders - 2] = savedChar;
+    *lenBody = contentLength != NULL ? atoi(contentLength) : 0;
+    if (*lenBody < 0 || *lenHeaders + *lenBody > lenBuf) {
+        return false;
+    }
+
+    while (lenRead < *lenHeaders + *lenBody) {
+        int numRead = ::recv(hSocket, server->requestBuf + lenRead, *lenHeaders + *lenBody - lenRead, 0);
+        if (numRead <= 0) {
+            return false;
+        }
+        lenRead += numRead;
+    }
+
+    return true;
+}
+
+
+MayaUploadStandInDump *findMayaUploadStandInDump(MayaUploadStandIn *server, const char *name)
+{
+    for (unsigned int i=0; i < server->numDumps; ++i) {
+        if (strcmp(server->dumps[i].name, name) == 0) {
+            return &server->dumps[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/// Answers a single request, unless fault injection has it dropped. The connection is closed afterwards either way.
+void handleMayaUploadStandInRequest(MayaUploadStandIn *server, SOCKET hSocket)
+{
+    int lenHeaders = 0;
+    int lenBody = 0;
+    if (!recvMayaUploadStandInRequest(server, hSocket, &lenHeaders, &lenBody)) {
+        return;
+    }
+    ++server->numRequests;
+
+    const uint32_t roll = nextMayaCrashHarnessUploadRandom(&server->rngState) % 100;
+    if (roll < server->dropPercent) {
+        ++server->numDropped;
+        return;
+    }
+    if (roll < server->dropPercent + server->failPercent) {
+        ++server->numFailed;
+        sendMayaUploadStandInResponse(hSocket, 503, NULL, NULL, 0);
+        return;
+    }
+
+    char *headers = server->requestBuf;
+    const BYTE *body = (const BYTE *)server->requestBuf + lenHeaders;
+    headers[lenHeaders - 2] = '\0';
+
+    char verb[16] = {0};
+    char path[MAX_PATH * 3] = {0};
+    if (sscanf(headers, "%15s %767s", verb, path) != 2) {
+        ++server->numRejected;
+        sendMayaUploadStandInResponse(hSocket, 400, NULL, NULL, 0);
+        return;
+    }
+
+    const BYTE *rawBody = body;
+    int lenRawBody = lenBody;
+    const char *compression = findMayaUploadStandInHeader(headers, "X-Maya-Compression");
+    if (compression != NULL) {
+        const char *rawLength = findMayaUploadStandInHeader(headers, "X-Maya-Raw-Length");
+        lenRawBody = rawLength != NULL ? atoi(rawLength) : -1;
+        SIZE_T lenDecompressed = 0;
+        if (strncmp(compression, "xpress-huff", 11) != 0
+            || lenRawBody < 0 || lenRawBody > MAYA_CRASH_HARNESS_UPLOAD_MAX_BODY_BYTES
+            || !::Decompress(server->hDecompressor, body, (SIZE_T)lenBody, server->rawBuf, (SIZE_T)lenRawBody, &lenDecompressed)
+            || lenDecompressed != (SIZE_T)lenRawBody) {
+            ++server->numRejected;
+            sendMayaUploadStandInResponse(hSocket, 400, NULL, NULL, 0);
+            return;
+        }
+        rawBody = server->rawBuf;
+    }
+    server->wireBytes += (uint64_t)lenBody;
+    server->rawBytes += (uint64_t)lenRawBody;
+
+    char *query = strchr(path, '?');
+    if (query != NULL) {
+        *query++ = '\0';
+    }
+    const size_t lenPath = strlen(path);
+    const char *dumpName = strstr(path, "/dumps/");
+
+    if (strcmp(verb, "POST") == 0 && lenPath >= 6 && strcmp(path + lenPath - 6, "/batch") == 0) {
+        for (int offset=0; offset < lenRawBody;) {
+            const MayaUploadBatchRecordHeader *record = (const MayaUploadBatchRecordHeader *)(rawBody + offset);
+            if (offset + (int)sizeof(MayaUploadBatchRecordHeader) > lenRawBody
+                || record->magic != MAYA_UPLOAD_BATCH_RECORD_MAGIC
+                || offset + (int)sizeof(MayaUploadBatchRecordHeader) + (int)record->size > lenRawBody) {
+                ++server->numRejected;
+                sendMayaUploadStandInResponse(hSocket, 400, NULL, NULL, 0);
+                return;
+            }
+            ++server->numBatchRecords;
+            offset += (int)sizeof(MayaUploadBatchRecordHeader) + (int)record->size;
+        }
+
+        // NOTE: (sonictk) Answer with the fingerprints of the dumps that have been uploaded in full.
+        int lenResponse = 0;
+        for (unsigned int i=0; i < server->numDumps && lenResponse + 18 < MAYA_CRASH_HARNESS_UPLOAD_MAX_RESPONSE_BYTES; ++i) {
+            const MayaUploadStandInDump *dump = &server->dumps[i];
+            if (dump->hasFingerprint && dump->received == dump->total) {
+                lenResponse += snprintf(server->responseBuf + lenResponse, (size_t)(MAYA_CRASH_HARNESS_UPLOAD_MAX_RESPONSE_BYTES - lenResponse),
+                                        "%016llx\n", dump->fingerprint);
+            }
+        }
+        sendMayaUploadStandInResponse(hSocket, 200, NULL, server->responseBuf, lenResponse);
+        return;
+    }
+
+    if (dumpName == NULL) {
+        sendMayaUploadStandInResponse(hSocket, 404, NULL, NULL, 0);
+        return;
+    }
+    dumpName += 7;
+    MayaUploadStandInDump *dump = findMayaUploadStandInDump(server, dumpName);
+
+    if (strcmp(verb, "GET") == 0) {
+        if (dump == NULL) {
+            sendMayaUploadStandInResponse(hSocket, 404, NULL, NULL, 0);
+            return;
+        }
+        char offsetHeader[64] = {0};
+        snprintf(offsetHeader, sizeof(offsetHeader), "X-Upload-Offset: %llu\r\n", dump->received);
+        sendMayaUploadStandInResponse(hSocket, 200, offsetHeader, NULL, 0);
+        return;
+    }
+
+    if (strcmp(verb, "PUT") == 0 && query != NULL) {
+        const char *offsetStr = strstr(query, "offset=");
+        const char *totalStr = strstr(query, "total=");
+        const uint64_t offset = offsetStr != NULL ? _strtoui64(offsetStr + 7, NULL, 10) : 0;
+        const uint64_t total = totalStr != NULL ? _strtoui64(totalStr + 6, NULL, 10) : 0;
+        if (dump == NULL && offset == 0 && server->numDumps < MAYA_CRASH_HARNESS_UPLOAD_MAX_SERVER_DUMPS) {
+            dump = &server->dumps[server->numDumps++];
+            memset(dump, 0, sizeof(MayaUploadStandInDump));
+            strncpy(dump->name, dumpName, MAX_PATH - 1);
+            dump->hash = MAYA_CRASH_HARNESS_UPLOAD_FNV_OFFSET_BASIS;
+        }
+        // NOTE: (sonictk) Chunks must arrive in order, with the uploader asking where to carry on
+        // from after a failure, or the dump would end up with a hole in it.
+        if (dump == NULL || offset != dump->received || offset + (uint64_t)lenRawBody > total) {
+            ++server->numRejected;
+            sendMayaUploadStandInResponse(hSocket, 409, NULL, NULL, 0);
+            return;
+        }
+        dump->hash = hashMayaCrashHarnessUploadBytes(dump->hash, rawBody, (size_t)lenRawBody);
+        dump->received += (uint64_t)lenRawBody;
+        dump->total = total;
+        const char *fingerprint = findMayaUploadStandInHeader(headers, "X-Maya-Fingerprint");
+        if (fingerprint != NULL) {
+            dump->fingerprint = _strtoui64(fingerprint, NULL, 16);
+            dump->hasFingerprint = true;
+        }
+        sendMayaUploadStandInResponse(hSocket, 200, NULL, NULL, 0);
+        return;
+    }
+
+    sendMayaUploadStandInResponse(hSocket, 405, NULL, NULL, 0);
+}
+
+
+DWORD WINAPI mayaUploadStandInThreadProc(LPVOID param)
+{
+    MayaUploadStandIn *server = (MayaUploadStandIn *)param;
+    for (;;) {
+        // NOTE: (sonictk) Fails once the listening socket is closed, which is how the stand-in is stopped.
+        SOCKET hSocket = ::accept(server->hListenSocket, NULL, NULL);
+        if (hSocket == INVALID_SOCKET) {
+            break;
+        }
+        handleMayaUploadStandInRequest(server, hSocket);
+        ::shutdown(hSocket, SD_SEND);
+        ::closesocket(hSocket);
+    }
+
+    return 0;
+}
+
+
+bool startMayaUploadStandIn(MayaUploadStandIn *server)
+{
+    WSADATA wsaData;
+    if (::WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+    if (!::CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &server->hDecompressor)) {
+        server->hDecompressor = NULL;
+        return false;
+    }
+    server->requestBuf = (char *)malloc(MAYA_CRASH_HARNESS_UPLOAD_MAX_HEADER_BYTES + MAYA_CRASH_HARNESS_UPLOAD_MAX_BODY_BYTES + 1);
+    server->rawBuf = (BYTE *)malloc(MAYA_CRASH_HARNESS_UPLOAD_MAX_BODY_BYTES);
+    server->responseBuf = (char *)malloc(MAYA_CRASH_HARNESS_UPLOAD_MAX_RESPONSE_BYTES);
+    if (server->requestBuf == NULL || server->rawBuf == NULL || server->responseBuf == NULL) {
+        return false;
+    }
+
+    server->hListenSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (server->hListenSocket == INVALID_SOCKET) {
+        return false;
+    }
+    // NOTE: (sonictk) Let the system pick the port, so that runs never collide with anything else listening.
+    sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    int lenAddr = (int)sizeof(addr);
+    if (::bind(server->hListenSocket, (const sockaddr *)&addr, lenAddr) == SOCKET_ERROR
+        || ::listen(server->hListenSocket, SOMAXCONN) == SOCKET_ERROR
+        || ::getsockname(server->hListenSocket, (sockaddr *)&addr, &lenAddr) == SOCKET_ERROR) {
+        return false;
+    }
+    server->port = ::ntohs(addr.sin_port);
+
+    server->hThread = ::CreateThread(NULL, 0, mayaUploadStandInThreadProc, server, 0, NULL);
+
+    return server->hThread != NULL;
+}
+
+
+void stopMayaUploadStandIn(MayaUploadStandIn *server)
+{
+    if (server->hListenSocket != INVALID_SOCKET && server->hListenSocket != 0) {
+        ::closesocket(server->hListenSocket);
+        server->hListenSocket = INVALID_SOCKET;
+    }
+    if (server->hThread != NULL) {
+        ::WaitForSingleObject(server->hThread, INFINITE);
+        ::CloseHandle(server->hThread);
+        server->hThread = NULL;
+    }
+    if (server->hDecompressor != NULL) {
+        ::CloseDecompressor(server->hDecompressor);
+        server->hDecompressor = NULL;
+    }
+    free(server->responseBuf);
+    free(server->rawBuf);
+    free(server->requestBuf);
+    server->responseBuf = NULL;
+    server->rawBuf = NULL;
+    server->requestBuf = NULL;
+    ::WSACleanup();
+}
+
+
+/// The fingerprint of the given crash in the storm. Consecutive crashes are different ones, the
+/// way the same few crashes come around again and again when a whole farm hits the same bug.
+static inline uint64_t getMayaCrashHarnessUploadFingerprint(unsigned int crashIdx)
+{
+    return 0x9E3779B97F4A7C15ULL * (uint64_t)(crashIdx % MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS + 1);
+}
+
+
+static inline void getMayaCrashHarnessUploadDumpFileName(const SYSTEMTIME *time, unsigned int crashIdx, char *fileName, size_t lenFileName)
+{
+    snprintf(fileName, lenFileName, "%s_%04u%02u%02u-%02u%02u%02u_%u_%016llx.dmp",
+             MINIDUMP_FILE_PREFIX, time->wYear, time->wMonth, time->wDay, time->wHour, time->wMinute, time->wSecond,
+             10000 + crashIdx, getMayaCrashHarnessUploadFingerprint(crashIdx));
+}
+
+
+/**
+ * Fills in the contents of a stand-in dump. Like a real one, it is a mix of untouched (zeroed)
+ * pages, pages full of pointers and small integers that compress well, and pages that don't
+ * compress at all.
+ */
+void fillMayaCrashHarnessUploadDump(BYTE *buf, size_t size, unsigned int crashIdx)
+{
+    uint32_t rngState = 0x1234567u + crashIdx;
+    for (size_t pageStart=0; pageStart < size; pageStart += MAYA_CRASH_HARNESS_UPLOAD_PAGE_SIZE) {
+        size_t lenPage = size - pageStart < MAYA_CRASH_HARNESS_UPLOAD_PAGE_SIZE ? size - pageStart : MAYA_CRASH_HARNESS_UPLOAD_PAGE_SIZE;
+        BYTE *page = buf + pageStart;
+        switch ((pageStart / MAYA_CRASH_HARNESS_UPLOAD_PAGE_SIZE * 7 + crashIdx) % 4) {
+        case 0:
+            memset(page, 0, lenPage);
+            break;
+        case 3:
+            for (size_t i=0; i < lenPage; ++i) {
+                page[i] = (BYTE)nextMayaCrashHarnessUploadRandom(&rngState);
+            }
+            break;
+        default:
+            for (size_t i=0; i + sizeof(uint64_t) <= lenPage; i += sizeof(uint64_t)) {
+                uint64_t value = 0x00007FF600000000ULL + ((nextMayaCrashHarnessUploadRandom(&rngState) & 0xFFF) << 4);
+                memcpy(page + i, &value, sizeof(value));
+            }
+            break;
+        }
+    }
+}
+
+
+bool writeMayaCrashHarnessUploadFile(const char *dirPath, const char *fileName, const void *data, DWORD size)
+{
+    char filePath[MAX_PATH] = {0};
+    snprintf(filePath, MAX_PATH, "%s\\%s", dirPath, fileName);
+    HANDLE hFile = ::CreateFileA(filePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD bytesWritten = 0;
+    BOOL bStat = ::WriteFile(hFile, data, size, &bytesWritten, NULL);
+    ::CloseHandle(hFile);
+
+    return bStat == TRUE && bytesWritten == size;
+}
+
+
+bool doesMayaCrashHarnessUploadFileExist(const char *dirPath, const char *fileName)
+{
+    char filePath[MAX_PATH] = {0};
+    snprintf(filePath, MAX_PATH, "%s\\%s", dirPath, fileName);
+
+    return ::GetFileAttributesA(filePath) != INVALID_FILE_ATTRIBUTES;
+}
+
+
+/// Deletes every file in the given directory, and then the directory itself.
+void deleteMayaCrashHarnessUploadDir(const char *dirPath)
+{
+    char searchPath[MAX_PATH] = {0};
+    snprintf(searchPath, MAX_PATH, "%s\\*", dirPath);
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = ::FindFirstFileA(searchPath, &findData);
+    for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE; bStat = ::FindNextFileA(hFind, &findData)) {
+        if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            continue;
+        }
+        char filePath[MAX_PATH] = {0};
+        snprintf(filePath, MAX_PATH, "%s\\%s", dirPath, findData.cFileName);
+        ::DeleteFileA(filePath);
+    }
+    if (hFind != INVALID_HANDLE_VALUE) {
+        ::FindClose(hFind);
+    }
+    ::RemoveDirectoryA(dirPath);
+}
+
+
+/**
+ * Runs the uploader over the crash storm until the spool has been emptied (or it stops making
+ * progress), and checks what the stand-in ended up with.
+ *
+ * @param exePath           The path to the harness; the uploader is expected next to it.
+ * @param numCrashes        The number of crashes in the storm.
+ * @param failPercent       The percentage of requests that the stand-in answers with a ``503``.
+ * @param dropPercent       The percentage of requests that the stand-in drops the connection of.
+ * @param config            Only ``timeoutSecs`` (per pass of the uploader) and ``keepDumps`` are used.
+ * @param timerFrequency    The frequency of the performance counter.
+ *
+ * @return                  The number of checks that failed.
+ */
+int runMayaCrashHarnessUpload(const char *exePath,
+                              unsigned int numCrashes,
+                              unsigned int failPercent,
+                              unsigned int dropPercent,
+                              const MayaCrashHarnessConfig *config,
+                              LONGLONG timerFrequency)
+{
+    numCrashes = numCrashes > MAYA_CRASH_HARNESS_UPLOAD_MAX_CRASHES ? MAYA_CRASH_HARNESS_UPLOAD_MAX_CRASHES : numCrashes;
+    failPercent = failPercent > 100 ? 100 : failPercent;
+    dropPercent = dropPercent > 100 - failPercent ? 100 - failPercent : dropPercent;
+
+    char uploaderPath[MAX_PATH] = {0};
+    strncpy(uploaderPath, exePath, MAX_PATH - 1);
+    char *exeName = strrchr(uploaderPath, '\\');
+    exeName = exeName == NULL ? uploaderPath : exeName + 1;
+    snprintf(exeName, (size_t)(MAX_PATH - (exeName - uploaderPath)), "%s", MAYA_CRASH_HARNESS_UPLOADER_EXE_NAME);
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    char spoolDirPath[MAX_PATH] = {0};
+    snprintf(spoolDirPath, MAX_PATH, "%s\\MayaCrashHarnessSpool_%lu", tempDirPath, ::GetCurrentProcessId());
+    char uploadedDirPath[MAX_PATH] = {0};
+    snprintf(uploadedDirPath, MAX_PATH, "%s\\uploaded", spoolDirPath);
+    ::CreateDirectoryA(spoolDirPath, NULL);
+
+    // NOTE: (sonictk) The storm itself. Every crash gets a sidecar; the stand-in dumps are all
+    // named after the same second, the way they would be when a whole farm goes down at once.
+    SYSTEMTIME now;
+    ::GetSystemTime(&now);
+    BYTE *dumpBuf = (BYTE *)malloc(MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES);
+    uint64_t *dumpHashes = (uint64_t *)calloc(numCrashes, sizeof(uint64_t));
+    int numFailed = 0;
+    uint64_t spoolBytes = 0;
+    for (unsigned int i=0; i < numCrashes && dumpBuf != NULL && dumpHashes != NULL; ++i) {
+        char dumpFileName[MAX_PATH] = {0};
+        getMayaCrashHarnessUploadDumpFileName(&now, i, dumpFileName, MAX_PATH);
+        fillMayaCrashHarnessUploadDump(dumpBuf, MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES, i);
+        dumpHashes[i] = hashMayaCrashHarnessUploadBytes(MAYA_CRASH_HARNESS_UPLOAD_FNV_OFFSET_BASIS, dumpBuf, MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES);
+
+        MayaCrashSidecar sidecar;
+        memset(&sidecar, 0, sizeof(sidecar));
+        sidecar.magic = MAYA_CRASH_SIDECAR_MAGIC;
+        sidecar.version = MAYA_CRASH_SIDECAR_VERSION;
+        sidecar.fingerprint = getMayaCrashHarnessUploadFingerprint(i);
+        ::GetSystemTimeAsFileTime((FILETIME *)&sidecar.timestamp);
+        sidecar.processId = 10000 + i;
+        sidecar.exceptionCode = EXCEPTION_ACCESS_VIOLATION;
+        char sidecarFileName[MAX_PATH] = {0};
+        snprintf(sidecarFileName, MAX_PATH, "%s%s", dumpFileName, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+
+        // NOTE: (sonictk) The sidecar goes last, as it does in the crash handler.
+        if (!writeMayaCrashHarnessUploadFile(spoolDirPath, dumpFileName, dumpBuf, MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES)
+            || !writeMayaCrashHarnessUploadFile(spoolDirPath, sidecarFileName, &sidecar, (DWORD)sizeof(sidecar))) {
+            fprintf(stderr, "Could not write the crash storm to %s: error %lu\n", spoolDirPath, ::GetLastError());
+            numFailed = 1;
+            break;
+        }
+        spoolBytes += MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES + sizeof(MayaCrashSidecar);
+    }
+    for (int i=0; i < (int)(ARRAY_SIZE(kMayaCrashHarnessUploadForeignFileNames)) && numFailed == 0 && dumpBuf != NULL; ++i) {
+        writeMayaCrashHarnessUploadFile(spoolDirPath, kMayaCrashHarnessUploadForeignFileNames[i], dumpBuf, MAYA_CRASH_HARNESS_UPLOAD_PAGE_SIZE);
+    }
+    free(dumpBuf);
+    if (dumpHashes == NULL) {
+        numFailed = 1;
+    }
+
+    static MayaUploadStandIn server;
+    memset(&server, 0, sizeof(server));
+    server.hListenSocket = INVALID_SOCKET;
+    server.failPercent = failPercent;
+    server.dropPercent = dropPercent;
+    server.rngState = 0xC0FFEEu; // NOTE: (sonictk) Fixed, so that every run injects the same faults.
+    if (numFailed == 0 && !startMayaUploadStandIn(&server)) {
+        fprintf(stderr, "Could not start the stand-in server: error %d\n", ::WSAGetLastError());
+        numFailed = 1;
+    }
+
+    printf("Crash storm: %u crashes (%u distinct), %.1f MB in the spool; the stand-in fails %u%% of requests and drops %u%%\n",
+           numCrashes, numCrashes < MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS ? numCrashes : MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS,
+           spoolBytes / (1024.0 * 1024.0), failPercent, dropPercent);
+    fflush(stdout);
+
+    // NOTE: (sonictk) Anything the uploader gives up on is left in the spool for its next pass,
+    // so keep running it for as long as it makes progress.
+    unsigned int numPasses = 0;
+    unsigned int numLeft = numCrashes;
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+    ::QueryPerformanceCounter(&start);
+    while (numFailed == 0 && numLeft > 0 && numPasses < MAYA_CRASH_HARNESS_UPLOAD_MAX_PASSES) {
+        char cmdLine[MAX_PATH * 3] = {0};
+        snprintf(cmdLine, sizeof(cmdLine), "\"%s\" -url http://127.0.0.1:%u/api -spool \"%s\" -chunkmb %u -once",
+                 uploaderPath, server.port, spoolDirPath, MAYA_CRASH_HARNESS_UPLOAD_CHUNK_MB);
+        STARTUPINFOA startupInfo = {0};
+        startupInfo.cb = sizeof(startupInfo);
+        PROCESS_INFORMATION procInfo = {0};
+        if (!::CreateProcessA(NULL, cmdLine, NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &procInfo)) {
+            fprintf(stderr, "Could not run %s: error %lu\n", uploaderPath, ::GetLastError());
+            numFailed = 1;
+            break;
+        }
+        ++numPasses;
+        DWORD exitCode = 0;
+        if (::WaitForSingleObject(procInfo.hProcess, config->timeoutSecs * 1000) != WAIT_OBJECT_0) {
+            fprintf(stderr, "The uploader timed out after %u seconds.\n", config->timeoutSecs);
+            ::TerminateProcess(procInfo.hProcess, 1);
+            ::WaitForSingleObject(procInfo.hProcess, INFINITE);
+            ++numFailed;
+        }
+        ::GetExitCodeProcess(procInfo.hProcess, &exitCode);
+        ::CloseHandle(procInfo.hThread);
+        ::CloseHandle(procInfo.hProcess);
+        if (exitCode != 0) {
+            fprintf(stderr, "The uploader exited with %lu.\n", exitCode);
+            ++numFailed;
+        }
+
+        const unsigned int numLeftBefore = numLeft;
+        numLeft = 0;
+        for (unsigned int i=0; i < numCrashes; ++i) {
+            char dumpFileName[MAX_PATH] = {0};
+            getMayaCrashHarnessUploadDumpFileName(&now, i, dumpFileName, MAX_PATH);
+            numLeft += doesMayaCrashHarnessUploadFileExist(spoolDirPath, dumpFileName) ? 1 : 0;
+        }
+        if (numLeft == numLeftBefore) {
+            break;
+        }
+    }
+    ::QueryPerformanceCounter(&end);
+    stopMayaUploadStandIn(&server);
+
+    // NOTE: (sonictk) Check that every crash was dealt with, that the stand-in has one intact copy
+    // of every distinct crash, and that everything else in the spool was left alone.
+    char computerName[MAX_COMPUTERNAME_LENGTH + 1] = {0};
+    DWORD lenComputerName = (DWORD)(ARRAY_SIZE(computerName));
+    ::GetComputerNameA(computerName, &lenComputerName);
+
+    unsigned int numUploaded = 0;
+    unsigned int numMissing = 0;
+    unsigned int numCorrupt = 0;
+    uint64_t dedupSavedBytes = 0;
+    bool fingerprintUploaded[MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS] = {0};
+    for (unsigned int i=0; i < numCrashes && numFailed == 0; ++i) {
+        char dumpFileName[MAX_PATH] = {0};
+        getMayaCrashHarnessUploadDumpFileName(&now, i, dumpFileName, MAX_PATH);
+        char sidecarFileName[MAX_PATH] = {0};
+        snprintf(sidecarFileName, MAX_PATH, "%s%s", dumpFileName, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+        if (!doesMayaCrashHarnessUploadFileExist(uploadedDirPath, dumpFileName)
+            || !doesMayaCrashHarnessUploadFileExist(uploadedDirPath, sidecarFileName)) {
+            ++numMissing;
+        }
+
+        char remoteName[MAX_PATH] = {0};
+        snprintf(remoteName, MAX_PATH, "%s_%s", computerName, dumpFileName);
+        const MayaUploadStandInDump *dump = findMayaUploadStandInDump(&server, remoteName);
+        if (dump == NULL) {
+            dedupSavedBytes += MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES;
+            continue;
+        }
+        if (dump->received != MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES || dump->total != MAYA_CRASH_HARNESS_UPLOAD_DUMP_BYTES || dump->hash != dumpHashes[i]) {
+            fprintf(stderr, "%s: the stand-in has %llu of %llu bytes, which %s the original.\n",
+                    dumpFileName, dump->received, dump->total, dump->hash == dumpHashes[i] ? "match" : "do not match");
+            ++numCorrupt;
+            continue;
+        }
+        ++numUploaded;
+        fingerprintUploaded[i % MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS] = true;
+    }
+
+    unsigned int numDistinctMissing = 0;
+    for (unsigned int i=0; i < MAYA_CRASH_HARNESS_UPLOAD_NUM_FINGERPRINTS && i < numCrashes; ++i) {
+        numDistinctMissing += fingerprintUploaded[i] ? 0 : 1;
+    }
+
+    unsigned int numForeignMoved = 0;
+    for (int i=0; i < (int)(ARRAY_SIZE(kMayaCrashHarnessUploadForeignFileNames)); ++i) {
+        if (!doesMayaCrashHarnessUploadFileExist(spoolDirPath, kMayaCrashHarnessUploadForeignFileNames[i])
+            || doesMayaCrashHarnessUploadFileExist(uploadedDirPath, kMayaCrashHarnessUploadForeignFileNames[i])) {
+            fprintf(stderr, "%s was taken out of the spool.\n", kMayaCrashHarnessUploadForeignFileNames[i]);
+            ++numForeignMoved;
+        }
+    }
+
+    const double elapsedSecs = (double)(end.QuadPart - start.QuadPart) / (double)timerFrequency;
+    const uint64_t sentBytes = server.wireBytes;
+    const uint64_t compressionSavedBytes = server.rawBytes > server.wireBytes ? server.rawBytes - server.wireBytes : 0;
+    printf("Passes: %u | requests: %llu (%llu failed, %llu dropped, %llu rejected), batch records: %llu\n",
+           numPasses, server.numRequests, server.numFailed, server.numDropped, server.numRejected, server.numBatchRecords);
+    printf("Dumps uploaded: %u, skipped: %u, missing: %u, corrupt: %u | distinct crashes missing: %u | foreign files taken: %u\n",
+           numUploaded, numCrashes - numUploaded - numCorrupt, numMissing, numCorrupt, numDistinctMissing, numForeignMoved);
+    printf("Sent: %.1f MB, saved by dedup: %.1f MB, by compression: %.1f MB (%.1f%% of the spool not sent) | %.2f s, %.1f MB/s\n",
+           sentBytes / (1024.0 * 1024.0), dedupSavedBytes / (1024.0 * 1024.0), compressionSavedBytes / (1024.0 * 1024.0),
+           spoolBytes != 0 && spoolBytes > sentBytes ? 100.0 * (double)(spoolBytes - sentBytes) / (double)spoolBytes : 0.0,
+           elapsedSecs, elapsedSecs > 0.0 ? spoolBytes / (1024.0 * 1024.0) / elapsedSecs : 0.0);
+
+    numFailed += numMissing != 0 ? 1 : 0;
+    numFailed += numCorrupt != 0 ? 1 : 0;
+    numFailed += numDistinctMissing != 0 ? 1 : 0;
+    numFailed += numForeignMoved != 0 ? 1 : 0;
+
+    if (!config->keepDumps) {
+        deleteMayaCrashHarnessUploadDir(uploadedDirPath);
+        deleteMayaCrashHarnessUploadDir(spoolDirPath);
+    } else {
+        printf("Spool kept in %s\n", spoolDirPath);
+    }
+    free(dumpHashes);
+
+    return numFailed;
+}
@@ -0,0 +1,818 @@
+/**
+ * @file   maya_crash_uploader_main.c
+ * @brief  Watches the crash spool (the directory the dumps are written to) and uploads its
+ *         contents to a crash report server, so that nobody has to go around copying dumps off
+ *         the farm nodes by hand.
+ *
+ *         usage: maya_crash_uploader.exe -url <server URL> [-spool <dir>] [-ratekbps <KB/s>] [-chunkmb <MB>] [-interval <secs>] [-once]
+ *         e.g. ``maya_crash_uploader.exe -url http://crashes.studio.local:8080/api/crash -ratekbps 2048``
+ *
+ *         The protocol spoken with the server is as follows (all paths relative to the URL given):
+ *
+ *         ``POST batch``: The body is a sequence of ``MayaUploadBatchRecordHeader``s, each followed
+ *         by the contents of a small file (crash sidecars and repeat records). The server responds
+ *         with ``200`` and a body listing the fingerprints (one ``%016llx`` per line) that it
+ *         already has a dump for; dumps with those fingerprints are not uploaded.
+ *
+ *         ``GET dumps/<name>``: Responds with ``200`` and an ``X-Upload-Offset`` header holding the
+ *         number of bytes of the dump that the server already has, or ``404`` if it has none.
+ *
+ *         ``PUT dumps/<name>?offset=<offset>&total=<size>``: Uploads the next chunk of a dump.
+ *
+ *         Request bodies are compressed with the Windows Compression API (XPRESS with Huffman
+ *         coding) whenever that makes them smaller, in which case the ``X-Maya-Compression:
+ *         xpress-huff`` and ``X-Maya-Raw-Length`` headers are set.
+ */
+#ifndef _WIN32
+#error "Unsupported platform for compilation."
+#endif // _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Dbghelp.h>
+#include <winhttp.h>
+#include <compressapi.h>
+
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAYA_UPLOADER_USER_AGENT L"MayaCrashUploader/1.0"
+#define MAYA_UPLOADER_UPLOADED_DIR_NAME "uploaded"
+
+#define MAYA_UPLOADER_DEFAULT_INTERVAL_SECS 30
+#define MAYA_UPLOADER_DEFAULT_CHUNK_MB 4
+#define MAYA_UPLOADER_MAX_CHUNK_MB 64
+
+/// Small files are sent in batches of at most this many files/bytes.
+#define MAYA_UPLOADER_MAX_BATCH_RECORDS 256
+#define MAYA_UPLOADER_MAX_BATCH_BYTES (1024 * 1024)
+#define MAYA_UPLOADER_MAX_SMALL_FILE_BYTES (64 * 1024)
+
+#define MAYA_UPLOADER_MAX_DUMPS_PER_CYCLE 1024
+#define MAYA_UPLOADER_MAX_KNOWN_FINGERPRINTS 4096
+#define MAYA_UPLOADER_MAX_RESPONSE_BYTES (64 * 1024)
+
+#define MAYA_UPLOADER_MAX_RETRIES 5
+#define MAYA_UPLOADER_INITIAL_BACKOFF_MS 500
+
+/// Time to wait for the spool to settle after a change before uploading, so that the files
+/// written by a crash storm get batched together.
+#define MAYA_UPLOADER_SETTLE_MS 2000
+
+typedef struct MayaTokenBucket
+{
+    double tokens;
+    double bytesPerSec; // NOTE: (sonictk) ``0`` means unlimited.
+    double capacity;
+    LONGLONG lastRefillTicks;
+    LONGLONG timerFrequency;
+} MayaTokenBucket;
+
+typedef struct MayaUploaderStats
+{
+    uint64_t numBatches;
+    uint64_t numRecords;
+    uint64_t numDumpsUploaded;
+    uint64_t numDumpsSkipped;
+    uint64_t numRetries;
+    uint64_t rawBytes; // NOTE: (sonictk) Size of everything that was handled, whether it was sent or not.
+    uint64_t sentBytes;
+    uint64_t dedupSavedBytes;
+    uint64_t compressionSavedBytes;
+    LONGLONG busyTicks;
+} MayaUploaderStats;
+
+/// A dump in the spool, along with the fingerprint from its sidecar (if it has one).
+typedef struct MayaSpoolDump
+{
+    char fileName[MAX_PATH];
+    uint64_t fingerprint;
+    bool hasFingerprint;
+} MayaSpoolDump;
+
+typedef struct MayaUploader
+{
+    char spoolDirPath[MAX_PATH];
+    char uploadedDirPath[MAX_PATH];
+    char computerName[MAX_COMPUTERNAME_LENGTH + 1];
+    WCHAR host[256];
+    WCHAR basePath[1024];
+    INTERNET_PORT port;
+    bool secure;
+    DWORD chunkBytes;
+
+    HINTERNET hSession;
+    HINTERNET hConnect;
+    COMPRESSOR_HANDLE hCompressor;
+
+    BYTE *chunkBuf;
+    BYTE *compressedBuf;
+    SIZE_T lenCompressedBuf;
+    BYTE *batchBuf;
+    char *responseBuf;
+
+    uint64_t knownFingerprints[MAYA_UPLOADER_MAX_KNOWN_FINGERPRINTS];
+    uint32_t numKnownFingerprints;
+
+    MayaSpoolDump dumps[MAYA_UPLOADER_MAX_DUMPS_PER_CYCLE];
+    uint32_t numDumps;
+
+    MayaTokenBucket bucket;
+    MayaUploaderStats stats;
+} MayaUploader;
+
+
+void initMayaTokenBucket(MayaTokenBucket *bucket, double bytesPerSec)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    bucket->bytesPerSec = bytesPerSec;
+    bucket->capacity = bytesPerSec; // NOTE: (sonictk) Allow bursts of up to a second's worth.
+    bucket->tokens = bucket->capacity;
+    bucket->lastRefillTicks = now.QuadPart;
+    bucket->timerFrequency = freq.QuadPart;
+}
+
+
+/// Blocks until ``numBytes`` may be sent without exceeding the bandwidth cap.
+void consumeMayaTokenBucket(MayaTokenBucket *bucket, DWORD numBytes)
+{
+    if (bucket->bytesPerSec <= 0.0) {
+        return;
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    bucket->tokens += (double)(now.QuadPart - bucket->lastRefillTicks) * bucket->bytesPerSec / (double)bucket->timerFrequency;
+    bucket->tokens = bucket->tokens > bucket->capacity ? bucket->capacity : bucket->tokens;
+    bucket->lastRefillTicks = now.QuadPart;
+
+    // NOTE: (sonictk) Chunks can be larger than the bucket, so we let it go into debt and sleep
+    // off the difference instead of waiting for it to fill up.
+    bucket->tokens -= (double)numBytes;
+    if (bucket->tokens < 0.0) {
+        Sleep((DWORD)(-bucket->tokens * 1000.0 / bucket->bytesPerSec));
+        QueryPerformanceCounter(&now);
+        bucket->lastRefillTicks = now.QuadPart;
+        bucket->tokens = 0.0;
+    }
+}
+
+
+bool isKnownMayaFingerprint(const MayaUploader *uploader, uint64_t fingerprint)
+{
+    for (uint32_t i=0; i < uploader->numKnownFingerprints; ++i) {
+        if (uploader->knownFingerprints[i] == fingerprint) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void addKnownMayaFingerprint(MayaUploader *uploader, uint64_t fingerprint)
+{
+    if (isKnownMayaFingerprint(uploader, fingerprint)) {
+        return;
+    }
+    // NOTE: (sonictk) Once full, forget the oldest ones; worst case, we ask the server again.
+    if (uploader->numKnownFingerprints == MAYA_UPLOADER_MAX_KNOWN_FINGERPRINTS) {
+        memmove(uploader->knownFingerprints, uploader->knownFingerprints + 1, (MAYA_UPLOADER_MAX_KNOWN_FINGERPRINTS - 1) * sizeof(uint64_t));
+        --uploader->numKnownFingerprints;
+    }
+    uploader->knownFingerprints[uploader->numKnownFingerprints++] = fingerprint;
+}
+
+
+/**
+ * Sends a single request to the server and reads back the response, retrying with exponential
+ * backoff if the request could not be completed or the server responded with a ``5xx`` status.
+ *
+ * @param uploader          The uploader.
+ * @param verb              The HTTP verb to use.
+ * @param path              The path of the request, relative to the server URL.
+ * @param extraHeaders      Additional headers to send, separated by ``\r\n``. May be ``NULL``.
+ * @param body              The body of the request. May be ``NULL``.
+ * @param lenBody           The size of ``body``.
+ * @param statusCode        Storage for the HTTP status code of the response.
+ * @param lenResponse       Storage for the size of the response body, which is written into
+ *                          ``uploader->responseBuf`` and ``NULL``-terminated. May be ``NULL``.
+ * @param uploadOffset      Storage for the value of the ``X-Upload-Offset`` header of the
+ *                          response, if any. May be ``NULL``.
+ *
+ * @return                  ``true`` if a response was received, ``false`` otherwise.
+ */
+bool sendMayaUploadRequest(MayaUploader *uploader,
+                           const WCHAR *verb,
+                           const char *path,
+                           const char *extraHeaders,
+                           const void *body,
+                           DWORD lenBody,
+                           DWORD *statusCode,
+                           DWORD *lenResponse,
+                           uint64_t *uploadOffset)
+{
+    WCHAR fullPath[2048] = {0};
+    WCHAR relPath[1024] = {0};
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, relPath, (int)(ARRAY_SIZE(relPath)));
+    _snwprintf(fullPath, ARRAY_SIZE(fullPath) - 1, L"%s/%s", uploader->basePath, relPath);
+
+    WCHAR headers[1024] = {0};
+    if (extraHeaders != NULL) {
+        MultiByteToWideChar(CP_UTF8, 0, extraHeaders, -1, headers, (int)(ARRAY_SIZE(headers)));
+    }
+
+    DWORD backoffMs = MAYA_UPLOADER_INITIAL_BACKOFF_MS;
+    for (int attempt=0; attempt <= MAYA_UPLOADER_MAX_RETRIES; ++attempt) {
+        if (attempt > 0) {
+            ++uploader->stats.numRetries;
+            Sleep(backoffMs);
+            backoffMs *= 2;
+        }
+        *statusCode = 0;
+
+        HINTERNET hRequest = WinHttpOpenRequest(uploader->hConnect,
+                                                verb,
+                                                fullPath,
+                                                NULL,
+                                                WINHTTP_NO_REFERER,
+                                                WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                                uploader->secure ? WINHTTP_FLAG_SECURE : 0);
+        if (hRequest == NULL) {
+            continue;
+        }
+
+        BOOL bStat = WinHttpSendRequest(hRequest,
+                                        extraHeaders != NULL ? headers : WINHTTP_NO_ADDITIONAL_HEADERS,
+                                        extraHeaders != NULL ? (DWORD)-1L : 0,
+                                        (LPVOID)body,
+                                        lenBody,
+                                        lenBody,
+                                        0);
+        if (bStat == TRUE) {
+            bStat = WinHttpReceiveResponse(hRequest, NULL);
+        }
+        if (bStat != TRUE) {
+            WinHttpCloseHandle(hRequest);
+            continue;
+        }
+
+        DWORD lenStatusCode = sizeof(DWORD);
+        WinHttpQueryHeaders(hRequest,
+                            WINHTTP_QUERY_STATUS_CODE|WINHTTP_QUERY_FLAG_NUMBER,
+                            WINHTTP_HEADER_NAME_BY_INDEX,
+                            statusCode,
+                            &lenStatusCode,
+                            WINHTTP_NO_HEADER_INDEX);
+
+        if (uploadOffset != NULL) {
+            WCHAR offsetStr[32] = {0};
+            DWORD lenOffsetStr = sizeof(offsetStr);
+            *uploadOffset = 0;
+            if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CUSTOM, L"X-Upload-Offset", offsetStr, &lenOffsetStr, WINHTTP_NO_HEADER_INDEX)) {
+                *uploadOffset = _wcstoui64(offsetStr, NULL, 10);
+            }
+        }
+
+        DWORD totalRead = 0;
+        for (;;) {
+            DWORD bytesRead = 0;
+            DWORD lenRemaining = MAYA_UPLOADER_MAX_RESPONSE_BYTES - 1 - totalRead;
+            if (lenRemaining == 0
+                || !WinHttpReadData(hRequest, uploader->responseBuf + totalRead, lenRemaining, &bytesRead)
+                || bytesRead == 0) {
+                break;
+            }
+            totalRead += bytesRead;
+        }
+        uploader->responseBuf[totalRead] = '\0';
+        if (lenResponse != NULL) {
+            *lenResponse = totalRead;
+        }
+
+        WinHttpCloseHandle(hRequest);
+
+        // NOTE: (sonictk) Server-side trouble is worth retrying; anything else is for the caller to deal with.
+        if (*statusCode >= 500) {
+            continue;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * Compresses the given buffer into ``uploader->compressedBuf``.
+ *
+ * @return  The compressed size, or ``0`` if compressing it wouldn't make it any smaller.
+ */
+DWORD compressMayaUploadBody(MayaUploader *uploader, const void *data, DWORD lenData)
+{
+    if (uploader->hCompressor == NULL) {
+        return 0;
+    }
+
+    SIZE_T lenCompressed = 0;
+    if (!Compress(uploader->hCompressor, data, lenData, uploader->compressedBuf, uploader->lenCompressedBuf, &lenCompressed)
+        || lenCompressed >= lenData) {
+        return 0;
+    }
+
+    return (DWORD)lenCompressed;
+}
+
+
+/**
+ * Sends a request with the given body, compressing it if worthwhile and keeping to the
+ * bandwidth cap. Parameters are as for ``sendMayaUploadRequest``.
+ */
+bool sendMayaUploadBody(MayaUploader *uploader,
+                        const WCHAR *verb,
+                        const char *path,
+                        const char *extraHeaders,
+                        const void *body,
+                        DWORD lenBody,
+                        DWORD *statusCode,
+                        DWORD *lenResponse)
+{
+    char headers[1024] = {0};
+    const void *bodyToSend = body;
+    DWORD lenBodyToSend = lenBody;
+    DWORD lenCompressed = compressMayaUploadBody(uploader, body, lenBody);
+    if (lenCompressed != 0) {
+        snprintf(headers, sizeof(headers), "%sX-Maya-Compression: xpress-huff\r\nX-Maya-Raw-Length: %lu",
+                 extraHeaders != NULL ? extraHeaders : "", lenBody);
+        bodyToSend = uploader->compressedBuf;
+        lenBodyToSend = lenCompressed;
+    } else if (extraHeaders != NULL) {
+        snprintf(headers, sizeof(headers), "%s", extraHeaders);
+    }
+
+    consumeMayaTokenBucket(&uploader->bucket, lenBodyToSend);
+
+    bool bStat = sendMayaUploadRequest(uploader, verb, path, headers[0] != '\0' ? headers : NULL, bodyToSend, lenBodyToSend, statusCode, lenResponse, NULL);
+    if (bStat) {
+        uploader->stats.sentBytes += lenBodyToSend;
+        uploader->stats.compressionSavedBytes += lenBody - lenBodyToSend;
+    }
+
+    return bStat;
+}
+
+
+/// Moves a file that has been dealt with out of the spool, so that it isn't uploaded again.
+void moveMayaSpoolFileToUploaded(MayaUploader *uploader, const char *fileName)
+{
+    char srcPath[MAX_PATH] = {0};
+    char dstPath[MAX_PATH] = {0};
+    snprintf(srcPath, MAX_PATH, "%s\\%s", uploader->spoolDirPath, fileName);
+    snprintf(dstPath, MAX_PATH, "%s\\%s", uploader->uploadedDirPath, fileName);
+    MoveFileExA(srcPath, dstPath, MOVEFILE_REPLACE_EXISTING);
+}
+
+
+/**
+ * Reads a whole small file from the spool. Files that are still being written to (i.e. that
+ * the crash handler still has open) can't be opened, and are picked up on the next cycle instead.
+ *
+ * @return  The size of the file, or ``-1`` if it couldn't be read.
+ */
+int readMayaSpoolSmallFile(MayaUploader *uploader, const char *fileName, BYTE *buf, DWORD lenBuf)
+{
+    char filePath[MAX_PATH] = {0};
+    snprintf(filePath, MAX_PATH, "%s\\%s", uploader->spoolDirPath, fileName);
+    HANDLE hFile = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    DWORD bytesRead = 0;
+    BOOL bStat = ReadFile(hFile, buf, lenBuf, &bytesRead, NULL);
+    CloseHandle(hFile);
+
+    return bStat == TRUE ? (int)bytesRead : -1;
+}
+
+
+/**
+ * Sends one batch of small files to the server and records the fingerprints it already has.
+ *
+ * @return  ``true`` if the server accepted the batch.
+ */
+bool sendMayaUploadBatch(MayaUploader *uploader, DWORD lenBatch, uint32_t numRecords)
+{
+    DWORD statusCode = 0;
+    DWORD lenResponse = 0;
+    if (!sendMayaUploadBody(uploader, L"POST", "batch", NULL, uploader->batchBuf, lenBatch, &statusCode, &lenResponse) || statusCode != 200) {
+        fprintf(stderr, "Failed to upload a batch of %u records (HTTP status %lu).\n", numRecords, statusCode);
+        return false;
+    }
+    ++uploader->stats.numBatches;
+    uploader->stats.numRecords += numRecords;
+    uploader->stats.rawBytes += lenBatch;
+
+    for (char *line = uploader->responseBuf; *line != '\0';) {
+        char *end = NULL;
+        uint64_t fingerprint = _strtoui64(line, &end, 16);
+        if (end != line) {
+            addKnownMayaFingerprint(uploader, fingerprint);
+        }
+        line = strchr(line, '\n');
+        if (line == NULL) {
+            break;
+        }
+        ++line;
+    }
+
+    return true;
+}
+
+
+/**
+ * Gathers the sidecars and repeat records in the spool into batched requests, and notes down
+ * the fingerprint of every dump that has a sidecar.
+ */
+void uploadMayaSpoolSmallFiles(MayaUploader *uploader)
+{
+    // NOTE: (sonictk) The names of the files in each batch, so that they can be moved out of the
+    // spool once the batch has been accepted.
+    static char batchFileNames[MAYA_UPLOADER_MAX_BATCH_RECORDS][MAX_PATH];
+    uint32_t numRecords = 0;
+    DWORD lenBatch = 0;
+
+    static const char *patterns[] = {MAYA_CRASH_SIDECAR_FILE_PATTERN, MAYA_CRASH_REPEAT_RECORD_FILE_PREFIX "_*.bin"};
+    for (int p=0; p < (int)(ARRAY_SIZE(patterns)); ++p) {
+        char searchPath[MAX_PATH] = {0};
+        snprintf(searchPath, MAX_PATH, "%s\\%s", uploader->spoolDirPath, patterns[p]);
+        WIN32_FIND_DATAA findData;
+        HANDLE hFind = FindFirstFileA(searchPath, &findData);
+        for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE; bStat = FindNextFileA(hFind, &findData)) {
+            if (findData.nFileSizeHigh != 0 || findData.nFileSizeLow > MAYA_UPLOADER_MAX_SMALL_FILE_BYTES) {
+                continue;
+            }
+            if (lenBatch + sizeof(MayaUploadBatchRecordHeader) + findData.nFileSizeLow > MAYA_UPLOADER_MAX_BATCH_BYTES
+                || numRecords == MAYA_UPLOADER_MAX_BATCH_RECORDS) {
+                if (sendMayaUploadBatch(uploader, lenBatch, numRecords)) {
+                    for (uint32_t i=0; i < numRecords; ++i) {
+                        moveMayaSpoolFileToUploaded(uploader, batchFileNames[i]);
+                    }
+                }
+                numRecords = 0;
+                lenBatch = 0;
+            }
+
+            MayaUploadBatchRecordHeader *header = (MayaUploadBatchRecordHeader *)(uploader->batchBuf + lenBatch);
+            BYTE *data = uploader->batchBuf + lenBatch + sizeof(MayaUploadBatchRecordHeader);
+            int lenData = readMayaSpoolSmallFile(uploader, findData.cFileName, data, MAYA_UPLOADER_MAX_SMALL_FILE_BYTES);
+            if (lenData < 0) {
+                continue;
+            }
+
+            memset(header, 0, sizeof(MayaUploadBatchRecordHeader));
+            header->magic = MAYA_UPLOAD_BATCH_RECORD_MAGIC;
+            header->type = p == 0 ? MayaUploadBatchRecordType_Sidecar : MayaUploadBatchRecordType_RepeatRecord;
+            header->size = (uint32_t)lenData;
+            // NOTE: (sonictk) Prefix the name with the machine's, since every machine names its files the same way.
+            snprintf(header->name, MAYA_UPLOAD_BATCH_RECORD_NAME_LEN, "%s_%s", uploader->computerName, findData.cFileName);
+
+            if (p == 0 && lenData == (int)sizeof(MayaCrashSidecar)) {
+                const MayaCrashSidecar *sidecar = (const MayaCrashSidecar *)data;
+                // NOTE: (sonictk) The sidecar is named after its dump, i.e. ``<dump file name>.sidecar``.
+                size_t lenDumpFileName = strlen(findData.cFileName) - strlen(MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+                for (uint32_t i=0; i < uploader->numDumps; ++i) {
+                    MayaSpoolDump *dump = &uploader->dumps[i];
+                    if (strlen(dump->fileName) == lenDumpFileName && _strnicmp(dump->fileName, findData.cFileName, lenDumpFileName) == 0) {
+                        dump->fingerprint = sidecar->fingerprint;
+                        dump->hasFingerprint = sidecar->magic == MAYA_CRASH_SIDECAR_MAGIC;
+                        break;
+                    }
+                }
+            }
+
+            strncpy(batchFileNames[numRecords], findData.cFileName, MAX_PATH - 1);
+            lenBatch += sizeof(MayaUploadBatchRecordHeader) + (DWORD)lenData;
+            ++numRecords;
+        }
+        if (hFind != INVALID_HANDLE_VALUE) {
+            FindClose(hFind);
+        }
+    }
+
+    if (numRecords > 0 && sendMayaUploadBatch(uploader, lenBatch, numRecords)) {
+        for (uint32_t i=0; i < numRecords; ++i) {
+            moveMayaSpoolFileToUploaded(uploader, batchFileNames[i]);
+        }
+    }
+}
+
+
+/**
+ * Uploads a single dump in chunks, resuming from wherever the server got up to if a previous
+ * attempt was interrupted.
+ *
+ * @return  ``true`` if the whole dump was uploaded.
+ */
+bool uploadMayaSpoolDump(MayaUploader *uploader, const MayaSpoolDump *dump)
+{
+    char filePath[MAX_PATH] = {0};
+    snprintf(filePath, MAX_PATH, "%s\\%s", uploader->spoolDirPath, dump->fileName);
+    HANDLE hFile = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(hFile, &fileSize);
+
+    // NOTE: (sonictk) Dumps are only named uniquely per machine, so qualify the name with the machine's.
+    char remotePath[MAX_PATH * 2] = {0};
+    char remoteName[MAX_PATH] = {0};
+    snprintf(remoteName, MAX_PATH, "%s_%s", uploader->computerName, dump->fileName);
+    snprintf(remotePath, sizeof(remotePath), "dumps/%s", remoteName);
+
+    DWORD statusCode = 0;
+    uint64_t offset = 0;
+    if (!sendMayaUploadRequest(uploader, L"GET", remotePath, NULL, NULL, 0, &statusCode, NULL, &offset)) {
+        CloseHandle(hFile);
+        return false;
+    }
+    if (statusCode != 200) {
+        offset = 0;
+    }
+    if (offset > (uint64_t)fileSize.QuadPart) {
+        offset = 0;
+    }
+
+    char headers[256] = {0};
+    if (dump->hasFingerprint) {
+        snprintf(headers, sizeof(headers), "X-Maya-Fingerprint: %016llx\r\n", dump->fingerprint);
+    }
+
+    bool success = true;
+    while (offset < (uint64_t)fileSize.QuadPart) {
+        LARGE_INTEGER seekPos;
+        seekPos.QuadPart = (LONGLONG)offset;
+        SetFilePointerEx(hFile, seekPos, NULL, FILE_BEGIN);
+        DWORD bytesRead = 0;
+        if (!ReadFile(hFile, uploader->chunkBuf, uploader->chunkBytes, &bytesRead, NULL) || bytesRead == 0) {
+            success = false;
+            break;
+        }
+
+        char chunkPath[MAX_PATH * 3] = {0};
+        snprintf(chunkPath, sizeof(chunkPath), "%s?offset=%llu&total=%lld", remotePath, offset, fileSize.QuadPart);
+        if (!sendMayaUploadBody(uploader, L"PUT", chunkPath, headers[0] != '\0' ? headers : NULL, uploader->chunkBuf, bytesRead, &statusCode, NULL)
+            || (statusCode != 200 && statusCode != 201 && statusCode != 204)) {
+            // NOTE: (sonictk) Ask the server where it got up to, and carry on from there next cycle.
+            fprintf(stderr, "Failed to upload %s at offset %llu (HTTP status %lu).\n", dump->fileName, offset, statusCode);
+            success = false;
+            break;
+        }
+        offset += bytesRead;
+        uploader->stats.rawBytes += bytesRead;
+    }
+
+    CloseHandle(hFile);
+
+    return success;
+}
+
+
+/**
+ * Checks whether the given dump has a sidecar, either still in the spool or already uploaded (the
+ * sidecars go out in batches ahead of their dumps, so a dump whose upload failed has had its
+ * sidecar moved out of the spool already).
+ */
+bool hasMayaSpoolDumpSidecar(const MayaUploader *uploader, const char *dumpFileName)
+{
+    char sidecarPath[MAX_PATH] = {0};
+    snprintf(sidecarPath, MAX_PATH, "%s\\%s%s", uploader->spoolDirPath, dumpFileName, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+    if (GetFileAttributesA(sidecarPath) != INVALID_FILE_ATTRIBUTES) {
+        return true;
+    }
+    snprintf(sidecarPath, MAX_PATH, "%s\\%s%s", uploader->uploadedDirPath, dumpFileName, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+
+    return GetFileAttributesA(sidecarPath) != INVALID_FILE_ATTRIBUTES;
+}
+
+
+/// Runs one pass over the spool: batches up the small files, then uploads the dumps the server doesn't have yet.
+void runMayaUploaderCycle(MayaUploader *uploader)
+{
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    QueryPerformanceCounter(&startTime);
+
+    // NOTE: (sonictk) List the dumps first, so that their fingerprints can be filled in from the
+    // sidecars as those get batched up. The spool is usually the temp directory, which everything
+    // else writes its dumps to as well, so only the plugin's crash dumps are taken, and only once
+    // their sidecar has been written (i.e. the crash handler is done with them).
+    uploader->numDumps = 0;
+    char searchPath[MAX_PATH] = {0};
+    snprintf(searchPath, MAX_PATH, "%s\\%s", uploader->spoolDirPath, MINIDUMP_FILE_PATTERN);
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA(searchPath, &findData);
+    for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE && uploader->numDumps < MAYA_UPLOADER_MAX_DUMPS_PER_CYCLE; bStat = FindNextFileA(hFind, &findData)) {
+        if (!hasMayaSpoolDumpSidecar(uploader, findData.cFileName)) {
+            continue;
+        }
+        MayaSpoolDump *dump = &uploader->dumps[uploader->numDumps++];
+        memset(dump, 0, sizeof(MayaSpoolDump));
+        strncpy(dump->fileName, findData.cFileName, MAX_PATH - 1);
+    }
+    if (hFind != INVALID_HANDLE_VALUE) {
+        FindClose(hFind);
+    }
+
+    uploadMayaSpoolSmallFiles(uploader);
+
+    for (uint32_t i=0; i < uploader->numDumps; ++i) {
+        const MayaSpoolDump *dump = &uploader->dumps[i];
+        if (dump->hasFingerprint && isKnownMayaFingerprint(uploader, dump->fingerprint)) {
+            char filePath[MAX_PATH] = {0};
+            snprintf(filePath, MAX_PATH, "%s\\%s", uploader->spoolDirPath, dump->fileName);
+            WIN32_FILE_ATTRIBUTE_DATA fileAttrs = {0};
+            if (GetFileAttributesExA(filePath, GetFileExInfoStandard, &fileAttrs)) {
+                uint64_t fileSize = ((uint64_t)fileAttrs.nFileSizeHigh << 32) | fileAttrs.nFileSizeLow;
+                uploader->stats.dedupSavedBytes += fileSize;
+                uploader->stats.rawBytes += fileSize;
+            }
+            ++uploader->stats.numDumpsSkipped;
+            moveMayaSpoolFileToUploaded(uploader, dump->fileName);
+            continue;
+        }
+
+        if (uploadMayaSpoolDump(uploader, dump)) {
+            ++uploader->stats.numDumpsUploaded;
+            if (dump->hasFingerprint) {
+                addKnownMayaFingerprint(uploader, dump->fingerprint);
+            }
+            moveMayaSpoolFileToUploaded(uploader, dump->fileName);
+        }
+    }
+
+    QueryPerformanceCounter(&endTime);
+    uploader->stats.busyTicks += endTime.QuadPart - startTime.QuadPart;
+
+    const MayaUploaderStats *stats = &uploader->stats;
+    double busySecs = (double)stats->busyTicks / (double)uploader->bucket.timerFrequency;
+    printf("Batches: %llu (%llu records) | dumps uploaded: %llu, skipped: %llu | handled: %.1f MB, sent: %.1f MB, "
+           "saved by dedup: %.1f MB, by compression: %.1f MB | retries: %llu | throughput: %.2f MB/s\n",
+           stats->numBatches, stats->numRecords, stats->numDumpsUploaded, stats->numDumpsSkipped,
+           stats->rawBytes / (1024.0 * 1024.0), stats->sentBytes / (1024.0 * 1024.0),
+           stats->dedupSavedBytes / (1024.0 * 1024.0), stats->compressionSavedBytes / (1024.0 * 1024.0),
+           stats->numRetries,
+           busySecs > 0.0 ? stats->rawBytes / (1024.0 * 1024.0) / busySecs : 0.0);
+    fflush(stdout);
+}
+
+
+/// Splits the server URL into its host, port and base path, and connects to the server.
+bool connectMayaUploader(MayaUploader *uploader, const char *url)
+{
+    WCHAR urlW[2048] = {0};
+    MultiByteToWideChar(CP_UTF8, 0, url, -1, urlW, (int)(ARRAY_SIZE(urlW)));
+
+    URL_COMPONENTS components = {0};
+    components.dwStructSize = sizeof(components);
+    components.lpszHostName = uploader->host;
+    components.dwHostNameLength = (DWORD)(ARRAY_SIZE(uploader->host));
+    components.lpszUrlPath = uploader->basePath;
+    components.dwUrlPathLength = (DWORD)(ARRAY_SIZE(uploader->basePath));
+    if (!WinHttpCrackUrl(urlW, 0, 0, &components)) {
+        return false;
+    }
+    uploader->port = components.nPort;
+    uploader->secure = components.nScheme == INTERNET_SCHEME_HTTPS;
+
+    // NOTE: (sonictk) Paths are joined with a ``/``, so drop any trailing one.
+    size_t lenBasePath = wcslen(uploader->basePath);
+    if (lenBasePath > 0 && uploader->basePath[lenBasePath - 1] == L'/') {
+        uploader->basePath[lenBasePath - 1] = L'\0';
+    }
+
+    uploader->hSession = WinHttpOpen(MAYA_UPLOADER_USER_AGENT, WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (uploader->hSession == NULL) {
+        return false;
+    }
+    uploader->hConnect = WinHttpConnect(uploader->hSession, uploader->host, uploader->port, 0);
+
+    return uploader->hConnect != NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    static MayaUploader uploader = {0};
+    const char *url = NULL;
+    unsigned int rateKBps = 0;
+    unsigned int chunkMB = MAYA_UPLOADER_DEFAULT_CHUNK_MB;
+    unsigned int intervalSecs = MAYA_UPLOADER_DEFAULT_INTERVAL_SECS;
+    bool runOnce = false;
+
+    for (int i=1; i < argc; ++i) {
+        if (strcmp(argv[i], "-url") == 0 && i + 1 < argc) {
+            url = argv[++i];
+        } else if (strcmp(argv[i], "-spool") == 0 && i + 1 < argc) {
+            strncpy(uploader.spoolDirPath, argv[++i], MAX_PATH - 1);
+        } else if (strcmp(argv[i], "-ratekbps") == 0 && i + 1 < argc) {
+            rateKBps = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-chunkmb") == 0 && i + 1 < argc) {
+            chunkMB = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-interval") == 0 && i + 1 < argc) {
+            intervalSecs = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-once") == 0) {
+            runOnce = true;
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (url == NULL) {
+        fprintf(stderr, "usage: maya_crash_uploader.exe -url <server URL> [-spool <dir>] [-ratekbps <KB/s>] [-chunkmb <MB>] [-interval <secs>] [-once]\n");
+        return 1;
+    }
+
+    if (uploader.spoolDirPath[0] == '\0') {
+        DWORD lenTempDirPath = GetEnvironmentVariable((LPCTSTR)TEMP_ENV_VAR_NAME, (LPTSTR)uploader.spoolDirPath, (DWORD)MAX_PATH);
+        if (lenTempDirPath == 0 || lenTempDirPath >= MAX_PATH) {
+            strncpy(uploader.spoolDirPath, DEFAULT_TEMP_DIRECTORY, MAX_PATH - 1);
+        }
+    }
+    snprintf(uploader.uploadedDirPath, MAX_PATH, "%s\\%s", uploader.spoolDirPath, MAYA_UPLOADER_UPLOADED_DIR_NAME);
+    CreateDirectoryA(uploader.uploadedDirPath, NULL);
+
+    DWORD lenComputerName = (DWORD)(ARRAY_SIZE(uploader.computerName));
+    GetComputerNameA(uploader.computerName, &lenComputerName);
+
+    chunkMB = chunkMB == 0 ? 1 : chunkMB;
+    chunkMB = chunkMB > MAYA_UPLOADER_MAX_CHUNK_MB ? MAYA_UPLOADER_MAX_CHUNK_MB : chunkMB;
+    uploader.chunkBytes = chunkMB * 1024 * 1024;
+    uploader.lenCompressedBuf = uploader.chunkBytes > MAYA_UPLOADER_MAX_BATCH_BYTES ? uploader.chunkBytes : MAYA_UPLOADER_MAX_BATCH_BYTES;
+    uploader.chunkBuf = (BYTE *)malloc(uploader.chunkBytes);
+    uploader.compressedBuf = (BYTE *)malloc(uploader.lenCompressedBuf);
+    uploader.batchBuf = (BYTE *)malloc(MAYA_UPLOADER_MAX_BATCH_BYTES + sizeof(MayaUploadBatchRecordHeader) + MAYA_UPLOADER_MAX_SMALL_FILE_BYTES);
+    uploader.responseBuf = (char *)malloc(MAYA_UPLOADER_MAX_RESPONSE_BYTES);
+    if (uploader.chunkBuf == NULL || uploader.compressedBuf == NULL || uploader.batchBuf == NULL || uploader.responseBuf == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    // NOTE: (sonictk) Compression is nice to have; carry on without it if it isn't available.
+    if (!CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &uploader.hCompressor)) {
+        uploader.hCompressor = NULL;
+    }
+
+    initMayaTokenBucket(&uploader.bucket, rateKBps * 1024.0);
+
+    if (!connectMayaUploader(&uploader, url)) {
+        fprintf(stderr, "Could not connect to %s: error %lu\n", url, GetLastError());
+        return 1;
+    }
+
+    printf("Uploading from %s to %s...\n", uploader.spoolDirPath, url);
+
+    HANDLE hChange = runOnce ? INVALID_HANDLE_VALUE : FindFirstChangeNotificationA(uploader.spoolDirPath, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_LAST_WRITE);
+    for (;;) {
+        runMayaUploaderCycle(&uploader);
+        if (runOnce) {
+            break;
+        }
+
+        // NOTE: (sonictk) Wait for something to show up in the spool (or for the interval to pass,
+        // to retry anything that failed), then give it a moment to settle so that everything
+        // written by a crash storm goes out in as few batches as possible.
+        if (hChange != INVALID_HANDLE_VALUE) {
+            if (WaitForSingleObject(hChange, intervalSecs * 1000) == WAIT_OBJECT_0) {
+                Sleep(MAYA_UPLOADER_SETTLE_MS);
+            }
+            FindNextChangeNotification(hChange);
+        } else {
+            Sleep(intervalSecs * 1000);
+        }
+    }
+
+    if (hChange != INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(hChange);
+    }
+    if (uploader.hCompressor != NULL) {
+        CloseCompressor(uploader.hCompressor);
+    }
+    WinHttpCloseHandle(uploader.hConnect);
+    WinHttpCloseHandle(uploader.hSession);
+    free(uploader.responseBuf);
+    free(uploader.batchBuf);
+    free(uploader.compressedBuf);
+    free(uploader.chunkBuf);
+
+    return 0;
+}
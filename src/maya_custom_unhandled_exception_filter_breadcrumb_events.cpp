@@ -0,0 +1,121 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_breadcrumb_events.cpp
+ * @brief  Records the breadcrumbs as a timeline of timestamped events rather than just the last
+ *         value of each, so that the sequence of events leading up to a crash can be looked at
+ *         in a trace viewer (see ``dump_reader -trace``).
+ */
+#include "maya_custom_unhandled_exception_filter_breadcrumb_events.h"
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
+
+
+/// NOTE: (sonictk) The ring header and its events live in a single allocation, so that they can be
+/// written into the dump as one stream.
+static MayaBreadcrumbEventRing *gMayaBreadcrumbEventRing = NULL;
+static MayaBreadcrumbEvent *gMayaBreadcrumbEvents = NULL;
+static SIZE_T gMayaBreadcrumbEventRingSize = 0;
+
+
+bool startMayaBreadcrumbEvents(unsigned int capacity)
+{
+    if (gMayaBreadcrumbEventRing != NULL || capacity == 0) {
+        return gMayaBreadcrumbEventRing != NULL;
+    }
+
+    capacity = capacity > MAYA_BREADCRUMB_EVENTS_MAX_CAPACITY ? MAYA_BREADCRUMB_EVENTS_MAX_CAPACITY : capacity;
+    unsigned int roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+
+    const SIZE_T ringSize = sizeof(MayaBreadcrumbEventRing) + (SIZE_T)roundedCapacity * sizeof(MayaBreadcrumbEvent);
+    // NOTE: (sonictk) Straight from the OS rather than the CRT heap, so that heap corruption can't take the events with it.
+    MayaBreadcrumbEventRing *ring = (MayaBreadcrumbEventRing *)::VirtualAlloc(NULL, ringSize, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if (ring == NULL) {
+        return false;
+    }
+
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    FILETIME nowFileTime;
+    ::QueryPerformanceFrequency(&freq);
+    ::QueryPerformanceCounter(&now);
+    ::GetSystemTimeAsFileTime(&nowFileTime);
+
+    ring->magic = MAYA_BREADCRUMB_EVENTS_MAGIC;
+    ring->version = MAYA_BREADCRUMB_EVENTS_VERSION;
+    ring->capacity = roundedCapacity;
+    ring->processId = ::GetCurrentProcessId();
+    ring->numEventsWritten = 0;
+    ring->timerFrequency = (uint64_t)freq.QuadPart;
+    ring->startTimestamp = (uint64_t)now.QuadPart;
+    ring->startTime = ((uint64_t)nowFileTime.dwHighDateTime << 32) | nowFileTime.dwLowDateTime;
+
+    gMayaBreadcrumbEvents = (MayaBreadcrumbEvent *)(ring + 1);
+    gMayaBreadcrumbEventRingSize = ringSize;
+    gMayaBreadcrumbEventRing = ring;
+
+    return true;
+}
+
+
+void stopMayaBreadcrumbEvents()
+{
+    MayaBreadcrumbEventRing *ring = gMayaBreadcrumbEventRing;
+    if (ring == NULL) {
+        return;
+    }
+    gMayaBreadcrumbEventRing = NULL;
+    gMayaBreadcrumbEvents = NULL;
+    gMayaBreadcrumbEventRingSize = 0;
+    ::VirtualFree(ring, 0, MEM_RELEASE);
+
+    return;
+}
+
+
+void recordMayaBreadcrumbEvent(MayaBreadcrumbEventType type, uint32_t id, uint32_t arg, const char *name)
+{
+    MayaBreadcrumbEventRing *ring = gMayaBreadcrumbEventRing;
+    if (ring == NULL) {
+        return;
+    }
+
+    const uint64_t idx = (uint64_t)::InterlockedIncrement64((volatile LONG64 *)&ring->numEventsWritten) - 1;
+    MayaBreadcrumbEvent *event = &gMayaBreadcrumbEvents[idx & (ring->capacity - 1)];
+
+    // NOTE: (sonictk) A zero timestamp marks the event as incomplete, in case we crash halfway
+    // through writing it; the timestamp is written last.
+    volatile uint64_t *pTimestamp = (volatile uint64_t *)&event->timestamp;
+    *pTimestamp = 0;
+    event->threadId = ::GetCurrentThreadId();
+    event->type = (uint16_t)type;
+    event->reserved = 0;
+    event->id = id;
+    event->arg = arg;
+    const size_t lenName = name == NULL ? 0 : strnlen(name, MAYA_BREADCRUMB_EVENT_NAME_LEN - 1);
+    if (lenName > 0) {
+        memcpy(event->name, name, lenName);
+        countMayaSelfProfileBytes(lenName);
+    }
+    event->name[lenName] = '\0';
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    MemoryBarrier();
+    *pTimestamp = (uint64_t)now.QuadPart;
+
+    return;
+}
+
+
+bool getMayaBreadcrumbEventsStream(MINIDUMP_USER_STREAM *stream)
+{
+    if (gMayaBreadcrumbEventRing == NULL) {
+        return false;
+    }
+    stream->Type = MAYA_BREADCRUMB_EVENTS_STREAM_TYPE;
+    stream->BufferSize = (ULONG)gMayaBreadcrumbEventRingSize;
+    stream->Buffer = gMayaBreadcrumbEventRing;
+
+    return true;
+}
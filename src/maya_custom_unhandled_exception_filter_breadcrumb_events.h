@@ -0,0 +1,48 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_BREADCRUMB_EVENTS_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_BREADCRUMB_EVENTS_H
+
+#include "common.h"
+
+/// Number of breadcrumb events to keep around (rounded up to a power of two). Set to ``0`` to
+/// stop recording them.
+#define MAYA_BREADCRUMB_EVENTS_CAPACITY_ENV_VAR_NAME "MAYA_CRASH_BREADCRUMB_EVENTS"
+#define MAYA_BREADCRUMB_EVENTS_DEFAULT_CAPACITY 16384
+#define MAYA_BREADCRUMB_EVENTS_MAX_CAPACITY (1 << 22)
+
+
+/**
+ * Allocates the ring that the breadcrumb events are recorded into.
+ *
+ * @param capacity      The number of events to keep around.
+ *
+ * @return              ``true`` if the ring was allocated successfully, ``false`` otherwise.
+ */
+bool startMayaBreadcrumbEvents(unsigned int capacity);
+
+/**
+ * Stops recording breadcrumb events and frees the ring.
+ */
+void stopMayaBreadcrumbEvents();
+
+/**
+ * Records a timestamped breadcrumb event. Safe to call from any thread; this never blocks and
+ * does not allocate any memory.
+ *
+ * @param type      The type of event.
+ * @param id        See ``MayaBreadcrumbEvent``.
+ * @param arg       See ``MayaBreadcrumbEvent``.
+ * @param name      The name of the event. Truncated if it is too long.
+ */
+void recordMayaBreadcrumbEvent(MayaBreadcrumbEventType type, uint32_t id, uint32_t arg, const char *name);
+
+/**
+ * Fills in the user stream that the breadcrumb events are written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true`` if the stream was filled in, ``false`` if no events are being recorded.
+ */
+bool getMayaBreadcrumbEventsStream(MINIDUMP_USER_STREAM *stream);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_BREADCRUMB_EVENTS_H */
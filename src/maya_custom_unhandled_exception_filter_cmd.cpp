@@ -1,9 +1,13 @@
 /**
  * @file   maya_custom_unhandled_exception_filter_cmd.cpp
  * @brief  A command to forcibly crash Maya in various ways in order to test our
- *         custom unhandled exception filter.
+ *         custom unhandled exception filter, along with one to grab a dump of the
+ *         session on demand without crashing it, and one to report what the plugin
+ *         itself costs the session.
  */
 #include "maya_custom_unhandled_exception_filter_cmd.h"
+#include "maya_custom_unhandled_exception_filter_snapshot.h"
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
 
 #include <maya/MArgDatabase.h>
 
@@ -60,88 +64,223 @@ MStatus MayaForceCrashCmd::parseArgs(const MArgList &args)
 }
 
 
-#pragma warning(disable : 4717)
-__declspec(noinline) void StackOverflow1 (volatile unsigned int* param)
+MStatus MayaForceCrashCmd::redoIt()
 {
-  volatile unsigned int dummy[256];
-  dummy[*param] %= 256;
+    if (!triggerMayaForceCrash(this->crashType)) {
+        MGlobal::displayWarning("Invalid crash type specified.");
+    }
 
-  StackOverflow1 (&dummy[*param]);
+    return MStatus::kSuccess;
 }
 
 
+MStatus MayaForceCrashCmd::doIt(const MArgList &args)
+{
+    this->clearResult();
 
-// TODO: (sonictk) Make sure that each of these crash types will invoke the unhandled exception filter.
-MStatus MayaForceCrashCmd::redoIt()
+    MStatus stat = this->parseArgs(args);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
+
+    if (this->flagHelp == true) {
+        return MStatus::kSuccess;
+    }
+
+    return this->redoIt();
+}
+
+
+MStatus MayaForceCrashCmd::undoIt()
+{
+    return MStatus::kSuccess;
+}
+
+
+bool MayaForceCrashCmd::isUndoable() const
+{
+    return false;
+}
+
+
+void *MayaSnapshotDumpCmd::creator()
+{
+    MayaSnapshotDumpCmd *cmd = new MayaSnapshotDumpCmd();
+
+    cmd->flagHelp = false;
+
+    return cmd;
+}
+
+
+MSyntax MayaSnapshotDumpCmd::newSyntax()
+{
+    MSyntax syntax;
+
+    syntax.enableQuery(false);
+    syntax.enableEdit(false);
+    syntax.useSelectionAsDefault(false);
+
+    syntax.addFlag(MAYA_SNAPSHOT_DUMP_CMD_HELP_FLAG_SHORTNAME,
+                   MAYA_SNAPSHOT_DUMP_CMD_HELP_FLAG_NAME);
+
+    return syntax;
+}
+
+
+MStatus MayaSnapshotDumpCmd::parseArgs(const MArgList &args)
 {
-    MStatus result = MStatus::kSuccess;
-
-    switch (this->crashType) {
-    case MayaForceCrashType_NullPtrDereference:
-    {
-        // NOTE: (sonictk) Ok, let's trigger a crash now to test our exception handler.
-        // The simplest method here is a NULL ptr deference operation, which should result in
-        // an access violation.
-        char *p = NULL;
-        *p = 5;
-        break;
+    MStatus result;
+
+    MArgDatabase argDb(this->syntax(), args, &result);
+    CHECK_MSTATUS_AND_RETURN_IT(result);
+
+    if (argDb.isFlagSet(MAYA_SNAPSHOT_DUMP_CMD_HELP_FLAG_SHORTNAME)) {
+        MGlobal::displayInfo(MAYA_SNAPSHOT_DUMP_CMD_HELP_TEXT);
+        this->flagHelp = true;
+        return MStatus::kSuccess;
     }
-    case MayaForceCrashType_Abort: // TODO: (sonictk) This doesn't seem to call it either.
-    {
-        // NOTE: (sonictk) Ok, for more comprehensiveness, let's call some CRT functions
-        // that _normally_ would not invoke our exception filter:
-        abort(); // NOTE: (sonictk) This is normally called internally in the CRT.
-        break;
+
+    return result;
+}
+
+
+MStatus MayaSnapshotDumpCmd::redoIt()
+{
+    MayaSnapshotInfo snapshotInfo = {0};
+    snapshotInfo.reason = MayaSnapshotReason_UserRequested;
+    snapshotInfo.mainThreadId = ::GetCurrentThreadId();
+
+    char dumpFilePath[MAX_PATH] = {0};
+    MayaSnapshotDumpTimings timings = {0};
+    bool bStat = writeMayaSnapshotDump(MAYA_SNAPSHOT_DUMP_FILE_PREFIX, &snapshotInfo, dumpFilePath, MAX_PATH, &timings);
+    if (!bStat) {
+        MGlobal::displayError("Unable to write a snapshot dump of the current session.");
+        return MStatus::kFailure;
     }
-    case MayaForceCrashType_OutOfBoundsAccess:
-    {
-        std::vector<int> v;
-        v[0] = 5; // NOTE: (sonictk) Out of bounds vector access is normally caught in the CRT.
-        break;
+
+    char msg[MAX_PATH + 128] = {0};
+    snprintf(msg, sizeof(msg), "Snapshot dump written to: %s (session paused for %.3f ms, dump written in %.1f ms).",
+             dumpFilePath, timings.pauseMicroseconds / 1000.0, timings.writeMicroseconds / 1000.0);
+    MGlobal::displayInfo(msg);
+    this->setResult(MString(dumpFilePath));
+
+    return MStatus::kSuccess;
+}
+
+
+MStatus MayaSnapshotDumpCmd::doIt(const MArgList &args)
+{
+    this->clearResult();
+
+    MStatus stat = this->parseArgs(args);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
+
+    if (this->flagHelp == true) {
+        return MStatus::kSuccess;
     }
-    case MayaForceCrashType_StackCorruption:
-    {
-        // NOTE: (sonictk) Simulate stack corruption. _AddressOfReturnAddress provides the
-        // address of the memory location that holds the return address of the current function.
-        *(uintptr_t *)_AddressOfReturnAddress() = 0x1234;
-        break;
+
+    return this->redoIt();
+}
+
+
+MStatus MayaSnapshotDumpCmd::undoIt()
+{
+    return MStatus::kSuccess;
+}
+
+
+bool MayaSnapshotDumpCmd::isUndoable() const
+{
+    return false;
+}
+
+
+void *MayaSelfProfileCmd::creator()
+{
+    MayaSelfProfileCmd *cmd = new MayaSelfProfileCmd();
+
+    cmd->flagHelp = false;
+
+    return cmd;
+}
+
+
+MSyntax MayaSelfProfileCmd::newSyntax()
+{
+    MSyntax syntax;
+
+    syntax.enableQuery(false);
+    syntax.enableEdit(false);
+    syntax.useSelectionAsDefault(false);
+
+    syntax.addFlag(MAYA_SELF_PROFILE_CMD_HELP_FLAG_SHORTNAME,
+                   MAYA_SELF_PROFILE_CMD_HELP_FLAG_NAME);
+
+    return syntax;
+}
+
+
+MStatus MayaSelfProfileCmd::parseArgs(const MArgList &args)
+{
+    MStatus result;
+
+    MArgDatabase argDb(this->syntax(), args, &result);
+    CHECK_MSTATUS_AND_RETURN_IT(result);
+
+    if (argDb.isFlagSet(MAYA_SELF_PROFILE_CMD_HELP_FLAG_SHORTNAME)) {
+        MGlobal::displayInfo(MAYA_SELF_PROFILE_CMD_HELP_TEXT);
+        this->flagHelp = true;
+        return MStatus::kSuccess;
     }
-    case MayaForceCrashType_PureVirtualFuncCall: // TODO: (sonictk) This doesn't seem to trigger even the patched CRT handlers
-    {
-        // NOTE: (sonictk) Simulate a pure virtual function call.
-        struct A
-        {
-            A() { bar(); }
-            virtual void foo() = 0;
-            void bar() { foo(); }
-        };
-
-        struct B: A
-        {
-            void foo() {}
-        };
-
-        A *a = new B;
-        a->foo();
-        break;
+
+    return result;
+}
+
+
+MStatus MayaSelfProfileCmd::redoIt()
+{
+    static const char *siteNames[] = {
+        "scene open", "scene load", "time change", "MEL command", "DAG change",
+        "node added", "node removed", "idle heartbeat", "plugin load", "flight recorder"
+    };
+
+    MayaSelfProfileCounter counters[MayaSelfProfileSite_Count];
+    uint32_t numThreads = 0;
+    const double cyclesPerMs = sumMayaSelfProfileCounters(counters, &numThreads);
+    if (cyclesPerMs == 0.0) {
+        MGlobal::displayWarning("The rate of the cycle counter is not known yet; times are not available.");
     }
-    case MayaForceCrashType_StackOverflow: // TODO: (sonictk) Also doesn't get caught by the handlers.
-    {
-        unsigned int initial = 3;
-        StackOverflow1(&initial);
-        break;
+    const double msPerCycle = cyclesPerMs == 0.0 ? 0.0 : 1.0 / cyclesPerMs;
+
+    uint64_t totalCycles = 0;
+    for (int i=0; i < MayaSelfProfileSite_Count; ++i) {
+        totalCycles += counters[i].totalCycles;
     }
-    case MayaForceCrashType_NoCrash:
-    default:
-        MGlobal::displayWarning("Invalid crash type specified.");
-        break;
+
+    char msg[256] = {0};
+    snprintf(msg, sizeof(msg), "Self profile: %.3f ms spent in this plugin's callbacks across %u threads.",
+             totalCycles * msPerCycle, numThreads);
+    MGlobal::displayInfo(msg);
+    for (int i=0; i < MayaSelfProfileSite_Count; ++i) {
+        const MayaSelfProfileCounter *counter = &counters[i];
+        if (counter->numCalls == 0) {
+            continue;
+        }
+        snprintf(msg, sizeof(msg), "%-16s %12llu calls %12.3f ms total %10.0f ns avg %10.3f us max %12llu bytes copied",
+                 i < (int)(ARRAY_SIZE(siteNames)) ? siteNames[i] : "?", counter->numCalls,
+                 counter->totalCycles * msPerCycle,
+                 counter->totalCycles * msPerCycle * 1e6 / (double)counter->numCalls,
+                 counter->maxCycles * msPerCycle * 1e3,
+                 counter->numBytesCopied);
+        MGlobal::displayInfo(msg);
     }
 
-    return result;
+    this->setResult(totalCycles * msPerCycle);
+
+    return MStatus::kSuccess;
 }
 
 
-MStatus MayaForceCrashCmd::doIt(const MArgList &args)
+MStatus MayaSelfProfileCmd::doIt(const MArgList &args)
 {
     this->clearResult();
 
@@ -156,13 +295,13 @@ MStatus MayaForceCrashCmd::doIt(const MArgList &args)
 }
 
 
-MStatus MayaForceCrashCmd::undoIt()
+MStatus MayaSelfProfileCmd::undoIt()
 {
     return MStatus::kSuccess;
 }
 
 
-bool MayaForceCrashCmd::isUndoable() const
+bool MayaSelfProfileCmd::isUndoable() const
 {
     return false;
 }
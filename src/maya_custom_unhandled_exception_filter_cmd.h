@@ -5,6 +5,8 @@
 #include <maya/MSyntax.h>
 #include <maya/MArgList.h>
 
+#include "maya_custom_unhandled_exception_filter_crash.h"
+
 #define MAYA_FORCE_CRASH_CMD_NAME "mayaForceCrash"
 #define MAYA_CRASH_CMD_HELP_FLAG_SHORTNAME "-h"
 #define MAYA_CRASH_CMD_HELP_FLAG_NAME "-help"
@@ -14,17 +16,21 @@
 
 #define MAYA_CRASH_CMD_HELP_TEXT "Triggers a crash for debugging purposes."
 
+#define MAYA_SNAPSHOT_DUMP_CMD_NAME "mayaSnapshotDump"
+#define MAYA_SNAPSHOT_DUMP_CMD_HELP_FLAG_SHORTNAME "-h"
+#define MAYA_SNAPSHOT_DUMP_CMD_HELP_FLAG_NAME "-help"
 
-enum MayaForceCrashType
-{
-    MayaForceCrashType_NoCrash = 0,
-    MayaForceCrashType_NullPtrDereference,
-    MayaForceCrashType_Abort,
-    MayaForceCrashType_OutOfBoundsAccess,
-    MayaForceCrashType_StackCorruption,
-    MayaForceCrashType_PureVirtualFuncCall,
-    MayaForceCrashType_StackOverflow
-};
+#define MAYA_SNAPSHOT_DUMP_CMD_HELP_TEXT "Writes a dump of the current Maya session without interrupting it, and returns the path of the dump file written."
+
+#define MAYA_SNAPSHOT_DUMP_FILE_PREFIX "MayaCustomSnapshotDump"
+
+#define MAYA_SELF_PROFILE_CMD_NAME "mayaSelfProfile"
+#define MAYA_SELF_PROFILE_CMD_HELP_FLAG_SHORTNAME "-h"
+#define MAYA_SELF_PROFILE_CMD_HELP_FLAG_NAME "-help"
+
+#define MAYA_SELF_PROFILE_CMD_HELP_TEXT "Prints how much time this plugin's own callbacks have taken up since it was loaded, " \
+    "summed across all threads: the number of calls to each, their total, average and worst time, and the number of bytes " \
+    "they copied. Returns the total time spent in the callbacks, in milliseconds."
 
 
 struct MayaForceCrashCmd : public MPxCommand
@@ -90,4 +96,124 @@ struct MayaForceCrashCmd : public MPxCommand
 };
 
 
+struct MayaSnapshotDumpCmd : public MPxCommand
+{
+    /**
+     * Creates a new instance of the command. Used for Maya plugin registration.
+     *
+     * @return  A pointer to the new instance.
+     */
+    static void *creator();
+
+    /**
+     * This function parses the arguments that were given to the command and stores
+     * it in local class data. It finally calls ``redoIt`` to implement the actual
+     * command functionality.
+     *
+     * @param args  The arguments that were passed to the command.
+     * @return      The status code.
+     */
+    MStatus doIt(const MArgList &args);
+
+    /**
+     * Writes a snapshot dump of the live process and reports how long the session was paused for.
+     *
+     * @return      The status code.
+     */
+    MStatus redoIt();
+
+    /**
+     * This command does not modify the scene, so there is nothing to undo.
+     *
+     * @return      The status code.
+     */
+    MStatus undoIt();
+
+    /**
+     * This function specifies that the command is not undoable in Maya.
+     *
+     * @return  ``false``, as this command is not undoable.
+     */
+    bool isUndoable() const;
+
+    /**
+     * This static function returns the syntax object for this command.
+     *
+     * @return The syntax object set up for this command.
+     */
+    static MSyntax newSyntax();
+
+    /**
+     * This function parses the given arguments to the command and stores the
+     * results in local class data.
+     *
+     * @param args      The arguments that were passed to the command.
+     * @return          The status code.
+     */
+    MStatus parseArgs(const MArgList &args);
+
+    bool flagHelp;
+};
+
+
+struct MayaSelfProfileCmd : public MPxCommand
+{
+    /**
+     * Creates a new instance of the command. Used for Maya plugin registration.
+     *
+     * @return  A pointer to the new instance.
+     */
+    static void *creator();
+
+    /**
+     * This function parses the arguments that were given to the command and stores
+     * it in local class data. It finally calls ``redoIt`` to implement the actual
+     * command functionality.
+     *
+     * @param args  The arguments that were passed to the command.
+     * @return      The status code.
+     */
+    MStatus doIt(const MArgList &args);
+
+    /**
+     * Prints the cost of the plugin's callbacks, summed across all threads.
+     *
+     * @return      The status code.
+     */
+    MStatus redoIt();
+
+    /**
+     * This command does not modify the scene, so there is nothing to undo.
+     *
+     * @return      The status code.
+     */
+    MStatus undoIt();
+
+    /**
+     * This function specifies that the command is not undoable in Maya.
+     *
+     * @return  ``false``, as this command is not undoable.
+     */
+    bool isUndoable() const;
+
+    /**
+     * This static function returns the syntax object for this command.
+     *
+     * @return The syntax object set up for this command.
+     */
+    static MSyntax newSyntax();
+
+    /**
+     * This function parses the given arguments to the command and stores the
+     * results in local class data.
+     *
+     * @param args      The arguments that were passed to the command.
+     * @return          The status code.
+     */
+    MStatus parseArgs(const MArgList &args);
+
+    bool flagHelp;
+};
+
+
 #endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_CMD_H */
@@ -0,0 +1,139 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_crash.cpp
+ * @brief  The various ways of crashing the process that ``mayaForceCrash`` supports, along with
+ *         the code that writes out the crash dump. These are shared with the crash harness.
+ */
+#include "maya_custom_unhandled_exception_filter_crash.h"
+#include "maya_custom_unhandled_exception_filter_dump_writer.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <intrin.h>
+
+#include <vector>
+
+
+static const char *MAYA_FORCE_CRASH_TYPE_NAMES[MayaForceCrashType_Count] = {
+    "NoCrash",
+    "NullPtrDereference",
+    "Abort",
+    "OutOfBoundsAccess",
+    "StackCorruption",
+    "PureVirtualFuncCall",
+    "StackOverflow"
+};
+
+
+const char *getMayaForceCrashTypeName(int crashType)
+{
+    if (crashType < 0 || crashType >= MayaForceCrashType_Count) {
+        return "Unknown";
+    }
+
+    return MAYA_FORCE_CRASH_TYPE_NAMES[crashType];
+}
+
+
+#pragma warning(disable : 4717)
+__declspec(noinline) void StackOverflow1 (volatile unsigned int* param)
+{
+  volatile unsigned int dummy[256];
+  dummy[*param] %= 256;
+
+  StackOverflow1 (&dummy[*param]);
+}
+
+
+
+// TODO: (sonictk) Make sure that each of these crash types will invoke the unhandled exception filter.
+bool triggerMayaForceCrash(int crashType)
+{
+    switch (crashType) {
+    case MayaForceCrashType_NullPtrDereference:
+    {
+        // NOTE: (sonictk) Ok, let's trigger a crash now to test our exception handler.
+        // The simplest method here is a NULL ptr deference operation, which should result in
+        // an access violation.
+        char *p = NULL;
+        *p = 5;
+        break;
+    }
+    case MayaForceCrashType_Abort: // TODO: (sonictk) This doesn't seem to call it either.
+    {
+        // NOTE: (sonictk) Ok, for more comprehensiveness, let's call some CRT functions
+        // that _normally_ would not invoke our exception filter:
+        abort(); // NOTE: (sonictk) This is normally called internally in the CRT.
+        break;
+    }
+    case MayaForceCrashType_OutOfBoundsAccess:
+    {
+        std::vector<int> v;
+        v[0] = 5; // NOTE: (sonictk) Out of bounds vector access is normally caught in the CRT.
+        break;
+    }
+    case MayaForceCrashType_StackCorruption:
+    {
+        // NOTE: (sonictk) Simulate stack corruption. _AddressOfReturnAddress provides the
+        // address of the memory location that holds the return address of the current function.
+        *(uintptr_t *)_AddressOfReturnAddress() = 0x1234;
+        break;
+    }
+    case MayaForceCrashType_PureVirtualFuncCall: // TODO: (sonictk) This doesn't seem to trigger even the patched CRT handlers
+    {
+        // NOTE: (sonictk) Simulate a pure virtual function call.
+        struct A
+        {
+            A() { bar(); }
+            virtual void foo() = 0;
+            void bar() { foo(); }
+        };
+
+        struct B: A
+        {
+            void foo() {}
+        };
+
+        A *a = new B;
+        a->foo();
+        break;
+    }
+    case MayaForceCrashType_StackOverflow: // TODO: (sonictk) Also doesn't get caught by the handlers.
+    {
+        unsigned int initial = 3;
+        StackOverflow1(&initial);
+        break;
+    }
+    case MayaForceCrashType_NoCrash:
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+
+BOOL writeMayaCrashDump(HANDLE hFile, LPEXCEPTION_POINTERS exceptionInfo, MINIDUMP_USER_STREAM *streams, ULONG numStreams, int capture)
+{
+    MINIDUMP_EXCEPTION_INFORMATION dumpExceptionInfo = {0};
+    dumpExceptionInfo.ThreadId = ::GetCurrentThreadId();
+    dumpExceptionInfo.ExceptionPointers = exceptionInfo;
+    dumpExceptionInfo.ClientPointers = TRUE;
+
+    MINIDUMP_USER_STREAM_INFORMATION dumpUserInfo = {0};
+    dumpUserInfo.UserStreamCount = numStreams;
+    dumpUserInfo.UserStreamArray = streams;
+
+    static const DWORD miniDumpFlags[MayaDumpCapture_Count] = {
+        MiniDumpNormal,
+        MiniDumpWithDataSegs|MiniDumpWithPrivateReadWriteMemory|MiniDumpWithHandleData|MiniDumpWithThreadInfo|MiniDumpWithFullMemoryInfo|MiniDumpWithUnloadedModules,
+        MiniDumpWithFullMemory|MiniDumpWithHandleData|MiniDumpWithThreadInfo|MiniDumpWithFullMemoryInfo|MiniDumpWithUnloadedModules
+    };
+    if (capture <= MayaDumpCapture_Normal || capture >= MayaDumpCapture_Count) {
+        return ::MiniDumpWriteDump(::GetCurrentProcess(), ::GetCurrentProcessId(), hFile, (MINIDUMP_TYPE)miniDumpFlags[MayaDumpCapture_Normal], &dumpExceptionInfo, &dumpUserInfo, NULL);
+    }
+
+    // NOTE: (sonictk) Dumps that capture memory run to GBs, which is where having DbgHelp write
+    // it all out from this one thread starts to hurt.
+    return writeMayaDumpWithWriters(hFile, (MINIDUMP_TYPE)miniDumpFlags[capture], &dumpExceptionInfo, &dumpUserInfo, NULL);
+}
@@ -0,0 +1,75 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_CRASH_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_CRASH_H
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Dbghelp.h>
+
+/// NOTE: (sonictk) Nothing in here depends on Maya, so that the crash harness can exercise the
+/// exact same crashes and dump writing code outside of a Maya session.
+
+/// How much of the memory of the process to write into the crash dump; one of ``MayaDumpCapture``.
+#define MAYA_DUMP_CAPTURE_ENV_VAR_NAME "MAYA_CRASH_DUMP_CAPTURE"
+
+
+enum MayaForceCrashType
+{
+    MayaForceCrashType_NoCrash = 0,
+    MayaForceCrashType_NullPtrDereference,
+    MayaForceCrashType_Abort,
+    MayaForceCrashType_OutOfBoundsAccess,
+    MayaForceCrashType_StackCorruption,
+    MayaForceCrashType_PureVirtualFuncCall,
+    MayaForceCrashType_StackOverflow,
+    MayaForceCrashType_Count
+};
+
+
+enum MayaDumpCapture
+{
+    MayaDumpCapture_Normal = 0, // NOTE: (sonictk) Just the stacks, which is enough for most crashes.
+    MayaDumpCapture_PrivateMemory, // NOTE: (sonictk) Along with the heaps and the rest of the private read-write memory.
+    MayaDumpCapture_FullMemory, // NOTE: (sonictk) Everything; what the dump reader's ``-heap`` and ``-stream`` need.
+    MayaDumpCapture_Count
+};
+
+
+/**
+ * Gets a human-readable name for the given crash type.
+ *
+ * @param crashType     The crash type.
+ *
+ * @return              The name of the crash type, or ``"Unknown"`` if it is not a valid type.
+ */
+const char *getMayaForceCrashTypeName(int crashType);
+
+/**
+ * Crashes the current process in the given way.
+ *
+ * @param crashType     The type of crash to trigger. Should be one of the ``MayaForceCrashType`` values.
+ *
+ * @return              ``false`` if the crash type is not valid. Otherwise, this is not expected
+ *                      to return at all.
+ */
+bool triggerMayaForceCrash(int crashType);
+
+/**
+ * Writes a minidump of the current process to the given file, with the given user streams.
+ * This is what the unhandled exception filter uses to write out the crash dump. Dumps that
+ * capture memory are handed to the dump writers, if they have been started.
+ *
+ * @param hFile             The file to write the dump to. It must be opened with
+ *                          ``FILE_SHARE_WRITE``; see ``writeMayaDumpWithWriters``.
+ * @param exceptionInfo     The exception that caused the crash.
+ * @param streams           The user streams to write into the dump.
+ * @param numStreams        The number of user streams.
+ * @param capture           How much of the memory of the process to write; one of ``MayaDumpCapture``.
+ *
+ * @return                  ``TRUE`` if the dump was written successfully, ``FALSE`` otherwise.
+ */
+BOOL writeMayaCrashDump(HANDLE hFile, LPEXCEPTION_POINTERS exceptionInfo, MINIDUMP_USER_STREAM *streams, ULONG numStreams, int capture);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_CRASH_H */
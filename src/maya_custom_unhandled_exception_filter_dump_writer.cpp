@@ -0,0 +1,401 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_dump_writer.cpp
+ * @brief  A small pool of writer threads that the crash dump is handed to, so that writing out a
+ *         dump that captures memory isn't all done from the crashing thread, one write after the
+ *         other. DbgHelp still lays out the file and reads the memory of the process, but instead
+ *         of writing to the file itself it hands each write to us through its I/O callbacks; each
+ *         one is copied into a large chunk and written at its offset in the file by whichever
+ *         writer is free, while DbgHelp carries on with the next part of the dump.
+ */
+#include "maya_custom_unhandled_exception_filter_dump_writer.h"
+
+#include <string.h>
+
+
+enum MayaDumpChunkState
+{
+    MayaDumpChunkState_Free = 0,
+    MayaDumpChunkState_Busy // NOTE: (sonictk) Being filled, waiting for a writer, or being written.
+};
+
+/// Part of the dump that is waiting to be (or is being) written, and where in the file it goes.
+struct MayaDumpChunk
+{
+    uint8_t *buf;
+    uint64_t fileOffset;
+    ULONG size;
+    volatile LONG state;
+};
+
+/// NOTE: (sonictk) All of these are set up front, so that the crash path never has to allocate.
+static uint8_t *gMayaDumpChunkBuf = NULL;
+static MayaDumpChunk gMayaDumpChunks[MAYA_DUMP_WRITERS_NUM_CHUNKS];
+
+static HANDLE gMayaDumpWriterThreads[MAYA_DUMP_WRITERS_MAX_NUM_THREADS];
+static DWORD gMayaDumpWriterThreadIds[MAYA_DUMP_WRITERS_MAX_NUM_THREADS];
+static HANDLE gMayaDumpWriterEvents[MAYA_DUMP_WRITERS_MAX_NUM_THREADS + 1]; // NOTE: (sonictk) The last one is for the crashing thread.
+static unsigned int gMayaDumpNumWriterThreads = 0;
+static HANDLE gMayaDumpWriterStopEvent = NULL;
+static HANDLE gMayaDumpChunkFreedEvent = NULL;
+
+/// The chunks waiting for a writer. The semaphore counts them; there is only ever the one thread
+/// (DbgHelp's) adding to the queue, so the entries are always written before they are counted.
+static HANDLE gMayaDumpChunksQueuedSemaphore = NULL;
+static volatile LONG gMayaDumpQueue[MAYA_DUMP_WRITERS_NUM_CHUNKS];
+static volatile LONG gMayaDumpQueueHead = 0;
+static volatile LONG gMayaDumpQueueTail = 0;
+
+/// The state of the dump being written.
+static volatile LONG gMayaDumpWriterInUse = 0;
+static HANDLE gMayaDumpWriteFile = NULL;
+static MayaDumpChunk *gMayaDumpFillingChunk = NULL;
+static bool gMayaDumpChunkBufRemoved = false;
+static volatile LONG64 gMayaDumpNumBytesWritten = 0;
+static volatile LONG gMayaDumpNumWritesFromDbgHelp = 0;
+static volatile LONG gMayaDumpNumChunksWritten = 0;
+static volatile LONG gMayaDumpNumChunksWrittenInline = 0;
+static volatile LONG gMayaDumpNumWriteErrors = 0;
+
+
+/// Writes the next chunk in the queue at its offset in the file, and frees it. The caller must
+/// have taken the chunk off of ``gMayaDumpChunksQueuedSemaphore`` already.
+static void writeNextQueuedMayaDumpChunk(HANDLE hEvent)
+{
+    LONG queueIdx = ::InterlockedIncrement(&gMayaDumpQueueHead) - 1;
+    MayaDumpChunk *chunk = &gMayaDumpChunks[gMayaDumpQueue[queueIdx % MAYA_DUMP_WRITERS_NUM_CHUNKS]];
+
+    // NOTE: (sonictk) Works the same whether the file could be reopened for overlapped writes or
+    // not; a synchronous handle just writes at the offset given before returning.
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = (DWORD)chunk->fileOffset;
+    overlapped.OffsetHigh = (DWORD)(chunk->fileOffset >> 32);
+    overlapped.hEvent = hEvent;
+    DWORD numBytesWritten = 0;
+    BOOL bStat = ::WriteFile(gMayaDumpWriteFile, chunk->buf, chunk->size, NULL, &overlapped);
+    if (bStat == TRUE || ::GetLastError() == ERROR_IO_PENDING) {
+        bStat = ::GetOverlappedResult(gMayaDumpWriteFile, &overlapped, &numBytesWritten, TRUE);
+    }
+    if (bStat == FALSE || numBytesWritten != chunk->size) {
+        ::InterlockedIncrement(&gMayaDumpNumWriteErrors);
+    }
+    ::InterlockedExchangeAdd64(&gMayaDumpNumBytesWritten, (LONG64)numBytesWritten);
+
+    ::InterlockedExchange(&chunk->state, MayaDumpChunkState_Free);
+    ::SetEvent(gMayaDumpChunkFreedEvent);
+
+    return;
+}
+
+
+static DWORD WINAPI mayaDumpWriterThreadProc(LPVOID param)
+{
+    HANDLE hEvent = gMayaDumpWriterEvents[(uintptr_t)param];
+    HANDLE handles[2] = {gMayaDumpWriterStopEvent, gMayaDumpChunksQueuedSemaphore};
+    while (::WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        writeNextQueuedMayaDumpChunk(hEvent);
+        ::InterlockedIncrement(&gMayaDumpNumChunksWritten);
+    }
+
+    return 0;
+}
+
+
+/// Has the crashing thread write one of the queued chunks itself, if there are any.
+static bool writeQueuedMayaDumpChunkInline()
+{
+    if (::WaitForSingleObject(gMayaDumpChunksQueuedSemaphore, 0) != WAIT_OBJECT_0) {
+        return false;
+    }
+    writeNextQueuedMayaDumpChunk(gMayaDumpWriterEvents[gMayaDumpNumWriterThreads]);
+    ::InterlockedIncrement(&gMayaDumpNumChunksWrittenInline);
+
+    return true;
+}
+
+
+/// Gets a free chunk to copy the next writes into, waiting for one of the writers to finish one
+/// if need be.
+static MayaDumpChunk *acquireMayaDumpChunk()
+{
+    for (;;) {
+        for (unsigned int i=0; i < MAYA_DUMP_WRITERS_NUM_CHUNKS; ++i) {
+            if (gMayaDumpChunks[i].state == MayaDumpChunkState_Free) {
+                gMayaDumpChunks[i].state = MayaDumpChunkState_Busy;
+                gMayaDumpChunks[i].size = 0;
+                return &gMayaDumpChunks[i];
+            }
+        }
+        // NOTE: (sonictk) The writers may well have been suspended along with everything else (or
+        // never be coming back at all), so rather than wait on them forever, write one of the
+        // chunks from here.
+        if (::WaitForSingleObject(gMayaDumpChunkFreedEvent, MAYA_DUMP_WRITERS_STALL_TIMEOUT_MS) == WAIT_TIMEOUT
+            && !writeQueuedMayaDumpChunkInline()) {
+            return NULL;
+        }
+    }
+}
+
+
+static void queueMayaDumpChunk(MayaDumpChunk *chunk)
+{
+    LONG queueIdx = ::InterlockedIncrement(&gMayaDumpQueueTail) - 1;
+    gMayaDumpQueue[queueIdx % MAYA_DUMP_WRITERS_NUM_CHUNKS] = (LONG)(chunk - gMayaDumpChunks);
+    ::MemoryBarrier();
+    ::ReleaseSemaphore(gMayaDumpChunksQueuedSemaphore, 1, NULL);
+
+    return;
+}
+
+
+/**
+ * Copies a write that DbgHelp would have made into chunks, queueing each one as it fills up.
+ * Writes that follow on from each other in the file (which is nearly all of them, since DbgHelp
+ * writes the memory of the process in order) end up in the same chunk.
+ *
+ * @return  ``false`` if there was no chunk to copy the write into.
+ */
+static bool copyMayaDumpWrite(uint64_t fileOffset, const void *buf, ULONG size)
+{
+    ::InterlockedIncrement(&gMayaDumpNumWritesFromDbgHelp);
+    const uint8_t *src = (const uint8_t *)buf;
+    while (size > 0) {
+        MayaDumpChunk *chunk = gMayaDumpFillingChunk;
+        if (chunk != NULL && (fileOffset != chunk->fileOffset + chunk->size || chunk->size == MAYA_DUMP_WRITERS_CHUNK_SIZE)) {
+            queueMayaDumpChunk(chunk);
+            chunk = NULL;
+        }
+        if (chunk == NULL) {
+            chunk = acquireMayaDumpChunk();
+            gMayaDumpFillingChunk = chunk;
+            if (chunk == NULL) {
+                return false;
+            }
+            chunk->fileOffset = fileOffset;
+        }
+        const ULONG sizeToCopy = size < MAYA_DUMP_WRITERS_CHUNK_SIZE - chunk->size ? size : MAYA_DUMP_WRITERS_CHUNK_SIZE - chunk->size;
+        memcpy(chunk->buf + chunk->size, src, sizeToCopy);
+        chunk->size += sizeToCopy;
+        src += sizeToCopy;
+        fileOffset += sizeToCopy;
+        size -= sizeToCopy;
+    }
+
+    return true;
+}
+
+
+/// Queues whatever is left in the chunk being filled, and waits for every chunk to be written.
+static bool finishMayaDumpWrites()
+{
+    if (gMayaDumpFillingChunk != NULL) {
+        queueMayaDumpChunk(gMayaDumpFillingChunk);
+        gMayaDumpFillingChunk = NULL;
+    }
+    for (;;) {
+        bool allFree = true;
+        for (unsigned int i=0; i < MAYA_DUMP_WRITERS_NUM_CHUNKS; ++i) {
+            allFree = allFree && gMayaDumpChunks[i].state == MayaDumpChunkState_Free;
+        }
+        if (allFree) {
+            return gMayaDumpNumWriteErrors == 0;
+        }
+        // NOTE: (sonictk) Only give up if none of the chunks are moving at all.
+        if (::WaitForSingleObject(gMayaDumpChunkFreedEvent, MAYA_DUMP_WRITERS_STALL_TIMEOUT_MS) == WAIT_TIMEOUT
+            && !writeQueuedMayaDumpChunkInline()) {
+            return false;
+        }
+    }
+}
+
+
+static BOOL CALLBACK mayaDumpWriterMiniDumpCallback(PVOID param,
+                                                    const PMINIDUMP_CALLBACK_INPUT callbackInput,
+                                                    PMINIDUMP_CALLBACK_OUTPUT callbackOutput)
+{
+    (void)param;
+    switch (callbackInput->CallbackType) {
+    case IoStartCallback:
+        // NOTE: (sonictk) Tells DbgHelp that we'll be doing the writing from here on.
+        callbackOutput->Status = S_FALSE;
+        break;
+    case IoWriteAllCallback:
+        callbackOutput->Status = copyMayaDumpWrite(callbackInput->Io.Offset, callbackInput->Io.Buffer, callbackInput->Io.BufferBytes) ? S_OK : E_FAIL;
+        break;
+    case IoFinishCallback:
+        callbackOutput->Status = finishMayaDumpWrites() ? S_OK : E_FAIL;
+        break;
+    case IncludeThreadCallback:
+        // NOTE: (sonictk) Leave the writers out of the dump, so that DbgHelp doesn't suspend them
+        // to get at their context while they are the ones writing the dump.
+        for (unsigned int i=0; i < gMayaDumpNumWriterThreads; ++i) {
+            if (callbackInput->IncludeThread.ThreadId == gMayaDumpWriterThreadIds[i]) {
+                return FALSE;
+            }
+        }
+        break;
+    case RemoveMemoryCallback:
+        // NOTE: (sonictk) The chunks only hold copies of the dump itself.
+        if (!gMayaDumpChunkBufRemoved) {
+            callbackOutput->MemoryBase = (ULONG64)(uintptr_t)gMayaDumpChunkBuf;
+            callbackOutput->MemorySize = (ULONG)(MAYA_DUMP_WRITERS_CHUNK_SIZE * MAYA_DUMP_WRITERS_NUM_CHUNKS);
+            gMayaDumpChunkBufRemoved = true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return TRUE;
+}
+
+
+bool startMayaDumpWriters(unsigned int numThreads)
+{
+    if (gMayaDumpNumWriterThreads != 0) {
+        return true;
+    }
+    numThreads = numThreads > MAYA_DUMP_WRITERS_MAX_NUM_THREADS ? MAYA_DUMP_WRITERS_MAX_NUM_THREADS : numThreads;
+    if (numThreads == 0) {
+        return false;
+    }
+
+    // NOTE: (sonictk) Committed now, so that the chunks can't fail to be paged in when the process
+    // has run out of memory.
+    gMayaDumpChunkBuf = (uint8_t *)::VirtualAlloc(NULL, (SIZE_T)MAYA_DUMP_WRITERS_CHUNK_SIZE * MAYA_DUMP_WRITERS_NUM_CHUNKS, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    gMayaDumpWriterStopEvent = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    gMayaDumpChunkFreedEvent = ::CreateEventA(NULL, FALSE, FALSE, NULL);
+    gMayaDumpChunksQueuedSemaphore = ::CreateSemaphoreA(NULL, 0, MAYA_DUMP_WRITERS_NUM_CHUNKS, NULL);
+    bool bStat = gMayaDumpChunkBuf != NULL && gMayaDumpWriterStopEvent != NULL && gMayaDumpChunkFreedEvent != NULL && gMayaDumpChunksQueuedSemaphore != NULL;
+    for (unsigned int i=0; i <= numThreads && bStat; ++i) {
+        gMayaDumpWriterEvents[i] = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+        bStat = gMayaDumpWriterEvents[i] != NULL;
+    }
+    if (!bStat) {
+        stopMayaDumpWriters();
+        return false;
+    }
+    for (unsigned int i=0; i < MAYA_DUMP_WRITERS_NUM_CHUNKS; ++i) {
+        gMayaDumpChunks[i].buf = gMayaDumpChunkBuf + (size_t)i * MAYA_DUMP_WRITERS_CHUNK_SIZE;
+        gMayaDumpChunks[i].state = MayaDumpChunkState_Free;
+    }
+
+    for (unsigned int i=0; i < numThreads; ++i) {
+        HANDLE hThread = ::CreateThread(NULL, 0, mayaDumpWriterThreadProc, (LPVOID)(uintptr_t)i, 0, &gMayaDumpWriterThreadIds[gMayaDumpNumWriterThreads]);
+        if (hThread == NULL) {
+            break;
+        }
+        // NOTE: (sonictk) They only ever have work to do once the process has crashed, at which
+        // point nothing else should get in their way.
+        ::SetThreadPriority(hThread, THREAD_PRIORITY_ABOVE_NORMAL);
+        gMayaDumpWriterThreads[gMayaDumpNumWriterThreads++] = hThread;
+    }
+    if (gMayaDumpNumWriterThreads == 0) {
+        stopMayaDumpWriters();
+        return false;
+    }
+
+    return true;
+}
+
+
+void stopMayaDumpWriters()
+{
+    if (gMayaDumpWriterStopEvent != NULL) {
+        ::SetEvent(gMayaDumpWriterStopEvent);
+    }
+    if (gMayaDumpNumWriterThreads > 0) {
+        ::WaitForMultipleObjects(gMayaDumpNumWriterThreads, gMayaDumpWriterThreads, TRUE, INFINITE);
+    }
+    for (unsigned int i=0; i < gMayaDumpNumWriterThreads; ++i) {
+        ::CloseHandle(gMayaDumpWriterThreads[i]);
+        gMayaDumpWriterThreads[i] = NULL;
+    }
+    for (unsigned int i=0; i < MAYA_DUMP_WRITERS_MAX_NUM_THREADS + 1; ++i) {
+        if (gMayaDumpWriterEvents[i] != NULL) {
+            ::CloseHandle(gMayaDumpWriterEvents[i]);
+            gMayaDumpWriterEvents[i] = NULL;
+        }
+    }
+    gMayaDumpNumWriterThreads = 0;
+
+    if (gMayaDumpChunksQueuedSemaphore != NULL) {
+        ::CloseHandle(gMayaDumpChunksQueuedSemaphore);
+        gMayaDumpChunksQueuedSemaphore = NULL;
+    }
+    if (gMayaDumpChunkFreedEvent != NULL) {
+        ::CloseHandle(gMayaDumpChunkFreedEvent);
+        gMayaDumpChunkFreedEvent = NULL;
+    }
+    if (gMayaDumpWriterStopEvent != NULL) {
+        ::CloseHandle(gMayaDumpWriterStopEvent);
+        gMayaDumpWriterStopEvent = NULL;
+    }
+    if (gMayaDumpChunkBuf != NULL) {
+        ::VirtualFree(gMayaDumpChunkBuf, 0, MEM_RELEASE);
+        gMayaDumpChunkBuf = NULL;
+    }
+
+    return;
+}
+
+
+BOOL writeMayaDumpWithWriters(HANDLE hFile,
+                              MINIDUMP_TYPE dumpType,
+                              PMINIDUMP_EXCEPTION_INFORMATION exceptionInfo,
+                              PMINIDUMP_USER_STREAM_INFORMATION userStreamInfo,
+                              MayaDumpWriterStats *stats)
+{
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(MayaDumpWriterStats));
+    }
+    // NOTE: (sonictk) Only one dump can go through the writers at a time; any other is written the
+    // way it always was.
+    if (gMayaDumpNumWriterThreads == 0 || ::InterlockedCompareExchange(&gMayaDumpWriterInUse, 1, 0) != 0) {
+        return ::MiniDumpWriteDump(::GetCurrentProcess(), ::GetCurrentProcessId(), hFile, dumpType, exceptionInfo, userStreamInfo, NULL);
+    }
+
+    // NOTE: (sonictk) Writes through a synchronous handle are done one at a time no matter how
+    // many threads make them, so the writers need a handle of their own that allows overlapped
+    // writes. If the file can't be opened again, fall back to the one we were given; the writes
+    // then still overlap with DbgHelp reading the memory, just not with each other.
+    HANDLE hWriteFile = ::ReOpenFile(hFile, GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, FILE_FLAG_OVERLAPPED);
+    const bool reopened = hWriteFile != INVALID_HANDLE_VALUE;
+    gMayaDumpWriteFile = reopened ? hWriteFile : hFile;
+    gMayaDumpFillingChunk = NULL;
+    gMayaDumpChunkBufRemoved = false;
+    gMayaDumpNumBytesWritten = 0;
+    gMayaDumpNumWritesFromDbgHelp = 0;
+    gMayaDumpNumChunksWritten = 0;
+    gMayaDumpNumChunksWrittenInline = 0;
+    gMayaDumpNumWriteErrors = 0;
+
+    MINIDUMP_CALLBACK_INFORMATION callbackInfo = {0};
+    callbackInfo.CallbackRoutine = mayaDumpWriterMiniDumpCallback;
+    callbackInfo.CallbackParam = NULL;
+    BOOL dumpWritten = ::MiniDumpWriteDump(::GetCurrentProcess(), ::GetCurrentProcessId(), hFile, dumpType, exceptionInfo, userStreamInfo, &callbackInfo);
+
+    // NOTE: (sonictk) DbgHelp may have given up before it got to ``IoFinishCallback``; the chunks
+    // must not still be written to the file once it's handed back either way.
+    const bool writesFinished = finishMayaDumpWrites();
+    dumpWritten = dumpWritten && writesFinished ? TRUE : FALSE;
+
+    // NOTE: (sonictk) A single flush once everything is written, rather than one per write.
+    if (dumpWritten) {
+        ::FlushFileBuffers(gMayaDumpWriteFile);
+    }
+    if (reopened) {
+        ::CloseHandle(hWriteFile);
+    }
+    gMayaDumpWriteFile = NULL;
+
+    if (stats != NULL) {
+        stats->numBytesWritten = (uint64_t)gMayaDumpNumBytesWritten;
+        stats->numWritesFromDbgHelp = (uint32_t)gMayaDumpNumWritesFromDbgHelp;
+        stats->numChunksWritten = (uint32_t)gMayaDumpNumChunksWritten;
+        stats->numChunksWrittenInline = (uint32_t)gMayaDumpNumChunksWrittenInline;
+        stats->numWriteErrors = (uint32_t)gMayaDumpNumWriteErrors;
+    }
+    ::InterlockedExchange(&gMayaDumpWriterInUse, 0);
+
+    return dumpWritten;
+}
@@ -0,0 +1,80 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_DUMP_WRITER_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_DUMP_WRITER_H
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Dbghelp.h>
+
+#include <stdint.h>
+
+/// NOTE: (sonictk) Nothing in here depends on Maya either, so that the crash harness can measure
+/// the writers against DbgHelp writing the dump by itself.
+
+/// The number of writer threads to start when the dump captures memory; ``0`` to have DbgHelp
+/// write the dump by itself.
+#define MAYA_DUMP_WRITERS_ENV_VAR_NAME "MAYA_CRASH_DUMP_WRITERS"
+#define MAYA_DUMP_WRITERS_DEFAULT_NUM_THREADS 4
+#define MAYA_DUMP_WRITERS_MAX_NUM_THREADS 16
+
+/// The dump is handed to the writers in chunks of this size, which are set aside up-front so that
+/// nothing has to be allocated in the crash path.
+#define MAYA_DUMP_WRITERS_CHUNK_SIZE (4 * 1024 * 1024)
+#define MAYA_DUMP_WRITERS_NUM_CHUNKS 16
+
+/// How long to wait for a free chunk before writing the data from the crashing thread instead, in
+/// case the writers have been suspended or have died along with the rest of the process.
+#define MAYA_DUMP_WRITERS_STALL_TIMEOUT_MS 2000
+
+
+/// How a dump was written by ``writeMayaDumpWithWriters``.
+struct MayaDumpWriterStats
+{
+    uint64_t numBytesWritten;
+    uint32_t numWritesFromDbgHelp;
+    uint32_t numChunksWritten; // NOTE: (sonictk) By the writer threads.
+    uint32_t numChunksWrittenInline; // NOTE: (sonictk) By the crashing thread, because the writers stalled.
+    uint32_t numWriteErrors;
+};
+
+
+/**
+ * Starts the writer threads and sets aside the chunks that they write from. This must be done
+ * ahead of time, since neither is safe to do once the process has crashed.
+ *
+ * @param numThreads    The number of writer threads to start.
+ *
+ * @return              ``true`` if the writers were started successfully, ``false`` otherwise.
+ */
+bool startMayaDumpWriters(unsigned int numThreads);
+
+/**
+ * Stops the writer threads and releases their chunks.
+ */
+void stopMayaDumpWriters();
+
+/**
+ * Writes a dump the same way as ``MiniDumpWriteDump``, except that DbgHelp only lays out the file
+ * and reads the memory of the process: each write that it would have made is copied into a chunk
+ * and written at its offset in the file by one of the writer threads, so that writing one part of
+ * the dump overlaps with reading the next. Falls back to having DbgHelp write the dump by itself
+ * if the writers have not been started.
+ *
+ * @param hFile             The file to write the dump to. It must be opened with
+ *                          ``FILE_SHARE_WRITE``, so that it can be opened again for the writers.
+ * @param dumpType          The ``MINIDUMP_TYPE`` flags to write the dump with.
+ * @param exceptionInfo     The exception that caused the dump, if any.
+ * @param userStreamInfo    The user streams to write into the dump.
+ * @param stats             Optional storage for how the dump was written.
+ *
+ * @return                  ``TRUE`` if the dump was written successfully, ``FALSE`` otherwise.
+ */
+BOOL writeMayaDumpWithWriters(HANDLE hFile,
+                              MINIDUMP_TYPE dumpType,
+                              PMINIDUMP_EXCEPTION_INFORMATION exceptionInfo,
+                              PMINIDUMP_USER_STREAM_INFORMATION userStreamInfo,
+                              MayaDumpWriterStats *stats);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_DUMP_WRITER_H */
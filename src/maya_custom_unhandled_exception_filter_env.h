@@ -0,0 +1,53 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_ENV_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_ENV_H
+
+#include <stdlib.h>
+
+
+/**
+ * Reads an unsigned integer setting from the environment. Used to configure the various
+ * samplers/watchdogs of the plugin without having to recompile it.
+ *
+ * @param name          The name of the environment variable to read.
+ * @param defaultVal    The value to return if the variable is not set or cannot be parsed.
+ *
+ * @return              The value of the setting.
+ */
+static unsigned int getEnvironmentVariableAsUInt(const char *name, unsigned int defaultVal)
+{
+    char buf[32] = {0};
+    DWORD lenBuf = ::GetEnvironmentVariableA(name, buf, (DWORD)sizeof(buf));
+    if (lenBuf == 0 || lenBuf >= (DWORD)sizeof(buf)) {
+        return defaultVal;
+    }
+
+    char *end = NULL;
+    unsigned long val = strtoul(buf, &end, 10);
+    if (end == buf) {
+        return defaultVal;
+    }
+
+    return (unsigned int)val;
+}
+
+
+/**
+ * Retrieves the directory that dump files should be written to. This is the user's temporary
+ * directory, or ``DEFAULT_TEMP_DIRECTORY`` if it is not set. This does not allocate any memory,
+ * so that it is safe to call from within the exception filter.
+ *
+ * @param dirPath       The buffer to write the directory path into.
+ * @param lenDirPath    The size of the buffer, in bytes.
+ */
+static void getMayaDumpDirectory(char *dirPath, DWORD lenDirPath)
+{
+    DWORD lenTempDirPath = ::GetEnvironmentVariableA(TEMP_ENV_VAR_NAME, dirPath, lenDirPath);
+    if (lenTempDirPath == 0 || lenTempDirPath >= lenDirPath) {
+        static const size_t lenDefaultTempDirPath = strlen(DEFAULT_TEMP_DIRECTORY);
+        memcpy(dirPath, DEFAULT_TEMP_DIRECTORY, lenDefaultTempDirPath);
+        memset(dirPath + lenDefaultTempDirPath, 0, 1);
+    }
+}
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_ENV_H */
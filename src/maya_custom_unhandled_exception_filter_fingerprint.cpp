@@ -0,0 +1,283 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_fingerprint.cpp
+ * @brief  Crash-loop detection. When a farm job crashes deterministically, the scheduler retries
+ *         it over and over again; rather than writing (and shipping) a full dump of the same crash
+ *         every time, repeats within a window only update a tiny record with a counter.
+ */
+#include "maya_custom_unhandled_exception_filter_fingerprint.h"
+#include "maya_custom_unhandled_exception_filter_stackwalk.h"
+
+
+struct MayaCrashFingerprintCacheEntry
+{
+    uint64_t fingerprint;
+    uint64_t faultModuleId;
+    uint64_t faultModuleOffset;
+    uint64_t firstSeenTime;
+    uint64_t lastSeenTime;
+    uint32_t count;
+    uint32_t exceptionCode;
+};
+
+/// The on-disk layout of the cache file.
+struct MayaCrashFingerprintCache
+{
+    uint32_t magic;
+    uint32_t numEntries;
+    MayaCrashFingerprintCacheEntry entries[MAYA_CRASH_FINGERPRINT_CACHE_CAPACITY];
+};
+
+/// NOTE: (sonictk) Kept in the .bss segment rather than on the stack, since we might be handling
+/// a stack overflow.
+static MayaCrashFingerprintCache gMayaCrashFingerprintCache = {0};
+
+
+static inline uint64_t hashMayaFingerprintBytes(uint64_t hash, const void *data, size_t lenData)
+{
+    // NOTE: (sonictk) FNV-1a.
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i=0; i < lenData; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+uint64_t getMayaModuleId(PVOID imageBase)
+{
+    if (imageBase == NULL) {
+        return 0;
+    }
+    const IMAGE_DOS_HEADER *pDosHeader = (const IMAGE_DOS_HEADER *)imageBase;
+    if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE) {
+        return 0;
+    }
+    const IMAGE_NT_HEADERS *pNtHeaders = (const IMAGE_NT_HEADERS *)((const BYTE *)imageBase + pDosHeader->e_lfanew);
+    if (pNtHeaders->Signature != IMAGE_NT_SIGNATURE) {
+        return 0;
+    }
+
+    return ((uint64_t)pNtHeaders->FileHeader.TimeDateStamp << 32) | (uint64_t)pNtHeaders->OptionalHeader.SizeOfImage;
+}
+
+
+void computeMayaCrashFingerprint(const EXCEPTION_POINTERS *exceptionInfo, MayaCrashFingerprint *fingerprint)
+{
+    memset(fingerprint, 0, sizeof(MayaCrashFingerprint));
+    const EXCEPTION_RECORD *pRecord = exceptionInfo->ExceptionRecord;
+    fingerprint->exceptionCode = pRecord->ExceptionCode;
+
+    uint64_t hash = 14695981039346656037ULL;
+    hash = hashMayaFingerprintBytes(hash, &fingerprint->exceptionCode, sizeof(fingerprint->exceptionCode));
+
+    PVOID faultModuleBase = NULL;
+    ::RtlPcToFileHeader(pRecord->ExceptionAddress, &faultModuleBase);
+    if (faultModuleBase != NULL) {
+        fingerprint->faultModuleId = getMayaModuleId(faultModuleBase);
+        fingerprint->faultModuleOffset = (uint64_t)pRecord->ExceptionAddress - (uint64_t)faultModuleBase;
+    } else {
+        fingerprint->faultModuleOffset = (uint64_t)pRecord->ExceptionAddress;
+    }
+    hash = hashMayaFingerprintBytes(hash, &fingerprint->faultModuleId, sizeof(fingerprint->faultModuleId));
+    hash = hashMayaFingerprintBytes(hash, &fingerprint->faultModuleOffset, sizeof(fingerprint->faultModuleOffset));
+
+    // NOTE: (sonictk) Unwind a copy, so that the context handed to the dump is left untouched.
+    CONTEXT context = *exceptionInfo->ContextRecord;
+    const NT_TIB *pTib = (const NT_TIB *)::NtCurrentTeb();
+    uint64_t frames[MAYA_CRASH_FINGERPRINT_NUM_FRAMES] = {0};
+    uint32_t numFrames = walkMayaStack(&context,
+                                       (ULONG64)pTib->StackLimit,
+                                       (ULONG64)pTib->StackBase,
+                                       frames,
+                                       MAYA_CRASH_FINGERPRINT_NUM_FRAMES);
+    for (uint32_t i=0; i < numFrames; ++i) {
+        PVOID moduleBase = NULL;
+        ::RtlPcToFileHeader((PVOID)frames[i], &moduleBase);
+        uint64_t moduleId = getMayaModuleId(moduleBase);
+        uint64_t offset = frames[i] - (uint64_t)moduleBase;
+        hash = hashMayaFingerprintBytes(hash, &moduleId, sizeof(moduleId));
+        hash = hashMayaFingerprintBytes(hash, &offset, sizeof(offset));
+    }
+
+    fingerprint->hash = hash;
+
+    return;
+}
+
+
+/**
+ * Opens the cache file in ``dirPath``, locks it and reads it into ``gMayaCrashFingerprintCache``.
+ * A missing or corrupt cache reads as an empty one.
+ *
+ * @return  The handle to the locked cache file, or ``INVALID_HANDLE_VALUE`` if the cache could
+ *          not be opened or locked.
+ */
+static HANDLE openMayaCrashFingerprintCache(const char *dirPath, OVERLAPPED *lockRange)
+{
+    char cacheFilePath[MAX_PATH] = {0};
+    snprintf(cacheFilePath, MAX_PATH, "%s\\%s", dirPath, MAYA_CRASH_FINGERPRINT_CACHE_FILE_NAME);
+    HANDLE hFile = ::CreateFileA(cacheFilePath, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    memset(lockRange, 0, sizeof(OVERLAPPED));
+    if (!::LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, sizeof(MayaCrashFingerprintCache), 0, lockRange)) {
+        ::CloseHandle(hFile);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    MayaCrashFingerprintCache *cache = &gMayaCrashFingerprintCache;
+    DWORD bytesRead = 0;
+    if (!::ReadFile(hFile, cache, sizeof(MayaCrashFingerprintCache), &bytesRead, NULL)
+        || bytesRead != sizeof(MayaCrashFingerprintCache)
+        || cache->magic != MAYA_CRASH_FINGERPRINT_CACHE_MAGIC
+        || cache->numEntries > MAYA_CRASH_FINGERPRINT_CACHE_CAPACITY) {
+        memset(cache, 0, sizeof(MayaCrashFingerprintCache));
+        cache->magic = MAYA_CRASH_FINGERPRINT_CACHE_MAGIC;
+    }
+
+    return hFile;
+}
+
+
+/// Writes ``gMayaCrashFingerprintCache`` back out if it was changed, and unlocks the cache file.
+static void closeMayaCrashFingerprintCache(HANDLE hFile, OVERLAPPED *lockRange, bool changed)
+{
+    if (changed) {
+        LARGE_INTEGER zero = {0};
+        DWORD bytesWritten = 0;
+        ::SetFilePointerEx(hFile, zero, NULL, FILE_BEGIN);
+        ::WriteFile(hFile, &gMayaCrashFingerprintCache, sizeof(MayaCrashFingerprintCache), &bytesWritten, NULL);
+        ::SetEndOfFile(hFile);
+    }
+
+    ::UnlockFileEx(hFile, 0, sizeof(MayaCrashFingerprintCache), 0, lockRange);
+    ::CloseHandle(hFile);
+
+    return;
+}
+
+
+/// Finds the cache entry for the given crash, or ``NULL`` if there isn't one.
+static MayaCrashFingerprintCacheEntry *findMayaCrashFingerprintCacheEntry(MayaCrashFingerprintCache *cache, uint64_t fingerprint)
+{
+    for (uint32_t i=0; i < cache->numEntries; ++i) {
+        if (cache->entries[i].fingerprint == fingerprint) {
+            return &cache->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static inline uint64_t getMayaCrashFingerprintCacheTime()
+{
+    FILETIME nowFileTime;
+    ::GetSystemTimeAsFileTime(&nowFileTime);
+
+    return ((uint64_t)nowFileTime.dwHighDateTime << 32) | nowFileTime.dwLowDateTime;
+}
+
+
+bool checkMayaCrashFingerprintCache(const char *dirPath,
+                                    const MayaCrashFingerprint *fingerprint,
+                                    uint32_t windowSecs,
+                                    MayaCrashRepeatRecord *record)
+{
+    // NOTE: (sonictk) If we can't get at the cache, err on the side of writing the dump.
+    OVERLAPPED lockRange;
+    HANDLE hFile = openMayaCrashFingerprintCache(dirPath, &lockRange);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    const uint64_t now = getMayaCrashFingerprintCacheTime();
+    const uint64_t window = (uint64_t)windowSecs * 10000000ULL; // NOTE: (sonictk) ``FILETIME``s are in 100ns intervals.
+
+    // NOTE: (sonictk) Only a crash whose full dump was written (and recorded) within the window is
+    // a repeat. Anything else is left alone here; it only makes it into the cache once its dump
+    // has actually been written, so that a dump that failed doesn't suppress the next one.
+    MayaCrashFingerprintCacheEntry *entry = findMayaCrashFingerprintCacheEntry(&gMayaCrashFingerprintCache, fingerprint->hash);
+    const bool isRepeat = entry != NULL && now >= entry->firstSeenTime && now - entry->firstSeenTime < window;
+    if (isRepeat) {
+        entry->count++;
+        entry->lastSeenTime = now;
+    }
+
+    closeMayaCrashFingerprintCache(hFile, &lockRange, isRepeat);
+
+    if (isRepeat) {
+        memset(record, 0, sizeof(MayaCrashRepeatRecord));
+        record->magic = MAYA_CRASH_REPEAT_RECORD_MAGIC;
+        record->exceptionCode = entry->exceptionCode;
+        record->fingerprint = entry->fingerprint;
+        record->faultModuleId = entry->faultModuleId;
+        record->faultModuleOffset = entry->faultModuleOffset;
+        record->firstSeenTime = entry->firstSeenTime;
+        record->lastSeenTime = entry->lastSeenTime;
+        record->count = entry->count;
+        record->lastProcessId = ::GetCurrentProcessId();
+    }
+
+    return isRepeat;
+}
+
+
+bool recordMayaCrashFingerprint(const char *dirPath, const MayaCrashFingerprint *fingerprint)
+{
+    OVERLAPPED lockRange;
+    HANDLE hFile = openMayaCrashFingerprintCache(dirPath, &lockRange);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // NOTE: (sonictk) Either this is a new crash, or the last full dump of it is old enough that
+    // it was worth getting a fresh one. If there is no entry for it yet, take over an empty slot,
+    // or the one that was seen the longest time ago.
+    MayaCrashFingerprintCache *cache = &gMayaCrashFingerprintCache;
+    MayaCrashFingerprintCacheEntry *entry = findMayaCrashFingerprintCacheEntry(cache, fingerprint->hash);
+    if (entry == NULL && cache->numEntries < MAYA_CRASH_FINGERPRINT_CACHE_CAPACITY) {
+        entry = &cache->entries[cache->numEntries++];
+    }
+    if (entry == NULL) {
+        entry = &cache->entries[0];
+        for (uint32_t i=1; i < cache->numEntries; ++i) {
+            if (cache->entries[i].lastSeenTime < entry->lastSeenTime) {
+                entry = &cache->entries[i];
+            }
+        }
+    }
+
+    const uint64_t now = getMayaCrashFingerprintCacheTime();
+    entry->fingerprint = fingerprint->hash;
+    entry->faultModuleId = fingerprint->faultModuleId;
+    entry->faultModuleOffset = fingerprint->faultModuleOffset;
+    entry->exceptionCode = fingerprint->exceptionCode;
+    entry->firstSeenTime = now;
+    entry->lastSeenTime = now;
+    entry->count = 1;
+
+    closeMayaCrashFingerprintCache(hFile, &lockRange, true);
+
+    return true;
+}
+
+
+bool writeMayaCrashRepeatRecord(const char *dirPath, const MayaCrashRepeatRecord *record, char *filePath, DWORD lenFilePath)
+{
+    snprintf(filePath, lenFilePath, "%s\\%s_%016llx.bin", dirPath, MAYA_CRASH_REPEAT_RECORD_FILE_PREFIX, (unsigned long long)record->fingerprint);
+    HANDLE hFile = ::CreateFileA(filePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    DWORD bytesWritten = 0;
+    BOOL written = ::WriteFile(hFile, record, sizeof(MayaCrashRepeatRecord), &bytesWritten, NULL);
+    ::CloseHandle(hFile);
+
+    return written == TRUE && bytesWritten == sizeof(MayaCrashRepeatRecord);
+}
@@ -0,0 +1,100 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_FINGERPRINT_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_FINGERPRINT_H
+
+#include "common.h"
+
+/// Crashes whose fingerprint has already been dumped within this many seconds only get a repeat
+/// record written instead of another full dump. Set to ``0`` to always write a full dump.
+#define MAYA_CRASH_DEDUP_WINDOW_ENV_VAR_NAME "MAYA_CRASH_DEDUP_WINDOW_SECS"
+#define MAYA_CRASH_DEDUP_DEFAULT_WINDOW_SECS 3600
+
+/// NOTE: (sonictk) Interactive sessions that aren't handling crashes headlessly always write a
+/// full dump unless a window is asked for.
+#define MAYA_CRASH_DEDUP_DEFAULT_INTERACTIVE_WINDOW_SECS 0
+
+#define MAYA_CRASH_FINGERPRINT_CACHE_FILE_NAME "MayaCrashFingerprintCache.bin"
+#define MAYA_CRASH_FINGERPRINT_CACHE_MAGIC 0x43465043 // NOTE: (sonictk) ``CPFC``.
+#define MAYA_CRASH_FINGERPRINT_CACHE_CAPACITY 64
+
+/// Number of frames from the top of the faulting stack that go into the fingerprint. Deeper
+/// frames tend to differ between runs of the same crash (e.g. because of the event loop).
+#define MAYA_CRASH_FINGERPRINT_NUM_FRAMES 8
+
+
+struct MayaCrashFingerprint
+{
+    uint64_t hash;
+    uint64_t faultModuleId;
+    uint64_t faultModuleOffset;
+    uint32_t exceptionCode;
+};
+
+
+/**
+ * Gets a value that identifies a particular build of a loaded module: its link timestamp in the
+ * upper 32 bits and its image size in the lower 32 bits. This only reads the module's headers,
+ * so it is safe to call from within the exception filter.
+ *
+ * @param imageBase     The base address of the module.
+ *
+ * @return              The identifier of the module, or ``0`` if it does not look like a valid image.
+ */
+uint64_t getMayaModuleId(PVOID imageBase);
+
+/**
+ * Computes a fingerprint of the given crash from its exception code, the offset of the faulting
+ * instruction within its module and the module-relative return addresses at the top of the
+ * faulting stack. Since addresses are module-relative, the same crash gets the same fingerprint
+ * across runs even though the modules are loaded at different addresses. This does not allocate
+ * any memory.
+ *
+ * @param exceptionInfo     The exception to fingerprint.
+ * @param fingerprint       Storage for the fingerprint.
+ */
+void computeMayaCrashFingerprint(const EXCEPTION_POINTERS *exceptionInfo, MayaCrashFingerprint *fingerprint);
+
+/**
+ * Checks the persistent fingerprint cache in ``dirPath`` for whether the same crash already had a
+ * full dump written within the last ``windowSecs`` seconds, and if so, counts this one as a repeat
+ * of it. The cache file is locked while it is being updated, so that several processes crashing
+ * at once don't trample over each other's entries.
+ *
+ * @param dirPath           The directory that the cache lives in.
+ * @param fingerprint       The fingerprint of the crash.
+ * @param windowSecs        How long after a full dump repeats of the same crash are suppressed for.
+ * @param record            If this is a repeat, this is filled in with the record to write out.
+ *
+ * @return                  ``true`` if this crash is a repeat and a full dump should not be written.
+ */
+bool checkMayaCrashFingerprintCache(const char *dirPath,
+                                    const MayaCrashFingerprint *fingerprint,
+                                    uint32_t windowSecs,
+                                    MayaCrashRepeatRecord *record);
+
+/**
+ * Records in the persistent fingerprint cache in ``dirPath`` that a full dump of the given crash
+ * has just been written, so that repeats of it are suppressed from now on. This must only be
+ * called once the dump has been written successfully.
+ *
+ * @param dirPath           The directory that the cache lives in.
+ * @param fingerprint       The fingerprint of the crash.
+ *
+ * @return                  ``true`` if the crash was recorded, ``false`` otherwise.
+ */
+bool recordMayaCrashFingerprint(const char *dirPath, const MayaCrashFingerprint *fingerprint);
+
+/**
+ * Writes the given repeat record to ``<dirPath>\MayaCustomCrashRepeat_<fingerprint>.bin``,
+ * replacing the previous record for the same crash.
+ *
+ * @param dirPath           The directory to write the record to.
+ * @param record            The record to write.
+ * @param filePath          Storage for the path of the file written.
+ * @param lenFilePath       The size of ``filePath``, in bytes.
+ *
+ * @return                  ``true`` if the record was written successfully, ``false`` otherwise.
+ */
+bool writeMayaCrashRepeatRecord(const char *dirPath, const MayaCrashRepeatRecord *record, char *filePath, DWORD lenFilePath);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_FINGERPRINT_H */
@@ -0,0 +1,155 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_flight_recorder.cpp
+ * @brief  A per-thread flight recorder of compute events. When a crash comes out of parallel
+ *         evaluation, the breadcrumbs (which are only updated from the main thread) say nothing
+ *         about which node each worker thread was computing; the last few begin/end events of
+ *         every thread are kept around here and written into the dump.
+ */
+#include "maya_custom_unhandled_exception_filter_flight_recorder.h"
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
+
+
+/// NOTE: (sonictk) Kept in the .bss segment so that it can be written into the dump as-is.
+static MayaFlightRecorderData gMayaFlightRecorderData = {0};
+static volatile LONG gMayaFlightRecorderEnabled = 0;
+
+/// NOTE: (sonictk) Each thread finds its ring once and remembers it from then on.
+static __declspec(thread) MayaFlightRecorderRing *tMayaFlightRecorderRing = NULL;
+static __declspec(thread) bool tMayaFlightRecorderNoRingLeft = false;
+static __declspec(thread) bool tMayaFlightRecorderModulePinned = false;
+
+
+bool startMayaFlightRecorder()
+{
+    LARGE_INTEGER freq;
+    ::QueryPerformanceFrequency(&freq);
+    gMayaFlightRecorderData.timerFrequency = (uint64_t)freq.QuadPart;
+    ::InterlockedExchange(&gMayaFlightRecorderEnabled, 1);
+
+    return true;
+}
+
+
+void stopMayaFlightRecorder()
+{
+    ::InterlockedExchange(&gMayaFlightRecorderEnabled, 0);
+
+    return;
+}
+
+
+bool getMayaFlightRecorderStream(MINIDUMP_USER_STREAM *stream)
+{
+    stream->Type = MAYA_FLIGHT_RECORDER_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaFlightRecorderData);
+    stream->Buffer = &gMayaFlightRecorderData;
+
+    return true;
+}
+
+
+/// Claims a ring for the calling thread. This is the only place where threads contend with each other.
+static MayaFlightRecorderRing *claimMayaFlightRecorderRing()
+{
+    const LONG threadId = (LONG)::GetCurrentThreadId();
+    for (int i=0; i < MAYA_FLIGHT_RECORDER_MAX_THREADS; ++i) {
+        MayaFlightRecorderRing *ring = &gMayaFlightRecorderData.rings[i];
+        if (ring->threadId == 0 && ::InterlockedCompareExchange((volatile LONG *)&ring->threadId, threadId, 0) == 0) {
+            ::InterlockedIncrement((volatile LONG *)&gMayaFlightRecorderData.numRings);
+            return ring;
+        }
+    }
+    ::InterlockedIncrement((volatile LONG *)&gMayaFlightRecorderData.numDroppedThreads);
+
+    return NULL;
+}
+
+
+/// Keeps the plugin loaded for the rest of the process. Node plugins hold on to the addresses of
+/// the exported functions and can't tell when the plugin is unloaded, so once any of them has
+/// called in, those addresses must stay valid.
+static void pinMayaFlightRecorderModule()
+{
+    HMODULE hModule = NULL;
+    ::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS|GET_MODULE_HANDLE_EX_FLAG_PIN,
+                         (LPCSTR)&mayaFlightRecorderBeginEvent,
+                         &hModule);
+    tMayaFlightRecorderModulePinned = true;
+
+    return;
+}
+
+
+static inline void recordMayaFlightRecorderEvent(const char *name, uint16_t category, MayaFlightRecorderPhase phase)
+{
+    // NOTE: (sonictk) Done even while recording is off, since callers keep calling in regardless.
+    // Pinning twice is harmless, so each thread does it once rather than sharing a flag.
+    if (!tMayaFlightRecorderModulePinned) {
+        pinMayaFlightRecorderModule();
+    }
+    if (gMayaFlightRecorderEnabled == 0) {
+        return;
+    }
+
+    MayaFlightRecorderRing *ring = tMayaFlightRecorderRing;
+    if (ring == NULL) {
+        if (tMayaFlightRecorderNoRingLeft) {
+            return;
+        }
+        ring = claimMayaFlightRecorderRing();
+        if (ring == NULL) {
+            tMayaFlightRecorderNoRingLeft = true;
+            return;
+        }
+        tMayaFlightRecorderRing = ring;
+    }
+
+    const uint64_t numEventsWritten = ring->numEventsWritten;
+    MayaFlightRecorderEvent *event = &ring->events[numEventsWritten & (MAYA_FLIGHT_RECORDER_RING_CAPACITY - 1)];
+
+    // NOTE: (sonictk) FNV-1a over the whole name, while finding its length.
+    uint32_t nameId = 2166136261U;
+    size_t lenName = 0;
+    if (name != NULL) {
+        for (; name[lenName] != '\0'; ++lenName) {
+            nameId ^= (uint8_t)name[lenName];
+            nameId *= 16777619U;
+        }
+    }
+    const size_t nameStart = lenName >= MAYA_FLIGHT_RECORDER_EVENT_NAME_LEN ? lenName - (MAYA_FLIGHT_RECORDER_EVENT_NAME_LEN - 1) : 0;
+    if (lenName > 0) {
+        memcpy(event->name, name + nameStart, lenName - nameStart);
+        countMayaSelfProfileBytes(lenName - nameStart);
+    }
+    event->name[lenName - nameStart] = '\0';
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    event->timestamp = (uint64_t)now.QuadPart;
+    event->nameId = nameId;
+    event->category = category;
+    event->phase = (uint8_t)phase;
+    event->reserved = 0;
+
+    // NOTE: (sonictk) Volatile stores have release semantics under MSVC on x64, so the event is
+    // complete before it becomes visible to the dump writer.
+    *(volatile uint64_t *)&ring->numEventsWritten = numEventsWritten + 1;
+
+    return;
+}
+
+
+extern "C" DLL_EXPORT void mayaFlightRecorderBeginEvent(const char *name, uint16_t category)
+{
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    recordMayaFlightRecorderEvent(name, category, MayaFlightRecorderPhase_Begin);
+    endMayaSelfProfile(MayaSelfProfileSite_FlightRecorder, &selfProfileScope);
+}
+
+
+extern "C" DLL_EXPORT void mayaFlightRecorderEndEvent(const char *name, uint16_t category)
+{
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    recordMayaFlightRecorderEvent(name, category, MayaFlightRecorderPhase_End);
+    endMayaSelfProfile(MayaSelfProfileSite_FlightRecorder, &selfProfileScope);
+}
@@ -0,0 +1,73 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_FLIGHT_RECORDER_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_FLIGHT_RECORDER_H
+
+#include "common.h"
+
+/// Set to ``0`` to stop recording compute events.
+#define MAYA_FLIGHT_RECORDER_ENV_VAR_NAME "MAYA_CRASH_FLIGHT_RECORDER"
+
+#define MAYA_FLIGHT_RECORDER_BEGIN_EVENT_FUNC_NAME "mayaFlightRecorderBeginEvent"
+#define MAYA_FLIGHT_RECORDER_END_EVENT_FUNC_NAME "mayaFlightRecorderEndEvent"
+
+/// Suggested categories for the events; anything else is recorded as-is.
+enum MayaFlightRecorderCategory
+{
+    MayaFlightRecorderCategory_Compute = 1,
+    MayaFlightRecorderCategory_Draw,
+    MayaFlightRecorderCategory_Deform,
+    MayaFlightRecorderCategory_Custom = 0x100
+};
+
+
+/**
+ * Starts recording events from all threads.
+ *
+ * @return  ``true`` if recording was started successfully, ``false`` otherwise.
+ */
+bool startMayaFlightRecorder();
+
+/**
+ * Stops recording events. The events recorded so far are kept around.
+ */
+void stopMayaFlightRecorder();
+
+/**
+ * Fills in the user stream that the flight recorder is written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; the stream is always written.
+ */
+bool getMayaFlightRecorderStream(MINIDUMP_USER_STREAM *stream);
+
+/**
+ * Records the start of a compute (or anything else) on the calling thread. This is exported from
+ * the plugin so that node plugins can call it around their ``compute()`` (look it up with
+ * ``GetProcAddress`` under ``MAYA_FLIGHT_RECORDER_BEGIN_EVENT_FUNC_NAME``), and is cheap enough to
+ * leave on in production: it never blocks, never allocates, and doesn't touch any memory shared
+ * with other threads after the first event recorded on each thread.
+ *
+ * The first call pins the plugin in memory for the rest of the process, so the addresses looked
+ * up stay valid even after ``unloadPlugin``; events are simply dropped until the plugin is loaded
+ * again, at which point the same addresses carry on recording. Don't unload the plugin while a
+ * node plugin is making its very first call.
+ *
+ * @param name          The name of the node being computed.
+ * @param category      One of ``MayaFlightRecorderCategory``, or anything else.
+ */
+extern "C" DLL_EXPORT void mayaFlightRecorderBeginEvent(const char *name, uint16_t category);
+
+/**
+ * Records the end of an event started with ``mayaFlightRecorderBeginEvent``.
+ *
+ * @param name          The name of the node being computed.
+ * @param category      The category that the event was started with.
+ */
+extern "C" DLL_EXPORT void mayaFlightRecorderEndEvent(const char *name, uint16_t category);
+
+
+/// The signature of the functions above, for node plugins looking them up with ``GetProcAddress``.
+typedef void (*MayaFlightRecorderEventFunc)(const char *name, uint16_t category);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_FLIGHT_RECORDER_H */
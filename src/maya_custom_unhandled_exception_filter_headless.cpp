@@ -0,0 +1,181 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_headless.cpp
+ * @brief  Headless crash handling for farm jobs. A modal dialog in a session with no one to
+ *         click it blocks the node until a watchdog reaps it; instead, the crash is reported in a
+ *         form that the farm scheduler can parse and the process exits straight away.
+ */
+#include "maya_custom_unhandled_exception_filter_headless.h"
+#include "maya_custom_unhandled_exception_filter_env.h"
+
+
+/// NOTE: (sonictk) C++ exceptions thrown by MSVC-compiled code are raised with this code (``.msc``).
+#define MAYA_MSVC_CPP_EXCEPTION_CODE 0xE06D7363
+
+/// NOTE: (sonictk) Heap corruption detected by the heap manager; not defined in every SDK version.
+#ifndef STATUS_HEAP_CORRUPTION
+#define STATUS_HEAP_CORRUPTION 0xC0000374
+#endif // STATUS_HEAP_CORRUPTION
+
+
+bool isMayaHeadlessCrashMode(bool isBatchSession)
+{
+    unsigned int mode = getEnvironmentVariableAsUInt(MAYA_CRASH_HEADLESS_ENV_VAR_NAME, MAYA_CRASH_HEADLESS_AUTO);
+    if (mode == MAYA_CRASH_HEADLESS_AUTO) {
+        return isBatchSession;
+    }
+
+    return mode != 0;
+}
+
+
+MayaCrashExitCode getMayaCrashExitCode(DWORD exceptionCode)
+{
+    switch (exceptionCode) {
+    case EXCEPTION_ACCESS_VIOLATION:
+    case EXCEPTION_IN_PAGE_ERROR:
+    case EXCEPTION_ARRAY_BOUNDS_EXCEEDED:
+    case EXCEPTION_DATATYPE_MISALIGNMENT:
+        return MayaCrashExitCode_AccessViolation;
+    case EXCEPTION_STACK_OVERFLOW:
+        return MayaCrashExitCode_StackOverflow;
+    case EXCEPTION_ILLEGAL_INSTRUCTION:
+    case EXCEPTION_PRIV_INSTRUCTION:
+        return MayaCrashExitCode_IllegalInstruction;
+    case EXCEPTION_INT_DIVIDE_BY_ZERO:
+    case EXCEPTION_INT_OVERFLOW:
+    case EXCEPTION_FLT_DENORMAL_OPERAND:
+    case EXCEPTION_FLT_DIVIDE_BY_ZERO:
+    case EXCEPTION_FLT_INEXACT_RESULT:
+    case EXCEPTION_FLT_INVALID_OPERATION:
+    case EXCEPTION_FLT_OVERFLOW:
+    case EXCEPTION_FLT_STACK_CHECK:
+    case EXCEPTION_FLT_UNDERFLOW:
+        return MayaCrashExitCode_Arithmetic;
+    case MAYA_MSVC_CPP_EXCEPTION_CODE:
+        return MayaCrashExitCode_CPPException;
+    case SIGABRT: // NOTE: (sonictk) Raised by our ``SIGABRT`` handler.
+        return MayaCrashExitCode_Abort;
+    case EXCEPTION_NONCONTINUABLE: // NOTE: (sonictk) Used as the code by our pure call handler.
+        return MayaCrashExitCode_PureCall;
+    case STATUS_HEAP_CORRUPTION:
+        return MayaCrashExitCode_HeapCorruption;
+    default:
+        return MayaCrashExitCode_Other;
+    }
+}
+
+
+bool isMayaFirstChanceExceptionFatal(const EXCEPTION_RECORD *record)
+{
+    // NOTE: (sonictk) Whether an exception was raised continuable says nothing about whether
+    // anyone can recover from it: access violations and stack overflows are raised continuable,
+    // and a host ``__except`` or ``catch (...)`` further up would swallow them without a dump if we
+    // left them to the unhandled exception filter. So we go by the code instead, and let
+    // everything else (C++ throws, guard pages, breakpoints, debugger notifications) through.
+    switch (record->ExceptionCode) {
+    case EXCEPTION_ACCESS_VIOLATION:
+    case EXCEPTION_STACK_OVERFLOW:
+    case EXCEPTION_ILLEGAL_INSTRUCTION:
+    case EXCEPTION_PRIV_INSTRUCTION:
+    case EXCEPTION_INT_DIVIDE_BY_ZERO:
+    case STATUS_HEAP_CORRUPTION:
+    case EXCEPTION_NONCONTINUABLE_EXCEPTION:
+    case SIGABRT: // NOTE: (sonictk) Raised by our ``SIGABRT`` handler.
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+static const char *getMayaCrashExitCodeName(MayaCrashExitCode exitCode)
+{
+    switch (exitCode) {
+    case MayaCrashExitCode_AccessViolation:
+        return "access_violation";
+    case MayaCrashExitCode_StackOverflow:
+        return "stack_overflow";
+    case MayaCrashExitCode_IllegalInstruction:
+        return "illegal_instruction";
+    case MayaCrashExitCode_Arithmetic:
+        return "arithmetic";
+    case MayaCrashExitCode_CPPException:
+        return "cpp_exception";
+    case MayaCrashExitCode_Abort:
+        return "abort";
+    case MayaCrashExitCode_PureCall:
+        return "pure_call";
+    case MayaCrashExitCode_HeapCorruption:
+        return "heap_corruption";
+    case MayaCrashExitCode_Other:
+    default:
+        return "other";
+    }
+}
+
+
+static const char *getMayaHeadlessCrashStatusName(MayaHeadlessCrashStatus status)
+{
+    switch (status) {
+    case MayaHeadlessCrashStatus_Dumped:
+        return "dumped";
+    case MayaHeadlessCrashStatus_Repeat:
+        return "repeat";
+    case MayaHeadlessCrashStatus_DumpFailed:
+    default:
+        return "dump_failed";
+    }
+}
+
+
+void finishMayaHeadlessCrash(const char *dirPath, const MayaHeadlessCrashReport *report)
+{
+    const MayaCrashExitCode exitCode = getMayaCrashExitCode(report->exceptionCode);
+
+    LARGE_INTEGER now;
+    LARGE_INTEGER freq;
+    ::QueryPerformanceCounter(&now);
+    ::QueryPerformanceFrequency(&freq);
+    const double elapsedMs = (double)(now.QuadPart - report->faultTime.QuadPart) * 1000.0 / (double)freq.QuadPart;
+
+    // NOTE: (sonictk) Kept in the .bss segment rather than on the stack, since we might be handling
+    // a stack overflow.
+    static char line[MAX_PATH * 2];
+    int lenLine = snprintf(line,
+                           sizeof(line),
+                           "MAYA_CRASH status=%s class=%s exit_code=%d exception_code=0x%08lx address=0x%p fingerprint=%016llx pid=%lu elapsed_ms=%.3f path=%s\n",
+                           getMayaHeadlessCrashStatusName(report->status),
+                           getMayaCrashExitCodeName(exitCode),
+                           (int)exitCode,
+                           report->exceptionCode,
+                           report->exceptionAddress,
+                           (unsigned long long)report->fingerprint,
+                           ::GetCurrentProcessId(),
+                           elapsedMs,
+                           report->filePath != NULL ? report->filePath : "");
+    if (lenLine < 0) {
+        lenLine = 0;
+    } else if (lenLine >= (int)sizeof(line)) {
+        lenLine = (int)sizeof(line) - 1;
+    }
+
+    // NOTE: (sonictk) Go straight to the handle instead of through the CRT, whose state can't be
+    // trusted at this point.
+    DWORD bytesWritten = 0;
+    HANDLE hStdErr = ::GetStdHandle(STD_ERROR_HANDLE);
+    if (hStdErr != NULL && hStdErr != INVALID_HANDLE_VALUE) {
+        ::WriteFile(hStdErr, line, (DWORD)lenLine, &bytesWritten, NULL);
+    }
+
+    char statusFilePath[MAX_PATH] = {0};
+    snprintf(statusFilePath, MAX_PATH, "%s\\%s_%lu.txt", dirPath, MAYA_CRASH_STATUS_FILE_PREFIX, ::GetCurrentProcessId());
+    HANDLE hFile = ::CreateFileA(statusFilePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        ::WriteFile(hFile, line, (DWORD)lenLine, &bytesWritten, NULL);
+        ::CloseHandle(hFile);
+    }
+
+    // NOTE: (sonictk) Don't give anything else (including the CRT's atexit handlers and other
+    // plugins' DllMains) the chance to hang on the way out.
+    ::TerminateProcess(::GetCurrentProcess(), (UINT)exitCode);
+}
@@ -0,0 +1,96 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_HEADLESS_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_HEADLESS_H
+
+#include "common.h"
+
+
+/// Set this to ``1`` to always handle crashes headlessly (no dialogs, exit straight away), or to
+/// ``0`` to always show the dialogs. If it is not set, batch sessions (``mayabatch``, ``mayapy``,
+/// ``Render``) are handled headlessly and interactive sessions are not.
+#define MAYA_CRASH_HEADLESS_ENV_VAR_NAME "MAYA_CRASH_HEADLESS"
+#define MAYA_CRASH_HEADLESS_AUTO 2
+
+#define MAYA_CRASH_STATUS_FILE_PREFIX "MayaCustomCrashStatus"
+
+/// The code that a headless session exits with after a crash, depending on what kind of crash it
+/// was. Farm schedulers can use these to decide whether a job is worth retrying.
+enum MayaCrashExitCode
+{
+    MayaCrashExitCode_Other = 200,
+    MayaCrashExitCode_AccessViolation,
+    MayaCrashExitCode_StackOverflow,
+    MayaCrashExitCode_IllegalInstruction,
+    MayaCrashExitCode_Arithmetic,
+    MayaCrashExitCode_CPPException,
+    MayaCrashExitCode_Abort,
+    MayaCrashExitCode_PureCall,
+    MayaCrashExitCode_HeapCorruption
+};
+
+/// What the exception filter managed to do about the crash.
+enum MayaHeadlessCrashStatus
+{
+    MayaHeadlessCrashStatus_Dumped = 0,
+    MayaHeadlessCrashStatus_Repeat,
+    MayaHeadlessCrashStatus_DumpFailed
+};
+
+struct MayaHeadlessCrashReport
+{
+    DWORD exceptionCode;
+    PVOID exceptionAddress;
+    uint64_t fingerprint;
+    LARGE_INTEGER faultTime; // NOTE: (sonictk) From ``QueryPerformanceCounter``, when the filter was entered.
+    MayaHeadlessCrashStatus status;
+    const char *filePath; // NOTE: (sonictk) The dump or repeat record written, if any.
+};
+
+
+/**
+ * Determines whether crashes should be handled headlessly, based on ``MAYA_CRASH_HEADLESS`` and
+ * the kind of session that is running.
+ *
+ * @param isBatchSession    Whether Maya is running without a UI.
+ *
+ * @return                  ``true`` if crashes should be handled headlessly.
+ */
+bool isMayaHeadlessCrashMode(bool isBatchSession);
+
+/**
+ * Maps an exception code to the code that the process should exit with.
+ *
+ * @param exceptionCode     The code of the exception that caused the crash.
+ *
+ * @return                  One of ``MayaCrashExitCode``.
+ */
+MayaCrashExitCode getMayaCrashExitCode(DWORD exceptionCode);
+
+/**
+ * Determines whether an exception seen by the vectored exception handler (i.e. before any
+ * ``__try``/``__except`` or ``catch`` has had a look at it) is a crash, which must be dumped
+ * there and then rather than risk a handler further up swallowing it. Most exceptions raised in
+ * a healthy session (C++ throws, guard page probes, debugger notifications) are handled by
+ * whoever raised them, and must be left for the unhandled exception filter to see if no one does.
+ *
+ * @param record            The exception.
+ *
+ * @return                  ``true`` if the exception is an access violation, stack overflow,
+ *                          illegal or privileged instruction, integer division by zero, heap
+ *                          corruption, an attempt to continue from a noncontinuable exception, or
+ *                          the one raised by our ``SIGABRT`` handler.
+ */
+bool isMayaFirstChanceExceptionFatal(const EXCEPTION_RECORD *record);
+
+/**
+ * Reports the crash with a single machine-readable line on ``stderr`` and in a
+ * ``MayaCustomCrashStatus_<pid>.txt`` file in the given directory, and then terminates the
+ * process immediately with the exit code for the kind of crash it was. This does not allocate
+ * any memory, so that it is safe to call from within the exception filter.
+ *
+ * @param dirPath           The directory to write the status file to.
+ * @param report            The crash to report.
+ */
+void finishMayaHeadlessCrash(const char *dirPath, const MayaHeadlessCrashReport *report);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_HEADLESS_H */
@@ -0,0 +1,184 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_iat.cpp
+ * @brief  Import address table patching, used to stop other modules from replacing our handlers.
+ *         Every module is patched once when the plugin is loaded, and modules loaded afterwards are
+ *         patched one at a time from a loader notification.
+ */
+#include "maya_custom_unhandled_exception_filter_iat.h"
+
+#include <TlHelp32.h>
+
+
+/// The loader notification API is exported by ntdll.dll, but not declared in any of the SDK headers.
+/// See: https://docs.microsoft.com/en-us/windows/win32/devnotes/ldrregisterdllnotification
+#define MAYA_LDR_DLL_NOTIFICATION_REASON_LOADED 1
+
+struct MayaLdrUnicodeString
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    PWSTR Buffer;
+};
+
+struct MayaLdrDllNotificationData
+{
+    ULONG Flags;
+    const MayaLdrUnicodeString *FullDllName;
+    const MayaLdrUnicodeString *BaseDllName;
+    PVOID DllBase;
+    ULONG SizeOfImage;
+};
+
+typedef VOID (CALLBACK *MayaLdrDllNotificationFunc)(ULONG reason, const MayaLdrDllNotificationData *data, PVOID context);
+typedef LONG (NTAPI *LdrRegisterDllNotificationFunc)(ULONG flags, MayaLdrDllNotificationFunc notificationFunc, PVOID context, PVOID *cookie);
+typedef LONG (NTAPI *LdrUnregisterDllNotificationFunc)(PVOID cookie);
+
+static MayaIATHook gMayaModuleLoadIATHooks[MAYA_MAX_IAT_HOOKS] = {};
+static unsigned int gMayaNumModuleLoadIATHooks = 0;
+static PVOID gMayaDllNotificationCookie = NULL;
+
+
+unsigned int patchOverIATEntriesInOneModule(HMODULE hmodCaller, const MayaIATHook *hooks, unsigned int numHooks, bool restore)
+{
+    // NOTE: (sonictk) We parse the PE headers ourselves rather than going through
+    // ``ImageDirectoryEntryToDataEx``, since this can be called from within a loader notification
+    // (i.e. with the loader lock held), and DbgHelp is not safe to call from there.
+    PBYTE pBase = (PBYTE)hmodCaller;
+    PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)pBase;
+    if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE) {
+        return 0;
+    }
+    PIMAGE_NT_HEADERS pNtHeaders = (PIMAGE_NT_HEADERS)(pBase + pDosHeader->e_lfanew);
+    if (pNtHeaders->Signature != IMAGE_NT_SIGNATURE) {
+        return 0;
+    }
+    const IMAGE_DATA_DIRECTORY *pImportDir = &pNtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+    if (pImportDir->VirtualAddress == 0 || pImportDir->Size == 0) {
+        return 0;
+    }
+
+    unsigned int numPatched = 0;
+    MEMORY_BASIC_INFORMATION memDesc = {0};
+    DWORD dwOldProtect = 0;
+    PIMAGE_IMPORT_DESCRIPTOR pImportDesc = (PIMAGE_IMPORT_DESCRIPTOR)(pBase + pImportDir->VirtualAddress);
+    for (; pImportDesc->Name != NULL && pImportDesc->Characteristics != NULL; ++pImportDesc) {
+        // NOTE: (sonictk) Go over each IAT thunk from the import desc. to find the ones used to call our desired procs.
+        PIMAGE_THUNK_DATA pThunk = (PIMAGE_THUNK_DATA)(pBase + pImportDesc->FirstThunk);
+        for (; pThunk->u1.Function != NULL; ++pThunk) {
+            PROC *pFunc = (PROC *)&pThunk->u1.Function;
+            for (unsigned int i=0; i < numHooks; ++i) {
+                PROC pfnCurrent = restore ? hooks[i].pfnNew : hooks[i].pfnOrig;
+                PROC pfnNew = restore ? hooks[i].pfnOrig : hooks[i].pfnNew;
+                if (*pFunc != pfnCurrent) {
+                    continue;
+                }
+
+                // NOTE: (sonictk) Found! Now we can patch over it. To do that, let's check the memory
+                // page where this is stored and set its permissions to be writable. The IAT is contiguous,
+                // so we only need to do this once per module in the common case.
+                if (memDesc.BaseAddress == NULL
+                    || (PBYTE)pFunc < (PBYTE)memDesc.BaseAddress
+                    || (PBYTE)pFunc + sizeof(PROC) > (PBYTE)memDesc.BaseAddress + memDesc.RegionSize) {
+                    if (memDesc.BaseAddress != NULL) {
+                        ::VirtualProtect(memDesc.BaseAddress, memDesc.RegionSize, memDesc.Protect, &dwOldProtect);
+                    }
+                    ::VirtualQuery(pFunc, &memDesc, sizeof(MEMORY_BASIC_INFORMATION));
+                    // NOTE: (sonictk) Try to set the permissions to be R/W. Old permissions are stored in the Protect member.
+                    if (!::VirtualProtect(memDesc.BaseAddress, memDesc.RegionSize, PAGE_READWRITE, &memDesc.Protect)) {
+                        memDesc.BaseAddress = NULL;
+                        return numPatched;
+                    }
+                }
+
+                // NOTE: (sonictk) Now store our function and overwrite the current one.
+                *pFunc = pfnNew;
+                ++numPatched;
+                break;
+            }
+        }
+    }
+
+    // NOTE: (sonictk) Restore memory page protections.
+    if (memDesc.BaseAddress != NULL) {
+        ::VirtualProtect(memDesc.BaseAddress, memDesc.RegionSize, memDesc.Protect, &dwOldProtect);
+    }
+
+    return numPatched;
+}
+
+
+bool patchOverIATEntriesInAllModules(const MayaIATHook *hooks, unsigned int numHooks, bool restore)
+{
+    DWORD currentProcId = ::GetCurrentProcessId();
+    // NOTE: (sonictk) We use CreateToolhelp32Snapshot instead of EnumProcessModules since
+    // it has less bookkeeping requirements and will take care of the memory
+    // management. This is only done once when the plugin is (un)loaded; modules loaded
+    // afterwards are patched individually as they come in through the loader notification.
+    HANDLE hProcSnapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, currentProcId);
+    if (hProcSnapshot == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    MODULEENTRY32 modEntry = {0};
+    modEntry.dwSize = sizeof(modEntry);
+
+    for (BOOL bStat = Module32First(hProcSnapshot, &modEntry); bStat == TRUE; bStat = Module32Next(hProcSnapshot, &modEntry)) {
+        patchOverIATEntriesInOneModule(modEntry.hModule, hooks, numHooks, restore);
+    }
+
+    ::CloseHandle(hProcSnapshot);
+
+    return true;
+}
+
+
+/// Called by the loader whenever a DLL is loaded or unloaded. Only the newly-loaded module gets
+/// patched, so that plugins loaded after us can't replace our handlers either.
+static VOID CALLBACK mayaDllNotificationCB(ULONG reason, const MayaLdrDllNotificationData *data, PVOID context)
+{
+    (void)context;
+    if (reason != MAYA_LDR_DLL_NOTIFICATION_REASON_LOADED || data == NULL) {
+        return;
+    }
+
+    patchOverIATEntriesInOneModule((HMODULE)data->DllBase, gMayaModuleLoadIATHooks, gMayaNumModuleLoadIATHooks, false);
+
+    return;
+}
+
+
+bool startPatchingIATsOnModuleLoad(const MayaIATHook *hooks, unsigned int numHooks)
+{
+    if (gMayaDllNotificationCookie != NULL || numHooks > MAYA_MAX_IAT_HOOKS) {
+        return false;
+    }
+
+    memcpy(gMayaModuleLoadIATHooks, hooks, numHooks * sizeof(MayaIATHook));
+    gMayaNumModuleLoadIATHooks = numHooks;
+
+    HMODULE hNtdllMod = ::GetModuleHandleA("ntdll.dll");
+    LdrRegisterDllNotificationFunc pfnRegister = (LdrRegisterDllNotificationFunc)::GetProcAddress(hNtdllMod, "LdrRegisterDllNotification");
+    if (pfnRegister == NULL || pfnRegister(0, mayaDllNotificationCB, NULL, &gMayaDllNotificationCookie) != 0) {
+        gMayaDllNotificationCookie = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+
+void stopPatchingIATsOnModuleLoad()
+{
+    if (gMayaDllNotificationCookie == NULL) {
+        return;
+    }
+
+    HMODULE hNtdllMod = ::GetModuleHandleA("ntdll.dll");
+    LdrUnregisterDllNotificationFunc pfnUnregister = (LdrUnregisterDllNotificationFunc)::GetProcAddress(hNtdllMod, "LdrUnregisterDllNotification");
+    if (pfnUnregister != NULL) {
+        pfnUnregister(gMayaDllNotificationCookie);
+    }
+    gMayaDllNotificationCookie = NULL;
+
+    return;
+}
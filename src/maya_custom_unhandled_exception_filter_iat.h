@@ -0,0 +1,65 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_IAT_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_IAT_H
+
+#include "common.h"
+
+#define MAYA_MAX_IAT_HOOKS 4
+
+
+/// A single import address table hook: every IAT entry that points to ``pfnOrig`` is patched to
+/// point to ``pfnNew`` instead.
+struct MayaIATHook
+{
+    PROC pfnOrig;
+    PROC pfnNew;
+};
+
+
+/**
+ * Patches every entry in the import address table of the given module that points to one of the
+ * hooked functions. The import directory is walked exactly once no matter how many hooks there are,
+ * and the IAT is made writable at most once, so the cost is the same for every module.
+ *
+ * Entries are matched by address rather than by the name of the DLL they are imported from, since
+ * the same function is frequently imported through an API set DLL (e.g.
+ * ``api-ms-win-core-errorhandling-l1-1-0.dll``) instead of the DLL that actually exports it.
+ *
+ * @param hmodCaller    The module whose import address table should be patched.
+ * @param hooks         The hooks to apply.
+ * @param numHooks      The number of hooks.
+ * @param restore       If ``true``, the hooks are undone instead (i.e. ``pfnNew`` is replaced with ``pfnOrig``).
+ *
+ * @return              The number of entries that were patched.
+ */
+unsigned int patchOverIATEntriesInOneModule(HMODULE hmodCaller, const MayaIATHook *hooks, unsigned int numHooks, bool restore);
+
+/**
+ * Patches the import address tables of every module currently loaded in the process.
+ *
+ * @param hooks         The hooks to apply.
+ * @param numHooks      The number of hooks.
+ * @param restore       If ``true``, the hooks are undone instead.
+ *
+ * @return              ``true`` if the modules could be enumerated, ``false`` otherwise.
+ */
+bool patchOverIATEntriesInAllModules(const MayaIATHook *hooks, unsigned int numHooks, bool restore);
+
+/**
+ * Registers for loader notifications so that every module loaded from now on has the given hooks
+ * applied to it as it is loaded, without rescanning the modules that are already loaded.
+ *
+ * @param hooks         The hooks to apply. These are copied.
+ * @param numHooks      The number of hooks. At most ``MAYA_MAX_IAT_HOOKS``.
+ *
+ * @return              ``true`` if the notification was registered, ``false`` otherwise.
+ */
+bool startPatchingIATsOnModuleLoad(const MayaIATHook *hooks, unsigned int numHooks);
+
+/**
+ * Stops patching newly-loaded modules. This takes the loader lock, so it also waits for any
+ * notification that is currently in flight to finish.
+ */
+void stopPatchingIATsOnModuleLoad();
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_IAT_H */
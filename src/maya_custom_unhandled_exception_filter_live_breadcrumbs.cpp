@@ -0,0 +1,95 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_live_breadcrumbs.cpp
+ * @brief  Publishes a copy of the breadcrumbs in named shared memory, so that external tools can
+ *         watch what a session is doing while it is still alive. The .bss copy remains the one
+ *         that gets written into the crash dump, since the shared memory segment can be
+ *         scribbled over by anyone who opens it.
+ */
+#include "maya_custom_unhandled_exception_filter_live_breadcrumbs.h"
+
+
+static HANDLE gMayaLiveBreadcrumbsMapping = NULL;
+static MayaLiveBreadcrumbs *gMayaLiveBreadcrumbs = NULL;
+
+
+bool createMayaLiveBreadcrumbs()
+{
+    if (gMayaLiveBreadcrumbs != NULL) {
+        return true;
+    }
+
+    char mappingName[MAX_PATH] = {0};
+    snprintf(mappingName, MAX_PATH, "%s%lu", MAYA_LIVE_BREADCRUMBS_MAPPING_NAME_PREFIX, ::GetCurrentProcessId());
+    gMayaLiveBreadcrumbsMapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(MayaLiveBreadcrumbs), mappingName);
+    if (gMayaLiveBreadcrumbsMapping == NULL) {
+        return false;
+    }
+
+    gMayaLiveBreadcrumbs = (MayaLiveBreadcrumbs *)::MapViewOfFile(gMayaLiveBreadcrumbsMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MayaLiveBreadcrumbs));
+    if (gMayaLiveBreadcrumbs == NULL) {
+        ::CloseHandle(gMayaLiveBreadcrumbsMapping);
+        gMayaLiveBreadcrumbsMapping = NULL;
+        return false;
+    }
+
+    // NOTE: (sonictk) If the plugin was reloaded, the segment might still be around (if a monitor
+    // kept it open); start over from scratch, but keep the sequence going so that monitors notice.
+    MayaLiveBreadcrumbs *live = beginMayaLiveBreadcrumbsUpdate();
+    const size_t fieldsOffset = offsetof(MayaLiveBreadcrumbs, processId);
+    memset((BYTE *)live + fieldsOffset, 0, sizeof(MayaLiveBreadcrumbs) - fieldsOffset);
+    live->magic = MAYA_LIVE_BREADCRUMBS_MAGIC;
+    live->version = MAYA_LIVE_BREADCRUMBS_VERSION;
+    live->processId = ::GetCurrentProcessId();
+    endMayaLiveBreadcrumbsUpdate();
+
+    return true;
+}
+
+
+void destroyMayaLiveBreadcrumbs()
+{
+    if (gMayaLiveBreadcrumbs != NULL) {
+        ::UnmapViewOfFile(gMayaLiveBreadcrumbs);
+        gMayaLiveBreadcrumbs = NULL;
+    }
+    if (gMayaLiveBreadcrumbsMapping != NULL) {
+        ::CloseHandle(gMayaLiveBreadcrumbsMapping);
+        gMayaLiveBreadcrumbsMapping = NULL;
+    }
+
+    return;
+}
+
+
+MayaLiveBreadcrumbs *beginMayaLiveBreadcrumbsUpdate()
+{
+    MayaLiveBreadcrumbs *live = gMayaLiveBreadcrumbs;
+    if (live == NULL) {
+        return NULL;
+    }
+
+    // NOTE: (sonictk) The sequence is now odd, telling readers that an update is in progress. The
+    // interlocked op. is a full barrier, so none of the writes to the fields that follow can become
+    // visible before it.
+    ::InterlockedIncrement((volatile LONG *)&live->sequence);
+
+    return live;
+}
+
+
+void endMayaLiveBreadcrumbsUpdate()
+{
+    MayaLiveBreadcrumbs *live = gMayaLiveBreadcrumbs;
+    if (live == NULL) {
+        return;
+    }
+
+    FILETIME nowFileTime;
+    ::GetSystemTimeAsFileTime(&nowFileTime);
+    live->lastUpdateTime = ((uint64_t)nowFileTime.dwHighDateTime << 32) | nowFileTime.dwLowDateTime;
+
+    // NOTE: (sonictk) Back to even; all the writes to the fields are visible before this is.
+    ::InterlockedIncrement((volatile LONG *)&live->sequence);
+
+    return;
+}
@@ -0,0 +1,38 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_LIVE_BREADCRUMBS_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_LIVE_BREADCRUMBS_H
+
+#include "common.h"
+
+/// Set to ``0`` to stop the breadcrumbs from being published for live monitoring.
+#define MAYA_LIVE_BREADCRUMBS_ENV_VAR_NAME "MAYA_CRASH_LIVE_BREADCRUMBS"
+
+
+/**
+ * Creates the named shared memory segment that the breadcrumbs are published to.
+ *
+ * @return  ``true`` if the segment was created successfully, ``false`` otherwise.
+ */
+bool createMayaLiveBreadcrumbs();
+
+/**
+ * Unmaps and closes the shared memory segment. Monitors that still have it open will see the
+ * last published state.
+ */
+void destroyMayaLiveBreadcrumbs();
+
+/**
+ * Starts an update of the published breadcrumbs. Every call that returns a non-``NULL`` pointer
+ * must be followed by a call to ``endMayaLiveBreadcrumbsUpdate`` once the fields have been written.
+ * Only one thread (i.e. the main thread) may update the breadcrumbs. This never blocks.
+ *
+ * @return  The breadcrumbs to write to, or ``NULL`` if they are not being published.
+ */
+MayaLiveBreadcrumbs *beginMayaLiveBreadcrumbsUpdate();
+
+/**
+ * Publishes the changes made since the matching call to ``beginMayaLiveBreadcrumbsUpdate``.
+ */
+void endMayaLiveBreadcrumbsUpdate();
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_LIVE_BREADCRUMBS_H */
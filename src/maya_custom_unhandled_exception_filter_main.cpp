@@ -11,7 +11,6 @@
 #endif
 #include <Windows.h>
 #include <Dbghelp.h>
-#include <TlHelp32.h>
 
 #include <assert.h>
 #include <stdio.h>
@@ -34,9 +33,29 @@
 #include <maya/MSceneMessage.h>
 #include <maya/MString.h>
 #include <maya/MTime.h>
+#include <maya/MTimerMessage.h>
 
 #include "common.h"
+#include "maya_custom_unhandled_exception_filter_env.h"
+#include "maya_custom_unhandled_exception_filter_crash.cpp"
+#include "maya_custom_unhandled_exception_filter_dump_writer.cpp"
 #include "maya_custom_unhandled_exception_filter_cmd.cpp"
+#include "maya_custom_unhandled_exception_filter_memory_sampler.cpp"
+#include "maya_custom_unhandled_exception_filter_snapshot.cpp"
+#include "maya_custom_unhandled_exception_filter_watchdog.cpp"
+#include "maya_custom_unhandled_exception_filter_stackwalk.cpp"
+#include "maya_custom_unhandled_exception_filter_profiler.cpp"
+#include "maya_custom_unhandled_exception_filter_fingerprint.cpp"
+#include "maya_custom_unhandled_exception_filter_sidecar.cpp"
+#include "maya_custom_unhandled_exception_filter_live_breadcrumbs.cpp"
+#include "maya_custom_unhandled_exception_filter_headless.cpp"
+#include "maya_custom_unhandled_exception_filter_breadcrumb_events.cpp"
+#include "maya_custom_unhandled_exception_filter_flight_recorder.cpp"
+#include "maya_custom_unhandled_exception_filter_plugin_load_times.cpp"
+#include "maya_custom_unhandled_exception_filter_name_table.cpp"
+#include "maya_custom_unhandled_exception_filter_iat.cpp"
+#include "maya_custom_unhandled_exception_filter_scene_stats.cpp"
+#include "maya_custom_unhandled_exception_filter_self_profile.cpp"
 #include "get_exception_info.c"
 
 static const char MSG_UNHANDLED_EXCEPTION[] = "An unhandled exception occurred.";
@@ -74,12 +93,88 @@ static char gMayaMELCmdInfoBlk[MAYA_MINIDUMP_MEL_CMD_INFO_BLK_SIZE] = "";
 
 static MayaCrashDumpInfo gMayaCrashDumpInfo = {0};
 
+/// One of the names of the last changes, as an ID into the name table. The table only keeps the
+/// tail end of long names, so those are also copied out here in full.
+struct MayaLastName
+{
+    volatile uint32_t id;
+    volatile uint32_t longNameId; // NOTE: (sonictk) The ID of the name in ``longName``, if any.
+    char longName[MAYA_DAG_PATH_MAX_NAME_LEN];
+};
+
+/// The DAG paths and DG node name of the last changes. They are only resolved into each dump's own
+/// copy of ``gMayaCrashDumpInfo`` when the dump is written.
+static MayaLastName gMayaLastDagParentName = {0};
+static MayaLastName gMayaLastDagChildName = {0};
+static MayaLastName gMayaLastDGNodeAddedName = {0};
+
+/// Summary of the crash written next to the dump. Kept in the .bss segment since we might be
+/// handling a stack overflow.
+static MayaCrashSidecar gMayaCrashSidecar = {0};
+
+/// The streams of the crash dump that are put together when it is written. Kept in the .bss
+/// segment for the same reason.
+static MayaDumpUserStreamStaging gMayaCrashDumpStaging = {0};
+
+/// Repeats of a crash within this many seconds of its last full dump don't get dumped again.
+static uint32_t gMayaCrashDedupWindowSecs = MAYA_CRASH_DEDUP_DEFAULT_WINDOW_SECS;
+
+/// Whether crashes are reported without any dialogs, for farm jobs with no one around to click them.
+static bool gMayaHeadlessCrashMode = false;
+
+/// How much of the memory of the process goes into the crash dump; one of ``MayaDumpCapture``.
+static int gMayaDumpCapture = MayaDumpCapture_Normal;
+
 /// Global record of callback IDs to be unregistered.
+static MCallbackId gMayaSceneBeforeOpen_cbid = 0;
 static MCallbackId gMayaSceneAfterOpen_cbid = 0;
+static MCallbackId gMayaSceneBeforeNew_cbid = 0;
+static MCallbackId gMayaSceneAfterNew_cbid = 0;
 static MCallbackId gMayaTimeChange_cbid = 0;
 static MCallbackId gMayaMELCmd_cbid = 0;
 static MCallbackId gMayaAllDAGChanges_cbid = 0;
 static MCallbackId gMayaNodeAdded_cbid = 0;
+static MCallbackId gMayaNodeRemoved_cbid = 0;
+static MCallbackId gMayaIdleHeartbeat_cbid = 0;
+static MCallbackId gMayaBeforePluginLoad_cbid = 0;
+static MCallbackId gMayaAfterPluginLoad_cbid = 0;
+static MCallbackId gMayaBeforePluginUnload_cbid = 0;
+static MCallbackId gMayaAfterPluginUnload_cbid = 0;
+
+
+/// Copies a breadcrumb into a fixed-size buffer, truncating it if needed.
+static inline void copyMayaBreadcrumb(char *dst, size_t lenDst, const char *src)
+{
+    const size_t lenSrc = strnlen(src, lenDst - 1);
+    memcpy(dst, src, lenSrc);
+    dst[lenSrc] = '\0';
+    countMayaSelfProfileBytes(lenSrc);
+}
+
+
+/// Keeps the ID of one of the last names seen. Only names too long for the name table to hold in
+/// full are copied.
+static inline void setMayaLastName(MayaLastName *lastName, uint32_t id, const char *name)
+{
+    if (id != MAYA_NAME_TABLE_INVALID_ID && strnlen(name, MAYA_NAME_TABLE_NAME_LEN) == MAYA_NAME_TABLE_NAME_LEN) {
+        lastName->longNameId = MAYA_NAME_TABLE_INVALID_ID;
+        copyMayaBreadcrumb(lastName->longName, sizeof(lastName->longName), name);
+        lastName->longNameId = id;
+    }
+    lastName->id = id;
+}
+
+
+/// Callback executed before a scene is opened or a new one is created.
+void mayaSceneBeforeLoadCB(void *unused)
+{
+    (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    beginMayaSceneStatsLoad();
+    endMayaSelfProfile(MayaSelfProfileSite_SceneLoad, &selfProfileScope);
+
+    return;
+}
 
 
 /// Callback executed on scene open events. It is used to set the record of the last scene opened
@@ -88,18 +183,48 @@ static MCallbackId gMayaNodeAdded_cbid = 0;
 void mayaSceneAfterOpenCB(void *unused)
 {
     (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
 
     const MString curFileNameMStr = MFileIO::currentFile();
     const unsigned int lenCurFileName = curFileNameMStr.length();
     memcpy(gMayaCurrentScenePath, curFileNameMStr.asChar(), lenCurFileName);
     memset(gMayaCurrentScenePath + lenCurFileName, 0, 1);
+    countMayaSelfProfileBytes(lenCurFileName);
 
     memset(&gMayaCrashDumpInfo, 0, sizeof(gMayaCrashDumpInfo));
+    memset(&gMayaLastDagParentName, 0, sizeof(gMayaLastDagParentName));
+    memset(&gMayaLastDagChildName, 0, sizeof(gMayaLastDagChildName));
+    memset(&gMayaLastDGNodeAddedName, 0, sizeof(gMayaLastDGNodeAddedName));
     gMayaCrashDumpInfo.verAPI = MGlobal::apiVersion();
     gMayaCrashDumpInfo.verCustom = MGlobal::customVersion();
     gMayaCrashDumpInfo.verMayaFile = MFileIO::latestMayaFileVersion();
     gMayaCrashDumpInfo.isYUp = MGlobal::isYAxisUp();
 
+    recountMayaSceneStats();
+
+    MayaLiveBreadcrumbs *live = beginMayaLiveBreadcrumbsUpdate();
+    if (live != NULL) {
+        copyMayaBreadcrumb(live->scenePath, sizeof(live->scenePath), gMayaCurrentScenePath);
+        endMayaLiveBreadcrumbsUpdate();
+    }
+
+    // NOTE: (sonictk) The file name is the interesting bit, and the event names are short.
+    const char *sceneFileName = strrchr(gMayaCurrentScenePath, '/');
+    recordMayaBreadcrumbEvent(MayaBreadcrumbEventType_SceneOpened, 0, 0, sceneFileName == NULL ? gMayaCurrentScenePath : sceneFileName + 1);
+    endMayaSelfProfile(MayaSelfProfileSite_SceneOpen, &selfProfileScope);
+
+    return;
+}
+
+
+/// Callback executed after a new scene is created.
+void mayaSceneAfterNewCB(void *unused)
+{
+    (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    recountMayaSceneStats();
+    endMayaSelfProfile(MayaSelfProfileSite_SceneLoad, &selfProfileScope);
+
     return;
 }
 
@@ -108,9 +233,22 @@ void mayaSceneAfterOpenCB(void *unused)
 void mayaSceneTimeChangeCB(MTime &time, void *unused)
 {
     (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    bumpMayaMainThreadHeartbeat();
     const MTime::Unit curUIUnit = MTime::uiUnit();
     double curFrame = time.asUnits(curUIUnit);
-    snprintf(gMayaTimingInfoBlk, MAYA_MINIDUMP_TIMING_INFO_BLK_SIZE, "Frame: %.1f Unit: %d", curFrame, curUIUnit);
+    const int lenTimingInfo = snprintf(gMayaTimingInfoBlk, MAYA_MINIDUMP_TIMING_INFO_BLK_SIZE, "Frame: %.1f Unit: %d", curFrame, curUIUnit);
+    countMayaSelfProfileBytes(lenTimingInfo > 0 ? (size_t)lenTimingInfo : 0);
+
+    MayaLiveBreadcrumbs *live = beginMayaLiveBreadcrumbsUpdate();
+    if (live != NULL) {
+        copyMayaBreadcrumb(live->timingInfo, sizeof(live->timingInfo), gMayaTimingInfoBlk);
+        endMayaLiveBreadcrumbsUpdate();
+    }
+
+    recordMayaBreadcrumbEvent(MayaBreadcrumbEventType_TimeChange, 0, 0, gMayaTimingInfoBlk);
+    endMayaSelfProfile(MayaSelfProfileSite_TimeChange, &selfProfileScope);
+
     return;
 }
 
@@ -120,17 +258,26 @@ void mayaSceneTimeChangeCB(MTime &time, void *unused)
 void mayaMELCmdCB(const MString &str, unsigned int procID, bool isProcEntry, unsigned int type, void *unused)
 {
     (void)unused;
-    (void)procID;
-    (void)isProcEntry;
     // if (type == kMELProc) { // NOTE: (sonictk) We only check against actual kMELCommand
     //     return;
     // }
-    (void)type;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    bumpMayaMainThreadHeartbeat();
     const char *cmdC = str.asChar();
+    recordMayaBreadcrumbEvent(isProcEntry ? MayaBreadcrumbEventType_MELProcEntry : MayaBreadcrumbEventType_MELProcExit, procID, type, cmdC);
     size_t lenCmdC = strlen(cmdC);
-    size_t lenToStore = lenCmdC > MAYA_MINIDUMP_MEL_CMD_INFO_BLK_SIZE ? MAYA_MINIDUMP_MEL_CMD_INFO_BLK_SIZE : lenCmdC;
+    // NOTE: (sonictk) Leave room for the terminator.
+    size_t lenToStore = lenCmdC > MAYA_MINIDUMP_MEL_CMD_INFO_BLK_SIZE - 1 ? MAYA_MINIDUMP_MEL_CMD_INFO_BLK_SIZE - 1 : lenCmdC;
     memcpy(gMayaMELCmdInfoBlk, cmdC, lenToStore);
     memset(gMayaMELCmdInfoBlk + lenToStore, '\0', 1);
+    countMayaSelfProfileBytes(lenToStore);
+
+    MayaLiveBreadcrumbs *live = beginMayaLiveBreadcrumbsUpdate();
+    if (live != NULL) {
+        copyMayaBreadcrumb(live->lastMELCmd, sizeof(live->lastMELCmd), gMayaMELCmdInfoBlk);
+        endMayaLiveBreadcrumbsUpdate();
+    }
+    endMayaSelfProfile(MayaSelfProfileSite_MELCmd, &selfProfileScope);
 
     return;
 }
@@ -140,36 +287,43 @@ void mayaMELCmdCB(const MString &str, unsigned int procID, bool isProcEntry, uns
 void mayaAllDAGChangesCB(MDagMessage::DagMessage msgType, MDagPath &child, MDagPath &parent, void *unused)
 {
     (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
     gMayaCrashDumpInfo.lastDagMessage = (short)msgType;
     MString childName = child.partialPathName();
     const char *childNameC = childName.asChar();
-    size_t lenChildName = strlen(childNameC);
-    lenChildName = lenChildName > MAYA_DAG_PATH_MAX_NAME_LEN ? MAYA_DAG_PATH_MAX_NAME_LEN : lenChildName;
-
     MString parentName = parent.partialPathName();
     const char *parentNameC = parentName.asChar();
-    size_t lenParentName = strlen(parentNameC);
-    lenParentName = lenParentName > MAYA_DAG_PATH_MAX_NAME_LEN ? MAYA_DAG_PATH_MAX_NAME_LEN : lenParentName;
 
-    memcpy(gMayaCrashDumpInfo.lastDagChildName, childNameC, lenChildName);
-    memset(gMayaCrashDumpInfo.lastDagChildName + lenChildName, 0, 1);
+    // NOTE: (sonictk) Only the IDs of the names are kept; the names themselves are only copied
+    // the first time they are seen.
+    const uint32_t childNameId = internMayaName(childNameC);
+    setMayaLastName(&gMayaLastDagChildName, childNameId, childNameC);
+    setMayaLastName(&gMayaLastDagParentName, internMayaName(parentNameC), parentNameC);
+
+    MayaLiveBreadcrumbs *live = beginMayaLiveBreadcrumbsUpdate();
+    if (live != NULL) {
+        copyMayaBreadcrumb(live->lastDagChildName, sizeof(live->lastDagChildName), childNameC);
+        copyMayaBreadcrumb(live->lastDagParentName, sizeof(live->lastDagParentName), parentNameC);
+        endMayaLiveBreadcrumbsUpdate();
+    }
 
-    memcpy(gMayaCrashDumpInfo.lastDagParentName, parentNameC, lenParentName);
-    memset(gMayaCrashDumpInfo.lastDagParentName + lenParentName, 0, 1);
+    recordMayaBreadcrumbEvent(MayaBreadcrumbEventType_DagChange, childNameId, (uint32_t)msgType, childNameC);
+    endMayaSelfProfile(MayaSelfProfileSite_DagChange, &selfProfileScope);
 
     return;
 }
 
 
-/// Callback executed every time a new node is added to the DG.
-void mayaNodeAddedCB(MObject &node, void *unused)
+/// Records a node that was added to the DG in the breadcrumbs.
+static void recordMayaNodeAdded(MObject &node)
 {
-    (void)unused;
-
     if (!node.hasFn(MFn::kDependencyNode)) {
         return;
     }
 
+    // NOTE: (sonictk) This is also called when undoing the deletion of a node, or redoing its creation.
+    countMayaSceneNode(node, 1);
+
     MStatus mstat;
     MFnDependencyNode fnNode(node, &mstat);
     if (mstat != MStatus::kSuccess) {
@@ -186,63 +340,134 @@ void mayaNodeAddedCB(MObject &node, void *unused)
     }
 
     const char *nodeNameC = nodeName.asChar();
-    size_t lenNodeName = strlen(nodeNameC);
-    if (lenNodeName == 0) {
+    const uint32_t nodeNameId = internMayaName(nodeNameC);
+    if (nodeNameId == MAYA_NAME_TABLE_INVALID_ID) {
         return;
     }
-    memcpy(gMayaCrashDumpInfo.lastDGNodeAddedName, nodeNameC, lenNodeName);
-    memset(gMayaCrashDumpInfo.lastDGNodeAddedName + lenNodeName, 0, 1);
+    setMayaLastName(&gMayaLastDGNodeAddedName, nodeNameId, nodeNameC);
+
+    MayaLiveBreadcrumbs *live = beginMayaLiveBreadcrumbsUpdate();
+    if (live != NULL) {
+        copyMayaBreadcrumb(live->lastDGNodeAddedName, sizeof(live->lastDGNodeAddedName), nodeNameC);
+        endMayaLiveBreadcrumbsUpdate();
+    }
+
+    recordMayaBreadcrumbEvent(MayaBreadcrumbEventType_NodeAdded, nodeNameId, 0, nodeNameC);
 
     return;
 }
 
 
-LONG WINAPI detouredSetUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+/// Callback executed every time a new node is added to the DG.
+void mayaNodeAddedCB(MObject &node, void *unused)
 {
-    (void)exceptionInfo;
-    return 0;
+    (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    recordMayaNodeAdded(node);
+    endMayaSelfProfile(MayaSelfProfileSite_NodeAdded, &selfProfileScope);
+
+    return;
 }
 
 
-LONG WINAPI unwantedUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+/// Callback executed every time a node is removed from the DG, including when undoing its creation
+/// or redoing its deletion.
+void mayaNodeRemovedCB(MObject &node, void *unused)
 {
-    (void)exceptionInfo;
-    ::MessageBoxA(NULL, "If you see this...", "...something has gone wrong.", MB_OK|MB_ICONSTOP);
-    return EXCEPTION_CONTINUE_SEARCH;
+    (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    countMayaSceneNode(node, -1);
+    endMayaSelfProfile(MayaSelfProfileSite_NodeRemoved, &selfProfileScope);
+
+    return;
 }
 
 
-/// Our actual exception filter that does the dirty work of writing out the minidump.
-LONG WINAPI mayaCustomUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+/// Callback executed periodically while Maya's main thread is servicing its event loop. It lets the
+/// hang watchdog know that the main thread is still alive, and picks up after scenes that never
+/// finished loading.
+void mayaIdleHeartbeatCB(float elapsedTime, float lastTime, void *unused)
 {
-    if (gHandlerCalled == true) {
-        return EXCEPTION_EXECUTE_HANDLER;
-    }
+    (void)elapsedTime;
+    (void)lastTime;
+    (void)unused;
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    bumpMayaMainThreadHeartbeat();
+    checkMayaSceneStatsLoad();
+    endMayaSelfProfile(MayaSelfProfileSite_IdleHeartbeat, &selfProfileScope);
 
-    char tempDirPath[MAX_PATH] = {0};
-    DWORD lenTempDirPath = ::GetEnvironmentVariable((LPCTSTR)TEMP_ENV_VAR_NAME, (LPTSTR)tempDirPath, (DWORD)MAX_PATH);
-    if (lenTempDirPath == 0) {
-        static const size_t lenDefaultTempDirPath = strlen(DEFAULT_TEMP_DIRECTORY);
-        memcpy(tempDirPath, DEFAULT_TEMP_DIRECTORY, lenDefaultTempDirPath);
-        memset(tempDirPath + lenDefaultTempDirPath, 0, 1);
-    }
-    char dumpFilePath[MAX_PATH] = {0};
-    snprintf(dumpFilePath, MAX_PATH, "%s\\%s", tempDirPath, MINIDUMP_FILE_NAME);
-    HANDLE hFile = CreateFile(dumpFilePath, GENERIC_READ|GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    // NOTE: (sonictk) If we can't write out the dump file, continue with normal crash handling
-    // since that is pretty much the point of our custom exception handler.
-    if (hFile == NULL || hFile == INVALID_HANDLE_VALUE) {
-        ::MessageBoxA(NULL, MSG_UNABLE_TO_WRITE_DUMP, MSG_UNHANDLED_EXCEPTION, MB_OK|MB_ICONSTOP);
-    // NOTE: (sonictk) This calls our exception handler, but also
-    // allows other exception handlers to kick in since it will proceed with normal execution of
-    // the filter.
-        return EXCEPTION_CONTINUE_SEARCH;
+    return;
+}
+
+
+/// Fills in the crash info stream. The last names seen are not in it yet; see ``stageMayaCrashInfo``.
+static bool getMayaCrashInfoStream(MINIDUMP_USER_STREAM *stream)
+{
+    stream->Type = MAYA_CRASH_INFO_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaCrashDumpInfo);
+    stream->Buffer = &gMayaCrashDumpInfo;
+
+    return true;
+}
+
+
+/// Resolves one of the last names seen, in full if it was too long for the name table.
+static void resolveMayaLastName(const MayaLastName *lastName, char *buf, size_t lenBuf)
+{
+    const uint32_t id = lastName->id;
+    if (id == MAYA_NAME_TABLE_INVALID_ID || id != lastName->longNameId) {
+        resolveMayaName(id, buf, lenBuf);
+        return;
     }
+    const size_t len = strnlen(lastName->longName, lenBuf - 1);
+    memcpy(buf, lastName->longName, len);
+    buf[len] = '\0';
+
+    return;
+}
+
+
+/**
+ * Copies the crash info out for a dump, and resolves the last names seen into the copy. The names
+ * are only kept as IDs until now.
+ *
+ * @param crashInfo     Storage for the copy.
+ */
+static void stageMayaCrashInfo(MayaCrashDumpInfo *crashInfo)
+{
+    // NOTE: (sonictk) The main thread can be updating this while the hang watchdog copies it out.
+    // A torn copy is no worse than what a dump of the live process would show anyway.
+    memcpy(crashInfo, &gMayaCrashDumpInfo, sizeof(MayaCrashDumpInfo));
+    resolveMayaLastName(&gMayaLastDagParentName, crashInfo->lastDagParentName, sizeof(crashInfo->lastDagParentName));
+    resolveMayaLastName(&gMayaLastDagChildName, crashInfo->lastDagChildName, sizeof(crashInfo->lastDagChildName));
+    resolveMayaLastName(&gMayaLastDGNodeAddedName, crashInfo->lastDGNodeAddedName, sizeof(crashInfo->lastDGNodeAddedName));
+
+    return;
+}
 
-    MINIDUMP_EXCEPTION_INFORMATION dumpExceptionInfo = {0};
-    dumpExceptionInfo.ThreadId = ::GetCurrentThreadId();
-    dumpExceptionInfo.ExceptionPointers = exceptionInfo;
-    dumpExceptionInfo.ClientPointers = TRUE;
+
+/// The function that fills in each of the streams in ``MAYA_DUMP_USER_STREAMS``, or ``NULL`` for
+/// those that are not written into every dump.
+typedef bool (*MayaDumpUserStreamGetter)(MINIDUMP_USER_STREAM *stream);
+
+#define MAYA_DUMP_USER_STREAM_GETTER_Every(name) getMaya##name##Stream
+#define MAYA_DUMP_USER_STREAM_GETTER_Snapshot(name) NULL
+#define MAYA_DUMP_USER_STREAM_GETTER(name, streamType, layout, sizing, dumps) MAYA_DUMP_USER_STREAM_GETTER_##dumps(name),
+
+static const MayaDumpUserStreamGetter gMayaDumpUserStreamGetters[MayaDumpUserStream_Count] = {
+    MAYA_DUMP_USER_STREAMS(MAYA_DUMP_USER_STREAM_GETTER)
+};
+
+/// NOTE: (sonictk) The scene path, the timing information and the last MEL command.
+#define MAYA_NUM_DUMP_COMMENT_STREAMS 3
+
+static_assert(MAYA_NUM_DUMP_COMMENT_STREAMS + MayaDumpUserStream_Count <= MAYA_MAX_DUMP_USER_STREAMS,
+              "MAYA_MAX_DUMP_USER_STREAMS is too small to hold every registered stream.");
+
+
+ULONG fillMayaDumpUserStreams(MINIDUMP_USER_STREAM *streams, ULONG maxStreams, MayaDumpUserStreamStaging *staging)
+{
+    ULONG numStreams = 0;
 
     // NOTE: (sonictk) Now let's store some custom information in the dump file. Chief among which:
     // the name of the Maya scene.
@@ -263,26 +488,162 @@ LONG WINAPI mayaCustomUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInf
     dumpMayaLastMELCmdInfo.BufferSize = MAYA_MINIDUMP_MEL_CMD_INFO_BLK_SIZE;
     dumpMayaLastMELCmdInfo.Buffer = gMayaMELCmdInfoBlk;
 
-    // NOTE: (sonictk) Now we store, as a binary block, additional crash dump information.
-    MINIDUMP_USER_STREAM dumpMayaCrashInfo = {0};
-    dumpMayaCrashInfo.Type = MAYA_CRASH_INFO_STREAM_TYPE;
-    dumpMayaCrashInfo.BufferSize = sizeof(gMayaCrashDumpInfo);
-    dumpMayaCrashInfo.Buffer = &gMayaCrashDumpInfo;
-
-    MINIDUMP_USER_STREAM streams[] = {
+    const MINIDUMP_USER_STREAM commentStreams[MAYA_NUM_DUMP_COMMENT_STREAMS] = {
         dumpMayaFileInfo,
         dumpMayaTimeInfo,
-        dumpMayaLastMELCmdInfo,
-        dumpMayaCrashInfo
+        dumpMayaLastMELCmdInfo
     };
-    MINIDUMP_USER_STREAM_INFORMATION dumpUserInfo = {0};
-    dumpUserInfo.UserStreamCount = ARRAY_SIZE(streams);
-    dumpUserInfo.UserStreamArray = streams;
+    for (ULONG i=0; i < ARRAY_SIZE(commentStreams) && numStreams < maxStreams; ++i) {
+        streams[numStreams++] = commentStreams[i];
+    }
+
+    // NOTE: (sonictk) Then the rest of the breadcrumbs, as binary blocks: the crash info, the
+    // memory pressure, what the main thread and every other thread had been busy with, the
+    // breadcrumb timeline if it is being recorded, plugin load times, the name table, how big the
+    // scene was and what our own callbacks have cost.
+    for (int i=0; i < MayaDumpUserStream_Count && numStreams < maxStreams; ++i) {
+        if (gMayaDumpUserStreamGetters[i] == NULL) {
+            continue;
+        }
+        MINIDUMP_USER_STREAM *stream = &streams[numStreams];
+        memset(stream, 0, sizeof(MINIDUMP_USER_STREAM));
+        if (!gMayaDumpUserStreamGetters[i](stream)) {
+            continue;
+        }
+        // NOTE: (sonictk) Rather not write a stream at all than one that the readers would reject.
+        if (stream->Type != kMayaDumpUserStreams[i].streamType
+            || !isMayaDumpUserStreamSizeValid((MayaDumpUserStream)i, stream->BufferSize)) {
+            continue;
+        }
+        if (i == MayaDumpUserStream_CrashInfo) {
+            stageMayaCrashInfo(&staging->crashInfo);
+            stream->Buffer = &staging->crashInfo;
+        }
+        ++numStreams;
+    }
+
+    return numStreams;
+}
+
+
+LONG WINAPI detouredSetUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+{
+    (void)exceptionInfo;
+    return 0;
+}
+
+
+LONG WINAPI unwantedUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+{
+    (void)exceptionInfo;
+    if (!gMayaHeadlessCrashMode) {
+        ::MessageBoxA(NULL, "If you see this...", "...something has gone wrong.", MB_OK|MB_ICONSTOP);
+    }
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+
+/// Writes out the summary of the crash next to its dump, along with the breadcrumbs from the .bss segment.
+void writeMayaCrashSidecarForDump(LPEXCEPTION_POINTERS exceptionInfo, const MayaCrashFingerprint *fingerprint, const char *dumpFilePath)
+{
+    MayaCrashSidecar *sidecar = &gMayaCrashSidecar;
+    memset(sidecar, 0, sizeof(MayaCrashSidecar));
+    fillMayaCrashSidecar(exceptionInfo, sidecar);
+    sidecar->fingerprint = fingerprint->hash;
+    sidecar->verAPI = gMayaCrashDumpInfo.verAPI;
+
+    // NOTE: (sonictk) Keep the tail end of the scene path, since the file name is the interesting bit.
+    const size_t lenScenePath = strnlen(gMayaCurrentScenePath, MAX_PATH);
+    const size_t sceneNameStart = lenScenePath >= MAYA_CRASH_SIDECAR_SCENE_NAME_LEN ? lenScenePath - (MAYA_CRASH_SIDECAR_SCENE_NAME_LEN - 1) : 0;
+    memcpy(sidecar->sceneName, gMayaCurrentScenePath + sceneNameStart, lenScenePath - sceneNameStart);
+    memcpy(sidecar->lastMELCmd, gMayaMELCmdInfoBlk, strnlen(gMayaMELCmdInfoBlk, MAYA_CRASH_SIDECAR_MEL_CMD_LEN - 1));
+    memcpy(sidecar->timingInfo, gMayaTimingInfoBlk, strnlen(gMayaTimingInfoBlk, MAYA_CRASH_SIDECAR_TIMING_INFO_LEN - 1));
+
+    writeMayaCrashSidecar(dumpFilePath, sidecar);
+
+    return;
+}
+
+
+/// Gets the path of the dump for the crash currently being handled. See ``MINIDUMP_FILE_PREFIX``.
+void getMayaCrashDumpFilePath(const char *dirPath, uint64_t fingerprint, char *dumpFilePath, DWORD lenDumpFilePath)
+{
+    SYSTEMTIME now;
+    ::GetSystemTime(&now);
+    snprintf(dumpFilePath, lenDumpFilePath, "%s\\%s_%04u%02u%02u-%02u%02u%02u_%lu_%016llx.dmp",
+             dirPath, MINIDUMP_FILE_PREFIX,
+             now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond,
+             ::GetCurrentProcessId(), (unsigned long long)fingerprint);
+
+    return;
+}
 
-    // static const DWORD miniDumpFlags = MiYniDumpWithDataSegs|MiniDumpWithPrivateReadWriteMemory|MiniDumpWithHandleData|MiniDumpWithThreadInfo|MiniDumpWithFullMemoryInfo|MiniDumpWithUnloadedModules;
-    static const DWORD miniDumpFlags = MiniDumpNormal;
-    BOOL dumpWritten = ::MiniDumpWriteDump(::GetCurrentProcess(), ::GetCurrentProcessId(), hFile, (MINIDUMP_TYPE)miniDumpFlags, &dumpExceptionInfo, &dumpUserInfo, NULL);
+
+/// Our actual exception filter that does the dirty work of writing out the minidump.
+LONG WINAPI mayaCustomUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInfo)
+{
+    if (gHandlerCalled == true) {
+        return EXCEPTION_EXECUTE_HANDLER;
+    }
+
+    MayaHeadlessCrashReport headlessReport = {0};
+    ::QueryPerformanceCounter(&headlessReport.faultTime);
+    headlessReport.exceptionCode = exceptionInfo->ExceptionRecord->ExceptionCode;
+    headlessReport.exceptionAddress = exceptionInfo->ExceptionRecord->ExceptionAddress;
+
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+
+    // NOTE: (sonictk) If we've already dumped this exact crash recently (e.g. a farm job that keeps
+    // getting retried on the same scene), don't bother writing out yet another full dump of it;
+    // just bump the counter in its repeat record.
+    MayaCrashFingerprint fingerprint;
+    computeMayaCrashFingerprint(exceptionInfo, &fingerprint);
+    headlessReport.fingerprint = fingerprint.hash;
+    if (gMayaCrashDedupWindowSecs != 0) {
+        MayaCrashRepeatRecord repeatRecord;
+        if (checkMayaCrashFingerprintCache(tempDirPath, &fingerprint, gMayaCrashDedupWindowSecs, &repeatRecord)) {
+            char repeatFilePath[MAX_PATH] = {0};
+            writeMayaCrashRepeatRecord(tempDirPath, &repeatRecord, repeatFilePath, MAX_PATH);
+            if (gMayaHeadlessCrashMode) {
+                headlessReport.status = MayaHeadlessCrashStatus_Repeat;
+                headlessReport.filePath = repeatFilePath;
+                finishMayaHeadlessCrash(tempDirPath, &headlessReport);
+            }
+            char msg[MAX_PATH * 2] = {0};
+            snprintf(msg, sizeof(msg), "An unrecoverable error has occured and the application will now close.\nThis crash has already happened %u times since it was last dumped, so no new minidump was written. The repeat count has been recorded in:\n%s", repeatRecord.count, repeatFilePath);
+            ::MessageBoxA(NULL, msg, MSG_UNHANDLED_EXCEPTION, MB_OK|MB_ICONSTOP);
+            return EXCEPTION_EXECUTE_HANDLER;
+        }
+    }
+
+    char dumpFilePath[MAX_PATH] = {0};
+    getMayaCrashDumpFilePath(tempDirPath, fingerprint.hash, dumpFilePath, MAX_PATH);
+    // NOTE: (sonictk) Shared for writing so that the dump writers can open it again for themselves.
+    HANDLE hFile = CreateFile(dumpFilePath, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    // NOTE: (sonictk) If we can't write out the dump file, continue with normal crash handling
+    // since that is pretty much the point of our custom exception handler.
+    if (hFile == NULL || hFile == INVALID_HANDLE_VALUE) {
+        if (gMayaHeadlessCrashMode) {
+            headlessReport.status = MayaHeadlessCrashStatus_DumpFailed;
+            finishMayaHeadlessCrash(tempDirPath, &headlessReport);
+        }
+        ::MessageBoxA(NULL, MSG_UNABLE_TO_WRITE_DUMP, MSG_UNHANDLED_EXCEPTION, MB_OK|MB_ICONSTOP);
+    // NOTE: (sonictk) This calls our exception handler, but also
+    // allows other exception handlers to kick in since it will proceed with normal execution of
+    // the filter.
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    MINIDUMP_USER_STREAM streams[MAYA_MAX_DUMP_USER_STREAMS];
+    ULONG numStreams = fillMayaDumpUserStreams(streams, MAYA_MAX_DUMP_USER_STREAMS, &gMayaCrashDumpStaging);
+    BOOL dumpWritten = writeMayaCrashDump(hFile, exceptionInfo, streams, numStreams, gMayaDumpCapture);
     if (dumpWritten == false) {
+        if (gMayaHeadlessCrashMode) {
+            CloseHandle(hFile);
+            headlessReport.status = MayaHeadlessCrashStatus_DumpFailed;
+            finishMayaHeadlessCrash(tempDirPath, &headlessReport);
+        }
 #ifdef _DEBUG
         DWORD wErr = ::GetLastError();
         LPVOID lpMsgBuf = NULL;
@@ -300,6 +661,20 @@ LONG WINAPI mayaCustomUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInf
         ::MessageBoxA(NULL, MSG_UNABLE_TO_WRITE_DUMP, MSG_UNHANDLED_EXCEPTION, MB_OK|MB_ICONSTOP);
         return EXCEPTION_CONTINUE_SEARCH;
     } else {
+        // NOTE: (sonictk) Only now that there is a dump of it does this crash count towards
+        // suppressing its repeats.
+        if (gMayaCrashDedupWindowSecs != 0) {
+            recordMayaCrashFingerprint(tempDirPath, &fingerprint);
+        }
+        writeMayaCrashSidecarForDump(exceptionInfo, &fingerprint, dumpFilePath);
+        if (gMayaHeadlessCrashMode) {
+            // NOTE: (sonictk) Make sure the dump is complete on disk before the process goes away.
+            CloseHandle(hFile);
+            headlessReport.status = MayaHeadlessCrashStatus_Dumped;
+            headlessReport.filePath = dumpFilePath;
+            finishMayaHeadlessCrash(tempDirPath, &headlessReport);
+        }
+
         char msg[MAX_PATH] = {0};
         snprintf(msg, MAX_PATH, "An unrecoverable error has occured and the application will now close.\nA minidump file has been written to the following location for debugging purposes:\n%s", dumpFilePath);
         ::MessageBoxA(NULL, msg, MSG_UNHANDLED_EXCEPTION, MB_OK|MB_ICONSTOP);
@@ -311,107 +686,60 @@ LONG WINAPI mayaCustomUnhandledExceptionFilter(LPEXCEPTION_POINTERS exceptionInf
 }
 
 
+/// Called first for every exception in the process, handled or not. Crashes are dumped right here,
+/// before a ``__try``/``__except`` or ``catch (...)`` in the host gets the chance to swallow them;
+/// anything else is left to reach ``mayaCustomUnhandledExceptionFilter`` if no one handles it.
 LONG WINAPI mayaCustomVectoredExceptionHandler(PEXCEPTION_POINTERS exceptionInfo)
 {
+    if (!isMayaFirstChanceExceptionFatal(exceptionInfo->ExceptionRecord)) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
     LONG result = mayaCustomUnhandledExceptionFilter(exceptionInfo);
     gHandlerCalled = true;
     return result;
 }
 
 
-bool patchOverIATEntryInOneModule(const char *calleeModName, PROC pfnCurrent, PROC pfnNew, HMODULE hmodCaller)
-{
-    ULONG importSectionSize = 0;
-    PIMAGE_IMPORT_DESCRIPTOR pImportDesc = (PIMAGE_IMPORT_DESCRIPTOR)::ImageDirectoryEntryToDataEx(hmodCaller, TRUE, IMAGE_DIRECTORY_ENTRY_IMPORT, &importSectionSize, NULL);
-    if (pImportDesc == NULL) {
-        return false;
-    }
-
-    // NOTE: (sonictk) Now we search within the import directory itself to find the specific entry we want to patch over.
-    bool foundEntry = false;
-    while (pImportDesc->Name != NULL && pImportDesc->Characteristics != NULL) {
-        PSTR pszImportName = (PSTR)((PBYTE)hmodCaller + pImportDesc->Name);
-        if (_stricmp(pszImportName, calleeModName) == 0) {
-            foundEntry = true;
-            break;
-        }
-        ++pImportDesc;
-    }
-    if (foundEntry != true) {
-        return false;
-    }
-
-    // NOTE: (sonictk) Ok, now that we found the entry in the import table, we'll go over each
-    // IAT thunk from the import desc. to find the one used to call our desired proc.
-    PIMAGE_THUNK_DATA pThunk = (PIMAGE_THUNK_DATA)((PBYTE)hmodCaller + pImportDesc->FirstThunk);
-    while (pThunk->u1.Function != NULL) {
-        // NOTE: (sonictk) Get a address of the function address to compare against.
-        PROC *pFunc = (PROC *)&pThunk->u1.Function;
-
-        if (*pFunc == *pfnCurrent) { // NOTE: (sonictk) Found! Now we can patch over it.
-            // NOTE: (sonictk) To do that, let's check the memory page where this is stored,
-            // set its permissions to be writable, write to it, and then restore the permissions.
-            MEMORY_BASIC_INFORMATION memDesc = {0};
-            ::VirtualQuery(pFunc, &memDesc, sizeof(MEMORY_BASIC_INFORMATION));
-            // NOTE: (sonictk) Try to set the permissions to be R/W. Old permissions are stored in the Protect member.
-            if (!::VirtualProtect(memDesc.BaseAddress, memDesc.RegionSize, PAGE_READWRITE, &memDesc.Protect)) {
-                return false;
-            }
+static MayaIATHook gMayaIATHooks[MAYA_MAX_IAT_HOOKS] = {};
+static unsigned int gMayaNumIATHooks = 0;
 
-            // NOTE: (sonictk) Now store our filter and overwrite the current one.
-            HANDLE hProcess = GetCurrentProcess();
-            ::WriteProcessMemory(hProcess, pFunc, &pfnNew, sizeof(pfnNew), NULL);
+/// NOTE: (sonictk) Since ``signal`` is imported from the CRT DLL, this is initialized with the address
+/// of the real one when the plugin is loaded, before any of the IATs have been patched. The plugin
+/// itself must always go through this instead of calling ``signal`` directly.
+typedef abort_handler (__cdecl *signal_func)(int sig, abort_handler handler);
+static signal_func gOrigSignal = (signal_func)signal;
 
-            // NOTE: (sonictk) Restore memory page protections.
-            DWORD dwOldProtect = 0;
-            ::VirtualProtect(memDesc.BaseAddress, memDesc.RegionSize, memDesc.Protect, &dwOldProtect);
-            return true;
-        }
-        ++pThunk;
-    }
 
-    return false;
+/// Turns ``abort()`` into a SEH exception so that our unhandled exception filter gets called.
+void __cdecl mayaAbortSignalHandler(int sig)
+{
+    (void)sig;
+    ::RaiseException(SIGABRT, EXCEPTION_NONCONTINUABLE, 0, NULL);
 }
 
 
-bool patchOverIATEntriesInAllModules(const char *calleeModName, PROC pfnCurrent, PROC pfnNew)
+/// Replaces the CRT's ``signal`` in every module, so that no one else can replace our ``SIGABRT``
+/// handler. Everything else is passed through to the CRT untouched.
+abort_handler __cdecl detouredSignal(int sig, abort_handler handler)
 {
-    // NOTE: (sonictk) We get a handle to the current module by finding which region of memory
-    // contains this function being run, and gettng a handle to its allocation base.
-    // MEMORY_BASIC_INFORMATION mbi;
-    // SIZE_T bufSize = VirtualQuery(patchOverIATEntriesInAllModules, &mbi, sizeof(mbi));
-    // if (bufSize == 0) {
-    //     return false;
-    // }
-    // HMODULE thisMod = (HMODULE)mbi.AllocationBase;
-
-    DWORD currentProcId = ::GetCurrentProcessId();
-    // NOTE: (sonictk) We use CreateToolhelp32Snapshot instead of EnumProcessModules since
-    // it has less bookkeeping requirements and will take care of the memory
-    // management. This isn't a bleeding-edge performance requirement.
-    HANDLE hProcSnapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, currentProcId);
-
-    MODULEENTRY32 modEntry = {0};
-    modEntry.dwSize = sizeof(modEntry);
-
-    for (BOOL bStat = Module32First(hProcSnapshot, &modEntry); bStat == TRUE; bStat = Module32Next(hProcSnapshot, &modEntry)) {
-        // if (modEntry.hModule == thisMod) {
-        //     continue;
-        // }
-
-        patchOverIATEntryInOneModule(calleeModName, pfnCurrent, pfnNew, modEntry.hModule);
+    if (sig == SIGABRT) {
+        // NOTE: (sonictk) Pretend that it worked, but leave our handler installed.
+        return mayaAbortSignalHandler;
     }
 
-    ::CloseHandle(hProcSnapshot);
-
-    return true;
+    return gOrigSignal(sig, handler);
 }
 
 
 /**
- * We patch over the ``SetUnhandledExceptionFilter`` function in the kernel32.dll's import address table
- * so that any calls to it end up calling ``pFnFilterReplace`` instead. This used to work to invoke our
- * exception filter on CRT exceptions as well (using VS 2008), but doesn't anymore.
+ * We patch over the ``SetUnhandledExceptionFilter`` function in the import address tables of all
+ * modules so that any calls to it end up calling ``pFnFilterReplace`` instead. This used to work to
+ * invoke our exception filter on CRT exceptions as well (using VS 2008), but doesn't anymore.
+ * The CRT's ``signal`` is patched the same way so that our ``SIGABRT`` handler stays put.
+ *
+ * Modules loaded after this is called are patched as they are loaded through a loader
+ * notification, instead of rescanning every module in the process.
  *
  * @param pFnFilterReplace    The filter to replace the existing one with.
  * @param pOrigFilter         A pointer to a storage for the original filter that is to be replaced.
@@ -420,10 +748,6 @@ bool patchOverIATEntriesInAllModules(const char *calleeModName, PROC pfnCurrent,
  */
 bool patchOverUnhandledExceptionFilter(PROC pFnFilterReplace, FARPROC *pOrigFilter)
 {
-    // HMODULE hMayaExe = NULL;
-    // ::GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, NULL, &hMayaExe);
-    // assert(hMayaExe != NULL);
-
     HMODULE hKernel32Mod = NULL;
     // NOTE: (sonictk) Kernel32.dll should be guaranteed to have been loaded by Maya at this point.
     ::GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, "kernel32.dll", &hKernel32Mod);
@@ -437,15 +761,62 @@ bool patchOverUnhandledExceptionFilter(PROC pFnFilterReplace, FARPROC *pOrigFilt
         }
     }
 
-    bool bStat = patchOverIATEntriesInAllModules("kernel32.dll", *pOrigFilter, pFnFilterReplace);
-    return bStat;
+    gMayaNumIATHooks = 0;
+    gMayaIATHooks[gMayaNumIATHooks].pfnOrig = (PROC)*pOrigFilter;
+    gMayaIATHooks[gMayaNumIATHooks++].pfnNew = pFnFilterReplace;
+    gMayaIATHooks[gMayaNumIATHooks].pfnOrig = (PROC)gOrigSignal;
+    gMayaIATHooks[gMayaNumIATHooks++].pfnNew = (PROC)detouredSignal;
+
+    bool bStat = patchOverIATEntriesInAllModules(gMayaIATHooks, gMayaNumIATHooks, false);
+    if (!bStat) {
+        return false;
+    }
+
+    if (!startPatchingIATsOnModuleLoad(gMayaIATHooks, gMayaNumIATHooks)) {
+        MGlobal::displayWarning("Could not register for DLL load notifications. Modules loaded after this plugin will not be patched.");
+    }
+
+    return true;
+}
+
+
+/**
+ * Undoes everything that ``patchOverUnhandledExceptionFilter`` did.
+ *
+ * @return  ``true`` if the operation was successful, ``false`` otherwise.
+ */
+bool restoreUnhandledExceptionFilter()
+{
+    // NOTE: (sonictk) Stop patching newly-loaded modules first, so that none are patched after
+    // they have been restored.
+    stopPatchingIATsOnModuleLoad();
+
+    return patchOverIATEntriesInAllModules(gMayaIATHooks, gMayaNumIATHooks, true);
 }
 
 
 MStatus initializePlugin(MObject obj)
 {
+    // NOTE: (sonictk) Our own initialization counts towards the startup cost as well, so time it
+    // in phases the same way as the plugins loaded after us.
+    startMayaSelfProfile();
+    startMayaPluginLoadTimes();
+    int selfLoadTime = beginMayaPluginLoadTime(MayaPluginLoadTimeKind_Self, "initializePlugin");
+    int phaseLoadTime = beginMayaPluginLoadTime(MayaPluginLoadTimeKind_Self, "initializePlugin: exception handlers");
+
     MFnPlugin plugin(obj, PLUGIN_AUTHOR, PLUGIN_VERSION, PLUGIN_REQUIRED_API_VERSION);
 
+    const bool isBatchSession = MGlobal::mayaState() != MGlobal::kInteractive;
+
+    // NOTE: (sonictk) Read this once up-front rather than every time the exception filter runs.
+    // Someone sitting in front of an interactive session wants a dump of every crash they hit, so
+    // only the sessions that crash loops happen in (i.e. those on the farm) deduplicate by default.
+    gMayaHeadlessCrashMode = isMayaHeadlessCrashMode(isBatchSession);
+    gMayaCrashDedupWindowSecs = getEnvironmentVariableAsUInt(MAYA_CRASH_DEDUP_WINDOW_ENV_VAR_NAME,
+                                                             isBatchSession || gMayaHeadlessCrashMode ? MAYA_CRASH_DEDUP_DEFAULT_WINDOW_SECS : MAYA_CRASH_DEDUP_DEFAULT_INTERACTIVE_WINDOW_SECS);
+    gMayaDumpCapture = (int)getEnvironmentVariableAsUInt(MAYA_DUMP_CAPTURE_ENV_VAR_NAME, MayaDumpCapture_Normal);
+    gMayaDumpCapture = gMayaDumpCapture >= MayaDumpCapture_Count ? MayaDumpCapture_Normal : gMayaDumpCapture;
+
     // NOTE: (sonictk) All the vectored handlers will be called first before any unhandled exception filters.
     gpVectoredHandler = (PVECTORED_EXCEPTION_HANDLER)::AddVectoredExceptionHandler(1, mayaCustomVectoredExceptionHandler);
 
@@ -473,12 +844,12 @@ MStatus initializePlugin(MObject obj)
       GetExceptionPointers(EXCEPTION_NONCONTINUABLE, &ppExceptionPointers);
       // NOTE: (sonictk) Here, it might be a good idea to have a different exception handler instead so that we can stuff in information
       // about the pure virtual function call and the call site, etc.
-      mayaCustomVectoredExceptionHandler(ppExceptionPointers);
+      mayaCustomUnhandledExceptionFilter(ppExceptionPointers);
       ::ExitProcess(0);
     });
 
     // NOTE: (sonictk) Other way: just raise a SEH exception which will trigger our unhandled exception filter to be caslled anyway!
-    gOrigAbortHandler = signal(SIGABRT, [](int signal){ (void)signal; ::RaiseException(SIGABRT, EXCEPTION_NONCONTINUABLE, 0, NULL); });
+    gOrigAbortHandler = gOrigSignal(SIGABRT, mayaAbortSignalHandler);
 
     // NOTE: (sonictk) Test that our detour-ing function works. If it is working,
     // unwantedUnhandledExceptionFilter should never get called.
@@ -486,6 +857,21 @@ MStatus initializePlugin(MObject obj)
 
     MGlobal::displayInfo("Custom Maya unhandled exception filter/handler(s) registered successfully.");
 
+    endMayaPluginLoadTime(phaseLoadTime);
+    phaseLoadTime = beginMayaPluginLoadTime(MayaPluginLoadTimeKind_Self, "initializePlugin: callbacks");
+
+    // NOTE: (sonictk) Publish a copy of the breadcrumbs for live monitoring as well. This has to
+    // be set up before the callbacks are first triggered below.
+    if (getEnvironmentVariableAsUInt(MAYA_LIVE_BREADCRUMBS_ENV_VAR_NAME, 1) != 0 && !createMayaLiveBreadcrumbs()) {
+        MGlobal::displayWarning("Could not create the shared memory segment for the breadcrumbs. The session will not be visible to monitors.");
+    }
+
+    // NOTE: (sonictk) Keep a timeline of the breadcrumbs as well, not just the latest of each.
+    unsigned int breadcrumbEventsCapacity = getEnvironmentVariableAsUInt(MAYA_BREADCRUMB_EVENTS_CAPACITY_ENV_VAR_NAME, MAYA_BREADCRUMB_EVENTS_DEFAULT_CAPACITY);
+    if (breadcrumbEventsCapacity != 0 && !startMayaBreadcrumbEvents(breadcrumbEventsCapacity)) {
+        MGlobal::displayWarning("Could not allocate the breadcrumb event ring. The breadcrumb timeline will not be available in crash dumps.");
+    }
+
     // NOTE: (sonictk) Install scene callbacks to set static variables in the data segment
     // that will actually be written into the dump. Why do we do this? Well, during a crash,
     // we're unwinding the stack, and the last thing we want to do is call into Maya functions
@@ -495,9 +881,18 @@ MStatus initializePlugin(MObject obj)
     // Aside; this is also why we're using fixed size buffers in the .bss segment instead of
     // dynamically allocating memory to hold the information we want to write out.
     MStatus mstat;
+    gMayaSceneBeforeOpen_cbid = MSceneMessage::addCallback(MSceneMessage::kBeforeOpen, mayaSceneBeforeLoadCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
     gMayaSceneAfterOpen_cbid = MSceneMessage::addCallback(MSceneMessage::kAfterOpen, mayaSceneAfterOpenCB, NULL, &mstat);
     CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
+    gMayaSceneBeforeNew_cbid = MSceneMessage::addCallback(MSceneMessage::kBeforeNew, mayaSceneBeforeLoadCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    gMayaSceneAfterNew_cbid = MSceneMessage::addCallback(MSceneMessage::kAfterNew, mayaSceneAfterNewCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
     gMayaTimeChange_cbid = MDGMessage::addTimeChangeCallback(mayaSceneTimeChangeCB, NULL, &mstat);
     CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
@@ -510,18 +905,112 @@ MStatus initializePlugin(MObject obj)
     gMayaNodeAdded_cbid = MDGMessage::addNodeAddedCallback(mayaNodeAddedCB, "dependNode", NULL, &mstat);
     CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
+    gMayaNodeRemoved_cbid = MDGMessage::addNodeRemovedCallback(mayaNodeRemovedCB, "dependNode", NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    gMayaIdleHeartbeat_cbid = MTimerMessage::addTimerCallback(MAYA_HANG_WATCHDOG_IDLE_HEARTBEAT_PERIOD_SECS, mayaIdleHeartbeatCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    gMayaBeforePluginLoad_cbid = MSceneMessage::addStringArrayCallback(MSceneMessage::kBeforePluginLoad, mayaBeforePluginLoadCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    gMayaAfterPluginLoad_cbid = MSceneMessage::addStringArrayCallback(MSceneMessage::kAfterPluginLoad, mayaAfterPluginLoadCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    gMayaBeforePluginUnload_cbid = MSceneMessage::addStringArrayCallback(MSceneMessage::kBeforePluginUnload, mayaBeforePluginUnloadCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    gMayaAfterPluginUnload_cbid = MSceneMessage::addStringArrayCallback(MSceneMessage::kAfterPluginUnload, mayaAfterPluginUnloadCB, NULL, &mstat);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
     // NOTE: (sonictk) We'll trigger the callbacks immediately anyway so that even on a fresh load of the plugin,
     // we get some basic information about the Maya session.
     mayaSceneAfterOpenCB(NULL);
     MTime curTime = MAnimControl::currentTime();
     mayaSceneTimeChangeCB(curTime, NULL);
 
+    endMayaPluginLoadTime(phaseLoadTime);
+    phaseLoadTime = beginMayaPluginLoadTime(MayaPluginLoadTimeKind_Self, "initializePlugin: background threads");
+
+    // NOTE: (sonictk) Most crashes under load are really the process running out of memory,
+    // so keep a history of the memory pressure around to be written into the dump.
+    unsigned int memorySampleIntervalMs = getEnvironmentVariableAsUInt(MAYA_MEMORY_SAMPLER_INTERVAL_ENV_VAR_NAME, MAYA_MEMORY_SAMPLER_DEFAULT_INTERVAL_MS);
+    if (!startMayaMemorySampler(memorySampleIntervalMs)) {
+        MGlobal::displayWarning("Could not start the memory sampler thread. Memory history will not be available in crash dumps.");
+    }
+
+    // NOTE: (sonictk) Hung sessions never raise an exception, so our filter would never get to run.
+    // Have a watchdog keep an eye on the main thread and snapshot the process if it stops responding.
+    // Batch sessions spend minutes at a time in a single render or compute without ever going
+    // idle, so the watchdog is only on there if a threshold was asked for.
+    unsigned int hangThresholdSecs = getEnvironmentVariableAsUInt(MAYA_HANG_WATCHDOG_THRESHOLD_ENV_VAR_NAME,
+                                                                  isBatchSession ? MAYA_HANG_WATCHDOG_DEFAULT_BATCH_THRESHOLD_SECS : MAYA_HANG_WATCHDOG_DEFAULT_THRESHOLD_SECS);
+    bool abortOnHang = getEnvironmentVariableAsUInt(MAYA_HANG_WATCHDOG_ABORT_ENV_VAR_NAME, 0) != 0;
+    if (hangThresholdSecs != 0 && !startMayaHangWatchdog(hangThresholdSecs, abortOnHang)) {
+        MGlobal::displayWarning("Could not start the hang watchdog thread. Hangs will not be captured.");
+    }
+
+    // NOTE: (sonictk) When a session crashes after minutes of degraded performance, we want to
+    // know what the main thread was burning its time on.
+    unsigned int profilerRateHz = getEnvironmentVariableAsUInt(MAYA_PROFILER_RATE_ENV_VAR_NAME, MAYA_PROFILER_DEFAULT_RATE_HZ);
+    if (profilerRateHz != 0 && !startMayaProfiler(profilerRateHz)) {
+        MGlobal::displayWarning("Could not start the sampling profiler thread. Main thread stacks will not be available in crash dumps.");
+    }
+
+    // NOTE: (sonictk) Node plugins report their computes to the flight recorder themselves, since
+    // Maya doesn't tell anyone else when a node starts or finishes computing.
+    if (getEnvironmentVariableAsUInt(MAYA_FLIGHT_RECORDER_ENV_VAR_NAME, 1) != 0 && !startMayaFlightRecorder()) {
+        MGlobal::displayWarning("Could not start the flight recorder. Compute events will not be available in crash dumps.");
+    }
+
+    // NOTE: (sonictk) Dumps that capture memory take long enough to write that it's worth having a
+    // few threads standing by to do it. They have to be started now, since it's too late once the
+    // process has crashed.
+    unsigned int numDumpWriters = getEnvironmentVariableAsUInt(MAYA_DUMP_WRITERS_ENV_VAR_NAME, MAYA_DUMP_WRITERS_DEFAULT_NUM_THREADS);
+    if (gMayaDumpCapture != MayaDumpCapture_Normal && numDumpWriters != 0 && !startMayaDumpWriters(numDumpWriters)) {
+        MGlobal::displayWarning("Could not start the dump writer threads. Crash dumps will be written from the crashing thread alone.");
+    }
+
+    endMayaPluginLoadTime(phaseLoadTime);
+
     mstat  = plugin.registerCommand(MAYA_FORCE_CRASH_CMD_NAME,
                                     MayaForceCrashCmd::creator,
                                     MayaForceCrashCmd::newSyntax);
 
     CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
+    mstat = plugin.registerCommand(MAYA_SNAPSHOT_DUMP_CMD_NAME,
+                                   MayaSnapshotDumpCmd::creator,
+                                   MayaSnapshotDumpCmd::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.registerCommand(MAYA_MEMORY_SAMPLES_CMD_NAME,
+                                   MayaMemorySamplesCmd::creator,
+                                   MayaMemorySamplesCmd::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.registerCommand(MAYA_PROFILER_STACKS_CMD_NAME,
+                                   MayaProfilerStacksCmd::creator,
+                                   MayaProfilerStacksCmd::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.registerCommand(MAYA_PLUGIN_LOAD_TIMES_CMD_NAME,
+                                   MayaPluginLoadTimesCmd::creator,
+                                   MayaPluginLoadTimesCmd::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.registerCommand(MAYA_SCENE_STATS_CMD_NAME,
+                                   MayaSceneStatsCmd::creator,
+                                   MayaSceneStatsCmd::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.registerCommand(MAYA_SELF_PROFILE_CMD_NAME,
+                                   MayaSelfProfileCmd::creator,
+                                   MayaSelfProfileCmd::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    endMayaPluginLoadTime(selfLoadTime);
+
     return mstat;
 }
 
@@ -538,8 +1027,7 @@ MStatus uninitializePlugin(MObject obj)
 
     // NOTE: (sonictk) Also re-patch the kernel32.dll's version to the original CRT one.
     if (gCRTFilterPatched) {
-        FARPROC customUnhandledExceptionFilter = (FARPROC)detouredSetUnhandledExceptionFilter;
-        bool bStat = patchOverUnhandledExceptionFilter((PROC)gOrigCRTFilter, &customUnhandledExceptionFilter);
+        bool bStat = restoreUnhandledExceptionFilter();
         if (!bStat) {
             MGlobal::displayError("Could not restore the original CRT exception filter.");
             return MStatus::kFailure;
@@ -550,9 +1038,26 @@ MStatus uninitializePlugin(MObject obj)
     // one instead.
     ::SetUnhandledExceptionFilter(gPrevFilter);
     _set_purecall_handler(gOrigPurecallHandler);
-    signal(SIGABRT, gOrigAbortHandler);
+    gOrigSignal(SIGABRT, gOrigAbortHandler);
+
+    stopMayaMemorySampler();
+    stopMayaHangWatchdog();
+    stopMayaProfiler();
+    destroyMayaLiveBreadcrumbs();
+    stopMayaBreadcrumbEvents();
+    stopMayaFlightRecorder();
+    stopMayaDumpWriters();
+
+    MStatus mstat = MMessage::removeCallback(gMayaSceneBeforeOpen_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
-    MStatus mstat = MMessage::removeCallback(gMayaSceneAfterOpen_cbid);
+    mstat = MMessage::removeCallback(gMayaSceneAfterOpen_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaSceneBeforeNew_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaSceneAfterNew_cbid);
     CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
     mstat = MMessage::removeCallback(gMayaTimeChange_cbid);
@@ -567,10 +1072,46 @@ MStatus uninitializePlugin(MObject obj)
     mstat = MMessage::removeCallback(gMayaNodeAdded_cbid);
     CHECK_MSTATUS_AND_RETURN_IT(mstat);
 
+    mstat = MMessage::removeCallback(gMayaNodeRemoved_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaIdleHeartbeat_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaBeforePluginLoad_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaAfterPluginLoad_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaBeforePluginUnload_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = MMessage::removeCallback(gMayaAfterPluginUnload_cbid);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
     MGlobal::displayInfo("All Maya custom unhandled exception filter(s) unregistered successfully.");
 
     MFnPlugin plugin(obj);
     mstat = plugin.deregisterCommand(MAYA_FORCE_CRASH_CMD_NAME);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.deregisterCommand(MAYA_SNAPSHOT_DUMP_CMD_NAME);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.deregisterCommand(MAYA_MEMORY_SAMPLES_CMD_NAME);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.deregisterCommand(MAYA_PROFILER_STACKS_CMD_NAME);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.deregisterCommand(MAYA_PLUGIN_LOAD_TIMES_CMD_NAME);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.deregisterCommand(MAYA_SCENE_STATS_CMD_NAME);
+    CHECK_MSTATUS_AND_RETURN_IT(mstat);
+
+    mstat = plugin.deregisterCommand(MAYA_SELF_PROFILE_CMD_NAME);
 
     return mstat;
 }
@@ -0,0 +1,391 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_memory_sampler.cpp
+ * @brief  A low-priority thread that periodically records the memory pressure of the Maya
+ *         process into a fixed ring in the .bss segment, so that the history is available
+ *         in the crash dump (most crashes under load are really out-of-memory conditions).
+ */
+#include "maya_custom_unhandled_exception_filter_memory_sampler.h"
+
+#include <Psapi.h>
+
+#include <maya/MArgDatabase.h>
+
+
+/// The ring of memory samples. This lives in the .bss segment and is written into the crash dump as-is.
+static MayaMemorySampleRing gMayaMemorySampleRing = {0};
+
+static HANDLE gMayaMemorySamplerThread = NULL;
+static HANDLE gMayaMemorySamplerStopEvent = NULL;
+
+/// When the sampler was started, so that the CPU time that it has used can be put against how long
+/// it has been running for.
+static ULONGLONG gMayaMemorySamplerStartTickMs = 0;
+
+/// Can be changed at runtime from the command; the sampler thread picks it up on its next iteration.
+static volatile LONG gMayaMemorySamplerIntervalMs = MAYA_MEMORY_SAMPLER_DEFAULT_INTERVAL_MS;
+
+
+/// Walks the address space of the process and accumulates the committed size of mapped views and images.
+static void sumMappedRegions(uint64_t *mappedBytes, uint64_t *imageBytes)
+{
+    uint64_t mapped = 0;
+    uint64_t image = 0;
+
+    MEMORY_BASIC_INFORMATION mbi = {0};
+    PBYTE addr = NULL;
+    while (::VirtualQuery(addr, &mbi, sizeof(mbi)) == sizeof(mbi)) {
+        if (mbi.State == MEM_COMMIT) {
+            if (mbi.Type == MEM_MAPPED) {
+                mapped += mbi.RegionSize;
+            } else if (mbi.Type == MEM_IMAGE) {
+                image += mbi.RegionSize;
+            }
+        }
+        PBYTE next = (PBYTE)mbi.BaseAddress + mbi.RegionSize;
+        if (next <= addr) {
+            break;
+        }
+        addr = next;
+    }
+
+    *mappedBytes = mapped;
+    *imageBytes = image;
+}
+
+
+/// Sums up the allocated and committed sizes of the heaps of the process.
+static void sumHeaps(uint64_t *allocatedBytes, uint64_t *committedBytes, uint32_t *numHeapsSummed)
+{
+    HANDLE heaps[MAYA_MEMORY_SAMPLER_MAX_HEAPS];
+    DWORD numHeaps = ::GetProcessHeaps(MAYA_MEMORY_SAMPLER_MAX_HEAPS, heaps);
+    uint64_t allocated = 0;
+    uint64_t committed = 0;
+    for (DWORD i=0; i < numHeaps && i < MAYA_MEMORY_SAMPLER_MAX_HEAPS; ++i) {
+        HEAP_SUMMARY heapSummary = {0};
+        heapSummary.cb = sizeof(heapSummary);
+        if (::HeapSummary(heaps[i], 0, &heapSummary)) {
+            allocated += heapSummary.cbAllocated;
+            committed += heapSummary.cbCommitted;
+        }
+    }
+
+    *allocatedBytes = allocated;
+    *committedBytes = committed;
+    *numHeapsSummed = numHeaps;
+}
+
+
+/// Records a single sample into the ring. This does not allocate any memory, since the whole
+/// point is to keep working when the process is running out of it.
+static void recordMayaMemorySample(unsigned int sampleIdx)
+{
+    MayaMemorySampleRing *ring = &gMayaMemorySampleRing;
+    uint32_t numWritten = ring->numSamplesWritten;
+    MayaMemorySample *sample = &ring->samples[numWritten % MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+
+    // NOTE: (sonictk) Carry over the expensive stats from the previous sample if we're not
+    // due to refresh them this time around.
+    uint64_t mappedBytes = 0;
+    uint64_t imageBytes = 0;
+    uint64_t heapAllocated = 0;
+    uint64_t heapCommitted = 0;
+    uint32_t numHeaps = 0;
+    if (numWritten > 0) {
+        const MayaMemorySample *prev = &ring->samples[(numWritten - 1) % MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+        mappedBytes = prev->mappedBytes;
+        imageBytes = prev->imageBytes;
+        heapAllocated = prev->heapAllocatedBytes;
+        heapCommitted = prev->heapCommittedBytes;
+        numHeaps = prev->numHeaps;
+    }
+    if (sampleIdx % MAYA_MEMORY_SAMPLER_REGION_WALK_PERIOD == 0) {
+        sumMappedRegions(&mappedBytes, &imageBytes);
+    }
+    if (sampleIdx % MAYA_MEMORY_SAMPLER_HEAP_SUMMARY_PERIOD == 0) {
+        sumHeaps(&heapAllocated, &heapCommitted, &numHeaps);
+    }
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+
+    PROCESS_MEMORY_COUNTERS_EX procMem = {0};
+    procMem.cb = sizeof(procMem);
+    ::GetProcessMemoryInfo(::GetCurrentProcess(), (PPROCESS_MEMORY_COUNTERS)&procMem, sizeof(procMem));
+
+    PERFORMANCE_INFORMATION perfInfo = {0};
+    perfInfo.cb = sizeof(perfInfo);
+    ::GetPerformanceInfo(&perfInfo, sizeof(perfInfo));
+
+    sample->timestamp = (uint64_t)now.QuadPart;
+    sample->workingSetBytes = procMem.WorkingSetSize;
+    sample->peakWorkingSetBytes = procMem.PeakWorkingSetSize;
+    sample->privateCommitBytes = procMem.PrivateUsage;
+    sample->heapAllocatedBytes = heapAllocated;
+    sample->heapCommittedBytes = heapCommitted;
+    sample->mappedBytes = mappedBytes;
+    sample->imageBytes = imageBytes;
+    sample->systemAvailPhysBytes = (uint64_t)perfInfo.PhysicalAvailable * perfInfo.PageSize;
+    sample->systemCommitTotalBytes = (uint64_t)perfInfo.CommitTotal * perfInfo.PageSize;
+    sample->systemCommitLimitBytes = (uint64_t)perfInfo.CommitLimit * perfInfo.PageSize;
+    sample->pageFaultCount = procMem.PageFaultCount;
+    sample->numHeaps = numHeaps;
+
+    // NOTE: (sonictk) Make sure the sample is fully written before we publish it, since the
+    // crash handler (or the command) can read the ring from another thread at any time.
+    ::MemoryBarrier();
+    ring->intervalMs = (uint32_t)gMayaMemorySamplerIntervalMs;
+    ring->numSamplesWritten = numWritten + 1;
+}
+
+
+static DWORD WINAPI mayaMemorySamplerThreadProc(LPVOID unused)
+{
+    (void)unused;
+
+    unsigned int sampleIdx = 0;
+    recordMayaMemorySample(sampleIdx++);
+    while (::WaitForSingleObject(gMayaMemorySamplerStopEvent, (DWORD)gMayaMemorySamplerIntervalMs) == WAIT_TIMEOUT) {
+        recordMayaMemorySample(sampleIdx++);
+    }
+
+    return 0;
+}
+
+
+bool startMayaMemorySampler(unsigned int intervalMs)
+{
+    if (gMayaMemorySamplerThread != NULL) {
+        return true;
+    }
+
+    if (intervalMs < MAYA_MEMORY_SAMPLER_MIN_INTERVAL_MS) {
+        intervalMs = MAYA_MEMORY_SAMPLER_MIN_INTERVAL_MS;
+    }
+    gMayaMemorySamplerIntervalMs = (LONG)intervalMs;
+
+    LARGE_INTEGER freq;
+    ::QueryPerformanceFrequency(&freq);
+    gMayaMemorySampleRing.timerFrequency = (uint64_t)freq.QuadPart;
+    gMayaMemorySampleRing.intervalMs = intervalMs;
+
+    gMayaMemorySamplerStopEvent = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (gMayaMemorySamplerStopEvent == NULL) {
+        return false;
+    }
+
+    gMayaMemorySamplerStartTickMs = ::GetTickCount64();
+    gMayaMemorySamplerThread = ::CreateThread(NULL, 0, mayaMemorySamplerThreadProc, NULL, CREATE_SUSPENDED, NULL);
+    if (gMayaMemorySamplerThread == NULL) {
+        ::CloseHandle(gMayaMemorySamplerStopEvent);
+        gMayaMemorySamplerStopEvent = NULL;
+        return false;
+    }
+
+    // NOTE: (sonictk) This should never compete with the artist's work for CPU time.
+    ::SetThreadPriority(gMayaMemorySamplerThread, THREAD_PRIORITY_LOWEST);
+    ::ResumeThread(gMayaMemorySamplerThread);
+
+    return true;
+}
+
+
+void stopMayaMemorySampler()
+{
+    if (gMayaMemorySamplerThread == NULL) {
+        return;
+    }
+
+    ::SetEvent(gMayaMemorySamplerStopEvent);
+    ::WaitForSingleObject(gMayaMemorySamplerThread, INFINITE);
+
+    ::CloseHandle(gMayaMemorySamplerThread);
+    ::CloseHandle(gMayaMemorySamplerStopEvent);
+    gMayaMemorySamplerThread = NULL;
+    gMayaMemorySamplerStopEvent = NULL;
+}
+
+
+/**
+ * Gets how much CPU time the sampler thread has used since it was started.
+ *
+ * @param cpuMs     Storage for the CPU time used by the sampler thread, in milliseconds.
+ * @param wallMs    Storage for how long the sampler has been running for, in milliseconds.
+ *
+ * @return          ``false`` if the sampler is not running.
+ */
+static bool getMayaMemorySamplerCPUTime(double *cpuMs, double *wallMs)
+{
+    if (gMayaMemorySamplerThread == NULL) {
+        return false;
+    }
+
+    FILETIME creationTime;
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    if (!::GetThreadTimes(gMayaMemorySamplerThread, &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return false;
+    }
+
+    // NOTE: (sonictk) ``FILETIME``s are in 100ns intervals.
+    const uint64_t kernel100ns = ((uint64_t)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+    const uint64_t user100ns = ((uint64_t)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+    *cpuMs = (double)(kernel100ns + user100ns) / 10000.0;
+    *wallMs = (double)(::GetTickCount64() - gMayaMemorySamplerStartTickMs);
+
+    return true;
+}
+
+
+bool getMayaMemorySamplesStream(MINIDUMP_USER_STREAM *stream)
+{
+    stream->Type = MAYA_MEMORY_SAMPLES_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaMemorySampleRing);
+    stream->Buffer = &gMayaMemorySampleRing;
+
+    return true;
+}
+
+
+void *MayaMemorySamplesCmd::creator()
+{
+    MayaMemorySamplesCmd *cmd = new MayaMemorySamplesCmd();
+
+    cmd->flagHelp = false;
+    cmd->count = MAYA_MEMORY_SAMPLE_RING_CAPACITY;
+    cmd->intervalMs = 0;
+
+    return cmd;
+}
+
+
+MSyntax MayaMemorySamplesCmd::newSyntax()
+{
+    MSyntax syntax;
+
+    syntax.enableQuery(false);
+    syntax.enableEdit(false);
+    syntax.useSelectionAsDefault(false);
+
+    syntax.addFlag(MAYA_MEMORY_SAMPLES_CMD_HELP_FLAG_SHORTNAME,
+                   MAYA_MEMORY_SAMPLES_CMD_HELP_FLAG_NAME);
+
+    syntax.addFlag(MAYA_MEMORY_SAMPLES_CMD_COUNT_FLAG_SHORTNAME,
+                   MAYA_MEMORY_SAMPLES_CMD_COUNT_FLAG_NAME,
+                   MSyntax::kLong);
+
+    syntax.addFlag(MAYA_MEMORY_SAMPLES_CMD_INTERVAL_FLAG_SHORTNAME,
+                   MAYA_MEMORY_SAMPLES_CMD_INTERVAL_FLAG_NAME,
+                   MSyntax::kLong);
+
+    return syntax;
+}
+
+
+MStatus MayaMemorySamplesCmd::parseArgs(const MArgList &args)
+{
+    MStatus result;
+
+    MArgDatabase argDb(this->syntax(), args, &result);
+    CHECK_MSTATUS_AND_RETURN_IT(result);
+
+    if (argDb.isFlagSet(MAYA_MEMORY_SAMPLES_CMD_HELP_FLAG_SHORTNAME)) {
+        MGlobal::displayInfo(MAYA_MEMORY_SAMPLES_CMD_HELP_TEXT);
+        this->flagHelp = true;
+        return MStatus::kSuccess;
+    }
+
+    if (argDb.isFlagSet(MAYA_MEMORY_SAMPLES_CMD_COUNT_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_MEMORY_SAMPLES_CMD_COUNT_FLAG_SHORTNAME, 0, this->count);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    if (argDb.isFlagSet(MAYA_MEMORY_SAMPLES_CMD_INTERVAL_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_MEMORY_SAMPLES_CMD_INTERVAL_FLAG_SHORTNAME, 0, this->intervalMs);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    return result;
+}
+
+
+MStatus MayaMemorySamplesCmd::redoIt()
+{
+    if (this->intervalMs > 0) {
+        int intervalMs = this->intervalMs < MAYA_MEMORY_SAMPLER_MIN_INTERVAL_MS ? MAYA_MEMORY_SAMPLER_MIN_INTERVAL_MS : this->intervalMs;
+        ::InterlockedExchange(&gMayaMemorySamplerIntervalMs, (LONG)intervalMs);
+    }
+
+    // NOTE: (sonictk) The sampler is meant to cost next to nothing, so say what it actually costs.
+    double cpuMs = 0.0;
+    double wallMs = 0.0;
+    if (getMayaMemorySamplerCPUTime(&cpuMs, &wallMs) && wallMs > 0.0) {
+        char line[256] = {0};
+        snprintf(line, sizeof(line), "Memory sampler: %.1f ms of CPU time over %.1f s (%.4f%% of one core), %u samples",
+                 cpuMs, wallMs / 1000.0, cpuMs / wallMs * 100.0, gMayaMemorySampleRing.numSamplesWritten);
+        MGlobal::displayInfo(line);
+    }
+
+    const MayaMemorySampleRing *ring = &gMayaMemorySampleRing;
+    uint32_t numWritten = ring->numSamplesWritten;
+    uint32_t numAvailable = numWritten > MAYA_MEMORY_SAMPLE_RING_CAPACITY ? MAYA_MEMORY_SAMPLE_RING_CAPACITY : numWritten;
+    uint32_t numToPrint = this->count < 0 ? 0 : (uint32_t)this->count;
+    if (numToPrint > numAvailable) {
+        numToPrint = numAvailable;
+    }
+    if (numToPrint == 0) {
+        MGlobal::displayInfo("No memory samples have been recorded yet.");
+        return MStatus::kSuccess;
+    }
+
+    static const double bytesToMB = 1.0 / (1024.0 * 1024.0);
+    const MayaMemorySample *newest = &ring->samples[(numWritten - 1) % MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+    for (uint32_t i=numWritten - numToPrint; i < numWritten; ++i) {
+        const MayaMemorySample *sample = &ring->samples[i % MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+        double ageSecs = ring->timerFrequency == 0 ? 0.0 : (double)(newest->timestamp - sample->timestamp) / (double)ring->timerFrequency;
+        char line[512] = {0};
+        snprintf(line, sizeof(line),
+                 "[-%8.1fs] WS: %9.1f MB Commit: %9.1f MB Heap: %9.1f/%9.1f MB Mapped: %9.1f MB "
+                 "Sys avail: %9.1f MB Sys commit: %9.1f/%9.1f MB Faults: %u",
+                 ageSecs,
+                 sample->workingSetBytes * bytesToMB,
+                 sample->privateCommitBytes * bytesToMB,
+                 sample->heapAllocatedBytes * bytesToMB,
+                 sample->heapCommittedBytes * bytesToMB,
+                 sample->mappedBytes * bytesToMB,
+                 sample->systemAvailPhysBytes * bytesToMB,
+                 sample->systemCommitTotalBytes * bytesToMB,
+                 sample->systemCommitLimitBytes * bytesToMB,
+                 sample->pageFaultCount);
+        MGlobal::displayInfo(line);
+    }
+
+    return MStatus::kSuccess;
+}
+
+
+MStatus MayaMemorySamplesCmd::doIt(const MArgList &args)
+{
+    this->clearResult();
+
+    MStatus stat = this->parseArgs(args);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
+
+    if (this->flagHelp == true) {
+        return MStatus::kSuccess;
+    }
+
+    return this->redoIt();
+}
+
+
+MStatus MayaMemorySamplesCmd::undoIt()
+{
+    return MStatus::kSuccess;
+}
+
+
+bool MayaMemorySamplesCmd::isUndoable() const
+{
+    return false;
+}
@@ -0,0 +1,125 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_MEMORY_SAMPLER_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_MEMORY_SAMPLER_H
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgList.h>
+
+#include "common.h"
+
+#define MAYA_MEMORY_SAMPLER_INTERVAL_ENV_VAR_NAME "MAYA_CRASH_MEMORY_SAMPLE_INTERVAL_MS"
+#define MAYA_MEMORY_SAMPLER_DEFAULT_INTERVAL_MS 1000
+#define MAYA_MEMORY_SAMPLER_MIN_INTERVAL_MS 100
+
+/// Walking the entire address space to find mapped views is far more expensive than the
+/// rest of a sample, so it is only done once every this many samples.
+#define MAYA_MEMORY_SAMPLER_REGION_WALK_PERIOD 30
+
+/// Summarising a heap takes its lock, which Maya's allocators are contending for already, so the
+/// heaps are summarised even less often than the address space is walked.
+#define MAYA_MEMORY_SAMPLER_HEAP_SUMMARY_PERIOD 60
+
+#define MAYA_MEMORY_SAMPLER_MAX_HEAPS 64
+
+#define MAYA_MEMORY_SAMPLES_CMD_NAME "mayaMemorySamples"
+#define MAYA_MEMORY_SAMPLES_CMD_HELP_FLAG_SHORTNAME "-h"
+#define MAYA_MEMORY_SAMPLES_CMD_HELP_FLAG_NAME "-help"
+
+#define MAYA_MEMORY_SAMPLES_CMD_COUNT_FLAG_SHORTNAME "-n"
+#define MAYA_MEMORY_SAMPLES_CMD_COUNT_FLAG_NAME "-count"
+
+#define MAYA_MEMORY_SAMPLES_CMD_INTERVAL_FLAG_SHORTNAME "-i"
+#define MAYA_MEMORY_SAMPLES_CMD_INTERVAL_FLAG_NAME "-interval"
+
+#define MAYA_MEMORY_SAMPLES_CMD_HELP_TEXT "Prints the most recent memory pressure samples recorded by the crash handler, " \
+    "along with how much CPU time the sampler has used so far. " \
+    "Use -count to limit the number of samples printed and -interval to change the sampling rate (in milliseconds)."
+
+
+/**
+ * Starts the low-priority thread that periodically records memory samples into the ring.
+ *
+ * @param intervalMs    The sampling interval, in milliseconds.
+ *
+ * @return              ``true`` if the sampler thread was started successfully, ``false`` otherwise.
+ */
+bool startMayaMemorySampler(unsigned int intervalMs);
+
+/**
+ * Signals the sampler thread to stop and waits for it to exit.
+ */
+void stopMayaMemorySampler();
+
+/**
+ * Fills in the user stream that the memory samples are written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; there is always a ring to write, even if it is empty.
+ */
+bool getMayaMemorySamplesStream(MINIDUMP_USER_STREAM *stream);
+
+
+struct MayaMemorySamplesCmd : public MPxCommand
+{
+    /**
+     * Creates a new instance of the command. Used for Maya plugin registration.
+     *
+     * @return  A pointer to the new instance.
+     */
+    static void *creator();
+
+    /**
+     * This function parses the arguments that were given to the command and stores
+     * it in local class data. It finally calls ``redoIt`` to implement the actual
+     * command functionality.
+     *
+     * @param args  The arguments that were passed to the command.
+     * @return      The status code.
+     */
+    MStatus doIt(const MArgList &args);
+
+    /**
+     * Prints the requested samples from the ring, and updates the sampling interval if requested.
+     *
+     * @return      The status code.
+     */
+    MStatus redoIt();
+
+    /**
+     * This command does not modify the scene, so there is nothing to undo.
+     *
+     * @return      The status code.
+     */
+    MStatus undoIt();
+
+    /**
+     * This function specifies that the command is not undoable in Maya.
+     *
+     * @return  ``false``, as this command is not undoable.
+     */
+    bool isUndoable() const;
+
+    /**
+     * This static function returns the syntax object for this command.
+     *
+     * @return The syntax object set up for this command.
+     */
+    static MSyntax newSyntax();
+
+    /**
+     * This function parses the given arguments to the command and stores the
+     * results in local class data.
+     *
+     * @param args      The arguments that were passed to the command.
+     * @return          The status code.
+     */
+    MStatus parseArgs(const MArgList &args);
+
+    bool flagHelp;
+    int count;
+    int intervalMs;
+};
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_MEMORY_SAMPLER_H */
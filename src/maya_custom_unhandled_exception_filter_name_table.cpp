@@ -0,0 +1,149 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_name_table.cpp
+ * @brief  A fixed-size table of the DAG paths and DG node names seen by the breadcrumbs. The same
+ *         few thousand names come up over and over again while rigs are evaluated and scenes are
+ *         edited, so rather than copying each name into the breadcrumbs every time, each one is
+ *         stored here once and the breadcrumbs keep its ID. The whole table is written into the
+ *         dump, so that the reader can turn the IDs back into names.
+ */
+#include "maya_custom_unhandled_exception_filter_name_table.h"
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
+
+
+/// NOTE: (sonictk) Kept in the .bss segment so that it can be written into the dump as-is.
+static MayaNameTable gMayaNameTable = {0};
+
+
+static inline uint32_t hashMayaName(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    for (size_t i=0; i < len; ++i) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+
+/// Whether ``id`` still names the entry it was put in, i.e. whether it hasn't been evicted.
+static inline bool isMayaNameIdLive(uint32_t id)
+{
+    const volatile uint32_t *pEntryId = &gMayaNameTable.entries[id & (MAYA_NAME_TABLE_CAPACITY - 1)].id;
+
+    return id != MAYA_NAME_TABLE_INVALID_ID && *pEntryId == id;
+}
+
+
+uint32_t internMayaName(const char *name)
+{
+    size_t len = name == NULL ? 0 : strlen(name);
+    if (len == 0) {
+        return MAYA_NAME_TABLE_INVALID_ID;
+    }
+    // NOTE: (sonictk) The leaf of a DAG path is the interesting bit, so keep the tail end.
+    if (len > MAYA_NAME_TABLE_NAME_LEN - 1) {
+        name += len - (MAYA_NAME_TABLE_NAME_LEN - 1);
+        len = MAYA_NAME_TABLE_NAME_LEN - 1;
+    }
+    const uint32_t hash = hashMayaName(name, len);
+    // NOTE: (sonictk) Lookups are deliberately not counted; every DAG change looks names up from
+    // whichever thread made it, and a shared counter would be the one contended cache line in here.
+    MayaNameTable *table = &gMayaNameTable;
+
+    const uint32_t indexMask = MAYA_NAME_TABLE_INDEX_CAPACITY - 1;
+    for (uint32_t i=0; i < MAYA_NAME_TABLE_MAX_PROBES; ++i) {
+        const uint32_t id = *(volatile uint32_t *)&table->index[(hash + i) & indexMask];
+        if (id == MAYA_NAME_TABLE_INVALID_ID) {
+            break;
+        }
+        const MayaNameTableEntry *entry = &table->entries[id & (MAYA_NAME_TABLE_CAPACITY - 1)];
+        if (isMayaNameIdLive(id) && entry->hash == hash && entry->len == len && memcmp(entry->name, name, len) == 0) {
+            // NOTE: (sonictk) Make sure that the entry wasn't reused while we were comparing it.
+            MemoryBarrier();
+            if (isMayaNameIdLive(id)) {
+                return id;
+            }
+        }
+    }
+
+    // NOTE: (sonictk) Not in there yet. Two threads adding the same name at the same time will end
+    // up with an ID each, which is harmless.
+    uint32_t id = (uint32_t)::InterlockedIncrement((volatile LONG *)&table->nextId);
+    if (id == MAYA_NAME_TABLE_INVALID_ID) {
+        id = (uint32_t)::InterlockedIncrement((volatile LONG *)&table->nextId);
+    }
+    ::InterlockedIncrement64((volatile LONG64 *)&table->numInserts);
+
+    // NOTE: (sonictk) Evicts whichever name was in the entry. It is marked as empty while being
+    // written to, so that a crash halfway through leaves no half-written name behind.
+    MayaNameTableEntry *entry = &table->entries[id & (MAYA_NAME_TABLE_CAPACITY - 1)];
+    ::InterlockedExchange((volatile LONG *)&entry->id, MAYA_NAME_TABLE_INVALID_ID);
+    entry->hash = hash;
+    entry->len = (uint32_t)len;
+    memcpy(entry->name, name, len);
+    entry->name[len] = '\0';
+    countMayaSelfProfileBytes(len);
+    ::InterlockedExchange((volatile LONG *)&entry->id, (LONG)id);
+
+    // NOTE: (sonictk) Take over the first index slot that is empty or that points at an evicted
+    // name. Evicted names are left in the index until then, so that they don't cut off the names
+    // that were probed past them. If there is no such slot, take over the oldest name's slot.
+    uint32_t oldestSlot = hash & indexMask;
+    uint32_t oldestAge = 0;
+    for (uint32_t i=0; i < MAYA_NAME_TABLE_MAX_PROBES; ++i) {
+        const uint32_t slot = (hash + i) & indexMask;
+        const uint32_t curId = *(volatile uint32_t *)&table->index[slot];
+        if (curId == MAYA_NAME_TABLE_INVALID_ID || !isMayaNameIdLive(curId)) {
+            if ((uint32_t)::InterlockedCompareExchange((volatile LONG *)&table->index[slot], (LONG)id, (LONG)curId) == curId) {
+                return id;
+            }
+            continue;
+        }
+        const uint32_t age = id - curId;
+        if (age > oldestAge) {
+            oldestAge = age;
+            oldestSlot = slot;
+        }
+    }
+    *(volatile uint32_t *)&table->index[oldestSlot] = id;
+
+    return id;
+}
+
+
+bool resolveMayaName(uint32_t id, char *buf, size_t lenBuf)
+{
+    if (lenBuf == 0) {
+        return false;
+    }
+    buf[0] = '\0';
+    if (!isMayaNameIdLive(id)) {
+        return false;
+    }
+    const MayaNameTableEntry *entry = &gMayaNameTable.entries[id & (MAYA_NAME_TABLE_CAPACITY - 1)];
+    size_t len = entry->len < MAYA_NAME_TABLE_NAME_LEN ? entry->len : MAYA_NAME_TABLE_NAME_LEN - 1;
+    len = len < lenBuf - 1 ? len : lenBuf - 1;
+    memcpy(buf, entry->name, len);
+    buf[len] = '\0';
+    MemoryBarrier();
+    if (!isMayaNameIdLive(id)) {
+        buf[0] = '\0';
+        return false;
+    }
+
+    return true;
+}
+
+
+bool getMayaNameTableStream(MINIDUMP_USER_STREAM *stream)
+{
+    // NOTE: (sonictk) Filled in here rather than statically, so that the table stays in .bss.
+    gMayaNameTable.magic = MAYA_NAME_TABLE_MAGIC;
+    gMayaNameTable.version = MAYA_NAME_TABLE_VERSION;
+    gMayaNameTable.capacity = MAYA_NAME_TABLE_CAPACITY;
+    stream->Type = MAYA_NAME_TABLE_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaNameTable);
+    stream->Buffer = &gMayaNameTable;
+
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_NAME_TABLE_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_NAME_TABLE_H
+
+#include "common.h"
+
+/// How many slots of the index to look through for a name before giving up on it.
+#define MAYA_NAME_TABLE_MAX_PROBES 32
+
+
+/**
+ * Looks up a name in the name table, adding it if it isn't in there yet. Safe to call from any
+ * thread; this never blocks and does not allocate any memory. If the table is full, the oldest
+ * name in it is evicted to make room.
+ *
+ * @param name      The name to intern. Only the tail end of it is kept if it is too long.
+ *
+ * @return          The ID of the name, or ``MAYA_NAME_TABLE_INVALID_ID`` if it is empty.
+ */
+uint32_t internMayaName(const char *name);
+
+/**
+ * Copies out the name with the given ID.
+ *
+ * @param id        The ID of the name, as returned by ``internMayaName``.
+ * @param buf       The buffer to copy the name into. Set to an empty string if the name was evicted.
+ * @param lenBuf    The size of the buffer.
+ *
+ * @return          ``true`` if the name is still in the table, ``false`` otherwise.
+ */
+bool resolveMayaName(uint32_t id, char *buf, size_t lenBuf);
+
+/**
+ * Fills in the user stream that the name table is written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; the stream is always written.
+ */
+bool getMayaNameTableStream(MINIDUMP_USER_STREAM *stream);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_NAME_TABLE_H */
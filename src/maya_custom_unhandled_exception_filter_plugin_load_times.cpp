@@ -0,0 +1,380 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_plugin_load_times.cpp
+ * @brief  Records how long each plugin takes to load and unload, and how much memory it takes
+ *         while doing so. Startup regressions are otherwise invisible until someone complains,
+ *         and a crash in the middle of a plugin load shows up in the dump as the load that never
+ *         finished.
+ */
+#include "maya_custom_unhandled_exception_filter_plugin_load_times.h"
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
+
+#include <Psapi.h>
+
+#include <algorithm>
+#include <functional>
+
+#include <maya/MArgDatabase.h>
+
+
+/// The table of load times. This lives in the .bss segment and is written into the crash dump as-is.
+static MayaPluginLoadTimes gMayaPluginLoadTimes = {0};
+
+/// The entries that have been started but not finished yet, innermost last. Only ever touched
+/// from the main thread.
+static int gMayaPluginLoadTimesPending[MAYA_PLUGIN_LOAD_TIMES_MAX_DEPTH] = {0};
+static uint32_t gMayaPluginLoadTimesNumPending = 0;
+
+/// The memory counters at the start of each pending entry.
+static uint64_t gMayaPluginLoadTimesStartPrivateBytes[MAYA_PLUGIN_LOAD_TIMES_MAX_DEPTH] = {0};
+static uint64_t gMayaPluginLoadTimesStartWorkingSet[MAYA_PLUGIN_LOAD_TIMES_MAX_DEPTH] = {0};
+
+
+static void readMayaProcessMemoryCounters(uint64_t *privateBytes, uint64_t *workingSet)
+{
+    PROCESS_MEMORY_COUNTERS_EX procMem = {0};
+    procMem.cb = sizeof(procMem);
+    ::GetProcessMemoryInfo(::GetCurrentProcess(), (PPROCESS_MEMORY_COUNTERS)&procMem, sizeof(procMem));
+    *privateBytes = (uint64_t)procMem.PrivateUsage;
+    *workingSet = (uint64_t)procMem.WorkingSetSize;
+}
+
+
+/// Copies a name into an entry the way ``beginMayaPluginLoadTime`` does, so that names can be compared as stored.
+static inline void copyMayaPluginLoadTimeName(char *dst, const char *src)
+{
+    const size_t lenSrc = strnlen(src, MAYA_PLUGIN_LOAD_TIME_NAME_LEN - 1);
+    memcpy(dst, src, lenSrc);
+    dst[lenSrc] = '\0';
+}
+
+
+void startMayaPluginLoadTimes()
+{
+    LARGE_INTEGER freq;
+    ::QueryPerformanceFrequency(&freq);
+    gMayaPluginLoadTimes.timerFrequency = (uint64_t)freq.QuadPart;
+
+    return;
+}
+
+
+int beginMayaPluginLoadTime(MayaPluginLoadTimeKind kind, const char *name)
+{
+    if (gMayaPluginLoadTimes.numEntries >= MAYA_PLUGIN_LOAD_TIMES_MAX_ENTRIES
+        || gMayaPluginLoadTimesNumPending >= MAYA_PLUGIN_LOAD_TIMES_MAX_DEPTH) {
+        ++gMayaPluginLoadTimes.numDroppedEntries;
+        return -1;
+    }
+
+    const int index = (int)gMayaPluginLoadTimes.numEntries;
+    MayaPluginLoadTime *entry = &gMayaPluginLoadTimes.entries[index];
+    copyMayaPluginLoadTimeName(entry->name, name == NULL ? "" : name);
+    entry->order = (uint32_t)index;
+    entry->kind = (uint8_t)kind;
+    entry->status = MayaPluginLoadTimeStatus_InProgress;
+    entry->depth = (uint16_t)gMayaPluginLoadTimesNumPending;
+    entry->durationTicks = 0;
+    entry->privateBytesDelta = 0;
+    entry->workingSetDelta = 0;
+
+    readMayaProcessMemoryCounters(&gMayaPluginLoadTimesStartPrivateBytes[gMayaPluginLoadTimesNumPending],
+                                  &gMayaPluginLoadTimesStartWorkingSet[gMayaPluginLoadTimesNumPending]);
+    gMayaPluginLoadTimesPending[gMayaPluginLoadTimesNumPending++] = index;
+
+    // NOTE: (sonictk) Take the timestamp last, so that reading the memory counters isn't counted.
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    entry->startTimestamp = (uint64_t)now.QuadPart;
+
+    // NOTE: (sonictk) Publish the entry only once it is complete, so that a crash in the middle of
+    // the load finds it in the dump as being in progress.
+    *(volatile uint32_t *)&gMayaPluginLoadTimes.numEntries = (uint32_t)index + 1;
+
+    return index;
+}
+
+
+void endMayaPluginLoadTime(int index)
+{
+    if (index < 0) {
+        return;
+    }
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+
+    // NOTE: (sonictk) Anything still pending above this entry never finished (e.g. a nested plugin
+    // that failed to load); those are left as in progress.
+    uint32_t level = gMayaPluginLoadTimesNumPending;
+    while (level > 0 && gMayaPluginLoadTimesPending[level - 1] != index) {
+        --level;
+    }
+    if (level == 0) {
+        return;
+    }
+    --level;
+
+    uint64_t privateBytes = 0;
+    uint64_t workingSet = 0;
+    readMayaProcessMemoryCounters(&privateBytes, &workingSet);
+
+    MayaPluginLoadTime *entry = &gMayaPluginLoadTimes.entries[index];
+    entry->durationTicks = (uint64_t)now.QuadPart - entry->startTimestamp;
+    entry->privateBytesDelta = (int64_t)(privateBytes - gMayaPluginLoadTimesStartPrivateBytes[level]);
+    entry->workingSetDelta = (int64_t)(workingSet - gMayaPluginLoadTimesStartWorkingSet[level]);
+    entry->status = MayaPluginLoadTimeStatus_Done;
+
+    gMayaPluginLoadTimesNumPending = level;
+
+    return;
+}
+
+
+bool getMayaPluginLoadTimesStream(MINIDUMP_USER_STREAM *stream)
+{
+    stream->Type = MAYA_PLUGIN_LOAD_TIMES_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaPluginLoadTimes);
+    stream->Buffer = &gMayaPluginLoadTimes;
+
+    return true;
+}
+
+
+/// Finds the innermost pending entry of the given kind and name, or ``-1`` if there is none (e.g.
+/// for our own plugin, whose load started before the callbacks were registered).
+static int findPendingMayaPluginLoadTime(MayaPluginLoadTimeKind kind, const char *name)
+{
+    char storedName[MAYA_PLUGIN_LOAD_TIME_NAME_LEN];
+    copyMayaPluginLoadTimeName(storedName, name);
+    for (uint32_t i=gMayaPluginLoadTimesNumPending; i > 0; --i) {
+        const MayaPluginLoadTime *entry = &gMayaPluginLoadTimes.entries[gMayaPluginLoadTimesPending[i - 1]];
+        if (entry->kind == kind && _stricmp(entry->name, storedName) == 0) {
+            return gMayaPluginLoadTimesPending[i - 1];
+        }
+    }
+
+    return -1;
+}
+
+
+void mayaBeforePluginLoadCB(const MStringArray &strs, void *clientData)
+{
+    (void)clientData;
+    if (strs.length() < 1) {
+        return;
+    }
+
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+
+    // NOTE: (sonictk) Only the path is known at this point; the plugin name that we get after the
+    // load is the file name without its extension, so use that to match them up.
+    char name[MAX_PATH] = {0};
+    const char *path = strs[0].asChar();
+    const char *baseName = path;
+    for (const char *c=path; *c != '\0'; ++c) {
+        if (*c == '/' || *c == '\\') {
+            baseName = c + 1;
+        }
+    }
+    strncpy(name, baseName, sizeof(name) - 1);
+    char *ext = strrchr(name, '.');
+    if (ext != NULL) {
+        *ext = '\0';
+    }
+
+    beginMayaPluginLoadTime(MayaPluginLoadTimeKind_Load, name);
+    endMayaSelfProfile(MayaSelfProfileSite_PluginLoad, &selfProfileScope);
+
+    return;
+}
+
+
+void mayaAfterPluginLoadCB(const MStringArray &strs, void *clientData)
+{
+    (void)clientData;
+    if (strs.length() < 2) {
+        return;
+    }
+
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    endMayaPluginLoadTime(findPendingMayaPluginLoadTime(MayaPluginLoadTimeKind_Load, strs[1].asChar()));
+    endMayaSelfProfile(MayaSelfProfileSite_PluginLoad, &selfProfileScope);
+
+    return;
+}
+
+
+void mayaBeforePluginUnloadCB(const MStringArray &strs, void *clientData)
+{
+    (void)clientData;
+    if (strs.length() < 1) {
+        return;
+    }
+
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    beginMayaPluginLoadTime(MayaPluginLoadTimeKind_Unload, strs[0].asChar());
+    endMayaSelfProfile(MayaSelfProfileSite_PluginLoad, &selfProfileScope);
+
+    return;
+}
+
+
+void mayaAfterPluginUnloadCB(const MStringArray &strs, void *clientData)
+{
+    (void)clientData;
+    if (strs.length() < 1) {
+        return;
+    }
+
+    const MayaSelfProfileScope selfProfileScope = beginMayaSelfProfile();
+    endMayaPluginLoadTime(findPendingMayaPluginLoadTime(MayaPluginLoadTimeKind_Unload, strs[0].asChar()));
+    endMayaSelfProfile(MayaSelfProfileSite_PluginLoad, &selfProfileScope);
+
+    return;
+}
+
+
+void *MayaPluginLoadTimesCmd::creator()
+{
+    MayaPluginLoadTimesCmd *cmd = new MayaPluginLoadTimesCmd();
+
+    cmd->flagHelp = false;
+    cmd->flagUnloads = false;
+    cmd->count = -1;
+
+    return cmd;
+}
+
+
+MSyntax MayaPluginLoadTimesCmd::newSyntax()
+{
+    MSyntax syntax;
+
+    syntax.enableQuery(false);
+    syntax.enableEdit(false);
+    syntax.useSelectionAsDefault(false);
+
+    syntax.addFlag(MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_FLAG_SHORTNAME,
+                   MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_FLAG_NAME);
+
+    syntax.addFlag(MAYA_PLUGIN_LOAD_TIMES_CMD_COUNT_FLAG_SHORTNAME,
+                   MAYA_PLUGIN_LOAD_TIMES_CMD_COUNT_FLAG_NAME,
+                   MSyntax::kLong);
+
+    syntax.addFlag(MAYA_PLUGIN_LOAD_TIMES_CMD_UNLOADS_FLAG_SHORTNAME,
+                   MAYA_PLUGIN_LOAD_TIMES_CMD_UNLOADS_FLAG_NAME);
+
+    return syntax;
+}
+
+
+MStatus MayaPluginLoadTimesCmd::parseArgs(const MArgList &args)
+{
+    MStatus result;
+
+    MArgDatabase argDb(this->syntax(), args, &result);
+    CHECK_MSTATUS_AND_RETURN_IT(result);
+
+    if (argDb.isFlagSet(MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_FLAG_SHORTNAME)) {
+        MGlobal::displayInfo(MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_TEXT);
+        this->flagHelp = true;
+        return MStatus::kSuccess;
+    }
+
+    if (argDb.isFlagSet(MAYA_PLUGIN_LOAD_TIMES_CMD_COUNT_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_PLUGIN_LOAD_TIMES_CMD_COUNT_FLAG_SHORTNAME, 0, this->count);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    this->flagUnloads = argDb.isFlagSet(MAYA_PLUGIN_LOAD_TIMES_CMD_UNLOADS_FLAG_SHORTNAME);
+
+    return result;
+}
+
+
+MStatus MayaPluginLoadTimesCmd::redoIt()
+{
+    static const char *kindNames[] = {"load", "unload", "init"};
+
+    const MayaPluginLoadTimes *data = &gMayaPluginLoadTimes;
+    const double ticksToMs = data->timerFrequency == 0 ? 0.0 : 1000.0 / (double)data->timerFrequency;
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+
+    // NOTE: (sonictk) Only count the outermost loads towards the total, since nested loads are
+    // already included in the plugin that loaded them.
+    std::vector<std::pair<uint64_t, uint32_t> > durations;
+    uint64_t totalLoadTicks = 0;
+    uint64_t selfTicks = 0;
+    uint32_t numLoads = 0;
+    for (uint32_t i=0; i < data->numEntries; ++i) {
+        const MayaPluginLoadTime *entry = &data->entries[i];
+        if (entry->kind == MayaPluginLoadTimeKind_Unload && !this->flagUnloads) {
+            continue;
+        }
+        uint64_t ticks = entry->status == MayaPluginLoadTimeStatus_Done ? entry->durationTicks : (uint64_t)now.QuadPart - entry->startTimestamp;
+        durations.push_back(std::make_pair(ticks, i));
+        if (entry->depth != 0 || entry->kind == MayaPluginLoadTimeKind_Unload) {
+            continue;
+        }
+        totalLoadTicks += ticks;
+        if (entry->kind == MayaPluginLoadTimeKind_Self) {
+            selfTicks += ticks;
+        } else {
+            ++numLoads;
+        }
+    }
+    std::sort(durations.begin(), durations.end(), std::greater<std::pair<uint64_t, uint32_t> >());
+
+    char msg[256] = {0};
+    snprintf(msg, sizeof(msg), "Plugin load times: %u plugins loaded in %.3f ms, %.3f ms of it initializing this plugin (%u entries dropped).",
+             numLoads, totalLoadTicks * ticksToMs, selfTicks * ticksToMs, data->numDroppedEntries);
+    MGlobal::displayInfo(msg);
+
+    uint32_t numToPrint = this->count < 0 ? (uint32_t)durations.size() : (uint32_t)this->count;
+    if (numToPrint > durations.size()) {
+        numToPrint = (uint32_t)durations.size();
+    }
+    for (uint32_t i=0; i < numToPrint; ++i) {
+        const MayaPluginLoadTime *entry = &data->entries[durations[i].second];
+        snprintf(msg, sizeof(msg), "#%u: %-40s %10.3f ms %+9.1f MB committed %+9.1f MB working set (%s #%u, depth %u)%s",
+                 i, entry->name, durations[i].first * ticksToMs,
+                 entry->privateBytesDelta / (1024.0 * 1024.0),
+                 entry->workingSetDelta / (1024.0 * 1024.0),
+                 entry->kind < (ARRAY_SIZE(kindNames)) ? kindNames[entry->kind] : "?", entry->order, entry->depth,
+                 entry->status == MayaPluginLoadTimeStatus_Done ? "" : " did not finish");
+        MGlobal::displayInfo(msg);
+    }
+
+    this->setResult(totalLoadTicks * ticksToMs);
+
+    return MStatus::kSuccess;
+}
+
+
+MStatus MayaPluginLoadTimesCmd::doIt(const MArgList &args)
+{
+    this->clearResult();
+
+    MStatus stat = this->parseArgs(args);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
+
+    if (this->flagHelp == true) {
+        return MStatus::kSuccess;
+    }
+
+    return this->redoIt();
+}
+
+
+MStatus MayaPluginLoadTimesCmd::undoIt()
+{
+    return MStatus::kSuccess;
+}
+
+
+bool MayaPluginLoadTimesCmd::isUndoable() const
+{
+    return false;
+}
@@ -0,0 +1,132 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_PLUGIN_LOAD_TIMES_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_PLUGIN_LOAD_TIMES_H
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgList.h>
+#include <maya/MStringArray.h>
+
+#include "common.h"
+
+/// Loads that are nested deeper than this (i.e. plugins loading plugins loading plugins...) are not recorded.
+#define MAYA_PLUGIN_LOAD_TIMES_MAX_DEPTH 16
+
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_NAME "mayaPluginLoadTimes"
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_FLAG_SHORTNAME "-h"
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_FLAG_NAME "-help"
+
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_COUNT_FLAG_SHORTNAME "-n"
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_COUNT_FLAG_NAME "-count"
+
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_UNLOADS_FLAG_SHORTNAME "-u"
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_UNLOADS_FLAG_NAME "-unloads"
+
+#define MAYA_PLUGIN_LOAD_TIMES_CMD_HELP_TEXT "Prints how long each plugin took to load, slowest first, along with the memory " \
+    "it committed while loading and the order it was loaded in. The cost of this plugin's own initialization is included. " \
+    "Use -count to limit the number of plugins printed, and -unloads to include plugin unloads as well. " \
+    "Returns the total time spent loading plugins, in milliseconds."
+
+
+/**
+ * Starts recording plugin load times. Must be called from the main thread, before any of the
+ * other functions below.
+ */
+void startMayaPluginLoadTimes();
+
+/**
+ * Starts timing a load, unload, or a phase of our own initialization.
+ *
+ * @param kind      One of ``MayaPluginLoadTimeKind``.
+ * @param name      The name of the plugin (or phase). Truncated if it is too long.
+ *
+ * @return          The index of the entry to pass to ``endMayaPluginLoadTime``, or ``-1`` if
+ *                  the table is full.
+ */
+int beginMayaPluginLoadTime(MayaPluginLoadTimeKind kind, const char *name);
+
+/**
+ * Finishes timing an entry started with ``beginMayaPluginLoadTime``.
+ *
+ * @param index     The index returned by ``beginMayaPluginLoadTime``. Does nothing if ``-1``.
+ */
+void endMayaPluginLoadTime(int index);
+
+/**
+ * Fills in the user stream that the plugin load times are written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; the stream is always written.
+ */
+bool getMayaPluginLoadTimesStream(MINIDUMP_USER_STREAM *stream);
+
+/// Callbacks for ``MSceneMessage::addStringArrayCallback`` on the plugin load/unload messages.
+void mayaBeforePluginLoadCB(const MStringArray &strs, void *clientData);
+void mayaAfterPluginLoadCB(const MStringArray &strs, void *clientData);
+void mayaBeforePluginUnloadCB(const MStringArray &strs, void *clientData);
+void mayaAfterPluginUnloadCB(const MStringArray &strs, void *clientData);
+
+
+struct MayaPluginLoadTimesCmd : public MPxCommand
+{
+    /**
+     * Creates a new instance of the command. Used for Maya plugin registration.
+     *
+     * @return  A pointer to the new instance.
+     */
+    static void *creator();
+
+    /**
+     * This function parses the arguments that were given to the command and stores
+     * it in local class data. It finally calls ``redoIt`` to implement the actual
+     * command functionality.
+     *
+     * @param args  The arguments that were passed to the command.
+     * @return      The status code.
+     */
+    MStatus doIt(const MArgList &args);
+
+    /**
+     * Prints the plugin load times, slowest first.
+     *
+     * @return      The status code.
+     */
+    MStatus redoIt();
+
+    /**
+     * This command does not modify the scene, so there is nothing to undo.
+     *
+     * @return      The status code.
+     */
+    MStatus undoIt();
+
+    /**
+     * This function specifies that the command is not undoable in Maya.
+     *
+     * @return  ``false``, as this command is not undoable.
+     */
+    bool isUndoable() const;
+
+    /**
+     * This static function returns the syntax object for this command.
+     *
+     * @return The syntax object set up for this command.
+     */
+    static MSyntax newSyntax();
+
+    /**
+     * This function parses the given arguments to the command and stores the
+     * results in local class data.
+     *
+     * @param args      The arguments that were passed to the command.
+     * @return          The status code.
+     */
+    MStatus parseArgs(const MArgList &args);
+
+    bool flagHelp;
+    bool flagUnloads;
+    int count;
+};
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_PLUGIN_LOAD_TIMES_H */
@@ -0,0 +1,489 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_profiler.cpp
+ * @brief  An always-on, low-rate sampling profiler of the Maya main thread. When a session
+ *         crashes after minutes of degraded performance, the history of what the main thread
+ *         was busy with ends up in the crash dump.
+ */
+#include "maya_custom_unhandled_exception_filter_profiler.h"
+#include "maya_custom_unhandled_exception_filter_stackwalk.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <maya/MArgDatabase.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif // CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+
+
+/// Everything the profiler records. This lives in the .bss segment and is written into the crash dump as-is.
+static MayaProfilerData gMayaProfilerData = {0};
+
+/// Maps stack hashes to entries in the stack table. Each slot holds the stack table index + 1, or
+/// ``0`` if it is empty. Only ever touched by the profiler thread.
+static uint16_t gMayaProfilerStackIndex[MAYA_PROFILER_STACK_INDEX_TABLE_SIZE] = {0};
+
+static HANDLE gMayaProfilerThread = NULL;
+static HANDLE gMayaProfilerStopEvent = NULL;
+static HANDLE gMayaProfilerMainThread = NULL;
+static ULONG64 gMayaProfilerMainThreadStackBase = 0;
+static PBYTE gMayaProfilerStackCopy = NULL;
+
+static volatile LONG gMayaProfilerRateHz = MAYA_PROFILER_DEFAULT_RATE_HZ;
+
+/// Total time spent taking samples, so that we can report the overhead of the profiler.
+static volatile LONG64 gMayaProfilerOverheadTicks = 0;
+static LARGE_INTEGER gMayaProfilerStartTime = {0};
+
+
+static inline uint64_t hashMayaStack(const uint64_t *frames, uint32_t numFrames)
+{
+    // NOTE: (sonictk) FNV-1a over the frame addresses.
+    uint64_t hash = 14695981039346656037ULL;
+    const uint8_t *bytes = (const uint8_t *)frames;
+    for (size_t i=0; i < numFrames * sizeof(uint64_t); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/// Finds the entry in the stack table for the given stack, adding it if it hasn't been seen before.
+/// Returns ``(uint32_t)-1`` if the stack table is full.
+static uint32_t findOrAddMayaProfilerStack(const uint64_t *frames, uint32_t numFrames)
+{
+    MayaProfilerData *data = &gMayaProfilerData;
+    uint64_t hash = hashMayaStack(frames, numFrames);
+
+    uint32_t slot = (uint32_t)hash & (MAYA_PROFILER_STACK_INDEX_TABLE_SIZE - 1);
+    for (uint32_t probe=0; probe < MAYA_PROFILER_STACK_INDEX_TABLE_SIZE; ++probe) {
+        uint16_t entry = gMayaProfilerStackIndex[slot];
+        if (entry == 0) {
+            break;
+        }
+        MayaProfilerStack *stack = &data->stacks[entry - 1];
+        if (stack->hash == hash && stack->numFrames == numFrames) {
+            return entry - 1;
+        }
+        slot = (slot + 1) & (MAYA_PROFILER_STACK_INDEX_TABLE_SIZE - 1);
+    }
+
+    if (data->numUniqueStacks >= MAYA_PROFILER_MAX_UNIQUE_STACKS) {
+        return (uint32_t)-1;
+    }
+
+    uint32_t stackIdx = data->numUniqueStacks;
+    MayaProfilerStack *stack = &data->stacks[stackIdx];
+    stack->hash = hash;
+    stack->count = 0;
+    stack->numFrames = numFrames;
+    memcpy(stack->frames, frames, numFrames * sizeof(uint64_t));
+    ::MemoryBarrier();
+    data->numUniqueStacks = stackIdx + 1;
+    gMayaProfilerStackIndex[slot] = (uint16_t)(stackIdx + 1);
+
+    return stackIdx;
+}
+
+
+/// Rewrites a value that points into the original stack so that it points into our copy instead.
+static inline ULONG64 rebaseMayaStackPointer(ULONG64 val, ULONG64 origLow, ULONG64 origHigh, ULONG64 copyLow)
+{
+    if (val >= origLow && val < origHigh) {
+        return val - origLow + copyLow;
+    }
+
+    return val;
+}
+
+
+static void sampleMayaMainThread()
+{
+    MayaProfilerData *data = &gMayaProfilerData;
+
+    CONTEXT ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.ContextFlags = CONTEXT_CONTROL|CONTEXT_INTEGER;
+
+    // NOTE: (sonictk) While the main thread is suspended, we must not do anything that could
+    // take a lock (allocating memory, looking up unwind info, etc.), since the main thread could
+    // be holding it. So all we do here is grab its registers and copy its stack; the actual
+    // unwinding happens on the copy once the main thread is running again.
+    if (::SuspendThread(gMayaProfilerMainThread) == (DWORD)-1) {
+        return;
+    }
+    if (!::GetThreadContext(gMayaProfilerMainThread, &ctx)) {
+        ::ResumeThread(gMayaProfilerMainThread);
+        return;
+    }
+    ULONG64 origLow = ctx.Rsp;
+    ULONG64 origHigh = gMayaProfilerMainThreadStackBase;
+    if (origLow >= origHigh || origHigh - origLow > 0x40000000) {
+        // NOTE: (sonictk) Not on its usual stack (e.g. running a fiber); nothing sensible to record.
+        ::ResumeThread(gMayaProfilerMainThread);
+        return;
+    }
+    SIZE_T copySize = (SIZE_T)(origHigh - origLow);
+    if (copySize > MAYA_PROFILER_MAX_STACK_COPY_BYTES) {
+        copySize = MAYA_PROFILER_MAX_STACK_COPY_BYTES;
+    }
+    memcpy(gMayaProfilerStackCopy, (const void *)origLow, copySize);
+    ::ResumeThread(gMayaProfilerMainThread);
+
+    // NOTE: (sonictk) Frame pointers and saved registers in the copy still point into the original
+    // stack, so they need to be fixed up before we can unwind through the copy.
+    ULONG64 copyLow = (ULONG64)gMayaProfilerStackCopy;
+    origHigh = origLow + copySize;
+    ULONG64 *pWord = (ULONG64 *)gMayaProfilerStackCopy;
+    for (SIZE_T i=0; i < copySize / sizeof(ULONG64); ++i) {
+        pWord[i] = rebaseMayaStackPointer(pWord[i], origLow, origHigh, copyLow);
+    }
+    ctx.Rsp = rebaseMayaStackPointer(ctx.Rsp, origLow, origHigh, copyLow);
+    ctx.Rbp = rebaseMayaStackPointer(ctx.Rbp, origLow, origHigh, copyLow);
+    ctx.Rbx = rebaseMayaStackPointer(ctx.Rbx, origLow, origHigh, copyLow);
+    ctx.Rsi = rebaseMayaStackPointer(ctx.Rsi, origLow, origHigh, copyLow);
+    ctx.Rdi = rebaseMayaStackPointer(ctx.Rdi, origLow, origHigh, copyLow);
+    ctx.R12 = rebaseMayaStackPointer(ctx.R12, origLow, origHigh, copyLow);
+    ctx.R13 = rebaseMayaStackPointer(ctx.R13, origLow, origHigh, copyLow);
+    ctx.R14 = rebaseMayaStackPointer(ctx.R14, origLow, origHigh, copyLow);
+    ctx.R15 = rebaseMayaStackPointer(ctx.R15, origLow, origHigh, copyLow);
+
+    uint64_t frames[MAYA_PROFILER_MAX_FRAMES];
+    uint32_t numFrames = walkMayaStack(&ctx, copyLow, copyLow + copySize, frames, MAYA_PROFILER_MAX_FRAMES);
+    if (numFrames == 0) {
+        return;
+    }
+
+    uint32_t stackIdx = findOrAddMayaProfilerStack(frames, numFrames);
+    if (stackIdx == (uint32_t)-1) {
+        ++data->numDroppedSamples;
+        return;
+    }
+    ++data->stacks[stackIdx].count;
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    uint32_t numWritten = data->numSamplesWritten;
+    MayaProfilerSample *sample = &data->samples[numWritten % MAYA_PROFILER_SAMPLE_RING_CAPACITY];
+    sample->timestamp = (uint64_t)now.QuadPart;
+    sample->stackIdx = stackIdx;
+    ::MemoryBarrier();
+    data->numSamplesWritten = numWritten + 1;
+}
+
+
+static DWORD WINAPI mayaProfilerThreadProc(LPVOID unused)
+{
+    (void)unused;
+
+    // NOTE: (sonictk) The default timer resolution is ~15.6 ms, which is too coarse for 100 Hz.
+    HANDLE hTimer = ::CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (hTimer == NULL) {
+        hTimer = ::CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+        if (hTimer == NULL) {
+            return 1;
+        }
+    }
+
+    HANDLE waitHandles[] = {gMayaProfilerStopEvent, hTimer};
+    for (;;) {
+        LONG rateHz = gMayaProfilerRateHz;
+        gMayaProfilerData.sampleRateHz = (uint32_t)rateHz;
+
+        // NOTE: (sonictk) Relative due times are negative, in 100 ns units.
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = rateHz > 0 ? -(10000000LL / rateHz) : -10000000LL;
+        ::SetWaitableTimer(hTimer, &dueTime, 0, NULL, NULL, FALSE);
+
+        DWORD waitResult = ::WaitForMultipleObjects((DWORD)ARRAY_SIZE(waitHandles), waitHandles, FALSE, INFINITE);
+        if (waitResult != WAIT_OBJECT_0 + 1) {
+            break;
+        }
+        if (rateHz <= 0) {
+            continue;
+        }
+
+        LARGE_INTEGER sampleStart;
+        LARGE_INTEGER sampleEnd;
+        ::QueryPerformanceCounter(&sampleStart);
+        sampleMayaMainThread();
+        ::QueryPerformanceCounter(&sampleEnd);
+        gMayaProfilerOverheadTicks += sampleEnd.QuadPart - sampleStart.QuadPart;
+    }
+
+    ::CloseHandle(hTimer);
+
+    return 0;
+}
+
+
+bool startMayaProfiler(unsigned int rateHz)
+{
+    if (gMayaProfilerThread != NULL) {
+        return true;
+    }
+
+    if (rateHz > MAYA_PROFILER_MAX_RATE_HZ) {
+        rateHz = MAYA_PROFILER_MAX_RATE_HZ;
+    }
+    gMayaProfilerRateHz = (LONG)rateHz;
+
+    LARGE_INTEGER freq;
+    ::QueryPerformanceFrequency(&freq);
+    ::QueryPerformanceCounter(&gMayaProfilerStartTime);
+    gMayaProfilerData.timerFrequency = (uint64_t)freq.QuadPart;
+    gMayaProfilerData.sampleRateHz = rateHz;
+    gMayaProfilerData.mainThreadId = ::GetCurrentThreadId();
+
+    // NOTE: (sonictk) We're running on the main thread right now, so this is its stack.
+    gMayaProfilerMainThreadStackBase = (ULONG64)((NT_TIB *)::NtCurrentTeb())->StackBase;
+
+    gMayaProfilerStackCopy = (PBYTE)::VirtualAlloc(NULL, MAYA_PROFILER_MAX_STACK_COPY_BYTES, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if (gMayaProfilerStackCopy == NULL) {
+        return false;
+    }
+
+    gMayaProfilerMainThread = ::OpenThread(THREAD_SUSPEND_RESUME|THREAD_GET_CONTEXT|THREAD_QUERY_INFORMATION, FALSE, ::GetCurrentThreadId());
+    gMayaProfilerStopEvent = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (gMayaProfilerMainThread != NULL && gMayaProfilerStopEvent != NULL) {
+        gMayaProfilerThread = ::CreateThread(NULL, 0, mayaProfilerThreadProc, NULL, CREATE_SUSPENDED, NULL);
+    }
+    if (gMayaProfilerThread == NULL) {
+        if (gMayaProfilerMainThread != NULL) {
+            ::CloseHandle(gMayaProfilerMainThread);
+            gMayaProfilerMainThread = NULL;
+        }
+        if (gMayaProfilerStopEvent != NULL) {
+            ::CloseHandle(gMayaProfilerStopEvent);
+            gMayaProfilerStopEvent = NULL;
+        }
+        ::VirtualFree(gMayaProfilerStackCopy, 0, MEM_RELEASE);
+        gMayaProfilerStackCopy = NULL;
+        return false;
+    }
+
+    // NOTE: (sonictk) The samples are most interesting precisely when the machine is busy, so make
+    // sure the profiler thread doesn't get starved. It spends nearly all of its time waiting anyway.
+    ::SetThreadPriority(gMayaProfilerThread, THREAD_PRIORITY_ABOVE_NORMAL);
+    ::ResumeThread(gMayaProfilerThread);
+
+    return true;
+}
+
+
+void stopMayaProfiler()
+{
+    if (gMayaProfilerThread == NULL) {
+        return;
+    }
+
+    ::SetEvent(gMayaProfilerStopEvent);
+    ::WaitForSingleObject(gMayaProfilerThread, INFINITE);
+
+    ::CloseHandle(gMayaProfilerThread);
+    ::CloseHandle(gMayaProfilerStopEvent);
+    ::CloseHandle(gMayaProfilerMainThread);
+    ::VirtualFree(gMayaProfilerStackCopy, 0, MEM_RELEASE);
+    gMayaProfilerThread = NULL;
+    gMayaProfilerStopEvent = NULL;
+    gMayaProfilerMainThread = NULL;
+    gMayaProfilerStackCopy = NULL;
+}
+
+
+bool getMayaProfilerStacksStream(MINIDUMP_USER_STREAM *stream)
+{
+    stream->Type = MAYA_PROFILER_STACKS_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaProfilerData);
+    stream->Buffer = &gMayaProfilerData;
+
+    return true;
+}
+
+
+/// Formats the given code address as ``module+offset``, which can be symbolized offline.
+static void formatMayaFrameAddress(uint64_t addr, char *buf, size_t lenBuf)
+{
+    HMODULE hMod = NULL;
+    if (::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS|GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR)addr, &hMod)) {
+        char modPath[MAX_PATH] = {0};
+        ::GetModuleFileNameA(hMod, modPath, MAX_PATH);
+        const char *modName = strrchr(modPath, '\\');
+        modName = modName == NULL ? modPath : modName + 1;
+        snprintf(buf, lenBuf, "%s+0x%llx", modName, addr - (uint64_t)hMod);
+    } else {
+        snprintf(buf, lenBuf, "0x%llx", addr);
+    }
+}
+
+
+void *MayaProfilerStacksCmd::creator()
+{
+    MayaProfilerStacksCmd *cmd = new MayaProfilerStacksCmd();
+
+    cmd->flagHelp = false;
+    cmd->count = MAYA_PROFILER_STACKS_CMD_DEFAULT_COUNT;
+    cmd->rateHz = -1;
+
+    return cmd;
+}
+
+
+MSyntax MayaProfilerStacksCmd::newSyntax()
+{
+    MSyntax syntax;
+
+    syntax.enableQuery(false);
+    syntax.enableEdit(false);
+    syntax.useSelectionAsDefault(false);
+
+    syntax.addFlag(MAYA_PROFILER_STACKS_CMD_HELP_FLAG_SHORTNAME,
+                   MAYA_PROFILER_STACKS_CMD_HELP_FLAG_NAME);
+
+    syntax.addFlag(MAYA_PROFILER_STACKS_CMD_COUNT_FLAG_SHORTNAME,
+                   MAYA_PROFILER_STACKS_CMD_COUNT_FLAG_NAME,
+                   MSyntax::kLong);
+
+    syntax.addFlag(MAYA_PROFILER_STACKS_CMD_FILE_FLAG_SHORTNAME,
+                   MAYA_PROFILER_STACKS_CMD_FILE_FLAG_NAME,
+                   MSyntax::kString);
+
+    syntax.addFlag(MAYA_PROFILER_STACKS_CMD_RATE_FLAG_SHORTNAME,
+                   MAYA_PROFILER_STACKS_CMD_RATE_FLAG_NAME,
+                   MSyntax::kLong);
+
+    return syntax;
+}
+
+
+MStatus MayaProfilerStacksCmd::parseArgs(const MArgList &args)
+{
+    MStatus result;
+
+    MArgDatabase argDb(this->syntax(), args, &result);
+    CHECK_MSTATUS_AND_RETURN_IT(result);
+
+    if (argDb.isFlagSet(MAYA_PROFILER_STACKS_CMD_HELP_FLAG_SHORTNAME)) {
+        MGlobal::displayInfo(MAYA_PROFILER_STACKS_CMD_HELP_TEXT);
+        this->flagHelp = true;
+        return MStatus::kSuccess;
+    }
+
+    if (argDb.isFlagSet(MAYA_PROFILER_STACKS_CMD_COUNT_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_PROFILER_STACKS_CMD_COUNT_FLAG_SHORTNAME, 0, this->count);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    if (argDb.isFlagSet(MAYA_PROFILER_STACKS_CMD_FILE_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_PROFILER_STACKS_CMD_FILE_FLAG_SHORTNAME, 0, this->filePath);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    if (argDb.isFlagSet(MAYA_PROFILER_STACKS_CMD_RATE_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_PROFILER_STACKS_CMD_RATE_FLAG_SHORTNAME, 0, this->rateHz);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    return result;
+}
+
+
+MStatus MayaProfilerStacksCmd::redoIt()
+{
+    if (this->rateHz >= 0) {
+        int rateHz = this->rateHz > MAYA_PROFILER_MAX_RATE_HZ ? MAYA_PROFILER_MAX_RATE_HZ : this->rateHz;
+        ::InterlockedExchange(&gMayaProfilerRateHz, (LONG)rateHz);
+    }
+
+    const MayaProfilerData *data = &gMayaProfilerData;
+    uint32_t numStacks = data->numUniqueStacks;
+    ::MemoryBarrier();
+
+    // NOTE: (sonictk) The counts keep changing underneath us; take a copy so that the sort is stable.
+    std::vector<std::pair<uint32_t, uint32_t> > stackCounts(numStacks);
+    uint64_t totalCount = 0;
+    for (uint32_t i=0; i < numStacks; ++i) {
+        stackCounts[i] = std::make_pair(data->stacks[i].count, i);
+        totalCount += data->stacks[i].count;
+    }
+    std::sort(stackCounts.begin(), stackCounts.end(), std::greater<std::pair<uint32_t, uint32_t> >());
+
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    double elapsedTicks = (double)(now.QuadPart - gMayaProfilerStartTime.QuadPart);
+    double overheadPct = elapsedTicks > 0.0 ? 100.0 * (double)gMayaProfilerOverheadTicks / elapsedTicks : 0.0;
+    char msg[256] = {0};
+    snprintf(msg, sizeof(msg), "Profiler: %llu samples in %u unique stacks (%u dropped) at %u Hz, overhead %.3f%% of one core.",
+             totalCount, numStacks, data->numDroppedSamples, data->sampleRateHz, overheadPct);
+    MGlobal::displayInfo(msg);
+
+    char frameBuf[MAX_PATH + 32] = {0};
+    if (this->filePath.length() > 0) {
+        FILE *f = fopen(this->filePath.asChar(), "w");
+        if (f == NULL) {
+            MGlobal::displayError("Could not open the file requested for writing.");
+            return MStatus::kFailure;
+        }
+        // NOTE: (sonictk) Folded stacks are written outermost frame first, one unique stack per line.
+        for (uint32_t i=0; i < numStacks; ++i) {
+            const MayaProfilerStack *stack = &data->stacks[stackCounts[i].second];
+            for (uint32_t j=stack->numFrames; j > 0; --j) {
+                formatMayaFrameAddress(stack->frames[j - 1], frameBuf, sizeof(frameBuf));
+                fputs(frameBuf, f);
+                fputc(j > 1 ? ';' : ' ', f);
+            }
+            fprintf(f, "%u\n", stackCounts[i].first);
+        }
+        fclose(f);
+        this->setResult(this->filePath);
+        return MStatus::kSuccess;
+    }
+
+    uint32_t numToPrint = this->count < 0 ? 0 : (uint32_t)this->count;
+    if (numToPrint > numStacks) {
+        numToPrint = numStacks;
+    }
+    for (uint32_t i=0; i < numToPrint; ++i) {
+        const MayaProfilerStack *stack = &data->stacks[stackCounts[i].second];
+        double pct = totalCount == 0 ? 0.0 : 100.0 * stackCounts[i].first / (double)totalCount;
+        snprintf(msg, sizeof(msg), "#%u: %u samples (%.1f%%)", i, stackCounts[i].first, pct);
+        MGlobal::displayInfo(msg);
+        for (uint32_t j=0; j < stack->numFrames; ++j) {
+            formatMayaFrameAddress(stack->frames[j], frameBuf, sizeof(frameBuf));
+            snprintf(msg, sizeof(msg), "    %s", frameBuf);
+            MGlobal::displayInfo(msg);
+        }
+    }
+
+    return MStatus::kSuccess;
+}
+
+
+MStatus MayaProfilerStacksCmd::doIt(const MArgList &args)
+{
+    this->clearResult();
+
+    MStatus stat = this->parseArgs(args);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
+
+    if (this->flagHelp == true) {
+        return MStatus::kSuccess;
+    }
+
+    return this->redoIt();
+}
+
+
+MStatus MayaProfilerStacksCmd::undoIt()
+{
+    return MStatus::kSuccess;
+}
+
+
+bool MayaProfilerStacksCmd::isUndoable() const
+{
+    return false;
+}
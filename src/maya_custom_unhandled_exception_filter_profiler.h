@@ -0,0 +1,132 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_PROFILER_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_PROFILER_H
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgList.h>
+#include <maya/MString.h>
+
+#include "common.h"
+
+/// Rate at which the main thread is sampled. Set to ``0`` to disable the profiler entirely.
+#define MAYA_PROFILER_RATE_ENV_VAR_NAME "MAYA_CRASH_PROFILER_HZ"
+#define MAYA_PROFILER_DEFAULT_RATE_HZ 100
+#define MAYA_PROFILER_MAX_RATE_HZ 1000
+
+/// The main thread's stack is copied out while it is suspended, and unwound from the copy after
+/// it has been resumed. Stacks deeper than this are truncated.
+#define MAYA_PROFILER_MAX_STACK_COPY_BYTES (512 * 1024)
+
+/// Size of the open-addressing table used to find the stack table entry for a given stack hash.
+/// Must be a power of two and larger than ``MAYA_PROFILER_MAX_UNIQUE_STACKS``.
+#define MAYA_PROFILER_STACK_INDEX_TABLE_SIZE 2048
+
+#define MAYA_PROFILER_STACKS_CMD_NAME "mayaProfilerStacks"
+#define MAYA_PROFILER_STACKS_CMD_HELP_FLAG_SHORTNAME "-h"
+#define MAYA_PROFILER_STACKS_CMD_HELP_FLAG_NAME "-help"
+
+#define MAYA_PROFILER_STACKS_CMD_COUNT_FLAG_SHORTNAME "-n"
+#define MAYA_PROFILER_STACKS_CMD_COUNT_FLAG_NAME "-count"
+
+#define MAYA_PROFILER_STACKS_CMD_FILE_FLAG_SHORTNAME "-f"
+#define MAYA_PROFILER_STACKS_CMD_FILE_FLAG_NAME "-file"
+
+#define MAYA_PROFILER_STACKS_CMD_RATE_FLAG_SHORTNAME "-r"
+#define MAYA_PROFILER_STACKS_CMD_RATE_FLAG_NAME "-rate"
+
+#define MAYA_PROFILER_STACKS_CMD_DEFAULT_COUNT 10
+
+#define MAYA_PROFILER_STACKS_CMD_HELP_TEXT "Prints the call stacks of the main thread most often seen by the sampling profiler. " \
+    "Use -count to limit the number of stacks printed, -file to write all stacks out in the folded format used by flamegraph tools, " \
+    "and -rate to change the sampling rate (in Hz)."
+
+
+/**
+ * Starts the thread that periodically samples the call stack of the main thread. Must be called
+ * from the main thread.
+ *
+ * @param rateHz    The number of samples to take per second.
+ *
+ * @return          ``true`` if the profiler was started successfully, ``false`` otherwise.
+ */
+bool startMayaProfiler(unsigned int rateHz);
+
+/**
+ * Signals the profiler thread to stop and waits for it to exit.
+ */
+void stopMayaProfiler();
+
+/**
+ * Fills in the user stream that the sampled stacks are written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; the stacks are written even if the profiler is disabled.
+ */
+bool getMayaProfilerStacksStream(MINIDUMP_USER_STREAM *stream);
+
+
+struct MayaProfilerStacksCmd : public MPxCommand
+{
+    /**
+     * Creates a new instance of the command. Used for Maya plugin registration.
+     *
+     * @return  A pointer to the new instance.
+     */
+    static void *creator();
+
+    /**
+     * This function parses the arguments that were given to the command and stores
+     * it in local class data. It finally calls ``redoIt`` to implement the actual
+     * command functionality.
+     *
+     * @param args  The arguments that were passed to the command.
+     * @return      The status code.
+     */
+    MStatus doIt(const MArgList &args);
+
+    /**
+     * Prints the top stacks, or writes all of them to a file in the folded stack format.
+     *
+     * @return      The status code.
+     */
+    MStatus redoIt();
+
+    /**
+     * This command does not modify the scene, so there is nothing to undo.
+     *
+     * @return      The status code.
+     */
+    MStatus undoIt();
+
+    /**
+     * This function specifies that the command is not undoable in Maya.
+     *
+     * @return  ``false``, as this command is not undoable.
+     */
+    bool isUndoable() const;
+
+    /**
+     * This static function returns the syntax object for this command.
+     *
+     * @return The syntax object set up for this command.
+     */
+    static MSyntax newSyntax();
+
+    /**
+     * This function parses the given arguments to the command and stores the
+     * results in local class data.
+     *
+     * @param args      The arguments that were passed to the command.
+     * @return          The status code.
+     */
+    MStatus parseArgs(const MArgList &args);
+
+    bool flagHelp;
+    int count;
+    int rateHz;
+    MString filePath;
+};
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_PROFILER_H */
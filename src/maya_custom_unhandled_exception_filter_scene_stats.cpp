@@ -0,0 +1,331 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_scene_stats.cpp
+ * @brief  Keeps count of the nodes in the scene, by type, as they are added and removed. How big
+ *         the scene was says a lot about a crash, but the DG can't be walked while crashing, and
+ *         walking it any other time is too slow to do routinely.
+ */
+#include "maya_custom_unhandled_exception_filter_scene_stats.h"
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <maya/MArgDatabase.h>
+#include <maya/MFileIO.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MItDependencyNodes.h>
+
+
+/// The node counts. This lives in the .bss segment and is written into the crash dump as-is.
+static MayaSceneStats gMayaSceneStats = {0};
+
+/// Which totals each function set counts towards, in the same order as ``MayaSceneStatsTotal``.
+static const MFn::Type gMayaSceneStatsTotalFnTypes[MayaSceneStatsTotal_Count] = {
+    MFn::kDependencyNode,
+    MFn::kDagNode,
+    MFn::kTransform,
+    MFn::kShape,
+    MFn::kMesh,
+    MFn::kJoint,
+    MFn::kCamera,
+    MFn::kLight,
+    MFn::kReference
+};
+
+static const char *gMayaSceneStatsTotalNames[MayaSceneStatsTotal_Count] = {
+    "nodes", "DAG nodes", "transforms", "shapes", "meshes", "joints", "cameras", "lights", "references"
+};
+
+
+/// Finds the entry for the given node type, adding it if it isn't in there yet. Returns ``NULL``
+/// if the table is full.
+static MayaSceneStatsType *findOrAddMayaSceneStatsType(uint32_t typeId, const MFnDependencyNode &fnNode)
+{
+    if (typeId == 0) {
+        return NULL;
+    }
+    MayaSceneStats *stats = &gMayaSceneStats;
+    const uint32_t mask = MAYA_SCENE_STATS_MAX_TYPES - 1;
+    const uint32_t hash = typeId * 2654435761U;
+    for (uint32_t i=0; i < MAYA_SCENE_STATS_MAX_PROBES; ++i) {
+        MayaSceneStatsType *entry = &stats->types[(hash + i) & mask];
+        const uint32_t curTypeId = *(volatile uint32_t *)&entry->typeId;
+        if (curTypeId == typeId) {
+            return entry;
+        }
+        if (curTypeId != 0) {
+            continue;
+        }
+        const uint32_t prevTypeId = (uint32_t)::InterlockedCompareExchange((volatile LONG *)&entry->typeId, (LONG)typeId, 0);
+        if (prevTypeId == 0) {
+            // NOTE: (sonictk) Only the first node of each type pays for getting its name.
+            const MString typeName = fnNode.typeName();
+            const size_t lenTypeName = strnlen(typeName.asChar(), MAYA_SCENE_STATS_TYPE_NAME_LEN - 1);
+            memcpy(entry->typeName, typeName.asChar(), lenTypeName);
+            entry->typeName[lenTypeName] = '\0';
+            countMayaSelfProfileBytes(lenTypeName);
+            ::InterlockedIncrementNoFence((volatile LONG *)&stats->numTypes);
+            return entry;
+        }
+        if (prevTypeId == typeId) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+
+/// Adds ``delta`` to the counts that the node counts towards.
+static void addMayaSceneNodeCount(MObject &node, LONG delta)
+{
+    MStatus mstat;
+    MFnDependencyNode fnNode(node, &mstat);
+    if (mstat != MStatus::kSuccess) {
+        return;
+    }
+
+    MayaSceneStats *stats = &gMayaSceneStats;
+    MayaSceneStatsType *entry = findOrAddMayaSceneStatsType(fnNode.typeId().id(), fnNode);
+    ::InterlockedExchangeAddNoFence(entry == NULL ? (volatile LONG *)&stats->numUntypedNodes : (volatile LONG *)&entry->count, delta);
+
+    for (int i=0; i < MayaSceneStatsTotal_Count; ++i) {
+        if (node.hasFn(gMayaSceneStatsTotalFnTypes[i])) {
+            ::InterlockedExchangeAddNoFence((volatile LONG *)&stats->totals[i], delta);
+        }
+    }
+
+    return;
+}
+
+
+/// Zeroes the counts, leaving the types in place.
+static void clearMayaSceneStatsCounts()
+{
+    MayaSceneStats *stats = &gMayaSceneStats;
+    for (uint32_t i=0; i < MAYA_SCENE_STATS_MAX_TYPES; ++i) {
+        ::InterlockedExchange((volatile LONG *)&stats->types[i].count, 0);
+    }
+    for (int i=0; i < MayaSceneStatsTotal_Count; ++i) {
+        ::InterlockedExchange((volatile LONG *)&stats->totals[i], 0);
+    }
+    ::InterlockedExchange((volatile LONG *)&stats->numUntypedNodes, 0);
+
+    return;
+}
+
+
+void countMayaSceneNode(MObject &node, int delta)
+{
+    if (!node.hasFn(MFn::kDependencyNode)) {
+        return;
+    }
+
+    MayaSceneStats *stats = &gMayaSceneStats;
+    if (delta < 0) {
+        // NOTE: (sonictk) These are the nodes of the previous scene going away, which were
+        // already taken out of the counts.
+        if (stats->isLoading != 0) {
+            return;
+        }
+        ::InterlockedIncrementNoFence64((volatile LONG64 *)&stats->numNodesRemoved);
+    } else {
+        ::InterlockedIncrementNoFence64((volatile LONG64 *)&stats->numNodesAdded);
+    }
+    addMayaSceneNodeCount(node, delta < 0 ? -1 : 1);
+
+    return;
+}
+
+
+void beginMayaSceneStatsLoad()
+{
+    gMayaSceneStats.isLoading = 1;
+    clearMayaSceneStatsCounts();
+
+    return;
+}
+
+
+void recountMayaSceneStats()
+{
+    MayaSceneStats *stats = &gMayaSceneStats;
+    stats->magic = MAYA_SCENE_STATS_MAGIC;
+    stats->version = MAYA_SCENE_STATS_VERSION;
+    stats->maxTypes = MAYA_SCENE_STATS_MAX_TYPES;
+
+    // NOTE: (sonictk) This is the only time that the DG is walked; once per scene, rather than
+    // every time we'd like to know how big it is.
+    clearMayaSceneStatsCounts();
+    for (MItDependencyNodes itNodes; !itNodes.isDone(); itNodes.next()) {
+        MObject node = itNodes.thisNode();
+        addMayaSceneNodeCount(node, 1);
+    }
+    ++stats->numRecounts;
+    stats->isLoading = 0;
+
+    return;
+}
+
+
+void checkMayaSceneStatsLoad()
+{
+    // NOTE: (sonictk) A scene that failed to open, or whose opening was cancelled, never gets as far
+    // as the after open/new callbacks. Until the counts are redone, they would ignore every node
+    // removed for the rest of the session.
+    if (gMayaSceneStats.isLoading == 0 || MFileIO::isOpeningFile() || MFileIO::isNewingFile() || MFileIO::isReadingFile()) {
+        return;
+    }
+    recountMayaSceneStats();
+
+    return;
+}
+
+
+bool getMayaSceneStatsStream(MINIDUMP_USER_STREAM *stream)
+{
+    stream->Type = MAYA_SCENE_STATS_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaSceneStats);
+    stream->Buffer = &gMayaSceneStats;
+
+    return true;
+}
+
+
+void *MayaSceneStatsCmd::creator()
+{
+    MayaSceneStatsCmd *cmd = new MayaSceneStatsCmd();
+
+    cmd->flagHelp = false;
+    cmd->count = -1;
+
+    return cmd;
+}
+
+
+MSyntax MayaSceneStatsCmd::newSyntax()
+{
+    MSyntax syntax;
+
+    syntax.enableQuery(false);
+    syntax.enableEdit(false);
+    syntax.useSelectionAsDefault(false);
+
+    syntax.addFlag(MAYA_SCENE_STATS_CMD_HELP_FLAG_SHORTNAME,
+                   MAYA_SCENE_STATS_CMD_HELP_FLAG_NAME);
+
+    syntax.addFlag(MAYA_SCENE_STATS_CMD_COUNT_FLAG_SHORTNAME,
+                   MAYA_SCENE_STATS_CMD_COUNT_FLAG_NAME,
+                   MSyntax::kLong);
+
+    syntax.addFlag(MAYA_SCENE_STATS_CMD_TYPE_FLAG_SHORTNAME,
+                   MAYA_SCENE_STATS_CMD_TYPE_FLAG_NAME,
+                   MSyntax::kString);
+
+    return syntax;
+}
+
+
+MStatus MayaSceneStatsCmd::parseArgs(const MArgList &args)
+{
+    MStatus result;
+
+    MArgDatabase argDb(this->syntax(), args, &result);
+    CHECK_MSTATUS_AND_RETURN_IT(result);
+
+    if (argDb.isFlagSet(MAYA_SCENE_STATS_CMD_HELP_FLAG_SHORTNAME)) {
+        MGlobal::displayInfo(MAYA_SCENE_STATS_CMD_HELP_TEXT);
+        this->flagHelp = true;
+        return MStatus::kSuccess;
+    }
+
+    if (argDb.isFlagSet(MAYA_SCENE_STATS_CMD_COUNT_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_SCENE_STATS_CMD_COUNT_FLAG_SHORTNAME, 0, this->count);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    if (argDb.isFlagSet(MAYA_SCENE_STATS_CMD_TYPE_FLAG_SHORTNAME)) {
+        result = argDb.getFlagArgument(MAYA_SCENE_STATS_CMD_TYPE_FLAG_SHORTNAME, 0, this->typeName);
+        CHECK_MSTATUS_AND_RETURN_IT(result);
+    }
+
+    return result;
+}
+
+
+MStatus MayaSceneStatsCmd::redoIt()
+{
+    const MayaSceneStats *stats = &gMayaSceneStats;
+
+    if (this->typeName.length() != 0) {
+        int count = 0;
+        for (uint32_t i=0; i < MAYA_SCENE_STATS_MAX_TYPES; ++i) {
+            if (stats->types[i].typeId != 0 && strcmp(stats->types[i].typeName, this->typeName.asChar()) == 0) {
+                count = stats->types[i].count;
+                break;
+            }
+        }
+        this->setResult(count);
+        return MStatus::kSuccess;
+    }
+
+    std::vector<std::pair<int32_t, uint32_t> > counts;
+    for (uint32_t i=0; i < MAYA_SCENE_STATS_MAX_TYPES; ++i) {
+        if (stats->types[i].typeId != 0 && stats->types[i].count != 0) {
+            counts.push_back(std::make_pair(stats->types[i].count, i));
+        }
+    }
+    std::sort(counts.begin(), counts.end(), std::greater<std::pair<int32_t, uint32_t> >());
+
+    char msg[512] = {0};
+    int lenMsg = snprintf(msg, sizeof(msg), "Scene stats: %u types, %d nodes of other types, %llu nodes added and %llu removed since the plugin was loaded.",
+                          (uint32_t)counts.size(), stats->numUntypedNodes, stats->numNodesAdded, stats->numNodesRemoved);
+    MGlobal::displayInfo(msg);
+    lenMsg = snprintf(msg, sizeof(msg), "Totals:");
+    for (int i=0; i < MayaSceneStatsTotal_Count && lenMsg > 0 && lenMsg < (int)sizeof(msg); ++i) {
+        lenMsg += snprintf(msg + lenMsg, sizeof(msg) - lenMsg, " %d %s%s", stats->totals[i], gMayaSceneStatsTotalNames[i], i + 1 < MayaSceneStatsTotal_Count ? "," : ".");
+    }
+    MGlobal::displayInfo(msg);
+
+    uint32_t numToPrint = this->count < 0 ? (uint32_t)counts.size() : (uint32_t)this->count;
+    if (numToPrint > counts.size()) {
+        numToPrint = (uint32_t)counts.size();
+    }
+    for (uint32_t i=0; i < numToPrint; ++i) {
+        const MayaSceneStatsType *entry = &stats->types[counts[i].second];
+        snprintf(msg, sizeof(msg), "#%u: %-40.*s %10d (type ID 0x%08x)",
+                 i, MAYA_SCENE_STATS_TYPE_NAME_LEN, entry->typeName, counts[i].first, entry->typeId);
+        MGlobal::displayInfo(msg);
+    }
+
+    this->setResult(stats->totals[MayaSceneStatsTotal_Nodes]);
+
+    return MStatus::kSuccess;
+}
+
+
+MStatus MayaSceneStatsCmd::doIt(const MArgList &args)
+{
+    this->clearResult();
+
+    MStatus stat = this->parseArgs(args);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
+
+    if (this->flagHelp == true) {
+        return MStatus::kSuccess;
+    }
+
+    return this->redoIt();
+}
+
+
+MStatus MayaSceneStatsCmd::undoIt()
+{
+    return MStatus::kSuccess;
+}
+
+
+bool MayaSceneStatsCmd::isUndoable() const
+{
+    return false;
+}
@@ -0,0 +1,131 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SCENE_STATS_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SCENE_STATS_H
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgList.h>
+#include <maya/MObject.h>
+#include <maya/MString.h>
+
+#include "common.h"
+
+/// How many slots of the type table to look through for a type before giving up on it.
+#define MAYA_SCENE_STATS_MAX_PROBES 64
+
+#define MAYA_SCENE_STATS_CMD_NAME "mayaSceneStats"
+#define MAYA_SCENE_STATS_CMD_HELP_FLAG_SHORTNAME "-h"
+#define MAYA_SCENE_STATS_CMD_HELP_FLAG_NAME "-help"
+
+#define MAYA_SCENE_STATS_CMD_COUNT_FLAG_SHORTNAME "-n"
+#define MAYA_SCENE_STATS_CMD_COUNT_FLAG_NAME "-count"
+
+#define MAYA_SCENE_STATS_CMD_TYPE_FLAG_SHORTNAME "-t"
+#define MAYA_SCENE_STATS_CMD_TYPE_FLAG_NAME "-type"
+
+#define MAYA_SCENE_STATS_CMD_HELP_TEXT "Prints the number of nodes in the scene, in total and by type, most common type first. " \
+    "Use -count to limit the number of types printed. Returns the total number of nodes, or the number of nodes of the " \
+    "given type if -type is used."
+
+
+/**
+ * Counts a node that was added to, or removed from the scene. Meant to be called from the node
+ * added/removed callbacks; this never blocks and does not allocate any memory.
+ *
+ * @param node      The node.
+ * @param delta     ``1`` if the node was added, ``-1`` if it was removed.
+ */
+void countMayaSceneNode(MObject &node, int delta);
+
+/**
+ * Marks the start of a scene being opened or created. Until ``recountMayaSceneStats`` is called,
+ * the counts start over from zero and only nodes being added are counted, since the nodes of the
+ * previous scene are being torn down at the same time.
+ */
+void beginMayaSceneStatsLoad();
+
+/**
+ * Throws away the counts and counts every node in the scene again. Called once a scene has been
+ * opened or created, and when the plugin is loaded.
+ */
+void recountMayaSceneStats();
+
+/**
+ * Recounts the scene if a scene started being opened or created, but is no longer being read
+ * and never finished loading (e.g. because opening it failed or was cancelled). Called
+ * periodically from the main thread; this does nothing unless a load was left unfinished.
+ */
+void checkMayaSceneStatsLoad();
+
+/**
+ * Fills in the user stream that the scene statistics are written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; the stream is always written.
+ */
+bool getMayaSceneStatsStream(MINIDUMP_USER_STREAM *stream);
+
+
+struct MayaSceneStatsCmd : public MPxCommand
+{
+    /**
+     * Creates a new instance of the command. Used for Maya plugin registration.
+     *
+     * @return  A pointer to the new instance.
+     */
+    static void *creator();
+
+    /**
+     * This function parses the arguments that were given to the command and stores
+     * it in local class data. It finally calls ``redoIt`` to implement the actual
+     * command functionality.
+     *
+     * @param args  The arguments that were passed to the command.
+     * @return      The status code.
+     */
+    MStatus doIt(const MArgList &args);
+
+    /**
+     * Prints the node counts, most common type first.
+     *
+     * @return      The status code.
+     */
+    MStatus redoIt();
+
+    /**
+     * This command does not modify the scene, so there is nothing to undo.
+     *
+     * @return      The status code.
+     */
+    MStatus undoIt();
+
+    /**
+     * This function specifies that the command is not undoable in Maya.
+     *
+     * @return  ``false``, as this command is not undoable.
+     */
+    bool isUndoable() const;
+
+    /**
+     * This static function returns the syntax object for this command.
+     *
+     * @return The syntax object set up for this command.
+     */
+    static MSyntax newSyntax();
+
+    /**
+     * This function parses the given arguments to the command and stores the
+     * results in local class data.
+     *
+     * @param args      The arguments that were passed to the command.
+     * @return          The status code.
+     */
+    MStatus parseArgs(const MArgList &args);
+
+    bool flagHelp;
+    int count;
+    MString typeName;
+};
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SCENE_STATS_H */
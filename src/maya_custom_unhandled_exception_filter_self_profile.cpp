@@ -0,0 +1,166 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_self_profile.cpp
+ * @brief  Counters of what the plugin's own callbacks cost. They run on every MEL command, DAG
+ *         change, node added and frame change in the session, so they had better be cheap; these
+ *         counters are always on so that we can tell whether they are, in production and in the
+ *         dumps. Each thread keeps its own counters, which are only summed up when read.
+ */
+#include "maya_custom_unhandled_exception_filter_self_profile.h"
+
+#include <intrin.h>
+
+
+/// NOTE: (sonictk) Kept in the .bss segment so that it can be written into the dump as-is.
+static MayaSelfProfile gMayaSelfProfile = {0};
+
+/// NOTE: (sonictk) Each thread finds its counters once and remembers them from then on.
+static __declspec(thread) MayaSelfProfileThread *tMayaSelfProfileThread = NULL;
+static __declspec(thread) bool tMayaSelfProfileNoSlotLeft = false;
+static __declspec(thread) uint64_t tMayaSelfProfileBytesCopied = 0;
+
+
+/// Records the current ``__rdtsc`` and ``QueryPerformanceCounter`` readings as the end of the
+/// interval used to work out the rate of ``__rdtsc``.
+static void markMayaSelfProfileEnd()
+{
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    gMayaSelfProfile.endCycles = __rdtsc();
+    gMayaSelfProfile.endTimestamp = (uint64_t)now.QuadPart;
+
+    return;
+}
+
+
+void startMayaSelfProfile()
+{
+    MayaSelfProfile *profile = &gMayaSelfProfile;
+    profile->magic = MAYA_SELF_PROFILE_MAGIC;
+    profile->version = MAYA_SELF_PROFILE_VERSION;
+
+    LARGE_INTEGER freq;
+    ::QueryPerformanceFrequency(&freq);
+    profile->timerFrequency = (uint64_t)freq.QuadPart;
+    LARGE_INTEGER now;
+    ::QueryPerformanceCounter(&now);
+    profile->startCycles = __rdtsc();
+    profile->startTimestamp = (uint64_t)now.QuadPart;
+    markMayaSelfProfileEnd();
+
+    return;
+}
+
+
+/// Claims a slot for the calling thread. This is the only place where threads contend with each other.
+static MayaSelfProfileThread *claimMayaSelfProfileThread()
+{
+    const LONG threadId = (LONG)::GetCurrentThreadId();
+    for (int i=0; i < MAYA_SELF_PROFILE_MAX_THREADS; ++i) {
+        MayaSelfProfileThread *slot = &gMayaSelfProfile.threads[i];
+        if (slot->threadId == 0 && ::InterlockedCompareExchange((volatile LONG *)&slot->threadId, threadId, 0) == 0) {
+            ::InterlockedIncrement((volatile LONG *)&gMayaSelfProfile.numThreads);
+            return slot;
+        }
+    }
+    ::InterlockedIncrement((volatile LONG *)&gMayaSelfProfile.numDroppedThreads);
+
+    return NULL;
+}
+
+
+MayaSelfProfileScope beginMayaSelfProfile()
+{
+    MayaSelfProfileScope scope;
+    scope.startBytesCopied = tMayaSelfProfileBytesCopied;
+    scope.startCycles = __rdtsc();
+
+    return scope;
+}
+
+
+void endMayaSelfProfile(MayaSelfProfileSite site, const MayaSelfProfileScope *scope)
+{
+    const uint64_t cycles = __rdtsc() - scope->startCycles;
+
+    MayaSelfProfileThread *slot = tMayaSelfProfileThread;
+    if (slot == NULL) {
+        if (tMayaSelfProfileNoSlotLeft) {
+            return;
+        }
+        slot = claimMayaSelfProfileThread();
+        if (slot == NULL) {
+            tMayaSelfProfileNoSlotLeft = true;
+            return;
+        }
+        tMayaSelfProfileThread = slot;
+    }
+
+    // NOTE: (sonictk) Only this thread ever writes to its counters, so there is nothing to
+    // synchronize; aligned 64-bit stores can't be torn, so readers see either the old or the new count.
+    MayaSelfProfileCounter *counter = &slot->counters[site];
+    ++counter->numCalls;
+    counter->totalCycles += cycles;
+    if (cycles > counter->maxCycles) {
+        counter->maxCycles = cycles;
+    }
+    counter->numBytesCopied += tMayaSelfProfileBytesCopied - scope->startBytesCopied;
+
+    return;
+}
+
+
+void countMayaSelfProfileBytes(size_t numBytes)
+{
+    tMayaSelfProfileBytesCopied += numBytes;
+
+    return;
+}
+
+
+double sumMayaSelfProfileCounters(MayaSelfProfileCounter counters[MayaSelfProfileSite_Count], uint32_t *numThreads)
+{
+    memset(counters, 0, sizeof(MayaSelfProfileCounter) * MayaSelfProfileSite_Count);
+    *numThreads = 0;
+    for (int i=0; i < MAYA_SELF_PROFILE_MAX_THREADS; ++i) {
+        const MayaSelfProfileThread *slot = &gMayaSelfProfile.threads[i];
+        if (slot->threadId == 0) {
+            continue;
+        }
+        ++*numThreads;
+        for (int j=0; j < MayaSelfProfileSite_Count; ++j) {
+            counters[j].numCalls += slot->counters[j].numCalls;
+            counters[j].totalCycles += slot->counters[j].totalCycles;
+            counters[j].numBytesCopied += slot->counters[j].numBytesCopied;
+            if (slot->counters[j].maxCycles > counters[j].maxCycles) {
+                counters[j].maxCycles = slot->counters[j].maxCycles;
+            }
+        }
+    }
+
+    const MayaSelfProfile *profile = &gMayaSelfProfile;
+    if (profile->timerFrequency == 0) {
+        return 0.0;
+    }
+    markMayaSelfProfileEnd();
+    const uint64_t elapsedTicks = profile->endTimestamp - profile->startTimestamp;
+    if (elapsedTicks == 0) {
+        return 0.0;
+    }
+
+    return (double)(profile->endCycles - profile->startCycles) * (double)profile->timerFrequency / (double)elapsedTicks / 1000.0;
+}
+
+
+bool getMayaSelfProfileStream(MINIDUMP_USER_STREAM *stream)
+{
+    // NOTE: (sonictk) The reader works out the rate of ``__rdtsc`` from how far it got since we
+    // started, so note where it is at now.
+    if (gMayaSelfProfile.timerFrequency != 0) {
+        markMayaSelfProfileEnd();
+    }
+    stream->Type = MAYA_SELF_PROFILE_STREAM_TYPE;
+    stream->BufferSize = sizeof(gMayaSelfProfile);
+    stream->Buffer = &gMayaSelfProfile;
+
+    return true;
+}
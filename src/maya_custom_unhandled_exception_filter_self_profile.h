@@ -0,0 +1,66 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SELF_PROFILE_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SELF_PROFILE_H
+
+#include "common.h"
+
+
+/// Where a callback started, as returned by ``beginMayaSelfProfile``.
+struct MayaSelfProfileScope
+{
+    uint64_t startCycles;
+    uint64_t startBytesCopied;
+};
+
+
+/**
+ * Starts the clock that the cycle counts are converted to time with. The counters themselves are
+ * always on, even before this is called.
+ */
+void startMayaSelfProfile();
+
+/**
+ * Marks the start of one of the plugin's callbacks on the calling thread.
+ *
+ * @return          The scope to pass to ``endMayaSelfProfile``.
+ */
+MayaSelfProfileScope beginMayaSelfProfile();
+
+/**
+ * Marks the end of a callback started with ``beginMayaSelfProfile``, and adds it to the calling
+ * thread's counters. This never blocks and does not allocate any memory; threads only contend
+ * with each other the first time each of them gets here.
+ *
+ * @param site      One of ``MayaSelfProfileSite``.
+ * @param scope     The scope returned by ``beginMayaSelfProfile``.
+ */
+void endMayaSelfProfile(MayaSelfProfileSite site, const MayaSelfProfileScope *scope);
+
+/**
+ * Counts bytes copied by the calling thread towards whichever callback it is in.
+ *
+ * @param numBytes  The number of bytes copied.
+ */
+void countMayaSelfProfileBytes(size_t numBytes);
+
+/**
+ * Sums up the counters of every thread.
+ *
+ * @param counters      The counters to fill in, one per ``MayaSelfProfileSite``.
+ * @param numThreads    The number of threads that the counters were summed from.
+ *
+ * @return              The number of ``__rdtsc`` ticks per millisecond, or ``0`` if it isn't
+ *                      known yet.
+ */
+double sumMayaSelfProfileCounters(MayaSelfProfileCounter counters[MayaSelfProfileSite_Count], uint32_t *numThreads);
+
+/**
+ * Fills in the user stream that the counters are written out in.
+ *
+ * @param stream    The stream to fill in.
+ *
+ * @return          ``true``; the stream is always written.
+ */
+bool getMayaSelfProfileStream(MINIDUMP_USER_STREAM *stream);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SELF_PROFILE_H */
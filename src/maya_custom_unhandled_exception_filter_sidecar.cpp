@@ -0,0 +1,156 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_sidecar.cpp
+ * @brief  Writes a small, fixed-layout summary of each crash next to its dump, so that a whole
+ *         spool of crashes can be triaged without opening a single dump.
+ */
+#include "maya_custom_unhandled_exception_filter_sidecar.h"
+#include "maya_custom_unhandled_exception_filter_fingerprint.h"
+#include "maya_custom_unhandled_exception_filter_stackwalk.h"
+
+#define MAYA_CODEVIEW_RSDS_SIGNATURE 0x53445352 // NOTE: (sonictk) ``RSDS``.
+
+/// The CodeView record in the debug directory of images built with PDBs.
+struct MayaCodeViewRSDS
+{
+    DWORD signature;
+    BYTE guid[16];
+    DWORD age;
+    char pdbPath[1];
+};
+
+
+/// Fills in the build information of the module at the given base address from its headers.
+static void fillMayaCrashSidecarModule(PVOID imageBase, MayaCrashSidecarModule *module)
+{
+    uint64_t moduleId = getMayaModuleId(imageBase);
+    module->timeDateStamp = (uint32_t)(moduleId >> 32);
+    module->sizeOfImage = (uint32_t)moduleId;
+    if (moduleId == 0) {
+        return;
+    }
+
+    const BYTE *pBase = (const BYTE *)imageBase;
+    const IMAGE_NT_HEADERS *pNtHeaders = (const IMAGE_NT_HEADERS *)(pBase + ((const IMAGE_DOS_HEADER *)pBase)->e_lfanew);
+    const IMAGE_DATA_DIRECTORY *pDebugDir = &pNtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+    if (pDebugDir->VirtualAddress == 0 || pDebugDir->Size == 0) {
+        return;
+    }
+
+    const IMAGE_DEBUG_DIRECTORY *pEntries = (const IMAGE_DEBUG_DIRECTORY *)(pBase + pDebugDir->VirtualAddress);
+    const DWORD numEntries = pDebugDir->Size / sizeof(IMAGE_DEBUG_DIRECTORY);
+    for (DWORD i=0; i < numEntries; ++i) {
+        if (pEntries[i].Type != IMAGE_DEBUG_TYPE_CODEVIEW
+            || pEntries[i].AddressOfRawData == 0
+            || pEntries[i].SizeOfData <= offsetof(MayaCodeViewRSDS, pdbPath)) {
+            continue;
+        }
+        const MayaCodeViewRSDS *pRSDS = (const MayaCodeViewRSDS *)(pBase + pEntries[i].AddressOfRawData);
+        if (pRSDS->signature != MAYA_CODEVIEW_RSDS_SIGNATURE) {
+            continue;
+        }
+        memcpy(module->pdbGuid, pRSDS->guid, sizeof(module->pdbGuid));
+        module->pdbAge = pRSDS->age;
+
+        // NOTE: (sonictk) The PDB path is that of the machine the module was built on; only its
+        // file name is of any use to us.
+        const size_t maxLenPdbPath = pEntries[i].SizeOfData - offsetof(MayaCodeViewRSDS, pdbPath);
+        const char *pdbName = pRSDS->pdbPath;
+        for (size_t j=0; j < maxLenPdbPath && pRSDS->pdbPath[j] != '\0'; ++j) {
+            if (pRSDS->pdbPath[j] == '\\' || pRSDS->pdbPath[j] == '/') {
+                pdbName = &pRSDS->pdbPath[j + 1];
+            }
+        }
+        const size_t maxLenPdbName = maxLenPdbPath - (size_t)(pdbName - pRSDS->pdbPath);
+        for (size_t j=0; j < maxLenPdbName && j < MAYA_CRASH_SIDECAR_MODULE_NAME_LEN - 1 && pdbName[j] != '\0'; ++j) {
+            module->pdbName[j] = pdbName[j];
+        }
+        break;
+    }
+
+    return;
+}
+
+
+/// Converts an address to a module-relative one, adding the module to the sidecar's module
+/// table if it isn't in there already.
+static MayaCrashSidecarFrame getMayaCrashSidecarFrame(uint64_t addr, MayaCrashSidecar *sidecar, PVOID *moduleBases)
+{
+    MayaCrashSidecarFrame frame = {0};
+    frame.offset = (uint32_t)addr;
+    frame.moduleIdx = MAYA_CRASH_SIDECAR_NO_MODULE;
+
+    PVOID moduleBase = NULL;
+    ::RtlPcToFileHeader((PVOID)addr, &moduleBase);
+    if (moduleBase == NULL) {
+        return frame;
+    }
+
+    uint32_t moduleIdx = 0;
+    for (; moduleIdx < sidecar->numModules; ++moduleIdx) {
+        if (moduleBases[moduleIdx] == moduleBase) {
+            break;
+        }
+    }
+    if (moduleIdx == sidecar->numModules) {
+        if (sidecar->numModules == MAYA_CRASH_SIDECAR_MAX_MODULES) {
+            return frame;
+        }
+        moduleBases[sidecar->numModules] = moduleBase;
+        fillMayaCrashSidecarModule(moduleBase, &sidecar->modules[sidecar->numModules]);
+        ++sidecar->numModules;
+    }
+
+    frame.offset = (uint32_t)(addr - (uint64_t)moduleBase);
+    frame.moduleIdx = (uint16_t)moduleIdx;
+
+    return frame;
+}
+
+
+void fillMayaCrashSidecar(const EXCEPTION_POINTERS *exceptionInfo, MayaCrashSidecar *sidecar)
+{
+    sidecar->magic = MAYA_CRASH_SIDECAR_MAGIC;
+    sidecar->version = MAYA_CRASH_SIDECAR_VERSION;
+    sidecar->processId = ::GetCurrentProcessId();
+    sidecar->exceptionCode = exceptionInfo->ExceptionRecord->ExceptionCode;
+
+    FILETIME nowFileTime;
+    ::GetSystemTimeAsFileTime(&nowFileTime);
+    sidecar->timestamp = ((uint64_t)nowFileTime.dwHighDateTime << 32) | nowFileTime.dwLowDateTime;
+
+    PVOID moduleBases[MAYA_CRASH_SIDECAR_MAX_MODULES] = {0};
+    sidecar->numModules = 0;
+    sidecar->exceptionAddress = getMayaCrashSidecarFrame((uint64_t)exceptionInfo->ExceptionRecord->ExceptionAddress, sidecar, moduleBases);
+
+    // NOTE: (sonictk) Unwind a copy, so that the context handed to the dump is left untouched.
+    CONTEXT context = *exceptionInfo->ContextRecord;
+    const NT_TIB *pTib = (const NT_TIB *)::NtCurrentTeb();
+    uint64_t frames[MAYA_CRASH_SIDECAR_MAX_FRAMES] = {0};
+    sidecar->numFrames = walkMayaStack(&context,
+                                       (ULONG64)pTib->StackLimit,
+                                       (ULONG64)pTib->StackBase,
+                                       frames,
+                                       MAYA_CRASH_SIDECAR_MAX_FRAMES);
+    for (uint32_t i=0; i < sidecar->numFrames; ++i) {
+        sidecar->frames[i] = getMayaCrashSidecarFrame(frames[i], sidecar, moduleBases);
+    }
+
+    return;
+}
+
+
+bool writeMayaCrashSidecar(const char *dumpFilePath, const MayaCrashSidecar *sidecar)
+{
+    char sidecarFilePath[MAX_PATH] = {0};
+    snprintf(sidecarFilePath, MAX_PATH, "%s%s", dumpFilePath, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+    HANDLE hFile = ::CreateFileA(sidecarFilePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    DWORD bytesWritten = 0;
+    BOOL written = ::WriteFile(hFile, sidecar, sizeof(MayaCrashSidecar), &bytesWritten, NULL);
+    ::CloseHandle(hFile);
+
+    return written == TRUE && bytesWritten == sizeof(MayaCrashSidecar);
+}
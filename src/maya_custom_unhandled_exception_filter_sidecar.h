@@ -0,0 +1,30 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SIDECAR_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SIDECAR_H
+
+#include "common.h"
+
+
+/**
+ * Fills in the parts of the sidecar that describe the crash itself: the exception code and
+ * address, the return addresses at the top of the faulting stack, and the builds of the modules
+ * that they fall in. The breadcrumb summary is left for the caller to fill in. This only reads
+ * the headers of the loaded modules and does not allocate any memory, so that it is safe to call
+ * from within the exception filter.
+ *
+ * @param exceptionInfo     The exception that caused the crash.
+ * @param sidecar           The sidecar to fill in.
+ */
+void fillMayaCrashSidecar(const EXCEPTION_POINTERS *exceptionInfo, MayaCrashSidecar *sidecar);
+
+/**
+ * Writes the given sidecar out to ``<dumpFilePath>.sidecar``.
+ *
+ * @param dumpFilePath      The path of the dump that the sidecar belongs to.
+ * @param sidecar           The sidecar to write.
+ *
+ * @return                  ``true`` if the sidecar was written successfully, ``false`` otherwise.
+ */
+bool writeMayaCrashSidecar(const char *dumpFilePath, const MayaCrashSidecar *sidecar);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SIDECAR_H */
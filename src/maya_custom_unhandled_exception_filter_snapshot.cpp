@@ -0,0 +1,160 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_snapshot.cpp
+ * @brief  Writes dumps of the live Maya process without killing it, for cases where there is
+ *         no exception to handle (e.g. the main thread is hung).
+ */
+#include "maya_custom_unhandled_exception_filter_snapshot.h"
+
+#include <ProcessSnapshot.h>
+
+
+/// Number of snapshot dumps written during this session; used to keep the file names unique.
+static volatile LONG gMayaNumSnapshotDumps = 0;
+
+
+/// Callback for ``MiniDumpWriteDump`` that lets DbgHelp know it is reading from a process snapshot
+/// rather than a process handle.
+static BOOL CALLBACK mayaSnapshotMiniDumpCallback(PVOID param,
+                                                  const PMINIDUMP_CALLBACK_INPUT callbackInput,
+                                                  PMINIDUMP_CALLBACK_OUTPUT callbackOutput)
+{
+    (void)param;
+    if (callbackInput->CallbackType == IsProcessSnapshotCallback) {
+        callbackOutput->Status = S_FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/// Replaces the buffers of the given user streams with copies read out of the snapshot's clone of
+/// the address space, so that the breadcrumbs are consistent with the rest of the dump even if the
+/// (still-running) process updates them while the dump is being written.
+static void *copyUserStreamsFromSnapshot(HPSS hSnapshot, MINIDUMP_USER_STREAM *streams, ULONG numStreams)
+{
+    PSS_VA_CLONE_INFORMATION cloneInfo = {0};
+    DWORD err = ::PssQuerySnapshot(hSnapshot, PSS_QUERY_VA_CLONE_INFORMATION, &cloneInfo, sizeof(cloneInfo));
+    if (err != ERROR_SUCCESS || cloneInfo.VaCloneHandle == NULL) {
+        return NULL;
+    }
+
+    SIZE_T totalSize = 0;
+    for (ULONG i=0; i < numStreams; ++i) {
+        totalSize += streams[i].BufferSize;
+    }
+
+    PBYTE stagingBuf = (PBYTE)::VirtualAlloc(NULL, totalSize, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if (stagingBuf == NULL) {
+        return NULL;
+    }
+
+    PBYTE pCur = stagingBuf;
+    for (ULONG i=0; i < numStreams; ++i) {
+        SIZE_T bytesRead = 0;
+        if (::ReadProcessMemory(cloneInfo.VaCloneHandle, streams[i].Buffer, pCur, streams[i].BufferSize, &bytesRead)
+            && bytesRead == streams[i].BufferSize) {
+            streams[i].Buffer = pCur;
+        }
+        // NOTE: (sonictk) Otherwise, fall back to the live copy of this stream; better than nothing.
+        pCur += streams[i].BufferSize;
+    }
+
+    return stagingBuf;
+}
+
+
+bool writeMayaSnapshotDump(const char *filePrefix,
+                           MayaSnapshotInfo *snapshotInfo,
+                           char *dumpFilePath,
+                           DWORD lenDumpFilePath,
+                           MayaSnapshotDumpTimings *timings)
+{
+    char tempDirPath[MAX_PATH] = {0};
+    getMayaDumpDirectory(tempDirPath, MAX_PATH);
+    LONG dumpIdx = ::InterlockedIncrement(&gMayaNumSnapshotDumps);
+    snprintf(dumpFilePath, lenDumpFilePath, "%s\\%s_%lu_%ld.dmp", tempDirPath, filePrefix, ::GetCurrentProcessId(), dumpIdx);
+
+    HANDLE hFile = ::CreateFileA(dumpFilePath, GENERIC_READ|GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == NULL || hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER freq;
+    LARGE_INTEGER pauseStart;
+    LARGE_INTEGER pauseEnd;
+    LARGE_INTEGER writeEnd;
+    ::QueryPerformanceFrequency(&freq);
+
+    // NOTE: (sonictk) This is the only point where the process is actually paused: the snapshot
+    // clones the address space copy-on-write, so the (slow) dump writing below happens against the
+    // clone while the rest of the process carries on.
+    static const DWORD snapshotFlags = PSS_CAPTURE_VA_CLONE
+        | PSS_CAPTURE_HANDLES
+        | PSS_CAPTURE_HANDLE_NAME_INFORMATION
+        | PSS_CAPTURE_HANDLE_BASIC_INFORMATION
+        | PSS_CAPTURE_HANDLE_TYPE_SPECIFIC_INFORMATION
+        | PSS_CAPTURE_HANDLE_TRACE
+        | PSS_CAPTURE_THREADS
+        | PSS_CAPTURE_THREAD_CONTEXT
+        | PSS_CAPTURE_THREAD_CONTEXT_EXTENDED
+        | PSS_CREATE_BREAKAWAY
+        | PSS_CREATE_BREAKAWAY_OPTIONAL
+        | PSS_CREATE_USE_VM_ALLOCATIONS
+        | PSS_CREATE_RELEASE_FAULTED_SNAPSHOT;
+
+    // NOTE: (sonictk) The staged streams are put together before the snapshot is taken, so that
+    // the clone holds them as they were at the time of the snapshot, like the rest of the dump.
+    MayaDumpUserStreamStaging staging;
+    MINIDUMP_USER_STREAM streams[MAYA_MAX_DUMP_USER_STREAMS + 1];
+    ULONG numStreams = fillMayaDumpUserStreams(streams, MAYA_MAX_DUMP_USER_STREAMS, &staging);
+
+    HPSS hSnapshot = NULL;
+    ::QueryPerformanceCounter(&pauseStart);
+    DWORD err = ::PssCaptureSnapshot(::GetCurrentProcess(), (PSS_CAPTURE_FLAGS)snapshotFlags, CONTEXT_ALL, &hSnapshot);
+    ::QueryPerformanceCounter(&pauseEnd);
+    if (err != ERROR_SUCCESS) {
+        ::CloseHandle(hFile);
+        ::DeleteFileA(dumpFilePath);
+        return false;
+    }
+
+    uint64_t pauseMicroseconds = (uint64_t)((pauseEnd.QuadPart - pauseStart.QuadPart) * 1000000 / freq.QuadPart);
+    snapshotInfo->pauseMicroseconds = pauseMicroseconds;
+
+    void *stagingBuf = copyUserStreamsFromSnapshot(hSnapshot, streams, numStreams);
+
+    MINIDUMP_USER_STREAM *dumpSnapshotInfo = &streams[numStreams++];
+    dumpSnapshotInfo->Type = MAYA_SNAPSHOT_INFO_STREAM_TYPE;
+    dumpSnapshotInfo->BufferSize = sizeof(MayaSnapshotInfo);
+    dumpSnapshotInfo->Buffer = snapshotInfo;
+
+    MINIDUMP_USER_STREAM_INFORMATION dumpUserInfo = {0};
+    dumpUserInfo.UserStreamCount = numStreams;
+    dumpUserInfo.UserStreamArray = streams;
+
+    MINIDUMP_CALLBACK_INFORMATION callbackInfo = {0};
+    callbackInfo.CallbackRoutine = mayaSnapshotMiniDumpCallback;
+    callbackInfo.CallbackParam = NULL;
+
+    static const DWORD miniDumpFlags = MiniDumpWithThreadInfo|MiniDumpWithUnloadedModules;
+    BOOL dumpWritten = ::MiniDumpWriteDump((HANDLE)hSnapshot, ::GetCurrentProcessId(), hFile, (MINIDUMP_TYPE)miniDumpFlags, NULL, &dumpUserInfo, &callbackInfo);
+    ::QueryPerformanceCounter(&writeEnd);
+
+    if (stagingBuf != NULL) {
+        ::VirtualFree(stagingBuf, 0, MEM_RELEASE);
+    }
+    ::PssFreeSnapshot(::GetCurrentProcess(), hSnapshot);
+    ::CloseHandle(hFile);
+
+    if (timings != NULL) {
+        timings->pauseMicroseconds = pauseMicroseconds;
+        timings->writeMicroseconds = (uint64_t)((writeEnd.QuadPart - pauseEnd.QuadPart) * 1000000 / freq.QuadPart);
+    }
+
+    if (dumpWritten == FALSE) {
+        ::DeleteFileA(dumpFilePath);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SNAPSHOT_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SNAPSHOT_H
+
+#include "common.h"
+
+#define MAYA_MAX_DUMP_USER_STREAMS 16
+
+
+/// Timings of a snapshot dump, for reporting back to the user.
+struct MayaSnapshotDumpTimings
+{
+    uint64_t pauseMicroseconds; // NOTE: (sonictk) How long the process was paused for.
+    uint64_t writeMicroseconds; // NOTE: (sonictk) How long it took to write the dump from the clone (the process is not paused for this).
+};
+
+
+/// The parts of the user streams that are only put together when a dump is written, e.g. the names
+/// of the last changes, which are kept as name table IDs until then. Each dump writer has its own,
+/// so that writing a dump never touches the breadcrumbs that the process is still updating.
+struct MayaDumpUserStreamStaging
+{
+    MayaCrashDumpInfo crashInfo;
+};
+
+
+/**
+ * Fills in the user streams (i.e. all of our breadcrumbs) that should be written into every
+ * dump file, whether it is written from the exception filter or as a snapshot of the live
+ * process. This is defined in the main plugin translation unit, where the breadcrumbs live.
+ *
+ * @param streams       Storage for the user streams. Must be able to hold at least
+ *                      ``MAYA_MAX_DUMP_USER_STREAMS`` entries.
+ * @param maxStreams    The number of entries that ``streams`` can hold.
+ * @param staging       Storage for the streams that are put together now. Some of the streams
+ *                      point into it, so it must outlive the dump being written.
+ *
+ * @return              The number of user streams that were filled in.
+ */
+ULONG fillMayaDumpUserStreams(MINIDUMP_USER_STREAM *streams, ULONG maxStreams, MayaDumpUserStreamStaging *staging);
+
+/**
+ * Writes a minidump of the current, still-running process without killing it. The process is
+ * captured using ``PssCaptureSnapshot``, which clones the address space copy-on-write, so the
+ * process is only paused for as long as it takes to take the snapshot; the dump itself, including
+ * the breadcrumb user streams, is then written from the clone while the process carries on.
+ *
+ * @param filePrefix        The prefix of the dump file name, e.g. ``MayaCustomHangDump``.
+ * @param snapshotInfo      Why the snapshot was taken. This is written into the dump as well, after
+ *                          its ``pauseMicroseconds`` member has been filled in.
+ * @param dumpFilePath      Storage for the path of the dump file that was written.
+ * @param lenDumpFilePath   The size of the ``dumpFilePath`` buffer.
+ * @param timings           Storage for the timings of the snapshot. Can be ``NULL``.
+ *
+ * @return                  ``true`` if the dump was written successfully, ``false`` otherwise.
+ */
+bool writeMayaSnapshotDump(const char *filePrefix,
+                           MayaSnapshotInfo *snapshotInfo,
+                           char *dumpFilePath,
+                           DWORD lenDumpFilePath,
+                           MayaSnapshotDumpTimings *timings);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_SNAPSHOT_H */
@@ -0,0 +1,47 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_stackwalk.cpp
+ * @brief  A minimal x64 stack walker built on top of the unwind tables of the loaded modules.
+ *         ``StackWalk64`` from DbgHelp is not an option here, since it allocates and is not
+ *         thread-safe.
+ */
+#include "maya_custom_unhandled_exception_filter_stackwalk.h"
+
+
+uint32_t walkMayaStack(CONTEXT *context, ULONG64 stackLow, ULONG64 stackHigh, uint64_t *frames, uint32_t maxFrames)
+{
+    uint32_t numFrames = 0;
+
+    while (numFrames < maxFrames && context->Rip != 0) {
+        if (context->Rsp < stackLow || context->Rsp >= stackHigh) {
+            break;
+        }
+
+        frames[numFrames++] = context->Rip;
+
+        ULONG64 imageBase = 0;
+        PRUNTIME_FUNCTION pFunctionEntry = ::RtlLookupFunctionEntry(context->Rip, &imageBase, NULL);
+        if (pFunctionEntry == NULL) {
+            // NOTE: (sonictk) No unwind info means this is a leaf function, which by definition
+            // hasn't touched the stack pointer; the return address is right at the top of the stack.
+            if (context->Rsp + sizeof(ULONG64) > stackHigh) {
+                break;
+            }
+            context->Rip = *(ULONG64 *)context->Rsp;
+            context->Rsp += sizeof(ULONG64);
+            continue;
+        }
+
+        PVOID handlerData = NULL;
+        ULONG64 establisherFrame = 0;
+        ULONG64 prevRsp = context->Rsp;
+        ::RtlVirtualUnwind(UNW_FLAG_NHANDLER, imageBase, context->Rip, pFunctionEntry, context, &handlerData, &establisherFrame, NULL);
+
+        // NOTE: (sonictk) The stack only ever grows downwards; if unwinding didn't move us up the
+        // stack, the unwind info (or the stack itself) is bogus and we'd loop forever.
+        if (context->Rsp <= prevRsp) {
+            break;
+        }
+    }
+
+    return numFrames;
+}
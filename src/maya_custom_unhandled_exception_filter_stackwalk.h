@@ -0,0 +1,25 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_STACKWALK_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_STACKWALK_H
+
+#include "common.h"
+
+
+/**
+ * Walks the stack described by the given context using the unwind tables of the loaded
+ * modules, recording the instruction pointer of each frame (innermost first). This does not
+ * allocate any memory or take any locks of its own, so that it can be used from within the
+ * exception filter. However, ``RtlLookupFunctionEntry`` may take loader locks internally, so
+ * it must **not** be called while another thread that could be holding them is suspended.
+ *
+ * @param context       The context to start unwinding from. This is modified as the stack is unwound.
+ * @param stackLow      The lowest address that the stack pointer is allowed to reach while unwinding.
+ * @param stackHigh     One past the highest address the stack pointer is allowed to reach while unwinding.
+ * @param frames        Storage for the instruction pointers of each frame.
+ * @param maxFrames     The number of entries that ``frames`` can hold.
+ *
+ * @return              The number of frames recorded.
+ */
+uint32_t walkMayaStack(CONTEXT *context, ULONG64 stackLow, ULONG64 stackHigh, uint64_t *frames, uint32_t maxFrames);
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_STACKWALK_H */
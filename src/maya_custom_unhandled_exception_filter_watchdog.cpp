@@ -0,0 +1,136 @@
+/**
+ * @file   maya_custom_unhandled_exception_filter_watchdog.cpp
+ * @brief  A watchdog thread that writes a snapshot dump of the live process when the Maya
+ *         main thread hangs. Hung sessions never raise an exception, so the unhandled
+ *         exception filter would otherwise never get a chance to run.
+ */
+#include "maya_custom_unhandled_exception_filter_watchdog.h"
+#include "maya_custom_unhandled_exception_filter_snapshot.h"
+
+
+/// Bumped by the main thread whenever it does any work that we can observe.
+static volatile LONG64 gMayaMainThreadHeartbeat = 0;
+static DWORD gMayaMainThreadId = 0;
+
+static HANDLE gMayaHangWatchdogThread = NULL;
+static HANDLE gMayaHangWatchdogStopEvent = NULL;
+static DWORD gMayaHangWatchdogThresholdMs = 0;
+static bool gMayaHangWatchdogAbort = false;
+
+
+void bumpMayaMainThreadHeartbeat()
+{
+    // NOTE: (sonictk) Only the main thread ever writes this, so there's no need for an interlocked op.
+    gMayaMainThreadHeartbeat = gMayaMainThreadHeartbeat + 1;
+}
+
+
+static DWORD WINAPI mayaHangWatchdogThreadProc(LPVOID unused)
+{
+    (void)unused;
+
+    // NOTE: (sonictk) Poll a few times per threshold period so that we notice a hang reasonably
+    // close to when it crosses the threshold, but never more than once per second.
+    DWORD pollMs = gMayaHangWatchdogThresholdMs / 4;
+    if (pollMs > 1000) {
+        pollMs = 1000;
+    }
+
+    LONG64 lastHeartbeat = gMayaMainThreadHeartbeat;
+    ULONGLONG lastHeartbeatTime = ::GetTickCount64();
+    bool dumpedThisStall = false;
+
+    while (::WaitForSingleObject(gMayaHangWatchdogStopEvent, pollMs) == WAIT_TIMEOUT) {
+        LONG64 heartbeat = gMayaMainThreadHeartbeat;
+        ULONGLONG now = ::GetTickCount64();
+        if (heartbeat != lastHeartbeat) {
+            lastHeartbeat = heartbeat;
+            lastHeartbeatTime = now;
+            dumpedThisStall = false;
+            continue;
+        }
+
+        ULONGLONG stallMs = now - lastHeartbeatTime;
+        if (dumpedThisStall || stallMs < gMayaHangWatchdogThresholdMs) {
+            continue;
+        }
+
+        // NOTE: (sonictk) Someone sitting at a breakpoint is not a hang.
+        if (::IsDebuggerPresent()) {
+            continue;
+        }
+
+        // NOTE: (sonictk) Only write one dump per stall; if the main thread never recovers, we
+        // don't want to fill up the disk with identical dumps.
+        dumpedThisStall = true;
+
+        MayaSnapshotInfo snapshotInfo = {0};
+        snapshotInfo.reason = MayaSnapshotReason_MainThreadHang;
+        snapshotInfo.mainThreadId = gMayaMainThreadId;
+        snapshotInfo.stallMs = stallMs;
+        snapshotInfo.heartbeat = (uint64_t)heartbeat;
+
+        char dumpFilePath[MAX_PATH] = {0};
+        MayaSnapshotDumpTimings timings = {0};
+        bool bStat = writeMayaSnapshotDump(MAYA_HANG_DUMP_FILE_PREFIX, &snapshotInfo, dumpFilePath, MAX_PATH, &timings);
+
+        char msg[MAX_PATH + 192] = {0};
+        if (bStat) {
+            snprintf(msg, sizeof(msg), "Maya main thread has been unresponsive for %llu ms. A snapshot dump was written to: %s "
+                     "(process paused for %llu us, dump written in %llu us)\n",
+                     stallMs, dumpFilePath, timings.pauseMicroseconds, timings.writeMicroseconds);
+        } else {
+            snprintf(msg, sizeof(msg), "Maya main thread has been unresponsive for %llu ms. Unable to write a snapshot dump.\n", stallMs);
+        }
+        ::OutputDebugStringA(msg);
+        fputs(msg, stderr);
+
+        if (gMayaHangWatchdogAbort) {
+            ::TerminateProcess(::GetCurrentProcess(), MAYA_HANG_WATCHDOG_ABORT_EXIT_CODE);
+        }
+    }
+
+    return 0;
+}
+
+
+bool startMayaHangWatchdog(unsigned int thresholdSecs, bool abortOnHang)
+{
+    if (gMayaHangWatchdogThread != NULL) {
+        return true;
+    }
+
+    gMayaMainThreadId = ::GetCurrentThreadId();
+    gMayaHangWatchdogThresholdMs = (DWORD)thresholdSecs * 1000;
+    gMayaHangWatchdogAbort = abortOnHang;
+
+    gMayaHangWatchdogStopEvent = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (gMayaHangWatchdogStopEvent == NULL) {
+        return false;
+    }
+
+    gMayaHangWatchdogThread = ::CreateThread(NULL, 0, mayaHangWatchdogThreadProc, NULL, 0, NULL);
+    if (gMayaHangWatchdogThread == NULL) {
+        ::CloseHandle(gMayaHangWatchdogStopEvent);
+        gMayaHangWatchdogStopEvent = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+
+void stopMayaHangWatchdog()
+{
+    if (gMayaHangWatchdogThread == NULL) {
+        return;
+    }
+
+    ::SetEvent(gMayaHangWatchdogStopEvent);
+    ::WaitForSingleObject(gMayaHangWatchdogThread, INFINITE);
+
+    ::CloseHandle(gMayaHangWatchdogThread);
+    ::CloseHandle(gMayaHangWatchdogStopEvent);
+    gMayaHangWatchdogThread = NULL;
+    gMayaHangWatchdogStopEvent = NULL;
+}
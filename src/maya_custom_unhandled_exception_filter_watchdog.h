@@ -0,0 +1,48 @@
+#ifndef MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_WATCHDOG_H
+#define MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_WATCHDOG_H
+
+#include "common.h"
+
+/// How long the main thread must be unresponsive for before a snapshot dump is written. Set to
+/// ``0`` to disable the watchdog entirely.
+#define MAYA_HANG_WATCHDOG_THRESHOLD_ENV_VAR_NAME "MAYA_CRASH_HANG_THRESHOLD_SECS"
+#define MAYA_HANG_WATCHDOG_DEFAULT_THRESHOLD_SECS 300
+
+/// NOTE: (sonictk) Off by default in batch sessions, where nothing bumps the heartbeat for as
+/// long as a single frame takes to render, which would be taken for a hang.
+#define MAYA_HANG_WATCHDOG_DEFAULT_BATCH_THRESHOLD_SECS 0
+
+/// If set to a non-zero value, the process is terminated after the hang snapshot has been written.
+#define MAYA_HANG_WATCHDOG_ABORT_ENV_VAR_NAME "MAYA_CRASH_HANG_ABORT"
+#define MAYA_HANG_WATCHDOG_ABORT_EXIT_CODE 0xDEAD
+
+/// Period of the idle timer callback that keeps the heartbeat ticking when nothing else is going on.
+#define MAYA_HANG_WATCHDOG_IDLE_HEARTBEAT_PERIOD_SECS 1.0f
+
+#define MAYA_HANG_DUMP_FILE_PREFIX "MayaCustomHangDump"
+
+
+/**
+ * Marks the main thread as being alive. This is called from the existing Maya callbacks that
+ * run on the main thread (idle, time change, MEL procs), so it must be cheap.
+ */
+void bumpMayaMainThreadHeartbeat();
+
+/**
+ * Starts the watchdog thread that writes a snapshot dump when the main thread stops bumping
+ * its heartbeat for longer than the given threshold. Must be called from the main thread.
+ *
+ * @param thresholdSecs     How long the main thread must be unresponsive for before a dump is written.
+ * @param abortOnHang       Whether to terminate the process after writing the dump.
+ *
+ * @return                  ``true`` if the watchdog was started successfully, ``false`` otherwise.
+ */
+bool startMayaHangWatchdog(unsigned int thresholdSecs, bool abortOnHang);
+
+/**
+ * Signals the watchdog thread to stop and waits for it to exit.
+ */
+void stopMayaHangWatchdog();
+
+
+#endif /* MAYA_CUSTOM_UNHANDLED_EXCEPTION_FILTER_WATCHDOG_H */
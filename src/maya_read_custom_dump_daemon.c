@@ -0,0 +1,786 @@
+/**
+ * @file   maya_read_custom_dump_daemon.c
+ * @brief  Watches spool directories for new dumps and keeps running totals of the crashes in
+ *         them (per crash bucket, Maya version, scene and last DG node added), so that a crash
+ *         storm on the farm shows up on a dashboard as it happens rather than when someone gets
+ *         around to running the reader.
+ *
+ *         Dumps are picked up once whoever is writing them has closed them, and are read by a
+ *         fixed pool of workers through a bounded queue. When the workers fall behind, the
+ *         watcher simply stops taking notifications off the queue; anything that the directory
+ *         notifications drop in the meantime is found again by rescanning the directory, so
+ *         nothing ever has to be queued without bound. The totals are served as JSON on a named
+ *         pipe and checkpointed to disk, along with which dumps have already been counted, so
+ *         that the daemon can be restarted without counting anything twice.
+ */
+#define MAYA_DAEMON_PIPE_NAME "\\\\.\\pipe\\MayaCrashAggregates"
+#define MAYA_DAEMON_CHECKPOINT_FILE_NAME "MayaCrashAggregates.bin"
+#define MAYA_DAEMON_CHECKPOINT_MAGIC 0x4741434D // NOTE: (sonictk) ``MCAG``.
+#define MAYA_DAEMON_CHECKPOINT_VERSION 1
+#define MAYA_DAEMON_CHECKPOINT_INTERVAL_MS 30000
+
+#define MAYA_DAEMON_MAX_DIRS 16
+#define MAYA_DAEMON_MAX_WORKERS 8
+#define MAYA_DAEMON_QUEUE_CAPACITY 64
+#define MAYA_DAEMON_MAX_PENDING 1024
+#define MAYA_DAEMON_RETRY_INTERVAL_MS 1000
+#define MAYA_DAEMON_NOTIFY_BUFFER_SIZE (64 * 1024)
+#define MAYA_DAEMON_KEY_LEN 256
+#define MAYA_DAEMON_TABLE_INITIAL_CAPACITY 1024
+#define MAYA_DAEMON_MAX_KEYS_SERVED 100
+
+/// NOTE: (sonictk) The sidecar is written just after the dump is closed. Give it this long to show
+/// up before counting the dump without it.
+#define MAYA_DAEMON_SIDECAR_WAIT_MS 5000
+
+typedef enum MayaDaemonCategory
+{
+    MayaDaemonCategory_Bucket = 0,
+    MayaDaemonCategory_MayaVersion,
+    MayaDaemonCategory_Scene,
+    MayaDaemonCategory_LastDGNode,
+    MayaDaemonCategory_Count
+} MayaDaemonCategory;
+
+static const char *kMayaDaemonCategoryNames[MayaDaemonCategory_Count] = {"buckets", "maya_versions", "scenes", "last_dg_nodes"};
+
+#pragma pack(push, 1)
+/// A single running total, as kept in memory and written into the checkpoint.
+typedef struct MayaDaemonCount
+{
+    uint64_t count; // NOTE: (sonictk) ``0`` marks an empty slot.
+    uint32_t category; // NOTE: (sonictk) One of ``MayaDaemonCategory``.
+    char key[MAYA_DAEMON_KEY_LEN];
+} MayaDaemonCount;
+
+/// The checkpoint is this header, followed by ``numCounts`` counts and ``numSeen`` hashes of the
+/// dumps that have already been counted.
+typedef struct MayaDaemonCheckpointHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numDumps;
+    uint64_t numFailedDumps;
+    uint32_t numCounts;
+    uint32_t numSeen;
+} MayaDaemonCheckpointHeader;
+#pragma pack(pop)
+
+typedef struct MayaDaemonCountTable
+{
+    MayaDaemonCount *counts;
+    uint32_t capacity; // NOTE: (sonictk) Always a power of two.
+    uint32_t numCounts;
+} MayaDaemonCountTable;
+
+/// Hashes of the dumps that have been queued already. A hash of ``0`` marks an empty slot.
+typedef struct MayaDaemonSeenSet
+{
+    uint64_t *hashes;
+    uint32_t capacity; // NOTE: (sonictk) Always a power of two.
+    uint32_t numHashes;
+} MayaDaemonSeenSet;
+
+typedef struct MayaDaemonDir
+{
+    const char *path;
+    HANDLE hDir;
+    OVERLAPPED overlapped;
+    DWORD notifyBuffer[MAYA_DAEMON_NOTIFY_BUFFER_SIZE / sizeof(DWORD)]; // NOTE: (sonictk) Must be DWORD-aligned.
+} MayaDaemonDir;
+
+typedef struct MayaDaemon
+{
+    // NOTE: (sonictk) Only touched by the watcher thread.
+    MayaDaemonDir dirs[MAYA_DAEMON_MAX_DIRS];
+    uint32_t numDirs;
+    char pending[MAYA_DAEMON_MAX_PENDING][MAX_PATH];
+    uint32_t numPending;
+    MayaDaemonSeenSet seen;
+    char checkpointPath[MAX_PATH];
+
+    // NOTE: (sonictk) The bounded queue between the watcher and the workers.
+    char queue[MAYA_DAEMON_QUEUE_CAPACITY][MAX_PATH];
+    uint32_t queueHead;
+    uint32_t queueTail;
+    CRITICAL_SECTION queueLock;
+    HANDLE hQueueSlotsFree;
+    HANDLE hQueueItemsAvailable;
+
+    // NOTE: (sonictk) Updated by the workers, read by the pipe server and the checkpoints.
+    SRWLOCK countsLock;
+    MayaDaemonCountTable counts;
+    uint64_t numDumps;
+    uint64_t numFailedDumps;
+    bool dirty;
+
+    HANDLE hStopEvent;
+} MayaDaemon;
+
+static MayaDaemon gMayaDaemon;
+
+
+/// FNV-1a, continued from ``hash``.
+static uint64_t hashMayaDaemonBytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i=0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+static uint64_t hashMayaDaemonCountKey(uint32_t category, const char *key)
+{
+    uint64_t hash = hashMayaDaemonBytes(14695981039346656037ULL, &category, sizeof(category));
+
+    return hashMayaDaemonBytes(hash, key, strlen(key));
+}
+
+
+/// Adds ``count`` to the total for the given key. Must be called with the counts lock held exclusively.
+static bool addMayaDaemonCount(MayaDaemonCountTable *table, uint32_t category, const char *key, uint64_t count)
+{
+    if ((table->numCounts + 1) * 2 > table->capacity) {
+        MayaDaemonCountTable newTable = {0};
+        newTable.capacity = table->capacity == 0 ? MAYA_DAEMON_TABLE_INITIAL_CAPACITY : table->capacity * 2;
+        newTable.counts = (MayaDaemonCount *)calloc(newTable.capacity, sizeof(MayaDaemonCount));
+        if (newTable.counts == NULL) {
+            return false;
+        }
+        for (uint32_t i=0; i < table->capacity; ++i) {
+            if (table->counts[i].count != 0) {
+                addMayaDaemonCount(&newTable, table->counts[i].category, table->counts[i].key, table->counts[i].count);
+            }
+        }
+        free(table->counts);
+        *table = newTable;
+    }
+
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i=(uint32_t)hashMayaDaemonCountKey(category, key) & mask;; i=(i + 1) & mask) {
+        MayaDaemonCount *entry = &table->counts[i];
+        if (entry->count == 0) {
+            entry->category = category;
+            strncpy(entry->key, key, MAYA_DAEMON_KEY_LEN - 1);
+            entry->key[MAYA_DAEMON_KEY_LEN - 1] = '\0';
+            entry->count = count;
+            ++table->numCounts;
+            return true;
+        }
+        if (entry->category == category && strncmp(entry->key, key, MAYA_DAEMON_KEY_LEN - 1) == 0) {
+            entry->count += count;
+            return true;
+        }
+    }
+}
+
+
+/// Adds the hash to the set. Returns ``false`` if it was already in it (or if we're out of memory).
+static bool addMayaDaemonSeen(MayaDaemonSeenSet *set, uint64_t hash)
+{
+    hash = hash == 0 ? 1 : hash;
+    if ((set->numHashes + 1) * 2 > set->capacity) {
+        MayaDaemonSeenSet newSet = {0};
+        newSet.capacity = set->capacity == 0 ? MAYA_DAEMON_TABLE_INITIAL_CAPACITY : set->capacity * 2;
+        newSet.hashes = (uint64_t *)calloc(newSet.capacity, sizeof(uint64_t));
+        if (newSet.hashes == NULL) {
+            return false;
+        }
+        for (uint32_t i=0; i < set->capacity; ++i) {
+            if (set->hashes[i] != 0) {
+                addMayaDaemonSeen(&newSet, set->hashes[i]);
+            }
+        }
+        free(set->hashes);
+        *set = newSet;
+    }
+
+    uint32_t mask = set->capacity - 1;
+    for (uint32_t i=(uint32_t)hash & mask;; i=(i + 1) & mask) {
+        if (set->hashes[i] == hash) {
+            return false;
+        }
+        if (set->hashes[i] == 0) {
+            set->hashes[i] = hash;
+            ++set->numHashes;
+            return true;
+        }
+    }
+}
+
+
+/// Writes the totals and the dumps seen so far to disk. Written to a temporary file first, so that
+/// a checkpoint is never left half-written.
+static bool writeMayaDaemonCheckpoint(MayaDaemon *daemon)
+{
+    char tempPath[MAX_PATH] = {0};
+    snprintf(tempPath, MAX_PATH, "%s.tmp", daemon->checkpointPath);
+    FILE *file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    AcquireSRWLockExclusive(&daemon->countsLock);
+    MayaDaemonCheckpointHeader header = {0};
+    header.magic = MAYA_DAEMON_CHECKPOINT_MAGIC;
+    header.version = MAYA_DAEMON_CHECKPOINT_VERSION;
+    header.numDumps = daemon->numDumps;
+    header.numFailedDumps = daemon->numFailedDumps;
+    header.numCounts = daemon->counts.numCounts;
+    header.numSeen = daemon->seen.numHashes;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (uint32_t i=0; i < daemon->counts.capacity && written; ++i) {
+        if (daemon->counts.counts[i].count != 0) {
+            written = fwrite(&daemon->counts.counts[i], sizeof(MayaDaemonCount), 1, file) == 1;
+        }
+    }
+    daemon->dirty = false;
+    ReleaseSRWLockExclusive(&daemon->countsLock);
+
+    // NOTE: (sonictk) The seen set is only ever touched from the watcher thread, which is us.
+    for (uint32_t i=0; i < daemon->seen.capacity && written; ++i) {
+        if (daemon->seen.hashes[i] != 0) {
+            written = fwrite(&daemon->seen.hashes[i], sizeof(uint64_t), 1, file) == 1;
+        }
+    }
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        DeleteFile(tempPath);
+        return false;
+    }
+
+    return MoveFileEx(tempPath, daemon->checkpointPath, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH) == TRUE;
+}
+
+
+static bool readMayaDaemonCheckpoint(MayaDaemon *daemon)
+{
+    FILE *file = fopen(daemon->checkpointPath, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    MayaDaemonCheckpointHeader header = {0};
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == MAYA_DAEMON_CHECKPOINT_MAGIC
+        && header.version == MAYA_DAEMON_CHECKPOINT_VERSION;
+    MayaDaemonCount count;
+    for (uint32_t i=0; i < header.numCounts && valid; ++i) {
+        valid = fread(&count, sizeof(count), 1, file) == 1 && count.category < MayaDaemonCategory_Count;
+        count.key[MAYA_DAEMON_KEY_LEN - 1] = '\0';
+        valid = valid && addMayaDaemonCount(&daemon->counts, count.category, count.key, count.count);
+    }
+    uint64_t hash = 0;
+    for (uint32_t i=0; i < header.numSeen && valid; ++i) {
+        valid = fread(&hash, sizeof(hash), 1, file) == 1;
+        if (valid) {
+            addMayaDaemonSeen(&daemon->seen, hash);
+        }
+    }
+    fclose(file);
+    if (!valid) {
+        printf("WARNING: The checkpoint %s is damaged; starting the counts from scratch.\n", daemon->checkpointPath);
+        free(daemon->counts.counts);
+        free(daemon->seen.hashes);
+        memset(&daemon->counts, 0, sizeof(daemon->counts));
+        memset(&daemon->seen, 0, sizeof(daemon->seen));
+        return false;
+    }
+    daemon->numDumps = header.numDumps;
+    daemon->numFailedDumps = header.numFailedDumps;
+
+    return true;
+}
+
+
+/// Reads a dump and adds it to the totals. Called from the workers.
+static void ingestMayaDaemonDump(MayaDaemon *daemon, const char *path)
+{
+    char keys[MayaDaemonCategory_Count][MAYA_DAEMON_KEY_LEN];
+    memset(keys, 0, sizeof(keys));
+
+    // NOTE: (sonictk) Bucket by the same fingerprint that crash loops are detected with, if the
+    // sidecar is there. Otherwise, go by where the crash happened.
+    MayaDiffDump dump;
+    bool opened = openMayaDiffDump(path, &dump);
+    char sidecarPath[MAX_PATH] = {0};
+    snprintf(sidecarPath, MAX_PATH, "%s%s", path, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+    MayaCrashSidecar sidecar;
+    if (readMayaFixedSizeFile(sidecarPath, &sidecar, sizeof(sidecar))
+        && sidecar.magic == MAYA_CRASH_SIDECAR_MAGIC
+        && sidecar.version == MAYA_CRASH_SIDECAR_VERSION) {
+        snprintf(keys[MayaDaemonCategory_Bucket], MAYA_DAEMON_KEY_LEN, "%016llx", sidecar.fingerprint);
+    } else if (opened && dump.exception != NULL) {
+        snprintf(keys[MayaDaemonCategory_Bucket], MAYA_DAEMON_KEY_LEN, "0x%08x %s", dump.exception->ExceptionRecord.ExceptionCode, dump.exceptionFrame);
+    }
+    if (opened && dump.crashInfo != NULL) {
+        snprintf(keys[MayaDaemonCategory_MayaVersion], MAYA_DAEMON_KEY_LEN, "%d", dump.crashInfo->verAPI);
+        snprintf(keys[MayaDaemonCategory_LastDGNode], MAYA_DAEMON_KEY_LEN, "%.*s", MAYA_DG_NODE_MAX_NAME_LEN, dump.crashInfo->lastDGNodeAddedName);
+    }
+    if (opened && dump.comments[0] != NULL) {
+        snprintf(keys[MayaDaemonCategory_Scene], MAYA_DAEMON_KEY_LEN, "%.*s", (int)strnlen(dump.comments[0], dump.lenComments[0]), dump.comments[0]);
+    }
+    closeMayaDiffDump(&dump);
+
+    AcquireSRWLockExclusive(&daemon->countsLock);
+    if (!opened) {
+        ++daemon->numFailedDumps;
+    } else {
+        ++daemon->numDumps;
+        for (uint32_t i=0; i < MayaDaemonCategory_Count; ++i) {
+            addMayaDaemonCount(&daemon->counts, i, keys[i][0] == '\0' ? "unknown" : keys[i], 1);
+        }
+    }
+    daemon->dirty = true;
+    ReleaseSRWLockExclusive(&daemon->countsLock);
+
+    printf("%s %s\n", opened ? "Counted" : "ERROR: Could not read", path);
+
+    return;
+}
+
+
+static DWORD WINAPI mayaDaemonWorkerThreadProc(LPVOID lpParameter)
+{
+    MayaDaemon *daemon = (MayaDaemon *)lpParameter;
+    HANDLE handles[2] = {daemon->hStopEvent, daemon->hQueueItemsAvailable};
+    char path[MAX_PATH];
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        EnterCriticalSection(&daemon->queueLock);
+        memcpy(path, daemon->queue[daemon->queueHead], MAX_PATH);
+        daemon->queueHead = (daemon->queueHead + 1) % MAYA_DAEMON_QUEUE_CAPACITY;
+        LeaveCriticalSection(&daemon->queueLock);
+        ReleaseSemaphore(daemon->hQueueSlotsFree, 1, NULL);
+
+        ingestMayaDaemonDump(daemon, path);
+    }
+
+    return 0;
+}
+
+
+/**
+ * Hands a dump to the workers. This is where the back-pressure comes from: if the queue is full,
+ * the watcher waits here for a slot instead of queueing any more.
+ *
+ * @return  ``false`` if the daemon was stopped while waiting.
+ */
+static bool enqueueMayaDaemonDump(MayaDaemon *daemon, const char *path)
+{
+    HANDLE handles[2] = {daemon->hStopEvent, daemon->hQueueSlotsFree};
+    if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+        return false;
+    }
+    EnterCriticalSection(&daemon->queueLock);
+    strncpy(daemon->queue[daemon->queueTail], path, MAX_PATH - 1);
+    daemon->queue[daemon->queueTail][MAX_PATH - 1] = '\0';
+    daemon->queueTail = (daemon->queueTail + 1) % MAYA_DAEMON_QUEUE_CAPACITY;
+    LeaveCriticalSection(&daemon->queueLock);
+    ReleaseSemaphore(daemon->hQueueItemsAvailable, 1, NULL);
+
+    return true;
+}
+
+
+static void addMayaDaemonPending(MayaDaemon *daemon, const char *path)
+{
+    for (uint32_t i=0; i < daemon->numPending; ++i) {
+        if (_stricmp(daemon->pending[i], path) == 0) {
+            return;
+        }
+    }
+    // NOTE: (sonictk) If there are this many dumps still being written, the rest will be found by
+    // the next rescan once some of these are done.
+    if (daemon->numPending == MAYA_DAEMON_MAX_PENDING) {
+        return;
+    }
+    strncpy(daemon->pending[daemon->numPending], path, MAX_PATH - 1);
+    daemon->pending[daemon->numPending++][MAX_PATH - 1] = '\0';
+
+    return;
+}
+
+
+/// Queues the pending dumps that have been closed by whoever was writing them.
+static bool processMayaDaemonPending(MayaDaemon *daemon)
+{
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    const uint64_t nowTime = ((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime;
+
+    uint32_t i = 0;
+    while (i < daemon->numPending) {
+        const char *path = daemon->pending[i];
+        // NOTE: (sonictk) Opening the dump without sharing it only succeeds once no one else has
+        // it open, i.e. once it has been written out completely.
+        HANDLE hFile = CreateFile(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            DWORD err = GetLastError();
+            if (err == ERROR_SHARING_VIOLATION || err == ERROR_LOCK_VIOLATION) {
+                ++i;
+            } else {
+                memcpy(daemon->pending[i], daemon->pending[--daemon->numPending], MAX_PATH);
+            }
+            continue;
+        }
+        BY_HANDLE_FILE_INFORMATION fileInfo;
+        BOOL gotInfo = GetFileInformationByHandle(hFile, &fileInfo);
+        CloseHandle(hFile);
+        if (gotInfo == FALSE) {
+            memcpy(daemon->pending[i], daemon->pending[--daemon->numPending], MAX_PATH);
+            continue;
+        }
+
+        const uint64_t lastWriteTime = ((uint64_t)fileInfo.ftLastWriteTime.dwHighDateTime << 32) | fileInfo.ftLastWriteTime.dwLowDateTime;
+        char sidecarPath[MAX_PATH] = {0};
+        snprintf(sidecarPath, MAX_PATH, "%s%s", path, MAYA_CRASH_SIDECAR_FILE_EXTENSION);
+        if (GetFileAttributes(sidecarPath) == INVALID_FILE_ATTRIBUTES && nowTime < lastWriteTime + MAYA_DAEMON_SIDECAR_WAIT_MS * 10000ULL) {
+            ++i;
+            continue;
+        }
+
+        // NOTE: (sonictk) The same dump moved between spools keeps its size and time, so it is
+        // only counted once.
+        char fullPath[MAX_PATH] = {0};
+        GetFullPathName(path, MAX_PATH, fullPath, NULL);
+        const char *fileName = strrchr(fullPath, '\\');
+        fileName = fileName == NULL ? fullPath : fileName + 1;
+        uint64_t hash = hashMayaDaemonBytes(14695981039346656037ULL, fileName, strlen(fileName));
+        hash = hashMayaDaemonBytes(hash, &fileInfo.nFileSizeLow, sizeof(fileInfo.nFileSizeLow));
+        hash = hashMayaDaemonBytes(hash, &fileInfo.nFileSizeHigh, sizeof(fileInfo.nFileSizeHigh));
+        hash = hashMayaDaemonBytes(hash, &lastWriteTime, sizeof(lastWriteTime));
+        // NOTE: (sonictk) Once it has been marked as seen, the dump has to be counted, or it would
+        // never be picked up again.
+        if (addMayaDaemonSeen(&daemon->seen, hash) && !enqueueMayaDaemonDump(daemon, path)) {
+            ingestMayaDaemonDump(daemon, path);
+            return false;
+        }
+        memcpy(daemon->pending[i], daemon->pending[--daemon->numPending], MAX_PATH);
+    }
+
+    return true;
+}
+
+
+/// Finds every dump in the directory. Used at startup and whenever notifications were dropped.
+static void rescanMayaDaemonDir(MayaDaemon *daemon, const MayaDaemonDir *dir)
+{
+    char searchPath[MAX_PATH] = {0};
+    char filePath[MAX_PATH] = {0};
+    snprintf(searchPath, MAX_PATH, "%s\\%s", dir->path, MAYA_DIFF_DUMP_FILE_PATTERN);
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(searchPath, &findData);
+    for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE; bStat = FindNextFile(hFind, &findData)) {
+        snprintf(filePath, MAX_PATH, "%s\\%s", dir->path, findData.cFileName);
+        addMayaDaemonPending(daemon, filePath);
+    }
+    if (hFind != INVALID_HANDLE_VALUE) {
+        FindClose(hFind);
+    }
+
+    return;
+}
+
+
+static bool watchMayaDaemonDir(MayaDaemonDir *dir)
+{
+    return ReadDirectoryChangesW(dir->hDir,
+                                 dir->notifyBuffer,
+                                 sizeof(dir->notifyBuffer),
+                                 FALSE,
+                                 FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_LAST_WRITE|FILE_NOTIFY_CHANGE_SIZE,
+                                 NULL,
+                                 &dir->overlapped,
+                                 NULL) == TRUE;
+}
+
+
+/// Picks the dumps out of a batch of directory notifications.
+static void readMayaDaemonNotifications(MayaDaemon *daemon, MayaDaemonDir *dir, DWORD numBytes)
+{
+    // NOTE: (sonictk) No bytes means that the notifications overflowed the buffer and were dropped.
+    if (numBytes == 0) {
+        rescanMayaDaemonDir(daemon, dir);
+        return;
+    }
+
+    const uint8_t *notifyBuffer = (const uint8_t *)dir->notifyBuffer;
+    char fileName[MAX_PATH] = {0};
+    char filePath[MAX_PATH] = {0};
+    for (DWORD offset=0;;) {
+        const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)(notifyBuffer + offset);
+        if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+            int lenFileName = WideCharToMultiByte(CP_ACP, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)),
+                                                  fileName, MAX_PATH - 1, NULL, NULL);
+            fileName[lenFileName > 0 ? lenFileName : 0] = '\0';
+            const char *ext = strrchr(fileName, '.');
+            if (ext != NULL && _stricmp(ext, MAYA_DIFF_DUMP_FILE_PATTERN + 1) == 0) {
+                snprintf(filePath, MAX_PATH, "%s\\%s", dir->path, fileName);
+                addMayaDaemonPending(daemon, filePath);
+            }
+        }
+        if (info->NextEntryOffset == 0) {
+            break;
+        }
+        offset += info->NextEntryOffset;
+    }
+
+    return;
+}
+
+
+/// Appends a string to the report as a JSON string literal.
+static void appendMayaDaemonJSONString(MayaDiffReport *report, const char *str)
+{
+    appendMayaDiffReport(report, "\"");
+    for (const char *c=str; *c != '\0'; ++c) {
+        unsigned char ch = (unsigned char)*c;
+        if (ch == '"' || ch == '\\') {
+            appendMayaDiffReport(report, "\\%c", ch);
+        } else if (ch < 0x20) {
+            appendMayaDiffReport(report, "\\u%04x", ch);
+        } else {
+            appendMayaDiffReport(report, "%c", ch);
+        }
+    }
+    appendMayaDiffReport(report, "\"");
+}
+
+
+static int compareMayaDaemonCounts(const void *a, const void *b)
+{
+    const MayaDaemonCount *countA = *(const MayaDaemonCount **)a;
+    const MayaDaemonCount *countB = *(const MayaDaemonCount **)b;
+    if (countA->category != countB->category) {
+        return countA->category < countB->category ? -1 : 1;
+    }
+
+    return countA->count == countB->count ? 0 : countA->count > countB->count ? -1 : 1;
+}
+
+
+/// Formats the totals as JSON, most common first within each category.
+static void formatMayaDaemonCounts(MayaDaemon *daemon, MayaDiffReport *report)
+{
+    AcquireSRWLockShared(&daemon->countsLock);
+    const MayaDaemonCount **sorted = (const MayaDaemonCount **)malloc((daemon->counts.numCounts + 1) * sizeof(MayaDaemonCount *));
+    uint32_t numSorted = 0;
+    if (sorted != NULL) {
+        for (uint32_t i=0; i < daemon->counts.capacity; ++i) {
+            if (daemon->counts.counts[i].count != 0) {
+                sorted[numSorted++] = &daemon->counts.counts[i];
+            }
+        }
+        qsort((void *)sorted, numSorted, sizeof(sorted[0]), compareMayaDaemonCounts);
+    }
+
+    appendMayaDiffReport(report, "{\"dumps\":%llu,\"failed_dumps\":%llu", daemon->numDumps, daemon->numFailedDumps);
+    uint32_t idx = 0;
+    for (uint32_t category=0; category < MayaDaemonCategory_Count; ++category) {
+        appendMayaDiffReport(report, ",\"%s\":[", kMayaDaemonCategoryNames[category]);
+        uint32_t numServed = 0;
+        for (; idx < numSorted && sorted[idx]->category == category; ++idx) {
+            if (numServed++ >= MAYA_DAEMON_MAX_KEYS_SERVED) {
+                continue;
+            }
+            appendMayaDiffReport(report, "%s{\"key\":", numServed > 1 ? "," : "");
+            appendMayaDaemonJSONString(report, sorted[idx]->key);
+            appendMayaDiffReport(report, ",\"count\":%llu}", sorted[idx]->count);
+        }
+        appendMayaDiffReport(report, "]");
+    }
+    appendMayaDiffReport(report, "}\n");
+    ReleaseSRWLockShared(&daemon->countsLock);
+    free((void *)sorted);
+
+    return;
+}
+
+
+/// Serves the totals to whoever connects to the pipe, one client at a time.
+static DWORD WINAPI mayaDaemonPipeThreadProc(LPVOID lpParameter)
+{
+    MayaDaemon *daemon = (MayaDaemon *)lpParameter;
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    HANDLE handles[2] = {daemon->hStopEvent, overlapped.hEvent};
+    while (WaitForSingleObject(daemon->hStopEvent, 0) == WAIT_TIMEOUT) {
+        HANDLE hPipe = CreateNamedPipe(MAYA_DAEMON_PIPE_NAME,
+                                       PIPE_ACCESS_OUTBOUND|FILE_FLAG_OVERLAPPED,
+                                       PIPE_TYPE_BYTE|PIPE_WAIT|PIPE_REJECT_REMOTE_CLIENTS,
+                                       1, MAYA_DAEMON_NOTIFY_BUFFER_SIZE, 0, 0, NULL);
+        if (hPipe == INVALID_HANDLE_VALUE) {
+            printf("ERROR: Could not create the named pipe %s.\n", MAYA_DAEMON_PIPE_NAME);
+            break;
+        }
+        ResetEvent(overlapped.hEvent);
+        bool connected = ConnectNamedPipe(hPipe, &overlapped) == TRUE || GetLastError() == ERROR_PIPE_CONNECTED;
+        if (!connected && GetLastError() == ERROR_IO_PENDING) {
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+                CancelIo(hPipe);
+                CloseHandle(hPipe);
+                break;
+            }
+            DWORD unused = 0;
+            connected = GetOverlappedResult(hPipe, &overlapped, &unused, FALSE) == TRUE;
+        }
+        if (connected) {
+            MayaDiffReport report = {0};
+            formatMayaDaemonCounts(daemon, &report);
+            DWORD numWritten = 0;
+            ResetEvent(overlapped.hEvent);
+            if (WriteFile(hPipe, report.buf, (DWORD)report.len, &numWritten, &overlapped) == FALSE && GetLastError() == ERROR_IO_PENDING) {
+                GetOverlappedResult(hPipe, &overlapped, &numWritten, TRUE);
+            }
+            FlushFileBuffers(hPipe);
+            DisconnectNamedPipe(hPipe);
+            free(report.buf);
+        }
+        CloseHandle(hPipe);
+    }
+    CloseHandle(overlapped.hEvent);
+
+    return 0;
+}
+
+
+static BOOL WINAPI mayaDaemonCtrlHandler(DWORD ctrlType)
+{
+    (void)ctrlType;
+    SetEvent(gMayaDaemon.hStopEvent);
+
+    return TRUE;
+}
+
+
+/**
+ * Watches the given spool directories for new dumps until stopped with Ctrl+C, keeping running
+ * totals of the crashes in them.
+ *
+ * @param dirPaths      The directories to watch.
+ * @param numDirs       The number of directories given.
+ *
+ * @return              ``0`` if the daemon was stopped cleanly, ``1`` otherwise.
+ */
+int runMayaDumpDaemon(char **dirPaths, uint32_t numDirs)
+{
+    MayaDaemon *daemon = &gMayaDaemon;
+    if (numDirs > MAYA_DAEMON_MAX_DIRS) {
+        printf("ERROR: Only up to %d directories can be watched at once.\n", MAYA_DAEMON_MAX_DIRS);
+        return 1;
+    }
+
+    // NOTE: (sonictk) The checkpoint lives with the first spool, so that it survives a move to
+    // another triage box along with it.
+    snprintf(daemon->checkpointPath, MAX_PATH, "%s\\%s", dirPaths[0], MAYA_DAEMON_CHECKPOINT_FILE_NAME);
+    InitializeSRWLock(&daemon->countsLock);
+    InitializeCriticalSection(&daemon->queueLock);
+    daemon->hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    daemon->hQueueSlotsFree = CreateSemaphore(NULL, MAYA_DAEMON_QUEUE_CAPACITY, MAYA_DAEMON_QUEUE_CAPACITY, NULL);
+    daemon->hQueueItemsAvailable = CreateSemaphore(NULL, 0, MAYA_DAEMON_QUEUE_CAPACITY, NULL);
+    if (daemon->hStopEvent == NULL || daemon->hQueueSlotsFree == NULL || daemon->hQueueItemsAvailable == NULL) {
+        printf("ERROR: Could not create the synchronization objects.\n");
+        return 1;
+    }
+    if (readMayaDaemonCheckpoint(daemon)) {
+        printf("Resuming from %s: %llu dumps counted so far.\n", daemon->checkpointPath, daemon->numDumps);
+    }
+
+    HANDLE waitHandles[MAYA_DAEMON_MAX_DIRS + 1];
+    waitHandles[0] = daemon->hStopEvent;
+    for (uint32_t i=0; i < numDirs; ++i) {
+        MayaDaemonDir *dir = &daemon->dirs[daemon->numDirs];
+        dir->path = dirPaths[i];
+        dir->hDir = CreateFile(dir->path, FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, NULL);
+        dir->overlapped.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (dir->hDir == INVALID_HANDLE_VALUE || dir->overlapped.hEvent == NULL || !watchMayaDaemonDir(dir)) {
+            printf("ERROR: Could not watch %s.\n", dir->path);
+            return 1;
+        }
+        waitHandles[++daemon->numDirs] = dir->overlapped.hEvent;
+        rescanMayaDaemonDir(daemon, dir);
+    }
+
+    SetConsoleCtrlHandler(mayaDaemonCtrlHandler, TRUE);
+
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    uint32_t numWorkers = sysInfo.dwNumberOfProcessors > MAYA_DAEMON_MAX_WORKERS ? MAYA_DAEMON_MAX_WORKERS : sysInfo.dwNumberOfProcessors;
+    numWorkers = numWorkers == 0 ? 1 : numWorkers;
+    HANDLE threads[MAYA_DAEMON_MAX_WORKERS + 1];
+    uint32_t numThreads = 0;
+    for (uint32_t i=0; i < numWorkers; ++i) {
+        threads[numThreads] = CreateThread(NULL, 0, mayaDaemonWorkerThreadProc, daemon, 0, NULL);
+        numThreads += threads[numThreads] != NULL ? 1 : 0;
+    }
+    threads[numThreads] = CreateThread(NULL, 0, mayaDaemonPipeThreadProc, daemon, 0, NULL);
+    numThreads += threads[numThreads] != NULL ? 1 : 0;
+    if (numThreads < 2) {
+        printf("ERROR: Could not start the worker threads.\n");
+        SetEvent(daemon->hStopEvent);
+    }
+
+    printf("Watching %u directories with %u workers; the totals are served on %s. Press Ctrl+C to stop.\n",
+           daemon->numDirs, numWorkers, MAYA_DAEMON_PIPE_NAME);
+
+    ULONGLONG lastCheckpointTime = GetTickCount64();
+    for (;;) {
+        if (!processMayaDaemonPending(daemon)) {
+            break;
+        }
+        // NOTE: (sonictk) Wake up every so often to retry the dumps still being written.
+        DWORD waitResult = WaitForMultipleObjects(daemon->numDirs + 1, waitHandles, FALSE,
+                                                  daemon->numPending > 0 ? MAYA_DAEMON_RETRY_INTERVAL_MS : MAYA_DAEMON_CHECKPOINT_INTERVAL_MS);
+        if (waitResult == WAIT_OBJECT_0) {
+            break;
+        }
+        if (waitResult > WAIT_OBJECT_0 && waitResult <= WAIT_OBJECT_0 + daemon->numDirs) {
+            MayaDaemonDir *dir = &daemon->dirs[waitResult - WAIT_OBJECT_0 - 1];
+            DWORD numBytes = 0;
+            if (GetOverlappedResult(dir->hDir, &dir->overlapped, &numBytes, FALSE) == FALSE) {
+                numBytes = 0;
+            }
+            readMayaDaemonNotifications(daemon, dir, numBytes);
+            if (!watchMayaDaemonDir(dir)) {
+                printf("ERROR: Stopped being able to watch %s.\n", dir->path);
+                break;
+            }
+        }
+        if (daemon->dirty && GetTickCount64() - lastCheckpointTime >= MAYA_DAEMON_CHECKPOINT_INTERVAL_MS) {
+            if (!writeMayaDaemonCheckpoint(daemon)) {
+                printf("WARNING: Could not write the checkpoint %s.\n", daemon->checkpointPath);
+            }
+            lastCheckpointTime = GetTickCount64();
+        }
+    }
+
+    SetEvent(daemon->hStopEvent);
+    WaitForMultipleObjects(numThreads, threads, TRUE, INFINITE);
+    for (uint32_t i=0; i < numThreads; ++i) {
+        CloseHandle(threads[i]);
+    }
+    for (uint32_t i=0; i < daemon->numDirs; ++i) {
+        CancelIo(daemon->dirs[i].hDir);
+        CloseHandle(daemon->dirs[i].hDir);
+        CloseHandle(daemon->dirs[i].overlapped.hEvent);
+    }
+
+    // NOTE: (sonictk) The workers stop without emptying the queue; count whatever is left in it
+    // here, since it has already been marked as seen.
+    while (WaitForSingleObject(daemon->hQueueItemsAvailable, 0) == WAIT_OBJECT_0) {
+        ingestMayaDaemonDump(daemon, daemon->queue[daemon->queueHead]);
+        daemon->queueHead = (daemon->queueHead + 1) % MAYA_DAEMON_QUEUE_CAPACITY;
+    }
+    int result = 0;
+    if (!writeMayaDaemonCheckpoint(daemon)) {
+        printf("ERROR: Could not write the checkpoint %s.\n", daemon->checkpointPath);
+        result = 1;
+    }
+    printf("Stopped after counting %llu dumps (%llu could not be read).\n", daemon->numDumps, daemon->numFailedDumps);
+
+    return result;
+}
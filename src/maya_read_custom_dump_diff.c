@@ -0,0 +1,652 @@
+/**
+ * @file   maya_read_custom_dump_diff.c
+ * @brief  Compares dumps against a baseline dump and reports what differs between them: the
+ *         modules loaded and their versions, the crash info and breadcrumb streams, the
+ *         exception and the top frame of every thread. Meant for when the same scene crashes
+ *         differently on two farm nodes. The dumps are only mapped and looked up through their
+ *         stream directories, never fully parsed, so that a whole spool of dumps can be compared
+ *         against the baseline in parallel.
+ */
+#define MAYA_DIFF_MAX_WORKERS 32
+#define MAYA_DIFF_MODULE_NAME_LEN 64
+#define MAYA_DIFF_FRAME_LEN 96
+#define MAYA_DIFF_DUMP_FILE_PATTERN "*.dmp"
+
+/// NOTE: (sonictk) The order in which the ``CommentStreamA`` streams are written by the plugin.
+static const char *kMayaDiffCommentStreamNames[] = {"Scene", "Timing", "Last MEL command"};
+
+typedef struct MayaDiffModule
+{
+    char name[MAYA_DIFF_MODULE_NAME_LEN];
+    uint64_t baseOfImage;
+    uint32_t sizeOfImage;
+    uint32_t timeDateStamp;
+    uint32_t checkSum;
+    uint32_t versionMS; // NOTE: (sonictk) ``0`` for both if the module has no version resource.
+    uint32_t versionLS;
+} MayaDiffModule;
+
+/// A mapped dump, along with the bits of it that get compared.
+typedef struct MayaDiffDump
+{
+    const char *path;
+    HANDLE hFile;
+    HANDLE hMapFile;
+    const uint8_t *view;
+    uint64_t size;
+
+    MayaDiffModule *modules; // NOTE: (sonictk) Sorted by name.
+    uint32_t numModules;
+
+    char (*topFrames)[MAYA_DIFF_FRAME_LEN]; // NOTE: (sonictk) One per thread, sorted.
+    uint32_t numThreads;
+
+    const MayaCrashDumpInfo *crashInfo;
+    const char *comments[ARRAY_SIZE(kMayaDiffCommentStreamNames)];
+    ULONG lenComments[ARRAY_SIZE(kMayaDiffCommentStreamNames)];
+    const MINIDUMP_EXCEPTION_STREAM *exception;
+    char exceptionFrame[MAYA_DIFF_FRAME_LEN];
+} MayaDiffDump;
+
+/// A growable text buffer. Each dump gets its own, so that the reports of dumps compared in
+/// parallel don't end up interleaved.
+typedef struct MayaDiffReport
+{
+    char *buf;
+    size_t len;
+    size_t capacity;
+    uint32_t numDifferences;
+    bool failed;
+} MayaDiffReport;
+
+typedef struct MayaDiffJob
+{
+    const MayaDiffDump *baseline;
+    char **paths;
+    MayaDiffReport *reports;
+    uint32_t numPaths;
+    volatile LONG nextPath;
+} MayaDiffJob;
+
+
+static void appendMayaDiffReport(MayaDiffReport *report, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int lenFormatted = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (lenFormatted < 0) {
+        return;
+    }
+
+    if (report->len + lenFormatted + 1 > report->capacity) {
+        size_t newCapacity = report->capacity == 0 ? 4096 : report->capacity * 2;
+        while (newCapacity < report->len + lenFormatted + 1) {
+            newCapacity *= 2;
+        }
+        char *newBuf = (char *)realloc(report->buf, newCapacity);
+        if (newBuf == NULL) {
+            return;
+        }
+        report->buf = newBuf;
+        report->capacity = newCapacity;
+    }
+
+    va_start(args, format);
+    vsnprintf(report->buf + report->len, report->capacity - report->len, format, args);
+    va_end(args);
+    report->len += lenFormatted;
+
+    return;
+}
+
+
+/// Returns a pointer to the given range of the dump, or ``NULL`` if it lies outside of the file.
+static const void *getMayaDiffDumpRange(const MayaDiffDump *dump, uint64_t rva, uint64_t size)
+{
+    if (rva > dump->size || size > dump->size - rva) {
+        return NULL;
+    }
+
+    return dump->view + rva;
+}
+
+
+/**
+ * Looks up a stream through the stream directory of the dump. Unlike ``MiniDumpReadDumpStream``,
+ * this can be called from several threads at once, and can find streams of the same type other
+ * than the first one.
+ *
+ * @param dump          The dump to look in.
+ * @param streamType    The type of stream to find.
+ * @param nth           Which of the streams of that type to return, starting from ``0``.
+ * @param streamSize    Storage for the size of the stream.
+ *
+ * @return              The stream, or ``NULL`` if it isn't there.
+ */
+static const void *findMayaDiffDumpStream(const MayaDiffDump *dump, ULONG streamType, uint32_t nth, ULONG *streamSize)
+{
+    const MINIDUMP_HEADER *header = (const MINIDUMP_HEADER *)getMayaDiffDumpRange(dump, 0, sizeof(MINIDUMP_HEADER));
+    if (header == NULL || header->Signature != MINIDUMP_SIGNATURE) {
+        return NULL;
+    }
+    const MINIDUMP_DIRECTORY *dir = (const MINIDUMP_DIRECTORY *)getMayaDiffDumpRange(dump,
+                                                                                      header->StreamDirectoryRva,
+                                                                                      (uint64_t)header->NumberOfStreams * sizeof(MINIDUMP_DIRECTORY));
+    if (dir == NULL) {
+        return NULL;
+    }
+    for (ULONG32 i=0; i < header->NumberOfStreams; ++i) {
+        if (dir[i].StreamType != streamType || nth-- > 0) {
+            continue;
+        }
+        *streamSize = dir[i].Location.DataSize;
+        return getMayaDiffDumpRange(dump, dir[i].Location.Rva, dir[i].Location.DataSize);
+    }
+
+    return NULL;
+}
+
+
+static int compareMayaDiffModuleNames(const void *a, const void *b)
+{
+    return _stricmp(((const MayaDiffModule *)a)->name, ((const MayaDiffModule *)b)->name);
+}
+
+
+static int compareMayaDiffFrames(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+
+/// Formats the given address as ``module+offset``, using the modules of the dump it came from.
+static void formatMayaDiffAddress(const MayaDiffDump *dump, uint64_t addr, char *buf, size_t lenBuf)
+{
+    for (uint32_t i=0; i < dump->numModules; ++i) {
+        const MayaDiffModule *module = &dump->modules[i];
+        if (addr >= module->baseOfImage && addr < module->baseOfImage + module->sizeOfImage) {
+            snprintf(buf, lenBuf, "%s+0x%llx", module->name, addr - module->baseOfImage);
+            return;
+        }
+    }
+
+    snprintf(buf, lenBuf, "0x%llx", addr);
+}
+
+
+/// Reads the instruction pointer out of a thread context stored in the dump, or returns ``0``.
+static uint64_t getMayaDiffContextIP(const MayaDiffDump *dump, const MINIDUMP_LOCATION_DESCRIPTOR *location)
+{
+    if (location->DataSize < sizeof(CONTEXT)) {
+        return 0;
+    }
+    const CONTEXT *context = (const CONTEXT *)getMayaDiffDumpRange(dump, location->Rva, sizeof(CONTEXT));
+
+    return context == NULL ? 0 : context->Rip;
+}
+
+
+static void closeMayaDiffDump(MayaDiffDump *dump)
+{
+    free(dump->modules);
+    free(dump->topFrames);
+    if (dump->view != NULL) {
+        UnmapViewOfFile(dump->view);
+    }
+    if (dump->hMapFile != NULL) {
+        CloseHandle(dump->hMapFile);
+    }
+    if (dump->hFile != INVALID_HANDLE_VALUE && dump->hFile != NULL) {
+        CloseHandle(dump->hFile);
+    }
+    memset(dump, 0, sizeof(MayaDiffDump));
+
+    return;
+}
+
+
+/**
+ * Looks up everything that gets compared in a dump that has been read into memory.
+ *
+ * @param dump      The dump, with ``view`` and ``size`` set.
+ *
+ * @return          ``true`` if the dump was parsed successfully, ``false`` if it ran out of memory.
+ */
+static bool parseMayaDiffDump(MayaDiffDump *dump)
+{
+    ULONG streamSize = 0;
+    const MINIDUMP_MODULE_LIST *moduleList = (const MINIDUMP_MODULE_LIST *)findMayaDiffDumpStream(dump, ModuleListStream, 0, &streamSize);
+    if (moduleList != NULL
+        && streamSize >= sizeof(ULONG32)
+        && (streamSize - sizeof(ULONG32)) / sizeof(MINIDUMP_MODULE) >= moduleList->NumberOfModules) {
+        dump->modules = (MayaDiffModule *)calloc(moduleList->NumberOfModules + 1, sizeof(MayaDiffModule));
+        if (dump->modules == NULL) {
+            return false;
+        }
+        for (ULONG32 i=0; i < moduleList->NumberOfModules; ++i) {
+            const MINIDUMP_MODULE *module = &moduleList->Modules[i];
+            MayaDiffModule *diffModule = &dump->modules[dump->numModules++];
+            diffModule->baseOfImage = module->BaseOfImage;
+            diffModule->sizeOfImage = module->SizeOfImage;
+            diffModule->timeDateStamp = module->TimeDateStamp;
+            diffModule->checkSum = module->CheckSum;
+            if (module->VersionInfo.dwSignature == VS_FFI_SIGNATURE) {
+                diffModule->versionMS = module->VersionInfo.dwFileVersionMS;
+                diffModule->versionLS = module->VersionInfo.dwFileVersionLS;
+            }
+            const MINIDUMP_STRING *moduleName = (const MINIDUMP_STRING *)getMayaDiffDumpRange(dump, module->ModuleNameRva, sizeof(ULONG32));
+            if (moduleName == NULL || getMayaDiffDumpRange(dump, module->ModuleNameRva + sizeof(ULONG32), moduleName->Length) == NULL) {
+                strcpy(diffModule->name, "?");
+                continue;
+            }
+            // NOTE: (sonictk) Only the file name is compared, since the same module can be
+            // installed in different places on different machines.
+            const int lenName = (int)(moduleName->Length / sizeof(WCHAR));
+            int baseNameStart = 0;
+            for (int j=0; j < lenName; ++j) {
+                if (moduleName->Buffer[j] == L'\\' || moduleName->Buffer[j] == L'/') {
+                    baseNameStart = j + 1;
+                }
+            }
+            int lenConverted = WideCharToMultiByte(CP_UTF8, 0, moduleName->Buffer + baseNameStart, lenName - baseNameStart,
+                                                   diffModule->name, MAYA_DIFF_MODULE_NAME_LEN - 1, NULL, NULL);
+            diffModule->name[lenConverted > 0 ? lenConverted : 0] = '\0';
+        }
+        qsort(dump->modules, dump->numModules, sizeof(MayaDiffModule), compareMayaDiffModuleNames);
+    }
+
+    const MINIDUMP_THREAD_LIST *threadList = (const MINIDUMP_THREAD_LIST *)findMayaDiffDumpStream(dump, ThreadListStream, 0, &streamSize);
+    if (threadList != NULL
+        && streamSize >= sizeof(ULONG32)
+        && (streamSize - sizeof(ULONG32)) / sizeof(MINIDUMP_THREAD) >= threadList->NumberOfThreads) {
+        dump->topFrames = (char (*)[MAYA_DIFF_FRAME_LEN])calloc(threadList->NumberOfThreads + 1, MAYA_DIFF_FRAME_LEN);
+        if (dump->topFrames == NULL) {
+            return false;
+        }
+        for (ULONG32 i=0; i < threadList->NumberOfThreads; ++i) {
+            uint64_t ip = getMayaDiffContextIP(dump, &threadList->Threads[i].ThreadContext);
+            formatMayaDiffAddress(dump, ip, dump->topFrames[dump->numThreads++], MAYA_DIFF_FRAME_LEN);
+        }
+        qsort(dump->topFrames, dump->numThreads, MAYA_DIFF_FRAME_LEN, compareMayaDiffFrames);
+    }
+
+    const MayaCrashDumpInfo *crashInfo = (const MayaCrashDumpInfo *)findMayaDiffDumpStream(dump, MAYA_CRASH_INFO_STREAM_TYPE, 0, &streamSize);
+    dump->crashInfo = crashInfo != NULL && isMayaDumpUserStreamSizeValid(MayaDumpUserStream_CrashInfo, streamSize) ? crashInfo : NULL;
+
+    for (uint32_t i=0; i < ARRAY_SIZE(kMayaDiffCommentStreamNames); ++i) {
+        dump->comments[i] = (const char *)findMayaDiffDumpStream(dump, CommentStreamA, i, &dump->lenComments[i]);
+    }
+
+    const MINIDUMP_EXCEPTION_STREAM *exception = (const MINIDUMP_EXCEPTION_STREAM *)findMayaDiffDumpStream(dump, ExceptionStream, 0, &streamSize);
+    if (exception != NULL && streamSize >= sizeof(MINIDUMP_EXCEPTION_STREAM)) {
+        dump->exception = exception;
+        formatMayaDiffAddress(dump, exception->ExceptionRecord.ExceptionAddress, dump->exceptionFrame, MAYA_DIFF_FRAME_LEN);
+    }
+
+    return true;
+}
+
+
+/**
+ * Maps the given dump and looks up everything that gets compared.
+ *
+ * @param path      The dump to open.
+ * @param dump      Storage for the dump. Must be closed with ``closeMayaDiffDump`` even if this fails.
+ *
+ * @return          ``true`` if the dump was opened successfully, ``false`` otherwise.
+ */
+static bool openMayaDiffDump(const char *path, MayaDiffDump *dump)
+{
+    memset(dump, 0, sizeof(MayaDiffDump));
+    dump->path = path;
+    dump->hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (dump->hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(dump->hFile, &fileSize) == FALSE || fileSize.QuadPart == 0) {
+        return false;
+    }
+    dump->size = (uint64_t)fileSize.QuadPart;
+    dump->hMapFile = CreateFileMapping(dump->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (dump->hMapFile == NULL) {
+        return false;
+    }
+    dump->view = (const uint8_t *)MapViewOfFile(dump->hMapFile, FILE_MAP_READ, 0, 0, 0);
+    if (dump->view == NULL) {
+        return false;
+    }
+
+    return parseMayaDiffDump(dump);
+}
+
+
+static void formatMayaDiffModuleVersion(const MayaDiffModule *module, char *buf, size_t lenBuf)
+{
+    snprintf(buf, lenBuf, "%u.%u.%u.%u",
+             (unsigned int)HIWORD(module->versionMS), (unsigned int)LOWORD(module->versionMS),
+             (unsigned int)HIWORD(module->versionLS), (unsigned int)LOWORD(module->versionLS));
+}
+
+
+static void diffMayaDumpModules(MayaDiffReport *report, const MayaDiffDump *a, const MayaDiffDump *b)
+{
+    // NOTE: (sonictk) Both module lists are sorted by name, so walk them side by side.
+    char versionA[32] = {0};
+    char versionB[32] = {0};
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < a->numModules || j < b->numModules) {
+        int order = i == a->numModules ? 1 : j == b->numModules ? -1 : _stricmp(a->modules[i].name, b->modules[j].name);
+        if (order < 0) {
+            formatMayaDiffModuleVersion(&a->modules[i], versionA, sizeof(versionA));
+            appendMayaDiffReport(report, "  Module only in baseline: %s (%s)\n", a->modules[i].name, versionA);
+            ++report->numDifferences;
+            ++i;
+            continue;
+        }
+        if (order > 0) {
+            formatMayaDiffModuleVersion(&b->modules[j], versionB, sizeof(versionB));
+            appendMayaDiffReport(report, "  Module only in dump: %s (%s)\n", b->modules[j].name, versionB);
+            ++report->numDifferences;
+            ++j;
+            continue;
+        }
+
+        const MayaDiffModule *moduleA = &a->modules[i++];
+        const MayaDiffModule *moduleB = &b->modules[j++];
+        if (moduleA->versionMS != moduleB->versionMS || moduleA->versionLS != moduleB->versionLS) {
+            formatMayaDiffModuleVersion(moduleA, versionA, sizeof(versionA));
+            formatMayaDiffModuleVersion(moduleB, versionB, sizeof(versionB));
+            appendMayaDiffReport(report, "  Module version: %s %s -> %s\n", moduleA->name, versionA, versionB);
+            ++report->numDifferences;
+        } else if (moduleA->timeDateStamp != moduleB->timeDateStamp
+                   || moduleA->checkSum != moduleB->checkSum
+                   || moduleA->sizeOfImage != moduleB->sizeOfImage) {
+            // NOTE: (sonictk) Same version, different build; this is usually a studio plugin that
+            // was rebuilt without bumping its version.
+            appendMayaDiffReport(report, "  Module build: %s timestamp 0x%08x -> 0x%08x, size %u -> %u\n", moduleA->name,
+                                 moduleA->timeDateStamp, moduleB->timeDateStamp, moduleA->sizeOfImage, moduleB->sizeOfImage);
+            ++report->numDifferences;
+        }
+    }
+
+    return;
+}
+
+
+static void diffMayaDumpStrings(MayaDiffReport *report, const char *label, const char *a, size_t lenA, const char *b, size_t lenB)
+{
+    lenA = a == NULL ? 0 : strnlen(a, lenA);
+    lenB = b == NULL ? 0 : strnlen(b, lenB);
+    if (lenA == lenB && (lenA == 0 || memcmp(a, b, lenA) == 0)) {
+        return;
+    }
+    appendMayaDiffReport(report, "  %s: \"%.*s\" -> \"%.*s\"\n", label, (int)lenA, lenA == 0 ? "" : a, (int)lenB, lenB == 0 ? "" : b);
+    ++report->numDifferences;
+
+    return;
+}
+
+
+static void diffMayaDumpInts(MayaDiffReport *report, const char *label, int a, int b)
+{
+    if (a == b) {
+        return;
+    }
+    appendMayaDiffReport(report, "  %s: %d -> %d\n", label, a, b);
+    ++report->numDifferences;
+
+    return;
+}
+
+
+static void diffMayaDumpBreadcrumbs(MayaDiffReport *report, const MayaDiffDump *a, const MayaDiffDump *b)
+{
+    for (uint32_t i=0; i < ARRAY_SIZE(kMayaDiffCommentStreamNames); ++i) {
+        diffMayaDumpStrings(report, kMayaDiffCommentStreamNames[i], a->comments[i], a->lenComments[i], b->comments[i], b->lenComments[i]);
+    }
+
+    if (a->crashInfo == NULL || b->crashInfo == NULL) {
+        if (a->crashInfo != b->crashInfo) {
+            appendMayaDiffReport(report, "  Crash info: only in %s\n", a->crashInfo != NULL ? "baseline" : "dump");
+            ++report->numDifferences;
+        }
+        return;
+    }
+
+    const MayaCrashDumpInfo *infoA = a->crashInfo;
+    const MayaCrashDumpInfo *infoB = b->crashInfo;
+    diffMayaDumpInts(report, "Maya API version", infoA->verAPI, infoB->verAPI);
+    diffMayaDumpInts(report, "Custom API version", infoA->verCustom, infoB->verCustom);
+    diffMayaDumpInts(report, "Maya file version", infoA->verMayaFile, infoB->verMayaFile);
+    diffMayaDumpInts(report, "Y is up", infoA->isYUp, infoB->isYUp);
+    diffMayaDumpStrings(report, "Last DAG parent", infoA->lastDagParentName, MAYA_DAG_PATH_MAX_NAME_LEN, infoB->lastDagParentName, MAYA_DAG_PATH_MAX_NAME_LEN);
+    diffMayaDumpStrings(report, "Last DAG child", infoA->lastDagChildName, MAYA_DAG_PATH_MAX_NAME_LEN, infoB->lastDagChildName, MAYA_DAG_PATH_MAX_NAME_LEN);
+    diffMayaDumpInts(report, "Last DAG message", infoA->lastDagMessage, infoB->lastDagMessage);
+    diffMayaDumpStrings(report, "Last DG node added", infoA->lastDGNodeAddedName, MAYA_DG_NODE_MAX_NAME_LEN, infoB->lastDGNodeAddedName, MAYA_DG_NODE_MAX_NAME_LEN);
+
+    return;
+}
+
+
+static void diffMayaDumpThreads(MayaDiffReport *report, const MayaDiffDump *a, const MayaDiffDump *b)
+{
+    if (a->exception != NULL && b->exception != NULL) {
+        if (a->exception->ExceptionRecord.ExceptionCode != b->exception->ExceptionRecord.ExceptionCode
+            || strcmp(a->exceptionFrame, b->exceptionFrame) != 0) {
+            appendMayaDiffReport(report, "  Exception: 0x%08x at %s -> 0x%08x at %s\n",
+                                 a->exception->ExceptionRecord.ExceptionCode, a->exceptionFrame,
+                                 b->exception->ExceptionRecord.ExceptionCode, b->exceptionFrame);
+            ++report->numDifferences;
+        }
+    } else if (a->exception != b->exception) {
+        appendMayaDiffReport(report, "  Exception: only in %s\n", a->exception != NULL ? "baseline" : "dump");
+        ++report->numDifferences;
+    }
+
+    // NOTE: (sonictk) Thread IDs mean nothing across processes, so compare where the threads
+    // were rather than which thread was where: both lists of top frames are sorted, and any
+    // frame that more (or fewer) threads were sitting at is reported.
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < a->numThreads || j < b->numThreads) {
+        const char *frame = i == a->numThreads ? b->topFrames[j]
+            : j == b->numThreads ? a->topFrames[i]
+            : strcmp(a->topFrames[i], b->topFrames[j]) <= 0 ? a->topFrames[i] : b->topFrames[j];
+        int countA = 0;
+        int countB = 0;
+        for (; i < a->numThreads && strcmp(a->topFrames[i], frame) == 0; ++i) {
+            ++countA;
+        }
+        for (; j < b->numThreads && strcmp(b->topFrames[j], frame) == 0; ++j) {
+            ++countB;
+        }
+        if (countA != countB) {
+            appendMayaDiffReport(report, "  Threads at %s: %d -> %d\n", frame, countA, countB);
+            ++report->numDifferences;
+        }
+    }
+
+    return;
+}
+
+
+/// Compares one dump against the baseline and writes what differs into the report.
+static void diffMayaDumpAgainstBaseline(MayaDiffReport *report, const MayaDiffDump *baseline, const char *path)
+{
+    appendMayaDiffReport(report, "--- %s\n+++ %s\n", baseline->path, path);
+
+    MayaDiffDump dump;
+    if (!openMayaDiffDump(path, &dump)) {
+        appendMayaDiffReport(report, "  ERROR: Could not open the dump.\n");
+        report->failed = true;
+        closeMayaDiffDump(&dump);
+        return;
+    }
+
+    diffMayaDumpThreads(report, baseline, &dump);
+    diffMayaDumpBreadcrumbs(report, baseline, &dump);
+    diffMayaDumpModules(report, baseline, &dump);
+    if (report->numDifferences == 0) {
+        appendMayaDiffReport(report, "  No differences.\n");
+    }
+    closeMayaDiffDump(&dump);
+
+    return;
+}
+
+
+static DWORD WINAPI mayaDiffWorkerThreadProc(LPVOID lpParameter)
+{
+    MayaDiffJob *job = (MayaDiffJob *)lpParameter;
+    for (LONG i=InterlockedIncrement(&job->nextPath) - 1; i < (LONG)job->numPaths; i=InterlockedIncrement(&job->nextPath) - 1) {
+        diffMayaDumpAgainstBaseline(&job->reports[i], job->baseline, job->paths[i]);
+    }
+
+    return 0;
+}
+
+
+/// Appends every dump in the given directory (other than the baseline) to the list of paths.
+static bool findMayaDiffSpoolDumps(const char *dirPath, const char *baselinePath, char ***paths, uint32_t *numPaths)
+{
+    char searchPath[MAX_PATH] = {0};
+    snprintf(searchPath, MAX_PATH, "%s\\%s", dirPath, MAYA_DIFF_DUMP_FILE_PATTERN);
+    char baselineFullPath[MAX_PATH] = {0};
+    GetFullPathName(baselinePath, MAX_PATH, baselineFullPath, NULL);
+
+    uint32_t capacity = 0;
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(searchPath, &findData);
+    for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE; bStat = FindNextFile(hFind, &findData)) {
+        char filePath[MAX_PATH] = {0};
+        snprintf(filePath, MAX_PATH, "%s\\%s", dirPath, findData.cFileName);
+        char fullPath[MAX_PATH] = {0};
+        GetFullPathName(filePath, MAX_PATH, fullPath, NULL);
+        if (_stricmp(fullPath, baselineFullPath) == 0) {
+            continue;
+        }
+        if (*numPaths == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            char **newPaths = (char **)realloc(*paths, capacity * sizeof(char *));
+            if (newPaths == NULL) {
+                FindClose(hFind);
+                return false;
+            }
+            *paths = newPaths;
+        }
+        (*paths)[(*numPaths)++] = _strdup(filePath);
+    }
+    if (hFind != INVALID_HANDLE_VALUE) {
+        FindClose(hFind);
+    }
+
+    return true;
+}
+
+
+/**
+ * Compares dumps against a baseline dump and prints what differs for each of them.
+ *
+ * @param baselinePath      The dump to compare against.
+ * @param paths             The dumps to compare. If there is only one and it is a directory,
+ *                          every dump in it is compared against the baseline instead.
+ * @param numPaths          The number of paths given.
+ *
+ * @return                  ``0`` if none of the dumps differ from the baseline, ``1`` if any of
+ *                          them do, or ``2`` if any of them could not be read.
+ */
+int diffMayaDumps(const char *baselinePath, char **paths, uint32_t numPaths)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&startTime);
+
+    MayaDiffDump baseline;
+    if (!openMayaDiffDump(baselinePath, &baseline)) {
+        printf("ERROR: Could not open the baseline dump %s.\n", baselinePath);
+        closeMayaDiffDump(&baseline);
+        return 2;
+    }
+
+    char **spoolPaths = NULL;
+    uint32_t numSpoolPaths = 0;
+    if (numPaths == 1) {
+        DWORD attributes = GetFileAttributes(paths[0]);
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            if (!findMayaDiffSpoolDumps(paths[0], baselinePath, &spoolPaths, &numSpoolPaths)) {
+                printf("ERROR: Out of memory.\n");
+                closeMayaDiffDump(&baseline);
+                return 2;
+            }
+            paths = spoolPaths;
+            numPaths = numSpoolPaths;
+        }
+    }
+
+    MayaDiffJob job = {0};
+    job.baseline = &baseline;
+    job.paths = paths;
+    job.numPaths = numPaths;
+    job.reports = (MayaDiffReport *)calloc(numPaths + 1, sizeof(MayaDiffReport));
+    if (job.reports == NULL) {
+        printf("ERROR: Out of memory.\n");
+        closeMayaDiffDump(&baseline);
+        return 2;
+    }
+
+    // NOTE: (sonictk) The baseline is only ever read from, so the workers can share it. Each dump
+    // is mapped by the worker comparing it, so only as many dumps are mapped at once as there
+    // are workers.
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    uint32_t numWorkers = sysInfo.dwNumberOfProcessors > MAYA_DIFF_MAX_WORKERS ? MAYA_DIFF_MAX_WORKERS : sysInfo.dwNumberOfProcessors;
+    numWorkers = numWorkers > numPaths ? numPaths : numWorkers;
+    HANDLE workers[MAYA_DIFF_MAX_WORKERS];
+    uint32_t numWorkersStarted = 0;
+    for (uint32_t i=0; i < numWorkers; ++i) {
+        workers[numWorkersStarted] = CreateThread(NULL, 0, mayaDiffWorkerThreadProc, &job, 0, NULL);
+        if (workers[numWorkersStarted] != NULL) {
+            ++numWorkersStarted;
+        }
+    }
+    if (numWorkersStarted == 0) {
+        mayaDiffWorkerThreadProc(&job);
+    } else {
+        WaitForMultipleObjects(numWorkersStarted, workers, TRUE, INFINITE);
+        for (uint32_t i=0; i < numWorkersStarted; ++i) {
+            CloseHandle(workers[i]);
+        }
+    }
+
+    uint32_t numDiffering = 0;
+    uint32_t numFailed = 0;
+    for (uint32_t i=0; i < numPaths; ++i) {
+        MayaDiffReport *report = &job.reports[i];
+        if (report->buf != NULL) {
+            fwrite(report->buf, 1, report->len, stdout);
+        }
+        numFailed += report->failed ? 1 : 0;
+        numDiffering += !report->failed && report->numDifferences > 0 ? 1 : 0;
+        free(report->buf);
+    }
+    free(job.reports);
+
+    QueryPerformanceCounter(&endTime);
+    printf("%u of %u dumps differ from the baseline (%u could not be read), compared in %.3f ms using %u threads.\n",
+           numDiffering, numPaths, numFailed,
+           (double)(endTime.QuadPart - startTime.QuadPart) * 1000.0 / (double)freq.QuadPart,
+           numWorkersStarted == 0 ? 1 : numWorkersStarted);
+
+    for (uint32_t i=0; i < numSpoolPaths; ++i) {
+        free(spoolPaths[i]);
+    }
+    free(spoolPaths);
+    closeMayaDiffDump(&baseline);
+
+    return numFailed > 0 ? 2 : numDiffering > 0 ? 1 : 0;
+}
@@ -0,0 +1,947 @@
+/**
+ * @file   maya_read_custom_dump_heap.c
+ * @brief  Works out what filled up the memory of a process from a full-memory dump: a histogram
+ *         of the sizes of the blocks in use in each heap, the largest allocations, and guesses
+ *         at the types of the C++ objects on the heap from the vtable pointers found in it (using
+ *         the MSVC RTTI that the vtables point back to). The memory in the dump is read through
+ *         an index of the ``Memory64ListStream`` over a mapped view of the file, and the heaps
+ *         and regions are split up between worker threads, so that dumps of tens of GB can be
+ *         gone through in minutes.
+ *
+ *         Heaps are walked by the allocators in ``kMayaHeapWalkers``; only the NT heap backend
+ *         is known about so far. Blocks handed out by the low-fragmentation heap show up as the
+ *         single backend block that they were carved out of, and allocators that get their
+ *         memory straight from ``VirtualAlloc`` (e.g. tbbmalloc) show up as private allocations.
+ */
+#define MAYA_HEAP_DEFAULT_NUM_TO_PRINT 20
+#define MAYA_HEAP_MAX_WORKERS 64
+#define MAYA_HEAP_MAX_LARGEST 64
+#define MAYA_HEAP_SCAN_CHUNK_SIZE (64ULL * 1024 * 1024)
+#define MAYA_HEAP_NUM_SIZE_BUCKETS 48
+#define MAYA_HEAP_TYPE_NAME_LEN 256
+#define MAYA_HEAP_VTABLE_TABLE_INITIAL_CAPACITY 4096
+
+/// NOTE: (sonictk) Layout of the x64 NT heap structures that we look at. These have been stable
+/// since Windows 8, but are not documented.
+#define MAYA_NT_HEAP_SEGMENT_SIGNATURE 0xffeeffee
+#define MAYA_NT_HEAP_SEGMENT_SIGNATURE_OFFSET 0x10
+#define MAYA_NT_HEAP_SEGMENT_HEAP_OFFSET 0x28
+#define MAYA_NT_HEAP_SEGMENT_FIRST_ENTRY_OFFSET 0x40
+#define MAYA_NT_HEAP_SEGMENT_LAST_VALID_ENTRY_OFFSET 0x48
+#define MAYA_NT_HEAP_ENCODE_FLAG_MASK_OFFSET 0x7c
+#define MAYA_NT_HEAP_ENCODING_OFFSET 0x80
+#define MAYA_NT_HEAP_ENTRY_SIZE 16
+#define MAYA_NT_HEAP_ENTRY_BUSY 0x01
+#define MAYA_NT_HEAP_ENTRY_LAST_ENTRY 0x10
+
+/// NOTE: (sonictk) The x64 ``RTTICompleteObjectLocator`` that sits just before each vtable.
+typedef struct MayaRTTICompleteObjectLocator
+{
+    uint32_t signature; // NOTE: (sonictk) Always ``1`` on x64, where everything is image-relative.
+    uint32_t offset;
+    uint32_t cdOffset;
+    uint32_t typeDescriptorRVA;
+    uint32_t classDescriptorRVA;
+    uint32_t selfRVA;
+} MayaRTTICompleteObjectLocator;
+
+/// A range of memory in the dump, and where it is in the file.
+typedef struct MayaHeapMemoryRange
+{
+    uint64_t start;
+    uint64_t size;
+    uint64_t fileOffset;
+} MayaHeapMemoryRange;
+
+/// The read-only data section of a module, which is where vtables live.
+typedef struct MayaHeapImageRange
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t imageBase;
+    const char *moduleName;
+} MayaHeapImageRange;
+
+typedef enum MayaHeapWorkItemKind
+{
+    MayaHeapWorkItemKind_Scan = 0, // NOTE: (sonictk) Look for vtable pointers.
+    MayaHeapWorkItemKind_Segment // NOTE: (sonictk) Walk the blocks of a heap segment.
+} MayaHeapWorkItemKind;
+
+typedef struct MayaHeapWorkItem
+{
+    uint64_t start;
+    uint64_t size;
+    uint32_t kind; // NOTE: (sonictk) One of ``MayaHeapWorkItemKind``.
+    uint32_t walkerIdx;
+} MayaHeapWorkItem;
+
+typedef struct MayaHeapAllocation
+{
+    uint64_t address;
+    uint64_t size;
+} MayaHeapAllocation;
+
+/// Maps vtable addresses to the number of pointers to them that were found.
+typedef struct MayaHeapVtableTable
+{
+    uint64_t *keys; // NOTE: (sonictk) ``0`` marks an empty slot.
+    uint64_t *counts;
+    uint32_t capacity; // NOTE: (sonictk) Always a power of two.
+    uint32_t numKeys;
+} MayaHeapVtableTable;
+
+/// What each worker finds. Merged once all of them are done, so that they never share anything.
+typedef struct MayaHeapResults
+{
+    MayaHeapVtableTable vtables;
+    uint64_t blockCounts[MAYA_HEAP_NUM_SIZE_BUCKETS];
+    uint64_t blockBytes[MAYA_HEAP_NUM_SIZE_BUCKETS];
+    uint64_t numBusyBlocks;
+    uint64_t busyBytes;
+    uint64_t freeBytes;
+    uint64_t numBytesScanned;
+    uint32_t numBadSegments;
+    MayaHeapAllocation largest[MAYA_HEAP_MAX_LARGEST];
+    uint32_t numLargest;
+    uint64_t minLargestSize; // NOTE: (sonictk) Once ``largest`` is full, the size of the smallest one in it.
+    bool outOfMemory;
+} MayaHeapResults;
+
+typedef struct MayaHeapDump MayaHeapDump;
+
+/**
+ * A heap implementation that we know how to walk. To support another allocator, add one of these
+ * to ``kMayaHeapWalkers``.
+ */
+typedef struct MayaHeapWalker
+{
+    const char *name;
+    /// Whether the allocation starting at ``allocationBase`` is a segment of this kind of heap.
+    bool (*isSegment)(const MayaHeapDump *heap, uint64_t allocationBase);
+    /// Walks the blocks of the segment, adding them to ``results``.
+    void (*walkSegment)(const MayaHeapDump *heap, uint64_t segment, uint64_t size, MayaHeapResults *results);
+} MayaHeapWalker;
+
+struct MayaHeapDump
+{
+    MayaDiffDump dump;
+
+    MayaHeapMemoryRange *ranges; // NOTE: (sonictk) Sorted by address.
+    uint32_t numRanges;
+
+    MayaHeapImageRange *imageRanges; // NOTE: (sonictk) Sorted by address.
+    uint32_t numImageRanges;
+    uint64_t minImageAddress;
+    uint64_t maxImageAddress;
+
+    MayaHeapWorkItem *items;
+    uint32_t numItems;
+};
+
+typedef struct MayaHeapJob
+{
+    const MayaHeapDump *heap;
+    MayaHeapResults *results; // NOTE: (sonictk) One per worker.
+    volatile LONG nextItem;
+    volatile LONG nextWorker;
+} MayaHeapJob;
+
+
+static bool isMayaNTHeapSegment(const MayaHeapDump *heap, uint64_t allocationBase);
+static void walkMayaNTHeapSegment(const MayaHeapDump *heap, uint64_t segment, uint64_t size, MayaHeapResults *results);
+
+static const MayaHeapWalker kMayaHeapWalkers[] = {
+    {"NT heap", isMayaNTHeapSegment, walkMayaNTHeapSegment}
+};
+
+
+/// Returns the index of the first memory range in the dump that starts after ``address``.
+static uint32_t findNextMayaHeapMemoryRange(const MayaHeapDump *heap, uint64_t address)
+{
+    uint32_t lo = 0;
+    uint32_t hi = heap->numRanges;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (heap->ranges[mid].start <= address) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/**
+ * Finds the given memory in the dump.
+ *
+ * @param heap          The dump.
+ * @param address       The address of the memory in the dumped process.
+ * @param available     Optional storage for the number of bytes from ``address`` that are
+ *                      available contiguously in the dump.
+ *
+ * @return              A pointer to the memory, or ``NULL`` if it isn't in the dump.
+ */
+static const uint8_t *getMayaHeapMemory(const MayaHeapDump *heap, uint64_t address, uint64_t *available)
+{
+    uint32_t lo = findNextMayaHeapMemoryRange(heap, address);
+    if (lo == 0) {
+        return NULL;
+    }
+    const MayaHeapMemoryRange *range = &heap->ranges[lo - 1];
+    if (address - range->start >= range->size) {
+        return NULL;
+    }
+    if (available != NULL) {
+        *available = range->size - (address - range->start);
+    }
+
+    return heap->dump.view + range->fileOffset + (address - range->start);
+}
+
+
+/// Reads ``size`` bytes of the dumped process' memory, or returns ``NULL`` if they aren't all in the dump.
+static const void *readMayaHeapMemory(const MayaHeapDump *heap, uint64_t address, uint64_t size)
+{
+    uint64_t available = 0;
+    const uint8_t *mem = getMayaHeapMemory(heap, address, &available);
+
+    return mem == NULL || available < size ? NULL : mem;
+}
+
+
+static bool readMayaHeapUInt64(const MayaHeapDump *heap, uint64_t address, uint64_t *value)
+{
+    const void *mem = readMayaHeapMemory(heap, address, sizeof(uint64_t));
+    if (mem == NULL) {
+        return false;
+    }
+    memcpy(value, mem, sizeof(uint64_t));
+
+    return true;
+}
+
+
+/// Finds the read-only data section that the address is in, or ``NULL``.
+static const MayaHeapImageRange *findMayaHeapImageRange(const MayaHeapDump *heap, uint64_t address)
+{
+    uint32_t lo = 0;
+    uint32_t hi = heap->numImageRanges;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (heap->imageRanges[mid].start <= address) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0 || address >= heap->imageRanges[lo - 1].end) {
+        return NULL;
+    }
+
+    return &heap->imageRanges[lo - 1];
+}
+
+
+static uint32_t getMayaHeapSizeBucket(uint64_t size)
+{
+    uint32_t bucket = 0;
+    while (size > 1 && bucket < MAYA_HEAP_NUM_SIZE_BUCKETS - 1) {
+        size >>= 1;
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+
+static void addMayaHeapLargestAllocation(MayaHeapResults *results, uint64_t address, uint64_t size)
+{
+    if (results->numLargest < MAYA_HEAP_MAX_LARGEST) {
+        results->largest[results->numLargest].address = address;
+        results->largest[results->numLargest++].size = size;
+    } else if (size > results->minLargestSize) {
+        // NOTE: (sonictk) Replace the smallest one. This is rare enough after the first few heap
+        // segments that finding it again each time doesn't matter.
+        uint32_t idx = 0;
+        for (uint32_t i=1; i < MAYA_HEAP_MAX_LARGEST; ++i) {
+            if (results->largest[i].size < results->largest[idx].size) {
+                idx = i;
+            }
+        }
+        results->largest[idx].address = address;
+        results->largest[idx].size = size;
+    } else {
+        return;
+    }
+    if (results->numLargest == MAYA_HEAP_MAX_LARGEST) {
+        results->minLargestSize = results->largest[0].size;
+        for (uint32_t i=1; i < MAYA_HEAP_MAX_LARGEST; ++i) {
+            if (results->largest[i].size < results->minLargestSize) {
+                results->minLargestSize = results->largest[i].size;
+            }
+        }
+    }
+
+    return;
+}
+
+
+static bool addMayaHeapVtableCount(MayaHeapVtableTable *table, uint64_t vtable, uint64_t count)
+{
+    if ((table->numKeys + 1) * 2 > table->capacity) {
+        MayaHeapVtableTable newTable = {0};
+        newTable.capacity = table->capacity == 0 ? MAYA_HEAP_VTABLE_TABLE_INITIAL_CAPACITY : table->capacity * 2;
+        newTable.keys = (uint64_t *)calloc(newTable.capacity, sizeof(uint64_t));
+        newTable.counts = (uint64_t *)calloc(newTable.capacity, sizeof(uint64_t));
+        if (newTable.keys == NULL || newTable.counts == NULL) {
+            free(newTable.keys);
+            free(newTable.counts);
+            return false;
+        }
+        for (uint32_t i=0; i < table->capacity; ++i) {
+            if (table->keys[i] != 0) {
+                addMayaHeapVtableCount(&newTable, table->keys[i], table->counts[i]);
+            }
+        }
+        free(table->keys);
+        free(table->counts);
+        *table = newTable;
+    }
+
+    // NOTE: (sonictk) Vtables are 8-byte aligned, so drop the low bits before mixing.
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i=(uint32_t)(((vtable >> 3) * 0x9e3779b97f4a7c15ULL) >> 32) & mask;; i=(i + 1) & mask) {
+        if (table->keys[i] == vtable) {
+            table->counts[i] += count;
+            return true;
+        }
+        if (table->keys[i] == 0) {
+            table->keys[i] = vtable;
+            table->counts[i] = count;
+            ++table->numKeys;
+            return true;
+        }
+    }
+}
+
+
+static bool isMayaNTHeapSegment(const MayaHeapDump *heap, uint64_t allocationBase)
+{
+    const uint32_t *signature = (const uint32_t *)readMayaHeapMemory(heap, allocationBase + MAYA_NT_HEAP_SEGMENT_SIGNATURE_OFFSET, sizeof(uint32_t));
+
+    return signature != NULL && *signature == MAYA_NT_HEAP_SEGMENT_SIGNATURE;
+}
+
+
+/// Walks the backend blocks of an NT heap segment, decoding their headers with the key of the heap
+/// that the segment belongs to.
+static void walkMayaNTHeapSegment(const MayaHeapDump *heap, uint64_t segment, uint64_t size, MayaHeapResults *results)
+{
+    uint64_t heapAddress = 0;
+    uint64_t firstEntry = 0;
+    uint64_t lastValidEntry = 0;
+    if (!readMayaHeapUInt64(heap, segment + MAYA_NT_HEAP_SEGMENT_HEAP_OFFSET, &heapAddress)
+        || !readMayaHeapUInt64(heap, segment + MAYA_NT_HEAP_SEGMENT_FIRST_ENTRY_OFFSET, &firstEntry)
+        || !readMayaHeapUInt64(heap, segment + MAYA_NT_HEAP_SEGMENT_LAST_VALID_ENTRY_OFFSET, &lastValidEntry)
+        || firstEntry < segment
+        || lastValidEntry > segment + size
+        || firstEntry >= lastValidEntry) {
+        ++results->numBadSegments;
+        return;
+    }
+    const uint32_t *encodeFlagMask = (const uint32_t *)readMayaHeapMemory(heap, heapAddress + MAYA_NT_HEAP_ENCODE_FLAG_MASK_OFFSET, sizeof(uint32_t));
+    const uint8_t *encoding = (const uint8_t *)readMayaHeapMemory(heap, heapAddress + MAYA_NT_HEAP_ENCODING_OFFSET, MAYA_NT_HEAP_ENTRY_SIZE);
+    if (encodeFlagMask == NULL || encoding == NULL) {
+        ++results->numBadSegments;
+        return;
+    }
+
+    bool walkedCleanly = true;
+    uint64_t entryAddress = firstEntry;
+    while (entryAddress + MAYA_NT_HEAP_ENTRY_SIZE <= lastValidEntry) {
+        uint8_t entry[MAYA_NT_HEAP_ENTRY_SIZE];
+        const uint8_t *mem = (const uint8_t *)readMayaHeapMemory(heap, entryAddress, MAYA_NT_HEAP_ENTRY_SIZE);
+        bool valid = mem != NULL;
+        if (valid) {
+            memcpy(entry, mem, MAYA_NT_HEAP_ENTRY_SIZE);
+            if (*encodeFlagMask != 0) {
+                for (int i=8; i < MAYA_NT_HEAP_ENTRY_SIZE; ++i) {
+                    entry[i] = (uint8_t)(entry[i] ^ encoding[i]);
+                }
+            }
+            // NOTE: (sonictk) The tag index doubles as a checksum of the size and flags.
+            valid = (uint8_t)(entry[8] ^ entry[9] ^ entry[10]) == entry[11];
+        }
+        const uint64_t blockSize = valid ? (uint64_t)(entry[8] | (entry[9] << 8)) * MAYA_NT_HEAP_ENTRY_SIZE : 0;
+
+        if (blockSize != 0 && (entry[10] & MAYA_NT_HEAP_ENTRY_BUSY) != 0) {
+            // NOTE: (sonictk) ``UnusedBytes`` includes the header itself.
+            const uint64_t unusedBytes = entry[15] & 0x3f;
+            const uint64_t userSize = blockSize > unusedBytes ? blockSize - unusedBytes : 0;
+            uint32_t bucket = getMayaHeapSizeBucket(userSize);
+            ++results->blockCounts[bucket];
+            results->blockBytes[bucket] += userSize;
+            ++results->numBusyBlocks;
+            results->busyBytes += blockSize;
+            addMayaHeapLargestAllocation(results, entryAddress + MAYA_NT_HEAP_ENTRY_SIZE, userSize);
+        } else if (blockSize != 0) {
+            results->freeBytes += blockSize;
+        }
+
+        if (blockSize != 0 && (entry[10] & MAYA_NT_HEAP_ENTRY_LAST_ENTRY) == 0) {
+            entryAddress += blockSize;
+            continue;
+        }
+
+        // NOTE: (sonictk) Either the end of the committed part of the segment, or a block we
+        // couldn't make sense of. Carry on from the next committed range in the segment, which
+        // always starts with a block.
+        if (blockSize == 0) {
+            walkedCleanly = false;
+        }
+        uint32_t lo = findNextMayaHeapMemoryRange(heap, entryAddress);
+        if (lo == heap->numRanges || heap->ranges[lo].start >= lastValidEntry) {
+            break;
+        }
+        entryAddress = heap->ranges[lo].start;
+    }
+    if (!walkedCleanly) {
+        ++results->numBadSegments;
+    }
+
+    return;
+}
+
+
+/// Counts every 8-byte aligned value in the range that points into a read-only data section.
+static void scanMayaHeapForVtables(const MayaHeapDump *heap, uint64_t start, uint64_t size, MayaHeapResults *results)
+{
+    const uint64_t end = start + size;
+    uint64_t address = start;
+    while (address < end) {
+        uint64_t available = 0;
+        const uint8_t *mem = getMayaHeapMemory(heap, address, &available);
+        if (mem == NULL) {
+            // NOTE: (sonictk) Not in the dump; skip ahead to the next range that is.
+            uint32_t lo = findNextMayaHeapMemoryRange(heap, address);
+            if (lo == heap->numRanges || heap->ranges[lo].start >= end) {
+                break;
+            }
+            address = heap->ranges[lo].start;
+            continue;
+        }
+        if (available > end - address) {
+            available = end - address;
+        }
+
+        const uint64_t *values = (const uint64_t *)mem;
+        const uint64_t numValues = available / sizeof(uint64_t);
+        for (uint64_t i=0; i < numValues; ++i) {
+            const uint64_t value = values[i];
+            // NOTE: (sonictk) Nearly everything on the heap is rejected by this first check alone.
+            if (value < heap->minImageAddress || value >= heap->maxImageAddress || (value & 7) != 0) {
+                continue;
+            }
+            if (findMayaHeapImageRange(heap, value) != NULL && !addMayaHeapVtableCount(&results->vtables, value, 1)) {
+                results->outOfMemory = true;
+                return;
+            }
+        }
+        results->numBytesScanned += available;
+        address += available;
+    }
+
+    return;
+}
+
+
+static DWORD WINAPI mayaHeapWorkerThreadProc(LPVOID lpParameter)
+{
+    MayaHeapJob *job = (MayaHeapJob *)lpParameter;
+    MayaHeapResults *results = &job->results[InterlockedIncrement(&job->nextWorker) - 1];
+    for (LONG i=InterlockedIncrement(&job->nextItem) - 1; i < (LONG)job->heap->numItems; i=InterlockedIncrement(&job->nextItem) - 1) {
+        const MayaHeapWorkItem *item = &job->heap->items[i];
+        if (item->kind == MayaHeapWorkItemKind_Segment) {
+            kMayaHeapWalkers[item->walkerIdx].walkSegment(job->heap, item->start, item->size, results);
+        } else {
+            scanMayaHeapForVtables(job->heap, item->start, item->size, results);
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Works out the name of the type that the given vtable belongs to from the RTTI of its module.
+ *
+ * @param heap      The dump.
+ * @param vtable    The address of the vtable.
+ * @param buf       Storage for the name of the type, as ``module!Type``.
+ * @param lenBuf    The size of ``buf``.
+ *
+ * @return          ``true`` if the address really is a vtable with RTTI, ``false`` otherwise.
+ */
+static bool getMayaHeapVtableTypeName(const MayaHeapDump *heap, uint64_t vtable, char *buf, size_t lenBuf)
+{
+    const MayaHeapImageRange *imageRange = findMayaHeapImageRange(heap, vtable);
+    uint64_t locatorAddress = 0;
+    if (imageRange == NULL || !readMayaHeapUInt64(heap, vtable - sizeof(uint64_t), &locatorAddress)) {
+        return false;
+    }
+    const MayaRTTICompleteObjectLocator *locator = (const MayaRTTICompleteObjectLocator *)readMayaHeapMemory(heap, locatorAddress, sizeof(MayaRTTICompleteObjectLocator));
+    // NOTE: (sonictk) The locator points back at itself, which rules out almost everything that
+    // only happens to look like one.
+    if (locator == NULL || locator->signature != 1 || imageRange->imageBase + locator->selfRVA != locatorAddress) {
+        return false;
+    }
+
+    // NOTE: (sonictk) The type descriptor is the type_info: a vtable pointer, a spare pointer and
+    // the decorated name (e.g. ``.?AVMyNode@myNamespace@@``).
+    uint64_t available = 0;
+    const char *name = (const char *)getMayaHeapMemory(heap, imageRange->imageBase + locator->typeDescriptorRVA + 2 * sizeof(uint64_t), &available);
+    if (name == NULL || available < 4 || name[0] != '.' || name[1] != '?' || name[2] != 'A') {
+        return false;
+    }
+    const size_t lenName = strnlen(name, available < MAYA_HEAP_TYPE_NAME_LEN ? (size_t)available : MAYA_HEAP_TYPE_NAME_LEN);
+
+    // NOTE: (sonictk) Undecorate simple names ourselves (``Type@ns1@ns2@@`` -> ``ns2::ns1::Type``);
+    // anything fancier (templates, nested types) is printed decorated.
+    size_t start = 4;
+    size_t end = lenName;
+    while (end > start && name[end - 1] == '@') {
+        --end;
+    }
+    bool simple = end > start && memchr(name + start, '?', end - start) == NULL && memchr(name + start, '$', end - start) == NULL;
+    if (!simple) {
+        snprintf(buf, lenBuf, "%s!%.*s", imageRange->moduleName, (int)lenName, name);
+        return true;
+    }
+    size_t lenWritten = (size_t)snprintf(buf, lenBuf, "%s!", imageRange->moduleName);
+    size_t segmentEnd = end;
+    while (segmentEnd > start && lenWritten < lenBuf) {
+        size_t segmentStart = segmentEnd;
+        while (segmentStart > start && name[segmentStart - 1] != '@') {
+            --segmentStart;
+        }
+        lenWritten += (size_t)snprintf(buf + lenWritten, lenBuf - lenWritten, "%.*s%s",
+                                       (int)(segmentEnd - segmentStart), name + segmentStart, segmentStart > start ? "::" : "");
+        segmentEnd = segmentStart > start ? segmentStart - 1 : start;
+    }
+
+    return true;
+}
+
+
+typedef struct MayaHeapTypeCount
+{
+    char name[MAYA_HEAP_TYPE_NAME_LEN];
+    uint64_t count;
+} MayaHeapTypeCount;
+
+static int compareMayaHeapTypeNames(const void *a, const void *b)
+{
+    return strcmp(((const MayaHeapTypeCount *)a)->name, ((const MayaHeapTypeCount *)b)->name);
+}
+
+static int compareMayaHeapTypeCounts(const void *a, const void *b)
+{
+    uint64_t countA = ((const MayaHeapTypeCount *)a)->count;
+    uint64_t countB = ((const MayaHeapTypeCount *)b)->count;
+
+    return countA == countB ? 0 : countA > countB ? -1 : 1;
+}
+
+/**
+ * Merges the counts of vtables that belong to the same type, and sorts the types by count.
+ *
+ * @param types         The count of each vtable, named after its type. Merged in place.
+ * @param numTypes      The number of entries in ``types``.
+ *
+ * @return              The number of distinct types left in ``types``.
+ */
+static uint32_t mergeMayaHeapTypeCounts(MayaHeapTypeCount *types, uint32_t numTypes)
+{
+    // NOTE: (sonictk) Types with several vtables (i.e. multiple inheritance) are counted once per
+    // vtable, so merge them and count the most common vtable as the number of objects.
+    qsort(types, numTypes, sizeof(MayaHeapTypeCount), compareMayaHeapTypeNames);
+    uint32_t numUniqueTypes = 0;
+    for (uint32_t i=0; i < numTypes; ++i) {
+        if (numUniqueTypes > 0 && strcmp(types[numUniqueTypes - 1].name, types[i].name) == 0) {
+            if (types[i].count > types[numUniqueTypes - 1].count) {
+                types[numUniqueTypes - 1].count = types[i].count;
+            }
+            continue;
+        }
+        types[numUniqueTypes++] = types[i];
+    }
+    qsort(types, numUniqueTypes, sizeof(MayaHeapTypeCount), compareMayaHeapTypeCounts);
+
+    return numUniqueTypes;
+}
+
+static int compareMayaHeapAllocationSizes(const void *a, const void *b)
+{
+    uint64_t sizeA = ((const MayaHeapAllocation *)a)->size;
+    uint64_t sizeB = ((const MayaHeapAllocation *)b)->size;
+
+    return sizeA == sizeB ? 0 : sizeA > sizeB ? -1 : 1;
+}
+
+static int compareMayaHeapMemoryRanges(const void *a, const void *b)
+{
+    uint64_t startA = ((const MayaHeapMemoryRange *)a)->start;
+    uint64_t startB = ((const MayaHeapMemoryRange *)b)->start;
+
+    return startA == startB ? 0 : startA < startB ? -1 : 1;
+}
+
+static int compareMayaHeapImageRanges(const void *a, const void *b)
+{
+    uint64_t startA = ((const MayaHeapImageRange *)a)->start;
+    uint64_t startB = ((const MayaHeapImageRange *)b)->start;
+
+    return startA == startB ? 0 : startA < startB ? -1 : 1;
+}
+
+
+/// Indexes the read-only data sections of the modules in the dump, from the headers of the
+/// modules in its memory.
+static bool indexMayaHeapImageRanges(MayaHeapDump *heap)
+{
+    // NOTE: (sonictk) The modules are in the dump too; their section tables tell us where the
+    // read-only data (and so the vtables) are.
+    heap->imageRanges = (MayaHeapImageRange *)calloc(heap->dump.numModules * 4 + 1, sizeof(MayaHeapImageRange));
+    if (heap->imageRanges == NULL) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+    heap->minImageAddress = UINT64_MAX;
+    for (uint32_t i=0; i < heap->dump.numModules; ++i) {
+        const MayaDiffModule *module = &heap->dump.modules[i];
+        const IMAGE_DOS_HEADER *dosHeader = (const IMAGE_DOS_HEADER *)readMayaHeapMemory(heap, module->baseOfImage, sizeof(IMAGE_DOS_HEADER));
+        if (dosHeader == NULL || dosHeader->e_magic != IMAGE_DOS_SIGNATURE) {
+            continue;
+        }
+        const IMAGE_NT_HEADERS64 *ntHeaders = (const IMAGE_NT_HEADERS64 *)readMayaHeapMemory(heap, module->baseOfImage + dosHeader->e_lfanew, sizeof(IMAGE_NT_HEADERS64));
+        if (ntHeaders == NULL || ntHeaders->Signature != IMAGE_NT_SIGNATURE) {
+            continue;
+        }
+        const uint64_t sectionsAddress = module->baseOfImage + dosHeader->e_lfanew
+            + FIELD_OFFSET(IMAGE_NT_HEADERS64, OptionalHeader) + ntHeaders->FileHeader.SizeOfOptionalHeader;
+        const IMAGE_SECTION_HEADER *sections = (const IMAGE_SECTION_HEADER *)readMayaHeapMemory(heap,
+                                                                                                sectionsAddress,
+                                                                                                ntHeaders->FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER));
+        if (sections == NULL) {
+            continue;
+        }
+        uint32_t numRangesInModule = 0;
+        for (WORD j=0; j < ntHeaders->FileHeader.NumberOfSections && numRangesInModule < 4; ++j) {
+            const DWORD characteristics = sections[j].Characteristics;
+            if ((characteristics & IMAGE_SCN_MEM_READ) == 0 || (characteristics & (IMAGE_SCN_MEM_WRITE|IMAGE_SCN_MEM_EXECUTE)) != 0) {
+                continue;
+            }
+            MayaHeapImageRange *imageRange = &heap->imageRanges[heap->numImageRanges++];
+            imageRange->start = module->baseOfImage + sections[j].VirtualAddress;
+            imageRange->end = imageRange->start + sections[j].Misc.VirtualSize;
+            imageRange->imageBase = module->baseOfImage;
+            imageRange->moduleName = module->name;
+            heap->minImageAddress = imageRange->start < heap->minImageAddress ? imageRange->start : heap->minImageAddress;
+            heap->maxImageAddress = imageRange->end > heap->maxImageAddress ? imageRange->end : heap->maxImageAddress;
+            ++numRangesInModule;
+        }
+    }
+    qsort(heap->imageRanges, heap->numImageRanges, sizeof(MayaHeapImageRange), compareMayaHeapImageRanges);
+
+    return true;
+}
+
+
+/// Indexes the memory ranges and the read-only data sections of the modules in the dump.
+static bool indexMayaHeapDump(MayaHeapDump *heap)
+{
+    ULONG streamSize = 0;
+    const MINIDUMP_MEMORY64_LIST *memoryList = (const MINIDUMP_MEMORY64_LIST *)findMayaDiffDumpStream(&heap->dump, Memory64ListStream, 0, &streamSize);
+    if (memoryList == NULL
+        || streamSize < sizeof(MINIDUMP_MEMORY64_LIST)
+        || (streamSize - sizeof(MINIDUMP_MEMORY64_LIST)) / sizeof(MINIDUMP_MEMORY_DESCRIPTOR64) < memoryList->NumberOfMemoryRanges) {
+        printf("ERROR: The dump does not contain the full memory of the process.\n");
+        return false;
+    }
+    heap->ranges = (MayaHeapMemoryRange *)calloc((size_t)memoryList->NumberOfMemoryRanges + 1, sizeof(MayaHeapMemoryRange));
+    if (heap->ranges == NULL) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+    uint64_t fileOffset = memoryList->BaseRva;
+    for (ULONG64 i=0; i < memoryList->NumberOfMemoryRanges; ++i) {
+        const MINIDUMP_MEMORY_DESCRIPTOR64 *desc = &memoryList->MemoryRanges[i];
+        if (getMayaDiffDumpRange(&heap->dump, fileOffset, desc->DataSize) == NULL) {
+            break;
+        }
+        MayaHeapMemoryRange *range = &heap->ranges[heap->numRanges++];
+        range->start = desc->StartOfMemoryRange;
+        range->size = desc->DataSize;
+        range->fileOffset = fileOffset;
+        fileOffset += desc->DataSize;
+    }
+    qsort(heap->ranges, heap->numRanges, sizeof(MayaHeapMemoryRange), compareMayaHeapMemoryRanges);
+
+    return indexMayaHeapImageRanges(heap);
+}
+
+
+/**
+ * Prints what the memory of the process in the given full-memory dump was being used for.
+ *
+ * @param dumpFilePath      The dump to read. It must have been written with the full memory of the
+ *                          process (e.g. by ``procdump -ma``, or Windows Error Reporting with a
+ *                          ``DumpType`` of ``2``).
+ * @param numToPrint        The number of allocations and types to print.
+ *
+ * @return                  ``0`` on success, ``1`` otherwise.
+ */
+int printMayaHeapSummary(const char *dumpFilePath, uint32_t numToPrint)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&startTime);
+
+    static MayaHeapDump heap;
+    if (!openMayaDiffDump(dumpFilePath, &heap.dump)) {
+        printf("ERROR: Could not open the dump file requested.\n");
+        closeMayaDiffDump(&heap.dump);
+        return 1;
+    }
+    int result = 1;
+    MayaHeapResults *results = NULL;
+    MayaHeapTypeCount *types = NULL;
+    MayaHeapAllocation *privateAllocations = NULL;
+    uint32_t numWorkers = 0;
+    if (!indexMayaHeapDump(&heap)) {
+        goto cleanup;
+    }
+
+    ULONG streamSize = 0;
+    const MINIDUMP_MEMORY_INFO_LIST *memoryInfoList = (const MINIDUMP_MEMORY_INFO_LIST *)findMayaDiffDumpStream(&heap.dump, MemoryInfoListStream, 0, &streamSize);
+    if (memoryInfoList == NULL
+        || streamSize < sizeof(MINIDUMP_MEMORY_INFO_LIST)
+        || memoryInfoList->SizeOfHeader > streamSize
+        || memoryInfoList->SizeOfEntry < sizeof(MINIDUMP_MEMORY_INFO)
+        || (streamSize - memoryInfoList->SizeOfHeader) / memoryInfoList->SizeOfEntry < memoryInfoList->NumberOfEntries) {
+        printf("ERROR: The dump does not contain the memory info of the process.\n");
+        goto cleanup;
+    }
+    const uint8_t *memoryInfos = (const uint8_t *)memoryInfoList + memoryInfoList->SizeOfHeader;
+
+    // NOTE: (sonictk) Group the committed private regions into the allocations they came from, and
+    // hand each heap segment and every few MB of private memory to the workers.
+    const uint32_t numMemoryInfos = (uint32_t)memoryInfoList->NumberOfEntries;
+    size_t maxItems = numMemoryInfos;
+    for (uint32_t i=0; i < numMemoryInfos; ++i) {
+        const MINIDUMP_MEMORY_INFO *info = (const MINIDUMP_MEMORY_INFO *)(memoryInfos + (size_t)i * memoryInfoList->SizeOfEntry);
+        maxItems += (size_t)(info->RegionSize / MAYA_HEAP_SCAN_CHUNK_SIZE) + 1;
+    }
+    heap.items = (MayaHeapWorkItem *)calloc(maxItems + 1, sizeof(MayaHeapWorkItem));
+    privateAllocations = (MayaHeapAllocation *)calloc(numMemoryInfos + 1, sizeof(MayaHeapAllocation));
+    if (heap.items == NULL || privateAllocations == NULL) {
+        printf("ERROR: Out of memory.\n");
+        goto cleanup;
+    }
+    uint32_t numPrivateAllocations = 0;
+    uint64_t privateBytes = 0;
+    uint64_t segmentBytes = 0;
+    uint32_t numSegments = 0;
+    uint64_t lastAllocationBase = 0;
+    bool lastAllocationIsSegment = false;
+    for (uint32_t i=0; i < numMemoryInfos; ++i) {
+        const MINIDUMP_MEMORY_INFO *info = (const MINIDUMP_MEMORY_INFO *)(memoryInfos + (size_t)i * memoryInfoList->SizeOfEntry);
+        if (info->State != MEM_COMMIT || info->Type != MEM_PRIVATE) {
+            continue;
+        }
+        privateBytes += info->RegionSize;
+
+        int walkerIdx = -1;
+        if (info->AllocationBase != lastAllocationBase || numPrivateAllocations == 0) {
+            lastAllocationBase = info->AllocationBase;
+            privateAllocations[numPrivateAllocations].address = info->AllocationBase;
+            privateAllocations[numPrivateAllocations++].size = 0;
+            for (int j=0; j < (int)(ARRAY_SIZE(kMayaHeapWalkers)); ++j) {
+                if (kMayaHeapWalkers[j].isSegment(&heap, info->AllocationBase)) {
+                    walkerIdx = j;
+                    break;
+                }
+            }
+            lastAllocationIsSegment = walkerIdx >= 0;
+        }
+        privateAllocations[numPrivateAllocations - 1].size += info->RegionSize;
+        if (walkerIdx >= 0) {
+            // NOTE: (sonictk) The segment reserves the whole allocation; the walker skips over
+            // the parts that aren't committed.
+            uint64_t allocationSize = 0;
+            for (uint32_t j=i; j < numMemoryInfos; ++j) {
+                const MINIDUMP_MEMORY_INFO *next = (const MINIDUMP_MEMORY_INFO *)(memoryInfos + (size_t)j * memoryInfoList->SizeOfEntry);
+                if (next->AllocationBase != info->AllocationBase) {
+                    break;
+                }
+                allocationSize += next->RegionSize;
+            }
+            MayaHeapWorkItem *item = &heap.items[heap.numItems++];
+            item->start = info->AllocationBase;
+            item->size = allocationSize;
+            item->kind = MayaHeapWorkItemKind_Segment;
+            item->walkerIdx = (uint32_t)walkerIdx;
+            ++numSegments;
+        }
+        if (lastAllocationIsSegment) {
+            segmentBytes += info->RegionSize;
+        }
+
+        if ((info->Protect & (PAGE_READWRITE|PAGE_WRITECOPY)) == 0 || (info->Protect & PAGE_GUARD) != 0) {
+            continue;
+        }
+        for (uint64_t offset=0; offset < info->RegionSize; offset += MAYA_HEAP_SCAN_CHUNK_SIZE) {
+            MayaHeapWorkItem *item = &heap.items[heap.numItems++];
+            item->start = info->BaseAddress + offset;
+            item->size = info->RegionSize - offset < MAYA_HEAP_SCAN_CHUNK_SIZE ? info->RegionSize - offset : MAYA_HEAP_SCAN_CHUNK_SIZE;
+            item->kind = MayaHeapWorkItemKind_Scan;
+        }
+    }
+
+    // NOTE: (sonictk) Heap segments go first, since they take the longest to walk.
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    numWorkers = sysInfo.dwNumberOfProcessors > MAYA_HEAP_MAX_WORKERS ? MAYA_HEAP_MAX_WORKERS : sysInfo.dwNumberOfProcessors;
+    numWorkers = numWorkers == 0 ? 1 : numWorkers;
+    results = (MayaHeapResults *)calloc(numWorkers, sizeof(MayaHeapResults));
+    if (results == NULL) {
+        printf("ERROR: Out of memory.\n");
+        goto cleanup;
+    }
+    MayaHeapJob job = {0};
+    job.heap = &heap;
+    job.results = results;
+    HANDLE workers[MAYA_HEAP_MAX_WORKERS];
+    uint32_t numWorkersStarted = 0;
+    for (uint32_t i=0; i < numWorkers; ++i) {
+        workers[numWorkersStarted] = CreateThread(NULL, 0, mayaHeapWorkerThreadProc, &job, 0, NULL);
+        if (workers[numWorkersStarted] != NULL) {
+            ++numWorkersStarted;
+        }
+    }
+    if (numWorkersStarted == 0) {
+        mayaHeapWorkerThreadProc(&job);
+    } else {
+        WaitForMultipleObjects(numWorkersStarted, workers, TRUE, INFINITE);
+        for (uint32_t i=0; i < numWorkersStarted; ++i) {
+            CloseHandle(workers[i]);
+        }
+    }
+
+    // NOTE: (sonictk) Merge everything into the first worker's results.
+    MayaHeapResults *total = &results[0];
+    for (uint32_t i=1; i < numWorkers; ++i) {
+        const MayaHeapResults *other = &results[i];
+        for (uint32_t j=0; j < MAYA_HEAP_NUM_SIZE_BUCKETS; ++j) {
+            total->blockCounts[j] += other->blockCounts[j];
+            total->blockBytes[j] += other->blockBytes[j];
+        }
+        total->numBusyBlocks += other->numBusyBlocks;
+        total->busyBytes += other->busyBytes;
+        total->freeBytes += other->freeBytes;
+        total->numBytesScanned += other->numBytesScanned;
+        total->numBadSegments += other->numBadSegments;
+        total->outOfMemory |= other->outOfMemory;
+        for (uint32_t j=0; j < other->numLargest; ++j) {
+            addMayaHeapLargestAllocation(total, other->largest[j].address, other->largest[j].size);
+        }
+        for (uint32_t j=0; j < other->vtables.capacity; ++j) {
+            if (other->vtables.keys[j] != 0 && !addMayaHeapVtableCount(&total->vtables, other->vtables.keys[j], other->vtables.counts[j])) {
+                total->outOfMemory = true;
+            }
+        }
+    }
+    if (total->outOfMemory) {
+        printf("WARNING: Ran out of memory counting vtable pointers; the type counts are incomplete.\n");
+    }
+
+    const double bytesToMB = 1.0 / (1024.0 * 1024.0);
+    QueryPerformanceCounter(&endTime);
+    printf("Heap summary of %s, gone through in %.3f s using %u threads:\n",
+           dumpFilePath, (double)(endTime.QuadPart - startTime.QuadPart) / (double)freq.QuadPart, numWorkersStarted == 0 ? 1 : numWorkersStarted);
+    printf("Private committed: %.1f MB in %u allocations, of which %.1f MB in %u heap segments (%.1f MB in use, %.1f MB free, %u segments could not be fully walked).\n",
+           privateBytes * bytesToMB, numPrivateAllocations, segmentBytes * bytesToMB, numSegments,
+           total->busyBytes * bytesToMB, total->freeBytes * bytesToMB, total->numBadSegments);
+
+    printf("Heap blocks in use by size:\n");
+    for (uint32_t i=0; i < MAYA_HEAP_NUM_SIZE_BUCKETS; ++i) {
+        if (total->blockCounts[i] == 0) {
+            continue;
+        }
+        printf("    %12llu - %12llu bytes: %10llu blocks, %10.1f MB\n",
+               i == 0 ? 0ULL : 1ULL << i, (2ULL << i) - 1, total->blockCounts[i], total->blockBytes[i] * bytesToMB);
+    }
+
+    char typeName[MAYA_HEAP_TYPE_NAME_LEN] = {0};
+    qsort(total->largest, total->numLargest, sizeof(MayaHeapAllocation), compareMayaHeapAllocationSizes);
+    printf("Largest heap blocks in use:\n");
+    for (uint32_t i=0; i < total->numLargest && i < numToPrint; ++i) {
+        uint64_t vtable = 0;
+        bool hasType = readMayaHeapUInt64(&heap, total->largest[i].address, &vtable)
+            && getMayaHeapVtableTypeName(&heap, vtable, typeName, sizeof(typeName));
+        printf("    0x%016llx: %10.1f MB%s%s\n", total->largest[i].address, total->largest[i].size * bytesToMB,
+               hasType ? " " : "", hasType ? typeName : "");
+    }
+
+    qsort(privateAllocations, numPrivateAllocations, sizeof(MayaHeapAllocation), compareMayaHeapAllocationSizes);
+    printf("Largest private allocations:\n");
+    for (uint32_t i=0; i < numPrivateAllocations && i < numToPrint; ++i) {
+        printf("    0x%016llx: %10.1f MB committed\n", privateAllocations[i].address, privateAllocations[i].size * bytesToMB);
+    }
+
+    // NOTE: (sonictk) Only now check which of the pointers found really are vtables, since there
+    // are far fewer distinct pointers than there are pointers.
+    types = (MayaHeapTypeCount *)calloc(total->vtables.numKeys + 1, sizeof(MayaHeapTypeCount));
+    if (types == NULL) {
+        printf("ERROR: Out of memory.\n");
+        goto cleanup;
+    }
+    uint32_t numTypes = 0;
+    uint64_t numObjects = 0;
+    for (uint32_t i=0; i < total->vtables.capacity; ++i) {
+        if (total->vtables.keys[i] == 0 || !getMayaHeapVtableTypeName(&heap, total->vtables.keys[i], types[numTypes].name, MAYA_HEAP_TYPE_NAME_LEN)) {
+            continue;
+        }
+        types[numTypes++].count = total->vtables.counts[i];
+        numObjects += total->vtables.counts[i];
+    }
+    const uint32_t numUniqueTypes = mergeMayaHeapTypeCounts(types, numTypes);
+    printf("Most common C++ types, from %llu vtable pointers in %.1f MB scanned:\n", numObjects, total->numBytesScanned * bytesToMB);
+    for (uint32_t i=0; i < numUniqueTypes && i < numToPrint; ++i) {
+        printf("    %10llu %s\n", types[i].count, types[i].name);
+    }
+    printf("End of heap summary.\n");
+    result = 0;
+
+cleanup:
+    if (results != NULL) {
+        for (uint32_t i=0; i < numWorkers; ++i) {
+            free(results[i].vtables.keys);
+            free(results[i].vtables.counts);
+        }
+    }
+    free(results);
+    free(types);
+    free(privateAllocations);
+    free(heap.items);
+    free(heap.imageRanges);
+    free(heap.ranges);
+    closeMayaDiffDump(&heap.dump);
+
+    return result;
+}
@@ -0,0 +1,517 @@
+/**
+ * @file   maya_read_custom_dump_io.c
+ * @brief  Reads a handful of streams out of many dumps at once. Going through a spool on a
+ *         network share is bound by latency rather than bandwidth: every dump takes a read of its
+ *         header, then of its stream directory, then of the streams wanted, and mapping the dumps
+ *         one after the other waits for each of those in turn. Here, hundreds of dumps are kept
+ *         in flight with overlapped reads on an I/O completion port instead. Each dump only
+ *         issues its next read once the one it depends on has completed, and only the byte
+ *         ranges of the streams wanted are ever read.
+ *
+ *         Opening the files is synchronous (and also a round trip on a share), so that is left to
+ *         a few opener threads; the reads all complete on the calling thread. There is also a
+ *         synchronous mode that does the same reads one after the other, for filesystems that
+ *         don't do overlapped I/O.
+ */
+#define MAYA_DUMP_IO_MAX_STREAMS 8
+#define MAYA_DUMP_IO_DEFAULT_IN_FLIGHT 256
+#define MAYA_DUMP_IO_MAX_IN_FLIGHT 4096
+#define MAYA_DUMP_IO_MAX_OPENERS 16
+#define MAYA_DUMP_IO_MAX_DIRECTORY_ENTRIES 4096
+#define MAYA_DUMP_IO_MAX_STREAM_SIZE (16 * 1024 * 1024) // NOTE: (sonictk) Larger streams are treated as missing.
+#define MAYA_DUMP_IO_COMPLETIONS_PER_WAIT 64
+
+typedef enum MayaDumpIOMode
+{
+    MayaDumpIOMode_Async = 0,
+    MayaDumpIOMode_Sync // NOTE: (sonictk) Positional reads one after the other, on the calling thread.
+} MayaDumpIOMode;
+
+typedef enum MayaDumpIOStage
+{
+    MayaDumpIOStage_Header = 0,
+    MayaDumpIOStage_Directory,
+    MayaDumpIOStage_Streams
+} MayaDumpIOStage;
+
+/// A stream to read out of every dump: the ``nth`` stream of type ``streamType``.
+typedef struct MayaDumpIOStreamRequest
+{
+    ULONG streamType;
+    uint32_t nth;
+} MayaDumpIOStreamRequest;
+
+/// What was read out of a dump. ``streams`` is in the same order as the streams requested, with
+/// ``NULL`` for the ones that aren't in the dump. Only valid for the duration of the callback.
+typedef struct MayaDumpIOResult
+{
+    const char *path;
+    uint32_t pathIdx;
+    bool ok; // NOTE: (sonictk) ``false`` if the dump could not be opened, or is not a dump.
+    uint32_t numReads;
+    uint64_t numBytesRead;
+    const void *streams[MAYA_DUMP_IO_MAX_STREAMS];
+    ULONG streamSizes[MAYA_DUMP_IO_MAX_STREAMS];
+} MayaDumpIOResult;
+
+typedef void (*MayaDumpIOCallback)(const MayaDumpIOResult *result, void *userData);
+
+typedef struct MayaDumpIOStats
+{
+    uint32_t numDumps;
+    uint32_t numFailedDumps;
+    uint64_t numReads;
+    uint64_t numBytesRead;
+    uint32_t maxInFlight; // NOTE: (sonictk) The most dumps that actually were in flight at once.
+} MayaDumpIOStats;
+
+struct MayaDumpIOContext;
+
+/// A single outstanding read. The ``OVERLAPPED`` must come first, since the completions only hand
+/// it back.
+typedef struct MayaDumpIORead
+{
+    OVERLAPPED overlapped;
+    struct MayaDumpIOContext *ctx;
+    uint32_t size;
+    int slot; // NOTE: (sonictk) The index of the stream being read, or ``-1`` for the header/directory.
+} MayaDumpIORead;
+
+/// A dump in flight.
+typedef struct MayaDumpIOContext
+{
+    HANDLE hFile;
+    uint32_t pathIdx;
+    uint32_t stage; // NOTE: (sonictk) One of ``MayaDumpIOStage``.
+    bool failed;
+    uint64_t fileSize;
+    MINIDUMP_HEADER header;
+    MINIDUMP_DIRECTORY *dir;
+    LONG numPending;
+    MayaDumpIOResult result;
+    uint8_t *streamBufs[MAYA_DUMP_IO_MAX_STREAMS];
+    MayaDumpIORead reads[MAYA_DUMP_IO_MAX_STREAMS + 1];
+} MayaDumpIOContext;
+
+typedef struct MayaDumpIOEngine
+{
+    MayaDumpIOMode mode;
+    char **paths;
+    uint32_t numPaths;
+    const MayaDumpIOStreamRequest *wanted;
+    uint32_t numWanted;
+    MayaDumpIOCallback callback;
+    void *userData;
+    MayaDumpIOStats *stats;
+
+    HANDLE hPort;
+    HANDLE hSlots; // NOTE: (sonictk) Counts the contexts that are free.
+    volatile LONG nextPath;
+    uint32_t numDone;
+    uint32_t numInFlight;
+
+    MayaDumpIOContext *contexts;
+    uint32_t *freeContexts;
+    uint32_t numFreeContexts;
+    SRWLOCK freeContextsLock;
+} MayaDumpIOEngine;
+
+
+static void finishMayaDumpIOContext(MayaDumpIOEngine *engine, MayaDumpIOContext *ctx);
+
+
+/// Starts reading a range of the dump. In synchronous mode, the read is done (and its completion
+/// handled) before this returns.
+static bool issueMayaDumpIORead(MayaDumpIOEngine *engine, MayaDumpIOContext *ctx, int slot, uint64_t offset, void *buf, uint32_t size);
+
+
+static void handleMayaDumpIOReadComplete(MayaDumpIOEngine *engine, MayaDumpIORead *read, bool succeeded, DWORD numBytesTransferred)
+{
+    MayaDumpIOContext *ctx = read->ctx;
+    if (!succeeded || numBytesTransferred != read->size) {
+        ctx->failed = ctx->failed || read->slot < 0;
+        if (read->slot >= 0) {
+            // NOTE: (sonictk) A stream that can't be read is just reported as missing.
+            free(ctx->streamBufs[read->slot]);
+            ctx->streamBufs[read->slot] = NULL;
+        }
+    } else {
+        ++ctx->result.numReads;
+        ctx->result.numBytesRead += numBytesTransferred;
+    }
+
+    if (ctx->failed) {
+        if (--ctx->numPending == 0) {
+            finishMayaDumpIOContext(engine, ctx);
+        }
+        return;
+    }
+
+    switch (ctx->stage) {
+    case MayaDumpIOStage_Header:
+    {
+        --ctx->numPending;
+        const MINIDUMP_HEADER *header = &ctx->header;
+        const uint64_t dirSize = (uint64_t)header->NumberOfStreams * sizeof(MINIDUMP_DIRECTORY);
+        if (header->Signature != MINIDUMP_SIGNATURE
+            || header->NumberOfStreams == 0
+            || header->NumberOfStreams > MAYA_DUMP_IO_MAX_DIRECTORY_ENTRIES
+            || header->StreamDirectoryRva > ctx->fileSize
+            || dirSize > ctx->fileSize - header->StreamDirectoryRva) {
+            ctx->failed = true;
+            finishMayaDumpIOContext(engine, ctx);
+            return;
+        }
+        ctx->dir = (MINIDUMP_DIRECTORY *)malloc((size_t)dirSize);
+        ctx->stage = MayaDumpIOStage_Directory;
+        ++ctx->numPending;
+        if (ctx->dir == NULL || !issueMayaDumpIORead(engine, ctx, -1, header->StreamDirectoryRva, ctx->dir, (uint32_t)dirSize)) {
+            ctx->failed = true;
+            if (--ctx->numPending == 0) {
+                finishMayaDumpIOContext(engine, ctx);
+            }
+        }
+        return;
+    }
+    case MayaDumpIOStage_Directory:
+    {
+        // NOTE: (sonictk) Every stream wanted is read at once; none of them depend on each other.
+        // The count is held at one while they are being issued, so that the dump isn't finished
+        // by a read that completes before the rest have even been issued.
+        ctx->stage = MayaDumpIOStage_Streams;
+        for (uint32_t i=0; i < engine->numWanted; ++i) {
+            uint32_t nth = engine->wanted[i].nth;
+            const MINIDUMP_DIRECTORY *entry = NULL;
+            for (ULONG32 j=0; j < ctx->header.NumberOfStreams; ++j) {
+                if (ctx->dir[j].StreamType == engine->wanted[i].streamType && nth-- == 0) {
+                    entry = &ctx->dir[j];
+                    break;
+                }
+            }
+            if (entry == NULL
+                || entry->Location.DataSize == 0
+                || entry->Location.DataSize > MAYA_DUMP_IO_MAX_STREAM_SIZE
+                || entry->Location.Rva > ctx->fileSize
+                || entry->Location.DataSize > ctx->fileSize - entry->Location.Rva) {
+                continue;
+            }
+            ctx->streamBufs[i] = (uint8_t *)malloc(entry->Location.DataSize);
+            if (ctx->streamBufs[i] == NULL) {
+                continue;
+            }
+            ctx->result.streamSizes[i] = entry->Location.DataSize;
+            ++ctx->numPending;
+            if (!issueMayaDumpIORead(engine, ctx, (int)i, entry->Location.Rva, ctx->streamBufs[i], entry->Location.DataSize)) {
+                free(ctx->streamBufs[i]);
+                ctx->streamBufs[i] = NULL;
+                --ctx->numPending;
+            }
+        }
+        if (--ctx->numPending == 0) {
+            finishMayaDumpIOContext(engine, ctx);
+        }
+        return;
+    }
+    case MayaDumpIOStage_Streams:
+    default:
+        if (--ctx->numPending == 0) {
+            finishMayaDumpIOContext(engine, ctx);
+        }
+        return;
+    }
+}
+
+
+static bool issueMayaDumpIORead(MayaDumpIOEngine *engine, MayaDumpIOContext *ctx, int slot, uint64_t offset, void *buf, uint32_t size)
+{
+    MayaDumpIORead *read = &ctx->reads[slot + 1];
+    memset(&read->overlapped, 0, sizeof(OVERLAPPED));
+    read->overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    read->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    read->ctx = ctx;
+    read->size = size;
+    read->slot = slot;
+
+    if (engine->mode == MayaDumpIOMode_Sync) {
+        // NOTE: (sonictk) The handle isn't overlapped, so this is a positional read that blocks.
+        DWORD numBytesRead = 0;
+        BOOL bStat = ReadFile(ctx->hFile, buf, size, &numBytesRead, &read->overlapped);
+        handleMayaDumpIOReadComplete(engine, read, bStat == TRUE, numBytesRead);
+        return true;
+    }
+
+    // NOTE: (sonictk) Even reads that complete straight away are handed back through the port.
+    if (ReadFile(ctx->hFile, buf, size, NULL, &read->overlapped) == FALSE && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+
+    return true;
+}
+
+
+static void finishMayaDumpIOContext(MayaDumpIOEngine *engine, MayaDumpIOContext *ctx)
+{
+    MayaDumpIOResult *result = &ctx->result;
+    result->path = engine->paths[ctx->pathIdx];
+    result->pathIdx = ctx->pathIdx;
+    result->ok = !ctx->failed;
+    for (uint32_t i=0; i < engine->numWanted; ++i) {
+        result->streams[i] = ctx->streamBufs[i];
+        if (ctx->streamBufs[i] == NULL) {
+            result->streamSizes[i] = 0;
+        }
+    }
+    engine->callback(result, engine->userData);
+
+    MayaDumpIOStats *stats = engine->stats;
+    ++stats->numDumps;
+    stats->numFailedDumps += result->ok ? 0 : 1;
+    stats->numReads += result->numReads;
+    stats->numBytesRead += result->numBytesRead;
+
+    for (uint32_t i=0; i < MAYA_DUMP_IO_MAX_STREAMS; ++i) {
+        free(ctx->streamBufs[i]);
+        ctx->streamBufs[i] = NULL;
+    }
+    free(ctx->dir);
+    ctx->dir = NULL;
+    if (ctx->hFile != INVALID_HANDLE_VALUE && ctx->hFile != NULL) {
+        CloseHandle(ctx->hFile);
+    }
+    ctx->hFile = INVALID_HANDLE_VALUE;
+
+    ++engine->numDone;
+    if (engine->mode == MayaDumpIOMode_Async) {
+        --engine->numInFlight;
+        const uint32_t ctxIdx = (uint32_t)(ctx - engine->contexts);
+        AcquireSRWLockExclusive(&engine->freeContextsLock);
+        engine->freeContexts[engine->numFreeContexts++] = ctxIdx;
+        ReleaseSRWLockExclusive(&engine->freeContextsLock);
+        ReleaseSemaphore(engine->hSlots, 1, NULL);
+    }
+
+    return;
+}
+
+
+/// Sets up a context for the given dump and opens it. Returns ``false`` if it could not be opened,
+/// in which case the context is marked as failed.
+static bool openMayaDumpIOContext(MayaDumpIOEngine *engine, MayaDumpIOContext *ctx, uint32_t pathIdx)
+{
+    memset(&ctx->header, 0, sizeof(ctx->header));
+    memset(&ctx->result, 0, sizeof(ctx->result));
+    ctx->pathIdx = pathIdx;
+    ctx->stage = MayaDumpIOStage_Header;
+    ctx->failed = false;
+    ctx->numPending = 0;
+    ctx->hFile = CreateFile(engine->paths[pathIdx], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_RANDOM_ACCESS | (engine->mode == MayaDumpIOMode_Async ? FILE_FLAG_OVERLAPPED : 0), NULL);
+    LARGE_INTEGER fileSize;
+    if (ctx->hFile == INVALID_HANDLE_VALUE || GetFileSizeEx(ctx->hFile, &fileSize) == FALSE || fileSize.QuadPart < (LONGLONG)sizeof(MINIDUMP_HEADER)) {
+        ctx->failed = true;
+        return false;
+    }
+    ctx->fileSize = (uint64_t)fileSize.QuadPart;
+    if (engine->mode == MayaDumpIOMode_Async && CreateIoCompletionPort(ctx->hFile, engine->hPort, (ULONG_PTR)ctx, 0) == NULL) {
+        ctx->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+/// Starts off a dump that has been opened (or failed to) by reading its header.
+static void startMayaDumpIOContext(MayaDumpIOEngine *engine, MayaDumpIOContext *ctx)
+{
+    if (ctx->failed) {
+        finishMayaDumpIOContext(engine, ctx);
+        return;
+    }
+    ctx->numPending = 1;
+    if (!issueMayaDumpIORead(engine, ctx, -1, 0, &ctx->header, (uint32_t)sizeof(MINIDUMP_HEADER))) {
+        ctx->failed = true;
+        ctx->numPending = 0;
+        finishMayaDumpIOContext(engine, ctx);
+    }
+
+    return;
+}
+
+
+/// Opens dumps as long as there are contexts free for them, and hands them over to the completion
+/// port. Opening is the only part that can't be overlapped.
+static DWORD WINAPI mayaDumpIOOpenerThreadProc(LPVOID lpParameter)
+{
+    MayaDumpIOEngine *engine = (MayaDumpIOEngine *)lpParameter;
+    while (WaitForSingleObject(engine->hSlots, INFINITE) == WAIT_OBJECT_0) {
+        const LONG pathIdx = InterlockedIncrement(&engine->nextPath) - 1;
+        if (pathIdx >= (LONG)engine->numPaths) {
+            ReleaseSemaphore(engine->hSlots, 1, NULL);
+            break;
+        }
+        AcquireSRWLockExclusive(&engine->freeContextsLock);
+        MayaDumpIOContext *ctx = &engine->contexts[engine->freeContexts[--engine->numFreeContexts]];
+        ReleaseSRWLockExclusive(&engine->freeContextsLock);
+
+        openMayaDumpIOContext(engine, ctx, (uint32_t)pathIdx);
+        // NOTE: (sonictk) A completion without an ``OVERLAPPED`` tells the calling thread that the
+        // dump is ready to be read.
+        PostQueuedCompletionStatus(engine->hPort, 0, (ULONG_PTR)ctx, NULL);
+    }
+
+    return 0;
+}
+
+
+/// Returns ``-1`` if overlapped reads could not be set up at all (so that nothing was read), or
+/// whether every dump was read otherwise.
+static int runMayaDumpIOAsync(MayaDumpIOEngine *engine, uint32_t maxInFlight)
+{
+    engine->hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    engine->hSlots = CreateSemaphore(NULL, (LONG)maxInFlight, (LONG)maxInFlight, NULL);
+    engine->contexts = (MayaDumpIOContext *)calloc(maxInFlight, sizeof(MayaDumpIOContext));
+    engine->freeContexts = (uint32_t *)calloc(maxInFlight, sizeof(uint32_t));
+    InitializeSRWLock(&engine->freeContextsLock);
+    bool started = engine->hPort != NULL && engine->hSlots != NULL && engine->contexts != NULL && engine->freeContexts != NULL;
+    for (uint32_t i=0; i < maxInFlight && started; ++i) {
+        engine->contexts[i].hFile = INVALID_HANDLE_VALUE;
+        engine->freeContexts[engine->numFreeContexts++] = maxInFlight - 1 - i;
+    }
+
+    uint32_t numOpeners = engine->numPaths < MAYA_DUMP_IO_MAX_OPENERS ? engine->numPaths : MAYA_DUMP_IO_MAX_OPENERS;
+    HANDLE openers[MAYA_DUMP_IO_MAX_OPENERS];
+    uint32_t numOpenersStarted = 0;
+    for (uint32_t i=0; i < numOpeners && started; ++i) {
+        openers[numOpenersStarted] = CreateThread(NULL, 0, mayaDumpIOOpenerThreadProc, engine, 0, NULL);
+        if (openers[numOpenersStarted] != NULL) {
+            ++numOpenersStarted;
+        }
+    }
+    started = started && numOpenersStarted > 0;
+
+    OVERLAPPED_ENTRY entries[MAYA_DUMP_IO_COMPLETIONS_PER_WAIT];
+    bool waitFailed = false;
+    while (started && engine->numDone < engine->numPaths) {
+        ULONG numEntries = 0;
+        if (GetQueuedCompletionStatusEx(engine->hPort, entries, MAYA_DUMP_IO_COMPLETIONS_PER_WAIT, &numEntries, INFINITE, FALSE) == FALSE) {
+            waitFailed = true;
+            break;
+        }
+        for (ULONG i=0; i < numEntries; ++i) {
+            MayaDumpIOContext *ctx = (MayaDumpIOContext *)entries[i].lpCompletionKey;
+            if (entries[i].lpOverlapped == NULL) {
+                ++engine->numInFlight;
+                if (engine->numInFlight > engine->stats->maxInFlight) {
+                    engine->stats->maxInFlight = engine->numInFlight;
+                }
+                startMayaDumpIOContext(engine, ctx);
+                continue;
+            }
+            MayaDumpIORead *read = (MayaDumpIORead *)entries[i].lpOverlapped;
+            // NOTE: (sonictk) ``Internal`` holds the status of the read once it has completed.
+            const bool succeeded = read->overlapped.Internal == 0;
+            handleMayaDumpIOReadComplete(engine, read, succeeded, entries[i].dwNumberOfBytesTransferred);
+        }
+    }
+
+    // NOTE: (sonictk) If we stopped early, the openers might still be waiting for a context.
+    if (engine->numDone < engine->numPaths && engine->hSlots != NULL) {
+        InterlockedExchange(&engine->nextPath, (LONG)engine->numPaths);
+        ReleaseSemaphore(engine->hSlots, (LONG)numOpenersStarted, NULL);
+    }
+    if (numOpenersStarted > 0) {
+        WaitForMultipleObjects(numOpenersStarted, openers, TRUE, INFINITE);
+        for (uint32_t i=0; i < numOpenersStarted; ++i) {
+            CloseHandle(openers[i]);
+        }
+    }
+    // NOTE: (sonictk) The port is ours and the wait has no timeout, so it only fails if something
+    // is badly wrong. Reads might still be in flight into the contexts then, so they are leaked
+    // rather than freed from under them.
+    if (!waitFailed) {
+        free(engine->freeContexts);
+        free(engine->contexts);
+    }
+    if (engine->hSlots != NULL) {
+        CloseHandle(engine->hSlots);
+    }
+    if (engine->hPort != NULL) {
+        CloseHandle(engine->hPort);
+    }
+
+    if (!started) {
+        return -1;
+    }
+
+    return engine->numDone == engine->numPaths ? 1 : 0;
+}
+
+
+/**
+ * Reads the given streams out of every dump given, calling back with each dump as soon as all
+ * of its streams have been read. Dumps are not called back in any particular order.
+ *
+ * @param paths         The dumps to read.
+ * @param numPaths      The number of dumps.
+ * @param wanted        The streams to read out of each dump.
+ * @param numWanted     The number of streams wanted. At most ``MAYA_DUMP_IO_MAX_STREAMS``.
+ * @param mode          One of ``MayaDumpIOMode``. Falls back to ``MayaDumpIOMode_Sync`` if
+ *                      overlapped reads can't be set up.
+ * @param maxInFlight   How many dumps to keep in flight at once (for overlapped reads).
+ * @param callback      Called on the calling thread with each dump read.
+ * @param userData      Passed to ``callback``.
+ * @param stats         Storage for the totals of what was read.
+ *
+ * @return              ``true`` if every dump was called back, ``false`` otherwise.
+ */
+static bool readMayaDumpStreams(char **paths,
+                                uint32_t numPaths,
+                                const MayaDumpIOStreamRequest *wanted,
+                                uint32_t numWanted,
+                                MayaDumpIOMode mode,
+                                uint32_t maxInFlight,
+                                MayaDumpIOCallback callback,
+                                void *userData,
+                                MayaDumpIOStats *stats)
+{
+    memset(stats, 0, sizeof(MayaDumpIOStats));
+    if (numWanted > MAYA_DUMP_IO_MAX_STREAMS) {
+        return false;
+    }
+
+    MayaDumpIOEngine engine;
+    memset(&engine, 0, sizeof(engine));
+    engine.mode = mode;
+    engine.paths = paths;
+    engine.numPaths = numPaths;
+    engine.wanted = wanted;
+    engine.numWanted = numWanted;
+    engine.callback = callback;
+    engine.userData = userData;
+    engine.stats = stats;
+
+    maxInFlight = maxInFlight == 0 ? MAYA_DUMP_IO_DEFAULT_IN_FLIGHT : maxInFlight;
+    maxInFlight = maxInFlight > MAYA_DUMP_IO_MAX_IN_FLIGHT ? MAYA_DUMP_IO_MAX_IN_FLIGHT : maxInFlight;
+    maxInFlight = maxInFlight > numPaths ? numPaths : maxInFlight;
+    if (mode == MayaDumpIOMode_Async && maxInFlight > 0) {
+        const int asyncStat = runMayaDumpIOAsync(&engine, maxInFlight);
+        if (asyncStat >= 0) {
+            return asyncStat == 1;
+        }
+        // NOTE: (sonictk) Nothing was read, so it is safe to start over synchronously.
+        memset(stats, 0, sizeof(MayaDumpIOStats));
+        engine.numDone = 0;
+    }
+    engine.mode = MayaDumpIOMode_Sync;
+
+    MayaDumpIOContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    for (uint32_t i=0; i < numPaths; ++i) {
+        stats->maxInFlight = 1;
+        openMayaDumpIOContext(&engine, &ctx, i);
+        startMayaDumpIOContext(&engine, &ctx);
+    }
+
+    return engine.numDone == numPaths;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file   maya_read_custom_dump_scan.c
+ * @brief  A quick triage pass over a spool of dumps: one line per dump with its exception, the
+ *         scene that was open and the last DG node added, read with as little I/O as possible.
+ *         Meant for spools on network shares, where reading the dumps is all about latency; see
+ *         ``maya_read_custom_dump_io.c``. The same pass can also be made by mapping each dump in
+ *         turn, which is how the rest of the reader reads dumps, to compare the two.
+ */
+#define MAYA_SCAN_MODE_ASYNC "async"
+#define MAYA_SCAN_MODE_SYNC "sync"
+#define MAYA_SCAN_MODE_MAP "map"
+#define MAYA_SCAN_MODE_BENCH "bench"
+#define MAYA_SCAN_LINE_LEN 1024
+
+typedef enum MayaScanStream
+{
+    MayaScanStream_Exception = 0,
+    MayaScanStream_CrashInfo,
+    MayaScanStream_Scene,
+    MayaScanStream_Count
+} MayaScanStream;
+
+/// NOTE: (sonictk) The scene path is the first of the ``CommentStreamA`` streams written by the plugin.
+static const MayaDumpIOStreamRequest kMayaScanStreams[MayaScanStream_Count] = {
+    {ExceptionStream, 0},
+    {MAYA_CRASH_INFO_STREAM_TYPE, 0},
+    {CommentStreamA, 0}
+};
+
+typedef struct MayaScanJob
+{
+    char (*lines)[MAYA_SCAN_LINE_LEN]; // NOTE: (sonictk) One per dump, so that they can be printed in order.
+    bool print;
+} MayaScanJob;
+
+
+/// Formats the triage line of a dump from its streams.
+static void mayaScanDumpCB(const MayaDumpIOResult *result, void *userData)
+{
+    MayaScanJob *job = (MayaScanJob *)userData;
+    char *line = job->lines[result->pathIdx];
+    if (!result->ok) {
+        snprintf(line, MAYA_SCAN_LINE_LEN, "%s: could not be read\n", result->path);
+        return;
+    }
+
+    char exceptionDesc[64] = "no exception";
+    const MINIDUMP_EXCEPTION_STREAM *exception = (const MINIDUMP_EXCEPTION_STREAM *)result->streams[MayaScanStream_Exception];
+    if (exception != NULL && result->streamSizes[MayaScanStream_Exception] >= sizeof(MINIDUMP_EXCEPTION_STREAM)) {
+        snprintf(exceptionDesc, sizeof(exceptionDesc), "0x%08x at 0x%016llx",
+                 exception->ExceptionRecord.ExceptionCode, exception->ExceptionRecord.ExceptionAddress);
+    }
+    const char *scene = (const char *)result->streams[MayaScanStream_Scene];
+    const int lenScene = scene == NULL ? 0 : (int)strnlen(scene, result->streamSizes[MayaScanStream_Scene]);
+    const MayaCrashDumpInfo *crashInfo = (const MayaCrashDumpInfo *)result->streams[MayaScanStream_CrashInfo];
+    if (crashInfo != NULL && !isMayaDumpUserStreamSizeValid(MayaDumpUserStream_CrashInfo, result->streamSizes[MayaScanStream_CrashInfo])) {
+        crashInfo = NULL;
+    }
+    snprintf(line, MAYA_SCAN_LINE_LEN, "%s: %s, scene \"%.*s\", last DG node added \"%.*s\"\n",
+             result->path, exceptionDesc, lenScene, lenScene == 0 ? "" : scene,
+             crashInfo == NULL ? 1 : (int)strnlen(crashInfo->lastDGNodeAddedName, MAYA_DG_NODE_MAX_NAME_LEN), crashInfo == NULL ? "?" : crashInfo->lastDGNodeAddedName);
+
+    return;
+}
+
+
+/// Does the same pass as ``readMayaDumpStreams``, by mapping each dump in turn.
+static void readMayaDumpStreamsMapped(char **paths, uint32_t numPaths, MayaDumpIOCallback callback, void *userData, MayaDumpIOStats *stats)
+{
+    memset(stats, 0, sizeof(MayaDumpIOStats));
+    for (uint32_t i=0; i < numPaths; ++i) {
+        MayaDumpIOResult result;
+        memset(&result, 0, sizeof(result));
+        result.path = paths[i];
+        result.pathIdx = i;
+
+        // NOTE: (sonictk) Only the mapping is needed to look up the streams, not the rest of
+        // ``openMayaDiffDump``.
+        MayaDiffDump dump;
+        memset(&dump, 0, sizeof(dump));
+        dump.hFile = CreateFile(paths[i], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        LARGE_INTEGER fileSize;
+        if (dump.hFile != INVALID_HANDLE_VALUE && GetFileSizeEx(dump.hFile, &fileSize) == TRUE && fileSize.QuadPart > 0) {
+            dump.size = (uint64_t)fileSize.QuadPart;
+            dump.hMapFile = CreateFileMapping(dump.hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            dump.view = dump.hMapFile == NULL ? NULL : (const uint8_t *)MapViewOfFile(dump.hMapFile, FILE_MAP_READ, 0, 0, 0);
+        }
+        result.ok = dump.view != NULL && ((const MINIDUMP_HEADER *)dump.view)->Signature == MINIDUMP_SIGNATURE;
+        for (uint32_t j=0; j < MayaScanStream_Count && result.ok; ++j) {
+            result.streams[j] = findMayaDiffDumpStream(&dump, kMayaScanStreams[j].streamType, kMayaScanStreams[j].nth, &result.streamSizes[j]);
+            if (result.streams[j] == NULL) {
+                result.streamSizes[j] = 0;
+            }
+        }
+        callback(&result, userData);
+
+        ++stats->numDumps;
+        stats->numFailedDumps += result.ok ? 0 : 1;
+        stats->maxInFlight = 1;
+        closeMayaDiffDump(&dump);
+    }
+
+    return;
+}
+
+
+/// Runs a single pass over the dumps in the given mode, and prints how long it took.
+static bool runMayaScanPass(char **paths, uint32_t numPaths, const char *mode, uint32_t maxInFlight, MayaScanJob *job)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&startTime);
+
+    MayaDumpIOStats stats;
+    bool bStat = true;
+    if (strcmp(mode, MAYA_SCAN_MODE_MAP) == 0) {
+        readMayaDumpStreamsMapped(paths, numPaths, mayaScanDumpCB, job, &stats);
+    } else {
+        bStat = readMayaDumpStreams(paths, numPaths, kMayaScanStreams, MayaScanStream_Count,
+                                    strcmp(mode, MAYA_SCAN_MODE_SYNC) == 0 ? MayaDumpIOMode_Sync : MayaDumpIOMode_Async,
+                                    maxInFlight, mayaScanDumpCB, job, &stats);
+    }
+
+    QueryPerformanceCounter(&endTime);
+    const double elapsedSecs = (double)(endTime.QuadPart - startTime.QuadPart) / (double)freq.QuadPart;
+    if (job->print) {
+        for (uint32_t i=0; i < numPaths; ++i) {
+            fputs(job->lines[i], stdout);
+        }
+    }
+    // NOTE: (sonictk) Mapped dumps are read by page faults, so there is no count of the reads.
+    if (strcmp(mode, MAYA_SCAN_MODE_MAP) == 0) {
+        printf("%-5s: %u dumps (%u could not be read) in %.3f s, %.1f dumps/s.\n",
+               mode, stats.numDumps, stats.numFailedDumps, elapsedSecs,
+               elapsedSecs > 0.0 ? stats.numDumps / elapsedSecs : 0.0);
+    } else {
+        printf("%-5s: %u dumps (%u could not be read) in %.3f s, %.1f dumps/s, %llu reads, %.1f KB read, up to %u dumps in flight.\n",
+               mode, stats.numDumps, stats.numFailedDumps, elapsedSecs,
+               elapsedSecs > 0.0 ? stats.numDumps / elapsedSecs : 0.0,
+               stats.numReads, stats.numBytesRead / 1024.0, stats.maxInFlight);
+    }
+
+    return bStat && stats.numFailedDumps == 0;
+}
+
+
+/**
+ * Prints a line of triage for every dump in a spool directory.
+ *
+ * @param dirPath       The directory to look for dumps in.
+ * @param mode          ``async`` (the default) to read the dumps with overlapped reads,
+ *                      ``sync`` for the same reads done one after the other, or ``map`` to map
+ *                      each dump in turn. ``bench`` makes a pass in each mode, printing only how
+ *                      long each one took.
+ * @param maxInFlight   How many dumps to keep in flight at once in ``async`` mode; ``0`` for the
+ *                      default.
+ *
+ * @return              ``0`` if every dump was read, ``2`` otherwise.
+ */
+int scanMayaDumps(const char *dirPath, const char *mode, uint32_t maxInFlight)
+{
+    mode = mode == NULL ? MAYA_SCAN_MODE_ASYNC : mode;
+    if (strcmp(mode, MAYA_SCAN_MODE_ASYNC) != 0
+        && strcmp(mode, MAYA_SCAN_MODE_SYNC) != 0
+        && strcmp(mode, MAYA_SCAN_MODE_MAP) != 0
+        && strcmp(mode, MAYA_SCAN_MODE_BENCH) != 0) {
+        printf("ERROR: Unknown scan mode %s.\n", mode);
+        return 2;
+    }
+
+    char **paths = NULL;
+    uint32_t numPaths = 0;
+    if (!findMayaDiffSpoolDumps(dirPath, "", &paths, &numPaths)) {
+        printf("ERROR: Out of memory.\n");
+        return 2;
+    }
+
+    MayaScanJob job;
+    job.lines = (char (*)[MAYA_SCAN_LINE_LEN])calloc(numPaths + 1, MAYA_SCAN_LINE_LEN);
+    job.print = strcmp(mode, MAYA_SCAN_MODE_BENCH) != 0;
+    int result = 2;
+    if (job.lines == NULL) {
+        printf("ERROR: Out of memory.\n");
+    } else if (job.print) {
+        result = runMayaScanPass(paths, numPaths, mode, maxInFlight, &job) ? 0 : 2;
+    } else {
+        // NOTE: (sonictk) Every pass after the first might be served from the cache, which flatters
+        // it. The slowest way goes first so that it can't be the one that benefits.
+        printf("Scanning %u dumps in %s; later passes may be served from the file cache.\n", numPaths, dirPath);
+        bool bStat = runMayaScanPass(paths, numPaths, MAYA_SCAN_MODE_MAP, maxInFlight, &job);
+        bStat = runMayaScanPass(paths, numPaths, MAYA_SCAN_MODE_SYNC, maxInFlight, &job) && bStat;
+        bStat = runMayaScanPass(paths, numPaths, MAYA_SCAN_MODE_ASYNC, maxInFlight, &job) && bStat;
+        result = bStat ? 0 : 2;
+    }
+
+    free(job.lines);
+    for (uint32_t i=0; i < numPaths; ++i) {
+        free(paths[i]);
+    }
+    free(paths);
+
+    return result;
+}
@@ -0,0 +1,264 @@
+/**
+ * @file   maya_read_custom_dump_sidecars.c
+ * @brief  Aggregates the crash sidecars (and repeat records) in a directory by fingerprint, so
+ *         that a whole spool of crashes can be triaged without opening any of the dumps.
+ */
+#define MAYA_SIDECAR_GROUPS_INITIAL_CAPACITY 4096
+
+/// All the crashes seen with the same fingerprint.
+typedef struct MayaSidecarGroup
+{
+    uint64_t fingerprint;
+    uint64_t lastSeenTime;
+    uint32_t numCrashes; // NOTE: (sonictk) Number of crashes that were dumped, i.e. that have a sidecar.
+    uint32_t numRepeats; // NOTE: (sonictk) Number of crashes that only got a repeat record.
+    uint32_t exceptionCode;
+    uint32_t faultOffset;
+    char faultModuleName[MAYA_CRASH_SIDECAR_MODULE_NAME_LEN];
+    MayaCrashSidecarModule faultModule; // NOTE: (sonictk) Only valid if ``faultModuleName`` is set.
+    char faultSymbolName[MAYA_SYMBOL_SERVER_SYMBOL_NAME_LEN + 16];
+    char sceneName[MAYA_CRASH_SIDECAR_SCENE_NAME_LEN];
+} MayaSidecarGroup;
+
+typedef struct MayaSidecarGroupTable
+{
+    MayaSidecarGroup *groups;
+    uint32_t capacity; // NOTE: (sonictk) Always a power of two.
+    uint32_t numGroups;
+} MayaSidecarGroupTable;
+
+
+static MayaSidecarGroup *findOrAddMayaSidecarGroup(MayaSidecarGroupTable *table, uint64_t fingerprint);
+
+static bool growMayaSidecarGroupTable(MayaSidecarGroupTable *table)
+{
+    MayaSidecarGroupTable newTable = {0};
+    newTable.capacity = table->capacity == 0 ? MAYA_SIDECAR_GROUPS_INITIAL_CAPACITY : table->capacity * 2;
+    newTable.groups = (MayaSidecarGroup *)calloc(newTable.capacity, sizeof(MayaSidecarGroup));
+    if (newTable.groups == NULL) {
+        return false;
+    }
+    for (uint32_t i=0; i < table->capacity; ++i) {
+        if (table->groups[i].fingerprint == 0) {
+            continue;
+        }
+        *findOrAddMayaSidecarGroup(&newTable, table->groups[i].fingerprint) = table->groups[i];
+    }
+    free(table->groups);
+    *table = newTable;
+
+    return true;
+}
+
+
+/// Open addressing on the fingerprint, which is already a hash. A fingerprint of ``0`` marks an empty slot.
+static MayaSidecarGroup *findOrAddMayaSidecarGroup(MayaSidecarGroupTable *table, uint64_t fingerprint)
+{
+    if ((table->numGroups + 1) * 2 > table->capacity) {
+        if (!growMayaSidecarGroupTable(table)) {
+            return NULL;
+        }
+    }
+
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i=(uint32_t)fingerprint & mask;; i=(i + 1) & mask) {
+        MayaSidecarGroup *group = &table->groups[i];
+        if (group->fingerprint == fingerprint) {
+            return group;
+        }
+        if (group->fingerprint == 0) {
+            group->fingerprint = fingerprint;
+            ++table->numGroups;
+            return group;
+        }
+    }
+}
+
+
+/// Reads exactly ``lenBuf`` bytes from the start of the given file.
+static bool readMayaFixedSizeFile(const char *filePath, void *buf, DWORD lenBuf)
+{
+    HANDLE hFile = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD bytesRead = 0;
+    BOOL bStat = ReadFile(hFile, buf, lenBuf, &bytesRead, NULL);
+    CloseHandle(hFile);
+
+    return bStat == TRUE && bytesRead == lenBuf;
+}
+
+
+static int compareSidecarGroupCounts(const void *a, const void *b)
+{
+    const MayaSidecarGroup *groupA = *(const MayaSidecarGroup **)a;
+    const MayaSidecarGroup *groupB = *(const MayaSidecarGroup **)b;
+    uint64_t countA = (uint64_t)groupA->numCrashes + groupA->numRepeats;
+    uint64_t countB = (uint64_t)groupB->numCrashes + groupB->numRepeats;
+    if (countA == countB) {
+        return 0;
+    }
+
+    return countA > countB ? -1 : 1;
+}
+
+
+/**
+ * Reads all the sidecars and repeat records in the given directory, and prints out how often
+ * each distinct crash happened, most frequent first.
+ *
+ * @param dirPath   The directory to read from.
+ *
+ * @return          ``0`` on success, ``1`` otherwise.
+ */
+int aggregateAndPrintCrashSidecars(const char *dirPath)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&startTime);
+
+    MayaSidecarGroupTable table = {0};
+    uint32_t numSidecars = 0;
+    uint32_t numRepeatRecords = 0;
+    uint32_t numInvalid = 0;
+
+    char searchPath[MAX_PATH] = {0};
+    char filePath[MAX_PATH] = {0};
+    WIN32_FIND_DATA findData;
+
+    MayaCrashSidecar sidecar;
+    snprintf(searchPath, MAX_PATH, "%s\\%s", dirPath, MAYA_CRASH_SIDECAR_FILE_PATTERN);
+    HANDLE hFind = FindFirstFile(searchPath, &findData);
+    for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE; bStat = FindNextFile(hFind, &findData)) {
+        snprintf(filePath, MAX_PATH, "%s\\%s", dirPath, findData.cFileName);
+        if (!readMayaFixedSizeFile(filePath, &sidecar, sizeof(sidecar))
+            || sidecar.magic != MAYA_CRASH_SIDECAR_MAGIC
+            || sidecar.version != MAYA_CRASH_SIDECAR_VERSION) {
+            ++numInvalid;
+            continue;
+        }
+        MayaSidecarGroup *group = findOrAddMayaSidecarGroup(&table, sidecar.fingerprint);
+        if (group == NULL) {
+            printf("ERROR: Out of memory.\n");
+            FindClose(hFind);
+            free(table.groups);
+            return 1;
+        }
+        ++numSidecars;
+        ++group->numCrashes;
+        if (sidecar.timestamp >= group->lastSeenTime) {
+            group->lastSeenTime = sidecar.timestamp;
+            group->exceptionCode = sidecar.exceptionCode;
+            group->faultOffset = sidecar.exceptionAddress.offset;
+            group->faultModuleName[0] = '\0';
+            if (sidecar.exceptionAddress.moduleIdx < sidecar.numModules && sidecar.exceptionAddress.moduleIdx < MAYA_CRASH_SIDECAR_MAX_MODULES) {
+                group->faultModule = sidecar.modules[sidecar.exceptionAddress.moduleIdx];
+                memcpy(group->faultModuleName, group->faultModule.pdbName, MAYA_CRASH_SIDECAR_MODULE_NAME_LEN);
+                group->faultModuleName[MAYA_CRASH_SIDECAR_MODULE_NAME_LEN - 1] = '\0';
+            }
+            memcpy(group->sceneName, sidecar.sceneName, MAYA_CRASH_SIDECAR_SCENE_NAME_LEN);
+            group->sceneName[MAYA_CRASH_SIDECAR_SCENE_NAME_LEN - 1] = '\0';
+        }
+    }
+    if (hFind != INVALID_HANDLE_VALUE) {
+        FindClose(hFind);
+    }
+
+    MayaCrashRepeatRecord record;
+    snprintf(searchPath, MAX_PATH, "%s\\%s_*.bin", dirPath, MAYA_CRASH_REPEAT_RECORD_FILE_PREFIX);
+    hFind = FindFirstFile(searchPath, &findData);
+    for (BOOL bStat = hFind != INVALID_HANDLE_VALUE; bStat == TRUE; bStat = FindNextFile(hFind, &findData)) {
+        snprintf(filePath, MAX_PATH, "%s\\%s", dirPath, findData.cFileName);
+        if (!readMayaFixedSizeFile(filePath, &record, sizeof(record)) || record.magic != MAYA_CRASH_REPEAT_RECORD_MAGIC) {
+            ++numInvalid;
+            continue;
+        }
+        MayaSidecarGroup *group = findOrAddMayaSidecarGroup(&table, record.fingerprint);
+        if (group == NULL) {
+            printf("ERROR: Out of memory.\n");
+            FindClose(hFind);
+            free(table.groups);
+            return 1;
+        }
+        ++numRepeatRecords;
+        // NOTE: (sonictk) The count includes the crash that was dumped, which has its own sidecar.
+        group->numRepeats += record.count > 0 ? record.count - 1 : 0;
+        if (group->numCrashes == 0) {
+            group->exceptionCode = record.exceptionCode;
+            group->faultOffset = (uint32_t)record.faultModuleOffset;
+        }
+        if (record.lastSeenTime > group->lastSeenTime) {
+            group->lastSeenTime = record.lastSeenTime;
+        }
+    }
+    if (hFind != INVALID_HANDLE_VALUE) {
+        FindClose(hFind);
+    }
+
+    MayaSidecarGroup **sortedGroups = (MayaSidecarGroup **)malloc((table.numGroups + 1) * sizeof(MayaSidecarGroup *));
+    if (sortedGroups == NULL) {
+        printf("ERROR: Out of memory.\n");
+        free(table.groups);
+        return 1;
+    }
+    uint32_t numSorted = 0;
+    for (uint32_t i=0; i < table.capacity; ++i) {
+        if (table.groups[i].fingerprint != 0) {
+            sortedGroups[numSorted++] = &table.groups[i];
+        }
+    }
+    qsort((void *)sortedGroups, numSorted, sizeof(sortedGroups[0]), compareSidecarGroupCounts);
+
+    // NOTE: (sonictk) Name the faults if there is a symbol server running to ask.
+    static MayaSymbolClient symbolClient;
+    if (connectMayaSymbolServer(&symbolClient)) {
+        bool symbolized = true;
+        for (uint32_t i=0; i < numSorted && symbolized; ++i) {
+            MayaSidecarGroup *group = sortedGroups[i];
+            if (group->faultModuleName[0] != '\0') {
+                symbolized = queueMayaSymbolLookup(&symbolClient, &group->faultModule, group->faultOffset,
+                                                   group->faultSymbolName, sizeof(group->faultSymbolName));
+            }
+        }
+        if (!symbolized || !flushMayaSymbolLookups(&symbolClient)) {
+            printf("WARNING: The symbol server stopped answering; some faults are not named.\n");
+        }
+        disconnectMayaSymbolServer(&symbolClient);
+    }
+
+    QueryPerformanceCounter(&endTime);
+    printf("Read %u sidecars and %u repeat records (%u invalid) from %s in %.1f ms: %u distinct crashes.\n",
+           numSidecars, numRepeatRecords, numInvalid, dirPath,
+           (double)(endTime.QuadPart - startTime.QuadPart) * 1000.0 / (double)freq.QuadPart,
+           numSorted);
+    printf("%8s %8s %-10s %-18s %-48s %-19s %s\n", "Dumped", "Repeats", "Exception", "Fingerprint", "Fault", "Last seen (UTC)", "Scene");
+
+    char faultBuf[MAYA_CRASH_SIDECAR_MODULE_NAME_LEN + MAYA_SYMBOL_SERVER_SYMBOL_NAME_LEN + 16] = {0};
+    for (uint32_t i=0; i < numSorted; ++i) {
+        const MayaSidecarGroup *group = sortedGroups[i];
+        if (group->faultSymbolName[0] != '\0') {
+            snprintf(faultBuf, sizeof(faultBuf), "%s!%s", group->faultModuleName, group->faultSymbolName);
+        } else if (group->faultModuleName[0] != '\0') {
+            snprintf(faultBuf, sizeof(faultBuf), "%s+0x%x", group->faultModuleName, group->faultOffset);
+        } else {
+            snprintf(faultBuf, sizeof(faultBuf), "0x%x", group->faultOffset);
+        }
+        FILETIME lastSeenFileTime;
+        lastSeenFileTime.dwLowDateTime = (DWORD)group->lastSeenTime;
+        lastSeenFileTime.dwHighDateTime = (DWORD)(group->lastSeenTime >> 32);
+        SYSTEMTIME lastSeen = {0};
+        FileTimeToSystemTime(&lastSeenFileTime, &lastSeen);
+        printf("%8u %8u 0x%08x 0x%016llx %-48s %04u-%02u-%02u %02u:%02u:%02u %s\n",
+               group->numCrashes, group->numRepeats, group->exceptionCode, group->fingerprint, faultBuf,
+               lastSeen.wYear, lastSeen.wMonth, lastSeen.wDay, lastSeen.wHour, lastSeen.wMinute, lastSeen.wSecond,
+               group->sceneName);
+    }
+
+    free(sortedGroups);
+    free(table.groups);
+
+    return 0;
+}
@@ -0,0 +1,842 @@
+/**
+ * @file   maya_read_custom_dump_stream.c
+ * @brief  Reads full-memory dumps that are too large to map, within a fixed memory budget. Only
+ *         the start of the dump, where the stream directory and every stream other than the
+ *         memory itself live, is read into memory: it is small, and everything that reads mapped
+ *         dumps can read it as-is. The memory of the process, which makes up nearly all of the
+ *         file, is then read in a single forward pass through two windows of fixed size, one of
+ *         which is always being read ahead while the other is looked at. What can't be done in a
+ *         forward pass (i.e. looking up the RTTI of the vtables found) is done in a few more
+ *         passes that only read the bytes needed, in the order that they are in the file.
+ *
+ *         Every offset into the file is 64-bit; the memory of a full dump lies well past 4 GB
+ *         into the file more often than not.
+ */
+#define MAYA_STREAM_DEFAULT_BUDGET_MB 256
+#define MAYA_STREAM_MIN_BUDGET_MB 16
+#define MAYA_STREAM_MAX_WINDOW_SIZE (64 * 1024 * 1024)
+#define MAYA_STREAM_MIN_WINDOW_SIZE (1024 * 1024)
+#define MAYA_STREAM_MAX_READ_SIZE (16 * 1024 * 1024) // NOTE: (sonictk) Per ``ReadFile``.
+#define MAYA_STREAM_MODULE_HEADERS_SIZE 4096 // NOTE: (sonictk) The headers and section table of a module nearly always fit in its first page.
+#define MAYA_STREAM_FETCH_MAX_GAP 4096 // NOTE: (sonictk) Reading over a gap this small is cheaper than another read.
+#define MAYA_STREAM_NUM_FETCHES_PER_VTABLE 3
+
+/// A region of the dumped process' memory that is looked through for vtable pointers.
+typedef struct MayaStreamRegion
+{
+    uint64_t start;
+    uint64_t end;
+} MayaStreamRegion;
+
+/// Some of the dumped process' memory to read, for the passes after the first one.
+typedef struct MayaStreamFetch
+{
+    uint64_t address;
+    uint64_t size;
+    uint64_t fileOffset;
+} MayaStreamFetch;
+
+/// One of the windows that the memory is read through.
+typedef struct MayaStreamWindow
+{
+    OVERLAPPED overlapped;
+    HANDLE hEvent;
+    uint8_t *buf;
+    uint64_t fileOffset;
+    DWORD size;
+    bool pending;
+} MayaStreamWindow;
+
+typedef struct MayaStreamReader
+{
+    HANDLE hFile;
+    HANDLE hEvent; // NOTE: (sonictk) For the reads that are waited on straight away.
+    uint64_t fileSize;
+    uint64_t budget;
+
+    MayaDiffDump dump; // NOTE: (sonictk) Only the start of the file, up to where the memory begins.
+    uint32_t numHiddenStreams;
+    const MINIDUMP_MEMORY64_LIST *memoryList;
+    uint64_t memoryEnd;
+
+    // NOTE: (sonictk) The memory ranges, with their offsets into the file rather than into a
+    // view, so they must never be read through with ``readMayaHeapMemory``.
+    MayaHeapDump index;
+
+    MayaStreamRegion *regions; // NOTE: (sonictk) Sorted by address.
+    uint32_t numRegions;
+    uint32_t numPrivateAllocations;
+    uint64_t privateBytes;
+
+    MayaHeapDump images; // NOTE: (sonictk) Only its read-only data sections are kept around.
+
+    MayaHeapVtableTable vtables;
+    uint32_t maxVtableCapacity;
+    uint64_t numVtablePointersDropped;
+    uint64_t numBytesScanned;
+
+    uint64_t numBytesRead;
+    uint64_t numReads;
+} MayaStreamReader;
+
+
+/// Defined along with the printers of each stream.
+void printMayaDumpUserStreams(PVOID pFileView);
+
+
+/// Reads from the given offset in the dump, waiting for the read to complete.
+static bool readMayaStreamFile(MayaStreamReader *reader, uint64_t fileOffset, void *buf, uint64_t size)
+{
+    uint8_t *dst = (uint8_t *)buf;
+    while (size > 0) {
+        const DWORD sizeToRead = size > MAYA_STREAM_MAX_READ_SIZE ? MAYA_STREAM_MAX_READ_SIZE : (DWORD)size;
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = (DWORD)fileOffset;
+        overlapped.OffsetHigh = (DWORD)(fileOffset >> 32);
+        overlapped.hEvent = reader->hEvent;
+        if (ReadFile(reader->hFile, dst, sizeToRead, NULL, &overlapped) == FALSE && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        DWORD numBytesRead = 0;
+        if (GetOverlappedResult(reader->hFile, &overlapped, &numBytesRead, TRUE) == FALSE || numBytesRead == 0) {
+            return false;
+        }
+        ++reader->numReads;
+        reader->numBytesRead += numBytesRead;
+        dst += numBytesRead;
+        fileOffset += numBytesRead;
+        size -= numBytesRead;
+    }
+
+    return true;
+}
+
+
+static int compareMayaStreamFetchOffsets(const void *a, const void *b)
+{
+    uint64_t offsetA = ((const MayaStreamFetch *)a)->fileOffset;
+    uint64_t offsetB = ((const MayaStreamFetch *)b)->fileOffset;
+
+    return offsetA == offsetB ? 0 : offsetA < offsetB ? -1 : 1;
+}
+
+
+static int compareMayaStreamRegions(const void *a, const void *b)
+{
+    uint64_t startA = ((const MayaStreamRegion *)a)->start;
+    uint64_t startB = ((const MayaStreamRegion *)b)->start;
+
+    return startA == startB ? 0 : startA < startB ? -1 : 1;
+}
+
+
+/**
+ * Reads the given bits of the dumped process' memory, in the order that they are in the file, so
+ * that they can then be read with ``readMayaHeapMemory``. Bits that aren't in the dump are left
+ * out.
+ *
+ * @param reader        The dump.
+ * @param fetches       What to read. Reordered and merged in place.
+ * @param numFetches    The number of entries in ``fetches``.
+ * @param cache         Storage for what was read. Must be freed with ``freeMayaStreamCache``.
+ *
+ * @return              ``false`` if it ran out of memory, ``true`` otherwise.
+ */
+static bool fetchMayaStreamMemory(MayaStreamReader *reader, MayaStreamFetch *fetches, uint32_t numFetches, MayaHeapDump *cache)
+{
+    memset(cache, 0, sizeof(MayaHeapDump));
+    uint32_t numInDump = 0;
+    for (uint32_t i=0; i < numFetches; ++i) {
+        MayaStreamFetch fetch = fetches[i];
+        const uint32_t lo = findNextMayaHeapMemoryRange(&reader->index, fetch.address);
+        if (lo == 0 || fetch.address - reader->index.ranges[lo - 1].start >= reader->index.ranges[lo - 1].size) {
+            continue;
+        }
+        const MayaHeapMemoryRange *range = &reader->index.ranges[lo - 1];
+        const uint64_t offsetInRange = fetch.address - range->start;
+        fetch.size = fetch.size < range->size - offsetInRange ? fetch.size : range->size - offsetInRange;
+        fetch.fileOffset = range->fileOffset + offsetInRange;
+        fetches[numInDump++] = fetch;
+    }
+
+    // NOTE: (sonictk) Bits that are next to each other in both the file and the process (i.e.
+    // that are off by the same amount) are read in one go, including any small gap between them.
+    qsort(fetches, numInDump, sizeof(MayaStreamFetch), compareMayaStreamFetchOffsets);
+    uint32_t numMerged = 0;
+    uint64_t totalSize = 0;
+    for (uint32_t i=0; i < numInDump; ++i) {
+        const MayaStreamFetch *fetch = &fetches[i];
+        MayaStreamFetch *last = numMerged == 0 ? NULL : &fetches[numMerged - 1];
+        if (last != NULL
+            && fetch->address - fetch->fileOffset == last->address - last->fileOffset
+            && fetch->fileOffset <= last->fileOffset + last->size + MAYA_STREAM_FETCH_MAX_GAP) {
+            const uint64_t end = fetch->fileOffset + fetch->size;
+            if (end > last->fileOffset + last->size) {
+                totalSize += end - (last->fileOffset + last->size);
+                last->size = end - last->fileOffset;
+            }
+            continue;
+        }
+        fetches[numMerged++] = *fetch;
+        totalSize += fetch->size;
+    }
+
+    uint8_t *buf = (uint8_t *)malloc((size_t)totalSize + 1);
+    cache->ranges = (MayaHeapMemoryRange *)calloc(numMerged + 1, sizeof(MayaHeapMemoryRange));
+    if (buf == NULL || cache->ranges == NULL) {
+        free(buf);
+        free(cache->ranges);
+        cache->ranges = NULL;
+        return false;
+    }
+    uint64_t bufOffset = 0;
+    for (uint32_t i=0; i < numMerged; ++i) {
+        if (!readMayaStreamFile(reader, fetches[i].fileOffset, buf + bufOffset, fetches[i].size)) {
+            continue;
+        }
+        MayaHeapMemoryRange *range = &cache->ranges[cache->numRanges++];
+        range->start = fetches[i].address;
+        range->size = fetches[i].size;
+        range->fileOffset = bufOffset;
+        bufOffset += fetches[i].size;
+    }
+    qsort(cache->ranges, cache->numRanges, sizeof(MayaHeapMemoryRange), compareMayaHeapMemoryRanges);
+    cache->dump.view = buf;
+    cache->dump.size = bufOffset;
+
+    return true;
+}
+
+
+/// Frees what was read by ``fetchMayaStreamMemory``, leaving anything else in ``cache`` alone.
+static void freeMayaStreamCache(MayaHeapDump *cache)
+{
+    free((void *)cache->dump.view);
+    cache->dump.view = NULL;
+    cache->dump.size = 0;
+    free(cache->ranges);
+    cache->ranges = NULL;
+    cache->numRanges = 0;
+
+    return;
+}
+
+
+static void closeMayaStreamDump(MayaStreamReader *reader)
+{
+    freeMayaStreamCache(&reader->images);
+    free(reader->images.imageRanges);
+    free(reader->vtables.keys);
+    free(reader->vtables.counts);
+    free(reader->regions);
+    free(reader->index.ranges);
+    // NOTE: (sonictk) The start of the dump was read rather than mapped, so free it before
+    // ``closeMayaDiffDump`` tries to unmap it.
+    free((void *)reader->dump.view);
+    reader->dump.view = NULL;
+    closeMayaDiffDump(&reader->dump);
+    if (reader->hEvent != NULL) {
+        CloseHandle(reader->hEvent);
+    }
+    if (reader->hFile != INVALID_HANDLE_VALUE && reader->hFile != NULL) {
+        CloseHandle(reader->hFile);
+    }
+    memset(reader, 0, sizeof(MayaStreamReader));
+
+    return;
+}
+
+
+/**
+ * Reads the start of the dump, up to where the memory of the process begins, and indexes the
+ * memory.
+ *
+ * @param path      The dump to open.
+ * @param budget    The most memory to use, in bytes.
+ * @param reader    Storage for the dump. Must be closed with ``closeMayaStreamDump`` even if this fails.
+ *
+ * @return          ``true`` if the dump was opened successfully, ``false`` otherwise.
+ */
+static bool openMayaStreamDump(const char *path, uint64_t budget, MayaStreamReader *reader)
+{
+    memset(reader, 0, sizeof(MayaStreamReader));
+    reader->budget = budget;
+    reader->dump.path = path;
+    reader->hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED|FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    reader->hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    LARGE_INTEGER fileSize;
+    if (reader->hFile == INVALID_HANDLE_VALUE || reader->hEvent == NULL || GetFileSizeEx(reader->hFile, &fileSize) == FALSE) {
+        printf("ERROR: Could not open the dump file requested.\n");
+        return false;
+    }
+    reader->fileSize = (uint64_t)fileSize.QuadPart;
+
+    MINIDUMP_HEADER header;
+    if (!readMayaStreamFile(reader, 0, &header, sizeof(header)) || header.Signature != MINIDUMP_SIGNATURE) {
+        printf("ERROR: The file is not a minidump.\n");
+        return false;
+    }
+    const uint64_t dirSize = (uint64_t)header.NumberOfStreams * sizeof(MINIDUMP_DIRECTORY);
+    MINIDUMP_DIRECTORY *dir = (MINIDUMP_DIRECTORY *)malloc((size_t)dirSize + 1);
+    if (dir == NULL || !readMayaStreamFile(reader, header.StreamDirectoryRva, dir, dirSize)) {
+        printf("ERROR: Could not read the stream directory of the dump.\n");
+        free(dir);
+        return false;
+    }
+
+    // NOTE: (sonictk) The memory is written last, after every other stream. Everything before it
+    // is what gets read in.
+    uint64_t prefixSize = reader->fileSize;
+    for (ULONG32 i=0; i < header.NumberOfStreams; ++i) {
+        MINIDUMP_MEMORY64_LIST memoryListHeader;
+        if (dir[i].StreamType == Memory64ListStream
+            && dir[i].Location.DataSize >= sizeof(MINIDUMP_MEMORY64_LIST)
+            && readMayaStreamFile(reader, dir[i].Location.Rva, &memoryListHeader, sizeof(MINIDUMP_MEMORY64_LIST))
+            && memoryListHeader.BaseRva < prefixSize) {
+            prefixSize = memoryListHeader.BaseRva;
+        }
+    }
+    free(dir);
+    if (prefixSize > budget / 4 || (uint64_t)header.StreamDirectoryRva + dirSize > prefixSize) {
+        printf("ERROR: The streams of the dump take up %.1f MB, which is more than a quarter of the budget.\n", prefixSize / (1024.0 * 1024.0));
+        return false;
+    }
+    uint8_t *prefix = (uint8_t *)malloc((size_t)prefixSize + 1);
+    if (prefix == NULL || !readMayaStreamFile(reader, 0, prefix, prefixSize)) {
+        printf("ERROR: Could not read the streams of the dump.\n");
+        free(prefix);
+        return false;
+    }
+    reader->dump.view = prefix;
+    reader->dump.size = prefixSize;
+
+    // NOTE: (sonictk) Anything that lies past the start of the memory wasn't read in. Hide it, so
+    // that nothing that looks through the directory reads past the end of what was.
+    MINIDUMP_DIRECTORY *prefixDir = (MINIDUMP_DIRECTORY *)(prefix + header.StreamDirectoryRva);
+    for (ULONG32 i=0; i < header.NumberOfStreams; ++i) {
+        if (prefixDir[i].StreamType != UnusedStream
+            && (uint64_t)prefixDir[i].Location.Rva + prefixDir[i].Location.DataSize > prefixSize) {
+            prefixDir[i].StreamType = UnusedStream;
+            ++reader->numHiddenStreams;
+        }
+    }
+    if (!parseMayaDiffDump(&reader->dump)) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+
+    ULONG streamSize = 0;
+    const MINIDUMP_MEMORY64_LIST *memoryList = (const MINIDUMP_MEMORY64_LIST *)findMayaDiffDumpStream(&reader->dump, Memory64ListStream, 0, &streamSize);
+    if (memoryList == NULL
+        || streamSize < sizeof(MINIDUMP_MEMORY64_LIST)
+        || (streamSize - sizeof(MINIDUMP_MEMORY64_LIST)) / sizeof(MINIDUMP_MEMORY_DESCRIPTOR64) < memoryList->NumberOfMemoryRanges) {
+        printf("ERROR: The dump does not contain the full memory of the process.\n");
+        return false;
+    }
+    reader->memoryList = memoryList;
+    reader->index.ranges = (MayaHeapMemoryRange *)calloc((size_t)memoryList->NumberOfMemoryRanges + 1, sizeof(MayaHeapMemoryRange));
+    if (reader->index.ranges == NULL) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+    uint64_t fileOffset = memoryList->BaseRva;
+    for (ULONG64 i=0; i < memoryList->NumberOfMemoryRanges; ++i) {
+        const MINIDUMP_MEMORY_DESCRIPTOR64 *desc = &memoryList->MemoryRanges[i];
+        if (fileOffset > reader->fileSize || desc->DataSize > reader->fileSize - fileOffset) {
+            break;
+        }
+        MayaHeapMemoryRange *range = &reader->index.ranges[reader->index.numRanges++];
+        range->start = desc->StartOfMemoryRange;
+        range->size = desc->DataSize;
+        range->fileOffset = fileOffset;
+        fileOffset += desc->DataSize;
+    }
+    reader->memoryEnd = fileOffset;
+    qsort(reader->index.ranges, reader->index.numRanges, sizeof(MayaHeapMemoryRange), compareMayaHeapMemoryRanges);
+
+    return true;
+}
+
+
+/// Works out which memory to look for vtable pointers in, the same way as ``printMayaHeapSummary``.
+static bool findMayaStreamRegions(MayaStreamReader *reader)
+{
+    ULONG streamSize = 0;
+    const MINIDUMP_MEMORY_INFO_LIST *memoryInfoList = (const MINIDUMP_MEMORY_INFO_LIST *)findMayaDiffDumpStream(&reader->dump, MemoryInfoListStream, 0, &streamSize);
+    if (memoryInfoList == NULL
+        || streamSize < sizeof(MINIDUMP_MEMORY_INFO_LIST)
+        || memoryInfoList->SizeOfHeader > streamSize
+        || memoryInfoList->SizeOfEntry < sizeof(MINIDUMP_MEMORY_INFO)
+        || (streamSize - memoryInfoList->SizeOfHeader) / memoryInfoList->SizeOfEntry < memoryInfoList->NumberOfEntries) {
+        printf("ERROR: The dump does not contain the memory info of the process.\n");
+        return false;
+    }
+    const uint8_t *memoryInfos = (const uint8_t *)memoryInfoList + memoryInfoList->SizeOfHeader;
+    const uint32_t numMemoryInfos = (uint32_t)memoryInfoList->NumberOfEntries;
+    reader->regions = (MayaStreamRegion *)calloc(numMemoryInfos + 1, sizeof(MayaStreamRegion));
+    if (reader->regions == NULL) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+    uint64_t lastAllocationBase = 0;
+    for (uint32_t i=0; i < numMemoryInfos; ++i) {
+        const MINIDUMP_MEMORY_INFO *info = (const MINIDUMP_MEMORY_INFO *)(memoryInfos + (size_t)i * memoryInfoList->SizeOfEntry);
+        if (info->State != MEM_COMMIT || info->Type != MEM_PRIVATE) {
+            continue;
+        }
+        reader->privateBytes += info->RegionSize;
+        if (info->AllocationBase != lastAllocationBase || reader->numPrivateAllocations == 0) {
+            lastAllocationBase = info->AllocationBase;
+            ++reader->numPrivateAllocations;
+        }
+        if ((info->Protect & (PAGE_READWRITE|PAGE_WRITECOPY)) == 0 || (info->Protect & PAGE_GUARD) != 0) {
+            continue;
+        }
+        MayaStreamRegion *region = &reader->regions[reader->numRegions++];
+        region->start = info->BaseAddress;
+        region->end = info->BaseAddress + info->RegionSize;
+    }
+    qsort(reader->regions, reader->numRegions, sizeof(MayaStreamRegion), compareMayaStreamRegions);
+
+    return true;
+}
+
+
+/// Reads the headers of every module, and indexes their read-only data sections.
+static bool indexMayaStreamImageRanges(MayaStreamReader *reader)
+{
+    MayaStreamFetch *fetches = (MayaStreamFetch *)calloc(reader->dump.numModules + 1, sizeof(MayaStreamFetch));
+    if (fetches == NULL) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+    for (uint32_t i=0; i < reader->dump.numModules; ++i) {
+        fetches[i].address = reader->dump.modules[i].baseOfImage;
+        fetches[i].size = MAYA_STREAM_MODULE_HEADERS_SIZE;
+    }
+    bool bStat = fetchMayaStreamMemory(reader, fetches, reader->dump.numModules, &reader->images);
+    free(fetches);
+    if (!bStat) {
+        printf("ERROR: Out of memory.\n");
+        return false;
+    }
+    reader->images.dump.modules = reader->dump.modules;
+    reader->images.dump.numModules = reader->dump.numModules;
+    bStat = indexMayaHeapImageRanges(&reader->images);
+    // NOTE: (sonictk) The modules belong to ``reader->dump``, and the headers aren't needed any more.
+    reader->images.dump.modules = NULL;
+    reader->images.dump.numModules = 0;
+    freeMayaStreamCache(&reader->images);
+
+    return bStat;
+}
+
+
+/// Counts a pointer to a possible vtable, unless the table of them is already as large as the
+/// budget allows and it isn't in there yet.
+static void countMayaStreamVtable(MayaStreamReader *reader, uint64_t vtable)
+{
+    MayaHeapVtableTable *table = &reader->vtables;
+    if ((table->numKeys + 1) * 2 <= table->capacity || table->capacity < reader->maxVtableCapacity) {
+        if (!addMayaHeapVtableCount(table, vtable, 1)) {
+            ++reader->numVtablePointersDropped;
+        }
+        return;
+    }
+
+    // NOTE: (sonictk) Same probing as ``addMayaHeapVtableCount``.
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i=(uint32_t)(((vtable >> 3) * 0x9e3779b97f4a7c15ULL) >> 32) & mask;; i=(i + 1) & mask) {
+        if (table->keys[i] == vtable) {
+            ++table->counts[i];
+            return;
+        }
+        if (table->keys[i] == 0) {
+            ++reader->numVtablePointersDropped;
+            return;
+        }
+    }
+}
+
+
+/// Counts every 8-byte aligned value in the given memory that points into a read-only data
+/// section, if the memory is somewhere that objects live.
+static void scanMayaStreamMemory(MayaStreamReader *reader, uint64_t address, const uint8_t *mem, uint64_t size)
+{
+    uint32_t lo = 0;
+    uint32_t hi = reader->numRegions;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (reader->regions[mid].start <= address) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const uint64_t end = address + size;
+    const MayaHeapDump *images = &reader->images;
+    for (uint32_t i=lo == 0 ? 0 : lo - 1; i < reader->numRegions && reader->regions[i].start < end; ++i) {
+        uint64_t start = reader->regions[i].start > address ? reader->regions[i].start : address;
+        const uint64_t stop = reader->regions[i].end < end ? reader->regions[i].end : end;
+        start = (start + 7) & ~7ULL;
+        for (uint64_t cur=start; cur + sizeof(uint64_t) <= stop; cur += sizeof(uint64_t)) {
+            uint64_t value;
+            memcpy(&value, mem + (cur - address), sizeof(uint64_t));
+            // NOTE: (sonictk) Nearly everything on the heap is rejected by this first check alone.
+            if (value < images->minImageAddress || value >= images->maxImageAddress || (value & 7) != 0) {
+                continue;
+            }
+            if (findMayaHeapImageRange(images, value) != NULL) {
+                countMayaStreamVtable(reader, value);
+            }
+        }
+        reader->numBytesScanned += stop > start ? stop - start : 0;
+    }
+
+    return;
+}
+
+
+static bool issueMayaStreamWindow(MayaStreamReader *reader, MayaStreamWindow *window, uint64_t fileOffset, DWORD size)
+{
+    memset(&window->overlapped, 0, sizeof(OVERLAPPED));
+    window->overlapped.Offset = (DWORD)fileOffset;
+    window->overlapped.OffsetHigh = (DWORD)(fileOffset >> 32);
+    window->overlapped.hEvent = window->hEvent;
+    window->fileOffset = fileOffset;
+    window->size = size;
+    if (ReadFile(reader->hFile, window->buf, size, NULL, &window->overlapped) == FALSE && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    window->pending = true;
+
+    return true;
+}
+
+
+static bool waitMayaStreamWindow(MayaStreamReader *reader, MayaStreamWindow *window)
+{
+    DWORD numBytesRead = 0;
+    window->pending = false;
+    if (GetOverlappedResult(reader->hFile, &window->overlapped, &numBytesRead, TRUE) == FALSE) {
+        return false;
+    }
+    ++reader->numReads;
+    reader->numBytesRead += numBytesRead;
+
+    return numBytesRead == window->size;
+}
+
+
+/**
+ * Reads through all of the memory in the dump once, from start to end, looking for vtable
+ * pointers.
+ *
+ * @param reader    The dump.
+ *
+ * @return          ``true`` if all of the memory was read, ``false`` otherwise.
+ */
+static bool streamMayaDumpMemory(MayaStreamReader *reader)
+{
+    uint64_t windowSize = (reader->budget / 8) & ~0xffffULL;
+    windowSize = windowSize > MAYA_STREAM_MAX_WINDOW_SIZE ? MAYA_STREAM_MAX_WINDOW_SIZE : windowSize;
+    windowSize = windowSize < MAYA_STREAM_MIN_WINDOW_SIZE ? MAYA_STREAM_MIN_WINDOW_SIZE : windowSize;
+
+    MayaStreamWindow windows[2];
+    memset(windows, 0, sizeof(windows));
+    bool bStat = true;
+    for (int i=0; i < 2; ++i) {
+        windows[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        windows[i].buf = (uint8_t *)VirtualAlloc(NULL, (SIZE_T)windowSize, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        bStat = bStat && windows[i].hEvent != NULL && windows[i].buf != NULL;
+    }
+
+    // NOTE: (sonictk) The memory ranges are laid out in the file one after the other, in the
+    // order of their descriptors; follow along with them as the windows move through the file.
+    const MINIDUMP_MEMORY64_LIST *memoryList = reader->memoryList;
+    ULONG64 descIdx = 0;
+    uint64_t descFileOffset = memoryList->BaseRva;
+    uint64_t nextFileOffset = memoryList->BaseRva;
+    for (int i=0; i < 2 && bStat && nextFileOffset < reader->memoryEnd; ++i) {
+        const DWORD size = (DWORD)(reader->memoryEnd - nextFileOffset < windowSize ? reader->memoryEnd - nextFileOffset : windowSize);
+        bStat = issueMayaStreamWindow(reader, &windows[i], nextFileOffset, size);
+        nextFileOffset += size;
+    }
+    for (uint32_t k=0; bStat && windows[k % 2].pending; ++k) {
+        MayaStreamWindow *window = &windows[k % 2];
+        if (!waitMayaStreamWindow(reader, window)) {
+            bStat = false;
+            break;
+        }
+
+        const uint64_t windowEnd = window->fileOffset + window->size;
+        while (descIdx < memoryList->NumberOfMemoryRanges) {
+            const MINIDUMP_MEMORY_DESCRIPTOR64 *desc = &memoryList->MemoryRanges[descIdx];
+            const uint64_t descEnd = descFileOffset + desc->DataSize;
+            const uint64_t pieceStart = descFileOffset > window->fileOffset ? descFileOffset : window->fileOffset;
+            const uint64_t pieceEnd = descEnd < windowEnd ? descEnd : windowEnd;
+            if (pieceStart < pieceEnd) {
+                scanMayaStreamMemory(reader,
+                                     desc->StartOfMemoryRange + (pieceStart - descFileOffset),
+                                     window->buf + (pieceStart - window->fileOffset),
+                                     pieceEnd - pieceStart);
+            }
+            if (descEnd > windowEnd) {
+                break;
+            }
+            descFileOffset = descEnd;
+            ++descIdx;
+        }
+
+        // NOTE: (sonictk) The other window has been reading ahead all this time; this one goes
+        // after it.
+        if (nextFileOffset < reader->memoryEnd) {
+            const DWORD size = (DWORD)(reader->memoryEnd - nextFileOffset < windowSize ? reader->memoryEnd - nextFileOffset : windowSize);
+            bStat = issueMayaStreamWindow(reader, window, nextFileOffset, size);
+            nextFileOffset += size;
+        }
+    }
+
+    // NOTE: (sonictk) Can't let go of a buffer that is still being read into.
+    for (int i=0; i < 2; ++i) {
+        if (windows[i].pending) {
+            waitMayaStreamWindow(reader, &windows[i]);
+        }
+        if (windows[i].buf != NULL) {
+            VirtualFree(windows[i].buf, 0, MEM_RELEASE);
+        }
+        if (windows[i].hEvent != NULL) {
+            CloseHandle(windows[i].hEvent);
+        }
+    }
+
+    return bStat && nextFileOffset >= reader->memoryEnd;
+}
+
+
+
+
+/**
+ * Looks up the types of the vtables found, a batch at a time. Each batch takes three passes
+ * over the file, one for each pointer that has to be followed to get from a vtable to the name
+ * of its type.
+ *
+ * @param reader        The dump.
+ * @param types         Storage for the count of each vtable, named after its type. Must be freed
+ *                      by the caller.
+ * @param numTypes      Storage for the number of entries in ``types``.
+ * @param numObjects    Storage for the number of vtable pointers that were to types.
+ *
+ * @return              ``true`` if every vtable was looked up, ``false`` if it ran out of budget.
+ */
+static bool resolveMayaStreamTypes(MayaStreamReader *reader, MayaHeapTypeCount **types, uint32_t *numTypes, uint64_t *numObjects)
+{
+    *types = NULL;
+    *numTypes = 0;
+    *numObjects = 0;
+    const MayaHeapVtableTable *table = &reader->vtables;
+    const uint64_t bytesPerVtable = MAYA_STREAM_NUM_FETCHES_PER_VTABLE * (sizeof(MayaStreamFetch) + sizeof(MayaHeapMemoryRange))
+        + 4 * sizeof(uint64_t) + sizeof(uint64_t) + sizeof(MayaRTTICompleteObjectLocator) + MAYA_HEAP_TYPE_NAME_LEN;
+    const uint32_t batchSize = (uint32_t)(reader->budget / 4 / bytesPerVtable);
+    const uint32_t maxTypes = (uint32_t)(reader->budget / 4 / sizeof(MayaHeapTypeCount));
+    MayaStreamFetch *fetches = (MayaStreamFetch *)calloc((size_t)batchSize * MAYA_STREAM_NUM_FETCHES_PER_VTABLE + 1, sizeof(MayaStreamFetch));
+    uint64_t *vtables = (uint64_t *)calloc((size_t)batchSize * 4 + 1, sizeof(uint64_t));
+    if (batchSize == 0 || fetches == NULL || vtables == NULL) {
+        free(fetches);
+        free(vtables);
+        return false;
+    }
+    uint64_t *counts = vtables + batchSize;
+    uint64_t *locators = counts + batchSize;
+    uint64_t *names = locators + batchSize;
+
+    bool bStat = true;
+    uint32_t typesCapacity = 0;
+    uint32_t slot = 0;
+    while (slot < table->capacity && bStat) {
+        uint32_t numInBatch = 0;
+        for (; slot < table->capacity && numInBatch < batchSize; ++slot) {
+            if (table->keys[slot] != 0) {
+                vtables[numInBatch] = table->keys[slot];
+                counts[numInBatch] = table->counts[slot];
+                locators[numInBatch] = 0;
+                names[numInBatch++] = 0;
+            }
+        }
+
+        // NOTE: (sonictk) The pointer to the locator, just before the vtable...
+        MayaHeapDump cache;
+        for (uint32_t i=0; i < numInBatch; ++i) {
+            fetches[i].address = vtables[i] - sizeof(uint64_t);
+            fetches[i].size = sizeof(uint64_t);
+        }
+        if (!fetchMayaStreamMemory(reader, fetches, numInBatch, &cache)) {
+            bStat = false;
+            break;
+        }
+        for (uint32_t i=0; i < numInBatch; ++i) {
+            readMayaHeapUInt64(&cache, vtables[i] - sizeof(uint64_t), &locators[i]);
+        }
+        freeMayaStreamCache(&cache);
+
+        // NOTE: (sonictk) ...then the locator itself, which says where the name is...
+        uint32_t numFetches = 0;
+        for (uint32_t i=0; i < numInBatch; ++i) {
+            if (locators[i] != 0) {
+                fetches[numFetches].address = locators[i];
+                fetches[numFetches++].size = sizeof(MayaRTTICompleteObjectLocator);
+            }
+        }
+        if (!fetchMayaStreamMemory(reader, fetches, numFetches, &cache)) {
+            bStat = false;
+            break;
+        }
+        for (uint32_t i=0; i < numInBatch; ++i) {
+            const MayaRTTICompleteObjectLocator *locator = locators[i] == 0 ? NULL
+                : (const MayaRTTICompleteObjectLocator *)readMayaHeapMemory(&cache, locators[i], sizeof(MayaRTTICompleteObjectLocator));
+            const MayaHeapImageRange *imageRange = findMayaHeapImageRange(&reader->images, vtables[i]);
+            if (locator != NULL && imageRange != NULL && locator->signature == 1) {
+                names[i] = imageRange->imageBase + locator->typeDescriptorRVA + 2 * sizeof(uint64_t);
+            }
+        }
+        freeMayaStreamCache(&cache);
+
+        // NOTE: (sonictk) ...and then all three again at once, so that the name is looked up (and
+        // checked) the same way as when the dump is mapped.
+        numFetches = 0;
+        for (uint32_t i=0; i < numInBatch; ++i) {
+            if (names[i] == 0) {
+                continue;
+            }
+            fetches[numFetches].address = vtables[i] - sizeof(uint64_t);
+            fetches[numFetches++].size = sizeof(uint64_t);
+            fetches[numFetches].address = locators[i];
+            fetches[numFetches++].size = sizeof(MayaRTTICompleteObjectLocator);
+            fetches[numFetches].address = names[i];
+            fetches[numFetches++].size = MAYA_HEAP_TYPE_NAME_LEN;
+        }
+        if (!fetchMayaStreamMemory(reader, fetches, numFetches, &cache)) {
+            bStat = false;
+            break;
+        }
+        cache.imageRanges = reader->images.imageRanges;
+        cache.numImageRanges = reader->images.numImageRanges;
+        for (uint32_t i=0; i < numInBatch; ++i) {
+            if (names[i] == 0) {
+                continue;
+            }
+            if (*numTypes == typesCapacity) {
+                const uint32_t newCapacity = typesCapacity == 0 ? 1024 : typesCapacity * 2;
+                MayaHeapTypeCount *newTypes = newCapacity > maxTypes ? NULL
+                    : (MayaHeapTypeCount *)realloc(*types, newCapacity * sizeof(MayaHeapTypeCount));
+                if (newTypes == NULL) {
+                    bStat = false;
+                    break;
+                }
+                *types = newTypes;
+                typesCapacity = newCapacity;
+            }
+            if (getMayaHeapVtableTypeName(&cache, vtables[i], (*types)[*numTypes].name, MAYA_HEAP_TYPE_NAME_LEN)) {
+                (*types)[(*numTypes)++].count = counts[i];
+                *numObjects += counts[i];
+            }
+        }
+        freeMayaStreamCache(&cache);
+    }
+    free(fetches);
+    free(vtables);
+
+    return bStat;
+}
+
+
+/**
+ * Prints the custom streams and what the memory of the process was being used for from a
+ * full-memory dump, reading the dump from start to end without ever holding more than the given
+ * amount of it in memory. Meant for dumps that are too large to map (e.g. of a process that had
+ * run away with 100 GB of memory), and for when the dump is on a disk or share that only reads
+ * quickly from start to end.
+ *
+ * @param dumpFilePath      The dump to read.
+ * @param budgetMB          The most memory to use, in MB; ``0`` for the default.
+ * @param numToPrint        The number of types to print.
+ *
+ * @return                  ``0`` on success, ``1`` otherwise.
+ */
+int streamMayaDump(const char *dumpFilePath, uint32_t budgetMB, uint32_t numToPrint)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&startTime);
+
+    budgetMB = budgetMB == 0 ? MAYA_STREAM_DEFAULT_BUDGET_MB : budgetMB;
+    budgetMB = budgetMB < MAYA_STREAM_MIN_BUDGET_MB ? MAYA_STREAM_MIN_BUDGET_MB : budgetMB;
+    static MayaStreamReader reader;
+    int result = 1;
+    MayaHeapTypeCount *types = NULL;
+    if (!openMayaStreamDump(dumpFilePath, (uint64_t)budgetMB * 1024 * 1024, &reader)) {
+        goto cleanup;
+    }
+
+    // NOTE: (sonictk) Everything but the memory itself is in what was read in, so the streams are
+    // printed the same way as from a mapped dump.
+    printMayaDumpUserStreams((PVOID)reader.dump.view);
+    if (reader.numHiddenStreams > 0) {
+        printf("WARNING: %u streams lie after the memory of the process and were not read.\n", reader.numHiddenStreams);
+    }
+
+    if (!findMayaStreamRegions(&reader) || !indexMayaStreamImageRanges(&reader)) {
+        goto cleanup;
+    }
+
+    // NOTE: (sonictk) The table of vtables is the only thing that grows with the size of the
+    // dump, so it gets a quarter of the budget; once it's full, only the vtables already in it
+    // are counted.
+    reader.maxVtableCapacity = MAYA_HEAP_VTABLE_TABLE_INITIAL_CAPACITY;
+    while ((uint64_t)reader.maxVtableCapacity * 2 * 2 * sizeof(uint64_t) <= reader.budget / 4) {
+        reader.maxVtableCapacity *= 2;
+    }
+    if (!streamMayaDumpMemory(&reader)) {
+        printf("ERROR: Could not read the memory of the process from the dump.\n");
+        goto cleanup;
+    }
+    if (reader.numVtablePointersDropped > 0) {
+        printf("WARNING: %llu possible vtable pointers did not fit in the budget; the type counts are incomplete.\n",
+               reader.numVtablePointersDropped);
+    }
+
+    uint32_t numTypes = 0;
+    uint64_t numObjects = 0;
+    if (!resolveMayaStreamTypes(&reader, &types, &numTypes, &numObjects)) {
+        printf("WARNING: Ran out of budget looking up the types of the vtables; the type counts are incomplete.\n");
+    }
+    const uint32_t numUniqueTypes = mergeMayaHeapTypeCounts(types, numTypes);
+
+    const double bytesToMB = 1.0 / (1024.0 * 1024.0);
+    printf("Private committed: %.1f MB in %u allocations.\n", reader.privateBytes * bytesToMB, reader.numPrivateAllocations);
+    printf("Most common C++ types, from %llu vtable pointers in %.1f MB scanned:\n", numObjects, reader.numBytesScanned * bytesToMB);
+    for (uint32_t i=0; i < numUniqueTypes && i < numToPrint; ++i) {
+        printf("    %10llu %s\n", types[i].count, types[i].name);
+    }
+
+    QueryPerformanceCounter(&endTime);
+    const double elapsedSecs = (double)(endTime.QuadPart - startTime.QuadPart) / (double)freq.QuadPart;
+    PROCESS_MEMORY_COUNTERS memCounters;
+    memset(&memCounters, 0, sizeof(memCounters));
+    GetProcessMemoryInfo(GetCurrentProcess(), &memCounters, sizeof(memCounters));
+    printf("Streamed %.1f MB of a %.1f MB dump in %llu reads in %.3f s (%.1f MB/s), peak working set %.1f MB of a %u MB budget.\n",
+           reader.numBytesRead * bytesToMB, reader.fileSize * bytesToMB, reader.numReads, elapsedSecs,
+           elapsedSecs > 0.0 ? reader.numBytesRead * bytesToMB / elapsedSecs : 0.0,
+           memCounters.PeakWorkingSetSize * bytesToMB, budgetMB);
+    result = 0;
+
+cleanup:
+    free(types);
+    closeMayaStreamDump(&reader);
+
+    return result;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file   maya_read_custom_dump_symbols.c
+ * @brief  Looks up the symbols of module+offset addresses with ``maya_symbol_server.exe``, if it is
+ *         running. Lookups are queued up and sent to the server in batches.
+ */
+typedef struct MayaSymbolClient
+{
+    HANDLE hPipe;
+    MayaSymbolServerRequest request;
+    MayaSymbolServerResponse response;
+
+    // NOTE: (sonictk) Where to write the result of each queued lookup.
+    char *names[MAYA_SYMBOL_SERVER_MAX_LOOKUPS];
+    size_t lenNames[MAYA_SYMBOL_SERVER_MAX_LOOKUPS];
+} MayaSymbolClient;
+
+
+/// Returns ``false`` (quietly) if the symbol server isn't running.
+static bool connectMayaSymbolServer(MayaSymbolClient *client)
+{
+    client->hPipe = CreateFile(MAYA_SYMBOL_SERVER_PIPE_NAME, GENERIC_READ|GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (client->hPipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipe(MAYA_SYMBOL_SERVER_PIPE_NAME, 1000) == TRUE) {
+        client->hPipe = CreateFile(MAYA_SYMBOL_SERVER_PIPE_NAME, GENERIC_READ|GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    }
+    if (client->hPipe == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD mode = PIPE_READMODE_MESSAGE;
+    if (SetNamedPipeHandleState(client->hPipe, &mode, NULL, NULL) == FALSE) {
+        CloseHandle(client->hPipe);
+        client->hPipe = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    client->request.magic = MAYA_SYMBOL_SERVER_MAGIC;
+    client->request.version = MAYA_SYMBOL_SERVER_VERSION;
+    client->request.numModules = 0;
+    client->request.numLookups = 0;
+
+    return true;
+}
+
+
+/// Sends the queued lookups to the server and writes out their results. Lookups that could not be
+/// answered leave their names untouched.
+static bool flushMayaSymbolLookups(MayaSymbolClient *client)
+{
+    MayaSymbolServerRequest *request = &client->request;
+    if (request->numLookups == 0) {
+        return true;
+    }
+    const DWORD lenRequest = (DWORD)(offsetof(MayaSymbolServerRequest, lookups) + request->numLookups * sizeof(MayaCrashSidecarFrame));
+    DWORD lenResponse = 0;
+    bool sent = TransactNamedPipe(client->hPipe, request, lenRequest, &client->response, sizeof(client->response), &lenResponse, NULL) == TRUE
+        && lenResponse >= offsetof(MayaSymbolServerResponse, results)
+        && client->response.magic == MAYA_SYMBOL_SERVER_MAGIC
+        && client->response.numResults == request->numLookups
+        && lenResponse >= offsetof(MayaSymbolServerResponse, results) + client->response.numResults * sizeof(MayaSymbolServerResult);
+    for (uint32_t i=0; i < request->numLookups && sent; ++i) {
+        const MayaSymbolServerResult *result = &client->response.results[i];
+        if (result->status == MayaSymbolServerStatus_Found) {
+            snprintf(client->names[i], client->lenNames[i], "%.*s+0x%x",
+                     MAYA_SYMBOL_SERVER_SYMBOL_NAME_LEN, result->name, result->displacement);
+        }
+    }
+    request->numModules = 0;
+    request->numLookups = 0;
+
+    return sent;
+}
+
+
+/// Queues up the lookup of an address, sending off the batch if it is full. The symbol (as
+/// ``name+0xdisplacement``) is written to ``name`` once the batch has been sent.
+static bool queueMayaSymbolLookup(MayaSymbolClient *client, const MayaCrashSidecarModule *module, uint32_t offset, char *name, size_t lenName)
+{
+    MayaSymbolServerRequest *request = &client->request;
+    uint32_t moduleIdx = 0;
+    for (; moduleIdx < request->numModules; ++moduleIdx) {
+        if (request->modules[moduleIdx].pdbAge == module->pdbAge
+            && memcmp(request->modules[moduleIdx].pdbGuid, module->pdbGuid, sizeof(module->pdbGuid)) == 0) {
+            break;
+        }
+    }
+    if ((moduleIdx == request->numModules && request->numModules == MAYA_SYMBOL_SERVER_MAX_MODULES)
+        || request->numLookups == MAYA_SYMBOL_SERVER_MAX_LOOKUPS) {
+        if (!flushMayaSymbolLookups(client)) {
+            return false;
+        }
+        moduleIdx = 0;
+    }
+    if (moduleIdx == request->numModules) {
+        request->modules[request->numModules++] = *module;
+    }
+    MayaCrashSidecarFrame *lookup = &request->lookups[request->numLookups];
+    lookup->offset = offset;
+    lookup->moduleIdx = (uint16_t)moduleIdx;
+    lookup->reserved = 0;
+    client->names[request->numLookups] = name;
+    client->lenNames[request->numLookups] = lenName;
+    ++request->numLookups;
+
+    return true;
+}
+
+
+static void disconnectMayaSymbolServer(MayaSymbolClient *client)
+{
+    if (client->hPipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(client->hPipe);
+        client->hPipe = INVALID_HANDLE_VALUE;
+    }
+
+    return;
+}
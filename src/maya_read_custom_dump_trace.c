@@ -0,0 +1,335 @@
+/**
+ * @file   maya_read_custom_dump_trace.c
+ * @brief  Exports the breadcrumb timeline of a dump in the Chrome trace event format, so that the
+ *         events leading up to a crash can be looked at in a trace viewer (``chrome://tracing``,
+ *         Perfetto UI). Each thread becomes a track, MEL procedures and commands become slices
+ *         and the other breadcrumbs become instant events. The output is written as the events
+ *         are read, so that dumps with millions of events don't need to fit in memory twice.
+ */
+#define MAYA_TRACE_MAX_THREADS 256
+#define MAYA_TRACE_OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define MAYA_TRACE_FILE_EXTENSION ".trace.json"
+
+/// NOTE: (sonictk) ``MCommandMessage::kMELCommand``; anything else is a MEL procedure.
+#define MAYA_TRACE_MEL_COMMAND_PROC_TYPE 1
+
+/// A track in the trace, along with the number of MEL slices currently open on it.
+typedef struct MayaTraceThread
+{
+    uint32_t threadId;
+    uint32_t depth;
+} MayaTraceThread;
+
+typedef struct MayaTraceWriter
+{
+    FILE *file;
+    uint32_t processId;
+    uint32_t mainThreadId;
+    uint64_t numEventsWritten;
+    MayaTraceThread threads[MAYA_TRACE_MAX_THREADS];
+    uint32_t numThreads;
+} MayaTraceWriter;
+
+
+/// Writes a string as a JSON string literal, escaping it as needed.
+static void writeMayaTraceString(FILE *file, const char *str, size_t maxLen)
+{
+    fputc('"', file);
+    for (size_t i=0; i < maxLen && str[i] != '\0'; ++i) {
+        unsigned char c = (unsigned char)str[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+
+/// Starts a new event in the trace, taking care of the separator between events.
+static void beginMayaTraceEvent(MayaTraceWriter *writer)
+{
+    fputs(writer->numEventsWritten == 0 ? "\n" : ",\n", writer->file);
+    ++writer->numEventsWritten;
+}
+
+
+/// Finds the track for the given thread, adding it (and naming it in the trace) if this is the
+/// first event seen on it.
+static MayaTraceThread *getMayaTraceThread(MayaTraceWriter *writer, uint32_t threadId)
+{
+    for (uint32_t i=0; i < writer->numThreads; ++i) {
+        if (writer->threads[i].threadId == threadId) {
+            return &writer->threads[i];
+        }
+    }
+    if (writer->numThreads == MAYA_TRACE_MAX_THREADS) {
+        return NULL;
+    }
+
+    MayaTraceThread *thread = &writer->threads[writer->numThreads++];
+    thread->threadId = threadId;
+    thread->depth = 0;
+
+    beginMayaTraceEvent(writer);
+    if (threadId == writer->mainThreadId) {
+        fprintf(writer->file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"Main thread\"}}",
+                writer->processId, threadId);
+    } else {
+        fprintf(writer->file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+                writer->processId, threadId, threadId);
+    }
+
+    return thread;
+}
+
+
+/// Retrieves the given stream from the dump, or ``NULL`` if it isn't there.
+static const void *readMayaTraceDumpStream(PVOID pFileView, ULONG streamType, ULONG *streamSize)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pStream = NULL;
+    if (MiniDumpReadDumpStream(pFileView, streamType, &miniDumpDirPath, &pStream, streamSize) != TRUE) {
+        return NULL;
+    }
+
+    return pStream;
+}
+
+
+/// Looks up a name by ID in the name table of the dump, if it has one and the name hasn't been evicted.
+static const MayaNameTableEntry *findMayaTraceName(const MayaNameTable *nameTable, uint32_t id)
+{
+    if (nameTable == NULL || id == MAYA_NAME_TABLE_INVALID_ID) {
+        return NULL;
+    }
+    const MayaNameTableEntry *entry = &nameTable->entries[id & (MAYA_NAME_TABLE_CAPACITY - 1)];
+
+    return entry->id == id && entry->len < MAYA_NAME_TABLE_NAME_LEN ? entry : NULL;
+}
+
+
+/**
+ * Writes the breadcrumb events stored in the given dump out as a Chrome trace.
+ *
+ * @param pFileView         A view of the entire dump file.
+ * @param file              The file to write the trace to.
+ *
+ * @return                  The number of breadcrumb events written, or ``-1`` if the dump has no
+ *                          breadcrumb events stream.
+ */
+int64_t writeMayaBreadcrumbTrace(PVOID pFileView, FILE *file)
+{
+    ULONG streamSize = 0;
+    const MayaBreadcrumbEventRing *ring = (const MayaBreadcrumbEventRing *)readMayaTraceDumpStream(pFileView, MAYA_BREADCRUMB_EVENTS_STREAM_TYPE, &streamSize);
+    if (ring == NULL
+        || !isMayaDumpUserStreamSizeValid(MayaDumpUserStream_BreadcrumbEvents, streamSize)
+        || ring->magic != MAYA_BREADCRUMB_EVENTS_MAGIC
+        || ring->version != MAYA_BREADCRUMB_EVENTS_VERSION
+        || ring->capacity == 0
+        || (ring->capacity & (ring->capacity - 1)) != 0
+        || streamSize < sizeof(MayaBreadcrumbEventRing) + (uint64_t)ring->capacity * sizeof(MayaBreadcrumbEvent)) {
+        return -1;
+    }
+    const MayaBreadcrumbEvent *events = (const MayaBreadcrumbEvent *)(ring + 1);
+
+    // NOTE: (sonictk) The writer's thread table is a few KB; keep it off the stack all the same.
+    static MayaTraceWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.file = file;
+    writer.processId = ring->processId;
+
+    const MayaProfilerData *profilerData = (const MayaProfilerData *)readMayaTraceDumpStream(pFileView, MAYA_PROFILER_STACKS_STREAM_TYPE, &streamSize);
+    if (profilerData != NULL && isMayaDumpUserStreamSizeValid(MayaDumpUserStream_ProfilerStacks, streamSize)) {
+        writer.mainThreadId = profilerData->mainThreadId;
+    }
+
+    // NOTE: (sonictk) The events only hold the start of the DAG paths and node names; the full names
+    // are in the name table.
+    const MayaNameTable *nameTable = (const MayaNameTable *)readMayaTraceDumpStream(pFileView, MAYA_NAME_TABLE_STREAM_TYPE, &streamSize);
+    if (nameTable != NULL && (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_NameTable, streamSize) || nameTable->magic != MAYA_NAME_TABLE_MAGIC || nameTable->version != MAYA_NAME_TABLE_VERSION)) {
+        nameTable = NULL;
+    }
+
+    const double ticksToMicroseconds = ring->timerFrequency == 0 ? 0.0 : 1000000.0 / (double)ring->timerFrequency;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    beginMayaTraceEvent(&writer);
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"Maya (%u)\"}}", writer.processId, writer.processId);
+
+    const uint64_t numEventsWritten = ring->numEventsWritten;
+    const uint64_t firstEvent = numEventsWritten > ring->capacity ? numEventsWritten - ring->capacity : 0;
+    uint64_t lastTimestamp = ring->startTimestamp;
+    int64_t numEventsExported = 0;
+    for (uint64_t i=firstEvent; i < numEventsWritten; ++i) {
+        const MayaBreadcrumbEvent *event = &events[i & (ring->capacity - 1)];
+        // NOTE: (sonictk) Skip events that were in the middle of being written when the dump was taken.
+        if (event->timestamp == 0 || event->timestamp < ring->startTimestamp) {
+            continue;
+        }
+        MayaTraceThread *thread = getMayaTraceThread(&writer, event->threadId);
+        if (thread == NULL) {
+            continue;
+        }
+        lastTimestamp = event->timestamp > lastTimestamp ? event->timestamp : lastTimestamp;
+        const double ts = (double)(event->timestamp - ring->startTimestamp) * ticksToMicroseconds;
+
+        switch (event->type) {
+        case MayaBreadcrumbEventType_MELProcEntry:
+        case MayaBreadcrumbEventType_MELProcExit:
+        {
+            const bool isEntry = event->type == MayaBreadcrumbEventType_MELProcEntry;
+            // NOTE: (sonictk) The entry of this slice was overwritten in the ring; drop its exit
+            // too, so that it doesn't close one of the slices that are still open.
+            if (!isEntry && thread->depth == 0) {
+                continue;
+            }
+            if (isEntry) {
+                ++thread->depth;
+            } else {
+                --thread->depth;
+            }
+            beginMayaTraceEvent(&writer);
+            fputs("{\"name\":", file);
+            writeMayaTraceString(file, event->name, MAYA_BREADCRUMB_EVENT_NAME_LEN);
+            fprintf(file, ",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"procId\":%u}}",
+                    event->arg == MAYA_TRACE_MEL_COMMAND_PROC_TYPE ? "mel_command" : "mel_proc",
+                    isEntry ? "B" : "E",
+                    ts,
+                    writer.processId,
+                    event->threadId,
+                    event->id);
+            break;
+        }
+        case MayaBreadcrumbEventType_TimeChange:
+        case MayaBreadcrumbEventType_DagChange:
+        case MayaBreadcrumbEventType_NodeAdded:
+        case MayaBreadcrumbEventType_SceneOpened:
+        {
+            const char *category = "scene";
+            switch (event->type) {
+            case MayaBreadcrumbEventType_TimeChange:
+                category = "time";
+                break;
+            case MayaBreadcrumbEventType_DagChange:
+                category = "dag";
+                break;
+            case MayaBreadcrumbEventType_NodeAdded:
+                category = "dg";
+                break;
+            default:
+                break;
+            }
+            const MayaNameTableEntry *fullName = NULL;
+            if (event->type == MayaBreadcrumbEventType_DagChange || event->type == MayaBreadcrumbEventType_NodeAdded) {
+                fullName = findMayaTraceName(nameTable, event->id);
+            }
+            beginMayaTraceEvent(&writer);
+            fputs("{\"name\":", file);
+            if (fullName != NULL) {
+                writeMayaTraceString(file, fullName->name, fullName->len);
+            } else {
+                writeMayaTraceString(file, event->name, MAYA_BREADCRUMB_EVENT_NAME_LEN);
+            }
+            fprintf(file, ",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"message\":%u}}",
+                    category, ts, writer.processId, event->threadId, event->arg);
+            break;
+        }
+        default:
+            continue;
+        }
+        ++numEventsExported;
+    }
+
+    const double lastTs = (double)(lastTimestamp - ring->startTimestamp) * ticksToMicroseconds;
+
+    // NOTE: (sonictk) Close off whatever was still running when the dump was taken, so that it
+    // shows up as running right up until the end.
+    for (uint32_t i=0; i < writer.numThreads; ++i) {
+        for (uint32_t j=0; j < writer.threads[i].depth; ++j) {
+            beginMayaTraceEvent(&writer);
+            fprintf(file, "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"unfinished\":true}}",
+                    lastTs, writer.processId, writer.threads[i].threadId);
+        }
+    }
+
+    // NOTE: (sonictk) And mark the crash itself on the thread that crashed.
+    const MINIDUMP_EXCEPTION_STREAM *exceptionStream = (const MINIDUMP_EXCEPTION_STREAM *)readMayaTraceDumpStream(pFileView, ExceptionStream, &streamSize);
+    if (exceptionStream != NULL && streamSize >= sizeof(MINIDUMP_EXCEPTION_STREAM)) {
+        getMayaTraceThread(&writer, exceptionStream->ThreadId);
+        beginMayaTraceEvent(&writer);
+        fprintf(file, "{\"name\":\"Crash (0x%08x)\",\"cat\":\"crash\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u}",
+                exceptionStream->ExceptionRecord.ExceptionCode, lastTs, writer.processId, exceptionStream->ThreadId);
+    }
+
+    fputs("\n]}\n", file);
+
+    return numEventsExported;
+}
+
+
+/**
+ * Exports the breadcrumb timeline of the given dump as a Chrome trace.
+ *
+ * @param dumpFilePath      The dump to read.
+ * @param outputFilePath    The file to write the trace to. If ``NULL``, it is written next to the
+ *                          dump, as ``<dump file path>.trace.json``.
+ *
+ * @return                  ``0`` if the trace was written successfully, ``1`` otherwise.
+ */
+int exportMayaBreadcrumbTrace(const char *dumpFilePath, const char *outputFilePath)
+{
+    char defaultOutputFilePath[MAX_PATH] = {0};
+    if (outputFilePath == NULL) {
+        snprintf(defaultOutputFilePath, MAX_PATH, "%s%s", dumpFilePath, MAYA_TRACE_FILE_EXTENSION);
+        outputFilePath = defaultOutputFilePath;
+    }
+
+    HANDLE hFile = CreateFile(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        printf("ERROR: Could not open the dump file requested.\n");
+        return 1;
+    }
+    HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapFile == NULL) {
+        printf("ERROR: Could not create the file mapping for the dump.\n");
+        CloseHandle(hFile);
+        return 1;
+    }
+    PVOID pFileView = MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+    if (pFileView == NULL) {
+        printf("ERROR: Failed to map view of the dump file.\n");
+        CloseHandle(hMapFile);
+        CloseHandle(hFile);
+        return 1;
+    }
+
+    int result = 1;
+    FILE *file = fopen(outputFilePath, "wb");
+    if (file == NULL) {
+        printf("ERROR: Could not open %s for writing.\n", outputFilePath);
+    } else {
+        setvbuf(file, NULL, _IOFBF, MAYA_TRACE_OUTPUT_BUFFER_SIZE);
+        int64_t numEvents = writeMayaBreadcrumbTrace(pFileView, file);
+        bool written = fclose(file) == 0;
+        if (numEvents < 0) {
+            printf("No breadcrumb events were recorded in the dump file.\n");
+            DeleteFile(outputFilePath);
+        } else if (!written) {
+            printf("ERROR: Failed to write out %s.\n", outputFilePath);
+        } else {
+            printf("Wrote %lld breadcrumb events to %s\n", numEvents, outputFilePath);
+            result = 0;
+        }
+    }
+
+    UnmapViewOfFile(pFileView);
+    CloseHandle(hMapFile);
+    CloseHandle(hFile);
+
+    return result;
+}
@@ -12,36 +12,39 @@
 #endif
 #include <Windows.h>
 #include <Dbghelp.h>
+#include <Psapi.h>
 
 #include "common.h"
 
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#define MAYA_PROFILER_NUM_TOP_STACKS_TO_PRINT 10
 
-void parseAndPrintCustomStreamFromMiniDump(const char *dumpFilePath)
-{
-    if (dumpFilePath == NULL) {
-        return;
-    }
+#define MAYA_READER_SIDECARS_FLAG "-sidecars"
+#define MAYA_READER_TRACE_FLAG "-trace"
+#define MAYA_READER_DIFF_FLAG "-diff"
+#define MAYA_READER_HEAP_FLAG "-heap"
+#define MAYA_READER_WATCH_FLAG "-watch"
+#define MAYA_READER_SCAN_FLAG "-scan"
+#define MAYA_READER_STREAM_FLAG "-stream"
 
-    HANDLE hFile = CreateFile(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE) {
-        printf("ERROR: Could not open the dump file requested.\n");
-        return;
-    }
+#include "maya_read_custom_dump_symbols.c"
+#include "maya_read_custom_dump_sidecars.c"
+#include "maya_read_custom_dump_trace.c"
+#include "maya_read_custom_dump_diff.c"
+#include "maya_read_custom_dump_heap.c"
+#include "maya_read_custom_dump_daemon.c"
+#include "maya_read_custom_dump_io.c"
+#include "maya_read_custom_dump_scan.c"
+#include "maya_read_custom_dump_stream.c"
 
-    HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
-    if (hMapFile == NULL) {
-        printf("ERROR: Could not create the file mapping for the dump.\n");
-        return;
-    }
-
-    PVOID pFileView = MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
-    if (pFileView == NULL) {
-        printf("ERROR: Failed to map view of the dump file.\n");
-        return;
-    }
 
+void printCrashInfoStream(PVOID pFileView)
+{
     PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
     PVOID pUserStream = NULL;
     ULONG streamSize = 0;
@@ -55,7 +58,7 @@ void parseAndPrintCustomStreamFromMiniDump(const char *dumpFilePath)
         return;
     }
 
-    if (streamSize != sizeof(MayaCrashDumpInfo)) {
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_CrashInfo, streamSize)) {
         printf("ERROR: Stream size mismatch. Check if the dump file was written correctly.\n");
         return;
     }
@@ -83,18 +86,607 @@ void parseAndPrintCustomStreamFromMiniDump(const char *dumpFilePath)
 }
 
 
+void printMemorySamplesStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_MEMORY_SAMPLES_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No memory samples were recorded in the dump file.\n");
+        return;
+    }
+
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_MemorySamples, streamSize)) {
+        printf("ERROR: Memory samples stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    const MayaMemorySampleRing *ring = (const MayaMemorySampleRing *)pUserStream;
+    uint32_t numWritten = ring->numSamplesWritten;
+    uint32_t numAvailable = numWritten > MAYA_MEMORY_SAMPLE_RING_CAPACITY ? MAYA_MEMORY_SAMPLE_RING_CAPACITY : numWritten;
+    printf("Memory samples (%u recorded, every %u ms, newest last):\n", numAvailable, ring->intervalMs);
+    if (numAvailable == 0) {
+        return;
+    }
+
+    const double bytesToMB = 1.0 / (1024.0 * 1024.0);
+    const MayaMemorySample *newest = &ring->samples[(numWritten - 1) % MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+    for (uint32_t i=numWritten - numAvailable; i < numWritten; ++i) {
+        const MayaMemorySample *sample = &ring->samples[i % MAYA_MEMORY_SAMPLE_RING_CAPACITY];
+        double ageSecs = ring->timerFrequency == 0 ? 0.0 : (double)(newest->timestamp - sample->timestamp) / (double)ring->timerFrequency;
+        printf("[-%8.1fs] WS: %9.1f MB Commit: %9.1f MB Heap: %9.1f/%9.1f MB Mapped: %9.1f MB "
+               "Sys avail: %9.1f MB Sys commit: %9.1f/%9.1f MB Faults: %u\n",
+               ageSecs,
+               sample->workingSetBytes * bytesToMB,
+               sample->privateCommitBytes * bytesToMB,
+               sample->heapAllocatedBytes * bytesToMB,
+               sample->heapCommittedBytes * bytesToMB,
+               sample->mappedBytes * bytesToMB,
+               sample->systemAvailPhysBytes * bytesToMB,
+               sample->systemCommitTotalBytes * bytesToMB,
+               sample->systemCommitLimitBytes * bytesToMB,
+               sample->pageFaultCount);
+    }
+    printf("End of memory samples.\n");
+
+    return;
+}
+
+
+void printSnapshotInfoStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_SNAPSHOT_INFO_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        // NOTE: (sonictk) Not a snapshot of a live process; nothing to report.
+        return;
+    }
+
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_SnapshotInfo, streamSize)) {
+        printf("ERROR: Snapshot info stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    const MayaSnapshotInfo *snapshotInfo = (const MayaSnapshotInfo *)pUserStream;
+    const char *reason = "unknown";
+    switch (snapshotInfo->reason) {
+    case MayaSnapshotReason_MainThreadHang:
+        reason = "main thread hang";
+        break;
+    case MayaSnapshotReason_UserRequested:
+        reason = "user requested";
+        break;
+    default:
+        break;
+    }
+    printf("This is a snapshot of a live process, not a crash.\n"
+           "Snapshot reason: %s\n"
+           "Main thread ID: %u\n"
+           "Main thread stalled for: %llu ms\n"
+           "Main thread heartbeat: %llu\n"
+           "Process paused for: %llu us\n",
+           reason,
+           snapshotInfo->mainThreadId,
+           snapshotInfo->stallMs,
+           snapshotInfo->heartbeat,
+           snapshotInfo->pauseMicroseconds);
+
+    return;
+}
+
+
+/// Formats the given address as ``module+offset`` using the module list stored in the dump.
+void formatDumpAddress(PVOID pFileView, uint64_t addr, char *buf, size_t lenBuf)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pStream = NULL;
+    ULONG streamSize = 0;
+    if (MiniDumpReadDumpStream(pFileView, ModuleListStream, &miniDumpDirPath, &pStream, &streamSize) == TRUE) {
+        const MINIDUMP_MODULE_LIST *moduleList = (const MINIDUMP_MODULE_LIST *)pStream;
+        for (ULONG32 i=0; i < moduleList->NumberOfModules; ++i) {
+            const MINIDUMP_MODULE *module = &moduleList->Modules[i];
+            if (addr < module->BaseOfImage || addr >= module->BaseOfImage + module->SizeOfImage) {
+                continue;
+            }
+            const MINIDUMP_STRING *moduleName = (const MINIDUMP_STRING *)((const char *)pFileView + module->ModuleNameRva);
+            const WCHAR *baseName = wcsrchr(moduleName->Buffer, L'\\');
+            baseName = baseName == NULL ? moduleName->Buffer : baseName + 1;
+            snprintf(buf, lenBuf, "%ls+0x%llx", baseName, addr - module->BaseOfImage);
+            return;
+        }
+    }
+
+    snprintf(buf, lenBuf, "0x%llx", addr);
+}
+
+
+static int compareProfilerStackCounts(const void *a, const void *b)
+{
+    const MayaProfilerStack *stackA = *(const MayaProfilerStack **)a;
+    const MayaProfilerStack *stackB = *(const MayaProfilerStack **)b;
+    if (stackA->count == stackB->count) {
+        return 0;
+    }
+
+    return stackA->count > stackB->count ? -1 : 1;
+}
+
+
+void printProfilerStacksStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_PROFILER_STACKS_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No profiler samples were recorded in the dump file.\n");
+        return;
+    }
+
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_ProfilerStacks, streamSize)) {
+        printf("ERROR: Profiler stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    const MayaProfilerData *data = (const MayaProfilerData *)pUserStream;
+    uint32_t numStacks = data->numUniqueStacks > MAYA_PROFILER_MAX_UNIQUE_STACKS ? MAYA_PROFILER_MAX_UNIQUE_STACKS : data->numUniqueStacks;
+    uint64_t totalCount = 0;
+    const MayaProfilerStack *sortedStacks[MAYA_PROFILER_MAX_UNIQUE_STACKS];
+    for (uint32_t i=0; i < numStacks; ++i) {
+        sortedStacks[i] = &data->stacks[i];
+        totalCount += data->stacks[i].count;
+    }
+    qsort((void *)sortedStacks, numStacks, sizeof(sortedStacks[0]), compareProfilerStackCounts);
+
+    printf("Main thread (ID %u) profile: %llu samples in %u unique stacks (%u dropped) at %u Hz. Top stacks:\n",
+           data->mainThreadId, totalCount, numStacks, data->numDroppedSamples, data->sampleRateHz);
+
+    char frameBuf[MAX_PATH + 32] = {0};
+    for (uint32_t i=0; i < numStacks && i < MAYA_PROFILER_NUM_TOP_STACKS_TO_PRINT; ++i) {
+        const MayaProfilerStack *stack = sortedStacks[i];
+        printf("#%u: %u samples (%.1f%%)\n", i, stack->count, totalCount == 0 ? 0.0 : 100.0 * stack->count / (double)totalCount);
+        uint32_t numFrames = stack->numFrames > MAYA_PROFILER_MAX_FRAMES ? MAYA_PROFILER_MAX_FRAMES : stack->numFrames;
+        for (uint32_t j=0; j < numFrames; ++j) {
+            formatDumpAddress(pFileView, stack->frames[j], frameBuf, sizeof(frameBuf));
+            printf("    %s\n", frameBuf);
+        }
+    }
+    printf("End of profiler stacks.\n");
+
+    return;
+}
+
+
+void printBreadcrumbEventsStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_BREADCRUMB_EVENTS_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No breadcrumb events were recorded in the dump file.\n");
+        return;
+    }
+
+    const MayaBreadcrumbEventRing *ring = (const MayaBreadcrumbEventRing *)pUserStream;
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_BreadcrumbEvents, streamSize)
+        || ring->magic != MAYA_BREADCRUMB_EVENTS_MAGIC
+        || ring->version != MAYA_BREADCRUMB_EVENTS_VERSION
+        || streamSize < sizeof(MayaBreadcrumbEventRing) + (uint64_t)ring->capacity * sizeof(MayaBreadcrumbEvent)) {
+        printf("ERROR: Breadcrumb events stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    // NOTE: (sonictk) The timeline itself is best looked at in a trace viewer; see ``-trace``.
+    const uint64_t numAvailable = ring->numEventsWritten > ring->capacity ? ring->capacity : ring->numEventsWritten;
+    printf("Breadcrumb events: %llu recorded, the last %llu of which are in the dump. Use %s to export them as a trace.\n",
+           ring->numEventsWritten, numAvailable, MAYA_READER_TRACE_FLAG);
+
+    return;
+}
+
+
+void printFlightRecorderStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_FLIGHT_RECORDER_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No compute events were recorded in the dump file.\n");
+        return;
+    }
+
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_FlightRecorder, streamSize)) {
+        printf("ERROR: Flight recorder stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    const MayaFlightRecorderData *data = (const MayaFlightRecorderData *)pUserStream;
+    printf("Flight recorder: %u threads recorded compute events (%u dropped).\n", data->numRings, data->numDroppedThreads);
+    for (uint32_t i=0; i < MAYA_FLIGHT_RECORDER_MAX_THREADS; ++i) {
+        const MayaFlightRecorderRing *ring = &data->rings[i];
+        if (ring->threadId == 0 || ring->numEventsWritten == 0) {
+            continue;
+        }
+        const uint64_t numWritten = ring->numEventsWritten;
+        const uint64_t numAvailable = numWritten > MAYA_FLIGHT_RECORDER_RING_CAPACITY ? MAYA_FLIGHT_RECORDER_RING_CAPACITY : numWritten;
+        const MayaFlightRecorderEvent *newest = &ring->events[(numWritten - 1) % MAYA_FLIGHT_RECORDER_RING_CAPACITY];
+
+        // NOTE: (sonictk) Work out which events were still open (i.e. begun but not ended) when
+        // the dump was taken; that's what the thread was in the middle of.
+        const MayaFlightRecorderEvent *openEvents[MAYA_FLIGHT_RECORDER_RING_CAPACITY];
+        uint32_t numOpenEvents = 0;
+        for (uint64_t j=numWritten - numAvailable; j < numWritten; ++j) {
+            const MayaFlightRecorderEvent *event = &ring->events[j % MAYA_FLIGHT_RECORDER_RING_CAPACITY];
+            if (event->phase == MayaFlightRecorderPhase_Begin) {
+                openEvents[numOpenEvents++] = event;
+            } else if (numOpenEvents > 0 && openEvents[numOpenEvents - 1]->nameId == event->nameId) {
+                --numOpenEvents;
+            }
+        }
+
+        printf("Thread %u (%llu events):\n", ring->threadId, numWritten);
+        if (numOpenEvents == 0) {
+            printf("    Not in the middle of any compute.\n");
+        }
+        for (uint32_t j=0; j < numOpenEvents; ++j) {
+            const MayaFlightRecorderEvent *event = openEvents[j];
+            double ageMs = data->timerFrequency == 0 ? 0.0 : (double)(newest->timestamp - event->timestamp) * 1000.0 / (double)data->timerFrequency;
+            printf("    %*sIn: %.*s (ID 0x%08x, category %u) for at least %.3f ms\n",
+                   (int)j * 2, "", MAYA_FLIGHT_RECORDER_EVENT_NAME_LEN, event->name, event->nameId, event->category, ageMs);
+        }
+    }
+    printf("End of flight recorder.\n");
+
+    return;
+}
+
+
+void printPluginLoadTimesStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_PLUGIN_LOAD_TIMES_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No plugin load times were recorded in the dump file.\n");
+        return;
+    }
+
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_PluginLoadTimes, streamSize)) {
+        printf("ERROR: Plugin load times stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    static const char *kindNames[] = {"load", "unload", "init"};
+
+    const MayaPluginLoadTimes *data = (const MayaPluginLoadTimes *)pUserStream;
+    const uint32_t numEntries = data->numEntries > MAYA_PLUGIN_LOAD_TIMES_MAX_ENTRIES ? MAYA_PLUGIN_LOAD_TIMES_MAX_ENTRIES : data->numEntries;
+    const double ticksToMs = data->timerFrequency == 0 ? 0.0 : 1000.0 / (double)data->timerFrequency;
+    printf("Plugin load times (%u entries, %u dropped), in the order they were started:\n", numEntries, data->numDroppedEntries);
+
+    // NOTE: (sonictk) Printed in order rather than sorted, since what matters in a crash dump is
+    // which load (if any) was still in progress, and what had been loaded before it.
+    for (uint32_t i=0; i < numEntries; ++i) {
+        const MayaPluginLoadTime *entry = &data->entries[i];
+        const char *kindName = entry->kind < (ARRAY_SIZE(kindNames)) ? kindNames[entry->kind] : "?";
+        if (entry->status != MayaPluginLoadTimeStatus_Done) {
+            printf("    %*s%-6s %.*s: did not finish\n",
+                   (int)entry->depth * 2, "", kindName, MAYA_PLUGIN_LOAD_TIME_NAME_LEN, entry->name);
+            continue;
+        }
+        printf("    %*s%-6s %.*s: %.3f ms, %+.1f MB committed, %+.1f MB working set\n",
+               (int)entry->depth * 2, "", kindName, MAYA_PLUGIN_LOAD_TIME_NAME_LEN, entry->name,
+               entry->durationTicks * ticksToMs,
+               entry->privateBytesDelta / (1024.0 * 1024.0),
+               entry->workingSetDelta / (1024.0 * 1024.0));
+    }
+    printf("End of plugin load times.\n");
+
+    return;
+}
+
+
+void printNameTableStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_NAME_TABLE_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No name table was recorded in the dump file.\n");
+        return;
+    }
+
+    const MayaNameTable *table = (const MayaNameTable *)pUserStream;
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_NameTable, streamSize) || table->magic != MAYA_NAME_TABLE_MAGIC || table->version != MAYA_NAME_TABLE_VERSION) {
+        printf("ERROR: Name table stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    uint32_t numNames = 0;
+    uint64_t numNameBytes = 0;
+    for (uint32_t i=0; i < MAYA_NAME_TABLE_CAPACITY; ++i) {
+        if (table->entries[i].id != MAYA_NAME_TABLE_INVALID_ID) {
+            ++numNames;
+            numNameBytes += table->entries[i].len;
+        }
+    }
+    const uint64_t numEvicted = table->numInserts > MAYA_NAME_TABLE_CAPACITY ? table->numInserts - MAYA_NAME_TABLE_CAPACITY : 0;
+    printf("Name table: %u names (%.1f KB) of %u, %llu inserts, %llu evicted.\n",
+           numNames, numNameBytes / 1024.0, MAYA_NAME_TABLE_CAPACITY,
+           table->numInserts, numEvicted);
+
+    return;
+}
+
+
+/// Sorts scene stats types by count, most common first.
+static int compareMayaSceneStatsTypes(const void *a, const void *b)
+{
+    const int32_t countA = ((const MayaSceneStatsType *)a)->count;
+    const int32_t countB = ((const MayaSceneStatsType *)b)->count;
+
+    return countA < countB ? 1 : (countA > countB ? -1 : 0);
+}
+
+
+void printSceneStatsStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_SCENE_STATS_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No scene statistics were recorded in the dump file.\n");
+        return;
+    }
+
+    const MayaSceneStats *stats = (const MayaSceneStats *)pUserStream;
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_SceneStats, streamSize) || stats->magic != MAYA_SCENE_STATS_MAGIC || stats->version != MAYA_SCENE_STATS_VERSION) {
+        printf("ERROR: Scene statistics stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    static const char *totalNames[] = {"nodes", "DAG nodes", "transforms", "shapes", "meshes", "joints", "cameras", "lights", "references"};
+    printf("Scene statistics%s:\n", stats->isLoading != 0 ? " (the scene was still being opened; only the nodes loaded so far are counted)" : "");
+    for (uint32_t i=0; i < MayaSceneStatsTotal_Count && i < (ARRAY_SIZE(totalNames)); ++i) {
+        printf("    %-12s %10d\n", totalNames[i], stats->totals[i]);
+    }
+    printf("    %llu nodes added and %llu removed since the plugin was loaded, %llu recounts.\n",
+           stats->numNodesAdded, stats->numNodesRemoved, stats->numRecounts);
+
+    // NOTE: (sonictk) Copied out so that they can be sorted; the stream is mapped read-only.
+    static MayaSceneStatsType types[MAYA_SCENE_STATS_MAX_TYPES];
+    uint32_t numTypes = 0;
+    for (uint32_t i=0; i < MAYA_SCENE_STATS_MAX_TYPES; ++i) {
+        if (stats->types[i].typeId != 0 && stats->types[i].count != 0) {
+            types[numTypes++] = stats->types[i];
+        }
+    }
+    qsort(types, numTypes, sizeof(MayaSceneStatsType), compareMayaSceneStatsTypes);
+    printf("Nodes by type (%u types, %d nodes of other types):\n", numTypes, stats->numUntypedNodes);
+    for (uint32_t i=0; i < numTypes; ++i) {
+        printf("    %-40.*s %10d\n", MAYA_SCENE_STATS_TYPE_NAME_LEN, types[i].typeName, types[i].count);
+    }
+    printf("End of scene statistics.\n");
+
+    return;
+}
+
+
+void printSelfProfileStream(PVOID pFileView)
+{
+    PMINIDUMP_DIRECTORY miniDumpDirPath = NULL;
+    PVOID pUserStream = NULL;
+    ULONG streamSize = 0;
+    BOOL bStat = MiniDumpReadDumpStream(pFileView,
+                                        MAYA_SELF_PROFILE_STREAM_TYPE,
+                                        &miniDumpDirPath,
+                                        &pUserStream,
+                                        &streamSize);
+    if (bStat != TRUE) {
+        printf("No self profile was recorded in the dump file.\n");
+        return;
+    }
+
+    const MayaSelfProfile *profile = (const MayaSelfProfile *)pUserStream;
+    if (!isMayaDumpUserStreamSizeValid(MayaDumpUserStream_SelfProfile, streamSize) || profile->magic != MAYA_SELF_PROFILE_MAGIC || profile->version != MAYA_SELF_PROFILE_VERSION) {
+        printf("ERROR: Self profile stream size mismatch. Check if the dump file was written correctly.\n");
+        return;
+    }
+
+    static const char *siteNames[] = {
+        "scene open", "scene load", "time change", "MEL command", "DAG change",
+        "node added", "node removed", "idle heartbeat", "plugin load", "flight recorder"
+    };
+
+    // NOTE: (sonictk) The rate of ``__rdtsc`` is worked out from how far it got compared to
+    // ``QueryPerformanceCounter`` between the plugin being loaded and the dump being written.
+    const uint64_t elapsedTicks = profile->endTimestamp - profile->startTimestamp;
+    const double elapsedMs = profile->timerFrequency == 0 ? 0.0 : elapsedTicks * 1000.0 / (double)profile->timerFrequency;
+    const double msPerCycle = profile->endCycles <= profile->startCycles ? 0.0 : elapsedMs / (double)(profile->endCycles - profile->startCycles);
+
+    MayaSelfProfileCounter counters[MayaSelfProfileSite_Count];
+    memset(counters, 0, sizeof(counters));
+    uint64_t totalCycles = 0;
+    for (uint32_t i=0; i < MAYA_SELF_PROFILE_MAX_THREADS; ++i) {
+        const MayaSelfProfileThread *slot = &profile->threads[i];
+        if (slot->threadId == 0) {
+            continue;
+        }
+        for (uint32_t j=0; j < MayaSelfProfileSite_Count; ++j) {
+            counters[j].numCalls += slot->counters[j].numCalls;
+            counters[j].totalCycles += slot->counters[j].totalCycles;
+            counters[j].numBytesCopied += slot->counters[j].numBytesCopied;
+            if (slot->counters[j].maxCycles > counters[j].maxCycles) {
+                counters[j].maxCycles = slot->counters[j].maxCycles;
+            }
+            totalCycles += slot->counters[j].totalCycles;
+        }
+    }
+
+    printf("Self profile: %.3f ms spent in the plugin's callbacks over %.1f s (%.4f%%), across %u threads (%u not counted):\n",
+           totalCycles * msPerCycle, elapsedMs / 1000.0,
+           elapsedMs > 0.0 ? totalCycles * msPerCycle * 100.0 / elapsedMs : 0.0,
+           profile->numThreads, profile->numDroppedThreads);
+    for (uint32_t i=0; i < MayaSelfProfileSite_Count; ++i) {
+        const MayaSelfProfileCounter *counter = &counters[i];
+        if (counter->numCalls == 0) {
+            continue;
+        }
+        printf("    %-16s %12llu calls %12.3f ms total %10.0f ns avg %10.3f us max %12llu bytes copied\n",
+               i < (ARRAY_SIZE(siteNames)) ? siteNames[i] : "?", counter->numCalls,
+               counter->totalCycles * msPerCycle,
+               counter->totalCycles * msPerCycle * 1e6 / (double)counter->numCalls,
+               counter->maxCycles * msPerCycle * 1e3,
+               counter->numBytesCopied);
+    }
+
+    return;
+}
+
+
+/// Prints every custom stream in the given dump, which can be mapped or read into memory.
+void printMayaDumpUserStreams(PVOID pFileView)
+{
+    // NOTE: (sonictk) Every registered stream has a printer, or this won't compile.
+#define MAYA_PRINT_DUMP_USER_STREAM(name, streamType, layout, sizing, dumps) print##name##Stream(pFileView);
+    MAYA_DUMP_USER_STREAMS(MAYA_PRINT_DUMP_USER_STREAM)
+#undef MAYA_PRINT_DUMP_USER_STREAM
+
+    return;
+}
+
+
+void parseAndPrintCustomStreamFromMiniDump(const char *dumpFilePath)
+{
+    if (dumpFilePath == NULL) {
+        return;
+    }
+
+    HANDLE hFile = CreateFile(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        printf("ERROR: Could not open the dump file requested.\n");
+        return;
+    }
+
+    HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapFile == NULL) {
+        printf("ERROR: Could not create the file mapping for the dump.\n");
+        return;
+    }
+
+    PVOID pFileView = MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+    if (pFileView == NULL) {
+        printf("ERROR: Failed to map view of the dump file.\n");
+        return;
+    }
+
+    printMayaDumpUserStreams(pFileView);
+
+    UnmapViewOfFile(pFileView);
+    CloseHandle(hMapFile);
+    CloseHandle(hFile);
+
+    return;
+}
+
+
 int main(int argc, char *argv[])
 {
+    char tempDirPath[MAX_PATH] = {0};
+    DWORD lenTempDirPath = GetEnvironmentVariable((LPCTSTR)TEMP_ENV_VAR_NAME, (LPTSTR)tempDirPath, (DWORD)MAX_PATH);
+    if (lenTempDirPath == 0) {
+        const size_t lenDefaultTempDirPath = strlen(DEFAULT_TEMP_DIRECTORY);
+        memcpy(tempDirPath, DEFAULT_TEMP_DIRECTORY, lenDefaultTempDirPath);
+        memset(tempDirPath + lenDefaultTempDirPath, 0, 1);
+    }
+
+    // NOTE: (sonictk) ``dump_reader -sidecars [directory]`` aggregates the crash sidecars in the
+    // given directory (the temp. directory by default) instead of reading any dumps.
+    if (argc >= 2 && strcmp(argv[1], MAYA_READER_SIDECARS_FLAG) == 0) {
+        return aggregateAndPrintCrashSidecars(argc >= 3 ? argv[2] : tempDirPath);
+    }
+
+    // NOTE: (sonictk) ``dump_reader -trace <dump> [output]`` exports the breadcrumb timeline of the
+    // dump as a Chrome trace instead of printing its streams.
+    if (argc >= 3 && strcmp(argv[1], MAYA_READER_TRACE_FLAG) == 0) {
+        return exportMayaBreadcrumbTrace(argv[2], argc >= 4 ? argv[3] : NULL);
+    }
+
+    // NOTE: (sonictk) ``dump_reader -diff <baseline> <dump|directory> [dump...]`` compares the
+    // dumps (or every dump in the directory) against the baseline instead.
+    if (argc >= 4 && strcmp(argv[1], MAYA_READER_DIFF_FLAG) == 0) {
+        return diffMayaDumps(argv[2], argv + 3, (uint32_t)(argc - 3));
+    }
+
+    // NOTE: (sonictk) ``dump_reader -heap <dump> [count]`` summarises what the memory of the process
+    // was being used for, from a full-memory dump.
+    if (argc >= 3 && strcmp(argv[1], MAYA_READER_HEAP_FLAG) == 0) {
+        return printMayaHeapSummary(argv[2], argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 10) : MAYA_HEAP_DEFAULT_NUM_TO_PRINT);
+    }
+
+    // NOTE: (sonictk) ``dump_reader -watch <directory> [directory...]`` keeps running totals of the
+    // dumps written to the directories until stopped.
+    if (argc >= 3 && strcmp(argv[1], MAYA_READER_WATCH_FLAG) == 0) {
+        return runMayaDumpDaemon(argv + 2, (uint32_t)(argc - 2));
+    }
+
+    // NOTE: (sonictk) ``dump_reader -scan <directory> [async|sync|map|bench] [inflight]`` prints a
+    // line of triage for every dump in the directory, reading only the streams that it needs.
+    if (argc >= 3 && strcmp(argv[1], MAYA_READER_SCAN_FLAG) == 0) {
+        return scanMayaDumps(argv[2], argc >= 4 ? argv[3] : NULL, argc >= 5 ? (uint32_t)strtoul(argv[4], NULL, 10) : 0);
+    }
+
+    // NOTE: (sonictk) ``dump_reader -stream <dump> [budgetMB]`` does what ``-heap`` does (and prints
+    // the streams) for dumps too large to map, reading the dump from start to end within the budget.
+    if (argc >= 3 && strcmp(argv[1], MAYA_READER_STREAM_FLAG) == 0) {
+        return streamMayaDump(argv[2], argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 10) : 0, MAYA_HEAP_DEFAULT_NUM_TO_PRINT);
+    }
+
     if (argc == 1) {
-        char tempDirPath[MAX_PATH] = {0};
-        DWORD lenTempDirPath = GetEnvironmentVariable((LPCTSTR)TEMP_ENV_VAR_NAME, (LPTSTR)tempDirPath, (DWORD)MAX_PATH);
-        if (lenTempDirPath == 0) {
-            const size_t lenDefaultTempDirPath = strlen(DEFAULT_TEMP_DIRECTORY);
-            memcpy(tempDirPath, DEFAULT_TEMP_DIRECTORY, lenDefaultTempDirPath);
-            memset(tempDirPath + lenDefaultTempDirPath, 0, 1);
-        }
         char dumpFilePath[MAX_PATH] = {0};
-        snprintf(dumpFilePath, MAX_PATH, "%s\\%s", tempDirPath, MINIDUMP_FILE_NAME);
+        if (!findNewestMayaCrashDump(tempDirPath, dumpFilePath, MAX_PATH)) {
+            fprintf(stderr, "No crash dumps found in %s\n", tempDirPath);
+            return 1;
+        }
         parseAndPrintCustomStreamFromMiniDump(dumpFilePath);
     } else {
         for (int i=1; i < argc; ++i) {
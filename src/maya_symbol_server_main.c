@@ -0,0 +1,704 @@
+/**
+ * @file   maya_symbol_server_main.c
+ * @brief  A local symbol server that the triage tools send batches of module+offset addresses to,
+ *         so that the symbols of OpenMaya, Foundation and the studio plugins are read out of their
+ *         PDBs once rather than on every triage run.
+ *
+ *         usage: maya_symbol_server.exe -store <symbol store dir> [-cachemb <MB>] [-instances <n>]
+ *         e.g. ``maya_symbol_server.exe -store \\studio\symbols -cachemb 2048``
+ *
+ *         The symbol store is laid out the way ``symstore.exe`` lays it out, i.e.
+ *         ``<store>\<pdb name>\<GUID><age>\<pdb name>``. The symbols of each PDB are loaded the
+ *         first time that one of its addresses is asked for, and kept as a table sorted by address
+ *         so that lookups are a binary search. The tables are kept keyed by PDB GUID and age, and
+ *         the least recently used ones are dropped once they take up more than ``-cachemb``.
+ *
+ *         Clients connect to ``MAYA_SYMBOL_SERVER_PIPE_NAME`` and send a
+ *         ``MayaSymbolServerRequest`` as a single message, and get a ``MayaSymbolServerResponse``
+ *         back as a single message (see ``common.h``). A client can keep the pipe open and send as
+ *         many requests as it likes.
+ */
+#ifndef _WIN32
+#error "Unsupported platform for compilation."
+#endif // _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Dbghelp.h>
+
+#include "common.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAYA_SYMBOL_SERVER_DEFAULT_CACHE_MB 1024
+#define MAYA_SYMBOL_SERVER_DEFAULT_INSTANCES 16
+#define MAYA_SYMBOL_SERVER_MAX_INSTANCES 64
+#define MAYA_SYMBOL_SERVER_STATS_INTERVAL_MS 10000
+#define MAYA_SYMBOL_SERVER_HASH_BUCKETS 1024
+
+/// Modules that had no symbols in the store are not looked for again until this long afterwards.
+#define MAYA_SYMBOL_SERVER_RETRY_MISSING_MS 300000
+
+/// Where each PDB is loaded while its symbols are read out of it. The address doesn't matter, since
+/// only the module-relative addresses are kept.
+#define MAYA_SYMBOL_SERVER_LOAD_BASE 0x10000000ULL
+
+/// NOTE: (sonictk) From ``enum SymTagEnum`` in ``cvconst.h``, which isn't part of the Windows SDK.
+#define MAYA_SYMBOL_SERVER_SYM_TAG_FUNCTION 5
+#define MAYA_SYMBOL_SERVER_SYM_TAG_PUBLIC_SYMBOL 10
+
+/// Request latencies are counted in buckets of powers of two of microseconds.
+#define MAYA_SYMBOL_SERVER_LATENCY_BUCKETS 24
+
+typedef struct MayaSymbolEntry
+{
+    uint32_t rva;
+    uint32_t size; // NOTE: (sonictk) ``0`` if unknown, in which case it runs up to the next symbol.
+    uint32_t nameOffset; // NOTE: (sonictk) Into ``MayaSymbolTable::names``.
+    uint32_t isFunction;
+} MayaSymbolEntry;
+
+/// The symbols of a single PDB, sorted by address.
+typedef struct MayaSymbolTable
+{
+    uint8_t pdbGuid[16];
+    uint32_t pdbAge;
+    char pdbName[MAYA_CRASH_SIDECAR_MODULE_NAME_LEN];
+
+    MayaSymbolEntry *entries;
+    uint32_t numEntries;
+    char *names;
+    size_t numBytes;
+    bool loaded; // NOTE: (sonictk) ``false`` if the store had no symbols for the module.
+    ULONGLONG loadTime;
+
+    // NOTE: (sonictk) Guarded by the cache lock.
+    uint32_t refCount;
+    bool evicted;
+    struct MayaSymbolTable *lruPrev;
+    struct MayaSymbolTable *lruNext;
+    struct MayaSymbolTable *bucketNext;
+} MayaSymbolTable;
+
+typedef struct MayaSymbolServer
+{
+    char storePath[MAX_PATH];
+    size_t maxCachedBytes;
+
+    CRITICAL_SECTION cacheLock;
+    MayaSymbolTable *buckets[MAYA_SYMBOL_SERVER_HASH_BUCKETS];
+    MayaSymbolTable *lruHead; // NOTE: (sonictk) Most recently used.
+    MayaSymbolTable *lruTail;
+    size_t numCachedBytes;
+    uint32_t numCachedTables;
+
+    // NOTE: (sonictk) DbgHelp is not thread-safe, so only one PDB is ever loaded at a time.
+    CRITICAL_SECTION loadLock;
+    HANDLE hSymProcess;
+
+    volatile LONG64 numRequests;
+    volatile LONG64 numLookups;
+    volatile LONG64 numCacheHits;
+    volatile LONG64 numCacheMisses;
+    volatile LONG64 numEvictions;
+    volatile LONG64 totalRequestMicroseconds;
+    volatile LONG64 latencyBuckets[MAYA_SYMBOL_SERVER_LATENCY_BUCKETS];
+
+    LARGE_INTEGER timerFrequency;
+    HANDLE hStopEvent;
+} MayaSymbolServer;
+
+static MayaSymbolServer gMayaSymbolServer;
+
+/// Collects the symbols of a PDB while it is being enumerated.
+typedef struct MayaSymbolTableBuilder
+{
+    MayaSymbolEntry *entries;
+    uint32_t numEntries;
+    uint32_t capacity;
+    char *names;
+    size_t lenNames;
+    size_t capacityNames;
+    bool failed;
+} MayaSymbolTableBuilder;
+
+
+static uint32_t hashMayaSymbolTableKey(const uint8_t pdbGuid[16], uint32_t pdbAge)
+{
+    uint32_t hash = 2166136261U;
+    for (int i=0; i < 16; ++i) {
+        hash = (hash ^ pdbGuid[i]) * 16777619U;
+    }
+
+    return (hash ^ pdbAge) * 16777619U;
+}
+
+
+static BOOL CALLBACK collectMayaSymbolCB(PSYMBOL_INFO pSymInfo, ULONG symbolSize, PVOID userContext)
+{
+    (void)symbolSize;
+    MayaSymbolTableBuilder *builder = (MayaSymbolTableBuilder *)userContext;
+    if (pSymInfo->Tag != MAYA_SYMBOL_SERVER_SYM_TAG_FUNCTION && pSymInfo->Tag != MAYA_SYMBOL_SERVER_SYM_TAG_PUBLIC_SYMBOL) {
+        return TRUE;
+    }
+    if (builder->numEntries == builder->capacity) {
+        uint32_t newCapacity = builder->capacity == 0 ? 4096 : builder->capacity * 2;
+        MayaSymbolEntry *newEntries = (MayaSymbolEntry *)realloc(builder->entries, newCapacity * sizeof(MayaSymbolEntry));
+        if (newEntries == NULL) {
+            builder->failed = true;
+            return FALSE;
+        }
+        builder->entries = newEntries;
+        builder->capacity = newCapacity;
+    }
+    const size_t lenName = strnlen(pSymInfo->Name, pSymInfo->NameLen);
+    if (builder->lenNames + lenName + 1 > builder->capacityNames) {
+        size_t newCapacity = builder->capacityNames == 0 ? 256 * 1024 : builder->capacityNames * 2;
+        while (newCapacity < builder->lenNames + lenName + 1) {
+            newCapacity *= 2;
+        }
+        char *newNames = (char *)realloc(builder->names, newCapacity);
+        if (newNames == NULL) {
+            builder->failed = true;
+            return FALSE;
+        }
+        builder->names = newNames;
+        builder->capacityNames = newCapacity;
+    }
+
+    MayaSymbolEntry *entry = &builder->entries[builder->numEntries++];
+    entry->rva = (uint32_t)(pSymInfo->Address - pSymInfo->ModBase);
+    entry->size = pSymInfo->Size;
+    entry->nameOffset = (uint32_t)builder->lenNames;
+    entry->isFunction = pSymInfo->Tag == MAYA_SYMBOL_SERVER_SYM_TAG_FUNCTION ? 1 : 0;
+    memcpy(builder->names + builder->lenNames, pSymInfo->Name, lenName);
+    builder->names[builder->lenNames + lenName] = '\0';
+    builder->lenNames += lenName + 1;
+
+    return TRUE;
+}
+
+
+/// By address; where a function and a public symbol start at the same address, the function
+/// comes first, since it has a size.
+static int compareMayaSymbolEntries(const void *a, const void *b)
+{
+    const MayaSymbolEntry *entryA = (const MayaSymbolEntry *)a;
+    const MayaSymbolEntry *entryB = (const MayaSymbolEntry *)b;
+    if (entryA->rva != entryB->rva) {
+        return entryA->rva < entryB->rva ? -1 : 1;
+    }
+
+    return (int)entryB->isFunction - (int)entryA->isFunction;
+}
+
+
+/**
+ * Reads the symbols of a module out of its PDB in the symbol store. Must be called with the load
+ * lock held.
+ *
+ * @return  ``false`` if the store has no matching PDB for the module.
+ */
+static bool loadMayaSymbolTable(MayaSymbolServer *server, MayaSymbolTable *table)
+{
+    GUID guid;
+    memcpy(&guid, table->pdbGuid, sizeof(guid));
+    char pdbPath[MAX_PATH] = {0};
+    snprintf(pdbPath, MAX_PATH, "%s\\%s\\%08lX%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X\\%s",
+             server->storePath, table->pdbName,
+             guid.Data1, guid.Data2, guid.Data3,
+             guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+             guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7],
+             table->pdbAge, table->pdbName);
+    if (GetFileAttributes(pdbPath) == INVALID_FILE_ATTRIBUTES) {
+        return false;
+    }
+
+    // NOTE: (sonictk) DbgHelp is happy to load a PDB without its image, as long as it is given a
+    // size to go with the base address.
+    DWORD64 base = SymLoadModuleEx(server->hSymProcess, NULL, pdbPath, NULL, MAYA_SYMBOL_SERVER_LOAD_BASE, 0x7FFFFFFF, NULL, 0);
+    if (base == 0) {
+        return false;
+    }
+    IMAGEHLP_MODULE64 moduleInfo;
+    memset(&moduleInfo, 0, sizeof(moduleInfo));
+    moduleInfo.SizeOfStruct = sizeof(moduleInfo);
+    bool matches = SymGetModuleInfo64(server->hSymProcess, base, &moduleInfo) == TRUE
+        && memcmp(&moduleInfo.PdbSig70, &guid, sizeof(guid)) == 0
+        && moduleInfo.PdbAge == table->pdbAge;
+
+    MayaSymbolTableBuilder builder = {0};
+    if (matches) {
+        SymEnumSymbols(server->hSymProcess, base, "*", collectMayaSymbolCB, &builder);
+    }
+    SymUnloadModule64(server->hSymProcess, base);
+    if (!matches || builder.failed || builder.numEntries == 0) {
+        free(builder.entries);
+        free(builder.names);
+        return false;
+    }
+
+    qsort(builder.entries, builder.numEntries, sizeof(MayaSymbolEntry), compareMayaSymbolEntries);
+    uint32_t numUnique = 0;
+    for (uint32_t i=0; i < builder.numEntries; ++i) {
+        if (numUnique > 0 && builder.entries[numUnique - 1].rva == builder.entries[i].rva) {
+            continue;
+        }
+        builder.entries[numUnique++] = builder.entries[i];
+    }
+
+    table->entries = builder.entries;
+    table->numEntries = numUnique;
+    table->names = builder.names;
+    table->numBytes = sizeof(MayaSymbolTable) + (size_t)builder.capacity * sizeof(MayaSymbolEntry) + builder.capacityNames;
+
+    return true;
+}
+
+
+static void freeMayaSymbolTable(MayaSymbolTable *table)
+{
+    free(table->entries);
+    free(table->names);
+    free(table);
+
+    return;
+}
+
+
+/// Must be called with the cache lock held.
+static void unlinkMayaSymbolTable(MayaSymbolServer *server, MayaSymbolTable *table)
+{
+    MayaSymbolTable **link = &server->buckets[hashMayaSymbolTableKey(table->pdbGuid, table->pdbAge) % MAYA_SYMBOL_SERVER_HASH_BUCKETS];
+    while (*link != table) {
+        link = &(*link)->bucketNext;
+    }
+    *link = table->bucketNext;
+    if (table->lruPrev != NULL) {
+        table->lruPrev->lruNext = table->lruNext;
+    } else {
+        server->lruHead = table->lruNext;
+    }
+    if (table->lruNext != NULL) {
+        table->lruNext->lruPrev = table->lruPrev;
+    } else {
+        server->lruTail = table->lruPrev;
+    }
+    server->numCachedBytes -= table->numBytes;
+    --server->numCachedTables;
+    table->evicted = true;
+
+    return;
+}
+
+
+/// Must be called with the cache lock held.
+static void touchMayaSymbolTable(MayaSymbolServer *server, MayaSymbolTable *table)
+{
+    if (server->lruHead == table) {
+        return;
+    }
+    if (table->lruPrev != NULL) {
+        table->lruPrev->lruNext = table->lruNext;
+    }
+    if (table->lruNext != NULL) {
+        table->lruNext->lruPrev = table->lruPrev;
+    } else if (server->lruTail == table) {
+        server->lruTail = table->lruPrev;
+    }
+    table->lruPrev = NULL;
+    table->lruNext = server->lruHead;
+    if (server->lruHead != NULL) {
+        server->lruHead->lruPrev = table;
+    }
+    server->lruHead = table;
+    if (server->lruTail == NULL) {
+        server->lruTail = table;
+    }
+
+    return;
+}
+
+
+/// Must be called with the cache lock held.
+static MayaSymbolTable *findMayaSymbolTable(MayaSymbolServer *server, const MayaCrashSidecarModule *module)
+{
+    MayaSymbolTable *table = server->buckets[hashMayaSymbolTableKey(module->pdbGuid, module->pdbAge) % MAYA_SYMBOL_SERVER_HASH_BUCKETS];
+    for (; table != NULL; table = table->bucketNext) {
+        if (table->pdbAge == module->pdbAge && memcmp(table->pdbGuid, module->pdbGuid, sizeof(table->pdbGuid)) == 0) {
+            break;
+        }
+    }
+    // NOTE: (sonictk) Look for symbols that were missing again once in a while, since they may
+    // have been added to the store since.
+    if (table != NULL && !table->loaded && GetTickCount64() - table->loadTime >= MAYA_SYMBOL_SERVER_RETRY_MISSING_MS && table->refCount == 0) {
+        unlinkMayaSymbolTable(server, table);
+        freeMayaSymbolTable(table);
+        table = NULL;
+    }
+    if (table != NULL) {
+        ++table->refCount;
+        touchMayaSymbolTable(server, table);
+    }
+
+    return table;
+}
+
+
+/// Drops the least recently used tables until the cache fits its budget again. Tables that are
+/// still being read from are skipped over, and dropped once they have been given back. Must be
+/// called with the cache lock held.
+static void evictMayaSymbolTables(MayaSymbolServer *server)
+{
+    MayaSymbolTable *victim = server->lruTail;
+    while (server->numCachedBytes > server->maxCachedBytes && victim != NULL) {
+        MayaSymbolTable *prev = victim->lruPrev;
+        if (victim->refCount == 0) {
+            unlinkMayaSymbolTable(server, victim);
+            freeMayaSymbolTable(victim);
+            InterlockedIncrement64(&server->numEvictions);
+        }
+        victim = prev;
+    }
+
+    return;
+}
+
+
+/**
+ * Gets the symbols of a module, loading them if they aren't cached yet. The table must be given
+ * back with ``releaseMayaSymbolTable`` once done with.
+ *
+ * @return  The table, or ``NULL`` if out of memory.
+ */
+static MayaSymbolTable *acquireMayaSymbolTable(MayaSymbolServer *server, const MayaCrashSidecarModule *module)
+{
+    EnterCriticalSection(&server->cacheLock);
+    MayaSymbolTable *table = findMayaSymbolTable(server, module);
+    LeaveCriticalSection(&server->cacheLock);
+    if (table != NULL) {
+        InterlockedIncrement64(&server->numCacheHits);
+        return table;
+    }
+
+    // NOTE: (sonictk) Someone else may have loaded the same module while we waited our turn.
+    EnterCriticalSection(&server->loadLock);
+    EnterCriticalSection(&server->cacheLock);
+    table = findMayaSymbolTable(server, module);
+    LeaveCriticalSection(&server->cacheLock);
+    if (table != NULL) {
+        LeaveCriticalSection(&server->loadLock);
+        InterlockedIncrement64(&server->numCacheHits);
+        return table;
+    }
+
+    InterlockedIncrement64(&server->numCacheMisses);
+    table = (MayaSymbolTable *)calloc(1, sizeof(MayaSymbolTable));
+    if (table == NULL) {
+        LeaveCriticalSection(&server->loadLock);
+        return NULL;
+    }
+    memcpy(table->pdbGuid, module->pdbGuid, sizeof(table->pdbGuid));
+    table->pdbAge = module->pdbAge;
+    memcpy(table->pdbName, module->pdbName, sizeof(table->pdbName));
+    table->pdbName[MAYA_CRASH_SIDECAR_MODULE_NAME_LEN - 1] = '\0';
+    table->loaded = table->pdbName[0] != '\0' && loadMayaSymbolTable(server, table);
+    table->loadTime = GetTickCount64();
+    table->numBytes = table->loaded ? table->numBytes : sizeof(MayaSymbolTable);
+    table->refCount = 1;
+
+    EnterCriticalSection(&server->cacheLock);
+    MayaSymbolTable **bucket = &server->buckets[hashMayaSymbolTableKey(table->pdbGuid, table->pdbAge) % MAYA_SYMBOL_SERVER_HASH_BUCKETS];
+    table->bucketNext = *bucket;
+    *bucket = table;
+    touchMayaSymbolTable(server, table);
+    server->numCachedBytes += table->numBytes;
+    ++server->numCachedTables;
+
+    evictMayaSymbolTables(server);
+    LeaveCriticalSection(&server->cacheLock);
+    LeaveCriticalSection(&server->loadLock);
+
+    return table;
+}
+
+
+static void releaseMayaSymbolTable(MayaSymbolServer *server, MayaSymbolTable *table)
+{
+    EnterCriticalSection(&server->cacheLock);
+    --table->refCount;
+    if (table->evicted && table->refCount == 0) {
+        freeMayaSymbolTable(table);
+    } else if (table->refCount == 0) {
+        evictMayaSymbolTables(server);
+    }
+    LeaveCriticalSection(&server->cacheLock);
+
+    return;
+}
+
+
+static void lookUpMayaSymbol(const MayaSymbolTable *table, uint32_t offset, MayaSymbolServerResult *result)
+{
+    result->status = MayaSymbolServerStatus_NotFound;
+    if (table->numEntries == 0 || offset < table->entries[0].rva) {
+        return;
+    }
+    // NOTE: (sonictk) Find the last symbol that starts at or before the address.
+    uint32_t lo = 0;
+    uint32_t hi = table->numEntries;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (table->entries[mid].rva <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    const MayaSymbolEntry *entry = &table->entries[lo];
+    if (entry->size != 0 && offset - entry->rva >= entry->size) {
+        return;
+    }
+    result->status = MayaSymbolServerStatus_Found;
+    result->displacement = offset - entry->rva;
+    strncpy(result->name, table->names + entry->nameOffset, MAYA_SYMBOL_SERVER_SYMBOL_NAME_LEN - 1);
+
+    return;
+}
+
+
+/// Answers a single request. Returns the number of bytes of the response to send back.
+static DWORD handleMayaSymbolServerRequest(MayaSymbolServer *server,
+                                           const MayaSymbolServerRequest *request,
+                                           DWORD lenRequest,
+                                           MayaSymbolServerResponse *response)
+{
+    LARGE_INTEGER startTime;
+    QueryPerformanceCounter(&startTime);
+
+    memset(response, 0, offsetof(MayaSymbolServerResponse, results));
+    response->magic = MAYA_SYMBOL_SERVER_MAGIC;
+    response->version = MAYA_SYMBOL_SERVER_VERSION;
+    const DWORD minLenRequest = (DWORD)offsetof(MayaSymbolServerRequest, lookups);
+    if (lenRequest >= minLenRequest
+        && request->magic == MAYA_SYMBOL_SERVER_MAGIC
+        && request->version == MAYA_SYMBOL_SERVER_VERSION
+        && request->numModules <= MAYA_SYMBOL_SERVER_MAX_MODULES
+        && request->numLookups <= MAYA_SYMBOL_SERVER_MAX_LOOKUPS
+        && lenRequest >= minLenRequest + request->numLookups * sizeof(MayaCrashSidecarFrame)) {
+        response->numResults = request->numLookups;
+    }
+
+    // NOTE: (sonictk) Only the modules that are actually looked up in are loaded.
+    MayaSymbolTable *tables[MAYA_SYMBOL_SERVER_MAX_MODULES] = {0};
+    for (uint32_t i=0; i < response->numResults; ++i) {
+        const MayaCrashSidecarFrame *lookup = &request->lookups[i];
+        MayaSymbolServerResult *result = &response->results[i];
+        memset(result, 0, sizeof(MayaSymbolServerResult));
+        if (lookup->moduleIdx >= request->numModules) {
+            result->status = MayaSymbolServerStatus_NoModule;
+            continue;
+        }
+        if (tables[lookup->moduleIdx] == NULL) {
+            tables[lookup->moduleIdx] = acquireMayaSymbolTable(server, &request->modules[lookup->moduleIdx]);
+        }
+        const MayaSymbolTable *table = tables[lookup->moduleIdx];
+        if (table == NULL || !table->loaded) {
+            result->status = MayaSymbolServerStatus_NoSymbols;
+            continue;
+        }
+        lookUpMayaSymbol(table, lookup->offset, result);
+    }
+    for (uint32_t i=0; i < MAYA_SYMBOL_SERVER_MAX_MODULES; ++i) {
+        if (tables[i] != NULL) {
+            releaseMayaSymbolTable(server, tables[i]);
+        }
+    }
+
+    LARGE_INTEGER endTime;
+    QueryPerformanceCounter(&endTime);
+    const uint64_t elapsedMicroseconds = (uint64_t)(endTime.QuadPart - startTime.QuadPart) * 1000000ULL / (uint64_t)server->timerFrequency.QuadPart;
+    uint32_t bucket = 0;
+    while (bucket < MAYA_SYMBOL_SERVER_LATENCY_BUCKETS - 1 && (1ULL << bucket) <= elapsedMicroseconds) {
+        ++bucket;
+    }
+    InterlockedIncrement64(&server->latencyBuckets[bucket]);
+    InterlockedIncrement64(&server->numRequests);
+    InterlockedAdd64(&server->numLookups, (LONG64)response->numResults);
+    InterlockedAdd64(&server->totalRequestMicroseconds, (LONG64)elapsedMicroseconds);
+
+    MayaSymbolServerStats *stats = &response->stats;
+    stats->numRequests = (uint64_t)server->numRequests;
+    stats->numLookups = (uint64_t)server->numLookups;
+    stats->numCacheHits = (uint64_t)server->numCacheHits;
+    stats->numCacheMisses = (uint64_t)server->numCacheMisses;
+    stats->numEvictions = (uint64_t)server->numEvictions;
+    stats->numCachedTables = server->numCachedTables;
+    stats->numCachedBytes = server->numCachedBytes;
+    stats->totalRequestMicroseconds = (uint64_t)server->totalRequestMicroseconds;
+
+    return (DWORD)(offsetof(MayaSymbolServerResponse, results) + response->numResults * sizeof(MayaSymbolServerResult));
+}
+
+
+/// Serves one client at a time on its own instance of the pipe.
+static DWORD WINAPI mayaSymbolServerPipeThreadProc(LPVOID lpParameter)
+{
+    MayaSymbolServer *server = (MayaSymbolServer *)lpParameter;
+    MayaSymbolServerRequest *request = (MayaSymbolServerRequest *)malloc(sizeof(MayaSymbolServerRequest));
+    MayaSymbolServerResponse *response = (MayaSymbolServerResponse *)malloc(sizeof(MayaSymbolServerResponse));
+    if (request == NULL || response == NULL) {
+        free(request);
+        free(response);
+        return 1;
+    }
+    for (;;) {
+        HANDLE hPipe = CreateNamedPipe(MAYA_SYMBOL_SERVER_PIPE_NAME,
+                                       PIPE_ACCESS_DUPLEX,
+                                       PIPE_TYPE_MESSAGE|PIPE_READMODE_MESSAGE|PIPE_WAIT|PIPE_REJECT_REMOTE_CLIENTS,
+                                       PIPE_UNLIMITED_INSTANCES,
+                                       sizeof(MayaSymbolServerResponse),
+                                       sizeof(MayaSymbolServerRequest),
+                                       0,
+                                       NULL);
+        if (hPipe == INVALID_HANDLE_VALUE) {
+            fprintf(stderr, "Could not create the named pipe %s: error %lu\n", MAYA_SYMBOL_SERVER_PIPE_NAME, GetLastError());
+            SetEvent(server->hStopEvent);
+            break;
+        }
+        if (ConnectNamedPipe(hPipe, NULL) == TRUE || GetLastError() == ERROR_PIPE_CONNECTED) {
+            DWORD lenRequest = 0;
+            while (ReadFile(hPipe, request, sizeof(MayaSymbolServerRequest), &lenRequest, NULL) == TRUE) {
+                DWORD lenResponse = handleMayaSymbolServerRequest(server, request, lenRequest, response);
+                DWORD numWritten = 0;
+                if (WriteFile(hPipe, response, lenResponse, &numWritten, NULL) == FALSE) {
+                    break;
+                }
+            }
+            DisconnectNamedPipe(hPipe);
+        }
+        CloseHandle(hPipe);
+    }
+    free(request);
+    free(response);
+
+    return 0;
+}
+
+
+static void printMayaSymbolServerStats(MayaSymbolServer *server)
+{
+    const uint64_t numRequests = (uint64_t)server->numRequests;
+    const uint64_t numHits = (uint64_t)server->numCacheHits;
+    const uint64_t numMisses = (uint64_t)server->numCacheMisses;
+    EnterCriticalSection(&server->cacheLock);
+    const uint32_t numCachedTables = server->numCachedTables;
+    const size_t numCachedBytes = server->numCachedBytes;
+    LeaveCriticalSection(&server->cacheLock);
+
+    // NOTE: (sonictk) The percentiles are only as precise as the power-of-two buckets they are read from.
+    uint64_t percentileMicroseconds[3] = {0};
+    const double percentiles[3] = {0.5, 0.99, 0.999};
+    uint64_t numCounted = 0;
+    uint32_t percentileIdx = 0;
+    for (uint32_t i=0; i < MAYA_SYMBOL_SERVER_LATENCY_BUCKETS && percentileIdx < 3; ++i) {
+        numCounted += (uint64_t)server->latencyBuckets[i];
+        while (percentileIdx < 3 && numRequests > 0 && (double)numCounted >= percentiles[percentileIdx] * (double)numRequests) {
+            percentileMicroseconds[percentileIdx++] = 1ULL << i;
+        }
+    }
+
+    printf("%llu requests, %llu lookups, %.1f%% cache hits (%llu misses, %llu evictions), %u tables cached in %.1f MB, "
+           "latency avg %.1f us, p50 < %llu us, p99 < %llu us, p99.9 < %llu us\n",
+           numRequests, (uint64_t)server->numLookups,
+           numHits + numMisses > 0 ? (double)numHits * 100.0 / (double)(numHits + numMisses) : 0.0,
+           numMisses, (uint64_t)server->numEvictions,
+           numCachedTables, (double)numCachedBytes / (1024.0 * 1024.0),
+           numRequests > 0 ? (double)server->totalRequestMicroseconds / (double)numRequests : 0.0,
+           percentileMicroseconds[0], percentileMicroseconds[1], percentileMicroseconds[2]);
+
+    return;
+}
+
+
+static BOOL WINAPI mayaSymbolServerCtrlHandler(DWORD ctrlType)
+{
+    (void)ctrlType;
+    SetEvent(gMayaSymbolServer.hStopEvent);
+
+    return TRUE;
+}
+
+
+int main(int argc, char *argv[])
+{
+    MayaSymbolServer *server = &gMayaSymbolServer;
+    unsigned int cacheMB = MAYA_SYMBOL_SERVER_DEFAULT_CACHE_MB;
+    unsigned int numInstances = MAYA_SYMBOL_SERVER_DEFAULT_INSTANCES;
+
+    for (int i=1; i < argc; ++i) {
+        if (strcmp(argv[i], "-store") == 0 && i + 1 < argc) {
+            strncpy(server->storePath, argv[++i], MAX_PATH - 1);
+        } else if (strcmp(argv[i], "-cachemb") == 0 && i + 1 < argc) {
+            cacheMB = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-instances") == 0 && i + 1 < argc) {
+            numInstances = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (server->storePath[0] == '\0') {
+        fprintf(stderr, "usage: maya_symbol_server.exe -store <symbol store dir> [-cachemb <MB>] [-instances <n>]\n");
+        return 1;
+    }
+    numInstances = numInstances == 0 ? 1 : numInstances;
+    numInstances = numInstances > MAYA_SYMBOL_SERVER_MAX_INSTANCES ? MAYA_SYMBOL_SERVER_MAX_INSTANCES : numInstances;
+    server->maxCachedBytes = (size_t)(cacheMB == 0 ? 1 : cacheMB) * 1024 * 1024;
+    QueryPerformanceFrequency(&server->timerFrequency);
+    InitializeCriticalSection(&server->cacheLock);
+    InitializeCriticalSection(&server->loadLock);
+    server->hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    // NOTE: (sonictk) Any unique value will do as the process handle, since we never invade a process.
+    server->hSymProcess = (HANDLE)server;
+    SymSetOptions(SYMOPT_UNDNAME|SYMOPT_FAIL_CRITICAL_ERRORS|SYMOPT_NO_PROMPTS);
+    if (server->hStopEvent == NULL || SymInitialize(server->hSymProcess, NULL, FALSE) == FALSE) {
+        fprintf(stderr, "Could not initialize DbgHelp: error %lu\n", GetLastError());
+        return 1;
+    }
+    SetConsoleCtrlHandler(mayaSymbolServerCtrlHandler, TRUE);
+
+    for (unsigned int i=0; i < numInstances; ++i) {
+        HANDLE hThread = CreateThread(NULL, 0, mayaSymbolServerPipeThreadProc, server, 0, NULL);
+        if (hThread == NULL) {
+            fprintf(stderr, "Could not start a pipe thread: error %lu\n", GetLastError());
+            return 1;
+        }
+        CloseHandle(hThread);
+    }
+
+    printf("Serving symbols from %s on %s with %u pipe instances and a %u MB cache. Press Ctrl+C to stop.\n",
+           server->storePath, MAYA_SYMBOL_SERVER_PIPE_NAME, numInstances, cacheMB);
+
+    uint64_t lastNumRequests = 0;
+    while (WaitForSingleObject(server->hStopEvent, MAYA_SYMBOL_SERVER_STATS_INTERVAL_MS) == WAIT_TIMEOUT) {
+        if ((uint64_t)server->numRequests != lastNumRequests) {
+            lastNumRequests = (uint64_t)server->numRequests;
+            printMayaSymbolServerStats(server);
+        }
+    }
+    printMayaSymbolServerStats(server);
+
+    // NOTE: (sonictk) The pipe threads are left blocked on their clients; exiting the process
+    // takes care of them. Just make sure that none of them is in the middle of loading symbols.
+    EnterCriticalSection(&server->loadLock);
+    SymCleanup(server->hSymProcess);
+
+    return 0;
+}
@@ -103,100 +103,95 @@ DLL_EXPORT DECLARE_API(readMayaDumpStreams)
         memcpy(tempDirPath, DEFAULT_TEMP_DIRECTORY, lenDefaultTempDirPath);
         memset(tempDirPath + lenDefaultTempDirPath, 0, 1);
     }
+    // NOTE: (sonictk) Every crash gets a dump of its own, so read the one given, or else the newest.
     char dumpFilePath[MAX_PATH] = {0};
-    snprintf(dumpFilePath, MAX_PATH, "%s\\%s", tempDirPath, MINIDUMP_FILE_NAME);
+    PCSTR argDumpFilePath = args;
+    while (argDumpFilePath != NULL && *argDumpFilePath == ' ') {
+        ++argDumpFilePath;
+    }
+    if (argDumpFilePath != NULL && *argDumpFilePath != '\0') {
+        snprintf(dumpFilePath, MAX_PATH, "%s", argDumpFilePath);
+    } else if (!findNewestMayaCrashDump(tempDirPath, dumpFilePath, MAX_PATH)) {
+        dprintf("ERROR: No crash dumps found in %s.\n", tempDirPath);
+        return;
+    }
     HANDLE hFile = CreateFile(dumpFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
     if (hFile == INVALID_HANDLE_VALUE) {
         dprintf("ERROR: Could not open the dump file requested.\n");
         return;
     }
 
-    // NOTE: (sonictk) Structure of minidump file is documented in ``minidumpapiset.h``.
-    PMINIDUMP_HEADER pDumpHeader = NULL;
-    PMINIDUMP_DIRECTORY pDumpDirPath = NULL;
-    PMINIDUMP_USER_STREAM pDumpUserStream = NULL;
-    static const ULONG gBufSize = 0x1000; // NOTE: (sonictk) Minidump header size is 4096 bytes according to: https://computer.forensikblog.de/en/2006/03/dmp-file-structure.html
-    void *pBuf = malloc(gBufSize);
+    // NOTE: (sonictk) Structure of minidump file is documented in ``minidumpapiset.h``. The
+    // header points to an array of ``MINIDUMP_DIRECTORY`` entries (which need not follow it), and
+    // each entry gives the type, size and file offset of one stream.
+    MINIDUMP_HEADER dumpHeader = {0};
     DWORD bytesRead = 0;
-
-    BOOL bStat = ReadFile(hFile, pBuf, sizeof(MINIDUMP_HEADER), &bytesRead, NULL);
-    if (bStat == 0) {
-        dprintf("ERROR: File read failure.\n");
+    BOOL bStat = ReadFile(hFile, &dumpHeader, sizeof(MINIDUMP_HEADER), &bytesRead, NULL);
+    if (bStat == 0 || bytesRead != sizeof(MINIDUMP_HEADER) || dumpHeader.Signature != MINIDUMP_SIGNATURE) {
+        dprintf("ERROR: Unable to read minidump header.\n");
+        CloseHandle(hFile);
         return;
     }
 
-    ULONG numUserStreams = 0;
-    if (bytesRead == sizeof(MINIDUMP_HEADER)) {
-        pDumpHeader = (PMINIDUMP_HEADER)pBuf;
-        numUserStreams = pDumpHeader->NumberOfStreams;
-        for (ULONG i=0; i < numUserStreams; ++i) {
-            bStat = ReadFile(hFile, pBuf, sizeof(MINIDUMP_DIRECTORY), &bytesRead, NULL);
-            if (bStat == 0) {
-                dprintf("ERROR: Failed to read minidump directory.\n");
-                break;
-            }
-
-            // NOTE: (sonictk) According to the header documentation:
-            //
-            // The MINIDUMP_HEADER field StreamDirectoryRva points to
-            // an array of MINIDUMP_DIRECTORY structures.
-            //
-            pDumpDirPath = (PMINIDUMP_DIRECTORY)pBuf;
-            if (pDumpDirPath->StreamType != MAYA_CRASH_INFO_STREAM_TYPE) {
-                continue;
-            }
-            // NOTE: (sonictk) According to the header documentation:
-            //
-            // The MINIDUMP_DIRECTORY field StreamType may be one of the following types.
-            // i.e.
-            //
-            // TODO: (sonictk) This part confuses me: is this really the format spec?
-            // How does all this casting around even work?
-            pDumpUserStream = (PMINIDUMP_USER_STREAM)pBuf;
-            ULONG streamBufSize = pDumpUserStream->BufferSize;
-            if (streamBufSize != sizeof(MayaCrashDumpInfo)) {
-                dprintf("ERROR: The stream size does not match that of the known crash dump structure.\n");
-                continue;
-            }
-            ULONG streamType = pDumpUserStream->Type;
-            PCHAR pUserStreamBuf = (PCHAR)pDumpUserStream->Buffer;
-            DWORD curPos = SetFilePointer(hFile, 0, NULL, FILE_CURRENT);
-#pragma warning(disable : 4311)
-            SetFilePointer(hFile, (LONG)pUserStreamBuf, NULL, FILE_BEGIN);
-#pragma warning(default : 4311)
-            MayaCrashDumpInfo crashInfo = {0};
-            bStat = ReadFile(hFile, &crashInfo, streamBufSize, &bytesRead, NULL);
-            if (bStat == 0 || bytesRead != streamBufSize) {
-                dprintf("ERROR: Failed to read user stream.\n");
-                break;
-            }
-
-            dprintf("\n"
-                    "-------------------------------------------------\n"
-                    "Maya dump file information is as follows:\n"
-                    "Stream type %d:\n"
-                    "Maya API version: %d\n"
-                    "Custom API version: %d\n"
-                    "Maya file version:: %d\n"
-                    "Is Y-axis up: %d \n"
-                    "Last DAG parent: %s \n"
-                    "Last DAG child: %s \n"
-                    "Last DAG message: %d \n"
-                    "Last DG node added: %s \n"
-                    "\nEnd of crash info. \n"
-                    "-------------------------------------------------\n"
-                    "\n\n", streamType, crashInfo.verAPI, crashInfo.verCustom, crashInfo.verMayaFile, crashInfo.isYUp, crashInfo.lastDagParentName, crashInfo.lastDagChildName, crashInfo.lastDagMessage, crashInfo.lastDGNodeAddedName);
-
-            SetFilePointer(hFile, curPos, NULL, FILE_BEGIN);
+    // NOTE: (sonictk) Seek with 64-bit offsets throughout: ``SetFilePointer`` with only the low
+    // ``LONG`` treats anything past 2 GB as negative, and full-memory dumps are far larger.
+    LARGE_INTEGER dirPos;
+    dirPos.QuadPart = (LONGLONG)dumpHeader.StreamDirectoryRva;
+    for (ULONG i=0; i < dumpHeader.NumberOfStreams; ++i) {
+        MINIDUMP_DIRECTORY dumpDir = {0};
+        if (SetFilePointerEx(hFile, dirPos, NULL, FILE_BEGIN) == FALSE
+            || ReadFile(hFile, &dumpDir, sizeof(MINIDUMP_DIRECTORY), &bytesRead, NULL) == FALSE
+            || bytesRead != sizeof(MINIDUMP_DIRECTORY)) {
+            dprintf("ERROR: Failed to read minidump directory.\n");
+            break;
         }
-    } else {
-        dprintf("ERROR: Unable to read minidump header.\n");
+        dirPos.QuadPart += sizeof(MINIDUMP_DIRECTORY);
+
+        const MayaDumpUserStream stream = findMayaDumpUserStream(dumpDir.StreamType);
+        if (stream == MayaDumpUserStream_Count) {
+            continue;
+        }
+        const ULONG32 streamSize = dumpDir.Location.DataSize;
+        if (!isMayaDumpUserStreamSizeValid(stream, streamSize)) {
+            dprintf("ERROR: The size of the %s stream (%lu bytes) does not match that of the known structure.\n",
+                    kMayaDumpUserStreams[stream].name, (unsigned long)streamSize);
+            continue;
+        }
+        if (stream != MayaDumpUserStream_CrashInfo) {
+            dprintf("Found the %s stream (type 0x%x, %lu bytes); use dump_reader to print it.\n",
+                    kMayaDumpUserStreams[stream].name, dumpDir.StreamType, (unsigned long)streamSize);
+            continue;
+        }
+
+        LARGE_INTEGER streamPos;
+        streamPos.QuadPart = (LONGLONG)dumpDir.Location.Rva;
+        MayaCrashDumpInfo crashInfo = {0};
+        if (SetFilePointerEx(hFile, streamPos, NULL, FILE_BEGIN) == FALSE
+            || ReadFile(hFile, &crashInfo, sizeof(MayaCrashDumpInfo), &bytesRead, NULL) == FALSE
+            || bytesRead != sizeof(MayaCrashDumpInfo)) {
+            dprintf("ERROR: Failed to read user stream.\n");
+            break;
+        }
+
+        dprintf("\n"
+                "-------------------------------------------------\n"
+                "Maya dump file information is as follows:\n"
+                "Stream type %d:\n"
+                "Maya API version: %d\n"
+                "Custom API version: %d\n"
+                "Maya file version:: %d\n"
+                "Is Y-axis up: %d \n"
+                "Last DAG parent: %s \n"
+                "Last DAG child: %s \n"
+                "Last DAG message: %d \n"
+                "Last DG node added: %s \n"
+                "\nEnd of crash info. \n"
+                "-------------------------------------------------\n"
+                "\n\n", dumpDir.StreamType, crashInfo.verAPI, crashInfo.verCustom, crashInfo.verMayaFile, crashInfo.isYUp, crashInfo.lastDagParentName, crashInfo.lastDagChildName, crashInfo.lastDagMessage, crashInfo.lastDGNodeAddedName);
     }
 
     CloseHandle(hFile);
 
-    free(pBuf);
-
     return;
 }
 
@@ -205,7 +200,7 @@ DLL_EXPORT DECLARE_API(readMayaDumpStreams)
 DLL_EXPORT DECLARE_API(readMayaDumpStreamsHelp)
 {
     dprintf("This is a custom WinDbg extension that allows for reading extended user stream information from our custom Maya minidump files.\n"
-            "Use the command !readMayaDumpStreams to attempt crossing the streams.\n");
+            "Use the command !readMayaDumpStreams [dumpFilePath] to attempt crossing the streams. Without a path, the newest crash dump in %%TEMP%% is read.\n");
     return;
 #pragma warning(default : 4100)
 }